@@ -0,0 +1,190 @@
+#include "bench_compare.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "json_reader.hpp"
+#include "json_writer.hpp"
+
+namespace {
+const BenchCaseSamples* Find(const std::vector<BenchCaseSamples>& cases, const std::string& name) {
+    for (const BenchCaseSamples& c : cases) {
+        if (c.name == name) return &c;
+    }
+    return nullptr;
+}
+
+bool Finish(std::unique_ptr<FILE, int (*)(FILE*)>& file, JsonWriter& w, const std::string& path, std::string& error) {
+    if (!w.flush() || std::fclose(file.release()) != 0) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+}  // namespace
+
+double BenchCaseSamples::median() const {
+    if (ns.empty()) return 0.0;
+    std::vector<double> sorted = ns;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t n = sorted.size();
+    return n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+}
+
+const char* BenchVerdictName(BenchVerdict::Kind kind) {
+    switch (kind) {
+        case BenchVerdict::Kind::Slower: return "slower";
+        case BenchVerdict::Kind::Faster: return "faster";
+        case BenchVerdict::Kind::New: return "new";
+        case BenchVerdict::Kind::Missing: return "missing";
+        default: return "same";
+    }
+}
+
+double MannWhitneyGreaterP(const std::vector<double>& a, const std::vector<double>& b) {
+    const size_t n1 = a.size(), n2 = b.size();
+    if (n1 == 0 || n2 == 0) return 1.0;
+    // Ranks of the pooled values, ties given their average rank.
+    std::vector<std::pair<double, int>> pooled;
+    pooled.reserve(n1 + n2);
+    for (double v : a) pooled.emplace_back(v, 0);
+    for (double v : b) pooled.emplace_back(v, 1);
+    std::sort(pooled.begin(), pooled.end());
+    const double n = static_cast<double>(n1 + n2);
+    double rank_sum_b = 0.0;
+    double ties = 0.0;  // sum of t^3 - t over tied groups
+    for (size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) ++j;
+        const double rank = 0.5 * static_cast<double>(i + 1 + j);  // average of ranks i+1 .. j
+        for (size_t k = i; k < j; ++k) {
+            if (pooled[k].second == 1) rank_sum_b += rank;
+        }
+        const double t = static_cast<double>(j - i);
+        ties += t * t * t - t;
+        i = j;
+    }
+    const double u = rank_sum_b - static_cast<double>(n2) * (n2 + 1) / 2.0;
+    const double mean = static_cast<double>(n1) * static_cast<double>(n2) / 2.0;
+    const double var = static_cast<double>(n1) * static_cast<double>(n2) / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0)));
+    if (!(var > 0.0)) return 1.0;  // all values equal
+    const double z = (u - mean - 0.5) / std::sqrt(var);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+std::vector<BenchVerdict> CompareBench(const std::vector<BenchCaseSamples>& baseline,
+                                       const std::vector<BenchCaseSamples>& current,
+                                       const BenchCompareSettings& settings) {
+    std::vector<BenchVerdict> out;
+    for (const BenchCaseSamples& now : current) {
+        BenchVerdict v;
+        v.name = now.name;
+        v.current_ns = now.median();
+        const BenchCaseSamples* base = Find(baseline, now.name);
+        if (!base || base->ns.empty()) {
+            v.kind = BenchVerdict::Kind::New;
+            out.push_back(v);
+            continue;
+        }
+        v.baseline_ns = base->median();
+        v.change = v.baseline_ns > 0.0 ? v.current_ns / v.baseline_ns - 1.0 : 0.0;
+        if (v.change >= 0.0) {
+            v.p = MannWhitneyGreaterP(base->ns, now.ns);
+            if (v.p < settings.alpha && v.change > settings.threshold) v.kind = BenchVerdict::Kind::Slower;
+        } else {
+            v.p = MannWhitneyGreaterP(now.ns, base->ns);
+            if (v.p < settings.alpha && -v.change > settings.threshold) v.kind = BenchVerdict::Kind::Faster;
+        }
+        out.push_back(v);
+    }
+    for (const BenchCaseSamples& base : baseline) {
+        if (Find(current, base.name)) continue;
+        BenchVerdict v;
+        v.name = base.name;
+        v.kind = BenchVerdict::Kind::Missing;
+        v.baseline_ns = base.median();
+        out.push_back(v);
+    }
+    return out;
+}
+
+bool WriteBenchJson(const std::string& path, const std::vector<BenchCaseSamples>& cases, std::string& error) {
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "w"), &std::fclose);
+    if (!file) {
+        error = "cannot create " + path;
+        return false;
+    }
+    JsonWriter w(file.get());
+    w.raw("{\"cases\": [");
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const BenchCaseSamples& c = cases[i];
+        w.raw(i ? ",\n  " : "\n  ").raw("{\"name\": ").string(c.name).raw(", \"calls\": ").integer(c.calls);
+        w.raw(", \"medianNs\": ").fixed(c.median(), 2).raw(", \"samplesNs\": [");
+        for (size_t k = 0; k < c.ns.size(); ++k) w.raw(k ? ", " : "").fixed(c.ns[k], 2);
+        w.raw("]}");
+    }
+    w.raw(cases.empty() ? "]}\n" : "\n]}\n");
+    return Finish(file, w, path, error);
+}
+
+bool LoadBenchJson(const std::string& path, std::vector<BenchCaseSamples>& cases, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Json root;
+    const Json* list = nullptr;
+    if (JsonParser(text).parse(root) && root.type == Json::Type::Object) list = root.get("cases");
+    if (!list || list->type != Json::Type::Array) {
+        error = path + " is not a face_pipeline_bench --json file";
+        return false;
+    }
+    cases.clear();
+    for (const Json& item : list->items) {
+        const Json* name = item.get("name");
+        const Json* samples = item.get("samplesNs");
+        if (!name || name->type != Json::Type::String || !samples || samples->type != Json::Type::Array) {
+            error = path + ": a case needs \"name\" and \"samplesNs\"";
+            return false;
+        }
+        BenchCaseSamples c;
+        c.name = name->text;
+        const Json* calls = item.get("calls");
+        if (calls && calls->type == Json::Type::Number) c.calls = static_cast<long long>(calls->number);
+        for (const Json& s : samples->items) {
+            if (s.type == Json::Type::Number) c.ns.push_back(s.number);
+        }
+        cases.push_back(std::move(c));
+    }
+    return true;
+}
+
+bool WriteCompareReport(const std::string& path, const std::vector<BenchVerdict>& verdicts,
+                        const BenchCompareSettings& settings, std::string& error) {
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "w"), &std::fclose);
+    if (!file) {
+        error = "cannot create " + path;
+        return false;
+    }
+    JsonWriter w(file.get());
+    w.raw("{\"threshold\": ").fixed(settings.threshold, 4).raw(", \"alpha\": ").fixed(settings.alpha, 4);
+    w.raw(", \"cases\": [");
+    int regressions = 0;
+    for (size_t i = 0; i < verdicts.size(); ++i) {
+        const BenchVerdict& v = verdicts[i];
+        regressions += v.kind == BenchVerdict::Kind::Slower ? 1 : 0;
+        w.raw(i ? ",\n  " : "\n  ").raw("{\"name\": ").string(v.name);
+        w.raw(", \"verdict\": \"").raw(BenchVerdictName(v.kind)).ch('"');
+        w.raw(", \"baselineNs\": ").fixed(v.baseline_ns, 2).raw(", \"currentNs\": ").fixed(v.current_ns, 2);
+        w.raw(", \"change\": ").fixed(v.change, 4).raw(", \"p\": ").fixed(v.p, 6).ch('}');
+    }
+    w.raw(verdicts.empty() ? "]" : "\n]").raw(", \"regressions\": ").integer(regressions);
+    w.raw(", \"passed\": ").raw(regressions == 0 ? "true" : "false").raw("}\n");
+    return Finish(file, w, path, error);
+}
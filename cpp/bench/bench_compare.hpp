@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * Benchmark results saved as a baseline and compared against later runs
+ * (face_pipeline_bench --json, --compare): whether a case got slower is
+ * decided by a one-sided Mann-Whitney U test over its batch timings, so
+ * run-to-run noise does not raise false alarms and a steady slowdown of a
+ * few percent is still caught.
+ */
+
+/** Timings of one case: per-call nanoseconds of each timed batch, over every run of the suite. */
+struct BenchCaseSamples {
+    std::string name;
+    long long calls = 0;
+    std::vector<double> ns;
+
+    double median() const;
+};
+
+/** Thresholds for calling a case slower (or faster). */
+struct BenchCompareSettings {
+    double threshold = 0.05;  // smallest change of the median to report, as a fraction of the baseline's
+    double alpha = 0.01;      // largest p-value that counts as a real change
+};
+
+/** One case, baseline against now. */
+struct BenchVerdict {
+    enum class Kind { Same, Slower, Faster, New, Missing };
+    std::string name;
+    Kind kind = Kind::Same;
+    double baseline_ns = 0.0;  // medians per call
+    double current_ns = 0.0;
+    double change = 0.0;       // current / baseline - 1
+    double p = 1.0;            // of the change in the median's direction happening by chance
+};
+
+const char* BenchVerdictName(BenchVerdict::Kind kind);
+
+/**
+ * One-sided Mann-Whitney U test, normal approximation with tie and
+ * continuity corrections.
+ *
+ * @return p-value of `b`'s values being as much larger than `a`'s as they are by chance
+ */
+double MannWhitneyGreaterP(const std::vector<double>& a, const std::vector<double>& b);
+
+/** Compare every case of either set, in the order of `current` (missing ones last). */
+std::vector<BenchVerdict> CompareBench(const std::vector<BenchCaseSamples>& baseline,
+                                       const std::vector<BenchCaseSamples>& current,
+                                       const BenchCompareSettings& settings);
+
+/** Save results as JSON: {"cases": [{"name", "calls", "medianNs", "samplesNs": [...]}]}. */
+bool WriteBenchJson(const std::string& path, const std::vector<BenchCaseSamples>& cases, std::string& error);
+bool LoadBenchJson(const std::string& path, std::vector<BenchCaseSamples>& cases, std::string& error);
+
+/**
+ * The comparison as JSON: the settings, per case its verdict, medians,
+ * change and p-value, then "regressions" (slower cases) and "passed".
+ */
+bool WriteCompareReport(const std::string& path, const std::vector<BenchVerdict>& verdicts,
+                        const BenchCompareSettings& settings, std::string& error);
@@ -0,0 +1,124 @@
+#include "crowd_scenario.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "embedding.hpp"
+
+namespace {
+struct Face {
+    float cx, cy;  // normalized center
+    float w, h;    // normalized size
+    float vx, vy;
+    int hidden_until = -1;  // out of sight before this frame
+    EmbeddingF32 identity;
+};
+
+EmbeddingF32 RandomUnit(std::mt19937& rng, int dim) {
+    std::normal_distribution<float> n01(0.0f, 1.0f);
+    EmbeddingF32 v(static_cast<size_t>(dim));
+    for (float& x : v) x = n01(rng);
+    L2Normalize(v);
+    return v;
+}
+
+// `base` plus noise of about `noise` in L2 norm, normalized again.
+EmbeddingF32 Noisy(const EmbeddingF32& base, float noise, std::mt19937& rng) {
+    std::normal_distribution<float> n(0.0f, noise / std::sqrt(static_cast<float>(base.size())));
+    EmbeddingF32 v = base;
+    for (float& x : v) x += n(rng);
+    L2Normalize(v);
+    return v;
+}
+}  // namespace
+
+std::vector<CrowdFrame> GenerateCrowdScenario(const CrowdScenarioOptions& o) {
+    std::mt19937 rng(o.seed);
+    std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+    std::normal_distribution<float> n01(0.0f, 1.0f);
+    const float aspect = static_cast<float>(o.width) / static_cast<float>(std::max(1, o.height));
+    // Crowd faces are small: 2-6% of the frame width, a little taller than wide.
+    auto spawn = [&](Face& f) {
+        f.w = 0.02f + 0.04f * u01(rng);
+        f.h = f.w * aspect * 1.25f;
+        const float angle = 6.2831853f * u01(rng);
+        f.vx = o.speed * std::cos(angle);
+        f.vy = o.speed * std::sin(angle);
+        f.hidden_until = -1;
+        f.identity = RandomUnit(rng, o.embedding_dim);
+    };
+    std::vector<Face> faces(static_cast<size_t>(std::max(0, o.faces)));
+    for (Face& f : faces) {
+        spawn(f);
+        f.cx = u01(rng);
+        f.cy = 0.1f + 0.8f * u01(rng);
+    }
+
+    std::vector<CrowdFrame> frames(static_cast<size_t>(std::max(0, o.frames)));
+    std::poisson_distribution<int> false_count(std::max(0.0f, o.false_rate));
+    for (int t = 0; t < o.frames; ++t) {
+        // Camera: a steady pan with a slow vertical sway.
+        const float pan_x = t > 0 ? o.pan : 0.0f;
+        const float pan_y = t > 0 ? o.pan * 0.25f * std::sin(static_cast<float>(t) / 50.0f) : 0.0f;
+        CrowdFrame& frame = frames[static_cast<size_t>(t)];
+        frame.warp = Mat3f::Identity();
+        frame.warp.m[2] = -pan_x * static_cast<float>(o.width);
+        frame.warp.m[5] = -pan_y * static_cast<float>(o.height);
+
+        for (Face& f : faces) {
+            if (t > 0) {
+                // Random walk, held near the mean speed.
+                f.vx += o.speed * 0.2f * n01(rng);
+                f.vy += o.speed * 0.2f * n01(rng);
+                const float v = std::hypot(f.vx, f.vy);
+                if (v > 2.0f * o.speed && v > 0.0f) {
+                    f.vx *= 2.0f * o.speed / v;
+                    f.vy *= 2.0f * o.speed / v;
+                }
+                f.cx += f.vx - pan_x;
+                f.cy += f.vy - pan_y;
+                if (f.cy < 0.1f || f.cy > 0.9f) {
+                    f.vy = -f.vy;
+                    f.cy = std::max(0.1f, std::min(0.9f, f.cy));
+                }
+                if (f.cx < -f.w / 2.0f || f.cx > 1.0f + f.w / 2.0f) {
+                    // Out of frame: someone new walks in on the far side.
+                    const float edge = f.cx < 0.0f ? 1.0f : 0.0f;
+                    spawn(f);
+                    f.cx = edge;
+                }
+            }
+            if (f.hidden_until <= t && u01(rng) < o.occlusion_rate) {
+                f.hidden_until = t + 1 + static_cast<int>(u01(rng) * static_cast<float>(std::max(1, o.occlusion_frames)));
+            }
+            if (f.hidden_until > t || u01(rng) < o.miss_rate) continue;
+
+            Detection d;
+            const float jx = o.jitter * f.w;
+            const float jy = o.jitter * f.h;
+            d.bbox = {f.cx - f.w / 2.0f + jx * n01(rng), f.cy - f.h / 2.0f + jy * n01(rng),
+                      f.cx + f.w / 2.0f + jx * n01(rng), f.cy + f.h / 2.0f + jy * n01(rng)};
+            d.score = 0.5f + 0.45f * u01(rng);
+            d.reid = Noisy(f.identity, o.embedding_noise, rng);
+            d.has_reid = true;
+            d.reid_quality = 0.9f;
+            frame.dets.push_back(std::move(d));
+        }
+        for (int k = false_count(rng); k > 0; --k) {
+            Detection d;
+            const float w = 0.02f + 0.03f * u01(rng);
+            const float x = u01(rng) * (1.0f - w);
+            const float y = u01(rng) * (1.0f - w * aspect);
+            d.bbox = {x, y, x + w, y + w * aspect};
+            d.score = 0.35f + 0.25f * u01(rng);
+            d.reid = RandomUnit(rng, o.embedding_dim);
+            d.has_reid = true;
+            d.reid_quality = 0.5f;
+            frame.dets.push_back(std::move(d));
+        }
+        // Detectors report faces in no particular order.
+        std::shuffle(frame.dets.begin(), frame.dets.end(), rng);
+    }
+    return frames;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "kalman_filter.hpp"
+#include "transform.hpp"
+
+/**
+ * A synthetic crowd shot for benchmarking association and linking: `faces`
+ * faces moving about a frame, hidden now and then behind each other, with
+ * the camera panning, and a detector that jitters, misses and invents
+ * boxes. Each face has an identity whose detections carry noisy copies of
+ * one random embedding. Faces that leave the frame come back in on the
+ * far side as a new identity. The same options and seed give the same
+ * scenario.
+ */
+struct CrowdScenarioOptions {
+    int faces = 100;
+    int frames = 300;
+    int width = 1920;               // frame pixels, for the warps
+    int height = 1080;
+    float speed = 0.002f;           // mean face speed, frame widths per frame
+    float pan = 0.002f;             // camera pan, frame widths per frame (0 = static)
+    float occlusion_rate = 0.01f;   // chance a visible face goes out of sight on a frame
+    int occlusion_frames = 20;      // longest time out of sight
+    float miss_rate = 0.05f;        // chance a visible face is not detected anyway
+    float false_rate = 0.5f;        // spurious detections per frame
+    float jitter = 0.03f;           // box noise, in box sizes
+    float embedding_noise = 0.35f;  // per-detection noise on a face's embedding (L2 norm)
+    int embedding_dim = 128;
+    uint32_t seed = 1;
+};
+
+/** One frame of a scenario: the detector's output and the camera motion. */
+struct CrowdFrame {
+    std::vector<Detection> dets;  // normalized boxes, embeddings set
+    Mat3f warp;                   // previous -> this frame, in pixels
+};
+
+/** Generate the whole scenario up front. */
+std::vector<CrowdFrame> GenerateCrowdScenario(const CrowdScenarioOptions& options);
@@ -0,0 +1,644 @@
+// Microbenchmarks of the native hot paths, to hold optimizations against.
+//
+//   face_pipeline_bench [--model <dir>] [--reid-model <dir>] [--image <file>]
+//                       [--filter <text>] [--min-time <s>]
+//   face_pipeline_bench [...] [--repeat <n>] [--json <file>] [--compare <baseline.json>]
+//   face_pipeline_bench --crowd <n,n,...> [--crowd-frames <n>] [--crowd-pan <f>] ...
+//   face_pipeline_bench --scaling [--images-file <file>] [--scaling-threads <n,n,...>] [--scaling-json <file>]
+//
+// Each case runs in batches whose size doubles until one batch takes a
+// tenth of --min-time, then until --min-time has passed; the table gives
+// the median and the fastest batch per call. Cases that need a model are
+// skipped without one. Frames are synthetic (textured, 1280x720) unless
+// --image is given; the GMC cases track the same frame shifted 3 px right
+// and 2 px down.
+//
+// --json saves every batch timing of every case; --compare runs the suite
+// --repeat times (default 5) and tests each case against such a baseline
+// (bench_compare.hpp), exiting with 2 if any got slower.
+//
+// --crowd instead runs a synthetic crowd shot (crowd_scenario.hpp) of each
+// size through OCSort::update with ReID and warps, then Phase 3 linking,
+// and prints the per-frame update latency, the linking time and the rows the
+// assignment solver saw (solved, settled by the warm start, re-augmented)
+// and the candidate pairs the motion gate dropped against the number of faces.
+//
+// --scaling instead runs every pipeline stage at 1, 2, 4 ... N threads
+// over a sample sequence (thread_scaling.hpp) and prints each stage's
+// throughput, efficiency and saturation point.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_compare.hpp"
+#include "crowd_scenario.hpp"
+#include "frame_cache.hpp"
+#include "gmc.hpp"
+#include "hungarian.hpp"
+#include "inference_backend.hpp"
+#include "kalman_filter.hpp"
+#include "ocsort.hpp"
+#include "reid.hpp"
+#include "scrfd.hpp"
+#include "scrfd_variants.hpp"
+#include "thread_scaling.hpp"
+#include "tracklet_linking.hpp"
+
+namespace {
+// Results are folded in here so the compiler cannot drop the calls.
+volatile double g_sink = 0.0;
+
+struct BenchSettings {
+    const char* filter = nullptr;
+    double min_time_s = 0.5;
+    std::vector<BenchCaseSamples>* results = nullptr;  // every batch's per-call time goes here too (null = none)
+};
+
+std::string FormatNs(double ns) {
+    char text[32];
+    if (ns >= 1e9) {
+        std::snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+    } else if (ns >= 1e6) {
+        std::snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+    } else if (ns >= 1e3) {
+        std::snprintf(text, sizeof(text), "%.2f us", ns / 1e3);
+    } else {
+        std::snprintf(text, sizeof(text), "%.1f ns", ns);
+    }
+    return text;
+}
+
+// True if --filter keeps cases named `name` (or starting with it).
+bool Wanted(const BenchSettings& settings, const std::string& name) {
+    return !settings.filter || name.find(settings.filter) != std::string::npos ||
+           std::string(settings.filter).compare(0, name.size(), name) == 0;
+}
+
+void Run(const BenchSettings& settings, const std::string& name, const std::function<void()>& fn) {
+    if (settings.filter && name.find(settings.filter) == std::string::npos) return;
+    using Clock = std::chrono::steady_clock;
+    auto time_batch = [&fn](long long n) {
+        const auto start = Clock::now();
+        for (long long i = 0; i < n; ++i) fn();
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    };
+    time_batch(1);  // warm caches and lazy state
+    const double min_ns = settings.min_time_s * 1e9;
+    long long batch = 1;
+    double ns = time_batch(batch);
+    while (ns < min_ns / 10.0 && batch < (1LL << 40)) {
+        batch *= 2;
+        ns = time_batch(batch);
+    }
+    std::vector<double> per_call{ns / static_cast<double>(batch)};
+    double total = ns;
+    long long calls = batch;
+    while (total < min_ns || per_call.size() < 3) {
+        ns = time_batch(batch);
+        per_call.push_back(ns / static_cast<double>(batch));
+        total += ns;
+        calls += batch;
+    }
+    if (settings.results) {
+        auto it = std::find_if(settings.results->begin(), settings.results->end(),
+                               [&name](const BenchCaseSamples& c) { return c.name == name; });
+        if (it == settings.results->end()) {
+            settings.results->push_back(BenchCaseSamples{name, 0, {}});
+            it = settings.results->end() - 1;
+        }
+        it->calls += calls;
+        it->ns.insert(it->ns.end(), per_call.begin(), per_call.end());
+    }
+    std::sort(per_call.begin(), per_call.end());
+    printf("%-40s %12lld %12s %12s\n", name.c_str(), calls, FormatNs(per_call[per_call.size() / 2]).c_str(),
+           FormatNs(per_call.front()).c_str());
+    fflush(stdout);
+}
+
+// Smooth blobs plus fine noise: corners for the feature trackers, texture
+// for the detector and ReID to chew on.
+std::vector<uint8_t> SyntheticFrame(int w, int h) {
+    std::vector<uint8_t> rgb(static_cast<size_t>(w) * h * 3);
+    std::mt19937 rng(7);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const double v = 128.0 + 60.0 * std::sin(x * 0.031) * std::cos(y * 0.027) +
+                             30.0 * std::sin((x + 2 * y) * 0.11);
+            for (int c = 0; c < 3; ++c) {
+                const int n = static_cast<int>(rng() % 21) - 10;
+                rgb[(static_cast<size_t>(y) * w + x) * 3 + c] =
+                    static_cast<uint8_t>(std::max(0.0, std::min(255.0, v + n + c * 12)));
+            }
+        }
+    }
+    return rgb;
+}
+
+// `src` moved by (dx, dy) pixels, edges repeated.
+std::vector<uint8_t> ShiftedFrame(const std::vector<uint8_t>& src, int w, int h, int dx, int dy) {
+    std::vector<uint8_t> out(src.size());
+    for (int y = 0; y < h; ++y) {
+        const int sy = std::max(0, std::min(h - 1, y - dy));
+        for (int x = 0; x < w; ++x) {
+            const int sx = std::max(0, std::min(w - 1, x - dx));
+            std::memcpy(&out[(static_cast<size_t>(y) * w + x) * 3], &src[(static_cast<size_t>(sy) * w + sx) * 3], 3);
+        }
+    }
+    return out;
+}
+
+// `count` face-sized boxes on a grid, drifting a little every frame.
+std::vector<Detection> GridDetections(int count, int frame, int w, int h) {
+    std::vector<Detection> dets(static_cast<size_t>(count));
+    const int cols = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count)))));
+    const float cell_w = static_cast<float>(w) / cols;
+    const float cell_h = static_cast<float>(h) / cols;
+    for (int i = 0; i < count; ++i) {
+        const float drift = static_cast<float>(frame % 60) * 0.5f;
+        const float x = (i % cols) * cell_w + cell_w * 0.2f + drift;
+        const float y = (i / cols) * cell_h + cell_h * 0.2f + drift * 0.5f;
+        dets[i].bbox = {x, y, x + cell_w * 0.5f, y + cell_h * 0.6f};
+        dets[i].score = 0.9f;
+    }
+    return dets;
+}
+
+void BenchDetector(const BenchSettings& s, const std::string& model_dir, const std::vector<uint8_t>& rgb, int w,
+                   int h) {
+    if (!Wanted(s, "scrfd/Detect")) return;
+    const std::string stem = ResolveDetectorStem(model_dir, std::string(), false);
+    for (int side : {320, 480, 640}) {
+        ScrfdDetector detector(stem + ".param", stem + ".bin", side, side, 0.5f, 0.4f);
+        if (!detector.IsLoaded()) {
+            printf("%-40s skipped: no detector in %s\n", "scrfd/Detect", model_dir.c_str());
+            return;
+        }
+        Run(s, "scrfd/Detect/" + std::to_string(side), [&]() {
+            g_sink = g_sink + static_cast<double>(detector.Detect(rgb.data(), w, h).size());
+        });
+    }
+}
+
+void BenchReid(const BenchSettings& s, const std::string& reid_dir, const std::vector<uint8_t>& rgb, int w, int h) {
+    if (!Wanted(s, "reid/Extract")) return;
+    const std::string stem = FindModelStem(reid_dir, {"mobilefacenet-opt", "mobilefacenet"});
+    MobileFaceNetReid reid;
+    if (stem.empty() || !reid.Load(stem + ".param", stem + ".bin")) {
+        printf("%-40s skipped: no --reid-model\n", "reid/Extract");
+        return;
+    }
+    const BBox face{w * 0.4f, h * 0.3f, w * 0.4f + 160.0f, h * 0.3f + 200.0f};
+    // Eyes, nose, mouth corners where SCRFD puts them on a frontal face.
+    std::array<std::array<float, 2>, 5> landmarks;
+    const float rel[5][2] = {{0.32f, 0.40f}, {0.68f, 0.40f}, {0.50f, 0.58f}, {0.36f, 0.76f}, {0.64f, 0.76f}};
+    for (int k = 0; k < 5; ++k) {
+        landmarks[k] = {face.x1 + rel[k][0] * face.width(), face.y1 + rel[k][1] * face.height()};
+    }
+    for (const bool aligned : {true, false}) {
+        Run(s, aligned ? "reid/Extract/aligned" : "reid/Extract/fallback", [&]() {
+            bool ok = false;
+            const EmbeddingF32 e = reid.Extract(rgb.data(), w, h, face, aligned ? &landmarks : nullptr, ok);
+            g_sink = g_sink + (ok && !e.empty() ? e[0] : 0.0f);
+        });
+    }
+}
+
+void BenchOcsort(const BenchSettings& s, int w, int h) {
+    for (int tracks : {1, 10, 100}) {
+        OCSort tracker(0.3f, 30, 1);
+        std::vector<TrackResult> out;
+        int frame = 0;
+        for (; frame < 5; ++frame) tracker.update(GridDetections(tracks, frame, w, h), out);
+        // Detections are built outside the timed call.
+        std::vector<std::vector<Detection>> frames(60);
+        for (int f = 0; f < 60; ++f) frames[f] = GridDetections(tracks, f, w, h);
+        Run(s, "ocsort/update/" + std::to_string(tracks), [&]() {
+            tracker.update(frames[frame++ % 60], out);
+            g_sink = g_sink + static_cast<double>(out.size());
+        });
+    }
+}
+
+void BenchHungarian(const BenchSettings& s) {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> cost(0.0, 1.0);
+    for (int n : {4, 16, 64, 256}) {
+        std::vector<std::vector<double>> matrix(n, std::vector<double>(n));
+        for (auto& row : matrix) {
+            for (double& c : row) c = cost(rng);
+        }
+        HungarianAlgorithm solver;
+        std::vector<int> assignment;
+        Run(s, "hungarian/solve/" + std::to_string(n) + "x" + std::to_string(n),
+            [&]() { g_sink = g_sink + solver.solve(matrix, assignment); });
+    }
+}
+
+void BenchGmc(const BenchSettings& s, const std::vector<uint8_t>& rgb, int w, int h) {
+    const std::vector<uint8_t> shifted = ShiftedFrame(rgb, w, h, 3, 2);
+#ifdef FACE_PIPELINE_GMC_OPENCV
+    // The videostab backend replaces every fallback.
+    const std::pair<const char*, GmcConfig::Fallback> backends[] = {{"opencv", GmcConfig::Fallback::Translation}};
+#else
+    const std::pair<const char*, GmcConfig::Fallback> backends[] = {
+        {"translation", GmcConfig::Fallback::Translation},
+        {"features", GmcConfig::Fallback::Features},
+        {"phase", GmcConfig::Fallback::PhaseCorrelation}};
+#endif
+    for (const auto& backend : backends) {
+        GmcConfig cfg;
+        cfg.fallback = backend.second;
+        GmcEstimator gmc(cfg);
+        bool forward = true;
+        // Alternate the pair so the previous frame is always the last
+        // current one, as in the pipeline.
+        Run(s, std::string("gmc/Estimate/") + backend.first, [&]() {
+            Mat3f warp;
+            const uint8_t* curr = forward ? shifted.data() : rgb.data();
+            const uint8_t* prev = forward ? rgb.data() : shifted.data();
+            gmc.Estimate(curr, w, h, prev, w, h, warp);
+            forward = !forward;
+            g_sink = g_sink + warp.m[2];
+        });
+    }
+}
+
+void BenchKalman(const BenchSettings& s) {
+    using M7 = Mat<7, 7>;
+    M7 a = M7::Identity();
+    M7 b = M7::Identity();
+    for (int r = 0; r < 7; ++r) {
+        for (int c = 0; c < 7; ++c) {
+            a(r, c) += 0.01f * (r + 2 * c);
+            b(r, c) += 0.02f * (2 * r + c);
+        }
+    }
+    Run(s, "kalman/Mat7x7/multiply", [&]() {
+        const M7 p = a * b;
+        g_sink = g_sink + p(3, 3);
+    });
+    Run(s, "kalman/Mat7x7/transpose-multiply", [&]() {
+        const M7 p = a * b * a.transpose();
+        g_sink = g_sink + p(3, 3);
+    });
+    Mat<4, 4> innovation = Mat<4, 4>::Identity();
+    for (int r = 0; r < 4; ++r) {
+        for (int c = 0; c < 4; ++c) innovation(r, c) += 0.1f / (1 + r + c);
+    }
+    Run(s, "kalman/Mat4x4/inverse", [&]() {
+        const Mat<4, 4> inv = innovation.inverse();
+        g_sink = g_sink + inv(1, 1);
+    });
+
+    for (int slots : {1, 100}) {
+        KalmanStateBank bank;
+        for (int i = 0; i < slots; ++i) {
+            const int slot = bank.acquire();
+            bank.start(slot, {100.0f + i, 200.0f + i, 4000.0f, 0.8f});
+        }
+        Run(s, "kalman/predictAll/" + std::to_string(slots), [&]() {
+            bank.predictAll();
+            g_sink = g_sink + bank.x(0, 0);
+        });
+        float t = 0.0f;
+        Run(s, "kalman/update/" + std::to_string(slots), [&]() {
+            t += 1.0f;
+            for (int i = 0; i < slots; ++i) bank.update(i, {100.0f + i + t, 200.0f + i, 4000.0f, 0.8f});
+            g_sink = g_sink + bank.x(0, 0);
+        });
+    }
+}
+
+// Milliseconds of the q-quantile of sorted `ns`.
+double QuantileMs(const std::vector<double>& ns, double q) {
+    if (ns.empty()) return 0.0;
+    const size_t k = std::min(ns.size() - 1, static_cast<size_t>(q * static_cast<double>(ns.size())));
+    return ns[k] * 1e-6;
+}
+
+// Association and linking of a crowd of each size, the way
+// FacePipeline::process runs them (default tracking and ReID settings).
+void BenchCrowd(const std::vector<int>& sizes, CrowdScenarioOptions options, float motion_gate, bool warm_assignment) {
+    using Clock = std::chrono::steady_clock;
+    const ReidConfig reid_config;
+    constexpr float kFps = 30.0f;
+    constexpr float kConfThresh = 0.5f;
+    printf("%6s %7s %8s %9s %9s %9s %9s %9s %10s %6s %6s %6s %8s %8s %8s %8s\n", "faces", "frames", "dets/f", "mean ms",
+           "p50 ms", "p95 ms", "p99 ms", "max ms", "link ms", "tracks", "links", "output", "solved", "seeded", "reaug",
+           "gated");
+    for (int n : sizes) {
+        options.faces = n;
+        const std::vector<CrowdFrame> frames = GenerateCrowdScenario(options);
+        OCSort tracker(0.3f, 30, 1, 3, 0.2f, true, 0.35f, 0.35f);
+        tracker.setMotionGate(motion_gate);
+        tracker.setWarmAssignment(warm_assignment);
+        std::vector<TrackResult> tracks;
+        std::vector<std::vector<TrackFrame>> track_data;
+        std::vector<double> update_ns;
+        update_ns.reserve(frames.size());
+        size_t dets = 0;
+        for (size_t t = 0; t < frames.size(); ++t) {
+            const CrowdFrame& frame = frames[t];
+            dets += frame.dets.size();
+            const auto start = Clock::now();
+            tracker.update(frame.dets, tracks, true, t > 0 ? &frame.warp : nullptr, options.width, options.height);
+            update_ns.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+            for (const TrackResult& r : tracks) {
+                const size_t id = static_cast<size_t>(r.track_id);
+                if (id >= track_data.size()) track_data.resize(id + 1);
+                track_data[id].push_back(TrackFrame{static_cast<int>(t), r.bbox, r.confidence, r.time_since_update == 0});
+            }
+        }
+
+        const auto link_start = Clock::now();
+        tracker.storeActiveAppearances();
+        const AppearanceTable& appearances = tracker.appearances();
+        std::vector<TrackletSummary> tracklets;
+        for (size_t id = 0; id < track_data.size(); ++id) {
+            if (!track_data[id].empty()) {
+                tracklets.push_back(SummarizeTracklet(static_cast<int>(id), track_data[id], kConfThresh));
+            }
+        }
+        std::vector<const PackedEmbedding*> appearance(tracklets.size(), nullptr);
+        for (size_t i = 0; i < tracklets.size(); ++i) appearance[i] = appearances.get(tracklets[i].id);
+        UnionFind uf(static_cast<int>(track_data.size()));
+        int links = 0;
+        for (const TrackletLink& link : FindTrackletLinks(tracklets, appearance, kFps, 0.35f, reid_config)) {
+            const int a = tracklets[link.from].id;
+            const int b = tracklets[link.to].id;
+            if (uf.find(a) == uf.find(b)) continue;
+            uf.unite(a, b);
+            links++;
+        }
+        int output = 0;
+        for (const TrackletSummary& t : tracklets) output += uf.representative(t.id) == t.id ? 1 : 0;
+        const double link_ms = std::chrono::duration<double, std::milli>(Clock::now() - link_start).count();
+
+        double total_ns = 0.0;
+        for (double ns : update_ns) total_ns += ns;
+        std::sort(update_ns.begin(), update_ns.end());
+        const double frame_count = static_cast<double>(std::max<size_t>(1, frames.size()));
+        const OCSort::AssociationStats& stats = tracker.associationStats();
+        printf("%6d %7zu %8.1f %9.3f %9.3f %9.3f %9.3f %9.3f %10.2f %6zu %6d %6d %8lld %8lld %8lld %8lld\n", n, frames.size(),
+               static_cast<double>(dets) / frame_count, total_ns * 1e-6 / frame_count, QuantileMs(update_ns, 0.50),
+               QuantileMs(update_ns, 0.95), QuantileMs(update_ns, 0.99), update_ns.empty() ? 0.0 : update_ns.back() * 1e-6,
+               link_ms, tracklets.size(), links, output, static_cast<long long>(stats.solved_rows),
+               static_cast<long long>(stats.seeded_rows), static_cast<long long>(stats.reaugmented_rows),
+               static_cast<long long>(stats.motion_gated));
+        fflush(stdout);
+    }
+}
+
+// "10,50,200" as its numbers; empty on anything else.
+std::vector<int> ParseSizes(const char* text) {
+    std::vector<int> sizes;
+    const char* p = text;
+    while (*p) {
+        char* end = nullptr;
+        const long n = std::strtol(p, &end, 10);
+        if (end == p || n < 1) return {};
+        sizes.push_back(static_cast<int>(n));
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return {};
+    }
+    return sizes;
+}
+
+void PrintUsage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  --model <dir>        SCRFD model dir (default: models)\n");
+    fprintf(stderr, "  --reid-model <dir>   MobileFaceNet model dir (reid cases are skipped without it)\n");
+    fprintf(stderr, "  --image <file>       Frame for the detector, ReID and GMC cases (default: synthetic 1280x720)\n");
+    fprintf(stderr, "  --filter <text>      Only the cases whose name contains text\n");
+    fprintf(stderr, "  --min-time <s>       Time spent per case (default: 0.5)\n");
+    fprintf(stderr, "  --repeat <n>         Run the suite n times (default: 1, or 5 with --compare)\n");
+    fprintf(stderr, "  --json <file>        Save every batch timing of every case, as a --compare baseline\n");
+    fprintf(stderr, "  --compare <file>     Test each case against a --json baseline (Mann-Whitney U); exit\n");
+    fprintf(stderr, "                       with 2 if any got slower\n");
+    fprintf(stderr, "  --compare-report <file> The comparison as JSON\n");
+    fprintf(stderr, "  --threshold <f>      Smallest change of a median that counts (default: 0.05 = 5%%)\n");
+    fprintf(stderr, "  --alpha <p>          Largest p-value that counts (default: 0.01)\n");
+    fprintf(stderr, "  --crowd <n,n,...>    Instead, a synthetic crowd shot of each size through association\n");
+    fprintf(stderr, "                       and linking: per-frame update latency and linking time\n");
+    fprintf(stderr, "  --crowd-frames <n>   Frames of each shot (default: 300)\n");
+    fprintf(stderr, "  --crowd-speed <f>    Mean face speed, frame widths per frame (default: 0.002)\n");
+    fprintf(stderr, "  --crowd-pan <f>      Camera pan, frame widths per frame (default: 0.002)\n");
+    fprintf(stderr, "  --crowd-occlusion <p> Chance a face goes out of sight on a frame (default: 0.01)\n");
+    fprintf(stderr, "  --crowd-miss <p>     Chance a visible face is not detected (default: 0.05)\n");
+    fprintf(stderr, "  --crowd-false <n>    Spurious detections per frame (default: 0.5)\n");
+    fprintf(stderr, "  --crowd-jitter <f>   Box noise, in box sizes (default: 0.03)\n");
+    fprintf(stderr, "  --crowd-seed <n>     Scenario seed (default: 1)\n");
+    fprintf(stderr, "  --crowd-motion-gate <chi2> The tracker's motion gate (OCSort::setMotionGate; default: off)\n");
+    fprintf(stderr, "  --crowd-cold-assignment Solve every frame's assignment from scratch (OCSort::setWarmAssignment)\n");
+    fprintf(stderr, "  --scaling            Instead, every pipeline stage at 1, 2, 4 ... N threads: throughput,\n");
+    fprintf(stderr, "                       efficiency and saturation point (--min-time per point)\n");
+    fprintf(stderr, "  --images-file <file> Sample sequence for --scaling, one image path per line (default:\n");
+    fprintf(stderr, "                       synthetic frames, without the decode and end-to-end stages)\n");
+    fprintf(stderr, "  --scaling-frames <n> Frames of it used (default: 30)\n");
+    fprintf(stderr, "  --scaling-threads <n,n,...> Thread counts (default: powers of 2 up to the core count)\n");
+    fprintf(stderr, "  --scaling-json <file> The results as JSON, for comparing machines\n");
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    BenchSettings settings;
+    std::string model_dir = "models";
+    std::string reid_dir;
+    std::string image_path;
+    std::vector<int> crowd_sizes;
+    CrowdScenarioOptions crowd;
+    float crowd_motion_gate = 0.0f;
+    bool crowd_warm_assignment = true;
+    int repeat = 0;
+    std::string json_path;
+    std::string compare_path;
+    std::string report_path;
+    BenchCompareSettings compare;
+    bool scaling = false;
+    std::string images_file;
+    int scaling_frames = 30;
+    ThreadScalingOptions scaling_options;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            model_dir = argv[++i];
+        } else if (strcmp(argv[i], "--reid-model") == 0 && i + 1 < argc) {
+            reid_dir = argv[++i];
+        } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            image_path = argv[++i];
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            settings.filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            settings.min_time_s = std::max(0.01, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            compare_path = argv[++i];
+        } else if (strcmp(argv[i], "--compare-report") == 0 && i + 1 < argc) {
+            report_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            compare.threshold = std::max(0.0, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) {
+            compare.alpha = std::max(0.0, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd") == 0 && i + 1 < argc) {
+            crowd_sizes = ParseSizes(argv[++i]);
+            if (crowd_sizes.empty()) {
+                fprintf(stderr, "Error: --crowd expects face counts like 10,50,200\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--crowd-frames") == 0 && i + 1 < argc) {
+            crowd.frames = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd-speed") == 0 && i + 1 < argc) {
+            crowd.speed = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd-pan") == 0 && i + 1 < argc) {
+            crowd.pan = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd-occlusion") == 0 && i + 1 < argc) {
+            crowd.occlusion_rate = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd-miss") == 0 && i + 1 < argc) {
+            crowd.miss_rate = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd-false") == 0 && i + 1 < argc) {
+            crowd.false_rate = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd-jitter") == 0 && i + 1 < argc) {
+            crowd.jitter = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd-motion-gate") == 0 && i + 1 < argc) {
+            crowd_motion_gate = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--crowd-cold-assignment") == 0) {
+            crowd_warm_assignment = false;
+        } else if (strcmp(argv[i], "--crowd-seed") == 0 && i + 1 < argc) {
+            crowd.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if (strcmp(argv[i], "--images-file") == 0 && i + 1 < argc) {
+            images_file = argv[++i];
+        } else if (strcmp(argv[i], "--scaling-frames") == 0 && i + 1 < argc) {
+            scaling_frames = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--scaling-threads") == 0 && i + 1 < argc) {
+            scaling_options.threads = ParseSizes(argv[++i]);
+            if (scaling_options.threads.empty()) {
+                fprintf(stderr, "Error: --scaling-threads expects thread counts like 1,2,4,8\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--scaling-json") == 0 && i + 1 < argc) {
+            scaling_options.json_path = argv[++i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(__OPTIMIZE__)
+    fprintf(stderr, "Warning: built without optimization; configure with -DCMAKE_BUILD_TYPE=Release\n");
+#endif
+    if (!crowd_sizes.empty()) {
+        BenchCrowd(crowd_sizes, crowd, crowd_motion_gate, crowd_warm_assignment);
+        return 0;
+    }
+
+    if (scaling) {
+        scaling_options.model_dir = model_dir;
+        scaling_options.reid_dir = reid_dir;
+        scaling_options.min_time_s = settings.min_time_s;
+        scaling_options.filter = settings.filter;
+        if (!images_file.empty()) {
+            std::ifstream list(images_file);
+            if (!list.is_open()) {
+                fprintf(stderr, "Error: cannot open %s\n", images_file.c_str());
+                return 1;
+            }
+            std::string line;
+            while (static_cast<int>(scaling_options.paths.size()) < scaling_frames && std::getline(list, line)) {
+                if (!line.empty()) scaling_options.paths.push_back(line);
+            }
+        } else {
+            // The synthetic frame panning 3 px right and 2 px down per frame.
+            scaling_options.width = 1280;
+            scaling_options.height = 720;
+            const std::vector<uint8_t> base = SyntheticFrame(1280, 720);
+            for (int f = 0; f < scaling_frames; ++f) {
+                scaling_options.frames.push_back(ShiftedFrame(base, 1280, 720, 3 * f, 2 * f));
+            }
+        }
+        return RunThreadScaling(scaling_options);
+    }
+
+    int w = 1280;
+    int h = 720;
+    std::vector<uint8_t> rgb;
+    if (!image_path.empty()) {
+        LoadedRgbFrame frame;
+        if (!LoadRgbFrame(image_path, frame) || !frame.hasRgb()) {
+            fprintf(stderr, "Error: cannot load %s\n", image_path.c_str());
+            return 1;
+        }
+        w = frame.rgb_w;
+        h = frame.rgb_h;
+        rgb.assign(frame.rgbData(), frame.rgbData() + static_cast<size_t>(w) * h * 3);
+    } else {
+        rgb = SyntheticFrame(w, h);
+    }
+
+    std::vector<BenchCaseSamples> baseline;
+    std::string error;
+    if (!compare_path.empty() && !LoadBenchJson(compare_path, baseline, error)) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return 1;
+    }
+    std::vector<BenchCaseSamples> results;
+    if (!json_path.empty() || !compare_path.empty()) settings.results = &results;
+    const int runs = repeat > 0 ? repeat : (compare_path.empty() ? 1 : 5);
+    for (int run = 0; run < runs; ++run) {
+        if (runs > 1) printf("%sRun %d of %d\n", run > 0 ? "\n" : "", run + 1, runs);
+        printf("%-40s %12s %12s %12s\n", "case", "calls", "median", "fastest");
+        BenchDetector(settings, model_dir, rgb, w, h);
+        BenchReid(settings, reid_dir, rgb, w, h);
+        BenchOcsort(settings, w, h);
+        BenchHungarian(settings);
+        BenchGmc(settings, rgb, w, h);
+        BenchKalman(settings);
+    }
+    if (!json_path.empty() && !WriteBenchJson(json_path, results, error)) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return 1;
+    }
+    if (compare_path.empty()) return 0;
+
+    const std::vector<BenchVerdict> verdicts = CompareBench(baseline, results, compare);
+    printf("\n%-40s %12s %12s %8s %10s  %s\n", "case", "baseline", "current", "change", "p", "verdict");
+    int regressions = 0;
+    for (const BenchVerdict& v : verdicts) {
+        const bool both = v.kind != BenchVerdict::Kind::New && v.kind != BenchVerdict::Kind::Missing;
+        char change[16] = "-";
+        char p[16] = "-";
+        if (both) {
+            std::snprintf(change, sizeof(change), "%+.1f%%", v.change * 100.0);
+            std::snprintf(p, sizeof(p), "%.2g", v.p);
+        }
+        printf("%-40s %12s %12s %8s %10s  %s\n", v.name.c_str(),
+               v.kind == BenchVerdict::Kind::New ? "-" : FormatNs(v.baseline_ns).c_str(),
+               v.kind == BenchVerdict::Kind::Missing ? "-" : FormatNs(v.current_ns).c_str(), change, p,
+               BenchVerdictName(v.kind));
+        regressions += v.kind == BenchVerdict::Kind::Slower ? 1 : 0;
+    }
+    if (!report_path.empty() && !WriteCompareReport(report_path, verdicts, compare, error)) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return 1;
+    }
+    if (regressions > 0) {
+        fprintf(stderr, "Error: %d case%s slower than %s\n", regressions, regressions == 1 ? "" : "s",
+                compare_path.c_str());
+        return 2;
+    }
+    return 0;
+}
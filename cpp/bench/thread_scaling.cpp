@@ -0,0 +1,341 @@
+#include "thread_scaling.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "frame_cache.hpp"
+#include "gmc.hpp"
+#include "inference_backend.hpp"
+#include "json_writer.hpp"
+#include "ocsort.hpp"
+#include "pipeline.hpp"
+#include "reid.hpp"
+#include "scrfd.hpp"
+#include "scrfd_variants.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Results are folded in here so the compiler cannot drop the calls.
+std::atomic<long long> g_scaling_sink{0};
+
+// One worker's share of a stage: does one unit of work and returns the
+// items it covered (frames, faces, tracker updates).
+using StageWork = std::function<long long()>;
+
+struct ScalingStage {
+    std::string name;
+    const char* unit = "frames";
+    bool warmup = true;  // one untimed call per worker first
+    const char* needs = "";  // shown when it is skipped
+    // State for `workers` workers, built before the clock starts (empty = skip).
+    std::function<std::vector<StageWork>(int workers)> prepare;
+};
+
+struct ScalingPoint {
+    int threads = 0;
+    double per_second = 0.0;
+    double speedup = 0.0;
+    double efficiency = 0.0;
+};
+
+struct ScalingResult {
+    std::string name;
+    const char* unit = "frames";
+    std::vector<ScalingPoint> points;
+    int saturation_threads = 0;
+    double peak_per_second = 0.0;
+};
+
+struct SampleFace {
+    int frame = 0;
+    BBox box;
+    std::array<std::array<float, 2>, 5> landmarks{};
+};
+
+// Items per second of `work`, one thread each, together for `min_time_s`.
+double MeasureThroughput(std::vector<StageWork>& work, bool warmup, double min_time_s) {
+    const int n = static_cast<int>(work.size());
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<long long> items(static_cast<size_t>(n), 0);
+    std::vector<Clock::time_point> ends(static_cast<size_t>(n));
+    Clock::time_point start;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < n; ++i) {
+        threads.emplace_back([&, i] {
+            ConfigureWorkerThread();
+            if (warmup) work[static_cast<size_t>(i)]();
+            ready++;
+            while (!go.load()) std::this_thread::yield();
+            long long done = 0;
+            Clock::time_point now = Clock::now();
+            while (std::chrono::duration<double>(now - start).count() < min_time_s) {
+                done += work[static_cast<size_t>(i)]();
+                now = Clock::now();
+            }
+            items[static_cast<size_t>(i)] = done;
+            ends[static_cast<size_t>(i)] = now;
+        });
+    }
+    while (ready.load() < n) std::this_thread::yield();
+    start = Clock::now();
+    go = true;
+    for (std::thread& t : threads) t.join();
+    long long total = 0;
+    Clock::time_point end = start;
+    for (int i = 0; i < n; ++i) {
+        total += items[static_cast<size_t>(i)];
+        end = std::max(end, ends[static_cast<size_t>(i)]);
+    }
+    const double s = std::chrono::duration<double>(end - start).count();
+    return s > 0.0 ? static_cast<double>(total) / s : 0.0;
+}
+
+// 1, 2, 4 ... up to the pipeline's cores, and the core count itself.
+std::vector<int> DefaultThreadCounts() {
+    const int cores = PipelineCoreCount();
+    std::vector<int> counts;
+    for (int t = 1; t < cores; t *= 2) counts.push_back(t);
+    counts.push_back(cores);
+    return counts;
+}
+
+bool WriteScalingJson(const std::string& path, const ThreadScalingOptions& options,
+                      const std::vector<ScalingResult>& results) {
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "w"), &std::fclose);
+    if (!file) return false;
+    {
+        JsonWriter w(file.get());
+        w.raw("{\"cores\": ").integer(PipelineCoreCount());
+        w.raw(", \"hardwareThreads\": ").integer(static_cast<int64_t>(std::thread::hardware_concurrency()));
+        w.raw(", \"frames\": ").integer(static_cast<int64_t>(options.paths.empty() ? options.frames.size()
+                                                                                  : options.paths.size()));
+        w.raw(", \"minTimeS\": ").fixed(options.min_time_s, 2).raw(", \"stages\": [");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const ScalingResult& r = results[i];
+            w.raw(i ? ",\n  " : "\n  ").raw("{\"name\": ").string(r.name).raw(", \"unit\": ").string(r.unit);
+            w.raw(", \"peakPerSecond\": ").fixed(r.peak_per_second, 2);
+            w.raw(", \"saturationThreads\": ").integer(r.saturation_threads).raw(", \"points\": [");
+            for (size_t k = 0; k < r.points.size(); ++k) {
+                const ScalingPoint& p = r.points[k];
+                w.raw(k ? ", " : "").raw("{\"threads\": ").integer(p.threads);
+                w.raw(", \"perSecond\": ").fixed(p.per_second, 2).raw(", \"speedup\": ").fixed(p.speedup, 3);
+                w.raw(", \"efficiency\": ").fixed(p.efficiency, 3).raw("}");
+            }
+            w.raw("]}");
+        }
+        w.raw(results.empty() ? "]}\n" : "\n]}\n");
+        if (!w.flush()) return false;
+    }
+    return std::fflush(file.get()) == 0;
+}
+}  // namespace
+
+int RunThreadScaling(ThreadScalingOptions& options) {
+    if (options.threads.empty()) options.threads = DefaultThreadCounts();
+
+    // The sample frames, reduced like the pipeline's decoder does by default.
+    FrameRequest decode_request;
+    decode_request.rgb_min_long_side = PipelineOptions{}.decode_long_side;
+    std::vector<std::vector<uint8_t>>& frames = options.frames;
+    if (!options.paths.empty()) {
+        frames.clear();
+        for (const std::string& path : options.paths) {
+            LoadedRgbFrame frame;
+            if (!LoadFrame(path, decode_request, frame) || !frame.hasRgb() ||
+                (!frames.empty() && (frame.rgb_w != options.width || frame.rgb_h != options.height))) {
+                fprintf(stderr, "Error: cannot load %s, or its size differs from the first frame's\n", path.c_str());
+                return 1;
+            }
+            options.width = frame.rgb_w;
+            options.height = frame.rgb_h;
+            frames.emplace_back(frame.rgbData(), frame.rgbData() + static_cast<size_t>(frame.rgb_w) * frame.rgb_h * 3);
+        }
+    }
+    if (frames.empty()) {
+        fprintf(stderr, "Error: no sample frames\n");
+        return 1;
+    }
+    const int w = options.width;
+    const int h = options.height;
+    const size_t frame_count = frames.size();
+    const std::string stem = ResolveDetectorStem(options.model_dir, std::string(), false);
+    const std::string reid_stem =
+        options.reid_dir.empty() ? std::string() : FindModelStem(options.reid_dir, {"mobilefacenet-opt", "mobilefacenet"});
+
+    // One single-threaded detector's view of the sequence, for the ReID and
+    // tracking stages.
+    std::vector<std::vector<Detection>> sequence_dets(frame_count);
+    std::vector<SampleFace> faces;
+    DetectorOptions single;
+    single.num_threads = 1;
+    {
+        ScrfdDetector detector(stem + ".param", stem + ".bin", 640, 640, 0.5f, 0.4f, single);
+        if (detector.IsLoaded()) {
+            for (size_t f = 0; f < frame_count; ++f) {
+                for (const ScrfdFace& face : detector.Detect(frames[f].data(), w, h)) {
+                    Detection d;
+                    d.bbox = {face.bbox[0], face.bbox[1], face.bbox[2], face.bbox[3]};
+                    d.score = face.score;
+                    sequence_dets[f].push_back(d);
+                    faces.push_back(SampleFace{static_cast<int>(f), d.bbox, face.landmarks});
+                }
+            }
+        }
+    }
+    if (faces.empty()) {
+        // No detector, or no faces: a frontal-sized box mid-frame.
+        faces.push_back(SampleFace{0, BBox{w * 0.4f, h * 0.3f, w * 0.4f + 160.0f, h * 0.3f + 200.0f}, {}});
+    }
+
+    std::vector<ScalingStage> stages;
+    if (!options.paths.empty()) {
+        stages.push_back({"decode", "frames", true, "", [&](int workers) {
+            std::vector<StageWork> work;
+            for (int i = 0; i < workers; ++i) {
+                auto frame = std::make_shared<LoadedRgbFrame>();
+                auto next = std::make_shared<size_t>(static_cast<size_t>(i) * frame_count / static_cast<size_t>(workers));
+                work.push_back([&, frame, next]() -> long long {
+                    const std::string& path = options.paths[(*next)++ % frame_count];
+                    if (LoadFrame(path, decode_request, *frame)) g_scaling_sink += frame->rgb_w;
+                    return 1;
+                });
+            }
+            return work;
+        }});
+    }
+    stages.push_back({"scrfd", "frames", true, "a detector in --model", [&](int workers) {
+        std::vector<StageWork> work;
+        for (int i = 0; i < workers; ++i) {
+            auto detector = std::make_shared<ScrfdDetector>(stem + ".param", stem + ".bin", 640, 640, 0.5f, 0.4f, single);
+            if (!detector->IsLoaded()) return std::vector<StageWork>{};
+            auto next = std::make_shared<size_t>(static_cast<size_t>(i) * frame_count / static_cast<size_t>(workers));
+            work.push_back([&, detector, next]() -> long long {
+                g_scaling_sink += static_cast<long long>(detector->Detect(frames[(*next)++ % frame_count].data(), w, h).size());
+                return 1;
+            });
+        }
+        return work;
+    }});
+    stages.push_back({"reid", "faces", true, "--reid-model", [&](int workers) {
+        std::vector<StageWork> work;
+        for (int i = 0; i < workers && !reid_stem.empty(); ++i) {
+            auto reid = std::make_shared<MobileFaceNetReid>();
+            if (!reid->Load(reid_stem + ".param", reid_stem + ".bin")) return std::vector<StageWork>{};
+            reid->SetNumThreads(1);
+            auto next = std::make_shared<size_t>(static_cast<size_t>(i) * faces.size() / static_cast<size_t>(workers));
+            work.push_back([&, reid, next]() -> long long {
+                const SampleFace& face = faces[(*next)++ % faces.size()];
+                const bool aligned = face.landmarks[0][0] != 0.0f || face.landmarks[1][0] != 0.0f;
+                bool ok = false;
+                const EmbeddingF32 e = reid->Extract(frames[static_cast<size_t>(face.frame)].data(), w, h, face.box,
+                                                     aligned ? &face.landmarks : nullptr, ok);
+                g_scaling_sink += ok && !e.empty() ? 1 : 0;
+                return 1;
+            });
+        }
+        return work;
+    }});
+    stages.push_back({"gmc", "frames", true, "two frames or more", [&](int workers) {
+        std::vector<StageWork> work;
+        if (frame_count < 2) return work;
+        for (int i = 0; i < workers; ++i) {
+            // Consecutive pairs, as the estimator keeps the last frame's state.
+            auto gmc = std::make_shared<GmcEstimator>(PipelineOptions{}.gmc);
+            auto next = std::make_shared<size_t>(static_cast<size_t>(i) * (frame_count - 1) / static_cast<size_t>(workers));
+            work.push_back([&, gmc, next]() -> long long {
+                const size_t k = 1 + (*next)++ % (frame_count - 1);
+                Mat3f warp;
+                gmc->Estimate(frames[k].data(), w, h, frames[k - 1].data(), w, h, warp);
+                g_scaling_sink += static_cast<long long>(warp.m[2]);
+                return 1;
+            });
+        }
+        return work;
+    }});
+    stages.push_back({"tracking", "frames", true, "", [&](int workers) {
+        std::vector<StageWork> work;
+        for (int i = 0; i < workers; ++i) {
+            // One clip per worker, started over at its end.
+            auto tracker = std::make_shared<std::unique_ptr<OCSort>>();
+            auto out = std::make_shared<std::vector<TrackResult>>();
+            auto next = std::make_shared<size_t>(0);
+            work.push_back([&, tracker, out, next]() -> long long {
+                const size_t f = (*next)++ % frame_count;
+                if (f == 0) tracker->reset(new OCSort(0.3f, PipelineOptions{}.track_max_age, 1));
+                (*tracker)->update(sequence_dets[f], *out);
+                g_scaling_sink += static_cast<long long>(out->size());
+                return 1;
+            });
+        }
+        return work;
+    }});
+    if (!options.paths.empty()) {
+        stages.push_back({"pipeline", "frames", false, "a detector in --model", [&](int workers) {
+            std::vector<StageWork> work;
+            PipelineOptions single_clip;
+            single_clip.detector = single;
+            single_clip.decode_threads = 1;
+            single_clip.detect_workers = 1;
+            single_clip.gmc_workers = 1;
+            single_clip.track_workers = 1;
+            for (int i = 0; i < workers; ++i) {
+                auto pipeline = std::make_shared<FacePipeline>(options.model_dir, 0.5f, 5.0f, 0.15f, options.reid_dir,
+                                                               0.35f, 0.35f, single_clip);
+                if (!pipeline->isLoaded()) return std::vector<StageWork>{};
+                work.push_back([&, pipeline]() -> long long {
+                    g_scaling_sink += static_cast<long long>(pipeline->process(options.paths).tracks.size());
+                    return static_cast<long long>(frame_count);
+                });
+            }
+            return work;
+        }});
+    }
+
+    std::vector<ScalingResult> results;
+    printf("%-10s %8s %12s %8s %8s %10s\n", "stage", "threads", "per second", "speedup", "effic.", "unit");
+    for (const ScalingStage& stage : stages) {
+        if (options.filter && stage.name.find(options.filter) == std::string::npos) continue;
+        ScalingResult result{stage.name, stage.unit, {}, 0, 0.0};
+        double base = 0.0;
+        for (const int threads : options.threads) {
+            std::vector<StageWork> work = stage.prepare(threads);
+            if (work.empty()) break;
+            const double per_second = MeasureThroughput(work, stage.warmup, options.min_time_s);
+            if (result.points.empty()) base = per_second;
+            ScalingPoint p{threads, per_second, 0.0, 0.0};
+            p.speedup = base > 0.0 ? per_second / base : 0.0;
+            p.efficiency = base > 0.0 ? per_second / (base * threads) : 0.0;
+            result.points.push_back(p);
+            printf("%-10s %8d %12.1f %7.2fx %7.0f%% %10s\n", stage.name.c_str(), threads, per_second, p.speedup,
+                   p.efficiency * 100.0, stage.unit);
+            fflush(stdout);
+        }
+        if (result.points.empty()) {
+            printf("%-10s skipped: needs %s\n", stage.name.c_str(), stage.needs);
+            continue;
+        }
+        for (const ScalingPoint& p : result.points) result.peak_per_second = std::max(result.peak_per_second, p.per_second);
+        for (const ScalingPoint& p : result.points) {
+            if (p.per_second >= 0.95 * result.peak_per_second) {
+                result.saturation_threads = p.threads;
+                break;
+            }
+        }
+        printf("%-10s saturates at %d thread%s (%.1f %s/s peak)\n", stage.name.c_str(), result.saturation_threads,
+               result.saturation_threads == 1 ? "" : "s", result.peak_per_second, stage.unit);
+        results.push_back(result);
+    }
+    if (!options.json_path.empty() && !WriteScalingJson(options.json_path, options, results)) {
+        fprintf(stderr, "Error: cannot write %s\n", options.json_path.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * How each pipeline stage scales with threads (face_pipeline_bench
+ * --scaling), for sizing machines and per-stage thread quotas.
+ *
+ * Every stage runs at each thread count as that many workers, each with
+ * its own state (decoder scratch, one single-threaded detector or ReID
+ * network, one GMC estimator, one tracker), pulling work until --min-time
+ * has passed. That is how the pipeline fans a stage out too (decode
+ * threads, --detect-workers, --gmc-workers, parallel shots), so the
+ * throughput at N threads is what a quota of N can get. The end-to-end
+ * row runs N whole clips at once, each on one thread per stage.
+ *
+ * Per stage: items per second, speedup and efficiency (speedup / threads)
+ * against one thread, and the saturation point: the fewest threads that
+ * reach 95% of the best throughput measured.
+ */
+struct ThreadScalingOptions {
+    std::string model_dir = "models";
+    std::string reid_dir;              // ReID stage skipped when empty or missing
+    std::vector<std::string> paths;    // sample sequence (empty: `frames`, no decode or end-to-end stage)
+    std::vector<std::vector<uint8_t>> frames;  // RGB frames used without `paths`
+    int width = 0;                     // of `frames`
+    int height = 0;
+    std::vector<int> threads;          // thread counts (empty = 1, 2, 4 ... PipelineCoreCount())
+    double min_time_s = 0.5;           // per stage and thread count
+    const char* filter = nullptr;      // only stages whose name contains this
+    std::string json_path;             // results as JSON too (empty = none)
+};
+
+/**
+ * Measure and print the table (and write `json_path`).
+ *
+ * @return 0, or 1 if the sample frames or the JSON file failed
+ */
+int RunThreadScaling(ThreadScalingOptions& options);
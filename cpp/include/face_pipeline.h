@@ -0,0 +1,179 @@
+#ifndef FACE_PIPELINE_H
+#define FACE_PIPELINE_H
+
+/**
+ * C API of libfacepipeline: face detection and tracking in-process (a
+ * Node addon, a host plugin, a service) instead of spawning the
+ * face_pipeline executable.
+ *
+ * The ABI is stable across releases of the same FP_API_VERSION: handles
+ * are opaque, structs passed in start with their own size, and fields are
+ * only ever added at their end. Strings are UTF-8. Unless said otherwise,
+ * functions may be called from any thread, and runs of one pipeline may go
+ * on concurrently (they share its models and detection cache).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(FACE_PIPELINE_BUILDING_LIBRARY)
+#define FP_API __declspec(dllexport)
+#elif defined(FACE_PIPELINE_SHARED)
+#define FP_API __declspec(dllimport)
+#else
+#define FP_API
+#endif
+#else
+#define FP_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FP_API_VERSION 1
+
+/** FP_API_VERSION the library was built with. */
+FP_API int fp_api_version(void);
+
+/**
+ * Message of the last call on this thread that failed, "" if none.
+ * Valid until the next call on the thread.
+ */
+FP_API const char* fp_last_error(void);
+
+/** Models and tracking settings a pipeline is loaded with. */
+typedef struct FpConfig {
+    size_t struct_size;          /* sizeof(FpConfig) */
+    const char* model_dir;       /* SCRFD models, or ":builtin" for embedded ones */
+    const char* reid_model_dir;  /* MobileFaceNet models, NULL or "" = no ReID */
+    float conf_thresh;           /* detector confidence threshold */
+    float detection_fps;         /* faces detected at this rate, tracked between */
+    float iou_thresh;            /* tracker IoU threshold */
+    float reid_weight;           /* appearance weight in association */
+    float reid_cos_thresh;       /* appearance similarity needed to link tracklets */
+} FpConfig;
+
+/** The face_pipeline executable's defaults. */
+FP_API void fp_config_init(FpConfig* config);
+
+typedef struct FpPipeline FpPipeline;
+
+/** @return NULL (see fp_last_error) if the models cannot be loaded */
+FP_API FpPipeline* fp_pipeline_create(const FpConfig* config);
+
+/** Call it once every run of the pipeline has returned: it does not wait for them. */
+FP_API void fp_pipeline_destroy(FpPipeline* pipeline);
+
+/**
+ * Progress of a run, one call at a time (maybe from worker threads), with
+ * the stages of PipelineOptions::progress: "frames" (total -1 while
+ * unknown), "shots", then "linking". Returning nonzero stops the run: it
+ * links the frames read so far and returns them (fp_result_stopped).
+ */
+typedef int (*FpProgressFn)(void* user, const char* stage, int done, int total);
+
+/** Settings of one run. */
+typedef struct FpRunOptions {
+    size_t struct_size;     /* sizeof(FpRunOptions) */
+    float video_fps;        /* frame rate of the input */
+    double time_budget_s;   /* seconds the run may take, 0 = no limit */
+    FpProgressFn progress;  /* NULL = none */
+    void* user;             /* passed to the callbacks */
+} FpRunOptions;
+
+FP_API void fp_run_options_init(FpRunOptions* options);
+
+typedef enum FpPixelFormat {
+    FP_PIXEL_RGB24 = 0, /* packed R,G,B */
+    FP_PIXEL_BGRA = 1,  /* packed B,G,R,A (alpha ignored) */
+    FP_PIXEL_NV12 = 2   /* Y plane, then the interleaved half-size UV plane */
+} FpPixelFormat;
+
+/**
+ * Frames handed over by the caller, e.g. from the host's decoder. `read`
+ * is called for frames 0, 1, ... in order, from one thread at a time, to
+ * copy frame `index` (width * height * 3 bytes for RGB24, * 4 for BGRA,
+ * * 3 / 2 for NV12) into `dst`; it returns 0 past the last frame.
+ *
+ * Frames already in memory can be lent instead: with `borrow` set (and
+ * `read` NULL), it returns frame `index`'s pixels, which must stay valid
+ * and unchanged until the run returns, or NULL past the last frame. RGB24
+ * frames are then read in place. With a known frame_count, `borrow` may be
+ * called concurrently and in any order.
+ */
+typedef struct FpFrameReader {
+    size_t struct_size;  /* sizeof(FpFrameReader) */
+    int width;
+    int height;
+    FpPixelFormat format;
+    int frame_count;     /* -1 = until `read` returns 0 */
+    int (*read)(void* user, int index, uint8_t* dst, size_t bytes);
+    void* user;
+    const uint8_t* (*borrow)(void* user, int index);
+} FpFrameReader;
+
+typedef struct FpResult FpResult;
+
+/**
+ * Track a sequence of image files (PNG, JPEG, ...).
+ *
+ * @return NULL (see fp_last_error) on bad arguments; unreadable frames end the sequence
+ */
+FP_API FpResult* fp_track_images(FpPipeline* pipeline, const char* const* paths, int count,
+                                 const FpRunOptions* options);
+
+/** Track frames from `reader`. @return NULL (see fp_last_error) on bad arguments */
+FP_API FpResult* fp_track_frames(FpPipeline* pipeline, const FpFrameReader* reader, const FpRunOptions* options);
+
+/** A face found in one frame; the box is normalized to the frame (0-1). */
+typedef struct FpDetection {
+    float x1;
+    float y1;
+    float x2;
+    float y2;
+    float confidence;
+} FpDetection;
+
+/**
+ * Detect the faces of one frame (width * height pixels of `format`), with
+ * the pipeline's detector and confidence threshold. Writes up to
+ * `capacity` of them to `out`, most confident first.
+ *
+ * @return how many faces there are (maybe more than `capacity`), -1 (see fp_last_error) on bad arguments
+ */
+FP_API int fp_detect_frame(FpPipeline* pipeline, const uint8_t* pixels, int width, int height, FpPixelFormat format,
+                           FpDetection* out, int capacity);
+
+/** One frame of a track; the box is normalized to the frame (0-1). */
+typedef struct FpTrackFrame {
+    int frame_index;
+    float x1;
+    float y1;
+    float x2;
+    float y2;
+    float confidence;
+} FpTrackFrame;
+
+/** A track of a result, valid as long as the result. */
+typedef struct FpTrack {
+    int id;
+    int identity;  /* -1 = none */
+    int frame_count;
+    const FpTrackFrame* frames;  /* in frame order */
+} FpTrack;
+
+FP_API int fp_result_frame_count(const FpResult* result);
+/** Nonzero if the run stopped early (stop, time budget): frames from fp_result_frame_count on were not read */
+FP_API int fp_result_stopped(const FpResult* result);
+FP_API int fp_result_track_count(const FpResult* result);
+/** @return track `index` (0 <= index < fp_result_track_count), one with no frames if out of range */
+FP_API FpTrack fp_result_track(const FpResult* result, int index);
+FP_API void fp_result_free(FpResult* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FACE_PIPELINE_H */
@@ -0,0 +1,585 @@
+// Node-API addon over the C API of libfacepipeline (include/face_pipeline.h):
+// the pipeline runs in the Node process, frames go in as buffers and tracks
+// come back as typed arrays. Built by -DFACE_PIPELINE_NODE_ADDON=ON.
+//
+//   createPipeline({modelDir, reidModelDir?, confThresh?, detectionFps?, iouThresh?,
+//                   reidWeight?, reidCosThresh?}) -> Promise<pipeline>
+//   trackImages(pipeline, paths, options?) -> Promise<result>
+//   trackFrames(pipeline, {width, height, format?, frames}, options?) -> Promise<result>
+//   detectFrame(pipeline, {width, height, format?, data}) -> Promise<{boxes, scores}>
+//
+// format is "rgb24" (default), "bgra" or "nv12"; frames are ArrayBuffers or
+// views of them, lent to the run (RGB24 is read in place, not copied) and
+// left unchanged until it settles. options: {videoFps?, timeBudget?,
+// onProgress?(stage, done, total), cancel?: Int32Array} - a nonzero
+// cancel[0] stops the run, which still resolves with the frames read.
+// A result is {frameCount, stopped, tracks: [{id, identity, frameIndices:
+// Int32Array, boxes: Float32Array (x1, y1, x2, y2 per frame), confidences:
+// Float32Array}]}. All work runs on the libuv thread pool.
+
+#define NAPI_VERSION 6
+#include <node_api.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "face_pipeline.h"
+
+namespace {
+
+#define NAPI_CALL(env, call)                                                   \
+    do {                                                                       \
+        if ((call) != napi_ok) {                                               \
+            const napi_extended_error_info* info = nullptr;                    \
+            napi_get_last_error_info((env), &info);                            \
+            bool pending = false;                                              \
+            napi_is_exception_pending((env), &pending);                        \
+            if (!pending) {                                                    \
+                napi_throw_error((env), nullptr,                               \
+                                 info && info->error_message ? info->error_message \
+                                                             : "Node-API call failed"); \
+            }                                                                  \
+            return nullptr;                                                    \
+        }                                                                      \
+    } while (0)
+
+napi_value Throw(napi_env env, const std::string& message) {
+    napi_throw_type_error(env, nullptr, message.c_str());
+    return nullptr;
+}
+
+bool IsType(napi_env env, napi_value v, napi_valuetype type) {
+    napi_valuetype t = napi_undefined;
+    return v != nullptr && napi_typeof(env, v, &t) == napi_ok && t == type;
+}
+
+// Property `name` of `obj` if it is set (not undefined or null).
+napi_value Property(napi_env env, napi_value obj, const char* name) {
+    napi_value v = nullptr;
+    if (!IsType(env, obj, napi_object) || napi_get_named_property(env, obj, name, &v) != napi_ok) return nullptr;
+    if (IsType(env, v, napi_undefined) || IsType(env, v, napi_null)) return nullptr;
+    return v;
+}
+
+bool NumberProperty(napi_env env, napi_value obj, const char* name, double& out) {
+    napi_value v = Property(env, obj, name);
+    if (v == nullptr) return true;
+    return napi_get_value_double(env, v, &out) == napi_ok;
+}
+
+bool StringValue(napi_env env, napi_value v, std::string& out) {
+    size_t len = 0;
+    if (napi_get_value_string_utf8(env, v, nullptr, 0, &len) != napi_ok) return false;
+    out.resize(len + 1);
+    if (napi_get_value_string_utf8(env, v, &out[0], out.size(), &len) != napi_ok) return false;
+    out.resize(len);
+    return true;
+}
+
+// Bytes of an ArrayBuffer, a typed array, a DataView or a Buffer.
+bool BufferBytes(napi_env env, napi_value v, uint8_t*& data, size_t& bytes) {
+    bool is = false;
+    void* p = nullptr;
+    if (napi_is_arraybuffer(env, v, &is) == napi_ok && is) {
+        if (napi_get_arraybuffer_info(env, v, &p, &bytes) != napi_ok) return false;
+        data = static_cast<uint8_t*>(p);
+        return true;
+    }
+    if (napi_is_typedarray(env, v, &is) == napi_ok && is) {
+        napi_typedarray_type type;
+        size_t length = 0;
+        napi_value buffer;
+        size_t offset = 0;
+        if (napi_get_typedarray_info(env, v, &type, &length, &p, &buffer, &offset) != napi_ok) return false;
+        size_t element = 1;
+        switch (type) {
+            case napi_int16_array:
+            case napi_uint16_array: element = 2; break;
+            case napi_int32_array:
+            case napi_uint32_array:
+            case napi_float32_array: element = 4; break;
+            case napi_float64_array:
+            case napi_bigint64_array:
+            case napi_biguint64_array: element = 8; break;
+            default: break;
+        }
+        data = static_cast<uint8_t*>(p);
+        bytes = length * element;
+        return true;
+    }
+    if (napi_is_dataview(env, v, &is) == napi_ok && is) {
+        napi_value buffer;
+        size_t offset = 0;
+        if (napi_get_dataview_info(env, v, &bytes, &p, &buffer, &offset) != napi_ok) return false;
+        data = static_cast<uint8_t*>(p);
+        return true;
+    }
+    return false;
+}
+
+bool PixelFormat(napi_env env, napi_value frames, FpPixelFormat& out) {
+    out = FP_PIXEL_RGB24;
+    napi_value v = Property(env, frames, "format");
+    std::string name;
+    if (v == nullptr) return true;
+    if (!StringValue(env, v, name)) return false;
+    if (name == "rgb24") return true;
+    if (name == "bgra") {
+        out = FP_PIXEL_BGRA;
+        return true;
+    }
+    if (name == "nv12") {
+        out = FP_PIXEL_NV12;
+        return true;
+    }
+    return false;
+}
+
+size_t FrameBytes(int width, int height, FpPixelFormat format) {
+    const size_t px = static_cast<size_t>(width) * static_cast<size_t>(height);
+    return format == FP_PIXEL_BGRA ? px * 4 : format == FP_PIXEL_NV12 ? px * 3 / 2 : px * 3;
+}
+
+void DeletePipeline(napi_env, void* data, void*) { fp_pipeline_destroy(static_cast<FpPipeline*>(data)); }
+
+/**
+ * One asynchronous call: `execute` on a pool thread, then `complete` back
+ * on the JS thread settles its promise. JS values the work reads from (the
+ * pipeline, frame buffers) are referenced until then.
+ */
+struct Work {
+    virtual ~Work() = default;
+    virtual void execute() = 0;
+    // @return the resolution, or null with `error` set to reject
+    virtual napi_value complete(napi_env env) = 0;
+
+    napi_async_work work = nullptr;
+    napi_deferred deferred = nullptr;
+    std::vector<napi_ref> refs;
+    std::string error;
+    FpPipeline* pipeline = nullptr;
+};
+
+void ExecuteWork(napi_env, void* data) { static_cast<Work*>(data)->execute(); }
+
+void CompleteWork(napi_env env, napi_status, void* data) {
+    Work* w = static_cast<Work*>(data);
+    napi_value value = w->error.empty() ? w->complete(env) : nullptr;
+    if (value != nullptr) {
+        napi_resolve_deferred(env, w->deferred, value);
+    } else {
+        napi_value message;
+        napi_value error;
+        napi_create_string_utf8(env, w->error.empty() ? "face pipeline failed" : w->error.c_str(), NAPI_AUTO_LENGTH,
+                                &message);
+        napi_create_error(env, nullptr, message, &error);
+        napi_reject_deferred(env, w->deferred, error);
+    }
+    for (napi_ref ref : w->refs) napi_delete_reference(env, ref);
+    napi_delete_async_work(env, w->work);
+    delete w;
+}
+
+// Queue `w` and return its promise (null, with an exception, on failure).
+napi_value Queue(napi_env env, Work* w, const char* name) {
+    napi_value promise;
+    napi_value resource_name;
+    if (napi_create_promise(env, &w->deferred, &promise) != napi_ok ||
+        napi_create_string_utf8(env, name, NAPI_AUTO_LENGTH, &resource_name) != napi_ok ||
+        napi_create_async_work(env, nullptr, resource_name, ExecuteWork, CompleteWork, w, &w->work) != napi_ok ||
+        napi_queue_async_work(env, w->work) != napi_ok) {
+        for (napi_ref ref : w->refs) napi_delete_reference(env, ref);
+        if (w->work != nullptr) napi_delete_async_work(env, w->work);
+        delete w;
+        return Throw(env, std::string("cannot start ") + name);
+    }
+    return promise;
+}
+
+bool Keep(napi_env env, Work* w, napi_value v) {
+    napi_ref ref;
+    if (napi_create_reference(env, v, 1, &ref) != napi_ok) return false;
+    w->refs.push_back(ref);
+    return true;
+}
+
+// The pipeline argument, kept for the work.
+bool TakePipeline(napi_env env, Work* w, napi_value v) {
+    void* data = nullptr;
+    if (!IsType(env, v, napi_external) || napi_get_value_external(env, v, &data) != napi_ok || data == nullptr) {
+        return false;
+    }
+    w->pipeline = static_cast<FpPipeline*>(data);
+    return Keep(env, w, v);
+}
+
+// --- createPipeline -------------------------------------------------------
+
+struct CreateWork final : Work {
+    FpConfig config;
+    std::string model_dir;
+    std::string reid_model_dir;
+    FpPipeline* created = nullptr;
+
+    void execute() override {
+        config.model_dir = model_dir.c_str();
+        config.reid_model_dir = reid_model_dir.c_str();
+        created = fp_pipeline_create(&config);
+        if (created == nullptr) error = fp_last_error();
+    }
+    napi_value complete(napi_env env) override {
+        napi_value external;
+        if (napi_create_external(env, created, DeletePipeline, nullptr, &external) != napi_ok) {
+            fp_pipeline_destroy(created);
+            error = "cannot wrap the pipeline";
+            return nullptr;
+        }
+        return external;
+    }
+};
+
+napi_value CreatePipeline(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+    napi_value model_dir = argc > 0 ? Property(env, argv[0], "modelDir") : nullptr;
+    auto* w = new CreateWork();
+    fp_config_init(&w->config);
+    double conf = w->config.conf_thresh;
+    double fps = w->config.detection_fps;
+    double iou = w->config.iou_thresh;
+    double reid_weight = w->config.reid_weight;
+    double reid_cos = w->config.reid_cos_thresh;
+    napi_value reid_dir = model_dir ? Property(env, argv[0], "reidModelDir") : nullptr;
+    if (model_dir == nullptr || !StringValue(env, model_dir, w->model_dir) ||
+        (reid_dir != nullptr && !StringValue(env, reid_dir, w->reid_model_dir)) ||
+        !NumberProperty(env, argv[0], "confThresh", conf) || !NumberProperty(env, argv[0], "detectionFps", fps) ||
+        !NumberProperty(env, argv[0], "iouThresh", iou) || !NumberProperty(env, argv[0], "reidWeight", reid_weight) ||
+        !NumberProperty(env, argv[0], "reidCosThresh", reid_cos)) {
+        delete w;
+        return Throw(env, "createPipeline expects {modelDir: string, ...numeric settings}");
+    }
+    w->config.conf_thresh = static_cast<float>(conf);
+    w->config.detection_fps = static_cast<float>(fps);
+    w->config.iou_thresh = static_cast<float>(iou);
+    w->config.reid_weight = static_cast<float>(reid_weight);
+    w->config.reid_cos_thresh = static_cast<float>(reid_cos);
+    return Queue(env, w, "createPipeline");
+}
+
+// --- trackImages / trackFrames --------------------------------------------
+
+struct ProgressEvent {
+    std::string stage;
+    int done;
+    int total;
+};
+
+void CallProgress(napi_env env, napi_value callback, void*, void* data) {
+    ProgressEvent* e = static_cast<ProgressEvent*>(data);
+    if (env != nullptr && callback != nullptr) {
+        napi_value argv[3];
+        napi_value global;
+        napi_create_string_utf8(env, e->stage.c_str(), NAPI_AUTO_LENGTH, &argv[0]);
+        napi_create_int32(env, e->done, &argv[1]);
+        napi_create_int32(env, e->total, &argv[2]);
+        napi_get_global(env, &global);
+        napi_call_function(env, global, callback, 3, argv, nullptr);
+    }
+    delete e;
+}
+
+struct TrackWork : Work {
+    FpRunOptions run;
+    napi_threadsafe_function progress = nullptr;
+    const volatile int32_t* cancel = nullptr;
+    FpResult* result = nullptr;
+
+    static int OnProgress(void* user, const char* stage, int done, int total) {
+        TrackWork* w = static_cast<TrackWork*>(user);
+        if (w->progress != nullptr) {
+            auto* e = new ProgressEvent{stage, done, total};
+            if (napi_call_threadsafe_function(w->progress, e, napi_tsfn_nonblocking) != napi_ok) delete e;
+        }
+        return w->cancel != nullptr && *w->cancel != 0 ? 1 : 0;
+    }
+
+    ~TrackWork() override {
+        if (progress != nullptr) napi_release_threadsafe_function(progress, napi_tsfn_release);
+        fp_result_free(result);
+    }
+
+    void finish() {
+        if (result == nullptr) error = fp_last_error();
+    }
+
+    napi_value complete(napi_env env) override {
+        napi_value out;
+        napi_value tracks;
+        napi_value v;
+        if (napi_create_object(env, &out) != napi_ok || napi_create_array(env, &tracks) != napi_ok) return nullptr;
+        napi_create_int32(env, fp_result_frame_count(result), &v);
+        napi_set_named_property(env, out, "frameCount", v);
+        napi_get_boolean(env, fp_result_stopped(result) != 0, &v);
+        napi_set_named_property(env, out, "stopped", v);
+        for (int t = 0; t < fp_result_track_count(result); ++t) {
+            const FpTrack track = fp_result_track(result, t);
+            const size_t n = static_cast<size_t>(track.frame_count);
+            napi_value obj;
+            napi_value buffers[3];
+            void* data[3];
+            const size_t sizes[3] = {n * sizeof(int32_t), n * 4 * sizeof(float), n * sizeof(float)};
+            for (int b = 0; b < 3; ++b) {
+                if (napi_create_arraybuffer(env, sizes[b], &data[b], &buffers[b]) != napi_ok) return nullptr;
+            }
+            int32_t* indices = static_cast<int32_t*>(data[0]);
+            float* boxes = static_cast<float*>(data[1]);
+            float* confidences = static_cast<float*>(data[2]);
+            for (size_t f = 0; f < n; ++f) {
+                const FpTrackFrame& frame = track.frames[f];
+                indices[f] = frame.frame_index;
+                boxes[f * 4 + 0] = frame.x1;
+                boxes[f * 4 + 1] = frame.y1;
+                boxes[f * 4 + 2] = frame.x2;
+                boxes[f * 4 + 3] = frame.y2;
+                confidences[f] = frame.confidence;
+            }
+            napi_create_object(env, &obj);
+            napi_create_int32(env, track.id, &v);
+            napi_set_named_property(env, obj, "id", v);
+            napi_create_int32(env, track.identity, &v);
+            napi_set_named_property(env, obj, "identity", v);
+            napi_create_typedarray(env, napi_int32_array, n, buffers[0], 0, &v);
+            napi_set_named_property(env, obj, "frameIndices", v);
+            napi_create_typedarray(env, napi_float32_array, n * 4, buffers[1], 0, &v);
+            napi_set_named_property(env, obj, "boxes", v);
+            napi_create_typedarray(env, napi_float32_array, n, buffers[2], 0, &v);
+            napi_set_named_property(env, obj, "confidences", v);
+            napi_set_element(env, tracks, static_cast<uint32_t>(t), obj);
+        }
+        napi_set_named_property(env, out, "tracks", tracks);
+        return out;
+    }
+};
+
+// Run options from the JS object `v` (undefined = defaults).
+bool TakeRunOptions(napi_env env, TrackWork* w, napi_value v) {
+    fp_run_options_init(&w->run);
+    w->run.user = w;
+    if (v == nullptr || IsType(env, v, napi_undefined)) return true;
+    double fps = w->run.video_fps;
+    double budget = 0.0;
+    if (!NumberProperty(env, v, "videoFps", fps) || !NumberProperty(env, v, "timeBudget", budget)) return false;
+    w->run.video_fps = static_cast<float>(fps);
+    w->run.time_budget_s = budget;
+    napi_value cancel = Property(env, v, "cancel");
+    if (cancel != nullptr) {
+        bool is = false;
+        napi_typedarray_type type;
+        size_t length = 0;
+        void* data = nullptr;
+        napi_value buffer;
+        size_t offset = 0;
+        if (napi_is_typedarray(env, cancel, &is) != napi_ok || !is ||
+            napi_get_typedarray_info(env, cancel, &type, &length, &data, &buffer, &offset) != napi_ok ||
+            type != napi_int32_array || length < 1 || !Keep(env, w, cancel)) {
+            return false;
+        }
+        w->cancel = static_cast<const volatile int32_t*>(data);
+    }
+    napi_value on_progress = Property(env, v, "onProgress");
+    if (on_progress != nullptr) {
+        napi_value name;
+        if (!IsType(env, on_progress, napi_function) ||
+            napi_create_string_utf8(env, "onProgress", NAPI_AUTO_LENGTH, &name) != napi_ok ||
+            napi_create_threadsafe_function(env, on_progress, nullptr, name, 0, 1, nullptr, nullptr, nullptr,
+                                            CallProgress, &w->progress) != napi_ok) {
+            return false;
+        }
+    }
+    if (w->cancel != nullptr || w->progress != nullptr) w->run.progress = &TrackWork::OnProgress;
+    return true;
+}
+
+struct ImagesWork final : TrackWork {
+    std::vector<std::string> paths;
+
+    void execute() override {
+        std::vector<const char*> list(paths.size());
+        for (size_t i = 0; i < paths.size(); ++i) list[i] = paths[i].c_str();
+        result = fp_track_images(pipeline, list.data(), static_cast<int>(list.size()), &run);
+        finish();
+    }
+};
+
+napi_value TrackImages(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value argv[3];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+    auto* w = new ImagesWork();
+    bool is_array = false;
+    uint32_t count = 0;
+    bool ok = argc >= 2 && TakePipeline(env, w, argv[0]) && napi_is_array(env, argv[1], &is_array) == napi_ok &&
+              is_array && napi_get_array_length(env, argv[1], &count) == napi_ok;
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        napi_value path;
+        w->paths.emplace_back();
+        ok = napi_get_element(env, argv[1], i, &path) == napi_ok && StringValue(env, path, w->paths.back());
+    }
+    if (!ok || !TakeRunOptions(env, w, argc > 2 ? argv[2] : nullptr)) {
+        for (napi_ref ref : w->refs) napi_delete_reference(env, ref);
+        delete w;
+        return Throw(env, "trackImages expects (pipeline, paths: string[], options?)");
+    }
+    return Queue(env, w, "trackImages");
+}
+
+struct FramesWork final : TrackWork {
+    FpFrameReader reader;
+    std::vector<const uint8_t*> frames;
+
+    static const uint8_t* Borrow(void* user, int index) {
+        const FramesWork* w = static_cast<const FramesWork*>(user);
+        return index >= 0 && index < static_cast<int>(w->frames.size()) ? w->frames[static_cast<size_t>(index)]
+                                                                         : nullptr;
+    }
+
+    void execute() override {
+        result = fp_track_frames(pipeline, &reader, &run);
+        finish();
+    }
+};
+
+napi_value TrackFrames(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value argv[3];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+    auto* w = new FramesWork();
+    std::memset(&w->reader, 0, sizeof(w->reader));
+    w->reader.struct_size = sizeof(FpFrameReader);
+    w->reader.borrow = &FramesWork::Borrow;
+    w->reader.user = w;
+    double width = 0;
+    double height = 0;
+    napi_value list = argc >= 2 ? Property(env, argv[1], "frames") : nullptr;
+    bool is_array = false;
+    uint32_t count = 0;
+    bool ok = list != nullptr && TakePipeline(env, w, argv[0]) && NumberProperty(env, argv[1], "width", width) &&
+              NumberProperty(env, argv[1], "height", height) && width >= 1 && height >= 1 &&
+              PixelFormat(env, argv[1], w->reader.format) && napi_is_array(env, list, &is_array) == napi_ok &&
+              is_array && napi_get_array_length(env, list, &count) == napi_ok;
+    if (ok) {
+        w->reader.width = static_cast<int>(width);
+        w->reader.height = static_cast<int>(height);
+        w->reader.frame_count = static_cast<int>(count);
+    }
+    const size_t need = ok ? FrameBytes(w->reader.width, w->reader.height, w->reader.format) : 0;
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        napi_value frame;
+        uint8_t* data = nullptr;
+        size_t bytes = 0;
+        ok = napi_get_element(env, list, i, &frame) == napi_ok && BufferBytes(env, frame, data, bytes) &&
+             bytes >= need && Keep(env, w, frame);
+        w->frames.push_back(data);
+    }
+    if (!ok || !TakeRunOptions(env, w, argc > 2 ? argv[2] : nullptr)) {
+        for (napi_ref ref : w->refs) napi_delete_reference(env, ref);
+        delete w;
+        return Throw(env, "trackFrames expects (pipeline, {width, height, format?, frames: buffers of a frame each}, "
+                          "options?)");
+    }
+    return Queue(env, w, "trackFrames");
+}
+
+// --- detectFrame ----------------------------------------------------------
+
+struct DetectWork final : Work {
+    const uint8_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    FpPixelFormat format = FP_PIXEL_RGB24;
+    std::vector<FpDetection> faces;
+
+    void execute() override {
+        faces.resize(16);
+        int n = fp_detect_frame(pipeline, pixels, width, height, format, faces.data(), static_cast<int>(faces.size()));
+        if (n > static_cast<int>(faces.size())) {
+            faces.resize(static_cast<size_t>(n));
+            n = fp_detect_frame(pipeline, pixels, width, height, format, faces.data(), n);
+        }
+        if (n < 0) {
+            error = fp_last_error();
+            return;
+        }
+        faces.resize(static_cast<size_t>(n));
+    }
+    napi_value complete(napi_env env) override {
+        napi_value out;
+        napi_value buffers[2];
+        void* data[2];
+        napi_value v;
+        const size_t n = faces.size();
+        if (napi_create_object(env, &out) != napi_ok ||
+            napi_create_arraybuffer(env, n * 4 * sizeof(float), &data[0], &buffers[0]) != napi_ok ||
+            napi_create_arraybuffer(env, n * sizeof(float), &data[1], &buffers[1]) != napi_ok) {
+            return nullptr;
+        }
+        float* boxes = static_cast<float*>(data[0]);
+        float* scores = static_cast<float*>(data[1]);
+        for (size_t i = 0; i < n; ++i) {
+            boxes[i * 4 + 0] = faces[i].x1;
+            boxes[i * 4 + 1] = faces[i].y1;
+            boxes[i * 4 + 2] = faces[i].x2;
+            boxes[i * 4 + 3] = faces[i].y2;
+            scores[i] = faces[i].confidence;
+        }
+        napi_create_typedarray(env, napi_float32_array, n * 4, buffers[0], 0, &v);
+        napi_set_named_property(env, out, "boxes", v);
+        napi_create_typedarray(env, napi_float32_array, n, buffers[1], 0, &v);
+        napi_set_named_property(env, out, "scores", v);
+        return out;
+    }
+};
+
+napi_value DetectFrame(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value argv[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+    auto* w = new DetectWork();
+    double width = 0;
+    double height = 0;
+    napi_value frame = argc >= 2 ? Property(env, argv[1], "data") : nullptr;
+    uint8_t* data = nullptr;
+    size_t bytes = 0;
+    bool ok = frame != nullptr && TakePipeline(env, w, argv[0]) && NumberProperty(env, argv[1], "width", width) &&
+              NumberProperty(env, argv[1], "height", height) && width >= 1 && height >= 1 &&
+              PixelFormat(env, argv[1], w->format) && BufferBytes(env, frame, data, bytes) && Keep(env, w, frame);
+    if (ok) {
+        w->width = static_cast<int>(width);
+        w->height = static_cast<int>(height);
+        w->pixels = data;
+        ok = bytes >= FrameBytes(w->width, w->height, w->format);
+    }
+    if (!ok) {
+        for (napi_ref ref : w->refs) napi_delete_reference(env, ref);
+        delete w;
+        return Throw(env, "detectFrame expects (pipeline, {width, height, format?, data: buffer of the frame})");
+    }
+    return Queue(env, w, "detectFrame");
+}
+
+napi_value Init(napi_env env, napi_value exports) {
+    const napi_property_descriptor methods[] = {
+        {"createPipeline", nullptr, CreatePipeline, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"trackImages", nullptr, TrackImages, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"trackFrames", nullptr, TrackFrames, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"detectFrame", nullptr, DetectFrame, nullptr, nullptr, nullptr, napi_default, nullptr},
+    };
+    NAPI_CALL(env, napi_define_properties(env, exports, sizeof(methods) / sizeof(methods[0]), methods));
+    return exports;
+}
+
+}  // namespace
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, Init)
@@ -0,0 +1,106 @@
+#include "alloc_stats.hpp"
+
+#include "stage_profile.hpp"
+
+// Tracy builds replace operator new as well, to report every allocation.
+#if FACE_PIPELINE_ALLOC_STATS || FACE_PIPELINE_TRACY
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if FACE_PIPELINE_TRACY
+#include <tracy/Tracy.hpp>
+#endif
+
+namespace {
+constexpr int kSlots = static_cast<int>(ProfileStage::Count) + 1;  // the last is "other"
+// Each block starts with its size, padded to keep the caller's alignment.
+constexpr size_t kHeader = alignof(std::max_align_t);
+
+struct Counters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+};
+Counters g_counters[kSlots];
+std::atomic<size_t> g_heap{0};
+std::atomic<size_t> g_peak{0};
+thread_local int t_stage = kSlots - 1;
+
+void* Allocate(size_t size) {
+    void* block = std::malloc(size + kHeader);
+    if (!block) return nullptr;
+    *static_cast<size_t*>(block) = size;
+    constexpr auto relaxed = std::memory_order_relaxed;
+    Counters& c = g_counters[t_stage];
+    c.allocations.fetch_add(1, relaxed);
+    c.bytes.fetch_add(size, relaxed);
+    const size_t heap = g_heap.fetch_add(size, relaxed) + size;
+    size_t peak = g_peak.load(relaxed);
+    while (heap > peak && !g_peak.compare_exchange_weak(peak, heap, relaxed)) {
+    }
+    void* p = static_cast<char*>(block) + kHeader;
+#if FACE_PIPELINE_TRACY
+    TracyAlloc(p, size);
+#endif
+    return p;
+}
+
+void* AllocateOrThrow(size_t size) {
+    for (;;) {
+        if (void* p = Allocate(size)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void Free(void* p) {
+    if (!p) return;
+#if FACE_PIPELINE_TRACY
+    TracyFree(p);
+#endif
+    char* block = static_cast<char*>(p) - kHeader;
+    g_heap.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+}  // namespace
+
+void* operator new(size_t size) { return AllocateOrThrow(size); }
+void* operator new[](size_t size) { return AllocateOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void operator delete(void* p) noexcept { Free(p); }
+void operator delete[](void* p) noexcept { Free(p); }
+void operator delete(void* p, size_t) noexcept { Free(p); }
+void operator delete[](void* p, size_t) noexcept { Free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { Free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { Free(p); }
+#endif
+
+#if FACE_PIPELINE_ALLOC_STATS
+
+int AllocStats::enter(int stage) {
+    const int previous = t_stage;
+    t_stage = stage >= 0 && stage < kSlots ? stage : kSlots - 1;
+    return previous;
+}
+
+void AllocStats::leave(int previous) { t_stage = previous; }
+
+AllocStats::Counts AllocStats::of(ProfileStage stage) {
+    const int s = static_cast<int>(stage);
+    const Counters& c = g_counters[s >= 0 && s < kSlots ? s : kSlots - 1];
+    return Counts{c.allocations.load(std::memory_order_relaxed), c.bytes.load(std::memory_order_relaxed)};
+}
+
+size_t AllocStats::heapBytes() { return g_heap.load(std::memory_order_relaxed); }
+size_t AllocStats::heapPeak() { return g_peak.load(std::memory_order_relaxed); }
+
+#else
+
+AllocStats::Counts AllocStats::of(ProfileStage) { return Counts{}; }
+size_t AllocStats::heapBytes() { return 0; }
+size_t AllocStats::heapPeak() { return 0; }
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class ProfileStage;
+
+/**
+ * Heap allocations counted by stage, in builds configured with
+ * FACE_PIPELINE_ALLOC_STATS (--memory-report prints them).
+ *
+ * Such builds replace the global operator new and delete: every
+ * allocation is counted against the stage its thread is in (an
+ * AllocStats::Scope, which StageProfile and the pipeline's stage clocks
+ * open), or "other" outside one, and the bytes live on the heap are kept
+ * with their high-water mark. ncnn allocates its blobs with its own
+ * fastMalloc, and aligned operator new is left alone, so neither is
+ * counted. Other builds compile all of it away. FACE_PIPELINE_TRACY builds
+ * use the same replacement to report allocations to Tracy.
+ */
+class AllocStats {
+public:
+#if FACE_PIPELINE_ALLOC_STATS
+    static constexpr bool kEnabled = true;
+#else
+    static constexpr bool kEnabled = false;
+#endif
+
+    /** Counts the calling thread's allocations against `stage` until it ends. */
+    class Scope {
+    public:
+#if FACE_PIPELINE_ALLOC_STATS
+        explicit Scope(ProfileStage stage) : previous_(enter(static_cast<int>(stage))) {}
+        ~Scope() { leave(previous_); }
+#else
+        explicit Scope(ProfileStage) {}
+#endif
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+#if FACE_PIPELINE_ALLOC_STATS
+    private:
+        int previous_;
+#endif
+    };
+
+    struct Counts {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    /** Allocations made in `stage` so far, over every thread (ProfileStage::Count = outside any stage). */
+    static Counts of(ProfileStage stage);
+
+    /** Bytes live on the heap now, and the most that ever were. */
+    static size_t heapBytes();
+    static size_t heapPeak();
+
+private:
+    static int enter(int stage);
+    static void leave(int previous);
+};
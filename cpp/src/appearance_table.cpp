@@ -0,0 +1,40 @@
+#include "appearance_table.hpp"
+
+#include <utility>
+
+void AppearanceTable::put(int id, const EmbeddingF32& v) {
+    if (id < 0 || v.empty()) return;
+    if (static_cast<size_t>(id) >= rows_.size()) rows_.resize(static_cast<size_t>(id) + 1);
+    if (rows_[id].empty()) count_++;
+    rows_[id].assign(v, storage_);
+}
+
+void AppearanceTable::put(int id, PackedEmbedding e) {
+    if (id < 0 || e.empty()) return;
+    if (static_cast<size_t>(id) >= rows_.size()) rows_.resize(static_cast<size_t>(id) + 1);
+    if (rows_[id].empty()) count_++;
+    rows_[id] = std::move(e);
+}
+
+void AppearanceTable::evict(int id) {
+    if (!get(id)) return;
+    rows_[id].release();
+    count_--;
+    evicted_++;
+}
+
+void AppearanceTable::absorb(AppearanceTable& other, int offset) {
+    for (int id = 0; id < other.idLimit(); ++id) {
+        if (!other.rows_[id].empty()) put(id + offset, std::move(other.rows_[id]));
+    }
+    evicted_ += other.evicted_;
+    other.rows_.clear();
+    other.count_ = 0;
+    other.evicted_ = 0;
+}
+
+void AppearanceTable::clear() {
+    rows_.clear();
+    count_ = 0;
+    evicted_ = 0;
+}
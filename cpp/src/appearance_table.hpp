@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "embedding.hpp"
+
+/**
+ * Track appearances for offline linking, one row per track ID.
+ *
+ * Track IDs are dense (0 ... OCSort::tracksStarted() - 1), so the rows sit
+ * in a vector indexed by ID instead of a map. The tracker packs a track's
+ * appearance into its row (EmbeddingStorage) when the track ends, reusing
+ * the row's buffer if it is stored again; linking reads the rows in place
+ * through get(). A row whose track can no longer be linked to anything is
+ * evicted, which frees its payload but keeps the IDs dense.
+ */
+class AppearanceTable {
+public:
+    explicit AppearanceTable(EmbeddingStorage storage = EmbeddingStorage::F32) : storage_(storage) {}
+
+    EmbeddingStorage storage() const { return storage_; }
+    void setStorage(EmbeddingStorage storage) { storage_ = storage; }
+
+    /** Pack `v` as track `id`'s appearance, replacing any it had. */
+    void put(int id, const EmbeddingF32& v);
+
+    /** Store an already packed row (checkpoints). */
+    void put(int id, PackedEmbedding e);
+
+    /** Track `id`'s appearance; null if it has none or it was evicted. */
+    const PackedEmbedding* get(int id) const {
+        if (id < 0 || static_cast<size_t>(id) >= rows_.size() || rows_[id].empty()) return nullptr;
+        return &rows_[id];
+    }
+
+    /** Free track `id`'s row. */
+    void evict(int id);
+
+    /**
+     * Move every row of `other` to its ID + `offset` (tracks of a shot
+     * tracked apart, see FacePipeline::process); `other` is left empty.
+     */
+    void absorb(AppearanceTable& other, int offset);
+
+    void clear();
+
+    /** One past the highest ID with a row slot. */
+    int idLimit() const { return static_cast<int>(rows_.size()); }
+    /** Rows holding an appearance. */
+    size_t count() const { return count_; }
+    size_t evicted() const { return evicted_; }
+
+private:
+    EmbeddingStorage storage_;
+    std::vector<PackedEmbedding> rows_;  // by track ID; empty() = none
+    size_t count_ = 0;
+    size_t evicted_ = 0;
+};
@@ -0,0 +1,266 @@
+#include "autotune.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#include "detection_scheduler.hpp"
+#include "gmc_stage.hpp"
+#include "json_reader.hpp"
+#include "json_writer.hpp"
+#include "prefetcher.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+constexpr double kMinGain = 1.02;  // a change must be this much faster to be kept
+constexpr int kPrefetchDepths[] = {4, 8, 16, 32};
+
+// 1, 2, 4 ... up to `limit`, and `limit` itself.
+std::vector<int> Counts(int limit) {
+    std::vector<int> out;
+    for (int n = 1; n < limit; n *= 2) out.push_back(n);
+    out.push_back(std::max(1, limit));
+    return out;
+}
+
+// `profile`'s settings, all of them, on top of `base`.
+PipelineOptions WithProfile(const PipelineOptions& base, const AutotuneProfile& profile) {
+    PipelineOptions o = base;
+    o.decode_threads = profile.decode_threads;
+    o.detect_workers = profile.detect_workers;
+    o.detector.num_threads = profile.detector_threads;
+    o.gmc_workers = profile.gmc_workers;
+    o.prefetch_depth = profile.prefetch_depth;
+    return o;
+}
+
+bool Field(const Json& object, const char* key, int& value) {
+    const Json* v = object.get(key);
+    if (!v || v->type != Json::Type::Number) return false;
+    value = static_cast<int>(v->number);
+    return true;
+}
+
+void WriteProfile(JsonWriter& w, const AutotuneProfile& p) {
+    w.raw("    {\"machine\": ").string(p.machine);
+    w.raw(", \"decodeThreads\": ").integer(p.decode_threads);
+    w.raw(", \"detectWorkers\": ").integer(p.detect_workers);
+    w.raw(", \"detectorThreads\": ").integer(p.detector_threads);
+    w.raw(", \"gmcWorkers\": ").integer(p.gmc_workers);
+    w.raw(", \"prefetchDepth\": ").integer(p.prefetch_depth);
+    w.raw(", \"framesPerSecond\": ").fixed(p.fps, 2).ch('}');
+}
+
+bool ReadProfiles(const std::string& path, std::vector<AutotuneProfile>& out) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    std::stringstream text;
+    text << file.rdbuf();
+    const std::string json = text.str();
+    Json root;
+    if (!JsonParser(json).parse(root) || root.type != Json::Type::Object) return false;
+    const Json* list = root.get("profiles");
+    if (!list || list->type != Json::Type::Array) return false;
+    for (const Json& entry : list->items) {
+        const Json* machine = entry.get("machine");
+        if (entry.type != Json::Type::Object || !machine || machine->type != Json::Type::String) continue;
+        AutotuneProfile p;
+        p.machine = machine->text;
+        if (!Field(entry, "decodeThreads", p.decode_threads) || !Field(entry, "detectWorkers", p.detect_workers) ||
+            !Field(entry, "detectorThreads", p.detector_threads) || !Field(entry, "gmcWorkers", p.gmc_workers) ||
+            !Field(entry, "prefetchDepth", p.prefetch_depth)) {
+            continue;
+        }
+        const Json* fps = entry.get("framesPerSecond");
+        if (fps && fps->type == Json::Type::Number) p.fps = fps->number;
+        out.push_back(std::move(p));
+    }
+    return true;
+}
+}  // namespace
+
+std::string MachineKey() {
+    std::string model;
+#if defined(__APPLE__)
+    char brand[256] = {};
+    size_t size = sizeof(brand);
+    if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) == 0) model = brand;
+#elif defined(__linux__)
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        // x86 names the model; arm64 only has the implementer and part.
+        if (line.compare(0, 10, "model name") == 0 || line.compare(0, 8, "Hardware") == 0 ||
+            line.compare(0, 8, "CPU part") == 0) {
+            const size_t colon = line.find(':');
+            if (colon != std::string::npos) model = line.substr(line.find_first_not_of(" \t", colon + 1));
+            if (line.compare(0, 10, "model name") == 0) break;
+        }
+    }
+#endif
+    if (model.empty()) model = "unknown CPU";
+    return model + " x" + std::to_string(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+std::string DefaultAutotunePath() {
+    const char* xdg = std::getenv("XDG_CONFIG_HOME");
+    if (xdg && *xdg) return std::string(xdg) + "/face_pipeline_autotune.json";
+    const char* home = std::getenv("HOME");
+    if (home && *home) return std::string(home) + "/.config/face_pipeline_autotune.json";
+    return std::string();
+}
+
+bool RunAutotune(const PipelineOptions& base, const AutotuneOptions& options, const AutotuneMeasure& measure,
+                 AutotuneProfile& out) {
+    const int cores = options.cores > 0 ? options.cores : PipelineCoreCount();
+    // Start from what the automatic counts would pick on `cores`.
+    AutotuneProfile best;
+    best.machine = MachineKey();
+    best.decode_threads = std::min(cores, FramePrefetcher::ResolveThreadCount(base.decode_threads));
+    best.detect_workers = std::min(cores, DetectionScheduler::ResolveWorkerCount(base.detect_workers));
+    best.detector_threads = base.detector.num_threads > 0 ? base.detector.num_threads
+                                                          : std::max(1, cores / best.detect_workers);
+    best.gmc_workers = std::min(cores, GmcStage::ResolveWorkerCount(base.gmc_workers));
+    best.prefetch_depth = base.prefetch_depth;
+
+    const bool fixed_decode = base.decode_threads > 0;
+    const bool fixed_workers = base.detect_workers > 0;
+    const bool fixed_threads = base.detector.num_threads > 0;
+    const bool fixed_gmc = base.gmc_workers > 0;
+
+    auto run = [&](const AutotuneProfile& p) {
+        const double fps = measure(WithProfile(base, p));
+        fprintf(stderr, "Autotune: decode %d, detect %d x %d, gmc %d, prefetch %d: %.2f fps\n", p.decode_threads,
+                p.detect_workers, p.detector_threads, p.gmc_workers, p.prefetch_depth, fps);
+        return fps;
+    };
+    // Models, page cache and allocators warm up on the first run.
+    if (measure(WithProfile(base, best)) <= 0.0) return false;
+    best.fps = run(best);
+    if (best.fps <= 0.0) return false;
+
+    auto consider = [&](AutotuneProfile candidate) {
+        if (candidate.detect_workers * candidate.detector_threads > cores) return false;
+        candidate.fps = run(candidate);
+        if (candidate.fps < best.fps * kMinGain) return false;
+        best = candidate;
+        return true;
+    };
+    for (int round = 0; round < std::max(1, options.rounds); ++round) {
+        bool changed = false;
+        if (!fixed_workers) {
+            for (const int w : Counts(cores)) {
+                if (w == best.detect_workers) continue;
+                AutotuneProfile c = best;
+                c.detect_workers = w;
+                if (!fixed_threads) c.detector_threads = std::max(1, cores / w);
+                changed |= consider(c);
+            }
+        }
+        if (!fixed_threads) {
+            for (const int t : Counts(std::max(1, cores / best.detect_workers))) {
+                if (t == best.detector_threads) continue;
+                AutotuneProfile c = best;
+                c.detector_threads = t;
+                changed |= consider(c);
+            }
+        }
+        if (!fixed_decode) {
+            for (const int d : Counts(cores)) {
+                if (d == best.decode_threads) continue;
+                AutotuneProfile c = best;
+                c.decode_threads = d;
+                changed |= consider(c);
+            }
+        }
+        if (!fixed_gmc) {
+            for (const int g : Counts(cores)) {
+                if (g == best.gmc_workers) continue;
+                AutotuneProfile c = best;
+                c.gmc_workers = g;
+                changed |= consider(c);
+            }
+        }
+        if (!options.prefetch_fixed) {
+            for (const int depth : kPrefetchDepths) {
+                if (depth == best.prefetch_depth) continue;
+                AutotuneProfile c = best;
+                c.prefetch_depth = depth;
+                changed |= consider(c);
+            }
+        }
+        if (!changed) break;
+    }
+    out = best;
+    return true;
+}
+
+bool LoadAutotuneProfile(const std::string& path, const std::string& machine, AutotuneProfile& out) {
+    std::vector<AutotuneProfile> profiles;
+    if (path.empty() || !ReadProfiles(path, profiles)) return false;
+    for (const AutotuneProfile& p : profiles) {
+        if (p.machine == machine) {
+            out = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SaveAutotuneProfile(const std::string& path, const AutotuneProfile& profile, std::string& error) {
+    if (path.empty()) {
+        error = "no profile path (set HOME or XDG_CONFIG_HOME, or pass --autotune-profile)";
+        return false;
+    }
+    std::vector<AutotuneProfile> profiles;
+    ReadProfiles(path, profiles);
+    profiles.erase(std::remove_if(profiles.begin(), profiles.end(),
+                                  [&](const AutotuneProfile& p) { return p.machine == profile.machine; }),
+                   profiles.end());
+    profiles.push_back(profile);
+
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "w");
+    if (!f) {
+        error = "cannot create " + tmp;
+        return false;
+    }
+    bool ok = true;
+    {
+        JsonWriter w(f);
+        w.raw("{\"profiles\": [\n");
+        for (size_t i = 0; i < profiles.size(); ++i) {
+            WriteProfile(w, profiles[i]);
+            w.raw(i + 1 < profiles.size() ? ",\n" : "\n");
+        }
+        w.raw("]}\n");
+        ok = w.flush();
+    }
+    ok = (std::fclose(f) == 0) && ok;
+    if (ok) {
+        std::remove(path.c_str());  // rename does not replace on Windows
+        ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        std::remove(tmp.c_str());
+        error = "cannot write " + path;
+    }
+    return ok;
+}
+
+void ApplyAutotuneProfile(const AutotuneProfile& profile, bool prefetch_fixed, PipelineOptions& options) {
+    if (options.decode_threads <= 0) options.decode_threads = profile.decode_threads;
+    if (options.detect_workers <= 0) options.detect_workers = profile.detect_workers;
+    if (options.detector.num_threads <= 0) options.detector.num_threads = profile.detector_threads;
+    if (options.gmc_workers <= 0) options.gmc_workers = profile.gmc_workers;
+    if (!prefetch_fixed && profile.prefetch_depth > 0) options.prefetch_depth = profile.prefetch_depth;
+}
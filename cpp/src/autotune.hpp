@@ -0,0 +1,86 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "pipeline.hpp"
+
+/**
+ * Per-machine stage thread counts (--autotune).
+ *
+ * The automatic counts come from the core count alone (half the cores as
+ * detection workers, ncnn threads splitting the rest), which suits neither
+ * an 8-core laptop with 4 efficiency cores nor a 32-core workstation whose
+ * detector saturates long before its threads run out. The autotuner runs
+ * the pipeline over a short sample sequence and searches the settings that
+ * only change how fast a run goes, never its tracks: decoder threads,
+ * detection workers and their ncnn threads, GMC workers and the prefetch
+ * depth. It goes one setting at a time (coordinate ascent), keeping a
+ * change that is at least 2% faster, within a core budget, until a pass
+ * changes nothing.
+ *
+ * The result is saved to a profile file keyed by the machine (CPU model and
+ * hardware threads), so one file can serve a shared home directory. Later
+ * runs load the entry for their machine and use it wherever the command
+ * line leaves a setting on auto.
+ */
+struct AutotuneProfile {
+    std::string machine;     // MachineKey() it was measured on
+    int decode_threads = 0;  // PipelineOptions::decode_threads
+    int detect_workers = 0;  // PipelineOptions::detect_workers
+    int detector_threads = 0;  // ncnn threads per detection worker (DetectorOptions::num_threads)
+    int gmc_workers = 0;     // PipelineOptions::gmc_workers
+    int prefetch_depth = 8;  // PipelineOptions::prefetch_depth
+    double fps = 0.0;        // sample throughput with these settings
+};
+
+struct AutotuneOptions {
+    int cores = 0;    // core budget: no stage gets more threads (0 = PipelineCoreCount())
+    int rounds = 3;   // passes over the settings at most
+    bool prefetch_fixed = false;  // the command line set --prefetch: keep it
+};
+
+/**
+ * Frames per second of one run with `options`; <= 0 if it failed.
+ */
+using AutotuneMeasure = std::function<double(const PipelineOptions& options)>;
+
+/**
+ * CPU model and hardware thread count, e.g. "Apple M2 x8".
+ */
+std::string MachineKey();
+
+/**
+ * $XDG_CONFIG_HOME/face_pipeline_autotune.json, or ~/.config/...; empty if
+ * neither is set.
+ */
+std::string DefaultAutotunePath();
+
+/**
+ * Search from `base`: settings it already fixes (non-zero thread and
+ * worker counts) are kept, the others are tuned. One warm-up run comes
+ * first. Progress goes to stderr.
+ *
+ * @return false if no run succeeded
+ */
+bool RunAutotune(const PipelineOptions& base, const AutotuneOptions& options, const AutotuneMeasure& measure,
+                 AutotuneProfile& out);
+
+/**
+ * The entry for `machine` in the profile file at `path`.
+ *
+ * @return false if the file or the entry is missing or malformed
+ */
+bool LoadAutotuneProfile(const std::string& path, const std::string& machine, AutotuneProfile& out);
+
+/**
+ * Save `profile` into the file at `path`, replacing the entry of its
+ * machine and keeping the others.
+ */
+bool SaveAutotuneProfile(const std::string& path, const AutotuneProfile& profile, std::string& error);
+
+/**
+ * Use `profile` for the settings `options` leaves on auto (and the prefetch
+ * depth unless `prefetch_fixed`).
+ */
+void ApplyAutotuneProfile(const AutotuneProfile& profile, bool prefetch_fixed, PipelineOptions& options);
@@ -0,0 +1,209 @@
+#include "blur_render.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "simd_kernels.hpp"
+#include "stb_image_write.h"
+#include "thread_pool.hpp"
+
+namespace {
+constexpr int kBoxPasses = 3;
+
+bool MakeDir(const std::string& path) {
+#ifdef _WIN32
+    if (_mkdir(path.c_str()) == 0) return true;
+    struct _stat64 st;
+    return _stat64(path.c_str(), &st) == 0 && (st.st_mode & _S_IFDIR);
+#else
+    if (::mkdir(path.c_str(), 0755) == 0) return true;
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+// Box radius whose three passes have the variance of a Gaussian reaching
+// `blurriness` pixels (sigma = blurriness / 3): r (r + 1) = sigma^2.
+int BoxRadius(float blurriness) {
+    if (!(blurriness > 0.0f)) return 0;
+    const double sigma = blurriness / 3.0;
+    const int r = static_cast<int>(std::lround((std::sqrt(1.0 + 4.0 * sigma * sigma) - 1.0) / 2.0));
+    return std::max(1, std::min(kBoxBlurMaxRadius, r));
+}
+
+// Interleaved RGB `src` (w x h) into `dst` as h x w: pixel (x, y) goes to row x.
+void TransposeRgb(const uint8_t* src, int w, int h, uint8_t* dst) {
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* row = src + static_cast<size_t>(y) * w * 3;
+        for (int x = 0; x < w; ++x) {
+            uint8_t* p = dst + (static_cast<size_t>(x) * h + y) * 3;
+            p[0] = row[x * 3];
+            p[1] = row[x * 3 + 1];
+            p[2] = row[x * 3 + 2];
+        }
+    }
+}
+
+// Mask coverage (0-256) of pixel `i` along one axis of a mask spanning
+// [lo, hi], its edges ramped over `feather` pixels.
+uint16_t Coverage(int i, float lo, float hi, float feather) {
+    const float c = static_cast<float>(i) + 0.5f;
+    const float inside = std::min(c - lo, hi - c);
+    float a = feather > 0.0f ? inside / feather + 0.5f : (inside >= 0.0f ? 1.0f : 0.0f);
+    a = std::max(0.0f, std::min(1.0f, a));
+    return static_cast<uint16_t>(std::lround(a * 256.0f));
+}
+
+struct Scratch {
+    std::vector<uint8_t> a, b;  // blur ping-pong, row-major ROI
+    std::vector<uint8_t> t, u;  // the same, transposed
+    std::vector<uint16_t> ax, ay;
+    std::vector<uint8_t> pixels;  // a writable copy of borrowed frames
+    LoadedRgbFrame frame;
+};
+
+// Blur `box` (normalized) into the w x h RGB image `rgb`.
+void BlurBox(uint8_t* rgb, int w, int h, const BBox& box, int radius, const BlurRenderOptions& options,
+             Scratch& s) {
+    const float feather = std::max(0.0f, options.feather);
+    const float mx1 = box.x1 * w - options.expansion;
+    const float mx2 = box.x2 * w + options.expansion;
+    const float my1 = box.y1 * h - options.expansion;
+    const float my2 = box.y2 * h + options.expansion;
+    if (!(mx2 > mx1) || !(my2 > my1)) return;
+    // Pixels the mask covers at all, then those the blur reads from.
+    const int ox1 = std::max(0, static_cast<int>(std::floor(mx1 - feather / 2.0f)));
+    const int ox2 = std::min(w, static_cast<int>(std::ceil(mx2 + feather / 2.0f)));
+    const int oy1 = std::max(0, static_cast<int>(std::floor(my1 - feather / 2.0f)));
+    const int oy2 = std::min(h, static_cast<int>(std::ceil(my2 + feather / 2.0f)));
+    if (ox2 <= ox1 || oy2 <= oy1) return;
+    const int reach = kBoxPasses * radius;
+    const int rx1 = std::max(0, ox1 - reach);
+    const int rx2 = std::min(w, ox2 + reach);
+    const int ry1 = std::max(0, oy1 - reach);
+    const int ry2 = std::min(h, oy2 + reach);
+    const int rw = rx2 - rx1;
+    const int rh = ry2 - ry1;
+    const size_t stride = static_cast<size_t>(rw) * 3;
+    const size_t tstride = static_cast<size_t>(rh) * 3;
+
+    s.a.resize(stride * rh);
+    s.b.resize(stride * rh);
+    s.t.resize(s.a.size());
+    s.u.resize(s.a.size());
+    for (int y = 0; y < rh; ++y) {
+        std::copy_n(rgb + (static_cast<size_t>(ry1 + y) * w + rx1) * 3, stride, s.a.data() + y * stride);
+    }
+    // Vertical passes (a -> b -> a -> b), then horizontal ones on the
+    // transpose (t -> u -> t -> u); the result goes back into a.
+    for (int p = 0; p < kBoxPasses; ++p) {
+        const bool even = p % 2 == 0;
+        BoxBlurColumnsU8(even ? s.a.data() : s.b.data(), stride, even ? s.b.data() : s.a.data(), stride,
+                         static_cast<int>(stride), rh, radius);
+    }
+    TransposeRgb(s.b.data(), rw, rh, s.t.data());
+    for (int p = 0; p < kBoxPasses; ++p) {
+        const bool even = p % 2 == 0;
+        BoxBlurColumnsU8(even ? s.t.data() : s.u.data(), tstride, even ? s.u.data() : s.t.data(), tstride,
+                         static_cast<int>(tstride), rw, radius);
+    }
+    TransposeRgb(s.u.data(), rh, rw, s.a.data());
+
+    s.ax.resize(static_cast<size_t>(ox2 - ox1));
+    s.ay.resize(static_cast<size_t>(oy2 - oy1));
+    for (int x = ox1; x < ox2; ++x) s.ax[x - ox1] = Coverage(x, mx1, mx2, feather);
+    for (int y = oy1; y < oy2; ++y) s.ay[y - oy1] = Coverage(y, my1, my2, feather);
+    for (int y = oy1; y < oy2; ++y) {
+        const uint32_t ay = s.ay[y - oy1];
+        if (ay == 0) continue;
+        uint8_t* out = rgb + static_cast<size_t>(y) * w * 3;
+        const uint8_t* blurred = s.a.data() + static_cast<size_t>(y - ry1) * stride - static_cast<size_t>(rx1) * 3;
+        for (int x = ox1; x < ox2; ++x) {
+            const uint32_t a = (s.ax[x - ox1] * ay + 128) >> 8;
+            for (int c = x * 3; c < x * 3 + 3; ++c) {
+                out[c] = static_cast<uint8_t>((out[c] * (256 - a) + blurred[c] * a + 128) >> 8);
+            }
+        }
+    }
+}
+}  // namespace
+
+bool RenderBlurredFrames(FrameSource& source, const PipelineResult& result, int first, int end,
+                         const BlurRenderOptions& options, int& written, std::string& error) {
+    written = 0;
+    if (!source.randomAccess()) {
+        error = "--render-blur needs input that can be read again in any order";
+        return false;
+    }
+    if (!MakeDir(options.dir)) {
+        error = "cannot create " + options.dir;
+        return false;
+    }
+    first = std::max(0, first);
+    if (source.frameCount() >= 0) end = std::min(end, source.frameCount());
+    if (end <= first) return true;
+
+    std::vector<std::vector<BBox>> boxes(static_cast<size_t>(end - first));
+    for (const FaceTrack& track : result.tracks) {
+        for (const TrackFrame& f : track.frames) {
+            if (f.frame_index >= first && f.frame_index < end) boxes[f.frame_index - first].push_back(f.bbox);
+        }
+    }
+    const int radius = BoxRadius(options.blurriness);
+    const int quality = std::max(1, std::min(100, options.jpeg_quality));
+
+    std::atomic<int> done{0};
+    std::atomic<bool> failed{false};
+    std::mutex error_mu;
+    auto fail = [&](const std::string& message) {
+        std::lock_guard<std::mutex> lock(error_mu);
+        if (!failed.exchange(true)) error = message;
+    };
+    ThreadPool::Shared().parallelFor(end - first, PipelineCoreCount(), [&](int k) {
+        if (failed.load()) return;
+        thread_local Scratch s;
+        const int index = first + k;
+        FrameRequest req;
+        s.frame.clear();
+        if (!source.read(index, req, s.frame) || !s.frame.hasRgb()) {
+            fail("cannot read frame " + std::to_string(index));
+            return;
+        }
+        const int w = s.frame.rgb_w;
+        const int h = s.frame.rgb_h;
+        uint8_t* rgb;
+        if (s.frame.rgb_view == nullptr) {
+            rgb = s.frame.rgb.data();
+        } else {
+            s.pixels.assign(s.frame.rgb_view, s.frame.rgb_view + static_cast<size_t>(w) * h * 3);
+            rgb = s.pixels.data();
+        }
+        if (radius > 0) {
+            for (const BBox& box : boxes[k]) BlurBox(rgb, w, h, box, radius, options, s);
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), options.png ? "/%06d.png" : "/%06d.jpg", index);
+        const std::string path = options.dir + name;
+        const int ok = options.png ? stbi_write_png(path.c_str(), w, h, 3, rgb, w * 3)
+                                   : stbi_write_jpg(path.c_str(), w, h, 3, rgb, quality);
+        if (ok == 0) {
+            fail("cannot write " + path);
+            return;
+        }
+        done.fetch_add(1);
+    });
+    written = done.load();
+    return !failed.load();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include "frame_source.hpp"
+#include "pipeline.hpp"
+
+/**
+ * Baked blur of the tracked faces (--render-blur): review copies straight
+ * from the decoded frames, without the MOGRT masks and Premiere's render.
+ *
+ * Each track box becomes the panel's rectangular mask: grown by
+ * `expansion` pixels, with its edges ramped over `feather` pixels centred
+ * on them. Inside it the frame is replaced by a Gaussian-like blur (three
+ * box passes each way, BoxBlurColumnsU8()) computed only around the mask,
+ * where the blur reads from. Overlapping faces are blurred one after the
+ * other. Every frame of the range is written, with faces or not, as
+ * <dir>/<input frame index, 6 digits>.jpg (or .png).
+ */
+struct BlurRenderOptions {
+    std::string dir;           // output directory (created if missing); empty = no render
+    float blurriness = 50.0f;  // the panel's Blurriness: the blur's reach in pixels, about 3 sigma
+    float feather = 10.0f;     // mask edge softness in pixels
+    float expansion = 0.0f;    // pixels the mask grows past the box (negative shrinks it)
+    bool png = false;          // PNG instead of JPEG
+    int jpeg_quality = 90;     // 1-100
+};
+
+/**
+ * Render frames [first, end) of `source` with `result`'s tracks blurred
+ * in. Frames are read again, on up to PipelineCoreCount() threads, so the
+ * source must allow random access.
+ *
+ * @param written Frames written
+ * @return false (with `error`) if the directory cannot be created or a
+ *         frame cannot be read or written
+ */
+bool RenderBlurredFrames(FrameSource& source, const PipelineResult& result, int first, int end,
+                         const BlurRenderOptions& options, int& written, std::string& error);
@@ -0,0 +1,157 @@
+#include "box_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Grid resolution limit per axis; finer grids only cost memory.
+constexpr int kMaxCells = 64;
+
+bool Binnable(const BBox& b) {
+    return std::isfinite(b.x1) && std::isfinite(b.y1) && std::isfinite(b.x2) && std::isfinite(b.y2) &&
+           b.x2 >= b.x1 && b.y2 >= b.y1;
+}
+
+// Clamped in float first, so far-away corners cannot overflow the cast.
+int Cell(float v, float origin, float inv_cell, int n) {
+    const float c = std::floor((v - origin) * inv_cell);
+    return static_cast<int>(std::max(0.0f, std::min(static_cast<float>(n - 1), c)));
+}
+}  // namespace
+
+bool BoxGrid::cellSpan(const BBox& b, int& cx0, int& cy0, int& cx1, int& cy1) const {
+    if (cols_ == 0 || !Binnable(b)) return false;
+    cx0 = Cell(b.x1, x0_, inv_cell_, cols_);
+    cy0 = Cell(b.y1, y0_, inv_cell_, rows_);
+    cx1 = Cell(b.x2, x0_, inv_cell_, cols_);
+    cy1 = Cell(b.y2, y0_, inv_cell_, rows_);
+    return true;
+}
+
+void BoxGrid::build(const std::vector<BBox>& boxes) {
+    cols_ = rows_ = 0;
+    items_.clear();
+    seen_.assign(boxes.size(), 0);
+    stamp_ = 0;
+
+    float x0 = 0.0f, y0 = 0.0f, x1 = 0.0f, y1 = 0.0f;
+    sides_.clear();
+    for (const BBox& b : boxes) {
+        if (!Binnable(b)) continue;
+        if (sides_.empty()) {
+            x0 = b.x1, y0 = b.y1, x1 = b.x2, y1 = b.y2;
+        }
+        x0 = std::min(x0, b.x1);
+        y0 = std::min(y0, b.y1);
+        x1 = std::max(x1, b.x2);
+        y1 = std::max(y1, b.y2);
+        sides_.push_back(std::max(b.width(), b.height()));
+    }
+    if (sides_.empty()) return;
+
+    const size_t mid = sides_.size() / 2;
+    std::nth_element(sides_.begin(), sides_.begin() + static_cast<std::ptrdiff_t>(mid), sides_.end());
+    const float extent = std::max(x1 - x0, y1 - y0);
+    const float cell = std::max({sides_[mid], extent / kMaxCells, 1e-6f});
+    x0_ = x0;
+    y0_ = y0;
+    inv_cell_ = 1.0f / cell;
+    cols_ = std::max(1, std::min(kMaxCells, static_cast<int>((x1 - x0) / cell) + 1));
+    rows_ = std::max(1, std::min(kMaxCells, static_cast<int>((y1 - y0) / cell) + 1));
+
+    // Counting sort of (cell, box) entries into compressed rows.
+    cell_begin_.assign(static_cast<size_t>(cols_) * static_cast<size_t>(rows_) + 1, 0);
+    int cx0, cy0, cx1, cy1;
+    for (const BBox& b : boxes) {
+        if (!cellSpan(b, cx0, cy0, cx1, cy1)) continue;
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) cell_begin_[static_cast<size_t>(cy) * cols_ + cx + 1]++;
+        }
+    }
+    for (size_t c = 1; c < cell_begin_.size(); ++c) cell_begin_[c] += cell_begin_[c - 1];
+    items_.resize(static_cast<size_t>(cell_begin_.back()));
+    cursor_.assign(cell_begin_.begin(), cell_begin_.end() - 1);
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (!cellSpan(boxes[i], cx0, cy0, cx1, cy1)) continue;
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                items_[static_cast<size_t>(cursor_[static_cast<size_t>(cy) * cols_ + cx]++)] = static_cast<int>(i);
+            }
+        }
+    }
+}
+
+const std::vector<int>& BoxGrid::query(const BBox& query) {
+    std::vector<int>& out = result_;
+    out.clear();
+    int cx0, cy0, cx1, cy1;
+    if (!cellSpan(query, cx0, cy0, cx1, cy1)) return out;
+    ++stamp_;
+    for (int cy = cy0; cy <= cy1; ++cy) {
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            const size_t c = static_cast<size_t>(cy) * cols_ + cx;
+            for (int k = cell_begin_[c]; k < cell_begin_[c + 1]; ++k) {
+                const int i = items_[static_cast<size_t>(k)];
+                if (seen_[static_cast<size_t>(i)] == stamp_) continue;
+                seen_[static_cast<size_t>(i)] = stamp_;
+                out.push_back(i);
+            }
+        }
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+float MotionGate::logArea(const BBox& b) {
+    return std::log(std::max(b.width(), 1e-6f) * std::max(b.height(), 1e-6f));
+}
+
+void FindOverlapPairs(const std::vector<BBox>& queries,
+                      const std::vector<BBox>& boxes,
+                      float min_iou,
+                      BoxGrid& grid,
+                      OverlapPairs& out,
+                      const MotionGate* gate) {
+    out.begin.assign(1, 0);
+    out.box.clear();
+    out.iou.clear();
+    out.gated = 0;
+    const bool overlap = min_iou > 0.0f;
+    if (overlap) grid.build(boxes);
+
+    float qx = 0.0f, qy = 0.0f, qs = 0.0f;
+    auto admits = [&](size_t b) {
+        if (!gate) return true;
+        const float dx = qx - gate->cx[b];
+        const float dy = qy - gate->cy[b];
+        const float ds = qs - gate->log_area[b];
+        if (dx * dx * gate->inv_var_x[b] + dy * dy * gate->inv_var_y[b] + ds * ds * gate->inv_var_s[b] <= gate->chi2) {
+            return true;
+        }
+        out.gated++;
+        return false;
+    };
+    for (const BBox& q : queries) {
+        if (gate) {
+            qx = q.centerX();
+            qy = q.centerY();
+            qs = MotionGate::logArea(q);
+        }
+        if (overlap) {
+            for (int b : grid.query(q)) {
+                if (!admits(static_cast<size_t>(b))) continue;
+                const float iou = q.iou(boxes[static_cast<size_t>(b)]);
+                if (iou < min_iou) continue;
+                out.box.push_back(b);
+                out.iou.push_back(iou);
+            }
+        } else {
+            for (size_t b = 0; b < boxes.size(); ++b) {
+                if (!admits(b)) continue;
+                out.box.push_back(static_cast<int>(b));
+                out.iou.push_back(q.iou(boxes[b]));
+            }
+        }
+        out.begin.push_back(static_cast<int>(out.box.size()));
+    }
+}
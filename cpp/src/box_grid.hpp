@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "kalman_filter.hpp"
+
+/**
+ * Uniform grid over a set of boxes, for finding the ones a query box may
+ * overlap without testing every box.
+ *
+ * A box is binned in every cell its corners span; cells are about the size
+ * of the median box, capped per axis. Two boxes that overlap always share
+ * a cell (binning is monotonic and out-of-range corners clamp to the edge
+ * cells), so a query returns a superset of the overlapping boxes. Boxes
+ * with a non-finite or inverted corner overlap nothing and are left out.
+ *
+ * The storage is kept between builds, so a per-frame rebuild does not
+ * allocate once the grid has seen the largest frame.
+ */
+class BoxGrid {
+public:
+    void build(const std::vector<BBox>& boxes);
+
+    /**
+     * Indices of the boxes `query` may overlap, ascending. The list is
+     * owned by the grid and valid until the next query() or build().
+     */
+    const std::vector<int>& query(const BBox& query);
+
+private:
+    bool cellSpan(const BBox& b, int& cx0, int& cy0, int& cx1, int& cy1) const;
+
+    float x0_ = 0.0f, y0_ = 0.0f, inv_cell_ = 1.0f;
+    int cols_ = 0, rows_ = 0;
+    std::vector<int> cell_begin_;  // box indices of cell c: items_[cell_begin_[c], cell_begin_[c + 1])
+    std::vector<int> items_;
+    std::vector<int> cursor_;      // per-cell write position while building
+    std::vector<uint32_t> seen_;   // per box: last query stamp, so multi-cell boxes are listed once
+    uint32_t stamp_ = 0;
+    std::vector<float> sides_;
+    std::vector<int> result_;
+};
+
+/**
+ * Pairs (query, box) whose IoU is at least `min_iou`, grouped by query in
+ * compressed rows: the pairs of query q are [begin[q], begin[q + 1]), with
+ * box indices ascending. Pairs not listed fall below `min_iou` or outside
+ * the MotionGate.
+ */
+struct OverlapPairs {
+    std::vector<int> begin;
+    std::vector<int> box;
+    std::vector<float> iou;
+    int gated = 0;  // candidates the MotionGate dropped before their IoU
+
+    /** Position of pair (q, b) in `box` / `iou`, or -1 if it is not listed. */
+    int find(int q, int b) const {
+        for (int k = begin[q]; k < begin[q + 1]; ++k) {
+            if (box[k] == b) return k;
+        }
+        return -1;
+    }
+};
+
+/**
+ * Per-box gate on where a query may be (OCSort::setMotionGate): query q
+ * can pair with box b only if the squared distance of q's center and log
+ * area from b's, weighted by b's inverse variances, is at most `chi2`.
+ */
+struct MotionGate {
+    float chi2 = 0.0f;
+    std::vector<float> cx, cy, log_area;  // per box
+    std::vector<float> inv_var_x, inv_var_y, inv_var_s;
+
+    /** log(width * height) of a box, as the gate compares it. */
+    static float logArea(const BBox& b);
+};
+
+/**
+ * Collect the pairs of `queries` x `boxes` with IoU >= min_iou. A positive
+ * threshold needs an actual overlap, so only the grid's candidates are
+ * scored; with min_iou <= 0 every pair qualifies and all are listed. With
+ * `gate`, a candidate outside it is dropped before its IoU is computed.
+ */
+void FindOverlapPairs(const std::vector<BBox>& queries,
+                      const std::vector<BBox>& boxes,
+                      float min_iou,
+                      BoxGrid& grid,
+                      OverlapPairs& out,
+                      const MotionGate* gate = nullptr);
@@ -0,0 +1,288 @@
+#include "calibration.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "reid.hpp"
+#include "stb_image_write.h"
+
+namespace {
+// Detections of the two models are the same face above this overlap.
+constexpr float kMatchIou = 0.5f;
+
+bool MakeDir(const std::string& path) {
+#ifdef _WIN32
+    if (_mkdir(path.c_str()) == 0) return true;
+    struct _stat64 st;
+    return _stat64(path.c_str(), &st) == 0 && (st.st_mode & _S_IFDIR);
+#else
+    if (::mkdir(path.c_str(), 0755) == 0) return true;
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+// Up to `max_frames` indices spread evenly over a sequence of `count` frames.
+std::vector<int> SampleFrames(int count, int max_frames) {
+    const int n = std::min(count, std::max(1, max_frames));
+    std::vector<int> indices;
+    indices.reserve(static_cast<size_t>(std::max(0, n)));
+    for (int i = 0; i < n; ++i) {
+        indices.push_back(static_cast<int>(static_cast<int64_t>(i) * count / n));
+    }
+    return indices;
+}
+
+float BoxIou(const std::array<float, 4>& a, const std::array<float, 4>& b) {
+    const float inter_w = std::max(0.0f, std::min(a[2], b[2]) - std::max(a[0], b[0]));
+    const float inter_h = std::max(0.0f, std::min(a[3], b[3]) - std::max(a[1], b[1]));
+    const float inter = inter_w * inter_h;
+    const float area_a = (a[2] - a[0]) * (a[3] - a[1]);
+    const float area_b = (b[2] - b[0]) * (b[3] - b[1]);
+    return inter / (area_a + area_b - inter + 1e-6f);
+}
+
+BBox ToBBox(const ScrfdFace& face) {
+    return BBox{face.bbox[0], face.bbox[1], face.bbox[2], face.bbox[3]};
+}
+
+// Loads the frames of a sequence one by one into the same buffers.
+class SequenceReader {
+public:
+    explicit SequenceReader(FrameSource& source) : source_(source) {}
+
+    bool read(int index, std::string& error) {
+        FrameRequest req;
+        frame_.clear();
+        if (!source_.read(index, req, frame_) || !frame_.hasRgb()) {
+            error = "failed to read frame " + std::to_string(index);
+            return false;
+        }
+        return true;
+    }
+
+    const LoadedRgbFrame& frame() const { return frame_; }
+
+private:
+    FrameSource& source_;
+    LoadedRgbFrame frame_;
+};
+
+std::unique_ptr<MobileFaceNetReid> LoadReid(const std::string& stem, std::string& error) {
+    auto reid = std::make_unique<MobileFaceNetReid>(stem + ".param", stem + ".bin");
+    if (!reid->IsLoaded()) {
+        error = "failed to load " + stem + ".param";
+        return nullptr;
+    }
+    reid->SetConfig(ReidConfigFromEnv());
+    return reid;
+}
+
+bool CheckSequence(FrameSource& source, std::string& error) {
+    if (source.frameCount() <= 0) {
+        error = "calibration needs an image sequence of known length";
+        return false;
+    }
+    return true;
+}
+}  // namespace
+
+bool ExportCalibrationSet(FrameSource& source,
+                          const std::string& model_dir,
+                          const std::string& reid_model_dir,
+                          const std::string& out_dir,
+                          const CalibrationOptions& options,
+                          std::string& error) {
+    if (!CheckSequence(source, error)) return false;
+
+    ScrfdDetector detector(model_dir + "/scrfd.param", model_dir + "/scrfd.bin",
+                           640, 640, 0.5f, 0.4f, options.detector);
+    if (!detector.IsLoaded()) {
+        error = "failed to load " + model_dir + "/scrfd.param";
+        return false;
+    }
+    std::unique_ptr<MobileFaceNetReid> reid;
+    if (!reid_model_dir.empty()) {
+        const std::string stem = FindModelStem(reid_model_dir, {"mobilefacenet-opt", "mobilefacenet"});
+        if (stem.empty()) {
+            error = "no mobilefacenet model in " + reid_model_dir;
+            return false;
+        }
+        reid = LoadReid(stem, error);
+        if (!reid) return false;
+    }
+
+    const std::string scrfd_dir = out_dir + "/scrfd";
+    const std::string reid_dir = out_dir + "/reid";
+    if (!MakeDir(out_dir) || !MakeDir(scrfd_dir) || (reid && !MakeDir(reid_dir))) {
+        error = "cannot create " + out_dir;
+        return false;
+    }
+    std::ofstream scrfd_list(out_dir + "/scrfd.txt");
+    std::ofstream reid_list;
+    if (reid) reid_list.open(out_dir + "/reid.txt");
+    if (!scrfd_list || (reid && !reid_list)) {
+        error = "cannot write the sample lists in " + out_dir;
+        return false;
+    }
+
+    SequenceReader reader(source);
+    std::vector<unsigned char> input;
+    std::vector<unsigned char> crop;
+    for (int index : SampleFrames(source.frameCount(), options.max_frames)) {
+        if (!reader.read(index, error)) return false;
+        const LoadedRgbFrame& frame = reader.frame();
+        const unsigned char* rgb = frame.rgbData();
+
+        // The detector input exactly as DetectRegion() builds it, before
+        // normalization: resized to the top-left corner, black padding.
+        int new_w = 0, new_h = 0, pad_w = 0, pad_h = 0;
+        detector.InputShape(frame.w, frame.h, new_w, new_h, pad_w, pad_h);
+        input.assign(static_cast<size_t>(pad_w) * static_cast<size_t>(pad_h) * 3u, 0);
+        ncnn::resize_bilinear_c3(rgb, frame.w, frame.h, frame.w * 3,
+                                 input.data(), new_w, new_h, pad_w * 3);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%06d.png", index);
+        const std::string input_path = scrfd_dir + "/" + name;
+        if (!stbi_write_png(input_path.c_str(), pad_w, pad_h, 3, input.data(), pad_w * 3)) {
+            error = "cannot write " + input_path;
+            return false;
+        }
+        scrfd_list << input_path << "\n";
+
+        if (!reid) continue;
+        const std::vector<ScrfdFace> faces = detector.Detect(rgb, frame.w, frame.h);
+        for (size_t k = 0; k < faces.size(); ++k) {
+            reid->MakeCrop(rgb, frame.w, frame.h, ToBBox(faces[k]), &faces[k].landmarks, crop);
+            snprintf(name, sizeof(name), "%06d_%zu.png", index, k);
+            const std::string crop_path = reid_dir + "/" + name;
+            if (!stbi_write_png(crop_path.c_str(), 112, 112, 3, crop.data(), 112 * 3)) {
+                error = "cannot write " + crop_path;
+                return false;
+            }
+            reid_list << crop_path << "\n";
+        }
+    }
+    return true;
+}
+
+bool RunInt8Parity(FrameSource& source,
+                   const std::string& model_dir,
+                   const std::string& reid_model_dir,
+                   const CalibrationOptions& options,
+                   Int8ParityReport& report,
+                   std::string& error) {
+    report = Int8ParityReport{};
+    if (!CheckSequence(source, error)) return false;
+
+    const std::string int8_stem = FindModelStem(model_dir, {"scrfd-int8"});
+    if (int8_stem.empty()) {
+        error = "no scrfd-int8 model in " + model_dir;
+        return false;
+    }
+    ScrfdDetector fp32(model_dir + "/scrfd.param", model_dir + "/scrfd.bin",
+                       640, 640, 0.5f, 0.4f, options.detector);
+    ScrfdDetector int8(int8_stem + ".param", int8_stem + ".bin",
+                       640, 640, 0.5f, 0.4f, options.detector);
+    if (!fp32.IsLoaded() || !int8.IsLoaded()) {
+        error = "failed to load the detectors in " + model_dir;
+        return false;
+    }
+    std::unique_ptr<MobileFaceNetReid> reid_fp32;
+    std::unique_ptr<MobileFaceNetReid> reid_int8;
+    if (!reid_model_dir.empty()) {
+        const std::string fp32_stem = FindModelStem(reid_model_dir, {"mobilefacenet-opt", "mobilefacenet"});
+        const std::string reid_int8_stem = FindModelStem(reid_model_dir, {"mobilefacenet-int8"});
+        if (fp32_stem.empty() || reid_int8_stem.empty()) {
+            error = "need mobilefacenet and mobilefacenet-int8 models in " + reid_model_dir;
+            return false;
+        }
+        reid_fp32 = LoadReid(fp32_stem, error);
+        reid_int8 = LoadReid(reid_int8_stem, error);
+        if (!reid_fp32 || !reid_int8) return false;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    double fp32_ms = 0.0, int8_ms = 0.0, iou_sum = 0.0, score_sum = 0.0, cos_sum = 0.0;
+    report.min_reid_cosine = 1.0;
+    SequenceReader reader(source);
+    for (int index : SampleFrames(source.frameCount(), options.max_frames)) {
+        if (!reader.read(index, error)) return false;
+        const LoadedRgbFrame& frame = reader.frame();
+        const unsigned char* rgb = frame.rgbData();
+
+        const auto t0 = Clock::now();
+        const std::vector<ScrfdFace> ref = fp32.Detect(rgb, frame.w, frame.h);
+        const auto t1 = Clock::now();
+        const std::vector<ScrfdFace> test = int8.Detect(rgb, frame.w, frame.h);
+        const auto t2 = Clock::now();
+        fp32_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        int8_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+        ++report.frames;
+        report.fp32_faces += static_cast<int>(ref.size());
+        report.int8_faces += static_cast<int>(test.size());
+
+        // Faces are few per frame: match each fp32 face to its best unused
+        // INT8 face.
+        std::vector<bool> used(test.size(), false);
+        for (const ScrfdFace& face : ref) {
+            int best = -1;
+            float best_iou = kMatchIou;
+            for (size_t j = 0; j < test.size(); ++j) {
+                const float iou = BoxIou(face.bbox, test[j].bbox);
+                if (!used[j] && iou >= best_iou) {
+                    best = static_cast<int>(j);
+                    best_iou = iou;
+                }
+            }
+            if (best < 0) continue;
+            used[static_cast<size_t>(best)] = true;
+            ++report.matched;
+            iou_sum += best_iou;
+            score_sum += std::fabs(test[static_cast<size_t>(best)].score - face.score);
+        }
+
+        if (!reid_fp32) continue;
+        // Both ReID models embed the crop of the fp32 detection, so only the
+        // networks differ.
+        for (const ScrfdFace& face : ref) {
+            bool ok_fp32 = false, ok_int8 = false;
+            const auto a = reid_fp32->Extract(rgb, frame.w, frame.h, ToBBox(face), &face.landmarks, ok_fp32);
+            const auto b = reid_int8->Extract(rgb, frame.w, frame.h, ToBBox(face), &face.landmarks, ok_int8);
+            if (!ok_fp32 || !ok_int8 || a.size() != b.size()) continue;
+            double dot = 0.0;
+            for (size_t d = 0; d < a.size(); ++d) dot += static_cast<double>(a[d]) * b[d];
+            ++report.reid_pairs;
+            cos_sum += dot;
+            report.min_reid_cosine = std::min(report.min_reid_cosine, dot);
+        }
+    }
+
+    if (report.frames > 0) {
+        report.fp32_ms = fp32_ms / report.frames;
+        report.int8_ms = int8_ms / report.frames;
+    }
+    if (report.matched > 0) {
+        report.mean_iou = iou_sum / report.matched;
+        report.mean_score_delta = score_sum / report.matched;
+    }
+    if (report.reid_pairs > 0) {
+        report.mean_reid_cosine = cos_sum / report.reid_pairs;
+    } else {
+        report.min_reid_cosine = 0.0;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+
+#include "frame_source.hpp"
+#include "scrfd.hpp"
+
+/**
+ * INT8 model calibration and parity checks.
+ *
+ * ncnn2table measures activation ranges on sample network inputs, and
+ * ncnn2int8 rewrites a model with the resulting table. Those samples have to
+ * look like what the networks see at run time. They are therefore exported
+ * from our own sequences with the same letterbox and face crop code the
+ * pipeline runs. scripts/calibrate_int8.py drives the whole workflow.
+ *
+ * INT8 models sit next to the fp32 ones as `scrfd-int8.param/.bin` and
+ * `mobilefacenet-int8.param/.bin` (see PipelineOptions::int8).
+ */
+struct CalibrationOptions {
+    int max_frames = 100;      // frames sampled evenly across the sequence
+    DetectorOptions detector;  // detector setup (input geometry, threads)
+};
+
+/**
+ * Write calibration samples for a sequence into `out_dir`:
+ *
+ * - scrfd/<n>.png and scrfd.txt: letterboxed detector inputs (uint8 RGB,
+ *   zero padding, mean/norm still to be applied)
+ * - reid/<n>_<k>.png and reid.txt: 112x112 ReID crops of the faces the fp32
+ *   detector finds (only if `reid_model_dir` is set)
+ *
+ * The .txt files list one image path per line, as ncnn2table expects.
+ *
+ * @return false with `error` set if a model or frame failed to load or a
+ *         file could not be written
+ */
+bool ExportCalibrationSet(FrameSource& source,
+                          const std::string& model_dir,
+                          const std::string& reid_model_dir,
+                          const std::string& out_dir,
+                          const CalibrationOptions& options,
+                          std::string& error);
+
+/**
+ * Agreement of the INT8 models with their fp32 originals.
+ */
+struct Int8ParityReport {
+    int frames = 0;
+    int fp32_faces = 0;
+    int int8_faces = 0;
+    int matched = 0;                // fp32 faces with an INT8 face at IoU >= 0.5
+    double mean_iou = 0.0;          // over matched pairs
+    double mean_score_delta = 0.0;  // mean |score_int8 - score_fp32| over matched pairs
+    double fp32_ms = 0.0;           // mean detector time per frame
+    double int8_ms = 0.0;
+    int reid_pairs = 0;             // crops embedded by both ReID models
+    double mean_reid_cosine = 0.0;  // fp32 vs INT8 embedding of the same crop
+    double min_reid_cosine = 0.0;
+
+    double recall() const { return fp32_faces > 0 ? static_cast<double>(matched) / fp32_faces : 1.0; }
+    double precision() const { return int8_faces > 0 ? static_cast<double>(matched) / int8_faces : 1.0; }
+};
+
+/**
+ * Run the fp32 and INT8 detectors (and ReID models if `reid_model_dir` is
+ * set) on evenly sampled frames and compare their outputs.
+ *
+ * @return false with `error` set if a model or frame failed to load
+ */
+bool RunInt8Parity(FrameSource& source,
+                   const std::string& model_dir,
+                   const std::string& reid_model_dir,
+                   const CalibrationOptions& options,
+                   Int8ParityReport& report,
+                   std::string& error);
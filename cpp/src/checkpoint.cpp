@@ -0,0 +1,14 @@
+#include "checkpoint.hpp"
+
+#include <cstring>
+
+void CheckpointWriter::bytes(const void* data, size_t n) {
+    if (!ok_ || n == 0) return;
+    ok_ = std::fwrite(data, 1, n, f_) == n;
+}
+
+void CheckpointReader::bytes(void* data, size_t n) {
+    if (n == 0) return;
+    if (ok_) ok_ = std::fread(data, 1, n, f_) == n;
+    if (!ok_) std::memset(data, 0, n);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Binary streams for resumable-run checkpoints (--checkpoint) and the
+ * detection cache (--detection-cache).
+ *
+ * Values are trivially copyable and written as their bytes, which is
+ * little-endian on every target we build for; a checkpoint is only read
+ * back by the build that wrote it (the file header carries a version), so
+ * it is a cache, not an interchange format. A failed read or write sticks:
+ * later calls do nothing and ok() stays false, so callers check once at
+ * the end.
+ */
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(FILE* f) : f_(f) {}
+
+    void bytes(const void* data, size_t n);
+
+    template <typename T>
+    void put(const T& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint values are raw bytes");
+        bytes(&v, sizeof(T));
+    }
+
+    template <typename T>
+    void putVector(const std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint values are raw bytes");
+        put<uint64_t>(v.size());
+        bytes(v.data(), v.size() * sizeof(T));
+    }
+
+    bool ok() const { return ok_; }
+
+private:
+    FILE* f_;
+    bool ok_ = true;
+};
+
+class CheckpointReader {
+public:
+    explicit CheckpointReader(FILE* f) : f_(f) {}
+
+    void bytes(void* data, size_t n);
+
+    template <typename T>
+    void get(T& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint values are raw bytes");
+        bytes(&v, sizeof(T));
+    }
+
+    template <typename T>
+    T get() {
+        T v{};
+        get(v);
+        return v;
+    }
+
+    template <typename T>
+    void getVector(std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint values are raw bytes");
+        const uint64_t n = get<uint64_t>();
+        if (!ok_ || n > kMaxBytes / sizeof(T)) {
+            fail();
+            v.clear();
+            return;
+        }
+        v.resize(static_cast<size_t>(n));
+        bytes(v.data(), v.size() * sizeof(T));
+    }
+
+    /** Mark the stream bad (a value read back is out of range). */
+    void fail() { ok_ = false; }
+    bool ok() const { return ok_; }
+
+private:
+    static constexpr uint64_t kMaxBytes = uint64_t{1} << 32;  // sanity bound on one vector
+
+    FILE* f_;
+    bool ok_ = true;
+};
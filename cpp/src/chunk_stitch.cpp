@@ -0,0 +1,446 @@
+#include "chunk_stitch.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#include "checkpoint.hpp"
+#include "keyframes.hpp"
+#include "tracklet_linking.hpp"
+
+namespace {
+constexpr char kMagic[8] = {'F', 'P', 'C', 'H', 'U', 'N', 'K', '1'};
+constexpr uint32_t kChunkVersion = 1;
+constexpr uint32_t kStopped = 1u;
+
+struct ChunkHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    int32_t start;
+    int32_t end;
+    int32_t read_first;
+    int32_t read_end;
+    float video_fps;
+    float conf_thresh;
+    float reid_cos_thresh;
+    uint32_t tracks;
+};
+
+struct TrackRecord {
+    int32_t id;
+    int32_t identity;
+};
+
+// Tracks of neighbouring chunks are the same face when they share at
+// least this many frames, overlapping by this mean IoU on them.
+constexpr int kMinCommonFrames = 3;
+constexpr float kMinOverlapIou = 0.5f;
+
+// Mean IoU of two tracks (frames in frame order) on the frames both have
+// in [first, end), and how many those are.
+std::pair<float, int> OverlapIou(const FaceTrack& a, const FaceTrack& b, int first, int end) {
+    float sum = 0.0f;
+    int common = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.frames.size() && j < b.frames.size()) {
+        const int fa = a.frames[i].frame_index;
+        const int fb = b.frames[j].frame_index;
+        if (fa < fb) {
+            i++;
+        } else if (fb < fa) {
+            j++;
+        } else {
+            if (fa >= first && fa < end) {
+                sum += a.frames[i].bbox.iou(b.frames[j].bbox);
+                common++;
+            }
+            i++;
+            j++;
+        }
+    }
+    return {common > 0 ? sum / static_cast<float>(common) : 0.0f, common};
+}
+}  // namespace
+
+bool TrackChunk::save(const std::string& path, std::string& error) const {
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        error = "cannot create " + tmp;
+        return false;
+    }
+    CheckpointWriter w(f);
+    ChunkHeader hdr{};
+    std::memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version = kChunkVersion;
+    hdr.flags = stopped ? kStopped : 0u;
+    hdr.start = start;
+    hdr.end = end;
+    hdr.read_first = read_first;
+    hdr.read_end = read_end;
+    hdr.video_fps = video_fps;
+    hdr.conf_thresh = conf_thresh;
+    hdr.reid_cos_thresh = reid_cos_thresh;
+    hdr.tracks = static_cast<uint32_t>(tracks.size());
+    w.put(hdr);
+    const EmbeddingF32 none;
+    for (const FaceTrack& track : tracks) {
+        w.put(TrackRecord{track.id, track.identity});
+        w.putVector(track.frames);
+        const auto app = appearances.find(track.id);
+        w.putVector(app != appearances.end() ? app->second : none);
+    }
+    bool ok = w.ok();
+    ok = (std::fclose(f) == 0) && ok;
+    if (ok) {
+        std::remove(path.c_str());  // rename does not replace on Windows
+        ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        std::remove(tmp.c_str());
+        error = "cannot write " + path;
+    }
+    return ok;
+}
+
+bool TrackChunk::load(const std::string& path, std::string& error) {
+    tracks.clear();
+    appearances.clear();
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        error = "cannot open " + path;
+        return false;
+    }
+    CheckpointReader r(f);
+    const ChunkHeader hdr = r.get<ChunkHeader>();
+    bool ok = r.ok() && std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) == 0 && hdr.version == kChunkVersion &&
+              hdr.read_first >= 0 && hdr.read_first <= hdr.start && hdr.start <= hdr.end && hdr.video_fps > 0.0f;
+    if (ok) {
+        stopped = (hdr.flags & kStopped) != 0;
+        start = hdr.start;
+        end = hdr.end;
+        read_first = hdr.read_first;
+        read_end = hdr.read_end;
+        video_fps = hdr.video_fps;
+        conf_thresh = hdr.conf_thresh;
+        reid_cos_thresh = hdr.reid_cos_thresh;
+    }
+    for (uint32_t t = 0; ok && t < hdr.tracks; ++t) {
+        const TrackRecord rec = r.get<TrackRecord>();
+        FaceTrack track;
+        track.id = rec.id;
+        track.identity = rec.identity;
+        r.getVector(track.frames);
+        EmbeddingF32 app;
+        r.getVector(app);
+        ok = r.ok() && !track.frames.empty() && track.frames.front().frame_index >= read_first &&
+             track.frames.back().frame_index < read_end;
+        for (size_t k = 1; ok && k < track.frames.size(); ++k) {
+            ok = track.frames[k - 1].frame_index < track.frames[k].frame_index;
+        }
+        if (!ok) break;
+        if (!app.empty()) appearances[track.id] = std::move(app);
+        tracks.push_back(std::move(track));
+    }
+    std::fclose(f);
+    if (!ok) {
+        tracks.clear();
+        appearances.clear();
+        error = path + " is not a chunk of tracklets (or is truncated)";
+    }
+    return ok;
+}
+
+bool StitchChunks(std::vector<TrackChunk>& chunks, const ReidConfig& link, PipelineResult& out,
+                  std::string& error) {
+    out = PipelineResult{};
+    out.frame_count = 0;
+    std::stable_sort(chunks.begin(), chunks.end(),
+                     [](const TrackChunk& a, const TrackChunk& b) { return a.start < b.start; });
+    for (size_t k = 1; k < chunks.size(); ++k) {
+        if (chunks[k].start < chunks[k - 1].end) {
+            error = "chunks " + std::to_string(chunks[k - 1].start) + ":" + std::to_string(chunks[k - 1].end) +
+                    " and " + std::to_string(chunks[k].start) + ":" + std::to_string(chunks[k].end) +
+                    " own the same frames";
+            return false;
+        }
+    }
+    for (const TrackChunk& chunk : chunks) {
+        out.frame_count = std::max(out.frame_count, chunk.read_end);
+        out.stopped = out.stopped || chunk.stopped;
+        if (chunk.video_fps != chunks.front().video_fps) {
+            fprintf(stderr, "Warning: chunk %d:%d was tracked at %.3f fps, linking assumes %.3f\n", chunk.start,
+                    chunk.end, chunk.video_fps, chunks.front().video_fps);
+        }
+    }
+    if (chunks.empty()) return true;
+
+    // Chunk owning frame f, -1 for frames no chunk owns.
+    auto owner = [&chunks](int f) {
+        const auto it = std::upper_bound(chunks.begin(), chunks.end(), f,
+                                         [](int frame, const TrackChunk& c) { return frame < c.start; });
+        if (it == chunks.begin()) return -1;
+        const int k = static_cast<int>(it - chunks.begin()) - 1;
+        return f < chunks[k].end ? k : -1;
+    };
+
+    // Every chunk's tracks, one node each.
+    struct Node {
+        int chunk;
+        const FaceTrack* track;
+    };
+    std::vector<Node> nodes;
+    std::vector<size_t> first_node(chunks.size() + 1, 0);
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        first_node[k] = nodes.size();
+        for (const FaceTrack& track : chunks[k].tracks) nodes.push_back({static_cast<int>(k), &track});
+    }
+    first_node[chunks.size()] = nodes.size();
+    UnionFind same_face(static_cast<int>(nodes.size()));
+
+    // 1. Tracks of chunks whose reads overlap, matched on their common frames.
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        for (size_t l = k + 1; l < chunks.size() && chunks[l].read_first < chunks[k].read_end; ++l) {
+            const int first = chunks[l].read_first;
+            const int end = std::min(chunks[k].read_end, chunks[l].read_end);
+            std::vector<std::tuple<float, size_t, size_t>> pairs;  // (IoU, node in k, node in l)
+            for (size_t a = first_node[k]; a < first_node[k + 1]; ++a) {
+                const FaceTrack& A = *nodes[a].track;
+                if (A.frames.back().frame_index < first) continue;
+                for (size_t b = first_node[l]; b < first_node[l + 1]; ++b) {
+                    const FaceTrack& B = *nodes[b].track;
+                    if (B.frames.front().frame_index >= end) continue;
+                    const auto overlap = OverlapIou(A, B, first, end);
+                    if (overlap.second >= kMinCommonFrames && overlap.first >= kMinOverlapIou) {
+                        pairs.emplace_back(overlap.first, a, b);
+                    }
+                }
+            }
+            std::stable_sort(pairs.begin(), pairs.end(), [](const auto& x, const auto& y) {
+                return std::get<0>(x) > std::get<0>(y);
+            });
+            std::vector<char> used(nodes.size(), 0);
+            for (const auto& p : pairs) {
+                const size_t a = std::get<1>(p);
+                const size_t b = std::get<2>(p);
+                if (used[a] || used[b]) continue;
+                used[a] = used[b] = 1;
+                same_face.unite(static_cast<int>(a), static_cast<int>(b));
+            }
+        }
+    }
+
+    // Each matched group as one track, every node keeping the frames its
+    // chunk owns (or that no chunk does).
+    struct Merged {
+        std::vector<TrackFrame> frames;
+        EmbeddingF32 appearance;  // sum of the nodes' appearances
+        int identity = -1;
+    };
+    std::vector<std::vector<size_t>> groups(nodes.size());
+    for (size_t n = 0; n < nodes.size(); ++n) groups[same_face.representative(static_cast<int>(n))].push_back(n);
+    std::vector<Merged> merged;
+    std::vector<TrackFrame> gathered;
+    std::vector<size_t> runs;
+    for (const std::vector<size_t>& group : groups) {
+        if (group.empty()) continue;
+        gathered.clear();
+        runs.assign(1, 0);
+        Merged m;
+        for (size_t member : group) {
+            const Node& node = nodes[member];
+            for (const TrackFrame& f : node.track->frames) {
+                const int k = owner(f.frame_index);
+                if (k == node.chunk || k < 0) gathered.push_back(f);
+            }
+            runs.push_back(gathered.size());
+            const TrackChunk& chunk = chunks[static_cast<size_t>(node.chunk)];
+            const auto app = chunk.appearances.find(node.track->id);
+            if (app != chunk.appearances.end()) {
+                if (m.appearance.empty()) m.appearance.assign(app->second.size(), 0.0f);
+                if (m.appearance.size() == app->second.size()) {
+                    for (size_t d = 0; d < app->second.size(); ++d) m.appearance[d] += app->second[d];
+                }
+            }
+            if (m.identity < 0) m.identity = node.track->identity;
+        }
+        MergeFrameRuns(gathered, runs, m.frames);
+        if (!m.appearance.empty()) L2Normalize(m.appearance);
+        merged.push_back(std::move(m));
+    }
+
+    // 2. Offline linking across chunk boundaries.
+    std::vector<TrackletSummary> summaries;
+    std::vector<int> summary_of;  // merged track of each summary
+    std::vector<PackedEmbedding> packed;
+    for (size_t m = 0; m < merged.size(); ++m) {
+        if (merged[m].frames.empty()) continue;
+        summaries.push_back(SummarizeTracklet(static_cast<int>(m), merged[m].frames, chunks.front().conf_thresh));
+        summary_of.push_back(static_cast<int>(m));
+        packed.emplace_back(merged[m].appearance);
+    }
+    std::vector<const PackedEmbedding*> appearance(summaries.size(), nullptr);
+    for (size_t s = 0; s < summaries.size(); ++s) {
+        if (!merged[summary_of[s]].appearance.empty()) appearance[s] = &packed[s];
+    }
+    UnionFind linked(static_cast<int>(merged.size()));
+    const auto may_link = [&](int from, int to) {
+        return owner(summaries[from].end_frame) != owner(summaries[to].start_frame);
+    };
+    for (const TrackletLink& l : FindTrackletLinks(summaries, appearance, chunks.front().video_fps,
+                                                   chunks.front().reid_cos_thresh, link, may_link)) {
+        linked.unite(summary_of[l.from], summary_of[l.to]);
+    }
+
+    // Output tracks, numbered by first frame.
+    std::vector<std::vector<int>> members(merged.size());
+    for (size_t m = 0; m < merged.size(); ++m) {
+        if (merged[m].frames.empty()) continue;
+        members[linked.representative(static_cast<int>(m))].push_back(static_cast<int>(m));
+    }
+    for (const std::vector<int>& group : members) {
+        if (group.empty()) continue;
+        gathered.clear();
+        runs.assign(1, 0);
+        FaceTrack track;
+        for (int m : group) {
+            gathered.insert(gathered.end(), merged[m].frames.begin(), merged[m].frames.end());
+            runs.push_back(gathered.size());
+            if (track.identity < 0) track.identity = merged[m].identity;
+        }
+        MergeFrameRuns(gathered, runs, track.frames);
+        out.tracks.push_back(std::move(track));
+    }
+    std::stable_sort(out.tracks.begin(), out.tracks.end(), [](const FaceTrack& a, const FaceTrack& b) {
+        return a.frames.front().frame_index < b.frames.front().frame_index;
+    });
+    for (size_t t = 0; t < out.tracks.size(); ++t) out.tracks[t].id = static_cast<int>(t);
+    return true;
+}
+
+bool TrackAroundFrame(FacePipeline& pipeline, FrameSource& source, int anchor, int overlap, float video_fps,
+                      float conf_thresh, const TrackSegmentSink& on_segment, PipelineResult& out,
+                      std::string& error) {
+    const int count = source.frameCount();
+    if (!source.randomAccess() || count < 0) {
+        error = "--priority-frame needs input of known length that can be read in any order";
+        return false;
+    }
+    anchor = std::max(0, std::min(anchor, count));
+    overlap = std::max(0, overlap);
+
+    // Direction 0 reads on from the anchor, direction 1 back from it.
+    ChunkFrameSource forward(source, std::max(0, anchor - overlap), -1);
+    ReversedFrameSource backward(source, anchor > 0 ? std::min(count, anchor + overlap) : 0);
+    const int forward_first = std::max(0, anchor - overlap);
+    auto to_input = [&](int direction, std::vector<TrackFrame>& frames) {
+        if (direction == 0) {
+            for (TrackFrame& f : frames) f.frame_index += forward_first;
+        } else {
+            for (TrackFrame& f : frames) f.frame_index = backward.inputIndex(f.frame_index);
+            std::reverse(frames.begin(), frames.end());
+        }
+    };
+
+    // One progress report for both; frames read are summed.
+    const RunTuning base = pipeline.tuning();
+    std::mutex mu;
+    int frames_read[2] = {0, 0};
+    const int total = forward.frameCount() + backward.frameCount();
+    std::vector<FaceTrack> streamed[2];  // each direction's segments, its own frame indices
+    auto tuning_for = [&](int direction) {
+        RunTuning tuning = base;
+        tuning.tracking.keyframe_tolerance = 0.0f;  // reduced once stitched, not each direction
+        // Editor cuts start a shot on the frame after the boundary: reversed,
+        // input frame c - 1 starts it.
+        tuning.tracking.cut_frames.clear();
+        for (int c : base.tracking.cut_frames) {
+            const int j = direction == 0 ? c - forward_first : backward.frameCount() - c;
+            if (j > 0) tuning.tracking.cut_frames.push_back(j);
+        }
+        if (base.tracking.progress) {
+            tuning.tracking.progress = [&, direction](const char* stage, int done, int stage_total) {
+                std::lock_guard<std::mutex> lock(mu);
+                if (std::strcmp(stage, "frames") == 0) {
+                    frames_read[direction] = done;
+                    base.tracking.progress(stage, frames_read[0] + frames_read[1], total);
+                } else {
+                    base.tracking.progress(stage, done, stage_total);
+                }
+            };
+        }
+        return tuning;
+    };
+    auto sink_for = [&](int direction) -> TrackSegmentSink {
+        if (!on_segment) return TrackSegmentSink();
+        return [&, direction](const FaceTrack& segment) {
+            FaceTrack provisional;
+            provisional.id = segment.id * 2 + direction;
+            provisional.frames = segment.frames;
+            to_input(direction, provisional.frames);
+            std::lock_guard<std::mutex> lock(mu);
+            streamed[direction].push_back(segment);
+            on_segment(provisional);
+        };
+    };
+
+    PipelineResult results[2];
+    std::thread back_in_time;
+    if (backward.frameCount() > 0) {
+        back_in_time = std::thread([&]() {
+            results[1] = pipeline.process(backward, video_fps, sink_for(1), tuning_for(1));
+        });
+    }
+    results[0] = pipeline.process(forward, video_fps, sink_for(0), tuning_for(0));
+    if (back_in_time.joinable()) back_in_time.join();
+
+    std::vector<TrackChunk> chunks;
+    for (int direction = 0; direction < 2; ++direction) {
+        PipelineResult& result = results[direction];
+        if (direction == 1 && backward.frameCount() == 0) continue;
+        TrackChunk chunk;
+        chunk.start = direction == 0 ? anchor : 0;
+        chunk.end = direction == 0 ? count : anchor;
+        chunk.read_first = direction == 0 ? forward_first : backward.frameCount() - result.frame_count;
+        chunk.read_end = direction == 0 ? forward_first + result.frame_count : backward.frameCount();
+        chunk.video_fps = video_fps;
+        chunk.conf_thresh = conf_thresh;
+        chunk.reid_cos_thresh = base.reid_cos_thresh;
+        chunk.stopped = result.stopped;
+        chunk.appearances = std::move(result.appearances);
+        // Streamed segments back into the output tracks they were linked into.
+        std::map<int, FaceTrack> tracks;
+        for (FaceTrack& track : result.tracks) tracks[track.id] = std::move(track);
+        for (const FaceTrack& segment : streamed[direction]) {
+            const auto link = result.segment_links.find(segment.id);
+            if (link == result.segment_links.end() || link->second < 0) continue;
+            FaceTrack& track = tracks[link->second];
+            track.id = link->second;
+            track.frames.insert(track.frames.end(), segment.frames.begin(), segment.frames.end());
+        }
+        for (auto& kv : tracks) {
+            FaceTrack& track = kv.second;
+            std::stable_sort(track.frames.begin(), track.frames.end(),
+                             [](const TrackFrame& a, const TrackFrame& b) { return a.frame_index < b.frame_index; });
+            to_input(direction, track.frames);
+            chunk.tracks.push_back(std::move(track));
+        }
+        chunks.push_back(std::move(chunk));
+    }
+    if (!StitchChunks(chunks, base.tracking.reid, out, error)) return false;
+    const PipelineResult& sized = results[0].frame_width > 0 ? results[0] : results[1];
+    out.frame_width = sized.frame_width;
+    out.frame_height = sized.frame_height;
+    if (base.tracking.keyframe_tolerance > 0.0f) {
+        for (FaceTrack& track : out.tracks) {
+            ReduceToKeyframes(track.frames, base.tracking.keyframe_tolerance, out.frame_width, out.frame_height);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "embedding.hpp"
+#include "frame_source.hpp"
+#include "pipeline.hpp"
+#include "reid.hpp"
+
+/**
+ * Tracks of one chunk of a long timeline (--chunk <start>:<end>
+ * --emit-tracklets <file>), tracked by a process of its own, maybe on
+ * another machine, then merged with the other chunks by StitchChunks()
+ * (--stitch).
+ *
+ * A chunk owns frames [start, end) of the input. It also tracks the
+ * overlap frames on either side of them, [read_first, read_end), so a face
+ * crossing a boundary is tracked on both sides of it for a while; that is
+ * what matches the two halves up. Frame indices are the input's.
+ *
+ * Like detection dumps, a file is read back by the build that wrote it.
+ */
+struct TrackChunk {
+    int start = 0;
+    int end = 0;
+    int read_first = 0;
+    int read_end = 0;
+    float video_fps = 30.0f;
+    float conf_thresh = 0.5f;      // detector threshold of the run (tracklet spans, long-gap links)
+    float reid_cos_thresh = 0.35f;  // linking similarity threshold of the run
+    bool stopped = false;           // the run ended early: read_end falls short of end + overlap
+    std::vector<FaceTrack> tracks;
+    std::map<int, EmbeddingF32> appearances;  // track id -> L2-normalized appearance (ReID runs)
+
+    bool save(const std::string& path, std::string& error) const;
+
+    /** @return false (with `error`) if `path` cannot be read */
+    bool load(const std::string& path, std::string& error);
+};
+
+/**
+ * Merge chunks into one result with track IDs numbered over the whole
+ * timeline, in order of first frame.
+ *
+ * Tracks of neighbouring chunks that follow the same face through their
+ * common frames (mean IoU there, one-to-one, best first) become one track,
+ * which keeps each chunk's boxes on the frames that chunk owns. Then the
+ * offline linking of FacePipeline::process (see FindTrackletLinks, with
+ * `link` for its limits) runs once more across chunk boundaries, joining
+ * tracks a boundary cut apart while the face was out of view. Linking
+ * within a chunk was settled by that chunk's run.
+ *
+ * @return false (with `error`) if two chunks own the same frames
+ */
+bool StitchChunks(std::vector<TrackChunk>& chunks, const ReidConfig& link, PipelineResult& out,
+                  std::string& error);
+
+/**
+ * Track outward from input frame `anchor` (--priority-frame): frames from
+ * it on forwards and, concurrently, the frames before it backwards in time,
+ * so the frames around the anchor are tracked first. The two runs of
+ * `pipeline` each read `overlap` frames past the anchor too, and are
+ * stitched as two chunks (StitchChunks) owning either side of it.
+ *
+ * @param on_segment Tracklets of both runs as they end (see TrackSegmentSink),
+ *                   in input frame order, with provisional IDs: `out` holds
+ *                   the whole tracks. Empty = none.
+ * @return false (with `error`) unless `source` knows its length and allows random access
+ */
+bool TrackAroundFrame(FacePipeline& pipeline, FrameSource& source, int anchor, int overlap, float video_fps,
+                      float conf_thresh, const TrackSegmentSink& on_segment, PipelineResult& out,
+                      std::string& error);
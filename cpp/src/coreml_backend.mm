@@ -0,0 +1,206 @@
+#include "inference_backend.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <set>
+
+#import <CoreML/CoreML.h>
+#import <Foundation/Foundation.h>
+
+namespace {
+float HalfToFloat(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+    const uint32_t exp = (h >> 10) & 0x1fu;
+    uint32_t mant = h & 0x3ffu;
+    uint32_t bits = 0;
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            // Subnormal: renormalize.
+            int e = -1;
+            do {
+                e++;
+                mant <<= 1;
+            } while ((mant & 0x400u) == 0);
+            bits = sign | static_cast<uint32_t>(127 - 15 - e) << 23 | (mant & 0x3ffu) << 13;
+        }
+    } else if (exp == 0x1f) {
+        bits = sign | 0x7f800000u | mant << 13;
+    } else {
+        bits = sign | (exp + 127 - 15) << 23 | mant << 13;
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+float ElementAt(const void* base, MLMultiArrayDataType type, NSInteger offset) {
+    switch (type) {
+        case MLMultiArrayDataTypeDouble: return static_cast<float>(static_cast<const double*>(base)[offset]);
+        case MLMultiArrayDataTypeInt32: return static_cast<float>(static_cast<const int32_t*>(base)[offset]);
+        case MLMultiArrayDataTypeFloat32: return static_cast<const float*>(base)[offset];
+        default: return HalfToFloat(static_cast<const uint16_t*>(base)[offset]);  // Float16 (ANE outputs)
+    }
+}
+
+// Copy a multi-array into a mat: [1, C, H, W] / [C, H, W] -> (w, h, c),
+// [1, N, K] / [N, K] -> (K, N). Strides are honoured, so padded Neural
+// Engine outputs work too.
+bool CopyToMat(MLMultiArray* array, ncnn::Mat& out) {
+    NSArray<NSNumber*>* shape = array.shape;
+    NSArray<NSNumber*>* strides = array.strides;
+    NSInteger dims[4] = {1, 1, 1, 1};
+    NSInteger steps[4] = {0, 0, 0, 0};
+    NSInteger rank = static_cast<NSInteger>(shape.count);
+    NSInteger first = 0;
+    if (rank == 4 || (rank == 3 && shape[0].integerValue == 1)) first = 1;  // batch
+    rank -= first;
+    if (rank < 1 || rank > 3) return false;
+    for (NSInteger i = 0; i < rank; ++i) {
+        dims[4 - rank + i] = shape[first + i].integerValue;
+        steps[4 - rank + i] = strides[first + i].integerValue;
+    }
+    const NSInteger c = dims[1], h = dims[2], w = dims[3];
+    if (rank == 3) {
+        out.create(static_cast<int>(w), static_cast<int>(h), static_cast<int>(c));
+    } else {
+        out.create(static_cast<int>(w), static_cast<int>(h));
+    }
+    if (out.empty()) return false;
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+    const void* base = array.dataPointer;
+#pragma clang diagnostic pop
+    const MLMultiArrayDataType type = array.dataType;
+    for (NSInteger q = 0; q < c; ++q) {
+        float* dst = rank == 3 ? static_cast<float*>(out.channel(static_cast<int>(q)).data)
+                               : static_cast<float*>(out.data);
+        for (NSInteger y = 0; y < h; ++y) {
+            for (NSInteger x = 0; x < w; ++x) {
+                dst[y * w + x] = ElementAt(base, type, q * steps[1] + y * steps[2] + x * steps[3]);
+            }
+        }
+    }
+    return true;
+}
+
+class CoreMlBackend final : public NetBackend {
+public:
+    CoreMlBackend(MLModel* model, NSString* input_name, int input_w, int input_h, std::set<std::string> outputs)
+        : model_(model), input_name_(input_name), input_w_(input_w), input_h_(input_h), outputs_(std::move(outputs)) {}
+
+    const char* name() const override { return "Core ML"; }
+    int inputWidth() const override { return input_w_; }
+    int inputHeight() const override { return input_h_; }
+    bool hasOutput(const char* name) const override { return outputs_.count(name) != 0; }
+
+    bool run(const ncnn::Mat& input,
+             const std::vector<const char*>& names,
+             std::vector<ncnn::Mat>& outputs) const override {
+        @autoreleasepool {
+            // Core ML only guarantees thread-safe predictions on recent
+            // systems, and the Neural Engine runs one request at a time anyway.
+            std::lock_guard<std::mutex> lock(mutex_);
+            // ncnn aligns channel starts (cstep); the strides describe that.
+            NSArray<NSNumber*>* shape = @[ @1, @(input.c), @(input.h), @(input.w) ];
+            NSArray<NSNumber*>* strides =
+                @[ @(input.cstep * input.c), @(input.cstep), @(input.w), @1 ];
+            NSError* error = nil;
+            MLMultiArray* array = [[MLMultiArray alloc] initWithDataPointer:input.data
+                                                                      shape:shape
+                                                                   dataType:MLMultiArrayDataTypeFloat32
+                                                                    strides:strides
+                                                                deallocator:nil
+                                                                      error:&error];
+            if (!array) return false;
+            MLDictionaryFeatureProvider* features = [[MLDictionaryFeatureProvider alloc]
+                initWithDictionary:@{input_name_ : [MLFeatureValue featureValueWithMultiArray:array]}
+                             error:&error];
+            if (!features) return false;
+            id<MLFeatureProvider> result = [model_ predictionFromFeatures:features error:&error];
+            if (!result) return false;
+
+            outputs.resize(names.size());
+            for (size_t i = 0; i < names.size(); ++i) {
+                MLMultiArray* value = [result featureValueForName:@(names[i])].multiArrayValue;
+                if (!value || !CopyToMat(value, outputs[i])) return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    MLModel* model_;
+    NSString* input_name_;
+    int input_w_ = 0;
+    int input_h_ = 0;
+    std::set<std::string> outputs_;
+    mutable std::mutex mutex_;
+};
+
+MLComputeUnits ToComputeUnits(CoreMlOptions::Units units) {
+    switch (units) {
+        case CoreMlOptions::Units::CpuOnly: return MLComputeUnitsCPUOnly;
+        case CoreMlOptions::Units::CpuAndGpu: return MLComputeUnitsCPUAndGPU;
+        case CoreMlOptions::Units::CpuAndNeuralEngine:
+            if (@available(macOS 13.0, *)) return MLComputeUnitsCPUAndNeuralEngine;
+            return MLComputeUnitsAll;  // closest before macOS 13
+        default: return MLComputeUnitsAll;
+    }
+}
+}  // namespace
+
+bool CoreMlAvailable() {
+    if (@available(macOS 10.14, *)) return true;
+    return false;
+}
+
+std::unique_ptr<NetBackend> LoadCoreMlModel(const std::string& mlmodelc_path,
+                                            const CoreMlOptions& options,
+                                            std::string& error) {
+    if (@available(macOS 10.14, *)) {
+        @autoreleasepool {
+            NSURL* url = [NSURL fileURLWithPath:@(mlmodelc_path.c_str()) isDirectory:YES];
+            if (![[NSFileManager defaultManager] fileExistsAtPath:url.path]) {
+                error = mlmodelc_path + " not found";
+                return nullptr;
+            }
+            MLModelConfiguration* config = [[MLModelConfiguration alloc] init];
+            config.computeUnits = ToComputeUnits(options.units);
+            NSError* ns_error = nil;
+            MLModel* model = [MLModel modelWithContentsOfURL:url configuration:config error:&ns_error];
+            if (!model) {
+                error = std::string("cannot load ") + mlmodelc_path + ": " +
+                        (ns_error ? ns_error.localizedDescription.UTF8String : "unknown error");
+                return nullptr;
+            }
+
+            NSDictionary<NSString*, MLFeatureDescription*>* inputs = model.modelDescription.inputDescriptionsByName;
+            MLFeatureDescription* input = inputs.allValues.firstObject;
+            if (inputs.count != 1 || input.type != MLFeatureTypeMultiArray) {
+                error = mlmodelc_path + ": expected a single multi-array input";
+                return nullptr;
+            }
+            // A flexible input takes any (padded) size; a fixed one sets the input size.
+            int input_w = 0;
+            int input_h = 0;
+            MLMultiArrayConstraint* constraint = input.multiArrayConstraint;
+            const bool flexible = constraint.shapeConstraint.type == MLMultiArrayShapeConstraintTypeRange;
+            if (!flexible && constraint.shape.count >= 2) {
+                input_w = constraint.shape.lastObject.intValue;
+                input_h = constraint.shape[constraint.shape.count - 2].intValue;
+            }
+
+            std::set<std::string> outputs;
+            for (NSString* name in model.modelDescription.outputDescriptionsByName) {
+                outputs.insert(name.UTF8String);
+            }
+            return std::unique_ptr<NetBackend>(new CoreMlBackend(model, input.name, input_w, input_h, std::move(outputs)));
+        }
+    }
+    error = "Core ML needs macOS 10.14 or later";
+    return nullptr;
+}
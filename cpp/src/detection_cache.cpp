@@ -0,0 +1,224 @@
+#include "detection_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include "checkpoint.hpp"
+
+namespace {
+constexpr char kMagic[8] = {'F', 'P', 'D', 'E', 'T', 'C', 'H', '1'};
+constexpr uint32_t kCacheVersion = 1;
+constexpr uint32_t kMaxFacesPerFrame = 1 << 16;  // sanity bounds on a file's entries
+constexpr uint32_t kMaxDim = 4096;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t model_key;
+    uint64_t count;
+};
+
+// Detection without its embedding, which follows as `dim` floats.
+struct CachedFace {
+    BBox bbox;
+    float score;
+    float reid_quality;
+    BBox pixel_bbox;
+    std::array<std::array<float, 2>, 5> landmarks;
+    uint32_t has_reid;
+    uint32_t dim;
+};
+
+// Memory of one entry: its detections, their embeddings and the map node.
+size_t EntryBytes(const std::vector<Detection>& dets) {
+    size_t bytes = sizeof(uint64_t) + sizeof(dets) + 2 * sizeof(void*) + dets.capacity() * sizeof(Detection);
+    for (const Detection& d : dets) bytes += d.reid.capacity() * sizeof(float);
+    return bytes;
+}
+}  // namespace
+
+void DetectionCache::Hasher::bytes(const void* data, size_t n) {
+    constexpr uint64_t kPrime = 1099511628211ull;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h_ = (h_ ^ w) * kPrime;
+        h_ ^= h_ >> 29;
+    }
+    for (; n > 0; --n, ++p) h_ = (h_ ^ *p) * kPrime;
+}
+
+bool DetectionCache::Hasher::file(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::vector<unsigned char> buf(1 << 16);
+    size_t n;
+    while ((n = std::fread(buf.data(), 1, buf.size(), f)) > 0) bytes(buf.data(), n);
+    const bool ok = !std::ferror(f);
+    std::fclose(f);
+    return ok;
+}
+
+uint64_t DetectionCache::FrameKey(const unsigned char* rgb, int width, int height) {
+    Hasher h;
+    h.value(width);
+    h.value(height);
+    h.bytes(rgb, static_cast<size_t>(width) * static_cast<size_t>(height) * 3);
+    return h.digest();
+}
+
+bool DetectionCache::load(const std::string& path, std::string& error) {
+    std::lock_guard<std::mutex> lock(mu_);
+    entries_.clear();
+    bytes_ = 0;
+    dirty_ = false;
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return true;  // first run
+
+    CheckpointReader r(f);
+    CacheHeader hdr{};
+    r.get(hdr);
+    bool ok = r.ok() && std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) == 0 && hdr.version == kCacheVersion;
+    if (ok && hdr.model_key != model_key_) {
+        // Other models or settings: nothing in it applies.
+        std::fclose(f);
+        dirty_ = true;
+        return true;
+    }
+    for (uint64_t e = 0; ok && e < hdr.count; ++e) {
+        const uint64_t key = r.get<uint64_t>();
+        const uint32_t faces = r.get<uint32_t>();
+        if (!r.ok() || faces > kMaxFacesPerFrame) {
+            ok = false;
+            break;
+        }
+        std::vector<Detection> dets(faces);
+        for (Detection& d : dets) {
+            const CachedFace c = r.get<CachedFace>();
+            if (!r.ok() || c.dim > kMaxDim) {
+                ok = false;
+                break;
+            }
+            d.bbox = c.bbox;
+            d.score = c.score;
+            d.reid_quality = c.reid_quality;
+            d.pixel_bbox = c.pixel_bbox;
+            d.landmarks = c.landmarks;
+            d.has_reid = c.has_reid != 0;
+            d.reid.resize(c.dim);
+            r.bytes(d.reid.data(), d.reid.size() * sizeof(float));
+        }
+        ok = ok && r.ok();
+        if (ok) {
+            bytes_ += EntryBytes(dets);
+            entries_[key] = std::move(dets);
+        }
+    }
+    std::fclose(f);
+    if (!ok) {
+        entries_.clear();
+        bytes_ = 0;
+        error = path + " is not a detection cache (or is truncated)";
+    }
+    if (account_) account_->set(bytes_);
+    return ok;
+}
+
+bool DetectionCache::save(const std::string& path, std::string& error) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!dirty_) return true;
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        error = "cannot create " + tmp;
+        return false;
+    }
+    CheckpointWriter w(f);
+    CacheHeader hdr{};
+    std::memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version = kCacheVersion;
+    hdr.model_key = model_key_;
+    hdr.count = entries_.size();
+    w.put(hdr);
+    for (const auto& entry : entries_) {
+        w.put(entry.first);
+        w.put(static_cast<uint32_t>(entry.second.size()));
+        for (const Detection& d : entry.second) {
+            CachedFace c{};
+            c.bbox = d.bbox;
+            c.score = d.score;
+            c.reid_quality = d.reid_quality;
+            c.pixel_bbox = d.pixel_bbox;
+            c.landmarks = d.landmarks;
+            c.has_reid = d.has_reid ? 1u : 0u;
+            c.dim = static_cast<uint32_t>(d.reid.size());
+            w.put(c);
+            w.bytes(d.reid.data(), d.reid.size() * sizeof(float));
+        }
+    }
+    bool ok = (std::fclose(f) == 0) && w.ok();
+    if (ok) {
+        std::remove(path.c_str());  // rename does not replace on Windows
+        ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        std::remove(tmp.c_str());
+        error = "cannot write " + path;
+    }
+    return ok;
+}
+
+bool DetectionCache::find(uint64_t key, std::vector<Detection>& out) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        misses_++;
+        return false;
+    }
+    hits_++;
+    out = it->second;
+    return true;
+}
+
+bool DetectionCache::get(uint64_t key, std::vector<Detection>& out) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) return false;
+    out = it->second;
+    return true;
+}
+
+void DetectionCache::insert(uint64_t key, const std::vector<Detection>& dets) {
+    std::lock_guard<std::mutex> lock(mu_);
+    const size_t bytes = EntryBytes(dets);
+    auto it = entries_.find(key);
+    const size_t replaced = it != entries_.end() ? EntryBytes(it->second) : 0;
+    if (account_ && bytes > replaced && !account_->fits(bytes - replaced)) return;
+    entries_[key] = dets;
+    bytes_ = bytes_ - replaced + bytes;
+    if (account_) account_->set(bytes_);
+    dirty_ = true;
+}
+
+void DetectionCache::setAccount(std::unique_ptr<MemoryBudget::Account> account) {
+    std::lock_guard<std::mutex> lock(mu_);
+    account_ = std::move(account);
+    if (account_) account_->set(bytes_);
+}
+
+size_t DetectionCache::size() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return entries_.size();
+}
+
+int DetectionCache::hits() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return hits_;
+}
+
+int DetectionCache::misses() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return misses_;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kalman_filter.hpp"
+#include "memory_budget.hpp"
+
+/**
+ * Detections and ReID embeddings of frames, kept across runs
+ * (--detection-cache <file>).
+ *
+ * Entries are keyed by a hash of the decoded RGB frame, so a re-run over
+ * the same clip (say, to tune tracking or linking thresholds) finds every
+ * detection frame again without running SCRFD or MobileFaceNet, whatever
+ * the frame's index. The file as a whole belongs to one model key: the
+ * model files and every setting that shapes their output. A file made
+ * under another key is started afresh.
+ *
+ * find() and insert() may be called from several detection workers.
+ * Charged to a memory budget, the cache takes no new frames once they no
+ * longer fit it.
+ * The file is read whole; save() writes a temporary file and renames it
+ * over the old one.
+ */
+class DetectionCache {
+public:
+    /**
+     * 64-bit hash for frame and model keys: FNV-1a over 64-bit words, each
+     * step also folding the high bits down. Not split-invariant: the same
+     * calls in the same order give the same digest.
+     */
+    class Hasher {
+    public:
+        void bytes(const void* data, size_t n);
+        template <typename T>
+        void value(const T& v) {
+            bytes(&v, sizeof(T));
+        }
+        /** Contents of a file; false if it cannot be read. */
+        bool file(const std::string& path);
+        uint64_t digest() const { return h_; }
+
+    private:
+        uint64_t h_ = 1469598103934665603ull;
+    };
+
+    /** Key of one frame: its size and RGB pixels. */
+    static uint64_t FrameKey(const unsigned char* rgb, int width, int height);
+
+    explicit DetectionCache(uint64_t model_key) : model_key_(model_key) {}
+
+    /**
+     * Replace the contents with `path`. A missing file, or one made under
+     * another model key, is an empty cache.
+     *
+     * @return false (with `error`) if the file exists but cannot be read
+     */
+    bool load(const std::string& path, std::string& error);
+
+    /** Write the cache if anything was inserted since load(). */
+    bool save(const std::string& path, std::string& error) const;
+
+    /** Copy frame `key`'s detections into `out`; false (counted as a miss) if it has none. */
+    bool find(uint64_t key, std::vector<Detection>& out);
+    /** Same, not counted. */
+    bool get(uint64_t key, std::vector<Detection>& out) const;
+    void insert(uint64_t key, const std::vector<Detection>& dets);
+
+    /** Charge the entries in memory to `account` from now on. */
+    void setAccount(std::unique_ptr<MemoryBudget::Account> account);
+
+    size_t size() const;
+    int hits() const;
+    int misses() const;
+
+private:
+    uint64_t model_key_;
+    mutable std::mutex mu_;
+    std::unordered_map<uint64_t, std::vector<Detection>> entries_;
+    size_t bytes_ = 0;  // of entries_, roughly
+    std::unique_ptr<MemoryBudget::Account> account_;
+    bool dirty_ = false;
+    int hits_ = 0;
+    int misses_ = 0;
+};
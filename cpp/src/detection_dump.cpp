@@ -0,0 +1,144 @@
+#include "detection_dump.hpp"
+
+#include <cstring>
+
+namespace {
+constexpr char kMagic[8] = {'F', 'P', 'D', 'D', 'U', 'M', 'P', '1'};
+constexpr uint32_t kDumpVersion = 1;
+constexpr uint32_t kHasWarps = 1u;
+constexpr uint32_t kHasReid = 2u;
+constexpr uint32_t kMaxFacesPerFrame = 1 << 16;  // sanity bound on a file's records
+
+struct DumpHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    int32_t stride;
+    int32_t frame_count;
+    uint64_t records;
+};
+
+// Per-frame flags of a record.
+constexpr uint32_t kDuplicate = 1u;
+constexpr uint32_t kSceneCut = 2u;
+constexpr uint32_t kWarpOk = 4u;
+
+struct FrameRecord {
+    int32_t frame_index;
+    uint32_t flags;
+    int32_t width;
+    int32_t height;
+    uint32_t faces;
+};
+}  // namespace
+
+bool DetectionDump::load(const std::string& path, std::string& error) {
+    frames.clear();
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        error = "cannot open " + path;
+        return false;
+    }
+    CheckpointReader r(f);
+    const DumpHeader hdr = r.get<DumpHeader>();
+    bool ok = r.ok() && std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) == 0 && hdr.version == kDumpVersion &&
+              hdr.stride > 0 && hdr.frame_count >= 0 && hdr.records <= static_cast<uint64_t>(hdr.frame_count);
+    if (ok) {
+        warps = (hdr.flags & kHasWarps) != 0;
+        reid = (hdr.flags & kHasReid) != 0;
+        stride = hdr.stride;
+        frame_count = hdr.frame_count;
+        frames.reserve(static_cast<size_t>(hdr.records));
+    }
+    int last_index = -1;
+    for (uint64_t k = 0; ok && k < hdr.records; ++k) {
+        const FrameRecord rec = r.get<FrameRecord>();
+        if (!r.ok() || rec.frame_index <= last_index || rec.frame_index >= frame_count ||
+            rec.faces > kMaxFacesPerFrame) {
+            ok = false;
+            break;
+        }
+        last_index = rec.frame_index;
+        TrackerInputFrame frame;
+        frame.frame_index = rec.frame_index;
+        frame.duplicate = (rec.flags & kDuplicate) != 0;
+        frame.scene_cut = (rec.flags & kSceneCut) != 0;
+        frame.warp_ok = (rec.flags & kWarpOk) != 0;
+        frame.width = rec.width;
+        frame.height = rec.height;
+        if (warps) r.get(frame.warp);
+        frame.dets.resize(rec.faces);
+        for (Detection& d : frame.dets) LoadDetection(r, d);
+        ok = r.ok();
+        frames.push_back(std::move(frame));
+    }
+    std::fclose(f);
+    if (!ok) {
+        frames.clear();
+        error = path + " is not a detection dump (or is truncated)";
+    }
+    return ok;
+}
+
+DetectionDumpWriter::~DetectionDumpWriter() {
+    if (!f_) return;
+    std::fclose(f_);
+    std::remove((path_ + ".tmp").c_str());
+}
+
+bool DetectionDumpWriter::open(const std::string& path, bool warps, bool reid, int stride, std::string& error) {
+    path_ = path;
+    f_ = std::fopen((path + ".tmp").c_str(), "wb");
+    if (!f_) {
+        error = "cannot create " + path + ".tmp";
+        return false;
+    }
+    w_ = std::make_unique<CheckpointWriter>(f_);
+    warps_ = warps;
+    reid_ = reid;
+    stride_ = stride;
+    // Placeholder until finish() knows the counts.
+    w_->put(DumpHeader{});
+    return w_->ok();
+}
+
+void DetectionDumpWriter::write(const TrackerInputFrame& f, bool detection_frame) {
+    if (!f_ || (!warps_ && !detection_frame && f.dets.empty())) return;
+    if (!warps_ && f.duplicate) return;
+    FrameRecord rec{};
+    rec.frame_index = f.frame_index;
+    rec.flags = (f.duplicate ? kDuplicate : 0u) | (f.scene_cut ? kSceneCut : 0u) | (f.warp_ok ? kWarpOk : 0u);
+    rec.width = f.width;
+    rec.height = f.height;
+    rec.faces = static_cast<uint32_t>(f.dets.size());
+    w_->put(rec);
+    if (warps_) w_->put(f.warp);
+    for (const Detection& d : f.dets) SaveDetection(*w_, d);
+    records_++;
+}
+
+bool DetectionDumpWriter::finish(int frame_count, std::string& error) {
+    if (!f_) return false;
+    DumpHeader hdr{};
+    std::memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version = kDumpVersion;
+    hdr.flags = (warps_ ? kHasWarps : 0u) | (reid_ ? kHasReid : 0u);
+    hdr.stride = stride_;
+    hdr.frame_count = frame_count;
+    hdr.records = records_;
+    bool ok = std::fseek(f_, 0, SEEK_SET) == 0;
+    if (ok) w_->put(hdr);
+    ok = ok && w_->ok();
+    ok = (std::fclose(f_) == 0) && ok;
+    f_ = nullptr;
+    const std::string tmp = path_ + ".tmp";
+    if (ok) {
+        std::remove(path_.c_str());  // rename does not replace on Windows
+        ok = std::rename(tmp.c_str(), path_.c_str()) == 0;
+    }
+    if (!ok) {
+        std::remove(tmp.c_str());
+        error = "cannot write " + path_;
+    }
+    return ok;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "kalman_filter.hpp"
+#include "transform.hpp"
+
+/**
+ * Tracker input of one frame: the detections OCSort is given, the GMC warp
+ * into the frame, and how the frame fits in the sequence.
+ */
+struct TrackerInputFrame {
+    int frame_index = 0;
+    bool duplicate = false;  // repeats the previous frame's tracks
+    bool scene_cut = false;  // first frame of a shot
+    std::vector<Detection> dets;
+    Mat3f warp = Mat3f::Identity();
+    bool warp_ok = false;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * Recorded tracker input of a run (--dump-detections), replayed by
+ * --replay-detections without the detection and ReID models.
+ *
+ * A dump holds the detections with their embeddings and qualities. With
+ * warps it holds every frame instead, with its GMC warp and duplicate and
+ * scene cut flags, and replay runs no image code at all; without them it
+ * holds detection frames only, and replay decodes the frames again for
+ * GMC.
+ *
+ * Layout: a header, then one record per frame in ascending frame order.
+ * Like checkpoints, a dump is read back by the build that wrote it.
+ */
+struct DetectionDump {
+    bool warps = false;  // every frame, with GMC warps and flags
+    bool reid = false;   // detections carry embeddings
+    int stride = 1;      // detection stride of the recorded run
+    int frame_count = 0;
+    std::vector<TrackerInputFrame> frames;
+
+    /** @return false (with `error`) if `path` cannot be read */
+    bool load(const std::string& path, std::string& error);
+};
+
+class DetectionDumpWriter {
+public:
+    DetectionDumpWriter() = default;
+    ~DetectionDumpWriter();
+
+    DetectionDumpWriter(const DetectionDumpWriter&) = delete;
+    DetectionDumpWriter& operator=(const DetectionDumpWriter&) = delete;
+
+    /** Start writing `path` (through a temporary file, see finish()). */
+    bool open(const std::string& path, bool warps, bool reid, int stride, std::string& error);
+
+    /**
+     * Record a frame. Without warps only detection frames and frames with
+     * detections (ROI crops) are kept.
+     */
+    void write(const TrackerInputFrame& f, bool detection_frame);
+
+    /** Complete the header and rename the file into place. */
+    bool finish(int frame_count, std::string& error);
+
+    bool warps() const { return warps_; }
+
+private:
+    std::string path_;
+    FILE* f_ = nullptr;
+    std::unique_ptr<CheckpointWriter> w_;
+    bool warps_ = false;
+    bool reid_ = false;
+    int stride_ = 1;
+    uint64_t records_ = 0;
+};
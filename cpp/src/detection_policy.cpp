@@ -0,0 +1,87 @@
+#include "detection_policy.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+DetectionPolicy::DetectionPolicy(const DetectionPolicyOptions& options, int stride, float video_fps)
+    : options_(options) {
+    stride = std::max(1, stride);
+    max_interval_ = options_.max_interval > 0 ? options_.max_interval : 3 * stride;
+    // Without an explicit budget, spend at most what the fixed stride would.
+    refill_ = (options_.budget_fps > 0.0f && video_fps > 0.0f) ? options_.budget_fps / video_fps
+                                                                 : 1.0f / static_cast<float>(stride);
+    options_.burst = std::max(1.0f, options_.burst);
+    tokens_ = options_.burst;
+}
+
+void DetectionPolicy::observeWarp(const Mat3f& w, int frame_width, int frame_height) {
+    if (frame_width <= 0 || frame_height <= 0) return;
+    const float fw = static_cast<float>(frame_width);
+    const float fh = static_cast<float>(frame_height);
+    const float corners[4][2] = {{0.0f, 0.0f}, {fw, 0.0f}, {fw, fh}, {0.0f, fh}};
+    float travel = 0.0f;
+    for (const auto& c : corners) {
+        float z = w(2, 0) * c[0] + w(2, 1) * c[1] + w(2, 2);
+        if (std::fabs(z) < 1e-6f) z = 1e-6f;
+        const float x = (w(0, 0) * c[0] + w(0, 1) * c[1] + w(0, 2)) / z;
+        const float y = (w(1, 0) * c[0] + w(1, 1) * c[1] + w(1, 2)) / z;
+        travel = std::max(travel, std::hypot(x - c[0], y - c[1]));
+    }
+    camera_motion_ += travel / std::hypot(fw, fh);
+}
+
+float DetectionPolicy::urgency() const {
+    const float next = static_cast<float>(since_detection_ + 1);
+    float u = next / static_cast<float>(max_interval_);
+    if (options_.max_covariance_growth > 1.0f) {
+        u = std::max(u, (covariance_growth_ - 1.0f) / (options_.max_covariance_growth - 1.0f));
+    }
+    if (options_.max_drift > 0.0f) u = std::max(u, drift_ / options_.max_drift);
+    if (options_.max_confidence_decay > 0.0f) u = std::max(u, confidence_decay_ / options_.max_confidence_decay);
+    if (options_.max_camera_motion > 0.0f) u = std::max(u, camera_motion_ / options_.max_camera_motion);
+    return u;
+}
+
+bool DetectionPolicy::decide(bool force) {
+    tokens_ = std::min(options_.burst, tokens_ + refill_);
+    bool detect = force || since_detection_ + 1 >= max_interval_;
+    if (!detect && tokens_ >= 1.0f && urgency() >= 1.0f) {
+        detect = true;
+        urgent_detections_++;
+    }
+    if (!detect) {
+        since_detection_++;
+        return false;
+    }
+    // Forced detections are paid for too; the bucket may go into debt.
+    tokens_ -= 1.0f;
+    detections_++;
+    since_detection_ = 0;
+    camera_motion_ = 0.0f;
+    return true;
+}
+
+void DetectionPolicy::observeTracks(const std::vector<TrackResult>& tracks, bool detected) {
+    covariance_growth_ = 1.0f;
+    drift_ = 0.0f;
+    confidence_decay_ = 0.0f;
+    if (detected) std::fill(detected_confidence_.begin(), detected_confidence_.end(), 0.0f);
+    for (const TrackResult& t : tracks) {
+        // Tracks the last detection missed have left or are occluded; another
+        // detection would not find them either.
+        if (t.time_since_update > since_detection_) continue;
+        if (detected) {
+            const size_t id = static_cast<size_t>(t.track_id);
+            if (id >= detected_confidence_.size()) detected_confidence_.resize(id + 1, 0.0f);
+            detected_confidence_[id] = t.confidence;
+            continue;
+        }
+        covariance_growth_ = std::max(covariance_growth_, t.covariance_growth);
+        drift_ = std::max(drift_, t.drift);
+        const size_t id = static_cast<size_t>(t.track_id);
+        const float at_detection = id < detected_confidence_.size() ? detected_confidence_[id] : 0.0f;
+        if (at_detection > 0.0f) {
+            confidence_decay_ = std::max(confidence_decay_, 1.0f - t.confidence / at_detection);
+        }
+    }
+}
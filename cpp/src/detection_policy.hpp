@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+#include "ocsort.hpp"
+#include "transform.hpp"
+
+/**
+ * Options for adaptive detection scheduling (see DetectionPolicy).
+ *
+ * Each `max_*` limit is the point at which its signal alone asks for a
+ * detection.
+ */
+struct DetectionPolicyOptions {
+    bool enabled = false;            // off = fixed stride (detection_fps)
+    float budget_fps = 0.0f;         // average detector calls per second of video (0 = the fixed stride's rate)
+    float burst = 3.0f;              // detections the budget may save up for fast motion
+    int max_interval = 0;            // frames without detection before one is forced (0 = 3x the fixed stride)
+    float max_covariance_growth = 100.0f; // KF position variance growth since a track's last observation
+    float max_drift = 0.5f;          // predicted track travel since its last observation, in box sizes
+    float max_confidence_decay = 0.75f;  // relative loss of a track's confidence since the last detection
+    float max_camera_motion = 0.05f; // GMC corner travel since the last detection, fraction of the frame diagonal
+};
+
+/**
+ * Per-frame "detect now?" decision replacing the fixed detection stride.
+ *
+ * A fixed stride spends detector calls on static shots and under-samples
+ * fast pans. The policy instead looks at what the tracker already knows:
+ * Kalman covariance growth, predicted drift and confidence decay of the
+ * live tracks, time since the last detection, and the camera motion GMC
+ * measured. Each is normalized by its limit; the largest is the frame's
+ * urgency and the detector runs once it reaches 1.
+ *
+ * Urgent detections are paid for from a token bucket refilled at
+ * `budget_fps`, so the average cost never exceeds the budget. The first
+ * frame, the last frame and frames `max_interval` after the previous
+ * detection always detect (new faces are only found by detection).
+ */
+class DetectionPolicy {
+public:
+    /**
+     * @param stride Fixed detection stride the policy replaces (frames)
+     */
+    DetectionPolicy(const DetectionPolicyOptions& options, int stride, float video_fps);
+
+    /**
+     * Accumulate the camera motion between the previous and the current frame.
+     */
+    void observeWarp(const Mat3f& warp_prev_to_curr, int frame_width, int frame_height);
+
+    /**
+     * Decide whether the current frame runs the detector. Called once per
+     * frame, after observeWarp() and before the tracker update.
+     *
+     * @param force Detect regardless of urgency and budget (first/last frame)
+     */
+    bool decide(bool force);
+
+    /**
+     * Feed the tracker output of the current frame (read by the next decide()).
+     *
+     * @param detected Whether this frame ran the detector
+     */
+    void observeTracks(const std::vector<TrackResult>& tracks, bool detected);
+
+    /**
+     * Urgency of the next frame so far (>= 1 asks for a detection).
+     */
+    float urgency() const;
+
+    int detections() const { return detections_; }
+    int urgentDetections() const { return urgent_detections_; }
+
+private:
+    DetectionPolicyOptions options_;
+    int max_interval_ = 1;
+    float refill_ = 1.0f;  // tokens per frame
+    float tokens_ = 0.0f;
+
+    int since_detection_ = 0;            // frames since the last detection
+    float camera_motion_ = 0.0f;         // accumulated since the last detection
+    float covariance_growth_ = 1.0f;     // max over live tracks
+    float drift_ = 0.0f;                 // max over live tracks
+    float confidence_decay_ = 0.0f;      // max over live tracks
+    std::vector<float> detected_confidence_;  // by track id: confidence at its last detection frame (0 = none)
+
+    int detections_ = 0;
+    int urgent_detections_ = 0;
+};
@@ -0,0 +1,70 @@
+#include "detection_scheduler.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+DetectionScheduler::DetectionScheduler(int count, int workers, FrameCache::Loader decode, Detector detect,
+                                       Embedder embed, int first, MemoryBudget* budget, int max_workers)
+    : detect_(std::move(detect)),
+      embed_(std::move(embed)),
+      // Two frames in flight per worker keeps every worker busy while the
+      // tracker drains results in order.
+      prefetch_(count, workers, 2 * std::max({1, workers, max_workers}),
+                [this, decode = std::move(decode)](int j, LoadedRgbFrame& out) {
+                    if (!decode(j, out)) return false;
+                    std::vector<Detection> dets = detect_(out);
+                    std::lock_guard<std::mutex> lock(mu_);
+                    results_[j] = std::move(dets);
+                    return true;
+                },
+                first, budget ? budget->open("detection queue") : nullptr, max_workers) {
+    if (!embed_) return;
+    // A single thread takes detected frames in order (FramePrefetcher::take
+    // expects that); ExtractBatch already spreads one frame over the cores.
+    reid_stage_ = std::make_unique<FramePrefetcher>(count, 1, 2, [this](int j, LoadedRgbFrame& out) {
+        std::vector<Detection> dets;
+        const bool ok = takeDetected(j, out, dets);
+        if (ok && !dets.empty()) {
+            const auto start = std::chrono::steady_clock::now();
+            embed_(out, dets);
+            embed_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                               start).count();
+        }
+        std::lock_guard<std::mutex> lock(mu_);
+        embedded_[j] = std::move(dets);
+        return ok;
+    }, first, budget ? budget->open("reid queue") : nullptr);
+}
+
+bool DetectionScheduler::take(int j, LoadedRgbFrame& out, std::vector<Detection>& dets) {
+    if (!reid_stage_) return takeDetected(j, out, dets);
+    dets.clear();
+    const bool ok = reid_stage_->take(j, out);
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = embedded_.find(j);
+    if (it != embedded_.end()) {
+        dets = std::move(it->second);
+        embedded_.erase(it);
+    }
+    return ok;
+}
+
+bool DetectionScheduler::takeDetected(int j, LoadedRgbFrame& out, std::vector<Detection>& dets) {
+    dets.clear();
+    const bool ok = prefetch_.take(j, out);
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = results_.find(j);
+    if (it != results_.end()) {
+        dets = std::move(it->second);
+        results_.erase(it);
+    }
+    return ok;
+}
+
+int DetectionScheduler::ResolveWorkerCount(int requested) {
+    if (requested > 0) return requested;
+    // Half the cores as concurrent frames; ncnn threads split the rest.
+    const int hw = PipelineCoreCount();
+    return std::max(1, std::min(8, hw / 2));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_cache.hpp"
+#include "kalman_filter.hpp"
+#include "prefetcher.hpp"
+
+/**
+ * Runs detection on sampled frames ahead of the tracker, several at once.
+ *
+ * Detection frames are independent of each other; only tracking needs
+ * order. Each worker decodes one detection frame and runs the detector on
+ * it (every ScrfdDetector::Detect call creates its own ncnn::Extractor on
+ * the shared ncnn::Net). Results are handed back strictly in order together
+ * with the decoded frame, which the tracker still needs for GMC.
+ *
+ * With an embedder, ReID is a stage of its own: the workers only detect,
+ * and one more thread embeds the faces of finished frames in order while
+ * the workers detect the next ones. It stays at most two frames ahead of
+ * the tracker.
+ *
+ * Slots are indexed by detection ordinal `j` (0, 1, 2, ...), not by frame
+ * index; the caller's loader maps one to the other.
+ */
+class DetectionScheduler {
+public:
+    using Detector = std::function<std::vector<Detection>(const LoadedRgbFrame&)>;
+    using Embedder = std::function<void(const LoadedRgbFrame&, std::vector<Detection>&)>;
+
+    /**
+     * @param count Number of detection frames (INT_MAX for open-ended input)
+     * @param workers Frames decoded and detected concurrently
+     * @param decode Loader for detection ordinal `j`
+     * @param detect Detector run on each successfully decoded frame
+     * @param embed Optional ReID stage run on each frame's detections
+     * @param first First ordinal to detect (a resumed run starts past 0)
+     * @param budget Frames in flight are charged to it (nullptr = no budget)
+     * @param max_workers Workers setActiveWorkers() may wake (0 = `workers`)
+     */
+    DetectionScheduler(int count, int workers, FrameCache::Loader decode, Detector detect,
+                       Embedder embed = nullptr, int first = 0, MemoryBudget* budget = nullptr,
+                       int max_workers = 0);
+
+    /**
+     * Block until detection ordinal `j` is done; hand over its frame and detections.
+     *
+     * @return false if the frame could not be decoded
+     */
+    bool take(int j, LoadedRgbFrame& out, std::vector<Detection>& dets);
+
+    int numWorkers() const { return prefetch_.numThreads(); }
+    void setActiveWorkers(int n) { prefetch_.setActiveThreads(n); }
+    int activeWorkers() { return prefetch_.activeThreads(); }
+    int ready() { return prefetch_.ready(); }  // detected frames waiting (FramePrefetcher::ready)
+    bool hasReidStage() const { return reid_stage_ != nullptr; }
+    int embedReady() { return reid_stage_ ? reid_stage_->ready() : 0; }  // embedded frames waiting
+
+    /** Time the workers spent decoding and detecting, summed over them. */
+    double busyMs() const { return prefetch_.busyMs(); }
+    /** Time the ReID stage spent embedding. */
+    double embedBusyMs() const { return static_cast<double>(embed_ns_.load()) * 1e-6; }
+
+    /**
+     * Resolve a worker count (`requested <= 0` = auto).
+     */
+    static int ResolveWorkerCount(int requested);
+
+private:
+    bool takeDetected(int j, LoadedRgbFrame& out, std::vector<Detection>& dets);
+
+    Detector detect_;
+    Embedder embed_;
+    std::mutex mu_;
+    std::map<int, std::vector<Detection>> results_;
+    std::map<int, std::vector<Detection>> embedded_;
+    std::atomic<int64_t> embed_ns_{0};
+    FramePrefetcher prefetch_;  // declared after the members its workers use
+    std::unique_ptr<FramePrefetcher> reid_stage_;  // reads prefetch_; destroyed first
+};
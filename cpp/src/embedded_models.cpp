@@ -0,0 +1,18 @@
+#include "embedded_models.hpp"
+
+#if FACE_PIPELINE_EMBEDDED_MODELS
+// Generated at build time by tools/embed_models.cpp.
+#include "embedded_models_data.inc"
+#else
+namespace {
+const EmbeddedModel* const kEmbeddedModels = nullptr;
+constexpr size_t kEmbeddedModelCount = 0;
+}  // namespace
+#endif
+
+const EmbeddedModel* FindEmbeddedModel(const std::string& name) {
+    for (size_t i = 0; i < kEmbeddedModelCount; ++i) {
+        if (name == kEmbeddedModels[i].name) return &kEmbeddedModels[i];
+    }
+    return nullptr;
+}
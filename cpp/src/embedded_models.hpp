@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Model dir that names the models compiled into the binary
+ * (FACE_PIPELINE_EMBED_MODELS), e.g. `--model :builtin`. Paths below it
+ * ("<kBuiltinModelDir>/scrfd.param") work wherever model files are accepted.
+ */
+constexpr const char kBuiltinModelDir[] = ":builtin";
+
+/**
+ * An ncnn model held in memory.
+ */
+struct EmbeddedModel {
+    const char* name;          // file stem, e.g. "scrfd" or "mobilefacenet-opt"
+    const char* param;         // NUL-terminated text .param
+    const unsigned char* bin;  // weights, 16-byte aligned
+    size_t bin_size;
+};
+
+/**
+ * Embedded model with file stem `name`, or nullptr if the binary was built
+ * without it.
+ */
+const EmbeddedModel* FindEmbeddedModel(const std::string& name);
@@ -0,0 +1,192 @@
+#include "embedding.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+inline float clampf(float v, float lo, float hi) {
+    return std::max(lo, std::min(hi, v));
+}
+
+// IEEE half <-> float, round to nearest even.
+uint16_t FloatToHalf(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t abs = bits & 0x7fffffffu;
+    if (abs >= 0x7f800000u) {
+        return static_cast<uint16_t>(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u));  // inf / nan
+    }
+    if (abs >= 0x477ff000u) return static_cast<uint16_t>(sign | 0x7c00u);  // overflows to inf
+    if (abs < 0x38800000u) {
+        // Subnormal half (or zero): shift the mantissa with its implicit bit.
+        if (abs < 0x33000000u) return static_cast<uint16_t>(sign);
+        const uint32_t mant = (abs & 0x7fffffu) | 0x800000u;
+        const int shift = 126 - static_cast<int>(abs >> 23);
+        const uint32_t half = mant >> shift;
+        const uint32_t rest = mant & ((1u << shift) - 1u);
+        const uint32_t mid = 1u << (shift - 1);
+        const uint32_t round = (rest > mid || (rest == mid && (half & 1u))) ? 1u : 0u;
+        return static_cast<uint16_t>(sign | (half + round));
+    }
+    const uint32_t rebased = abs - 0x38000000u;  // exponent bias 127 -> 15
+    const uint32_t half = rebased >> 13;
+    const uint32_t rest = rebased & 0x1fffu;
+    const uint32_t round = (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) ? 1u : 0u;
+    return static_cast<uint16_t>(sign | (half + round));
+}
+
+float HalfToFloat(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+    const uint32_t exp = (h >> 10) & 0x1fu;
+    uint32_t mant = h & 0x3ffu;
+    uint32_t bits = 0;
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            // Subnormal: renormalize.
+            int e = -1;
+            do {
+                e++;
+                mant <<= 1;
+            } while ((mant & 0x400u) == 0);
+            bits = sign | static_cast<uint32_t>(127 - 15 - e) << 23 | (mant & 0x3ffu) << 13;
+        }
+    } else if (exp == 0x1f) {
+        bits = sign | 0x7f800000u | mant << 13;
+    } else {
+        bits = sign | (exp + 127 - 15) << 23 | mant << 13;
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+size_t WordsFor(EmbeddingStorage storage, int dim) {
+    const size_t n = static_cast<size_t>(std::max(0, dim));
+    return storage == EmbeddingStorage::F16    ? (n + 1) / 2
+           : storage == EmbeddingStorage::Int8 ? (n + 3) / 4
+                                               : n;
+}
+}  // namespace
+
+float CosineSimilarity(const EmbeddingF32& a, const EmbeddingF32& b) {
+    if (a.empty() || a.size() != b.size()) return 0.0f;
+    const double dot = DotF32(a.data(), b.data(), static_cast<int>(a.size()));
+    return clampf(static_cast<float>(dot), -1.0f, 1.0f);
+}
+
+void L2Normalize(EmbeddingF32& v) {
+    double ss = 0.0;
+    for (float x : v) ss += static_cast<double>(x) * static_cast<double>(x);
+    const double inv = 1.0 / (std::sqrt(ss) + 1e-12);
+    for (float& x : v) x = static_cast<float>(static_cast<double>(x) * inv);
+}
+
+const char* EmbeddingStorageName(EmbeddingStorage storage) {
+    switch (storage) {
+        case EmbeddingStorage::F16: return "f16";
+        case EmbeddingStorage::Int8: return "int8";
+        default: return "f32";
+    }
+}
+
+bool ParseEmbeddingStorage(const char* name, EmbeddingStorage& out) {
+    const EmbeddingStorage all[] = {EmbeddingStorage::F32, EmbeddingStorage::F16, EmbeddingStorage::Int8};
+    for (EmbeddingStorage s : all) {
+        if (name && std::strcmp(name, EmbeddingStorageName(s)) == 0) {
+            out = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+PackedEmbedding::PackedEmbedding(const EmbeddingF32& v, EmbeddingStorage storage) {
+    assign(v, storage);
+}
+
+void PackedEmbedding::assign(const EmbeddingF32& v, EmbeddingStorage storage) {
+    storage_ = storage;
+    dim_ = static_cast<int>(v.size());
+    scale_ = 1.0f;
+    words_.assign(WordsFor(storage, dim_), 0.0f);
+    switch (storage) {
+        case EmbeddingStorage::F16: {
+            uint16_t* halves = reinterpret_cast<uint16_t*>(words_.data());
+            for (int i = 0; i < dim_; ++i) halves[i] = FloatToHalf(v[i]);
+            break;
+        }
+        case EmbeddingStorage::Int8: {
+            // Symmetric, one scale per vector.
+            float max_abs = 0.0f;
+            for (float x : v) max_abs = std::max(max_abs, std::fabs(x));
+            scale_ = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+            int8_t* codes = reinterpret_cast<int8_t*>(words_.data());
+            for (int i = 0; i < dim_; ++i) {
+                codes[i] = static_cast<int8_t>(clampf(std::round(v[i] / scale_), -127.0f, 127.0f));
+            }
+            break;
+        }
+        default:
+            std::copy(v.begin(), v.end(), words_.begin());
+            break;
+    }
+}
+
+PackedEmbedding PackedEmbedding::FromPayload(EmbeddingStorage storage, int dim, float scale,
+                                             const unsigned char* bytes) {
+    PackedEmbedding out;
+    out.storage_ = storage;
+    out.dim_ = std::max(0, dim);
+    out.scale_ = scale;
+    out.words_.resize(WordsFor(storage, out.dim_));
+    std::memcpy(out.words_.data(), bytes, out.bytes());
+    return out;
+}
+
+size_t PackedEmbedding::PayloadBytes(EmbeddingStorage storage, int dim) {
+    return WordsFor(storage, dim) * sizeof(float);
+}
+
+size_t PackedEmbedding::bytes() const {
+    return words_.size() * sizeof(float);
+}
+
+EmbeddingF32 PackedEmbedding::unpack() const {
+    EmbeddingF32 out(static_cast<size_t>(dim_), 0.0f);
+    switch (storage_) {
+        case EmbeddingStorage::F16: {
+            const uint16_t* halves = reinterpret_cast<const uint16_t*>(words_.data());
+            for (int i = 0; i < dim_; ++i) out[i] = HalfToFloat(halves[i]);
+            break;
+        }
+        case EmbeddingStorage::Int8: {
+            const int8_t* codes = reinterpret_cast<const int8_t*>(words_.data());
+            for (int i = 0; i < dim_; ++i) out[i] = static_cast<float>(codes[i]) * scale_;
+            break;
+        }
+        default:
+            std::copy(words_.begin(), words_.end(), out.begin());
+            break;
+    }
+    return out;
+}
+
+float CosineSimilarity(const PackedEmbedding& a, const PackedEmbedding& b) {
+    if (a.empty() || a.dim_ != b.dim_) return 0.0f;
+    if (a.storage_ == EmbeddingStorage::Int8 && b.storage_ == EmbeddingStorage::Int8) {
+        const int32_t dot = DotI8(reinterpret_cast<const int8_t*>(a.words_.data()),
+                                  reinterpret_cast<const int8_t*>(b.words_.data()), a.dim_);
+        return clampf(static_cast<float>(dot) * a.scale_ * b.scale_, -1.0f, 1.0f);
+    }
+    if (a.storage_ == EmbeddingStorage::F32 && b.storage_ == EmbeddingStorage::F32) {
+        const double dot = DotF32(a.words_.data(), b.words_.data(), a.dim_);
+        return clampf(static_cast<float>(dot), -1.0f, 1.0f);
+    }
+    return CosineSimilarity(a.unpack(), b.unpack());
+}
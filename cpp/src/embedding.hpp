@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * A ReID embedding. Its length is the ReID model's output size, known at
+ * run time (128 for the bundled MobileFaceNet, 512 for larger ArcFace
+ * models); empty means no embedding.
+ */
+using EmbeddingF32 = std::vector<float>;
+
+/**
+ * Cosine similarity of two L2-normalized embeddings (their dot product,
+ * clamped to [-1, 1] for numerical safety); 0 if the lengths differ.
+ */
+float CosineSimilarity(const EmbeddingF32& a, const EmbeddingF32& b);
+
+/** Scale `v` to unit length in place. */
+void L2Normalize(EmbeddingF32& v);
+
+/**
+ * How long-lived embeddings (track appearances kept for offline linking)
+ * are stored. The vectors are L2-normalized, so reduced precision costs
+ * little: F16 moves cosine similarities by ~1e-4, Int8 (one scale per
+ * vector) by a few 1e-3.
+ */
+enum class EmbeddingStorage {
+    F32,   // 4 bytes per dimension
+    F16,   // 2 bytes per dimension
+    Int8,  // 1 byte per dimension + scale
+};
+
+const char* EmbeddingStorageName(EmbeddingStorage storage);
+
+/** Parse "f32" / "f16" / "int8"; false (and `out` untouched) otherwise. */
+bool ParseEmbeddingStorage(const char* name, EmbeddingStorage& out);
+
+/**
+ * An embedding in one of the EmbeddingStorage formats.
+ */
+class PackedEmbedding {
+public:
+    PackedEmbedding() = default;
+    explicit PackedEmbedding(const EmbeddingF32& v, EmbeddingStorage storage = EmbeddingStorage::F32);
+
+    /** Repack to `v`, reusing the payload's buffer. */
+    void assign(const EmbeddingF32& v, EmbeddingStorage storage = EmbeddingStorage::F32);
+
+    /** Drop the payload and its memory. */
+    void release() {
+        dim_ = 0;
+        std::vector<float>().swap(words_);
+    }
+
+    bool empty() const { return dim_ == 0; }
+    int dim() const { return dim_; }
+    EmbeddingStorage storage() const { return storage_; }
+
+    /** Payload size in bytes. */
+    size_t bytes() const;
+
+    /** Payload size of a `dim`-dimensional embedding stored as `storage`. */
+    static size_t PayloadBytes(EmbeddingStorage storage, int dim);
+
+    /** Raw payload (bytes() long) and Int8 scale, for serialization. */
+    const unsigned char* payload() const { return reinterpret_cast<const unsigned char*>(words_.data()); }
+    float scale() const { return scale_; }
+
+    /** Inverse of payload()/scale(): `bytes` holds PayloadBytes(storage, dim) bytes. */
+    static PackedEmbedding FromPayload(EmbeddingStorage storage, int dim, float scale, const unsigned char* bytes);
+
+    EmbeddingF32 unpack() const;
+
+    /**
+     * CosineSimilarity() of the stored vectors (0 if their dimensions
+     * differ). Int8 pairs stay in integers (DotI8); other pairs are
+     * compared in float.
+     */
+    friend float CosineSimilarity(const PackedEmbedding& a, const PackedEmbedding& b);
+
+private:
+    EmbeddingStorage storage_ = EmbeddingStorage::F32;
+    int dim_ = 0;
+    float scale_ = 1.0f;  // Int8: value = code * scale_
+    // Float words, so the F32 payload is readable in place; F16 halves and
+    // Int8 codes are packed into their bytes.
+    std::vector<float> words_;
+};
@@ -0,0 +1,446 @@
+#include "evaluation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "json_reader.hpp"
+#include "json_writer.hpp"
+#include "lapjv.hpp"
+
+namespace {
+constexpr double kEps = 1e-9;
+constexpr float kMatchIou = 0.5f;  // CLEAR and Identity match threshold
+
+double Alpha(int a) { return 0.05 * (a + 1); }
+
+// `path` as seen from `dir` (unchanged if absolute).
+std::string Resolve(const std::string& dir, const std::string& path) {
+    if (dir.empty() || path.empty() || path[0] == '/' || path[0] == '\\' ||
+        (path.size() > 1 && path[1] == ':')) {
+        return path;
+    }
+    return dir + "/" + path;
+}
+
+std::string DirName(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash);
+}
+
+// A frame's boxes with their dense ID indices.
+struct FrameBoxes {
+    std::vector<int> ids;
+    std::vector<BBox> boxes;
+};
+
+// Row-major IoU of every (gt, tracker) pair of a frame.
+void Similarity(const FrameBoxes& gt, const FrameBoxes& tr, std::vector<double>& sim) {
+    sim.resize(gt.boxes.size() * tr.boxes.size());
+    for (size_t g = 0; g < gt.boxes.size(); ++g) {
+        for (size_t t = 0; t < tr.boxes.size(); ++t) {
+            sim[g * tr.boxes.size() + t] = gt.boxes[g].iou(tr.boxes[t]);
+        }
+    }
+}
+
+// Pairs of the maximum-`score` assignment of a rows x cols matrix
+// (row-major) that score above zero.
+void MaxAssignment(LapjvSolver& solver, const std::vector<double>& score, int rows, int cols,
+                   std::vector<std::pair<int, int>>& pairs) {
+    pairs.clear();
+    if (rows == 0 || cols == 0) return;
+    std::vector<double> cost(static_cast<size_t>(rows) * cols);
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) cost[r + static_cast<size_t>(rows) * c] = -score[static_cast<size_t>(r) * cols + c];
+    }
+    std::vector<int> assignment;
+    solver.solve(cost.data(), rows, cols, assignment);
+    for (int r = 0; r < rows; ++r) {
+        const int c = assignment[r];
+        if (c >= 0 && score[static_cast<size_t>(r) * cols + c] > kEps) pairs.emplace_back(r, c);
+    }
+}
+
+bool ReportNumber(const Json& object, const char* key, double& value) {
+    const Json* v = object.get(key);
+    if (!v || v->type != Json::Type::Number) return false;
+    value = v->number;
+    return true;
+}
+
+void WriteClipFields(JsonWriter& w, const std::string& name, const MotCounts& m, int frames, int tracks,
+                     double seconds, const std::array<double, static_cast<size_t>(ProfileStage::Count)>& stage_ms,
+                     size_t peak_rss) {
+    w.raw("\"name\": ").string(name).raw(", \"frames\": ").integer(frames);
+    w.raw(", \"gtIds\": ").integer(static_cast<int64_t>(m.gt_ids)).raw(", \"tracks\": ").integer(tracks);
+    w.raw(",\n     \"hota\": ").fixed(m.hota(), 4).raw(", \"detA\": ").fixed(m.detA(), 4);
+    w.raw(", \"assA\": ").fixed(m.assA(), 4).raw(", \"idf1\": ").fixed(m.idf1(), 4);
+    w.raw(", \"mota\": ").fixed(m.mota(), 4).raw(", \"motp\": ").fixed(m.motp(), 4);
+    w.raw(", \"idSwitches\": ").integer(static_cast<int64_t>(m.id_switches));
+    w.raw(", \"falsePositives\": ").integer(static_cast<int64_t>(m.clr_fp));
+    w.raw(", \"misses\": ").integer(static_cast<int64_t>(m.clr_fn));
+    w.raw(",\n     \"seconds\": ").fixed(seconds, 3);
+    w.raw(", \"framesPerSecond\": ").fixed(seconds > 0.0 ? frames / seconds : 0.0, 2);
+    w.raw(", \"peakRssMb\": ").fixed(static_cast<double>(peak_rss) / (1024.0 * 1024.0), 1);
+    w.raw(", \"stagesMs\": {");
+    for (int s = 0; s < static_cast<int>(ProfileStage::Count); ++s) {
+        w.raw(s > 0 ? ", \"" : "\"").raw(ProfileStageName(static_cast<ProfileStage>(s))).raw("\": ");
+        w.fixed(stage_ms[static_cast<size_t>(s)], 1);
+    }
+    w.ch('}');
+}
+}  // namespace
+
+bool LoadMotGroundTruth(const std::string& path, int frame_width, int frame_height,
+                        std::vector<std::vector<GroundTruthBox>>& frames, std::string& error) {
+    frames.clear();
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (frame_width <= 0 || frame_height <= 0) {
+        error = "no frame size to normalize " + path + " by";
+        return false;
+    }
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line)) {
+        line_no++;
+        if (line.empty() || line[0] == '#' || line == "\r") continue;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        double frame = 0, id = 0, left = 0, top = 0, w = 0, h = 0, flag = 1;
+        if (!(fields >> frame >> id >> left >> top >> w >> h) || frame < 1) {
+            error = path + ":" + std::to_string(line_no) + ": expected frame,id,left,top,width,height";
+            return false;
+        }
+        if ((fields >> flag) && flag == 0) continue;
+        const size_t f = static_cast<size_t>(frame) - 1;
+        if (f >= frames.size()) frames.resize(f + 1);
+        const float fw = static_cast<float>(frame_width);
+        const float fh = static_cast<float>(frame_height);
+        frames[f].push_back(GroundTruthBox{static_cast<int>(id),
+                                           BBox{static_cast<float>(left) / fw, static_cast<float>(top) / fh,
+                                                static_cast<float>(left + w) / fw, static_cast<float>(top + h) / fh}});
+    }
+    return true;
+}
+
+void MotCounts::add(const MotCounts& o) {
+    for (int a = 0; a < kAlphas; ++a) {
+        hota_tp[a] += o.hota_tp[a];
+        hota_fn[a] += o.hota_fn[a];
+        hota_fp[a] += o.hota_fp[a];
+        hota_ass[a] += o.hota_ass[a];
+    }
+    clr_tp += o.clr_tp;
+    clr_fn += o.clr_fn;
+    clr_fp += o.clr_fp;
+    id_switches += o.id_switches;
+    motp_sum += o.motp_sum;
+    idtp += o.idtp;
+    idfn += o.idfn;
+    idfp += o.idfp;
+    gt_ids += o.gt_ids;
+    tracker_ids += o.tracker_ids;
+}
+
+double MotCounts::detA() const {
+    double sum = 0.0;
+    for (int a = 0; a < kAlphas; ++a) sum += hota_tp[a] / std::max(1.0, hota_tp[a] + hota_fn[a] + hota_fp[a]);
+    return sum / kAlphas;
+}
+
+double MotCounts::assA() const {
+    double sum = 0.0;
+    for (int a = 0; a < kAlphas; ++a) sum += hota_ass[a] / std::max(1.0, hota_tp[a]);
+    return sum / kAlphas;
+}
+
+double MotCounts::hota() const {
+    double sum = 0.0;
+    for (int a = 0; a < kAlphas; ++a) {
+        const double det = hota_tp[a] / std::max(1.0, hota_tp[a] + hota_fn[a] + hota_fp[a]);
+        const double ass = hota_ass[a] / std::max(1.0, hota_tp[a]);
+        sum += std::sqrt(det * ass);
+    }
+    return sum / kAlphas;
+}
+
+MotCounts EvaluateTracks(const std::vector<std::vector<GroundTruthBox>>& ground_truth,
+                         const std::vector<FaceTrack>& tracks, int frame_count) {
+    MotCounts m;
+    const size_t n_frames = static_cast<size_t>(std::max(0, frame_count));
+    std::vector<FrameBoxes> gt(n_frames), tr(n_frames);
+    std::map<int, int> gt_index;
+    for (size_t f = 0; f < std::min(n_frames, ground_truth.size()); ++f) {
+        for (const GroundTruthBox& b : ground_truth[f]) {
+            const int dense = gt_index.emplace(b.id, static_cast<int>(gt_index.size())).first->second;
+            gt[f].ids.push_back(dense);
+            gt[f].boxes.push_back(b.bbox);
+        }
+    }
+    int n_tr = 0;
+    for (const FaceTrack& track : tracks) {
+        bool any = false;
+        for (const TrackFrame& frame : track.frames) {
+            if (frame.frame_index < 0 || static_cast<size_t>(frame.frame_index) >= n_frames) continue;
+            tr[frame.frame_index].ids.push_back(n_tr);
+            tr[frame.frame_index].boxes.push_back(frame.bbox);
+            any = true;
+        }
+        if (any) n_tr++;
+    }
+    const int n_gt = static_cast<int>(gt_index.size());
+    m.gt_ids = n_gt;
+    m.tracker_ids = n_tr;
+    const size_t pairs = static_cast<size_t>(n_gt) * n_tr;
+
+    // First pass: each ID pair's overall alignment (HOTA) and its frames
+    // matched at IoU 0.5 (Identity).
+    std::vector<double> potential(pairs, 0.0), id_matches(pairs, 0.0);
+    std::vector<double> gt_count(n_gt, 0.0), tr_count(n_tr, 0.0);
+    std::vector<double> sim;
+    double gt_boxes = 0, tr_boxes = 0;
+    for (size_t f = 0; f < n_frames; ++f) {
+        const size_t ng = gt[f].ids.size();
+        const size_t nt = tr[f].ids.size();
+        gt_boxes += ng;
+        tr_boxes += nt;
+        for (int id : gt[f].ids) gt_count[id] += 1;
+        for (int id : tr[f].ids) tr_count[id] += 1;
+        if (ng == 0 || nt == 0) continue;
+        Similarity(gt[f], tr[f], sim);
+        std::vector<double> row_sum(ng, 0.0), col_sum(nt, 0.0);
+        for (size_t g = 0; g < ng; ++g) {
+            for (size_t t = 0; t < nt; ++t) {
+                row_sum[g] += sim[g * nt + t];
+                col_sum[t] += sim[g * nt + t];
+            }
+        }
+        for (size_t g = 0; g < ng; ++g) {
+            for (size_t t = 0; t < nt; ++t) {
+                const double s = sim[g * nt + t];
+                const double denom = row_sum[g] + col_sum[t] - s;
+                const size_t k = static_cast<size_t>(gt[f].ids[g]) * n_tr + tr[f].ids[t];
+                if (denom > kEps) potential[k] += s / denom;
+                if (s >= kMatchIou - kEps) id_matches[k] += 1;
+            }
+        }
+    }
+    std::vector<double> alignment(pairs, 0.0);
+    for (int g = 0; g < n_gt; ++g) {
+        for (int t = 0; t < n_tr; ++t) {
+            const size_t k = static_cast<size_t>(g) * n_tr + t;
+            alignment[k] = potential[k] / std::max(kEps, gt_count[g] + tr_count[t] - potential[k]);
+        }
+    }
+
+    // Second pass: per-frame matching for HOTA (by alignment x IoU) and
+    // CLEAR (IoU >= 0.5, keeping the previous frame's matches).
+    LapjvSolver solver;
+    std::vector<std::vector<int>> hota_matches(MotCounts::kAlphas, std::vector<int>(pairs, 0));
+    std::vector<int> prev_tracker(n_gt, -1), last_tracker(n_gt, -1);
+    std::vector<double> score;
+    std::vector<std::pair<int, int>> matched;
+    for (size_t f = 0; f < n_frames; ++f) {
+        const int ng = static_cast<int>(gt[f].ids.size());
+        const int nt = static_cast<int>(tr[f].ids.size());
+        if (ng == 0 || nt == 0) {
+            for (int a = 0; a < MotCounts::kAlphas; ++a) {
+                m.hota_fn[a] += ng;
+                m.hota_fp[a] += nt;
+            }
+            m.clr_fn += ng;
+            m.clr_fp += nt;
+            continue;
+        }
+        Similarity(gt[f], tr[f], sim);
+        score.resize(sim.size());
+        for (int g = 0; g < ng; ++g) {
+            for (int t = 0; t < nt; ++t) {
+                const size_t k = static_cast<size_t>(gt[f].ids[g]) * n_tr + tr[f].ids[t];
+                score[static_cast<size_t>(g) * nt + t] = alignment[k] * sim[static_cast<size_t>(g) * nt + t];
+            }
+        }
+        MaxAssignment(solver, score, ng, nt, matched);
+        for (int a = 0; a < MotCounts::kAlphas; ++a) {
+            int tp = 0;
+            for (const auto& p : matched) {
+                if (sim[static_cast<size_t>(p.first) * nt + p.second] < Alpha(a) - kEps) continue;
+                tp++;
+                hota_matches[a][static_cast<size_t>(gt[f].ids[p.first]) * n_tr + tr[f].ids[p.second]]++;
+            }
+            m.hota_tp[a] += tp;
+            m.hota_fn[a] += ng - tp;
+            m.hota_fp[a] += nt - tp;
+        }
+
+        for (int g = 0; g < ng; ++g) {
+            for (int t = 0; t < nt; ++t) {
+                const double s = sim[static_cast<size_t>(g) * nt + t];
+                const bool kept = prev_tracker[gt[f].ids[g]] == tr[f].ids[t];
+                score[static_cast<size_t>(g) * nt + t] = s >= kMatchIou - kEps ? s + (kept ? 1000.0 : 0.0) : 0.0;
+            }
+        }
+        MaxAssignment(solver, score, ng, nt, matched);
+        std::fill(prev_tracker.begin(), prev_tracker.end(), -1);
+        for (const auto& p : matched) {
+            const int g = gt[f].ids[p.first];
+            const int t = tr[f].ids[p.second];
+            if (last_tracker[g] >= 0 && last_tracker[g] != t) m.id_switches += 1;
+            last_tracker[g] = t;
+            prev_tracker[g] = t;
+            m.motp_sum += sim[static_cast<size_t>(p.first) * nt + p.second];
+        }
+        m.clr_tp += matched.size();
+        m.clr_fn += ng - static_cast<int>(matched.size());
+        m.clr_fp += nt - static_cast<int>(matched.size());
+    }
+    for (int a = 0; a < MotCounts::kAlphas; ++a) {
+        for (int g = 0; g < n_gt; ++g) {
+            for (int t = 0; t < n_tr; ++t) {
+                const double c = hota_matches[a][static_cast<size_t>(g) * n_tr + t];
+                if (c > 0) m.hota_ass[a] += c * c / std::max(1.0, gt_count[g] + tr_count[t] - c);
+            }
+        }
+    }
+
+    // Identity: the one-to-one ID pairing that matches the most boxes.
+    MaxAssignment(solver, id_matches, n_gt, n_tr, matched);
+    for (const auto& p : matched) m.idtp += id_matches[static_cast<size_t>(p.first) * n_tr + p.second];
+    m.idfn = gt_boxes - m.idtp;
+    m.idfp = tr_boxes - m.idtp;
+    return m;
+}
+
+bool LoadEvalManifest(const std::string& path, std::vector<EvalClip>& clips, std::string& error) {
+    clips.clear();
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const std::string dir = DirName(path);
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line)) {
+        line_no++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        const std::string where = path + ":" + std::to_string(line_no) + ": ";
+        Json clip;
+        if (!JsonParser(line).parse(clip) || clip.type != Json::Type::Object) {
+            error = where + "not a JSON object";
+            return false;
+        }
+        const Json* name = clip.get("name");
+        const Json* images = clip.get("imagesFile");
+        const Json* gt = clip.get("groundTruth");
+        if (!images || images->type != Json::Type::String || !gt || gt->type != Json::Type::String) {
+            error = where + "a clip needs \"imagesFile\" and \"groundTruth\"";
+            return false;
+        }
+        EvalClip c;
+        c.name = name && name->type == Json::Type::String ? name->text : "clip" + std::to_string(clips.size());
+        c.images_file = Resolve(dir, images->text);
+        c.ground_truth = Resolve(dir, gt->text);
+        double fps = 0.0;
+        if (ReportNumber(clip, "videoFps", fps) && fps > 0.0) c.video_fps = static_cast<float>(fps);
+        clips.push_back(std::move(c));
+    }
+    if (clips.empty()) {
+        error = path + " lists no clips";
+        return false;
+    }
+    return true;
+}
+
+bool WriteEvalReport(FILE* out, const std::vector<EvalClipReport>& clips, const std::vector<std::string>& regressions) {
+    JsonWriter w(out);
+    MotCounts total;
+    int frames = 0, tracks = 0;
+    double seconds = 0.0;
+    size_t peak_rss = 0;
+    std::array<double, static_cast<size_t>(ProfileStage::Count)> stage_ms{};
+    w.raw("{\n  \"clips\": [");
+    for (size_t c = 0; c < clips.size(); ++c) {
+        const EvalClipReport& r = clips[c];
+        w.raw(c > 0 ? ",\n    {" : "\n    {");
+        WriteClipFields(w, r.name, r.counts, r.frames, r.tracks, r.seconds, r.stage_ms, r.peak_rss);
+        w.ch('}');
+        total.add(r.counts);
+        frames += r.frames;
+        tracks += r.tracks;
+        seconds += r.seconds;
+        peak_rss = std::max(peak_rss, r.peak_rss);
+        for (size_t s = 0; s < stage_ms.size(); ++s) stage_ms[s] += r.stage_ms[s];
+    }
+    w.raw("\n  ],\n  \"overall\": {");
+    WriteClipFields(w, "overall", total, frames, tracks, seconds, stage_ms, peak_rss);
+    w.raw("},\n  \"regressions\": [");
+    for (size_t k = 0; k < regressions.size(); ++k) {
+        w.raw(k > 0 ? ", " : "").string(regressions[k]);
+    }
+    w.raw("],\n  \"passed\": ").raw(regressions.empty() ? "true" : "false").raw("\n}\n");
+    return w.flush();
+}
+
+bool CompareEvalBaseline(const std::string& baseline_path, const std::vector<EvalClipReport>& clips,
+                         const EvalTolerance& tolerance, std::vector<std::string>& regressions, std::string& error) {
+    regressions.clear();
+    std::ifstream file(baseline_path);
+    if (!file.is_open()) {
+        error = "cannot open " + baseline_path;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    const std::string json = text.str();
+    Json baseline;
+    if (!JsonParser(json).parse(baseline) || baseline.type != Json::Type::Object) {
+        error = baseline_path + " is not an evaluation report";
+        return false;
+    }
+
+    auto check = [&](const std::string& name, const Json& base, const MotCounts& m, double fps) {
+        const std::pair<const char*, double> metrics[] = {{"hota", m.hota()}, {"idf1", m.idf1()}, {"mota", m.mota()}};
+        char line[160];
+        for (const auto& metric : metrics) {
+            double was = 0.0;
+            if (ReportNumber(base, metric.first, was) && metric.second < was - tolerance.metric) {
+                std::snprintf(line, sizeof(line), "%s: %s %.4f -> %.4f", name.c_str(), metric.first, was,
+                              metric.second);
+                regressions.push_back(line);
+            }
+        }
+        double was_fps = 0.0;
+        if (ReportNumber(base, "framesPerSecond", was_fps) && fps < was_fps * (1.0 - tolerance.fps)) {
+            std::snprintf(line, sizeof(line), "%s: framesPerSecond %.2f -> %.2f", name.c_str(), was_fps, fps);
+            regressions.push_back(line);
+        }
+    };
+
+    MotCounts total;
+    int frames = 0;
+    double seconds = 0.0;
+    const Json* base_clips = baseline.get("clips");
+    for (const EvalClipReport& r : clips) {
+        total.add(r.counts);
+        frames += r.frames;
+        seconds += r.seconds;
+        if (!base_clips || base_clips->type != Json::Type::Array) continue;
+        for (const Json& base : base_clips->items) {
+            const Json* name = base.get("name");
+            if (name && name->type == Json::Type::String && name->text == r.name) check(r.name, base, r.counts, r.fps());
+        }
+    }
+    if (const Json* overall = baseline.get("overall")) {
+        check("overall", *overall, total, seconds > 0.0 ? frames / seconds : 0.0);
+    }
+    return true;
+}
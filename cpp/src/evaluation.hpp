@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pipeline.hpp"
+#include "stage_profile.hpp"
+
+/**
+ * Tracking accuracy against annotations (--evaluate): MOTChallenge ground
+ * truth, scored the way TrackEval scores it (HOTA, CLEAR MOTA/MOTP and
+ * IDF1), so numbers stay comparable with published ones.
+ */
+
+/** One annotated face on a frame, normalized like the pipeline's boxes. */
+struct GroundTruthBox {
+    int id;
+    BBox bbox;
+};
+
+/**
+ * Read a MOTChallenge gt.txt: "frame,id,left,top,width,height[,flag,...]"
+ * a line, frames from 1, boxes in pixels of `frame_width` x
+ * `frame_height`. Lines whose flag is 0 (ignored regions) are left out.
+ *
+ * @param frames Boxes per frame, from frame 0 (= the file's frame 1)
+ * @return false (with `error`) if the file cannot be read or a line is malformed
+ */
+bool LoadMotGroundTruth(const std::string& path, int frame_width, int frame_height,
+                        std::vector<std::vector<GroundTruthBox>>& frames, std::string& error);
+
+/**
+ * Matching counts of one or more sequences. Counts of several sequences add
+ * up, and the metrics of the sum are those of the sequences combined.
+ */
+struct MotCounts {
+    static constexpr int kAlphas = 19;  // HOTA localization thresholds 0.05, 0.10 ... 0.95
+
+    std::array<double, kAlphas> hota_tp{}, hota_fn{}, hota_fp{};
+    std::array<double, kAlphas> hota_ass{};  // per alpha: sum over true positives of their association accuracy
+    double clr_tp = 0, clr_fn = 0, clr_fp = 0, id_switches = 0;
+    double motp_sum = 0;  // IoU summed over CLEAR true positives
+    double idtp = 0, idfn = 0, idfp = 0;
+    double gt_ids = 0, tracker_ids = 0;
+
+    void add(const MotCounts& other);
+
+    double detA() const;
+    double assA() const;
+    double hota() const;
+    double mota() const { return clr_tp + clr_fn > 0 ? (clr_tp - clr_fp - id_switches) / (clr_tp + clr_fn) : 0.0; }
+    double motp() const { return clr_tp > 0 ? motp_sum / clr_tp : 0.0; }
+    double idf1() const { return idtp > 0 ? idtp / (idtp + 0.5 * idfp + 0.5 * idfn) : 0.0; }
+};
+
+/**
+ * Score `tracks` (as FacePipeline::process() returns them) against the
+ * ground truth of frames 0 .. frame_count - 1.
+ */
+MotCounts EvaluateTracks(const std::vector<std::vector<GroundTruthBox>>& ground_truth,
+                         const std::vector<FaceTrack>& tracks, int frame_count);
+
+/**
+ * A clip of an evaluation manifest: one JSON object a line with "name",
+ * "imagesFile" (one frame path a line), "groundTruth" (gt.txt) and
+ * optionally "videoFps". Relative paths are taken from the manifest's
+ * directory.
+ */
+struct EvalClip {
+    std::string name;
+    std::string images_file;
+    std::string ground_truth;
+    float video_fps = 30.0f;
+};
+
+/** @return false (with `error`) if the manifest cannot be read or a line is not a clip */
+bool LoadEvalManifest(const std::string& path, std::vector<EvalClip>& clips, std::string& error);
+
+/** What one clip's run scored and cost. */
+struct EvalClipReport {
+    std::string name;
+    int frames = 0;
+    int tracks = 0;
+    MotCounts counts;
+    double seconds = 0.0;  // FacePipeline::process(), models loaded
+    std::array<double, static_cast<size_t>(ProfileStage::Count)> stage_ms{};
+    size_t peak_rss = 0;  // of the process once the clip is done, bytes (0 = unknown)
+
+    double fps() const { return seconds > 0.0 ? frames / seconds : 0.0; }
+};
+
+/** Limits a run may fall short of its baseline by. */
+struct EvalTolerance {
+    double metric = 0.01;  // largest drop of HOTA, IDF1 or MOTA (absolute)
+    double fps = 0.25;     // largest drop of frames per second (fraction of the baseline's)
+};
+
+/**
+ * Write the report as JSON: per clip and over all clips the metrics,
+ * frames per second, stage milliseconds and peak memory, then
+ * `regressions` (from CompareEvalBaseline) and "passed". A saved report
+ * is the next run's baseline.
+ *
+ * @return false if `out` fails
+ */
+bool WriteEvalReport(FILE* out, const std::vector<EvalClipReport>& clips, const std::vector<std::string>& regressions);
+
+/**
+ * Compare against an earlier report (WriteEvalReport): each clip of the
+ * same name, and the overall figures, may not lose more than `tolerance`.
+ *
+ * @param regressions One line per metric that did, e.g. "crowd: idf1 0.812 -> 0.771"
+ * @return false (with `error`) if the baseline cannot be read
+ */
+bool CompareEvalBaseline(const std::string& baseline_path, const std::vector<EvalClipReport>& clips,
+                         const EvalTolerance& tolerance, std::vector<std::string>& regressions, std::string& error);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+/**
+ * A detected face in frame pixels: box (x1, y1, x2, y2), confidence and the
+ * 5 keypoints (eyes, nose, mouth corners; zero when the model has none).
+ */
+struct ScrfdFace {
+    std::array<float, 4> bbox;
+    float score = 0.0f;
+    std::array<std::array<float, 2>, 5> landmarks{};
+};
+
+/**
+ * A face detector backend: SCRFD (scrfd.hpp), or one of the ultra-light
+ * models behind the hybrid schedule (light_detector.hpp). The pipeline's
+ * main detector stays a ScrfdDetector, whose tiles, regions and stride
+ * pruning go beyond this interface.
+ */
+class FaceDetector {
+public:
+    virtual ~FaceDetector() = default;
+
+    virtual bool IsLoaded() const = 0;
+
+    /** Short backend name for logs and metrics ("scrfd", "yunet"). */
+    virtual const char* Name() const = 0;
+
+    /**
+     * Detect faces in an interleaved RGB frame, after NMS. Safe to call
+     * concurrently.
+     */
+    virtual std::vector<ScrfdFace> DetectFaces(const unsigned char* rgb, int width, int height) const = 0;
+};
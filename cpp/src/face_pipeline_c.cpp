@@ -0,0 +1,271 @@
+#include "face_pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "frame_source.hpp"
+#include "pipeline.hpp"
+
+struct FpPipeline {
+    std::unique_ptr<FacePipeline> pipeline;
+};
+
+struct FpResult {
+    int frame_count = 0;
+    bool stopped = false;
+    std::vector<FpTrack> tracks;
+    std::vector<std::vector<FpTrackFrame>> frames;  // of each track
+};
+
+namespace {
+thread_local std::string g_last_error;
+
+void SetError(const std::string& message) { g_last_error = message; }
+
+// A struct from the caller holds at least the fields of version 1.
+template <typename T>
+bool SizeOk(const T* p, size_t v1_size, const char* what) {
+    if (p != nullptr && p->struct_size >= v1_size) return true;
+    SetError(std::string(what) + " is missing or has a bad struct_size");
+    return false;
+}
+
+RawPixelFormat ToRawFormat(FpPixelFormat format) {
+    return format == FP_PIXEL_BGRA ? RawPixelFormat::BGRA
+           : format == FP_PIXEL_NV12 ? RawPixelFormat::NV12
+                                     : RawPixelFormat::RGB24;
+}
+
+/**
+ * Frames a caller copies in through FpFrameReader::read, in order, or
+ * lends through FpFrameReader::borrow.
+ */
+class ReaderFrameSource final : public FrameSource {
+public:
+    explicit ReaderFrameSource(const FpFrameReader& reader) : reader_(reader) {
+        format_.width = reader.width;
+        format_.height = reader.height;
+        format_.format = ToRawFormat(reader.format);
+        format_.frame_count = reader.frame_count;
+    }
+
+    int frameCount() const override { return format_.frame_count; }
+    bool randomAccess() const override { return reader_.borrow != nullptr && format_.frame_count >= 0; }
+    int endIndex() const override { return end_index_.load(); }
+
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override {
+        out.clear();
+        if (reader_.borrow != nullptr) return lend(index, req, out);
+        if (index != next_index_ || (end_index_.load() >= 0 && index >= end_index_.load())) return false;
+        const size_t bytes = format_.frameBytes();
+        std::vector<uint8_t>& dst = format_.format == RawPixelFormat::RGB24 && req.rgb ? out.rgb : scratch_;
+        dst.resize(bytes);
+        if (reader_.read(reader_.user, index, dst.data(), bytes) == 0) {
+            out.clear();
+            end_index_ = index;
+            return false;
+        }
+        next_index_++;
+        if (format_.frame_count >= 0 && next_index_ >= format_.frame_count) end_index_ = next_index_;
+        FillRawFrame(dst.data(), format_, req, out);
+        return true;
+    }
+
+private:
+    bool lend(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+        if (index < 0 || (format_.frame_count >= 0 && index >= format_.frame_count)) return false;
+        const uint8_t* px = reader_.borrow(reader_.user, index);
+        if (px == nullptr) {
+            int end = end_index_.load();
+            while ((end < 0 || index < end) && !end_index_.compare_exchange_weak(end, index)) {
+            }
+            return false;
+        }
+        if (format_.format != RawPixelFormat::RGB24 || !req.rgb) {
+            FillRawFrame(px, format_, req, out);
+            return true;
+        }
+        // Packed RGB is used where it lies; only the luma plane is made.
+        FrameRequest luma_only = req;
+        luma_only.rgb = false;
+        FillRawFrame(px, format_, luma_only, out);
+        out.rgb_w = format_.width;
+        out.rgb_h = format_.height;
+        out.rgb_view = px;
+        return true;
+    }
+
+    FpFrameReader reader_;
+    RawStreamFormat format_;
+    int next_index_ = 0;
+    std::vector<uint8_t> scratch_;
+    std::atomic<int> end_index_{-1};
+};
+
+FpResult* Track(FpPipeline* p, FrameSource& source, const FpRunOptions* options) {
+    if (p == nullptr) {
+        SetError("no pipeline");
+        return nullptr;
+    }
+    FpRunOptions run;
+    fp_run_options_init(&run);
+    if (options != nullptr) {
+        if (!SizeOk(options, sizeof(FpRunOptions), "FpRunOptions")) return nullptr;
+        run = *options;
+    }
+    RunTuning tuning = p->pipeline->tuning();
+    auto stop = std::make_shared<std::atomic<bool>>(false);
+    tuning.tracking.stop = stop;
+    tuning.tracking.time_budget_s = run.time_budget_s;
+    tuning.tracking.budget_degrade = true;
+    if (run.progress != nullptr) {
+        tuning.tracking.progress = [run, stop](const char* stage, int done, int total) {
+            if (run.progress(run.user, stage, done, total) != 0) stop->store(true);
+        };
+    } else {
+        tuning.tracking.progress = nullptr;
+    }
+    const PipelineResult result =
+        p->pipeline->process(source, run.video_fps > 0.0f ? run.video_fps : 30.0f, TrackSegmentSink(), tuning);
+
+    auto out = std::make_unique<FpResult>();
+    out->frame_count = result.frame_count;
+    out->stopped = result.stopped;
+    out->frames.resize(result.tracks.size());
+    for (size_t t = 0; t < result.tracks.size(); ++t) {
+        const FaceTrack& track = result.tracks[t];
+        std::vector<FpTrackFrame>& frames = out->frames[t];
+        frames.reserve(track.frames.size());
+        for (const TrackFrame& f : track.frames) {
+            frames.push_back({f.frame_index, f.bbox.x1, f.bbox.y1, f.bbox.x2, f.bbox.y2, f.confidence});
+        }
+        out->tracks.push_back({track.id, track.identity, static_cast<int>(frames.size()), frames.data()});
+    }
+    g_last_error.clear();
+    return out.release();
+}
+}  // namespace
+
+extern "C" {
+
+int fp_api_version(void) { return FP_API_VERSION; }
+
+const char* fp_last_error(void) { return g_last_error.c_str(); }
+
+void fp_config_init(FpConfig* config) {
+    if (config == nullptr) return;
+    std::memset(config, 0, sizeof(*config));
+    config->struct_size = sizeof(FpConfig);
+    config->conf_thresh = 0.5f;
+    config->detection_fps = 5.0f;
+    config->iou_thresh = 0.15f;
+    config->reid_weight = 0.35f;
+    config->reid_cos_thresh = 0.35f;
+}
+
+void fp_run_options_init(FpRunOptions* options) {
+    if (options == nullptr) return;
+    std::memset(options, 0, sizeof(*options));
+    options->struct_size = sizeof(FpRunOptions);
+    options->video_fps = 30.0f;
+}
+
+FpPipeline* fp_pipeline_create(const FpConfig* config) {
+    if (!SizeOk(config, sizeof(FpConfig), "FpConfig")) return nullptr;
+    if (config->model_dir == nullptr || *config->model_dir == '\0') {
+        SetError("no model_dir");
+        return nullptr;
+    }
+    auto p = std::make_unique<FpPipeline>();
+    p->pipeline = std::make_unique<FacePipeline>(
+        config->model_dir, config->conf_thresh, config->detection_fps, config->iou_thresh,
+        config->reid_model_dir != nullptr ? config->reid_model_dir : "", config->reid_weight, config->reid_cos_thresh);
+    if (!p->pipeline->isLoaded()) {
+        SetError(std::string("failed to load models from ") + config->model_dir);
+        return nullptr;
+    }
+    g_last_error.clear();
+    return p.release();
+}
+
+void fp_pipeline_destroy(FpPipeline* pipeline) { delete pipeline; }
+
+FpResult* fp_track_images(FpPipeline* pipeline, const char* const* paths, int count, const FpRunOptions* options) {
+    if (count < 0 || (count > 0 && paths == nullptr)) {
+        SetError("bad image list");
+        return nullptr;
+    }
+    std::vector<std::string> list;
+    list.reserve(static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        if (paths[i] == nullptr) {
+            SetError("image path " + std::to_string(i) + " is NULL");
+            return nullptr;
+        }
+        list.emplace_back(paths[i]);
+    }
+    ImageListSource source(list);
+    return Track(pipeline, source, options);
+}
+
+FpResult* fp_track_frames(FpPipeline* pipeline, const FpFrameReader* reader, const FpRunOptions* options) {
+    if (!SizeOk(reader, sizeof(FpFrameReader), "FpFrameReader")) return nullptr;
+    if (reader->width <= 0 || reader->height <= 0 || (reader->read == nullptr && reader->borrow == nullptr) ||
+        (reader->format != FP_PIXEL_RGB24 && reader->format != FP_PIXEL_BGRA && reader->format != FP_PIXEL_NV12)) {
+        SetError("FpFrameReader needs a size, a pixel format and a read function");
+        return nullptr;
+    }
+    ReaderFrameSource source(*reader);
+    return Track(pipeline, source, options);
+}
+
+int fp_detect_frame(FpPipeline* pipeline, const uint8_t* pixels, int width, int height, FpPixelFormat format,
+                    FpDetection* out, int capacity) {
+    if (pipeline == nullptr || pixels == nullptr || width <= 0 || height <= 0 || capacity < 0 ||
+        (capacity > 0 && out == nullptr)) {
+        SetError("fp_detect_frame needs a pipeline, the pixels and their size");
+        return -1;
+    }
+    const unsigned char* rgb = pixels;
+    LoadedRgbFrame converted;
+    if (format != FP_PIXEL_RGB24) {
+        RawStreamFormat raw;
+        raw.width = width;
+        raw.height = height;
+        raw.format = ToRawFormat(format);
+        FillRawFrame(pixels, raw, FrameRequest{}, converted);
+        rgb = converted.rgbData();
+    }
+    std::vector<Detection> faces = pipeline->pipeline->detectRgb(rgb, width, height);
+    std::stable_sort(faces.begin(), faces.end(),
+                     [](const Detection& a, const Detection& b) { return a.score > b.score; });
+    for (int i = 0; i < capacity && i < static_cast<int>(faces.size()); ++i) {
+        const Detection& d = faces[static_cast<size_t>(i)];
+        out[i] = FpDetection{d.bbox.x1, d.bbox.y1, d.bbox.x2, d.bbox.y2, d.score};
+    }
+    g_last_error.clear();
+    return static_cast<int>(faces.size());
+}
+
+int fp_result_frame_count(const FpResult* result) { return result != nullptr ? result->frame_count : 0; }
+
+int fp_result_stopped(const FpResult* result) { return result != nullptr && result->stopped ? 1 : 0; }
+
+int fp_result_track_count(const FpResult* result) {
+    return result != nullptr ? static_cast<int>(result->tracks.size()) : 0;
+}
+
+FpTrack fp_result_track(const FpResult* result, int index) {
+    if (result == nullptr || index < 0 || index >= static_cast<int>(result->tracks.size())) {
+        return FpTrack{0, -1, 0, nullptr};
+    }
+    return result->tracks[static_cast<size_t>(index)];
+}
+
+void fp_result_free(FpResult* result) { delete result; }
+
+}  // extern "C"
@@ -0,0 +1,121 @@
+#include "frame_cache.hpp"
+
+#include <algorithm>
+
+#include "huge_pages.hpp"
+#include "image_decoder.hpp"
+#include "tracy_zones.hpp"
+
+bool LoadRgbFrame(const std::string& path, LoadedRgbFrame& out) {
+    FACE_PIPELINE_ZONE("LoadRgbFrame");
+    return LoadFrame(path, FrameRequest{}, out);
+}
+
+bool LoadFrame(const std::string& path, const FrameRequest& req, LoadedRgbFrame& out) {
+    return DecodeImageFile(path, req, out);
+}
+
+void LoadedRgbFrame::clear() {
+    w = 0;
+    h = 0;
+    rgb.clear();
+    rgb_w = 0;
+    rgb_h = 0;
+    luma.clear();
+    luma_w = 0;
+    luma_h = 0;
+    luma_scale = 0;
+    luma_coarse.clear();
+    motion_vectors.clear();
+    rgb_view = nullptr;
+    luma_view = nullptr;
+    storage.reset();
+    read_full_res = nullptr;
+}
+
+std::unique_ptr<LoadedRgbFrame> FramePool::acquire() {
+    size_t rgb_bytes = 0, luma_bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (!free_.empty()) {
+            auto frame = std::move(free_.back());
+            free_.pop_back();
+            return frame;
+        }
+        allocations_++;
+        rgb_bytes = rgb_bytes_;
+        luma_bytes = luma_bytes_;
+    }
+    auto frame = std::make_unique<LoadedRgbFrame>();
+    ReserveHugePages(frame->rgb, rgb_bytes);
+    ReserveHugePages(frame->luma, luma_bytes);
+    return frame;
+}
+
+void FramePool::release(std::unique_ptr<LoadedRgbFrame> frame) {
+    if (!frame) return;
+    frame->clear();
+    std::lock_guard<std::mutex> lock(mu_);
+    rgb_bytes_ = std::max(rgb_bytes_, frame->rgb.capacity());
+    luma_bytes_ = std::max(luma_bytes_, frame->luma.capacity());
+    if (free_.size() < max_free_) free_.push_back(std::move(frame));
+}
+
+int FramePool::allocations() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return allocations_;
+}
+
+FrameCache::FrameCache(size_t capacity, Loader loader)
+    : slots_(std::max<size_t>(1, capacity)),
+      loader_(std::move(loader)),
+      // Ring slots plus frames still held by consumers after eviction.
+      pool_(std::make_shared<FramePool>(slots_.size() + 2)) {}
+
+FrameCache::FramePtr FrameCache::get(int index) {
+    if (index < 0) return nullptr;
+    Slot& slot = slots_[static_cast<size_t>(index) % slots_.size()];
+    if (slot.index == index) {
+        hit_count_++;
+        return slot.frame;
+    }
+    return load(slot, index, loader_);
+}
+
+FrameCache::FramePtr FrameCache::reload(int index, const Loader& loader) {
+    if (index < 0) return nullptr;
+    return load(slots_[static_cast<size_t>(index) % slots_.size()], index, loader);
+}
+
+FrameCache::FramePtr FrameCache::load(Slot& slot, int index, const Loader& loader) {
+    std::unique_ptr<LoadedRgbFrame> frame = pool_->acquire();
+    decode_count_++;
+    const bool ok = loader && loader(index, *frame);
+    slot.index = index;
+    if (ok) {
+        // Hand the frame back to the pool once the last consumer drops it.
+        std::weak_ptr<FramePool> pool = pool_;
+        slot.frame = FramePtr(frame.release(), [pool](const LoadedRgbFrame* f) {
+            std::unique_ptr<LoadedRgbFrame> owned(const_cast<LoadedRgbFrame*>(f));
+            if (auto p = pool.lock()) p->release(std::move(owned));
+        });
+    } else {
+        pool_->release(std::move(frame));
+        slot.frame = nullptr;
+    }
+    return slot.frame;
+}
+
+FrameCache::FramePtr FrameCache::peek(int index) const {
+    if (index < 0) return nullptr;
+    const Slot& slot = slots_[static_cast<size_t>(index) % slots_.size()];
+    return (slot.index == index) ? slot.frame : nullptr;
+}
+
+size_t FrameCache::residentBytes() const {
+    size_t bytes = 0;
+    for (const Slot& slot : slots_) {
+        if (slot.frame) bytes += slot.frame->ownedBytes();
+    }
+    return bytes;
+}
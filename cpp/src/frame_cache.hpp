@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Decoded frame.
+ *
+ * `w`/`h` are always the full-resolution frame size. Depending on the
+ * FrameRequest it was decoded with, a frame carries interleaved RGB of
+ * `rgb_w x rgb_h` (full resolution unless the decoder could reduce it cheaply,
+ * e.g. JPEG DCT scaling), a luma plane reduced by `luma_scale`, or both.
+ *
+ * Planes are either owned (`rgb`/`luma`) or borrowed zero-copy from `storage`
+ * (`rgb_view`/`luma_view`, e.g. a memory-mapped frame container). Consumers
+ * should read through rgbData()/lumaData(), which cover both cases.
+ *
+ * A reduced RGB plane may come with `read_full_res`, which reads pixels
+ * back at full resolution (ReID crops of small faces), so the full frame
+ * itself never needs to be resident.
+ */
+
+/**
+ * Reads the `w x h` RGB pixels at (x, y) of a frame's full-resolution grid
+ * (LoadedRgbFrame::w x h) into `rgb`, rows packed. The rectangle lies
+ * within the frame.
+ *
+ * @return false if the pixels could not be read
+ */
+using RgbRegionReader = std::function<bool(int x, int y, int w, int h, std::vector<uint8_t>& rgb)>;
+
+struct LoadedRgbFrame {
+    int w = 0;
+    int h = 0;
+    std::vector<uint8_t> rgb;  // size = rgb_w*rgb_h*3
+    int rgb_w = 0;
+    int rgb_h = 0;
+
+    std::vector<uint8_t> luma;  // size = luma_w*luma_h, empty if not requested
+    int luma_w = 0;
+    int luma_h = 0;
+    int luma_scale = 0;
+    std::vector<uint8_t> luma_coarse;  // GmcEstimator::BuildCoarseLuma() of the luma plane, empty if none
+    std::vector<std::array<float, 4>> motion_vectors;  // decoder motion vectors (GmcEstimator::MotionVectors), empty if none
+
+    const uint8_t* rgb_view = nullptr;
+    const uint8_t* luma_view = nullptr;
+    std::shared_ptr<const void> storage;  // keeps borrowed views alive
+    RgbRegionReader read_full_res;        // set only while rgb_w < w and the source can read regions
+
+    const uint8_t* rgbData() const { return rgb_view ? rgb_view : (rgb.empty() ? nullptr : rgb.data()); }
+    const uint8_t* lumaData() const { return luma_view ? luma_view : (luma.empty() ? nullptr : luma.data()); }
+    bool hasRgb() const { return rgbData() != nullptr; }
+    bool hasLuma() const { return lumaData() != nullptr; }
+
+    /** Bytes allocated by the owned planes (borrowed views not counted). */
+    size_t ownedBytes() const {
+        return rgb.capacity() + luma.capacity() + luma_coarse.capacity() +
+               motion_vectors.capacity() * sizeof(motion_vectors[0]);
+    }
+
+    /**
+     * Reset to an empty frame but keep the plane allocations for reuse.
+     */
+    void clear();
+};
+
+/**
+ * What a consumer needs from a decoded frame.
+ *
+ * Frames that only feed GMC ask for `rgb = false` plus a reduced luma plane,
+ * which skips the full-resolution RGB buffer entirely. Single-frame
+ * requests, where nothing else overlaps the decode, may also ask for
+ * `decode_threads` (see image_decoder.hpp).
+ */
+struct FrameRequest {
+    bool rgb = true;             // interleaved RGB
+    int rgb_min_long_side = 0;   // RGB may be decoded smaller while its long side stays >= this (0 = full res)
+    int luma_downscale = 0;      // luma plane at 1/N scale (0 = none)
+    int decode_threads = 0;      // one image on up to N threads where its encoding allows (0/1 = one thread)
+};
+
+/**
+ * Decode an image file into an RGB frame.
+ *
+ * @return false if the file could not be decoded
+ */
+bool LoadRgbFrame(const std::string& path, LoadedRgbFrame& out);
+
+/**
+ * Decode an image file into the planes described by `req`.
+ *
+ * @return false if the file could not be decoded
+ */
+bool LoadFrame(const std::string& path, const FrameRequest& req, LoadedRgbFrame& out);
+
+/**
+ * Free list of decoded frames whose plane buffers are recycled.
+ *
+ * Frames handed out by the pool keep their vector capacity across uses, so
+ * once the pipeline reaches steady state decoders write into memory that
+ * was allocated for an earlier frame of the same size. With huge pages on,
+ * new frames get planes as large as the largest released ones up front.
+ */
+class FramePool {
+public:
+    explicit FramePool(size_t max_free = 16) : max_free_(max_free) {}
+
+    /**
+     * Take a cleared frame (recycled if available).
+     */
+    std::unique_ptr<LoadedRgbFrame> acquire();
+
+    /**
+     * Return a frame; it is cleared and kept if the free list has room.
+     */
+    void release(std::unique_ptr<LoadedRgbFrame> frame);
+
+    int allocations() const;
+
+private:
+    mutable std::mutex mu_;
+    std::vector<std::unique_ptr<LoadedRgbFrame>> free_;
+    size_t max_free_;
+    int allocations_ = 0;
+    size_t rgb_bytes_ = 0;   // largest plane capacities released so far, reserved for
+    size_t luma_bytes_ = 0;  // new frames in huge pages (see huge_pages.hpp)
+};
+
+/**
+ * Bounded ring of decoded frames keyed by frame index.
+ *
+ * Detection, ReID and GMC all read frames through the cache so each frame of a
+ * sequence is decoded exactly once while it is within the ring window. Frames
+ * are handed out as shared pointers, so an entry evicted from the ring stays
+ * valid for as long as a consumer still holds it. Released frames go back to
+ * a FramePool, so their buffers are reused for later frames.
+ *
+ * Usage:
+ *   FrameCache cache(2, [&](int i, LoadedRgbFrame& f) { return LoadRgbFrame(paths[i], f); });
+ *   auto cur = cache.get(i);      // decodes on miss
+ *   auto prev = cache.get(i - 1); // hits, no second decode
+ */
+class FrameCache {
+public:
+    using Loader = std::function<bool(int index, LoadedRgbFrame& out)>;
+    using FramePtr = std::shared_ptr<const LoadedRgbFrame>;
+
+    FrameCache(size_t capacity, Loader loader);
+
+    /**
+     * Get a decoded frame, decoding it on a cache miss.
+     *
+     * @return nullptr if the frame could not be decoded (failures are cached too)
+     */
+    FramePtr get(int index);
+
+    /**
+     * Return a frame only if it is already resident (never decodes).
+     */
+    FramePtr peek(int index) const;
+
+    /**
+     * Decode a frame again with another loader, replacing what the cache
+     * holds for it (say, a frame the usual loader passed over).
+     */
+    FramePtr reload(int index, const Loader& loader);
+
+    size_t capacity() const { return slots_.size(); }
+    int frameAllocations() const { return pool_->allocations(); }
+    int decodeCount() const { return decode_count_; }
+    int hitCount() const { return hit_count_; }
+
+    /** Bytes the resident frames' planes hold. */
+    size_t residentBytes() const;
+
+private:
+    struct Slot {
+        int index = -1;
+        FramePtr frame;
+    };
+
+    FramePtr load(Slot& slot, int index, const Loader& loader);
+
+    std::vector<Slot> slots_;
+    Loader loader_;
+    std::shared_ptr<FramePool> pool_;
+    int decode_count_ = 0;
+    int hit_count_ = 0;
+};
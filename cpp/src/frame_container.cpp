@@ -0,0 +1,323 @@
+#include "frame_container.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "image_ops.hpp"
+
+namespace {
+constexpr char kMagic[8] = {'F', 'P', 'F', 'R', 'A', 'M', 'E', '1'};
+
+inline uint64_t AlignUp(uint64_t v, uint64_t a) { return (v + a - 1) / a * a; }
+
+bool SeekTo(FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Size and modification time of `path`; zero if it cannot be stat'ed.
+void FileStamp(const std::string& path, uint64_t& size, int64_t& mtime) {
+#ifdef _WIN32
+    struct _stat64 st;
+    const bool ok = _stat64(path.c_str(), &st) == 0;
+#else
+    struct stat st;
+    const bool ok = ::stat(path.c_str(), &st) == 0;
+#endif
+    size = ok ? static_cast<uint64_t>(st.st_size) : 0;
+    mtime = ok ? static_cast<int64_t>(st.st_mtime) : 0;
+}
+
+// [offset, offset + bytes) lies within a file of `size` bytes.
+bool InFile(uint64_t offset, uint64_t bytes, uint64_t size) {
+    return offset <= size && bytes <= size - offset;
+}
+}  // namespace
+
+uint64_t HashFrameSequence(int count, const std::function<std::string(int)>& path_at) {
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](unsigned char c) {
+        h ^= c;
+        h *= 1099511628211ull;
+    };
+    auto mix_value = [&mix](uint64_t v) {
+        for (int k = 0; k < 8; ++k) mix(static_cast<unsigned char>(v >> (8 * k)));
+    };
+    for (int i = 0; i < count; ++i) {
+        const std::string path = path_at(i);
+        for (char c : path) mix(static_cast<unsigned char>(c));
+        mix('\n');
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        FileStamp(path, size, mtime);
+        mix_value(size);
+        mix_value(static_cast<uint64_t>(mtime));
+    }
+    return h;
+}
+
+uint64_t HashFrameSequence(const std::vector<std::string>& paths) {
+    return HashFrameSequence(static_cast<int>(paths.size()),
+                             [&paths](int i) { return paths[static_cast<size_t>(i)]; });
+}
+
+// ---------------------------------------------------------------------------
+// MappedFile
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path) {
+    std::shared_ptr<MappedFile> m(new MappedFile());
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+    m->file_ = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) return nullptr;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return nullptr;
+    m->mapping_ = mapping;
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) return nullptr;
+    m->data_ = static_cast<const uint8_t*>(view);
+    m->size_ = static_cast<size_t>(size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    m->fd_ = fd;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) return nullptr;
+    void* addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) return nullptr;
+    // Frames are consumed front to back.
+    (void)::madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    m->data_ = static_cast<const uint8_t*>(addr);
+    m->size_ = static_cast<size_t>(st.st_size);
+#endif
+    return m;
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(static_cast<HANDLE>(mapping_));
+    if (file_) CloseHandle(static_cast<HANDLE>(file_));
+#else
+    if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+    if (fd_ >= 0) ::close(fd_);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// ContainerFrameSource
+
+std::unique_ptr<ContainerFrameSource> ContainerFrameSource::Open(const std::string& path,
+                                                                 int expected_frames,
+                                                                 uint64_t source_hash) {
+    auto file = MappedFile::Open(path);
+    if (!file || file->size() < sizeof(FrameContainerHeader)) return nullptr;
+
+    FrameContainerHeader hdr;
+    std::memcpy(&hdr, file->data(), sizeof(hdr));
+    if (std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) != 0) return nullptr;
+    if (hdr.version != kFrameContainerVersion || !(hdr.flags & kFrameContainerComplete)) return nullptr;
+    if (hdr.compression != 0) return nullptr;
+    if (hdr.frame_count != expected_frames || hdr.source_hash != source_hash) return nullptr;
+    if (hdr.width <= 0 || hdr.height <= 0 || hdr.luma_scale <= 0) return nullptr;
+
+    if (hdr.frame_count < 0) return nullptr;
+
+    const uint64_t size = file->size();
+    const uint64_t index_bytes = static_cast<uint64_t>(hdr.frame_count) * sizeof(FrameContainerEntry);
+    if (hdr.index_offset % alignof(FrameContainerEntry) != 0 || !InFile(hdr.index_offset, index_bytes, size) ||
+        hdr.data_offset < hdr.index_offset + index_bytes) {
+        return nullptr;
+    }
+    // Every plane must be the header's geometry and lie in the data area,
+    // since read() hands them out as is.
+    const uint64_t rgb_bytes = static_cast<uint64_t>(hdr.width) * static_cast<uint64_t>(hdr.height) * 3u;
+    const uint64_t luma_bytes = static_cast<uint64_t>(DownscaledSize(hdr.width, hdr.luma_scale)) *
+                                static_cast<uint64_t>(DownscaledSize(hdr.height, hdr.luma_scale));
+    const auto* index = reinterpret_cast<const FrameContainerEntry*>(file->data() + hdr.index_offset);
+    for (int i = 0; i < hdr.frame_count; ++i) {
+        const FrameContainerEntry& e = index[i];
+        if (e.rgb_bytes == 0) continue;
+        if (e.rgb_bytes != rgb_bytes || e.luma_bytes != luma_bytes) return nullptr;
+        if (e.rgb_offset < hdr.data_offset || !InFile(e.rgb_offset, e.rgb_bytes, size) ||
+            e.luma_offset < hdr.data_offset || !InFile(e.luma_offset, e.luma_bytes, size)) {
+            return nullptr;
+        }
+    }
+
+    std::unique_ptr<ContainerFrameSource> src(new ContainerFrameSource());
+    src->file_ = std::move(file);
+    src->header_ = hdr;
+    src->index_ = index;
+    return src;
+}
+
+bool ContainerFrameSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    out.clear();
+    if (index < 0 || index >= header_.frame_count) return false;
+    const FrameContainerEntry& e = index_[index];
+    if (e.rgb_bytes == 0) return false;
+
+    const uint8_t* base = file_->data();
+    out.w = header_.width;
+    out.h = header_.height;
+    out.storage = file_;
+    if (req.rgb) {
+        out.rgb_view = base + e.rgb_offset;
+        out.rgb_w = out.w;
+        out.rgb_h = out.h;
+    }
+    if (req.luma_downscale > 0) {
+        out.luma_scale = req.luma_downscale;
+        out.luma_w = DownscaledSize(out.w, req.luma_downscale);
+        out.luma_h = DownscaledSize(out.h, req.luma_downscale);
+        if (req.luma_downscale == header_.luma_scale && e.luma_bytes > 0) {
+            out.luma_view = base + e.luma_offset;
+        } else {
+            // Recorded at another scale: derive from the mapped RGB plane.
+            RgbToLumaDownsample(base + e.rgb_offset, out.w, out.h, req.luma_downscale, out.luma);
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// FrameContainerWriter
+
+FrameContainerWriter::FrameContainerWriter(const std::string& path, int frame_count, uint64_t source_hash)
+    : path_(path),
+      tmp_path_(path + ".tmp"),
+      index_(static_cast<size_t>(std::max(0, frame_count))),
+      recorded_(static_cast<size_t>(std::max(0, frame_count)), 0) {
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, kMagic, sizeof(kMagic));
+    header_.version = kFrameContainerVersion;
+    header_.frame_count = std::max(0, frame_count);
+    header_.source_hash = source_hash;
+    header_.index_offset = sizeof(FrameContainerHeader);
+    header_.data_offset = AlignUp(header_.index_offset + index_.size() * sizeof(FrameContainerEntry), 4096);
+
+    file_ = std::fopen(tmp_path_.c_str(), "wb");
+    if (!file_) {
+        fprintf(stderr, "Warning: cannot create frame cache %s\n", tmp_path_.c_str());
+        failed_ = true;
+    }
+}
+
+FrameContainerWriter::~FrameContainerWriter() {
+    if (file_) {
+        std::fclose(file_);
+        std::remove(tmp_path_.c_str());
+    }
+}
+
+bool FrameContainerWriter::beginLocked(const LoadedRgbFrame& frame) {
+    if (header_.width == 0) {
+        header_.width = frame.w;
+        header_.height = frame.h;
+        header_.luma_scale = frame.luma_scale;
+        const uint64_t rgb = static_cast<uint64_t>(frame.w) * static_cast<uint64_t>(frame.h) * 3u;
+        const uint64_t luma = static_cast<uint64_t>(frame.luma_w) * static_cast<uint64_t>(frame.luma_h);
+        slot_bytes_ = AlignUp(rgb, 64) + AlignUp(luma, 64);
+    }
+    return frame.w == header_.width && frame.h == header_.height &&
+           frame.rgb_w == frame.w && frame.rgb_h == frame.h &&
+           frame.luma_scale == header_.luma_scale && frame.luma_w == DownscaledSize(frame.w, frame.luma_scale) &&
+           frame.luma_h == DownscaledSize(frame.h, frame.luma_scale);
+}
+
+bool FrameContainerWriter::writeAtLocked(uint64_t offset, const void* data, size_t bytes) {
+    return SeekTo(file_, offset) && std::fwrite(data, 1, bytes, file_) == bytes;
+}
+
+void FrameContainerWriter::write(int index, const LoadedRgbFrame& frame) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (failed_ || index < 0 || index >= header_.frame_count) return;
+    if (!frame.hasRgb() || !frame.hasLuma() || !beginLocked(frame)) {
+        // Mixed geometries cannot share fixed slots; give up on the cache.
+        failed_ = true;
+        return;
+    }
+
+    FrameContainerEntry& e = index_[static_cast<size_t>(index)];
+    e.rgb_offset = header_.data_offset + static_cast<uint64_t>(index) * slot_bytes_;
+    e.rgb_bytes = static_cast<uint64_t>(frame.w) * static_cast<uint64_t>(frame.h) * 3u;
+    e.luma_offset = e.rgb_offset + AlignUp(e.rgb_bytes, 64);
+    e.luma_bytes = static_cast<uint64_t>(frame.luma_w) * static_cast<uint64_t>(frame.luma_h);
+    if (!writeAtLocked(e.rgb_offset, frame.rgbData(), static_cast<size_t>(e.rgb_bytes)) ||
+        !writeAtLocked(e.luma_offset, frame.lumaData(), static_cast<size_t>(e.luma_bytes))) {
+        failed_ = true;
+        return;
+    }
+    recorded_[static_cast<size_t>(index)] = 1;
+}
+
+void FrameContainerWriter::writeMissing(int index) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (index < 0 || index >= header_.frame_count) return;
+    index_[static_cast<size_t>(index)] = FrameContainerEntry{};
+    recorded_[static_cast<size_t>(index)] = 1;
+}
+
+bool FrameContainerWriter::finish() {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!file_) return false;
+    const bool all_recorded =
+        std::all_of(recorded_.begin(), recorded_.end(), [](uint8_t r) { return r != 0; });
+    bool ok = !failed_ && all_recorded && header_.width > 0;
+    if (ok) {
+        header_.flags = kFrameContainerComplete;
+        ok = writeAtLocked(header_.index_offset, index_.data(), index_.size() * sizeof(FrameContainerEntry)) &&
+             writeAtLocked(0, &header_, sizeof(header_));
+    }
+    ok = (std::fclose(file_) == 0) && ok;
+    file_ = nullptr;
+    if (ok) {
+        std::remove(path_.c_str());
+        ok = std::rename(tmp_path_.c_str(), path_.c_str()) == 0;
+    }
+    if (!ok) std::remove(tmp_path_.c_str());
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// RecordingFrameSource
+
+bool RecordingFrameSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    FrameRequest full;
+    full.rgb = true;
+    full.luma_downscale = req.luma_downscale > 0 ? req.luma_downscale : 1;
+    if (!inner_.read(index, full, out)) {
+        writer_.writeMissing(index);
+        return false;
+    }
+    writer_.write(index, out);
+    if (!req.rgb) {
+        out.rgb.clear();
+        if (out.rgb_view && !out.luma_view) out.storage.reset();
+        out.rgb_view = nullptr;
+        out.rgb_w = 0;
+        out.rgb_h = 0;
+    }
+    return true;
+}
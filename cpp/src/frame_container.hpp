@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_source.hpp"
+
+/**
+ * On-disk frame container ("frame cache file").
+ *
+ * Decoding a PNG sequence dominates repeated runs over the same clip (e.g.
+ * while tuning thresholds). The first run records every decoded frame into a
+ * container; later runs memory-map it and hand out zero-copy plane pointers.
+ *
+ * Layout (little-endian):
+ *   FrameContainerHeader                      64 bytes
+ *   FrameContainerEntry[frame_count]          32 bytes each
+ *   frame data (RGB plane, then luma plane), each frame 64-byte aligned
+ *
+ * Only uncompressed planes are written today; `compression` is reserved so a
+ * compressed variant can be added without changing the layout.
+ */
+struct FrameContainerHeader {
+    char magic[8];          // "FPFRAME1"
+    uint32_t version;       // kFrameContainerVersion
+    uint32_t flags;         // kFrameContainerComplete once fully written
+    int32_t width;
+    int32_t height;
+    int32_t frame_count;
+    int32_t luma_scale;     // downscale of the stored luma plane
+    uint32_t compression;   // 0 = none
+    uint32_t reserved;
+    uint64_t source_hash;   // identifies the input sequence
+    uint64_t index_offset;
+    uint64_t data_offset;
+};
+static_assert(sizeof(FrameContainerHeader) == 64, "container header must stay 64 bytes");
+
+struct FrameContainerEntry {
+    uint64_t rgb_offset;
+    uint64_t rgb_bytes;     // 0 = frame could not be decoded
+    uint64_t luma_offset;
+    uint64_t luma_bytes;
+};
+static_assert(sizeof(FrameContainerEntry) == 32, "container entry must stay 32 bytes");
+
+constexpr uint32_t kFrameContainerVersion = 1;
+constexpr uint32_t kFrameContainerComplete = 1u;
+
+/**
+ * Stable hash of an image sequence (FNV-1a over the paths and each file's
+ * size and modification time), used to reject a container recorded for a
+ * different input or for files rewritten since.
+ */
+uint64_t HashFrameSequence(const std::vector<std::string>& paths);
+
+/**
+ * Same hash for a sequence whose paths are generated on demand.
+ */
+uint64_t HashFrameSequence(int count, const std::function<std::string(int)>& path_at);
+
+/**
+ * Read-only memory mapping of a whole file.
+ */
+class MappedFile {
+public:
+    static std::shared_ptr<MappedFile> Open(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+/**
+ * Frames served zero-copy from a memory-mapped container.
+ */
+class ContainerFrameSource final : public FrameSource {
+public:
+    /**
+     * Map `path` and validate it against the expected sequence.
+     *
+     * @return nullptr if the file is missing, incomplete, inconsistent
+     *         (planes not of the header's geometry or past the end of the
+     *         file) or was recorded for a different sequence
+     */
+    static std::unique_ptr<ContainerFrameSource> Open(const std::string& path,
+                                                      int expected_frames,
+                                                      uint64_t source_hash);
+
+    int frameCount() const override { return header_.frame_count; }
+    bool randomAccess() const override { return true; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+
+private:
+    ContainerFrameSource() = default;
+
+    std::shared_ptr<MappedFile> file_;
+    FrameContainerHeader header_{};
+    const FrameContainerEntry* index_ = nullptr;
+};
+
+/**
+ * Records frames into a new container.
+ *
+ * Frames may arrive from several decoder threads in any order; every frame
+ * has a fixed slot so writes never depend on arrival order. The file is
+ * written under a temporary name and only renamed into place by finish()
+ * once every frame was recorded with a consistent geometry.
+ */
+class FrameContainerWriter {
+public:
+    FrameContainerWriter(const std::string& path, int frame_count, uint64_t source_hash);
+    ~FrameContainerWriter();
+
+    FrameContainerWriter(const FrameContainerWriter&) = delete;
+    FrameContainerWriter& operator=(const FrameContainerWriter&) = delete;
+
+    /**
+     * Record frame `index` (must carry RGB and luma). Thread-safe.
+     */
+    void write(int index, const LoadedRgbFrame& frame);
+
+    /**
+     * Mark frame `index` as undecodable so finish() can still complete.
+     */
+    void writeMissing(int index);
+
+    /**
+     * Write the index and header and move the file into place.
+     *
+     * @return false if recording failed (the partial file is removed)
+     */
+    bool finish();
+
+private:
+    bool beginLocked(const LoadedRgbFrame& frame);
+    bool writeAtLocked(uint64_t offset, const void* data, size_t bytes);
+
+    std::string path_;
+    std::string tmp_path_;
+    FILE* file_ = nullptr;
+    FrameContainerHeader header_{};
+    std::vector<FrameContainerEntry> index_;
+    std::vector<uint8_t> recorded_;
+    uint64_t slot_bytes_ = 0;
+    bool failed_ = false;
+
+    std::mutex mu_;
+};
+
+/**
+ * Pass-through source that records every frame it reads into a container.
+ *
+ * Upgrades each request to full RGB plus luma (the container must serve any
+ * detection stride on later runs) and trims the result back to what the
+ * caller asked for.
+ */
+class RecordingFrameSource final : public FrameSource {
+public:
+    RecordingFrameSource(FrameSource& inner, FrameContainerWriter& writer)
+        : inner_(inner), writer_(writer) {}
+
+    int frameCount() const override { return inner_.frameCount(); }
+    bool randomAccess() const override { return inner_.randomAccess(); }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    int endIndex() const override { return inner_.endIndex(); }
+
+private:
+    FrameSource& inner_;
+    FrameContainerWriter& writer_;
+};
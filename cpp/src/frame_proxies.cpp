@@ -0,0 +1,106 @@
+#include "frame_proxies.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "image_ops.hpp"
+#include "stb_image_write.h"
+
+namespace {
+bool MakeDir(const std::string& path) {
+#ifdef _WIN32
+    if (_mkdir(path.c_str()) == 0) return true;
+    struct _stat64 st;
+    return _stat64(path.c_str(), &st) == 0 && (st.st_mode & _S_IFDIR);
+#else
+    if (::mkdir(path.c_str(), 0755) == 0) return true;
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+}  // namespace
+
+ProxyWriter::ProxyWriter(std::string dir, int height, int quality)
+    : dir_(std::move(dir)), height_(std::max(1, height)), quality_(std::max(1, std::min(100, quality))) {
+    ok_ = MakeDir(dir_);
+    if (ok_) thread_ = std::thread([this]() { run(); });
+}
+
+void ProxyWriter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        done_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void ProxyWriter::submit(int index, FrameCache::FramePtr frame) {
+    if (!ok_ || !frame || !frame->hasRgb()) return;
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this]() { return queue_.size() < kMaxQueued; });
+    queue_.emplace_back(index, std::move(frame));
+    lock.unlock();
+    cv_.notify_all();
+}
+
+int ProxyWriter::written() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return written_;
+}
+
+int ProxyWriter::failed() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return failed_;
+}
+
+std::string ProxyWriter::PathFor(const std::string& dir, int index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%06d.jpg", index);
+    return dir + "/" + name;
+}
+
+void ProxyWriter::run() {
+    for (;;) {
+        std::pair<int, FrameCache::FramePtr> item;
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            cv_.wait(lock, [this]() { return done_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            item = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        cv_.notify_all();
+        const bool ok = write(item.first, *item.second);
+        item.second.reset();  // back to the frame pool before the next one
+        std::lock_guard<std::mutex> lock(mu_);
+        (ok ? written_ : failed_)++;
+    }
+}
+
+bool ProxyWriter::write(int index, const LoadedRgbFrame& frame) {
+    const int dh = std::min(height_, frame.rgb_h);
+    const int dw = std::max(1, static_cast<int>((static_cast<int64_t>(frame.rgb_w) * dh + frame.rgb_h / 2) / frame.rgb_h));
+    const uint8_t* pixels = frame.rgbData();
+    if (dh != frame.rgb_h || dw != frame.rgb_w) {
+        ShrinkRgb(pixels, frame.rgb_w, frame.rgb_h, dw, dh, scaled_);
+        pixels = scaled_.data();
+    }
+    const std::string path = PathFor(dir_, index);
+    const std::string partial = path + ".part";
+    if (stbi_write_jpg(partial.c_str(), dw, dh, 3, pixels, quality_) == 0) {
+        std::remove(partial.c_str());
+        return false;
+    }
+    // rename() onto an existing file fails on Windows.
+    std::remove(path.c_str());
+    return std::rename(partial.c_str(), path.c_str()) == 0;
+}
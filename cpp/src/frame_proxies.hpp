@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "frame_cache.hpp"
+
+/**
+ * Small JPEG copies of the input frames for the panel to scrub
+ * (PipelineOptions::proxy_dir), made from the frames the pipeline decodes
+ * anyway instead of a second decode.
+ *
+ * The tracking loop hands each decoded frame over; one thread of the
+ * writer's own box-filters it down to `height` rows (never up) and writes
+ * <dir>/<frame index, 6 digits>.jpg, through a temporary name so a reader
+ * never sees half a file. Frames are held by their shared pointers until
+ * written, at most kMaxQueued at a time: submit() waits beyond that.
+ */
+class ProxyWriter {
+public:
+    static constexpr size_t kMaxQueued = 4;
+
+    /**
+     * @param dir Created if missing
+     * @param height Proxy rows (the width keeps the aspect ratio)
+     * @param quality JPEG quality, 1-100
+     */
+    ProxyWriter(std::string dir, int height, int quality);
+    ~ProxyWriter() { finish(); }
+
+    ProxyWriter(const ProxyWriter&) = delete;
+    ProxyWriter& operator=(const ProxyWriter&) = delete;
+
+    /** False if `dir` could not be created; nothing is written then. */
+    bool ok() const { return ok_; }
+
+    /** Queue frame `index` (it must have RGB). */
+    void submit(int index, FrameCache::FramePtr frame);
+
+    /** Write what is queued, then stop the thread; submit() nothing after. */
+    void finish();
+
+    /** Proxies written and failed so far. */
+    int written() const;
+    int failed() const;
+
+    /** File of frame `index`'s proxy in `dir`. */
+    static std::string PathFor(const std::string& dir, int index);
+
+private:
+    void run();
+    bool write(int index, const LoadedRgbFrame& frame);
+
+    std::string dir_;
+    int height_;
+    int quality_;
+    bool ok_ = false;
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<std::pair<int, FrameCache::FramePtr>> queue_;
+    bool done_ = false;
+    int written_ = 0;
+    int failed_ = 0;
+    std::vector<uint8_t> scaled_;  // writer thread only
+    std::thread thread_;
+};
@@ -0,0 +1,357 @@
+#include "frame_source.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "image_ops.hpp"
+
+namespace {
+bool SeekFile(FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Offset of the next byte of `f`, or -1 if it cannot seek (pipe, FIFO).
+int64_t TellFile(FILE* f) {
+#ifdef _WIN32
+    return static_cast<int64_t>(_ftelli64(f));
+#else
+    return static_cast<int64_t>(ftello(f));
+#endif
+}
+
+// Full-resolution RGB of one rectangle of the `w x h` NV12 frame at
+// `offset` of `path`: only the Y and UV rows it spans are read.
+bool ReadNv12Region(const std::string& path, uint64_t offset, int w, int h, int x, int y, int rw, int rh,
+                    std::vector<uint8_t>& rgb) {
+    if (x < 0 || y < 0 || rw <= 0 || rh <= 0 || x + rw > w || y + rh > h) return false;
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    // An even band of rows, so its chroma rows line up (h is even).
+    const int y0 = y & ~1;
+    const int band = (y + rh - y0 + 1) & ~1;
+    const size_t luma_bytes = static_cast<size_t>(w) * static_cast<size_t>(band);
+    std::vector<uint8_t> nv12(luma_bytes + luma_bytes / 2);
+    const bool ok = SeekFile(f, offset + static_cast<uint64_t>(y0) * w) &&
+                    std::fread(nv12.data(), 1, luma_bytes, f) == luma_bytes &&
+                    SeekFile(f, offset + static_cast<uint64_t>(w) * h + static_cast<uint64_t>(y0 / 2) * w) &&
+                    std::fread(nv12.data() + luma_bytes, 1, luma_bytes / 2, f) == luma_bytes / 2;
+    std::fclose(f);
+    if (ok) Nv12RegionToRgb(nv12.data(), w, band, x, y - y0, rw, rh, rgb);
+    return ok;
+}
+}  // namespace
+
+bool ImageListSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    if (index < 0 || index >= frameCount()) return false;
+    return LoadFrame(paths_[static_cast<size_t>(index)], req, out);
+}
+
+bool IsValidFramePattern(const std::string& pattern) {
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%') continue;
+        if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+            ++i;
+            continue;
+        }
+        size_t j = i + 1;
+        while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') ++j;
+        if (j >= pattern.size() || (pattern[j] != 'd' && pattern[j] != 'i')) return false;
+        conversions++;
+        i = j;
+    }
+    return conversions == 1;
+}
+
+std::string FormatFramePath(const std::string& pattern, int number) {
+    const int n = std::snprintf(nullptr, 0, pattern.c_str(), number);
+    if (n <= 0) return std::string();
+    std::string out(static_cast<size_t>(n) + 1, '\0');
+    std::snprintf(&out[0], out.size(), pattern.c_str(), number);
+    out.resize(static_cast<size_t>(n));
+    return out;
+}
+
+bool ImagePatternSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    if (index < 0 || index >= count_) return false;
+    return LoadFrame(framePath(index), req, out);
+}
+
+bool PathStreamSource::pathFor(int index, std::string& path) {
+    if (index < 0) return false;
+    auto lookup = [&] {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (index >= static_cast<int>(paths_.size())) return false;
+        path = paths_[static_cast<size_t>(index)];
+        return true;
+    };
+    if (lookup()) return true;
+
+    // Only one reader blocks on the stream; lookups of known paths by other
+    // decoders do not wait behind it.
+    std::lock_guard<std::mutex> read_lock(read_mu_);
+    std::string line;
+    while (!lookup()) {
+        if (end_index_.load() >= 0) return false;
+        if (!std::getline(in_, line)) {
+            std::lock_guard<std::mutex> lock(mu_);
+            end_index_ = static_cast<int>(paths_.size());
+            continue;
+        }
+        // Trim whitespace
+        const size_t start = line.find_first_not_of(" \t\r\n");
+        const size_t end = line.find_last_not_of(" \t\r\n");
+        if (start != std::string::npos && end != std::string::npos) {
+            std::lock_guard<std::mutex> lock(mu_);
+            paths_.push_back(line.substr(start, end - start + 1));
+        }
+    }
+    return true;
+}
+
+bool PathStreamSource::waitForFrame(int index) {
+    std::string path;
+    return pathFor(index, path);
+}
+
+bool PathStreamSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    std::string path;
+    if (!pathFor(index, path)) {
+        out.clear();
+        return false;
+    }
+    return LoadFrame(path, req, out);
+}
+
+size_t RawStreamFormat::frameBytes() const {
+    if (width <= 0 || height <= 0) return 0;
+    const size_t px = static_cast<size_t>(width) * static_cast<size_t>(height);
+    switch (format) {
+        case RawPixelFormat::RGB24: return px * 3u;
+        case RawPixelFormat::BGRA: return px * 4u;
+        case RawPixelFormat::NV12:
+            if ((width & 1) || (height & 1)) return 0;
+            return px + px / 2u;
+    }
+    return 0;
+}
+
+bool ParseRawPixelFormat(const std::string& name, RawPixelFormat& out) {
+    if (name == "rgb24" || name == "rgb") {
+        out = RawPixelFormat::RGB24;
+    } else if (name == "bgra") {
+        out = RawPixelFormat::BGRA;
+    } else if (name == "nv12") {
+        out = RawPixelFormat::NV12;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+RawStreamSource::RawStreamSource(const std::string& path, const RawStreamFormat& format)
+    : format_(format) {
+    if (path == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        file_ = stdin;
+    } else {
+        file_ = std::fopen(path.c_str(), "rb");
+        owns_file_ = (file_ != nullptr);
+        if (!file_) {
+            error_ = "cannot open raw stream " + path;
+            return;
+        }
+    }
+
+    if (format_.width <= 0 || format_.height <= 0) {
+        if (!readHeader()) return;
+    }
+    if (format_.frameBytes() == 0) {
+        error_ = "invalid raw stream geometry (NV12 needs even width/height)";
+        return;
+    }
+    if (format_.frame_count == 0) end_index_ = 0;
+    // A stream read from a file can be read again: reduced NV12 frames then
+    // fetch full-resolution regions from it instead of keeping the frame.
+    if (path != "-") {
+        path_ = path;
+        data_offset_ = TellFile(file_);
+    }
+}
+
+RawStreamSource::~RawStreamSource() {
+    if (owns_file_ && file_) std::fclose(file_);
+}
+
+bool RawStreamSource::readHeader() {
+    // Header is a single text line; read it byte-wise so no frame data is buffered away.
+    std::string line;
+    for (;;) {
+        const int c = std::fgetc(file_);
+        if (c == EOF) break;
+        if (c == '\n') break;
+        line.push_back(static_cast<char>(c));
+        if (line.size() > 256) break;
+    }
+
+    std::istringstream is(line);
+    std::string magic, fmt;
+    int w = 0, h = 0;
+    is >> magic >> w >> h >> fmt;
+    if (magic != "FPRAW" || w <= 0 || h <= 0 || !ParseRawPixelFormat(fmt, format_.format)) {
+        error_ = "bad raw stream header (expected 'FPRAW <w> <h> <rgb24|bgra|nv12> [frames]')";
+        return false;
+    }
+    format_.width = w;
+    format_.height = h;
+    int frames = -1;
+    if (is >> frames) format_.frame_count = frames;
+    return true;
+}
+
+void FillRawFrame(const uint8_t* px, const RawStreamFormat& format, const FrameRequest& req, LoadedRgbFrame& out) {
+    const int w = format.width;
+    const int h = format.height;
+    out.w = w;
+    out.h = h;
+    if (req.rgb) {
+        out.rgb_w = w;
+        out.rgb_h = h;
+    }
+    switch (format.format) {
+        case RawPixelFormat::RGB24:
+            if (req.rgb && px != out.rgb.data()) out.rgb.assign(px, px + format.frameBytes());
+            if (req.luma_downscale > 0) RgbToLumaDownsample(px, w, h, req.luma_downscale, out.luma);
+            break;
+        case RawPixelFormat::BGRA:
+            if (req.luma_downscale > 0) BgraToLumaDownsample(px, w, h, req.luma_downscale, out.luma);
+            if (req.rgb) BgraToRgb(px, w, h, out.rgb);
+            break;
+        case RawPixelFormat::NV12:
+            // The Y plane already is luma; only detection frames pay for
+            // YUV->RGB, converted straight to the reduced size they allow.
+            if (req.luma_downscale > 0) DownsampleLuma(px, w, h, req.luma_downscale, out.luma);
+            if (req.rgb) {
+                const int factor = RgbReduction(w, h, req.rgb_min_long_side);
+                Nv12ToRgbReduced(px, w, h, factor, out.rgb);
+                out.rgb_w = (w + factor - 1) / factor;
+                out.rgb_h = (h + factor - 1) / factor;
+            }
+            break;
+    }
+    if (req.luma_downscale > 0) {
+        out.luma_w = DownscaledSize(w, req.luma_downscale);
+        out.luma_h = DownscaledSize(h, req.luma_downscale);
+        out.luma_scale = req.luma_downscale;
+    }
+}
+
+bool RawStreamSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!isOpen() || index != next_index_) return false;
+    if (end_index_.load() >= 0 && index >= end_index_.load()) return false;
+
+    const size_t bytes = format_.frameBytes();
+    // Packed RGB24 for a detection frame is read straight into the frame.
+    const bool direct = (format_.format == RawPixelFormat::RGB24 && req.rgb);
+    std::vector<uint8_t>& dst = direct ? out.rgb : scratch_;
+    dst.resize(bytes);
+    if (std::fread(dst.data(), 1, bytes, file_) != bytes) {
+        out.clear();
+        end_index_ = index;
+        return false;
+    }
+    next_index_++;
+    if (format_.frame_count >= 0 && next_index_ >= format_.frame_count) end_index_ = next_index_;
+    FillRawFrame(dst.data(), format_, req, out);
+    if (format_.format == RawPixelFormat::NV12 && out.rgb_w < out.w && data_offset_ >= 0) {
+        const uint64_t offset = static_cast<uint64_t>(data_offset_) + static_cast<uint64_t>(index) * bytes;
+        const int w = format_.width;
+        const int h = format_.height;
+        out.read_full_res = [path = path_, offset, w, h](int x, int y, int rw, int rh, std::vector<uint8_t>& rgb) {
+            return ReadNv12Region(path, offset, w, h, x, y, rw, rh, rgb);
+        };
+    }
+    return true;
+}
+
+int ChunkFrameSource::clamp(int inner_end) const {
+    if (inner_end < 0) return -1;
+    const int end = end_ >= 0 ? std::min(end_, inner_end) : inner_end;
+    return std::max(0, end - first_);
+}
+
+int ChunkFrameSource::frameCount() const {
+    const int inner_count = inner_.frameCount();
+    return inner_count < 0 ? -1 : clamp(inner_count);
+}
+
+int ChunkFrameSource::endIndex() const {
+    const int inner_end = inner_.endIndex();
+    if (inner_end >= 0) return clamp(inner_end);
+    // An open stream still ends at the chunk's end.
+    return end_ >= 0 ? std::max(0, end_ - first_) : -1;
+}
+
+bool ChunkFrameSource::waitForFrame(int index) {
+    if (end_ >= 0 && first_ + index >= end_) return false;
+    return inner_.waitForFrame(first_ + index);
+}
+
+bool ChunkFrameSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    if (index < 0 || (end_ >= 0 && first_ + index >= end_)) return false;
+    const int target = first_ + index;
+    if (!inner_.skipsForward()) {
+        // Reads come in order from one decoder; skip ahead to the target.
+        FrameRequest skip;
+        skip.rgb = false;
+        LoadedRgbFrame dropped;
+        while (next_inner_ < target) {
+            if (!inner_.read(next_inner_++, skip, dropped)) return false;
+        }
+        next_inner_ = target + 1;
+    }
+    return inner_.read(target, req, out);
+}
+
+std::vector<int> ChunkFrameSource::keyframes() const {
+    std::vector<int> out;
+    for (const int k : inner_.keyframes()) {
+        if (end_ >= 0 && k >= end_) break;
+        if (k >= first_) out.push_back(k - first_);
+    }
+    return out;
+}
+
+bool ScaledFrameSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    // The luma downscale is from source pixels; the RGB floor is what the
+    // detector needs, whatever the resolution it comes from.
+    FrameRequest proxy = req;
+    if (req.luma_downscale > 0) {
+        proxy.luma_downscale = std::max(1, static_cast<int>(std::lround(req.luma_downscale / scale_)));
+    }
+    if (!inner_.read(index, proxy, out)) return false;
+    out.read_full_res = nullptr;  // it reads the proxy's grid, not the source's
+    out.w = static_cast<int>(std::lround(out.w * scale_));
+    out.h = static_cast<int>(std::lround(out.h * scale_));
+    if (out.luma_scale > 0) out.luma_scale = std::max(1, static_cast<int>(std::lround(out.luma_scale * scale_)));
+    for (auto& v : out.motion_vectors) {
+        for (float& c : v) c *= scale_;
+    }
+    return true;
+}
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_cache.hpp"
+
+/**
+ * Where tracking frames come from.
+ *
+ * Frames are always requested in increasing index order by the tracking loop.
+ * Sources that allow it (`randomAccess()`) may also be read concurrently and
+ * out of order by the prefetch pool; streams are read by a single decoder.
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    /**
+     * Total number of frames if known up front, -1 for open-ended streams.
+     */
+    virtual int frameCount() const = 0;
+
+    /**
+     * True if read() may be called concurrently and in any order.
+     */
+    virtual bool randomAccess() const = 0;
+
+    /**
+     * Read frame `index` into the planes described by `req`.
+     *
+     * @return false if the frame could not be read (see endIndex() for EOF)
+     */
+    virtual bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) = 0;
+
+    /**
+     * First index known to be past the end of the stream, or -1 if not reached.
+     */
+    virtual int endIndex() const { return frameCount(); }
+
+    /**
+     * Image file frame `index` is decoded from as is (read() being just its
+     * decode), or empty if it has none (yet); --read-ahead reads such files
+     * early, --delete-consumed removes them.
+     */
+    virtual std::string filePath(int index) const {
+        (void)index;
+        return {};
+    }
+
+    /**
+     * Block until it is known whether frame `index` exists.
+     *
+     * Sources that can only find out by decoding (raw/video streams) answer
+     * optimistically until they hit EOF.
+     */
+    virtual bool waitForFrame(int index) {
+        if (frameCount() >= 0) return index < frameCount();
+        const int end = endIndex();
+        return end < 0 || index < end;
+    }
+
+    /**
+     * True if frames may be passed over: a stream read at a later index
+     * than the next one moves there, and the frames in between are gone.
+     * Random-access sources always can.
+     */
+    virtual bool skipsForward() const { return randomAccess(); }
+
+    /**
+     * Frames that decode on their own (video keyframes), ascending; empty
+     * if the source does not know them or has no such distinction. A
+     * forward skip onto one decodes nothing before it.
+     */
+    virtual std::vector<int> keyframes() const { return {}; }
+};
+
+/**
+ * One image file per frame (PNG/JPEG/... via stb).
+ */
+class ImageListSource final : public FrameSource {
+public:
+    explicit ImageListSource(const std::vector<std::string>& paths) : paths_(paths) {}
+
+    int frameCount() const override { return static_cast<int>(paths_.size()); }
+    bool randomAccess() const override { return true; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    std::string filePath(int index) const override {
+        return index >= 0 && index < frameCount() ? paths_[static_cast<size_t>(index)] : std::string();
+    }
+
+private:
+    const std::vector<std::string>& paths_;
+};
+
+/**
+ * Check that `pattern` contains exactly one integer conversion (e.g. %06d).
+ */
+bool IsValidFramePattern(const std::string& pattern);
+
+/**
+ * Expand a frame pattern (see IsValidFramePattern) for frame number `number`.
+ */
+std::string FormatFramePath(const std::string& pattern, int number);
+
+/**
+ * Image sequence described by a printf-style pattern and a frame number range.
+ *
+ * Paths are built when a frame is read, so a long timeline costs neither the
+ * path list on stdin nor one string per frame in memory.
+ */
+class ImagePatternSource final : public FrameSource {
+public:
+    /**
+     * Frames `first..last` (inclusive) of `pattern`, e.g. "/tmp/x/frame%06d.png".
+     */
+    ImagePatternSource(const std::string& pattern, int first, int last)
+        : pattern_(pattern), first_(first), count_(last >= first ? last - first + 1 : 0) {}
+
+    std::string framePath(int index) const { return FormatFramePath(pattern_, first_ + index); }
+
+    int frameCount() const override { return count_; }
+    bool randomAccess() const override { return true; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    std::string filePath(int index) const override {
+        return index >= 0 && index < count_ ? framePath(index) : std::string();
+    }
+
+private:
+    std::string pattern_;
+    int first_;
+    int count_;
+};
+
+/**
+ * Image paths consumed incrementally from a text stream (one per line).
+ *
+ * Frames can be decoded as soon as their line arrives, so tracking overlaps
+ * with whatever is still producing the sequence; the stream ends at EOF.
+ * Decoding of already known paths can run concurrently.
+ */
+class PathStreamSource final : public FrameSource {
+public:
+    explicit PathStreamSource(std::istream& in) : in_(in) {}
+
+    int frameCount() const override { return -1; }
+    bool randomAccess() const override { return true; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    int endIndex() const override { return end_index_.load(); }
+    bool waitForFrame(int index) override;
+
+private:
+    bool pathFor(int index, std::string& path);
+
+    std::istream& in_;
+    std::mutex read_mu_;  // serializes reads from `in_`
+    std::mutex mu_;       // guards `paths_`
+    std::vector<std::string> paths_;
+    std::atomic<int> end_index_{-1};
+};
+
+/**
+ * Pixel layout of a raw frame stream.
+ */
+enum class RawPixelFormat {
+    RGB24,  // packed R,G,B
+    BGRA,   // packed B,G,R,A (alpha ignored)
+    NV12,   // Y plane + interleaved half-size UV plane
+};
+
+/**
+ * Geometry of a raw frame stream.
+ */
+struct RawStreamFormat {
+    int width = 0;
+    int height = 0;
+    RawPixelFormat format = RawPixelFormat::RGB24;
+    int frame_count = -1;  // -1 = read until EOF
+
+    size_t frameBytes() const;
+};
+
+/**
+ * Fill the planes `req` asks for from one raw frame of `format` at `px`
+ * (frameBytes() bytes). Packed RGB24 may already be `out.rgb` itself.
+ * NV12 honors `req.rgb_min_long_side`, converting to reduced RGB directly.
+ */
+void FillRawFrame(const uint8_t* px, const RawStreamFormat& format, const FrameRequest& req, LoadedRgbFrame& out);
+
+/**
+ * Parse a pixel format name ("rgb24", "bgra", "nv12").
+ *
+ * @return false if the name is unknown
+ */
+bool ParseRawPixelFormat(const std::string& name, RawPixelFormat& out);
+
+/**
+ * Packed raw frames on stdin or a named pipe.
+ *
+ * The stream either starts with a one-line text header:
+ *
+ *   FPRAW <width> <height> <rgb24|bgra|nv12> [frame_count]\n
+ *
+ * or the geometry is given up front (e.g. `ffmpeg -f rawvideo -pix_fmt rgb24 -`)
+ * and the stream carries frames only. Frames follow back to back with no
+ * padding; the stream ends at EOF or after `frame_count` frames.
+ *
+ * When the stream is a file, NV12 frames decoded to reduced RGB read their
+ * full-resolution regions back from it (LoadedRgbFrame::read_full_res).
+ */
+class RawStreamSource final : public FrameSource {
+public:
+    /**
+     * Open a stream. `path` is a file or FIFO path, or "-" for stdin.
+     * If `format.width/height` are 0 the header is read from the stream.
+     */
+    RawStreamSource(const std::string& path, const RawStreamFormat& format);
+    ~RawStreamSource() override;
+
+    RawStreamSource(const RawStreamSource&) = delete;
+    RawStreamSource& operator=(const RawStreamSource&) = delete;
+
+    /**
+     * True if the stream was opened and has a valid geometry.
+     */
+    bool isOpen() const { return file_ != nullptr && format_.frameBytes() > 0; }
+    const std::string& error() const { return error_; }
+    const RawStreamFormat& format() const { return format_; }
+
+    int frameCount() const override { return format_.frame_count; }
+    bool randomAccess() const override { return false; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    int endIndex() const override { return end_index_.load(); }
+
+private:
+    bool readHeader();
+
+    FILE* file_ = nullptr;
+    bool owns_file_ = false;
+    std::string path_;          // reopened for full-resolution regions
+    int64_t data_offset_ = -1;  // first frame's offset in `path_`, -1 if it cannot seek
+    RawStreamFormat format_;
+    std::string error_;
+
+    std::mutex mu_;
+    int next_index_ = 0;
+    std::vector<uint8_t> scratch_;
+    std::atomic<int> end_index_{-1};
+};
+
+/**
+ * Frames `first..end-1` of another source, as frames 0.. (--chunk).
+ *
+ * Pipeline frame indices are then relative to `first`. Sequential sources
+ * (streams, video) are read from their start: the frames before `first`
+ * are decoded and dropped on the way to it.
+ */
+class ChunkFrameSource final : public FrameSource {
+public:
+    /**
+     * @param end One past the last frame (-1 = to the end of `inner`)
+     */
+    ChunkFrameSource(FrameSource& inner, int first, int end) : inner_(inner), first_(first), end_(end) {}
+
+    int frameCount() const override;
+    bool randomAccess() const override { return inner_.randomAccess(); }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    int endIndex() const override;
+    bool waitForFrame(int index) override;
+    std::string filePath(int index) const override {
+        if (index < 0 || (end_ >= 0 && first_ + index >= end_)) return {};
+        return inner_.filePath(first_ + index);
+    }
+    bool skipsForward() const override { return inner_.skipsForward(); }
+    std::vector<int> keyframes() const override;
+
+private:
+    // Frames of `inner` from `first_` on, clamped to the chunk (-1 = unknown).
+    int clamp(int inner_end) const;
+
+    FrameSource& inner_;
+    int first_;
+    int end_;
+    int next_inner_ = 0;  // sequential sources: next frame of `inner_` to read
+};
+
+/**
+ * Frames of another source decoded from proxies, reported at the source
+ * resolution (--input-scale): `w` x `h` are the proxy's times `scale`, and
+ * so are luma_scale and motion vectors, while RGB stays the proxy's. Boxes
+ * are normalized and warps come out in source pixels, so the rest of the
+ * pipeline works as if it had the full-resolution frames. Proxies must keep
+ * the source's aspect ratio; scales that do not divide the luma downscale
+ * round its plane to the nearest whole factor.
+ */
+class ScaledFrameSource final : public FrameSource {
+public:
+    ScaledFrameSource(FrameSource& inner, float scale) : inner_(inner), scale_(scale) {}
+
+    int frameCount() const override { return inner_.frameCount(); }
+    bool randomAccess() const override { return inner_.randomAccess(); }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    int endIndex() const override { return inner_.endIndex(); }
+    bool waitForFrame(int index) override { return inner_.waitForFrame(index); }
+    bool skipsForward() const override { return inner_.skipsForward(); }
+    std::vector<int> keyframes() const override { return inner_.keyframes(); }
+
+private:
+    FrameSource& inner_;
+    float scale_;  // source pixels per proxy pixel
+};
+
+/**
+ * Frames `end-1` down to 0 of another source, as frames 0.. : tracking it
+ * goes back in time (--priority-frame). `inner` must allow random access
+ * and know its frame count.
+ */
+class ReversedFrameSource final : public FrameSource {
+public:
+    ReversedFrameSource(FrameSource& inner, int end) : inner_(inner), end_(end) {}
+
+    int frameCount() const override { return std::max(0, std::min(end_, inner_.frameCount())); }
+    bool randomAccess() const override { return true; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override {
+        if (index < 0 || index >= frameCount()) return false;
+        return inner_.read(frameCount() - 1 - index, req, out);
+    }
+
+    std::string filePath(int index) const override {
+        if (index < 0 || index >= frameCount()) return {};
+        return inner_.filePath(frameCount() - 1 - index);
+    }
+
+    /** Input frame of frame `index` of this source, and back. */
+    int inputIndex(int index) const { return frameCount() - 1 - index; }
+
+private:
+    FrameSource& inner_;
+    int end_;
+};
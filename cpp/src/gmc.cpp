@@ -1,26 +1,170 @@
 #include "gmc.hpp"
 
+#include "gmc_features.hpp"
+#include "gmc_phase.hpp"
+#include "image_ops.hpp"
+#include "simd_kernels.hpp"
+#include "tracy_zones.hpp"
+
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
+#include <utility>
+#include <vector>
 
 namespace {
 inline int clamp_downscale(int d) { return std::max(1, d); }
+
+constexpr int kPyramidFactor = 4;  // coarse GMC level: luma plane reduced 4x again
+constexpr int kMinPlaneSide = 32;  // smaller planes hold too few samples for a search
+
+// Exclusion boxes in the coordinates of a plane reduced by `down`, grown by
+// `margin` of their size on each side.
+GmcEstimator::ExcludeBoxes PlaneExclusion(const GmcEstimator::ExcludeBoxes* boxes, int down, float margin) {
+    GmcEstimator::ExcludeBoxes out;
+    if (!boxes) return out;
+    out.reserve(boxes->size());
+    const float inv = 1.0f / static_cast<float>(down);
+    for (const std::array<float, 4>& b : *boxes) {
+        const float mx = (b[2] - b[0]) * margin;
+        const float my = (b[3] - b[1]) * margin;
+        out.push_back({(b[0] - mx) * inv, (b[1] - my) * inv, (b[2] + mx) * inv, (b[3] + my) * inv});
+    }
+    return out;
+}
 }  // namespace
 
+const uint8_t* GmcEstimator::BuildCoarseLuma(const uint8_t* luma, int w, int h, std::vector<uint8_t>& out) {
+#ifdef FACE_PIPELINE_GMC_OPENCV
+    (void)luma;
+    (void)w;
+    (void)h;
+    out.clear();
+    return nullptr;
+#else
+    const int cw = w / kPyramidFactor;
+    const int ch = h / kPyramidFactor;
+    if (!luma || w < kMinPlaneSide || h < kMinPlaneSide || cw < kMinPlaneSide || ch < kMinPlaneSide) {
+        out.clear();
+        return nullptr;
+    }
+    // 4x4 box average, one output row at a time.
+    out.resize(static_cast<size_t>(cw) * static_cast<size_t>(ch));
+    std::vector<uint16_t> sums(static_cast<size_t>(cw));
+    for (int y = 0; y < ch; ++y) {
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int j = 0; j < kPyramidFactor; ++j) {
+            const uint8_t* row = luma + static_cast<size_t>(y * kPyramidFactor + j) * static_cast<size_t>(w);
+            for (int x = 0; x < cw; ++x) {
+                const uint8_t* p = row + x * kPyramidFactor;
+                sums[x] = static_cast<uint16_t>(sums[x] + p[0] + p[1] + p[2] + p[3]);
+            }
+        }
+        uint8_t* dst = out.data() + static_cast<size_t>(y) * static_cast<size_t>(cw);
+        for (int x = 0; x < cw; ++x) dst[x] = static_cast<uint8_t>(sums[x] / (kPyramidFactor * kPyramidFactor));
+    }
+    return out.data();
+#endif
+}
+
+bool GmcEstimator::Estimate(const uint8_t* curr_rgb, int curr_w, int curr_h,
+                            const uint8_t* prev_rgb, int prev_w, int prev_h,
+                            Mat3f& out_warp,
+                            const ExcludeBoxes* exclude) noexcept {
+    FACE_PIPELINE_ZONE("GmcEstimator::Estimate");
+    out_warp = Mat3f::Identity();
+    if (!curr_rgb || !prev_rgb) return false;
+    if (curr_w <= 0 || curr_h <= 0 || prev_w <= 0 || prev_h <= 0) return false;
+    if (curr_w != prev_w || curr_h != prev_h) return false;
+
+    const int down = clamp_downscale(cfg_.downscale);
+    std::vector<uint8_t> curr_luma, prev_luma;
+    RgbToLumaDownsample(curr_rgb, curr_w, curr_h, down, curr_luma);
+    RgbToLumaDownsample(prev_rgb, prev_w, prev_h, down, prev_luma);
+    return EstimateLuma(curr_luma.data(), prev_luma.data(),
+                        DownscaledSize(curr_w, down), DownscaledSize(curr_h, down), down,
+                        out_warp, nullptr, nullptr, exclude);
+}
+
+bool GmcEstimator::EstimateVectors(const MotionVectors& vectors, int frame_w, int frame_h,
+                                   Mat3f& out_warp,
+                                   const ExcludeBoxes* exclude) const noexcept {
+    FACE_PIPELINE_ZONE("GmcEstimator::EstimateVectors");
+    // Block motion is quarter-pel, but a block's best match is not always
+    // its true motion; a little more slack than for tracked corners.
+    constexpr float kVectorInlierPixels = 2.0f;
+    out_warp = Mat3f::Identity();
+    if (frame_w <= 0 || frame_h <= 0 || vectors.empty()) return false;
+    const ExcludeBoxes excluded = PlaneExclusion(exclude, 1, cfg_.exclude_margin);
+    std::vector<FeatureMotionEstimator::Corner> p0, p1;
+    p0.reserve(vectors.size());
+    p1.reserve(vectors.size());
+    for (const std::array<float, 4>& v : vectors) {
+        bool skip = false;
+        for (const std::array<float, 4>& b : excluded) {
+            if (v[0] >= b[0] && v[0] < b[2] && v[1] >= b[1] && v[1] < b[3]) {
+                skip = true;
+                break;
+            }
+        }
+        if (skip) continue;
+        p0.push_back(FeatureMotionEstimator::Corner{v[0], v[1]});
+        p1.push_back(FeatureMotionEstimator::Corner{v[2], v[3]});
+    }
+    Mat3f warp = Mat3f::Identity();
+    if (!FitRobustMotion(std::move(p0), std::move(p1), frame_w, frame_h, cfg_.model == GmcConfig::Model::Homography,
+                         kVectorInlierPixels, warp)) {
+        return false;
+    }
+    out_warp = warp;
+    return true;
+}
+
 #ifdef FACE_PIPELINE_GMC_OPENCV
 
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
+#include "opencv2/video/tracking.hpp"
 #include "opencv2/videostab.hpp"
 
+// Keypoints and sparse LK flow as videostab's KeypointBasedMotionEstimator
+// runs them (GFTT corners on the earlier frame, 21x21 window, 3 pyramid
+// levels), with the later frame's corners and flow pyramid kept: frame i's
+// "curr" is frame i+1's "prev", so each frame is prepared once.
 struct GmcEstimator::Impl {
+    static constexpr int kMaxCorners = 1000;
+    static constexpr int kMinPoints = 4;  // fewer tracked points fit no motion model
+
     cv::videostab::MotionModel motion_model = cv::videostab::MM_SIMILARITY;
     cv::Ptr<cv::videostab::MotionEstimatorRansacL2> est;
-    cv::Ptr<cv::videostab::KeypointBasedMotionEstimator> kbest;
+
+    // The previous call's current frame: its plane (to recognise it as the
+    // next call's previous frame), flow pyramid and corners.
+    std::vector<uint8_t> last_plane;
+    int last_w = 0;
+    int last_h = 0;
+    std::vector<cv::Mat> last_pyramid;
+    std::vector<cv::Point2f> last_corners;
 
     explicit Impl(cv::videostab::MotionModel m) : motion_model(m) {
         est = cv::makePtr<cv::videostab::MotionEstimatorRansacL2>(motion_model);
-        kbest = cv::makePtr<cv::videostab::KeypointBasedMotionEstimator>(est);
+    }
+
+    static const cv::Size& FlowWindow() {
+        static const cv::Size size(21, 21);
+        return size;
+    }
+
+    static void Prepare(const cv::Mat& plane, std::vector<cv::Mat>& pyramid, std::vector<cv::Point2f>& corners) {
+        cv::buildOpticalFlowPyramid(plane, pyramid, FlowWindow(), 3);
+        cv::goodFeaturesToTrack(plane, corners, kMaxCorners, 0.01, 1.0, cv::noArray(), 3);
+    }
+
+    bool isLast(const uint8_t* plane, int w, int h) const {
+        return w == last_w && h == last_h && !last_plane.empty() &&
+               std::memcmp(plane, last_plane.data(), last_plane.size()) == 0;
     }
 };
 
@@ -45,29 +189,71 @@ GmcEstimator::GmcEstimator(GmcConfig cfg) : cfg_(cfg) {
 
 GmcEstimator::~GmcEstimator() = default;
 
-bool GmcEstimator::Estimate(const uint8_t* curr_rgb, int curr_w, int curr_h,
-                            const uint8_t* prev_rgb, int prev_w, int prev_h,
-                            Mat3f& out_warp) noexcept {
+bool GmcEstimator::EstimateLuma(const uint8_t* curr_luma, const uint8_t* prev_luma,
+                                int plane_w, int plane_h, int downscale,
+                                Mat3f& out_warp,
+                                const uint8_t*,
+                                const uint8_t*,
+                                const ExcludeBoxes* exclude) noexcept {
+    FACE_PIPELINE_ZONE("GmcEstimator::EstimateLuma");
     out_warp = Mat3f::Identity();
     if (!impl_) return false;
-    if (!curr_rgb || !prev_rgb) return false;
-    if (curr_w <= 0 || curr_h <= 0 || prev_w <= 0 || prev_h <= 0) return false;
-    if (curr_w != prev_w || curr_h != prev_h) return false;
-
-    const int down = clamp_downscale(cfg_.downscale);
-    const int ds_w = std::max(1, curr_w / down);
-    const int ds_h = std::max(1, curr_h / down);
-
-    // NOTE: stb_image loads RGB; videostab does not require a specific channel order.
-    cv::Mat curr(curr_h, curr_w, CV_8UC3, const_cast<uint8_t*>(curr_rgb));
-    cv::Mat prev(curr_h, curr_w, CV_8UC3, const_cast<uint8_t*>(prev_rgb));
+    if (!curr_luma || !prev_luma) return false;
+    if (plane_w <= 0 || plane_h <= 0) return false;
+    const int down = clamp_downscale(downscale);
+
+    // Keypoint detection and sparse LK flow work on 8-bit gray. The planes
+    // are INTER_LINEAR reductions (GmcLumaFilter), as cv::resize() gave this
+    // backend the RGB frames, converted to luma with BT.601 weights.
+    cv::Mat curr_ds(plane_h, plane_w, CV_8UC1, const_cast<uint8_t*>(curr_luma));
+    cv::Mat prev_ds(plane_h, plane_w, CV_8UC1, const_cast<uint8_t*>(prev_luma));
+
+    Impl& im = *impl_;
+    std::vector<cv::Mat> prev_pyramid;
+    std::vector<cv::Point2f> prev_corners;
+    if (im.isLast(prev_luma, plane_w, plane_h)) {
+        prev_pyramid = std::move(im.last_pyramid);
+        prev_corners = std::move(im.last_corners);
+    } else {
+        Impl::Prepare(prev_ds, prev_pyramid, prev_corners);
+    }
+    std::vector<cv::Mat> curr_pyramid;
+    std::vector<cv::Point2f> curr_corners;
+    Impl::Prepare(curr_ds, curr_pyramid, curr_corners);
+
+    std::vector<cv::Point2f> tracked;
+    std::vector<uchar> status;
+    std::vector<float> flow_err;
+    if (prev_corners.size() >= static_cast<size_t>(Impl::kMinPoints)) {
+        cv::calcOpticalFlowPyrLK(prev_pyramid, curr_pyramid, prev_corners, tracked, status, flow_err,
+                                 Impl::FlowWindow(), 3);
+    }
 
-    cv::Mat curr_ds, prev_ds;
-    cv::resize(curr, curr_ds, cv::Size(ds_w, ds_h), 0, 0, cv::INTER_LINEAR);
-    cv::resize(prev, prev_ds, cv::Size(ds_w, ds_h), 0, 0, cv::INTER_LINEAR);
+    // Keep the current frame for the next call before anything can fail.
+    im.last_plane.assign(curr_luma, curr_luma + static_cast<size_t>(plane_w) * static_cast<size_t>(plane_h));
+    im.last_w = plane_w;
+    im.last_h = plane_h;
+    im.last_pyramid = std::move(curr_pyramid);
+    im.last_corners = std::move(curr_corners);
+
+    // Corners on excluded (foreground) regions would fit their motion, not the camera's.
+    const ExcludeBoxes boxes = PlaneExclusion(exclude, down, cfg_.exclude_margin);
+    auto excluded = [&](const cv::Point2f& p) {
+        for (const std::array<float, 4>& b : boxes) {
+            if (p.x >= b[0] && p.x < b[2] && p.y >= b[1] && p.y < b[3]) return true;
+        }
+        return false;
+    };
+    std::vector<cv::Point2f> points0, points1;
+    for (size_t k = 0; k < status.size(); ++k) {
+        if (!status[k] || excluded(prev_corners[k])) continue;
+        points0.push_back(prev_corners[k]);
+        points1.push_back(tracked[k]);
+    }
+    if (points0.size() < static_cast<size_t>(Impl::kMinPoints)) return false;
 
     bool ok = false;
-    cv::Mat warp = impl_->kbest->estimate(prev_ds, curr_ds, &ok);
+    cv::Mat warp = im.est->estimate(points0, points1, &ok);
     if (!ok || warp.empty()) {
         return false;
     }
@@ -92,123 +278,531 @@ bool GmcEstimator::Estimate(const uint8_t* curr_rgb, int curr_w, int curr_h,
 
 #else
 
-struct GmcEstimator::Impl {};
+// The fallback estimators that keep state; the translation search has none.
+struct GmcEstimator::Impl {
+    std::unique_ptr<FeatureMotionEstimator> features;
+    std::unique_ptr<PhaseCorrelator> phase;
+};
 
-GmcEstimator::GmcEstimator(GmcConfig cfg) : cfg_(cfg) {}
+GmcEstimator::GmcEstimator(GmcConfig cfg) : cfg_(cfg) {
+    if (cfg_.fallback == GmcConfig::Fallback::Features) {
+        impl_ = std::make_unique<Impl>();
+        impl_->features = std::make_unique<FeatureMotionEstimator>(cfg_.model == GmcConfig::Model::Homography);
+    } else if (cfg_.fallback == GmcConfig::Fallback::Adaptive) {
+        impl_ = std::make_unique<Impl>();
+        impl_->features = std::make_unique<FeatureMotionEstimator>(false, cfg_.adaptive_inliers);
+    } else if (cfg_.fallback == GmcConfig::Fallback::PhaseCorrelation) {
+        impl_ = std::make_unique<Impl>();
+        impl_->phase = std::make_unique<PhaseCorrelator>();
+    }
+}
 GmcEstimator::~GmcEstimator() = default;
 
 namespace {
-inline uint8_t luma_u8(const uint8_t* rgb) {
-    // Integer approx of BT.601: 0.299 R + 0.587 G + 0.114 B
-    const int r = rgb[0];
-    const int g = rgb[1];
-    const int b = rgb[2];
-    return static_cast<uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
-}
+// Translation search on a downsampled luma plane pyramid: every shift within
+// +/-kShiftSadRadius on a plane 4x smaller again, then a small window around
+// the (scaled up) winner on the given plane. The coarse level extends the
+// range to +/-8 * 4 * downscale full-resolution pixels (+/-128 at down=4)
+// for about a tenth of the SAD work of a full search at the fine level.
+constexpr int kRefineRadius = 3;   // fine-level window, coarse rounding plus slack
+constexpr float kMinKeptSamples = 0.25f;  // exclusions leaving fewer of a grid's samples are ignored
+
+// Sample grid of a search: every `step`th pixel at least `margin` inside
+// the plane, less the samples an exclusion mask leaves out.
+struct SearchGrid {
+    int x0, x1, y0, y1, step;
+    int nx, ny;                 // samples per row, rows
+    std::vector<uint8_t> keep;  // ny x nx, empty = every sample
+
+    SearchGrid(int w, int h, int margin, int s)
+        : x0(margin), x1(w - margin), y0(margin), y1(h - margin), step(s),
+          nx(std::max(0, (x1 - x0 + s - 1) / s)), ny(std::max(0, (y1 - y0 + s - 1) / s)) {}
+
+    // Leave out samples inside `boxes` (x1, y1, x2, y2 in plane pixels),
+    // unless that leaves too few.
+    void exclude(const GmcEstimator::ExcludeBoxes& boxes) {
+        if (boxes.empty() || nx == 0 || ny == 0) return;
+        std::vector<uint8_t> mask(static_cast<size_t>(nx) * static_cast<size_t>(ny), 1);
+        size_t kept = mask.size();
+        for (int r = 0; r < ny; ++r) {
+            const float y = static_cast<float>(y0 + r * step);
+            for (int c = 0; c < nx; ++c) {
+                const float x = static_cast<float>(x0 + c * step);
+                for (const std::array<float, 4>& b : boxes) {
+                    if (x >= b[0] && x < b[2] && y >= b[1] && y < b[3]) {
+                        mask[static_cast<size_t>(r) * nx + c] = 0;
+                        kept--;
+                        break;
+                    }
+                }
+            }
+        }
+        if (kept < mask.size() && kept >= kMinKeptSamples * mask.size()) keep = std::move(mask);
+    }
 
-// Brute-force translation search on a downsampled luma grid.
-// Returns true if a meaningful improvement over (0,0) is found.
-static bool estimate_translation_gmc(const uint8_t* curr_rgb, int w, int h,
-                                     const uint8_t* prev_rgb, int /*prev_w*/, int /*prev_h*/,
-                                     int down,
-                                     int& best_dx_px,
-                                     int& best_dy_px) noexcept {
-    best_dx_px = 0;
-    best_dy_px = 0;
-    if (!curr_rgb || !prev_rgb) return false;
-    if (w <= 0 || h <= 0) return false;
-    down = clamp_downscale(down);
+    bool kept(int r, int c) const { return keep.empty() || keep[static_cast<size_t>(r) * nx + c] != 0; }
+
+    // Samples whose shifted position stays on the grid.
+    uint64_t samples(int dx, int dy) const {
+        uint64_t n = 0;
+        for (int r = 0; r < ny; ++r) {
+            const int y = y0 + r * step;
+            if (y + dy < y0 || y + dy >= y1) continue;
+            for (int c = 0; c < nx; ++c) {
+                const int x = x0 + c * step;
+                n += (kept(r, c) && x + dx >= x0 && x + dx < x1) ? 1 : 0;
+            }
+        }
+        return n;
+    }
+
+    // Call fn(c_begin, c_end) for each run of kept samples of row r within [c_lo, c_hi).
+    template <typename Fn>
+    void keptRuns(int r, int c_lo, int c_hi, Fn fn) const {
+        if (keep.empty()) {
+            if (c_hi > c_lo) fn(c_lo, c_hi);
+            return;
+        }
+        for (int c = c_lo; c < c_hi;) {
+            if (!kept(r, c)) {
+                ++c;
+                continue;
+            }
+            int e = c + 1;
+            while (e < c_hi && kept(r, e)) ++e;
+            fn(c, e);
+            c = e;
+        }
+    }
+};
 
-    const int ds_w = std::max(1, w / down);
-    const int ds_h = std::max(1, h / down);
-    if (ds_w < 32 || ds_h < 32) return false;
+// Shifts that move samples off the grid compare fewer pixels. On the coarse
+// level, where that is a sizeable share of them, their SAD is scaled to the
+// full sample count so large shifts are not favoured for it.
+inline uint64_t normalized_sad(uint64_t sad, uint64_t samples, uint64_t full) {
+    return samples > 0 ? sad * full / samples : std::numeric_limits<uint64_t>::max() / 2;
+}
 
-    // Search range in downsampled pixels. At down=4, +/-8 => +/-32px at full-res.
-    const int max_shift_ds = 8;
-    const int step_ds = 12;   // sampling stride on downsampled grid
-    const int margin_ds = 8;  // avoid boundaries
+// Favor smaller motion (relative to `center`) slightly to reduce jitter in ambiguous cases.
+inline uint64_t motion_penalty(int dx, int dy, int cx, int cy) {
+    return static_cast<uint64_t>(((dx - cx) * (dx - cx) + (dy - cy) * (dy - cy)) * 4);
+}
 
-    auto sad_for = [&](int dx_ds, int dy_ds, uint64_t best_so_far) -> uint64_t {
-        uint64_t sad = 0;
-        const int y0 = margin_ds;
-        const int y1 = ds_h - margin_ds;
-        const int x0 = margin_ds;
-        const int x1 = ds_w - margin_ds;
-        for (int y = y0; y < y1; y += step_ds) {
-            const int y2 = y + dy_ds;
-            if (y2 < y0 || y2 >= y1) continue;
-            const int py = y * down;
-            const int cy = y2 * down;
-            for (int x = x0; x < x1; x += step_ds) {
-                const int x2 = x + dx_ds;
-                if (x2 < x0 || x2 >= x1) continue;
-                const int px = x * down;
-                const int cx = x2 * down;
-                const uint8_t* p = prev_rgb + (py * w + px) * 3;
-                const uint8_t* c = curr_rgb + (cy * w + cx) * 3;
-                const int dp = static_cast<int>(luma_u8(p));
-                const int dc = static_cast<int>(luma_u8(c));
-                sad += static_cast<uint64_t>(std::abs(dp - dc));
-                if (sad >= best_so_far) return sad;  // early stop
+// SADs of the shifts (cx + s, dy) for s in [-8, 8] into acc[s + 8]: per
+// sampled row, kernel calls over the kept samples whose every shifted pixel
+// stays in [x0, x1), and `edge` for the others (only the shifts s with
+// |s| <= edge_radius are summed there).
+void accumulate_row_shifts(const uint8_t* curr_luma, const uint8_t* prev_luma, int ds_w, const SearchGrid& g,
+                           int cx, int dy, int edge_radius, uint32_t acc[kShiftSadCount]) noexcept {
+    int k_lo = 0;
+    while (k_lo < g.nx && g.x0 + k_lo * g.step + cx - kShiftSadRadius < g.x0) ++k_lo;
+    int k_hi = g.nx;
+    while (k_hi > k_lo && g.x0 + (k_hi - 1) * g.step + cx + kShiftSadRadius >= g.x1) --k_hi;
+
+    for (int r = 0; r < g.ny; ++r) {
+        const int y = g.y0 + r * g.step;
+        const int y2 = y + dy;
+        if (y2 < g.y0 || y2 >= g.y1) continue;
+        const uint8_t* prow = prev_luma + static_cast<size_t>(y) * static_cast<size_t>(ds_w);
+        const uint8_t* crow = curr_luma + static_cast<size_t>(y2) * static_cast<size_t>(ds_w);
+        g.keptRuns(r, k_lo, k_hi, [&](int c0, int c1) {
+            AccumulateShiftSad(prow, crow + cx, g.x0 + c0 * g.step, g.step, c1 - c0, acc);
+        });
+        auto edge_column = [&](int k) {
+            if (!g.kept(r, k)) return;
+            const int x = g.x0 + k * g.step;
+            for (int s = -edge_radius; s <= edge_radius; ++s) {
+                const int x2 = x + cx + s;
+                if (x2 < g.x0 || x2 >= g.x1) continue;
+                acc[s + kShiftSadRadius] += static_cast<uint32_t>(std::abs(static_cast<int>(prow[x]) - static_cast<int>(crow[x2])));
             }
-        }
-        return sad;
-    };
+        };
+        for (int k = 0; k < k_lo; ++k) edge_column(k);
+        for (int k = k_hi; k < g.nx; ++k) edge_column(k);
+    }
+}
 
-    // Baseline (no warp).
-    const uint64_t sad0 = sad_for(0, 0, std::numeric_limits<uint64_t>::max());
-    if (sad0 == 0) return false;
+// Best shift within +/-kShiftSadRadius of the identity. `sad0` is the
+// unshifted SAD; returns the penalized SAD of the best shift.
+uint64_t search_all_shifts(const uint8_t* curr_luma, const uint8_t* prev_luma, int ds_w, const SearchGrid& g,
+                           bool normalize, int& best_dx, int& best_dy, uint64_t& sad0) noexcept {
+    const int max_shift_ds = kShiftSadRadius;
 
-    uint64_t best = sad0;
-    int best_dx_ds = 0;
-    int best_dy_ds = 0;
+    // SAD of every shift at once: per sampled row and dy, one kernel call
+    // covers all 17 dx.
+    uint32_t sad_table[kShiftSadCount][kShiftSadCount] = {};
+    for (int dy = -max_shift_ds; dy <= max_shift_ds; ++dy) {
+        accumulate_row_shifts(curr_luma, prev_luma, ds_w, g, 0, dy, max_shift_ds, sad_table[dy + max_shift_ds]);
+    }
+
+    const uint64_t full = normalize ? g.samples(0, 0) : 0;
+    sad0 = sad_table[max_shift_ds][max_shift_ds];
 
+    uint64_t best = sad0;
+    best_dx = 0;
+    best_dy = 0;
     for (int dy = -max_shift_ds; dy <= max_shift_ds; ++dy) {
         for (int dx = -max_shift_ds; dx <= max_shift_ds; ++dx) {
-            // Favor smaller motion slightly to reduce jitter in ambiguous cases.
-            const uint64_t penalty = static_cast<uint64_t>((dx * dx + dy * dy) * 4);
-            const uint64_t sad = sad_for(dx, dy, best) + penalty;
+            uint64_t sad = sad_table[dy + max_shift_ds][dx + max_shift_ds];
+            if (normalize) sad = normalized_sad(sad, g.samples(dx, dy), full);
+            sad += motion_penalty(dx, dy, 0, 0);
             if (sad < best) {
                 best = sad;
-                best_dx_ds = dx;
-                best_dy_ds = dy;
+                best_dx = dx;
+                best_dy = dy;
             }
         }
     }
+    return best;
+}
 
-    const double improvement = (static_cast<double>(sad0) - static_cast<double>(best)) / static_cast<double>(sad0);
-    if (!(improvement > 0.01)) {  // require at least 1% better than identity
-        best_dx_px = 0;
-        best_dy_px = 0;
-        return false;
+// SAD of one shift over the grid (samples shifted off it are left out).
+uint64_t shift_sad(const uint8_t* curr_luma, const uint8_t* prev_luma, int ds_w, const SearchGrid& g,
+                   int dx, int dy) noexcept {
+    uint64_t sad = 0;
+    for (int r = 0; r < g.ny; ++r) {
+        const int y = g.y0 + r * g.step;
+        const int y2 = y + dy;
+        if (y2 < g.y0 || y2 >= g.y1) continue;
+        const uint8_t* prow = prev_luma + static_cast<size_t>(y) * static_cast<size_t>(ds_w);
+        const uint8_t* crow = curr_luma + static_cast<size_t>(y2) * static_cast<size_t>(ds_w) + dx;
+        for (int c = 0; c < g.nx; ++c) {
+            const int x = g.x0 + c * g.step;
+            if (!g.kept(r, c) || x + dx < g.x0 || x + dx >= g.x1) continue;
+            sad += static_cast<uint64_t>(std::abs(static_cast<int>(prow[x]) - static_cast<int>(crow[x])));
+        }
     }
+    return sad;
+}
+
+// SAD of the shifts within +/-kRefineRadius of (cx, cy): sad[dy][dx] for
+// shift (cx + dx - kRefineRadius, cy + dy - kRefineRadius), same sums as
+// shift_sad(). Per row, one kernel call covers a 17-wide band of dx around
+// cx of which the window takes the middle.
+void refine_window(const uint8_t* curr_luma, const uint8_t* prev_luma, int ds_w, const SearchGrid& g, int cx, int cy,
+                   uint32_t sad[2 * kRefineRadius + 1][2 * kRefineRadius + 1]) noexcept {
+    static_assert(kRefineRadius <= kShiftSadRadius, "the refine window is a part of the kernel's band");
+    for (int j = 0; j <= 2 * kRefineRadius; ++j) {
+        uint32_t acc[kShiftSadCount] = {};
+        accumulate_row_shifts(curr_luma, prev_luma, ds_w, g, cx, cy + j - kRefineRadius, kRefineRadius, acc);
+        for (int i = 0; i <= 2 * kRefineRadius; ++i) sad[j][i] = acc[kShiftSadRadius + i - kRefineRadius];
+    }
+}
+
+// Returns true if a meaningful improvement over (0,0) is found.
+// `residual` (if set) is the mean absolute luma difference per sample the
+// returned shift leaves (identity included), or infinity if there was
+// nothing to search.
+static bool estimate_translation_gmc(const uint8_t* curr_luma, const uint8_t* prev_luma,
+                                     int ds_w, int ds_h,
+                                     const uint8_t* curr_coarse, const uint8_t* prev_coarse,
+                                     const GmcEstimator::ExcludeBoxes& exclude,
+                                     int& best_dx_ds,
+                                     int& best_dy_ds,
+                                     float* residual = nullptr) noexcept {
+    best_dx_ds = 0;
+    best_dy_ds = 0;
+    if (residual) *residual = std::numeric_limits<float>::infinity();
+    if (!curr_luma || !prev_luma) return false;
+    if (ds_w < kMinPlaneSide || ds_h < kMinPlaneSide) return false;
+
+    const int step_ds = 12;   // sampling stride on downsampled grid
+    const int margin_ds = 8;  // avoid boundaries
+    SearchGrid fine(ds_w, ds_h, margin_ds, step_ds);
+    fine.exclude(exclude);
+
+    uint64_t sad0 = 0;
+    uint64_t best = 0;
+    uint64_t best_raw = 0;  // `best` without the motion penalty
+    int bdx = 0;
+    int bdy = 0;
+    if (ds_w / kPyramidFactor < kMinPlaneSide || ds_h / kPyramidFactor < kMinPlaneSide) {
+        // Too small for a coarse level: search the plane itself.
+        best = search_all_shifts(curr_luma, prev_luma, ds_w, fine, false, bdx, bdy, sad0);
+        best_raw = best - motion_penalty(bdx, bdy, 0, 0);
+    } else {
+        // Coarse levels the caller kept from an earlier frame, else built here.
+        std::vector<uint8_t> curr_own, prev_own;
+        if (!curr_coarse) curr_coarse = GmcEstimator::BuildCoarseLuma(curr_luma, ds_w, ds_h, curr_own);
+        if (!prev_coarse) prev_coarse = GmcEstimator::BuildCoarseLuma(prev_luma, ds_w, ds_h, prev_own);
+        const int cw = ds_w / kPyramidFactor;
+        const int ch = ds_h / kPyramidFactor;
+        // Same sample count as the fine grid covers, on a quarter of the side.
+        SearchGrid coarse(cw, ch, kShiftSadRadius, std::max(1, step_ds / kPyramidFactor));
+        if (!exclude.empty()) {
+            GmcEstimator::ExcludeBoxes coarse_exclude = exclude;
+            for (std::array<float, 4>& b : coarse_exclude) {
+                for (float& v : b) v /= static_cast<float>(kPyramidFactor);
+            }
+            coarse.exclude(coarse_exclude);
+        }
+        int cdx = 0, cdy = 0;
+        uint64_t coarse_sad0 = 0;
+        search_all_shifts(curr_coarse, prev_coarse, cw, coarse, true, cdx, cdy, coarse_sad0);
+        if (coarse_sad0 == 0) {
+            if (residual) *residual = 0.0f;
+            return false;
+        }
 
-    best_dx_px = best_dx_ds * down;
-    best_dy_px = best_dy_ds * down;
+        const int cx = cdx * kPyramidFactor;
+        const int cy = cdy * kPyramidFactor;
+        uint32_t window[2 * kRefineRadius + 1][2 * kRefineRadius + 1];
+        refine_window(curr_luma, prev_luma, ds_w, fine, cx, cy, window);
+        const bool zero_in_window = std::abs(cx) <= kRefineRadius && std::abs(cy) <= kRefineRadius;
+        sad0 = zero_in_window ? window[kRefineRadius - cy][kRefineRadius - cx]
+                              : shift_sad(curr_luma, prev_luma, ds_w, fine, 0, 0);
+        best = sad0;
+        best_raw = sad0;
+        for (int dy = cy - kRefineRadius; dy <= cy + kRefineRadius; ++dy) {
+            for (int dx = cx - kRefineRadius; dx <= cx + kRefineRadius; ++dx) {
+                const uint64_t raw = window[dy - cy + kRefineRadius][dx - cx + kRefineRadius];
+                const uint64_t sad = raw + motion_penalty(dx, dy, cx, cy);
+                if (sad < best) {
+                    best = sad;
+                    best_raw = raw;
+                    bdx = dx;
+                    bdy = dy;
+                }
+            }
+        }
+    }
+    const double improvement = sad0 > 0 ? (static_cast<double>(sad0) - static_cast<double>(best)) / static_cast<double>(sad0) : 0.0;
+    const bool moved = improvement > 0.01;  // require at least 1% better than identity
+    if (residual) {
+        const uint64_t samples = moved ? fine.samples(bdx, bdy) : fine.samples(0, 0);
+        if (samples > 0) *residual = static_cast<float>(static_cast<double>(moved ? best_raw : sad0) / samples);
+    }
+    if (!moved) return false;
+
+    best_dx_ds = bdx;
+    best_dy_ds = bdy;
     return true;
 }
 }  // namespace
 
-bool GmcEstimator::Estimate(const uint8_t* curr_rgb, int curr_w, int curr_h,
-                            const uint8_t* prev_rgb, int prev_w, int prev_h,
-                            Mat3f& out_warp) noexcept {
+bool GmcEstimator::EstimateLuma(const uint8_t* curr_luma, const uint8_t* prev_luma,
+                                int plane_w, int plane_h, int downscale,
+                                Mat3f& out_warp,
+                                const uint8_t* curr_coarse,
+                                const uint8_t* prev_coarse,
+                                const ExcludeBoxes* exclude) noexcept {
+    FACE_PIPELINE_ZONE("GmcEstimator::EstimateLuma");
     out_warp = Mat3f::Identity();
+    const int down = clamp_downscale(downscale);
+    if (impl_ && impl_->phase) {
+        float dx = 0.0f, dy = 0.0f;
+        if (!impl_->phase->estimate(curr_luma, prev_luma, plane_w, plane_h,
+                                    PlaneExclusion(exclude, down, cfg_.exclude_margin), dx, dy)) {
+            return false;
+        }
+        out_warp.m[2] = dx * static_cast<float>(down);
+        out_warp.m[5] = dy * static_cast<float>(down);
+        return true;
+    }
+    // Sparse features: the plane-pixel warp scaled to full resolution.
+    auto features = [&]() {
+        Mat3f warp = Mat3f::Identity();
+        if (!impl_->features->estimate(curr_luma, prev_luma, plane_w, plane_h,
+                                      PlaneExclusion(exclude, down, cfg_.exclude_margin), warp)) {
+            return false;
+        }
+        warp.m[2] *= static_cast<float>(down);
+        warp.m[5] *= static_cast<float>(down);
+        warp.m[6] /= static_cast<float>(down);
+        warp.m[7] /= static_cast<float>(down);
+        out_warp = warp;
+        return true;
+    };
+    const bool adaptive = cfg_.fallback == GmcConfig::Fallback::Adaptive;
+    if (impl_ && impl_->features && !adaptive) return features();
     // Dependency-free fallback: estimate a simple translation model.
-    int dx_px = 0;
-    int dy_px = 0;
-    const bool ok = estimate_translation_gmc(
-        curr_rgb, curr_w, curr_h,
-        prev_rgb, prev_w, prev_h,
-        cfg_.downscale,
-        dx_px, dy_px
-    );
+    int dx_ds = 0;
+    int dy_ds = 0;
+    float residual = 0.0f;
+    const bool ok = estimate_translation_gmc(curr_luma, prev_luma, plane_w, plane_h, curr_coarse, prev_coarse,
+                                             PlaneExclusion(exclude, down, cfg_.exclude_margin), dx_ds, dy_ds,
+                                             adaptive ? &residual : nullptr);
+    // Adaptive: a translation that leaves the planes this far apart missed
+    // rotation, zoom or perspective; features take over, and the translation
+    // stays the answer if they fail too.
+    if (adaptive && residual > cfg_.adaptive_residual && features()) return true;
     if (!ok) return false;
 
     out_warp = Mat3f::Identity();
-    out_warp.m[2] = static_cast<float>(dx_px);
-    out_warp.m[5] = static_cast<float>(dy_px);
+    out_warp.m[2] = static_cast<float>(dx_ds * down);
+    out_warp.m[5] = static_cast<float>(dy_ds * down);
     return true;
 }
 
 #endif
 
+bool StaticCameraGate::shouldEstimate() {
+    if (!cfg_.enabled || !static_) return true;
+    if (++since_check_ >= std::max(1, cfg_.recheck_every)) {
+        since_check_ = 0;
+        return true;
+    }
+    skipped_++;
+    return false;
+}
+
+void StaticCameraGate::observe(bool ok, const Mat3f& warp) {
+    if (!cfg_.enabled) return;
+    constexpr float kLinearTolerance = 1e-3f;  // rotation / scale still read as no motion
+    const float* m = warp.m.data();
+    const bool moved = ok && (std::fabs(m[2]) > cfg_.max_shift || std::fabs(m[5]) > cfg_.max_shift ||
+                              std::fabs(m[0] - 1.0f) > kLinearTolerance || std::fabs(m[1]) > kLinearTolerance ||
+                              std::fabs(m[3]) > kLinearTolerance || std::fabs(m[4] - 1.0f) > kLinearTolerance);
+    if (moved) {
+        still_ = 0;
+        static_ = false;
+        return;
+    }
+    still_++;
+    if (!static_ && still_ >= cfg_.probe_frames) {
+        static_ = true;
+        since_check_ = 0;
+        segments_++;
+    }
+}
+
+namespace {
+using Mat3d = std::array<double, 9>;
+
+Mat3d Multiply(const Mat3d& a, const Mat3d& b) {
+    Mat3d out{};
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            out[r * 3 + c] = a[r * 3] * b[c] + a[r * 3 + 1] * b[3 + c] + a[r * 3 + 2] * b[6 + c];
+        }
+    }
+    return out;
+}
+
+Mat3f ComposeWarps(const Mat3f& a, const Mat3f& b) {  // a after b
+    Mat3d da{}, db{};
+    for (size_t k = 0; k < 9; ++k) {
+        da[k] = a.m[k];
+        db[k] = b.m[k];
+    }
+    const Mat3d p = Multiply(da, db);
+    Mat3f out;
+    for (size_t k = 0; k < 9; ++k) out.m[k] = static_cast<float>(p[k] / p[8]);
+    return out;
+}
+
+// The n-th root of a frame_w x frame_h frame's warp: exp(log(W) / n), with
+// both series taken in coordinates scaled by the long side, where an
+// interval's camera motion is close to the identity. False (and `out`
+// untouched) for motion too large for the series, e.g. a whip pan.
+bool WarpRoot(const Mat3f& warp, int n, int frame_w, int frame_h, Mat3f& out) {
+    constexpr int kTerms = 16;
+    constexpr double kMaxTerm = 0.5;  // the log series converges below 1
+    const double side = std::max(1, std::max(frame_w, frame_h));
+    Mat3d x{};  // S W S^-1 - I, S = diag(1 / side, 1 / side, 1)
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            double v = warp.m[static_cast<size_t>(r * 3 + c)] / warp.m[8];
+            if (r < 2 && c == 2) v /= side;
+            if (r == 2 && c < 2) v *= side;
+            x[r * 3 + c] = v - (r == c ? 1.0 : 0.0);
+            if (!(std::fabs(x[r * 3 + c]) < kMaxTerm)) return false;
+        }
+    }
+    Mat3d log{}, power = x;
+    for (int k = 1; k <= kTerms; ++k) {
+        const double f = ((k % 2) ? 1.0 : -1.0) / k;
+        for (size_t j = 0; j < 9; ++j) log[j] += f * power[j];
+        power = Multiply(power, x);
+    }
+    Mat3d a{};
+    for (size_t j = 0; j < 9; ++j) a[j] = log[j] / n;
+    Mat3d root = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    Mat3d term = root;
+    for (int k = 1; k <= kTerms; ++k) {
+        term = Multiply(term, a);
+        for (size_t j = 0; j < 9; ++j) term[j] /= k;
+        for (size_t j = 0; j < 9; ++j) root[j] += term[j];
+    }
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            double v = root[r * 3 + c] / root[8];
+            if (r < 2 && c == 2) v *= side;
+            if (r == 2 && c < 2) v /= side;
+            out.m[static_cast<size_t>(r * 3 + c)] = static_cast<float>(v);
+        }
+    }
+    return true;
+}
+
+// Largest distance between where `a` and `b` put a frame corner.
+float CornerDistance(const Mat3f& a, const Mat3f& b, int frame_w, int frame_h) {
+    const float xs[2] = {0.0f, static_cast<float>(frame_w)};
+    const float ys[2] = {0.0f, static_cast<float>(frame_h)};
+    auto apply = [](const Mat3f& w, float x, float y, float& ox, float& oy) {
+        const float d = w.m[6] * x + w.m[7] * y + w.m[8];
+        ox = (w.m[0] * x + w.m[1] * y + w.m[2]) / d;
+        oy = (w.m[3] * x + w.m[4] * y + w.m[5]) / d;
+    };
+    float worst = 0.0f;
+    for (float x : xs) {
+        for (float y : ys) {
+            float ax = 0.0f, ay = 0.0f, bx = 0.0f, by = 0.0f;
+            apply(a, x, y, ax, ay);
+            apply(b, x, y, bx, by);
+            worst = std::max(worst, std::hypot(ax - bx, ay - by));
+        }
+    }
+    return worst;
+}
+}  // namespace
+
+bool SparseGmc::carry(Mat3f& warp) {
+    if (!enabled() || !has_key_ || dense_left_ > 0 || steps_ + 1 >= cfg_.interval) return false;
+    warp = step_;
+    applied_ = ComposeWarps(step_, applied_);
+    steps_++;
+    carried_++;
+    return true;
+}
+
+bool SparseGmc::keyDue(int plane_w, int plane_h) const {
+    return enabled() && has_key_ && dense_left_ == 0 && steps_ + 1 >= cfg_.interval && plane_w == plane_w_ &&
+           plane_h == plane_h_;
+}
+
+void SparseGmc::observe(bool from_key, bool ok, Mat3f& warp, const uint8_t* luma, int plane_w, int plane_h,
+                        const std::vector<uint8_t>& coarse, int frame_w, int frame_h) {
+    if (!enabled()) return;
+    if (dense_left_ > 0) dense_left_--;
+    if (!ok) {
+        reset();
+        return;
+    }
+    if (from_key) {
+        key_estimates_++;
+        const int steps = steps_ + 1;
+        // What carrying on would have given, against what was measured. A
+        // step from one pair estimate is too coarse to be held to it.
+        const Mat3f measured = warp;
+        const bool missed = step_from_key_ &&
+                            CornerDistance(measured, ComposeWarps(step_, applied_), frame_w, frame_h) > cfg_.max_residual;
+        Mat3f undo;
+        if (applied_.inverse(undo)) warp = ComposeWarps(measured, undo);
+        if (!WarpRoot(measured, steps, frame_w, frame_h, step_) || missed) {
+            fallbacks_++;
+            dense_left_ = cfg_.interval;
+        }
+    } else {
+        step_ = warp;
+    }
+    step_from_key_ = from_key;
+    applied_ = Mat3f::Identity();
+    steps_ = 0;
+    has_key_ = true;
+    plane_w_ = plane_w;
+    plane_h_ = plane_h;
+    key_luma_.assign(luma, luma + static_cast<size_t>(plane_w) * static_cast<size_t>(plane_h));
+    key_coarse_ = coarse;
+}
+
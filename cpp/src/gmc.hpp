@@ -1,15 +1,28 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "transform.hpp"
 
 struct GmcConfig {
     enum class Model { Similarity, Homography };
+    // Estimator without OpenCV: a translation search, sparse features
+    // fitted to `model` (rotation and zoom too, at a few times the cost),
+    // FFT phase correlation (subpixel translation, any range, fixed cost),
+    // or the cheapest of translation -> similarity -> homography that fits
+    // each frame pair (Adaptive: escalates on the residual and inlier share
+    // below; `model` is ignored).
+    enum class Fallback { Translation, Features, PhaseCorrelation, Adaptive };
 
     int downscale = 4;
     Model model = Model::Similarity;
+    Fallback fallback = Fallback::Translation;
+    float exclude_margin = 0.25f;  // exclusion boxes grow by this fraction of their size per side
+    float adaptive_residual = 6.0f;  // Adaptive: mean |luma difference| a translation may leave before features are fitted
+    float adaptive_inliers = 0.6f;   // Adaptive: share of tracked corners a similarity must explain, else a homography is fitted too
 };
 
 class GmcEstimator {
@@ -20,11 +33,52 @@ public:
     GmcEstimator(const GmcEstimator&) = delete;
     GmcEstimator& operator=(const GmcEstimator&) = delete;
 
+    // Regions (x1, y1, x2, y2 in full-resolution pixels of the previous
+    // frame) left out of the estimate, e.g. tracked faces that move on their
+    // own. Ignored by the fallback if they would leave too little background.
+    using ExcludeBoxes = std::vector<std::array<float, 4>>;
+
     // Estimates warp that maps points from prev -> curr (pixel coordinates).
-    // If estimation fails (or OpenCV videostab is unavailable), returns false and sets identity.
+    // Consecutive frame pairs should go through one estimator in order: it
+    // keeps state of the last current frame for the next call (not thread-safe).
+    // If estimation fails, returns false and sets identity. Without OpenCV
+    // the estimate comes from the built-in GmcConfig::Fallback.
     bool Estimate(const uint8_t* curr_rgb, int curr_w, int curr_h,
                   const uint8_t* prev_rgb, int prev_w, int prev_h,
-                  Mat3f& out_warp) noexcept;
+                  Mat3f& out_warp,
+                  const ExcludeBoxes* exclude = nullptr) noexcept;
+
+    // Same as Estimate(), but on luma planes already reduced by `downscale`
+    // (e.g. produced by the decode stage). Planes must share the same size.
+    // The returned warp is in full-resolution pixel coordinates.
+    // `curr_coarse`/`prev_coarse` are the planes' BuildCoarseLuma() levels
+    // when the caller keeps them (built here otherwise).
+    bool EstimateLuma(const uint8_t* curr_luma, const uint8_t* prev_luma,
+                      int plane_w, int plane_h, int downscale,
+                      Mat3f& out_warp,
+                      const uint8_t* curr_coarse = nullptr,
+                      const uint8_t* prev_coarse = nullptr,
+                      const ExcludeBoxes* exclude = nullptr) noexcept;
+
+    // Codec motion vectors of a frame: (x, y) in the previous frame ->
+    // (x, y) in this one, full-resolution pixels, one per block.
+    using MotionVectors = std::vector<std::array<float, 4>>;
+
+    // Warp from a decoder's motion vectors instead of pixels: a robust fit
+    // of GmcConfig::model to the blocks' motion in a frame_w x frame_h frame.
+    // Vectors starting in `exclude` are not used. Returns false (identity)
+    // if too few vectors agree, e.g. on intra-coded frames.
+    bool EstimateVectors(const MotionVectors& vectors, int frame_w, int frame_h,
+                         Mat3f& out_warp,
+                         const ExcludeBoxes* exclude = nullptr) const noexcept;
+
+    // Coarse pyramid level of a plane_w x plane_h luma plane for
+    // EstimateLuma(), so it can be built once per frame (on a decode thread)
+    // and reused while the frame is the previous one. Returns out.data(),
+    // or nullptr if this estimator has no use for one.
+    static const uint8_t* BuildCoarseLuma(const uint8_t* luma, int plane_w, int plane_h, std::vector<uint8_t>& out);
+
+    int downscale() const { return cfg_.downscale < 1 ? 1 : cfg_.downscale; }
 
 private:
     struct Impl;
@@ -32,3 +86,176 @@ private:
     GmcConfig cfg_;
 };
 
+/**
+ * Static camera settings (see StaticCameraGate).
+ */
+struct StaticCameraConfig {
+    bool enabled = true;
+    int probe_frames = 8;      // consecutive pairs without camera motion that make a segment static
+    int recheck_every = 30;    // while static: frames per pair still estimated, to notice the camera moving
+    float max_shift = 0.5f;    // warp translation (full-resolution pixels) still read as no motion
+};
+
+/**
+ * Per-segment camera motion classification that skips GMC on locked-off
+ * shots, where every estimate would come back as the identity anyway.
+ *
+ * A segment (a shot, see reset()) is static once `probe_frames` estimates
+ * in a row find no camera motion. GMC then runs on one frame in
+ * `recheck_every` only; the first such re-check that finds motion ends the
+ * static segment.
+ */
+class StaticCameraGate {
+public:
+    explicit StaticCameraGate(StaticCameraConfig cfg = {}) : cfg_(cfg) {}
+
+    /** Whether to estimate the next frame's warp; counts the frames it skips. */
+    bool shouldEstimate();
+
+    /** Outcome of an estimate this gate let through. */
+    void observe(bool ok, const Mat3f& warp);
+
+    /** A new shot: probe the camera again. */
+    void reset() {
+        still_ = 0;
+        static_ = false;
+    }
+
+    bool isStatic() const { return static_; }
+    int segments() const { return segments_; }
+    int skipped() const { return skipped_; }
+
+    /** Everything the gate carries from frame to frame (for checkpoints). */
+    struct State {
+        int still = 0;        // estimates in a row without motion
+        bool is_static = false;
+        int since_check = 0;  // frames since the last estimate while static
+        int segments = 0;
+        int skipped = 0;
+    };
+    State state() const { return State{still_, static_, since_check_, segments_, skipped_}; }
+    void restore(const State& s) {
+        still_ = s.still;
+        static_ = s.is_static;
+        since_check_ = s.since_check;
+        segments_ = s.segments;
+        skipped_ = s.skipped;
+    }
+
+private:
+    StaticCameraConfig cfg_;
+    int still_ = 0;
+    bool static_ = false;
+    int since_check_ = 0;
+    int segments_ = 0;
+    int skipped_ = 0;
+};
+
+/**
+ * Sparse GMC settings (see SparseGmc).
+ */
+struct SparseGmcConfig {
+    int interval = 0;           // frames per estimate while motion is smooth (0 or 1 = every frame pair)
+    float max_residual = 8.0f;  // full-resolution pixels at the frame corners the carried warps may miss by
+};
+
+/**
+ * Camera motion estimated once per `interval` frames on smooth motion
+ * (--gmc-interval).
+ *
+ * The tracker is online, so a frame cannot wait for the next keyframe:
+ * each keyframe's warp from the previous keyframe is split into equal
+ * per-frame steps (its interval-th root), and the frames up to the next
+ * keyframe carry that step without an estimate. At the next keyframe
+ * the estimate against the last keyframe corrects what the carried steps
+ * missed. A miss above `max_residual` (motion changed) has the next
+ * `interval` frames estimate consecutive pairs again. Over an interval the
+ * estimate also resolves motion finer than one pair's search grid.
+ */
+class SparseGmc {
+public:
+    explicit SparseGmc(SparseGmcConfig cfg = {}) : cfg_(cfg) {}
+
+    bool enabled() const { return cfg_.interval > 1; }
+
+    /** Between keyframes: the carried step for the next frame, false if the frame needs an estimate. */
+    bool carry(Mat3f& warp);
+
+    /**
+     * Whether the next frame is estimated against the keyframe's plane
+     * (keyLuma(), keyCoarse()) instead of the previous frame's.
+     */
+    bool keyDue(int plane_w, int plane_h) const;
+    const uint8_t* keyLuma() const { return key_luma_.data(); }
+    const uint8_t* keyCoarse() const { return key_coarse_.empty() ? nullptr : key_coarse_.data(); }
+
+    /**
+     * Outcome of the frame's estimate: `warp` maps the keyframe (`from_key`)
+     * or the previous frame to it, and on return maps the previous frame.
+     * The frame's plane and coarse level (may be empty) become the keyframe.
+     */
+    void observe(bool from_key, bool ok, Mat3f& warp, const uint8_t* luma, int plane_w, int plane_h,
+                 const std::vector<uint8_t>& coarse, int frame_w, int frame_h);
+
+    /** A new shot, or the camera stopped: estimate pairs again. */
+    void reset() {
+        has_key_ = false;
+        key_luma_.clear();
+        key_coarse_.clear();
+    }
+
+    int carried() const { return carried_; }
+    int keyEstimates() const { return key_estimates_; }
+    int fallbacks() const { return fallbacks_; }
+
+    /** Everything but the keyframe planes (for checkpoints). */
+    struct State {
+        bool has_key = false;
+        int plane_w = 0;
+        int plane_h = 0;
+        int steps = 0;       // frames since the keyframe
+        int dense_left = 0;  // frames still estimated as pairs after a miss
+        Mat3f step;          // carried per-frame warp
+        Mat3f applied;       // carried steps since the keyframe, composed
+        bool step_from_key = false;
+        int carried = 0;
+        int key_estimates = 0;
+        int fallbacks = 0;
+    };
+    State state() const {
+        return State{has_key_, plane_w_, plane_h_, steps_, dense_left_, step_, applied_, step_from_key_, carried_,
+                     key_estimates_, fallbacks_};
+    }
+    std::vector<uint8_t>& keyLumaPlane() { return key_luma_; }
+    std::vector<uint8_t>& keyCoarsePlane() { return key_coarse_; }
+    void restore(const State& s) {
+        has_key_ = s.has_key;
+        plane_w_ = s.plane_w;
+        plane_h_ = s.plane_h;
+        steps_ = s.steps;
+        dense_left_ = s.dense_left;
+        step_ = s.step;
+        applied_ = s.applied;
+        step_from_key_ = s.step_from_key;
+        carried_ = s.carried;
+        key_estimates_ = s.key_estimates;
+        fallbacks_ = s.fallbacks;
+    }
+
+private:
+    SparseGmcConfig cfg_;
+    bool has_key_ = false;
+    int plane_w_ = 0;
+    int plane_h_ = 0;
+    int steps_ = 0;
+    int dense_left_ = 0;
+    Mat3f step_ = Mat3f::Identity();
+    Mat3f applied_ = Mat3f::Identity();
+    bool step_from_key_ = false;
+    std::vector<uint8_t> key_luma_;
+    std::vector<uint8_t> key_coarse_;
+    int carried_ = 0;
+    int key_estimates_ = 0;
+    int fallbacks_ = 0;
+};
+
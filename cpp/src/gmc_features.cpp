@@ -0,0 +1,456 @@
+#include "gmc_features.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+using Level = FeatureMotionEstimator::Level;
+using Corner = FeatureMotionEstimator::Corner;
+
+constexpr int kLevels = 3;             // flow pyramid levels (2x apart)
+constexpr int kMinLevelSide = 24;      // coarser levels would hold little more than the window
+constexpr int kWindow = 4;             // LK window half side (9x9)
+constexpr int kWindowPixels = (2 * kWindow + 1) * (2 * kWindow + 1);
+constexpr int kMaxIterations = 10;     // LK Gauss-Newton steps per level
+constexpr float kStepEpsilon = 0.01f;  // ... or until a step is this short (pixels)
+constexpr double kMinEigen = 1.0;      // per-pixel smallest gradient eigenvalue of a trackable window
+constexpr float kMaxFbError = 1.0f;    // forward-backward flow mismatch of a kept point (pixels)
+
+constexpr int kFastThreshold = 20;  // FAST-9 arc contrast, in levels
+constexpr int kCellSide = 16;       // one corner per cell
+constexpr int kMaxCorners = 400;
+
+constexpr int kMaxRansacIterations = 256;
+constexpr double kRansacConfidence = 0.99;
+constexpr float kInlierPixels = 1.5f;  // transfer error of an inlier (plane pixels)
+constexpr int kMinInliers = 12;
+constexpr float kMinInlierRatio = 0.3f;  // of the tracked points
+}  // namespace
+
+void BuildFlowPyramid(const uint8_t* plane, int w, int h, std::vector<Level>& pyramid) {
+    pyramid.resize(1);
+    Level& base = pyramid[0];
+    base.w = w;
+    base.h = h;
+    base.px.assign(plane, plane + static_cast<size_t>(w) * static_cast<size_t>(h));
+    while (static_cast<int>(pyramid.size()) < kLevels && pyramid.back().w / 2 >= kMinLevelSide &&
+           pyramid.back().h / 2 >= kMinLevelSide) {
+        const Level& fine = pyramid.back();
+        Level coarse;
+        coarse.w = fine.w / 2;
+        coarse.h = fine.h / 2;
+        coarse.px.resize(static_cast<size_t>(coarse.w) * static_cast<size_t>(coarse.h));
+        for (int y = 0; y < coarse.h; ++y) {
+            const float* r0 = fine.px.data() + static_cast<size_t>(2 * y) * static_cast<size_t>(fine.w);
+            const float* r1 = r0 + fine.w;
+            float* dst = coarse.px.data() + static_cast<size_t>(y) * static_cast<size_t>(coarse.w);
+            for (int x = 0; x < coarse.w; ++x) {
+                dst[x] = 0.25f * (r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1]);
+            }
+        }
+        pyramid.push_back(std::move(coarse));
+    }
+}
+
+namespace {
+// Bilinear sample, clamped to the level.
+inline float Sample(const Level& l, float x, float y) {
+    x = std::min(std::max(x, 0.0f), static_cast<float>(l.w) - 1.001f);
+    y = std::min(std::max(y, 0.0f), static_cast<float>(l.h) - 1.001f);
+    const int x0 = static_cast<int>(x);
+    const int y0 = static_cast<int>(y);
+    const float fx = x - static_cast<float>(x0);
+    const float fy = y - static_cast<float>(y0);
+    const float* r0 = l.px.data() + static_cast<size_t>(y0) * static_cast<size_t>(l.w) + x0;
+    const float* r1 = r0 + l.w;
+    return (1.0f - fy) * ((1.0f - fx) * r0[0] + fx * r0[1]) + fy * ((1.0f - fx) * r1[0] + fx * r1[1]);
+}
+}  // namespace
+
+// Pyramidal Lucas-Kanade (Bouguet).
+bool TrackFlowPoint(const std::vector<Level>& a, const std::vector<Level>& b, Corner p, Corner& q) {
+    const int levels = static_cast<int>(std::min(a.size(), b.size()));
+    float gx = 0.0f, gy = 0.0f;  // flow guess carried down the pyramid
+    float tmpl[kWindowPixels], ix[kWindowPixels], iy[kWindowPixels];
+    for (int lv = levels - 1; lv >= 0; --lv) {
+        const Level& la = a[static_cast<size_t>(lv)];
+        const Level& lb = b[static_cast<size_t>(lv)];
+        // A coarse pixel averages 2x2 finer ones: its centre sits half a
+        // finer pixel right of and below twice its index.
+        const float s = 1.0f / static_cast<float>(1 << lv);
+        const float px = (p.x + 0.5f) * s - 0.5f;
+        const float py = (p.y + 0.5f) * s - 0.5f;
+
+        double gxx = 0.0, gxy = 0.0, gyy = 0.0;
+        int k = 0;
+        for (int dy = -kWindow; dy <= kWindow; ++dy) {
+            for (int dx = -kWindow; dx <= kWindow; ++dx, ++k) {
+                const float x = px + static_cast<float>(dx);
+                const float y = py + static_cast<float>(dy);
+                tmpl[k] = Sample(la, x, y);
+                ix[k] = 0.5f * (Sample(la, x + 1.0f, y) - Sample(la, x - 1.0f, y));
+                iy[k] = 0.5f * (Sample(la, x, y + 1.0f) - Sample(la, x, y - 1.0f));
+                gxx += static_cast<double>(ix[k]) * ix[k];
+                gxy += static_cast<double>(ix[k]) * iy[k];
+                gyy += static_cast<double>(iy[k]) * iy[k];
+            }
+        }
+        const double det = gxx * gyy - gxy * gxy;
+        const double min_eigen = 0.5 * (gxx + gyy - std::sqrt((gxx - gyy) * (gxx - gyy) + 4.0 * gxy * gxy));
+        if (!(det > 0.0) || min_eigen < kMinEigen * kWindowPixels) return false;
+
+        float vx = 0.0f, vy = 0.0f;
+        for (int it = 0; it < kMaxIterations; ++it) {
+            double bx = 0.0, by = 0.0;
+            k = 0;
+            for (int dy = -kWindow; dy <= kWindow; ++dy) {
+                for (int dx = -kWindow; dx <= kWindow; ++dx, ++k) {
+                    const float e = tmpl[k] - Sample(lb, px + gx + vx + static_cast<float>(dx),
+                                                     py + gy + vy + static_cast<float>(dy));
+                    bx += static_cast<double>(e) * ix[k];
+                    by += static_cast<double>(e) * iy[k];
+                }
+            }
+            const float sx = static_cast<float>((gyy * bx - gxy * by) / det);
+            const float sy = static_cast<float>((gxx * by - gxy * bx) / det);
+            vx += sx;
+            vy += sy;
+            if (sx * sx + sy * sy < kStepEpsilon * kStepEpsilon) break;
+        }
+        if (lv > 0) {
+            gx = 2.0f * (gx + vx);
+            gy = 2.0f * (gy + vy);
+        } else {
+            gx += vx;
+            gy += vy;
+        }
+    }
+    q = Corner{p.x + gx, p.y + gy};
+    const Level& base = b[0];
+    return std::isfinite(q.x) && std::isfinite(q.y) && q.x >= 0.0f && q.y >= 0.0f &&
+           q.x <= static_cast<float>(base.w - 1) && q.y <= static_cast<float>(base.h - 1);
+}
+
+namespace {
+
+// FAST-9 corners, the strongest per kCellSide cell.
+void DetectCorners(const uint8_t* plane, int w, int h, std::vector<Corner>& corners) {
+    static const int kCircle[16][2] = {{0, -3}, {1, -3}, {2, -2}, {3, -1}, {3, 0}, {3, 1}, {2, 2}, {1, 3},
+                                       {0, 3}, {-1, 3}, {-2, 2}, {-3, 1}, {-3, 0}, {-3, -1}, {-2, -2}, {-1, -3}};
+    int offsets[16];
+    for (int k = 0; k < 16; ++k) offsets[k] = kCircle[k][1] * w + kCircle[k][0];
+
+    struct Best {
+        int score = 0;
+        int x = 0;
+        int y = 0;
+    };
+    const int border = kWindow + 3;
+    const int cells_x = (w + kCellSide - 1) / kCellSide;
+    const int cells_y = (h + kCellSide - 1) / kCellSide;
+    std::vector<Best> best(static_cast<size_t>(cells_x) * static_cast<size_t>(cells_y));
+    for (int y = border; y < h - border; ++y) {
+        const uint8_t* row = plane + static_cast<size_t>(y) * static_cast<size_t>(w);
+        for (int x = border; x < w - border; ++x) {
+            const uint8_t* c = row + x;
+            const int hi = c[0] + kFastThreshold;
+            const int lo = c[0] - kFastThreshold;
+            // An arc of 9 covers at least two of the four compass points.
+            int bright = 0, dark = 0;
+            for (int k = 0; k < 16; k += 4) {
+                const int v = c[offsets[k]];
+                bright += v > hi;
+                dark += v < lo;
+            }
+            if (bright < 2 && dark < 2) continue;
+            uint32_t bright_mask = 0, dark_mask = 0;
+            int bright_score = 0, dark_score = 0;
+            for (int k = 0; k < 16; ++k) {
+                const int v = c[offsets[k]];
+                if (v > hi) {
+                    bright_mask |= 1u << k;
+                    bright_score += v - hi;
+                } else if (v < lo) {
+                    dark_mask |= 1u << k;
+                    dark_score += lo - v;
+                }
+            }
+            auto has_arc = [](uint32_t mask) {
+                uint32_t m = mask | (mask << 16);
+                uint32_t run = m;
+                for (int k = 1; k < 9; ++k) run &= m >> k;
+                return run != 0;
+            };
+            int score = 0;
+            if (has_arc(bright_mask)) score = bright_score;
+            if (has_arc(dark_mask)) score = std::max(score, dark_score);
+            if (score == 0) continue;
+            Best& cell = best[static_cast<size_t>(y / kCellSide) * static_cast<size_t>(cells_x) +
+                              static_cast<size_t>(x / kCellSide)];
+            if (score > cell.score) cell = Best{score, x, y};
+        }
+    }
+    std::vector<Best> found;
+    for (const Best& b : best) {
+        if (b.score > 0) found.push_back(b);
+    }
+    // Stable: equal scores keep the cells' raster order.
+    std::stable_sort(found.begin(), found.end(), [](const Best& a, const Best& b) { return a.score > b.score; });
+    if (found.size() > static_cast<size_t>(kMaxCorners)) found.resize(static_cast<size_t>(kMaxCorners));
+    corners.clear();
+    corners.reserve(found.size());
+    for (const Best& b : found) corners.push_back(Corner{static_cast<float>(b.x), static_cast<float>(b.y)});
+}
+
+// Row-major 3x3 in double.
+struct Mat3d {
+    double m[9];
+};
+
+Mat3d Multiply(const Mat3d& a, const Mat3d& b) {
+    Mat3d out{};
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            double v = 0.0;
+            for (int k = 0; k < 3; ++k) v += a.m[r * 3 + k] * b.m[k * 3 + c];
+            out.m[r * 3 + c] = v;
+        }
+    }
+    return out;
+}
+
+inline double TransferError2(const Mat3d& h, const Corner& p, const Corner& q) {
+    const double w = h.m[6] * p.x + h.m[7] * p.y + h.m[8];
+    if (!(std::fabs(w) > 1e-12)) return std::numeric_limits<double>::max();
+    const double u = (h.m[0] * p.x + h.m[1] * p.y + h.m[2]) / w - q.x;
+    const double v = (h.m[3] * p.x + h.m[4] * p.y + h.m[5]) / w - q.y;
+    return u * u + v * v;
+}
+
+// n x n linear system by Gaussian elimination with partial pivoting (a is
+// row-major n x (n + 1), the last column the right-hand side).
+bool Solve(double* a, int n, double* x) {
+    for (int c = 0; c < n; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < n; ++r) {
+            if (std::fabs(a[r * (n + 1) + c]) > std::fabs(a[pivot * (n + 1) + c])) pivot = r;
+        }
+        if (!(std::fabs(a[pivot * (n + 1) + c]) > 1e-12)) return false;
+        if (pivot != c) {
+            for (int k = 0; k <= n; ++k) std::swap(a[c * (n + 1) + k], a[pivot * (n + 1) + k]);
+        }
+        for (int r = c + 1; r < n; ++r) {
+            const double f = a[r * (n + 1) + c] / a[c * (n + 1) + c];
+            for (int k = c; k <= n; ++k) a[r * (n + 1) + k] -= f * a[c * (n + 1) + k];
+        }
+    }
+    for (int r = n - 1; r >= 0; --r) {
+        double v = a[r * (n + 1) + n];
+        for (int k = r + 1; k < n; ++k) v -= a[r * (n + 1) + k] * x[k];
+        x[r] = v / a[r * (n + 1) + r];
+    }
+    return true;
+}
+
+// Least-squares similarity q = s R p + t over points `idx`.
+bool FitSimilarity(const std::vector<Corner>& p, const std::vector<Corner>& q, const int* idx, int n, Mat3d& h) {
+    double pmx = 0.0, pmy = 0.0, qmx = 0.0, qmy = 0.0;
+    for (int k = 0; k < n; ++k) {
+        pmx += p[idx[k]].x;
+        pmy += p[idx[k]].y;
+        qmx += q[idx[k]].x;
+        qmy += q[idx[k]].y;
+    }
+    pmx /= n;
+    pmy /= n;
+    qmx /= n;
+    qmy /= n;
+    double sp = 0.0, sa = 0.0, sb = 0.0;
+    for (int k = 0; k < n; ++k) {
+        const double px = p[idx[k]].x - pmx, py = p[idx[k]].y - pmy;
+        const double qx = q[idx[k]].x - qmx, qy = q[idx[k]].y - qmy;
+        sp += px * px + py * py;
+        sa += px * qx + py * qy;
+        sb += px * qy - py * qx;
+    }
+    if (!(sp > 1e-9)) return false;
+    const double a = sa / sp;
+    const double b = sb / sp;
+    const double scale = std::sqrt(a * a + b * b);
+    if (!(scale > 0.5 && scale < 2.0)) return false;
+    h = Mat3d{{a, -b, qmx - (a * pmx - b * pmy), b, a, qmy - (b * pmx + a * pmy), 0.0, 0.0, 1.0}};
+    return true;
+}
+
+// Least-squares (algebraic) homography with h33 = 1 over points `idx`.
+bool FitHomography(const std::vector<Corner>& p, const std::vector<Corner>& q, const int* idx, int n, Mat3d& h) {
+    double ata[8 * 9] = {};
+    auto add_row = [&ata](const double row[8], double rhs) {
+        for (int r = 0; r < 8; ++r) {
+            for (int c = 0; c < 8; ++c) ata[r * 9 + c] += row[r] * row[c];
+            ata[r * 9 + 8] += row[r] * rhs;
+        }
+    };
+    for (int k = 0; k < n; ++k) {
+        const double x = p[idx[k]].x, y = p[idx[k]].y;
+        const double u = q[idx[k]].x, v = q[idx[k]].y;
+        const double ru[8] = {x, y, 1.0, 0.0, 0.0, 0.0, -u * x, -u * y};
+        const double rv[8] = {0.0, 0.0, 0.0, x, y, 1.0, -v * x, -v * y};
+        add_row(ru, u);
+        add_row(rv, v);
+    }
+    double x[8];
+    if (!Solve(ata, 8, x)) return false;
+    h = Mat3d{{x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7], 1.0}};
+    // Orientation-preserving and not far from a similarity in scale.
+    const double det = h.m[0] * h.m[4] - h.m[1] * h.m[3];
+    return det > 0.25 && det < 4.0;
+}
+
+void ExcludeCorners(std::vector<Corner>& corners, const FeatureMotionEstimator::Boxes& boxes) {
+    if (boxes.empty()) return;
+    corners.erase(std::remove_if(corners.begin(), corners.end(),
+                                 [&boxes](const Corner& c) {
+                                     for (const std::array<float, 4>& b : boxes) {
+                                         if (c.x >= b[0] && c.x < b[2] && c.y >= b[1] && c.y < b[3]) return true;
+                                     }
+                                     return false;
+                                 }),
+                  corners.end());
+}
+}  // namespace
+
+bool FeatureMotionEstimator::estimate(const uint8_t* curr, const uint8_t* prev, int w, int h,
+                                      const Boxes& exclude, Mat3f& warp) {
+    if (!curr || !prev || w < kMinLevelSide || h < kMinLevelSide) return false;
+
+    std::vector<Level> prev_pyramid;
+    const size_t plane_size = static_cast<size_t>(w) * static_cast<size_t>(h);
+    if (w == last_w_ && h == last_h_ && last_plane_.size() == plane_size &&
+        std::memcmp(prev, last_plane_.data(), plane_size) == 0) {
+        prev_pyramid = std::move(last_pyramid_);
+    } else {
+        BuildFlowPyramid(prev, w, h, prev_pyramid);
+    }
+    std::vector<Level> curr_pyramid;
+    BuildFlowPyramid(curr, w, h, curr_pyramid);
+
+    std::vector<Corner> corners;
+    DetectCorners(prev, w, h, corners);
+    ExcludeCorners(corners, exclude);
+
+    // Points whose flow comes back to where it started.
+    std::vector<Corner> p0, p1;
+    p0.reserve(corners.size());
+    p1.reserve(corners.size());
+    for (const Corner& c : corners) {
+        Corner fwd, back;
+        if (!TrackFlowPoint(prev_pyramid, curr_pyramid, c, fwd)) continue;
+        if (!TrackFlowPoint(curr_pyramid, prev_pyramid, fwd, back)) continue;
+        const float ex = back.x - c.x, ey = back.y - c.y;
+        if (ex * ex + ey * ey > kMaxFbError * kMaxFbError) continue;
+        p0.push_back(c);
+        p1.push_back(fwd);
+    }
+
+    // Keep the current plane for the next call before anything can fail.
+    last_plane_.assign(curr, curr + plane_size);
+    last_w_ = w;
+    last_h_ = h;
+    last_pyramid_ = std::move(curr_pyramid);
+
+    if (homography_ || homography_below_ <= 0.0f) {
+        return FitRobustMotion(std::move(p0), std::move(p1), w, h, homography_, kInlierPixels, warp);
+    }
+    // A similarity first; a homography only where it leaves too many
+    // tracks unexplained (perspective, lens distortion).
+    float ratio = 0.0f;
+    Mat3f similarity = warp;
+    const bool ok = FitRobustMotion(p0, p1, w, h, false, kInlierPixels, similarity, &ratio);
+    if (ratio < homography_below_) {
+        float h_ratio = 0.0f;
+        Mat3f homography = warp;
+        if (FitRobustMotion(std::move(p0), std::move(p1), w, h, true, kInlierPixels, homography, &h_ratio) &&
+            (!ok || h_ratio > ratio)) {
+            warp = homography;
+            return true;
+        }
+    }
+    if (ok) warp = similarity;
+    return ok;
+}
+
+bool FitRobustMotion(std::vector<FeatureMotionEstimator::Corner> p0, std::vector<FeatureMotionEstimator::Corner> p1,
+                     int w, int h, bool homography, float inlier_pixels, Mat3f& warp, float* inlier_ratio) {
+    const int n = static_cast<int>(p0.size());
+    if (inlier_ratio) *inlier_ratio = 0.0f;
+    if (n < kMinInliers) return false;
+
+    // Fit in coordinates centred on the plane and scaled to about [-1, 1],
+    // which keeps the homography's normal equations well conditioned.
+    const double cx = 0.5 * w, cy = 0.5 * h, sc = 2.0 / std::max(w, h);
+    for (int k = 0; k < n; ++k) {
+        p0[k] = Corner{static_cast<float>((p0[k].x - cx) * sc), static_cast<float>((p0[k].y - cy) * sc)};
+        p1[k] = Corner{static_cast<float>((p1[k].x - cx) * sc), static_cast<float>((p1[k].y - cy) * sc)};
+    }
+    const double inlier2 = (inlier_pixels * sc) * (inlier_pixels * sc);
+    const int sample_size = homography ? 4 : 2;
+    auto fit = [&](const int* idx, int count, Mat3d& model) {
+        return homography ? FitHomography(p0, p1, idx, count, model) : FitSimilarity(p0, p1, idx, count, model);
+    };
+    auto inliers_of = [&](const Mat3d& model, std::vector<int>& out) {
+        out.clear();
+        for (int k = 0; k < n; ++k) {
+            if (TransferError2(model, p0[k], p1[k]) < inlier2) out.push_back(k);
+        }
+    };
+
+    // Fixed seed: the same frames give the same warp.
+    uint32_t rng = 0x9e3779b9u ^ static_cast<uint32_t>(n);
+    auto next = [&rng]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    };
+    std::vector<int> best, inliers;
+    int iterations = kMaxRansacIterations;
+    for (int it = 0; it < iterations; ++it) {
+        int sample[4];
+        for (int s = 0; s < sample_size; ++s) {
+            bool fresh = false;
+            while (!fresh) {
+                sample[s] = static_cast<int>(next() % static_cast<uint32_t>(n));
+                fresh = std::find(sample, sample + s, sample[s]) == sample + s;
+            }
+        }
+        Mat3d model;
+        if (!fit(sample, sample_size, model)) continue;
+        inliers_of(model, inliers);
+        if (inliers.size() <= best.size()) continue;
+        best.swap(inliers);
+        const double ratio = static_cast<double>(best.size()) / n;
+        const double miss = 1.0 - std::pow(ratio, sample_size);
+        if (miss <= 0.0) break;
+        const double needed = std::log(1.0 - kRansacConfidence) / std::log(miss);
+        iterations = std::min(kMaxRansacIterations, static_cast<int>(std::ceil(needed)));
+    }
+    if (inlier_ratio) *inlier_ratio = static_cast<float>(best.size()) / static_cast<float>(n);
+    if (static_cast<int>(best.size()) < std::max(kMinInliers, static_cast<int>(kMinInlierRatio * n))) return false;
+
+    Mat3d model;
+    if (!fit(best.data(), static_cast<int>(best.size()), model)) return false;
+    inliers_of(model, inliers);
+    if (inlier_ratio) *inlier_ratio = static_cast<float>(inliers.size()) / static_cast<float>(n);
+    if (static_cast<int>(inliers.size()) < std::max(kMinInliers, static_cast<int>(kMinInlierRatio * n))) return false;
+
+    // Back to plane pixels: T^-1 * H * T with T the normalization above.
+    const Mat3d t{{sc, 0.0, -cx * sc, 0.0, sc, -cy * sc, 0.0, 0.0, 1.0}};
+    const Mat3d t_inv{{1.0 / sc, 0.0, cx, 0.0, 1.0 / sc, cy, 0.0, 0.0, 1.0}};
+    Mat3d out = Multiply(t_inv, Multiply(model, t));
+    if (!(std::fabs(out.m[8]) > 1e-12)) return false;
+    for (int k = 0; k < 9; ++k) warp.m[static_cast<size_t>(k)] = static_cast<float>(out.m[k] / out.m[8]);
+    return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "transform.hpp"
+
+/**
+ * Dependency-free sparse-feature camera motion estimate, the fallback GMC
+ * backend for rotation and zoom (GmcConfig::Fallback::Features).
+ *
+ * FAST-9 corners on the earlier plane (best one per grid cell), pyramidal
+ * Lucas-Kanade flow into the later plane with a forward-backward check,
+ * and RANSAC for a similarity transform or a homography refit to its
+ * inliers by least squares. Like the OpenCV backend it keeps the later
+ * plane's flow pyramid, so each frame of a sequence is prepared once (not
+ * thread-safe).
+ */
+class FeatureMotionEstimator {
+public:
+    using Boxes = std::vector<std::array<float, 4>>;
+
+    /**
+     * @param homography_below With a similarity: also fit a homography to
+     *        the same tracks when a smaller share of them than this are
+     *        inliers, and keep it if it explains more (0 = never)
+     */
+    explicit FeatureMotionEstimator(bool homography, float homography_below = 0.0f)
+        : homography_(homography), homography_below_(homography_below) {}
+
+    /**
+     * Warp mapping `prev` to `curr` (planes of the same size), in plane
+     * pixels. Corners of `prev` inside `exclude` (plane pixels) are not used.
+     *
+     * @return false (warp untouched) if too few points agree on a motion
+     */
+    bool estimate(const uint8_t* curr, const uint8_t* prev, int w, int h, const Boxes& exclude, Mat3f& warp);
+
+    struct Level {
+        int w = 0;
+        int h = 0;
+        std::vector<float> px;
+    };
+    struct Corner {
+        float x;
+        float y;
+    };
+
+private:
+    bool homography_;
+    float homography_below_;
+
+    // The previous call's current plane and its pyramid.
+    std::vector<uint8_t> last_plane_;
+    int last_w_ = 0;
+    int last_h_ = 0;
+    std::vector<Level> last_pyramid_;
+};
+
+/**
+ * RANSAC fit of the similarity (or homography) taking points `p0` to `p1`
+ * in a w x h image, refit to its inliers by least squares. Point pairs from
+ * any source will do, e.g. flow tracks or codec motion vectors.
+ *
+ * @param inlier_pixels transfer error of an inlier, in the points' pixels
+ * @param inlier_ratio If set, the best model's share of inliers (also on failure)
+ * @return false (warp untouched) if too few pairs agree on a motion
+ */
+bool FitRobustMotion(std::vector<FeatureMotionEstimator::Corner> p0, std::vector<FeatureMotionEstimator::Corner> p1,
+                     int w, int h, bool homography, float inlier_pixels, Mat3f& warp,
+                     float* inlier_ratio = nullptr);
+
+/**
+ * The flow pyramid FeatureMotionEstimator builds for a w x h plane: up to
+ * three levels 2x apart, for TrackFlowPoint().
+ */
+void BuildFlowPyramid(const uint8_t* plane, int w, int h, std::vector<FeatureMotionEstimator::Level>& pyramid);
+
+/**
+ * Where the point `p` of pyramid `a` went on pyramid `b` (same plane size),
+ * by pyramidal Lucas-Kanade over a 9x9 window. Points in textureless
+ * windows, and flow that leaves the plane, are lost.
+ *
+ * @return false if lost (`q` undefined)
+ */
+bool TrackFlowPoint(const std::vector<FeatureMotionEstimator::Level>& a,
+                    const std::vector<FeatureMotionEstimator::Level>& b, FeatureMotionEstimator::Corner p,
+                    FeatureMotionEstimator::Corner& q);
@@ -0,0 +1,198 @@
+#include "gmc_phase.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+using Complex = std::complex<float>;
+
+constexpr int kMinSide = 32;           // smaller regions hold too few frequencies
+constexpr float kMinPeak = 0.03f;      // of the correlation (1 = every frequency agrees on the shift)
+constexpr float kMinPeakRatio = 1.5f;  // over the strongest correlation away from the peak
+constexpr int kPeakRadius = 2;         // cells around the peak that are part of it
+
+int FloorPow2(int v) {
+    int p = 1;
+    while (p * 2 <= v) p *= 2;
+    return p;
+}
+
+void HannWindow(int n, std::vector<float>& out) {
+    out.resize(static_cast<size_t>(n));
+    const double k = 2.0 * 3.14159265358979323846 / static_cast<double>(n - 1);
+    for (int i = 0; i < n; ++i) out[static_cast<size_t>(i)] = static_cast<float>(0.5 - 0.5 * std::cos(k * i));
+}
+
+void Twiddles(int n, std::vector<Complex>& out) {
+    out.resize(static_cast<size_t>(n / 2));
+    const double k = -2.0 * 3.14159265358979323846 / static_cast<double>(n);
+    for (int i = 0; i < n / 2; ++i) {
+        out[static_cast<size_t>(i)] = Complex(static_cast<float>(std::cos(k * i)), static_cast<float>(std::sin(k * i)));
+    }
+}
+
+inline Complex Mul(Complex a, Complex b) {
+    return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+// In-place radix-2 FFT of n (a power of two) values; unscaled both ways.
+void Fft(Complex* a, int n, const Complex* twiddle, bool inverse) {
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        const int half = len / 2;
+        const int step = n / len;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < half; ++k) {
+                const Complex t = twiddle[k * step];
+                const Complex v = Mul(a[i + k + half], inverse ? std::conj(t) : t);
+                const Complex u = a[i + k];
+                a[i + k] = u + v;
+                a[i + k + half] = u - v;
+            }
+        }
+    }
+}
+
+void Fft2d(Complex* data, int w, int h, const Complex* twiddle_x, const Complex* twiddle_y,
+           std::vector<Complex>& column, bool inverse) {
+    for (int y = 0; y < h; ++y) Fft(data + static_cast<size_t>(y) * static_cast<size_t>(w), w, twiddle_x, inverse);
+    column.resize(static_cast<size_t>(h));
+    for (int x = 0; x < w; ++x) {
+        for (int y = 0; y < h; ++y) column[static_cast<size_t>(y)] = data[static_cast<size_t>(y) * w + x];
+        Fft(column.data(), h, twiddle_y, inverse);
+        for (int y = 0; y < h; ++y) data[static_cast<size_t>(y) * w + x] = column[static_cast<size_t>(y)];
+    }
+}
+
+// Subpixel offset of a correlation peak `b` between neighbours `a` (left)
+// and `c` (right). A phase correlation peak is a sampled sinc, so the
+// offset towards the larger neighbour is its share of the two (Foroosh et
+// al.); a parabola would pull it towards whole pixels.
+inline float SubpixelPeak(float a, float b, float c) {
+    if (c >= a && c > 0.0f) return c / (c + b);
+    if (a > c && a > 0.0f) return -a / (a + b);
+    return 0.0f;
+}
+}  // namespace
+
+bool PhaseCorrelator::estimate(const uint8_t* curr, const uint8_t* prev, int w, int h, const Boxes& exclude,
+                               float& dx, float& dy) {
+    dx = 0.0f;
+    dy = 0.0f;
+    if (!curr || !prev || w < kMinSide || h < kMinSide) return false;
+    const int fw = FloorPow2(w);
+    const int fh = FloorPow2(h);
+    if (fw != fw_ || fh != fh_) {
+        fw_ = fw;
+        fh_ = fh;
+        HannWindow(fw, window_x_);
+        HannWindow(fh, window_y_);
+        Twiddles(fw, twiddle_x_);
+        Twiddles(fh, twiddle_y_);
+    }
+    const size_t n = static_cast<size_t>(fw) * static_cast<size_t>(fh);
+    const int x0 = (w - fw) / 2;
+    const int y0 = (h - fh) / 2;
+
+    keep_.assign(n, 1);
+    for (const std::array<float, 4>& b : exclude) {
+        const int bx0 = std::max(0, static_cast<int>(std::floor(b[0])) - x0);
+        const int by0 = std::max(0, static_cast<int>(std::floor(b[1])) - y0);
+        const int bx1 = std::min(fw, static_cast<int>(std::ceil(b[2])) - x0);
+        const int by1 = std::min(fh, static_cast<int>(std::ceil(b[3])) - y0);
+        for (int y = by0; y < by1; ++y) {
+            std::fill(keep_.begin() + static_cast<std::ptrdiff_t>(y) * fw + bx0,
+                      keep_.begin() + static_cast<std::ptrdiff_t>(y) * fw + std::max(bx0, bx1), 0);
+        }
+    }
+
+    // Mean-free, windowed planes: prev as the real part, curr as the imaginary part.
+    double sum_prev = 0.0, sum_curr = 0.0;
+    size_t kept = 0;
+    for (int y = 0; y < fh; ++y) {
+        const uint8_t* p = prev + static_cast<size_t>(y + y0) * static_cast<size_t>(w) + x0;
+        const uint8_t* c = curr + static_cast<size_t>(y + y0) * static_cast<size_t>(w) + x0;
+        const uint8_t* k = keep_.data() + static_cast<size_t>(y) * fw;
+        for (int x = 0; x < fw; ++x) {
+            if (!k[x]) continue;
+            sum_prev += p[x];
+            sum_curr += c[x];
+            kept++;
+        }
+    }
+    if (kept < n / 4) return false;  // mostly excluded: too little background
+    const float mean_prev = static_cast<float>(sum_prev / static_cast<double>(kept));
+    const float mean_curr = static_cast<float>(sum_curr / static_cast<double>(kept));
+    data_.resize(n);
+    for (int y = 0; y < fh; ++y) {
+        const uint8_t* p = prev + static_cast<size_t>(y + y0) * static_cast<size_t>(w) + x0;
+        const uint8_t* c = curr + static_cast<size_t>(y + y0) * static_cast<size_t>(w) + x0;
+        const uint8_t* k = keep_.data() + static_cast<size_t>(y) * fw;
+        Complex* d = data_.data() + static_cast<size_t>(y) * fw;
+        const float wy = window_y_[static_cast<size_t>(y)];
+        for (int x = 0; x < fw; ++x) {
+            const float wxy = k[x] ? wy * window_x_[static_cast<size_t>(x)] : 0.0f;
+            d[x] = Complex(wxy * (static_cast<float>(p[x]) - mean_prev), wxy * (static_cast<float>(c[x]) - mean_curr));
+        }
+    }
+    Fft2d(data_.data(), fw, fh, twiddle_x_.data(), twiddle_y_.data(), column_, false);
+
+    // Split the spectra (P = (Z[k] + conj Z[-k]) / 2, C = (Z[k] - conj Z[-k]) / 2i)
+    // and whiten C * conj(P): its inverse peaks at the shift of curr against prev.
+    cross_.resize(n);
+    for (int v = 0; v < fh; ++v) {
+        const int nv = (fh - v) & (fh - 1);
+        for (int u = 0; u < fw; ++u) {
+            const int nu = (fw - u) & (fw - 1);
+            const Complex z = data_[static_cast<size_t>(v) * fw + u];
+            const Complex zn = std::conj(data_[static_cast<size_t>(nv) * fw + nu]);
+            const Complex sp = 0.5f * (z + zn);
+            const Complex diff = z - zn;
+            const Complex sc(0.5f * diff.imag(), -0.5f * diff.real());
+            const Complex cross = Mul(sc, std::conj(sp));
+            const float mag = std::abs(cross);
+            cross_[static_cast<size_t>(v) * fw + u] = mag > 1e-9f ? cross / mag : Complex(0.0f, 0.0f);
+        }
+    }
+    Fft2d(cross_.data(), fw, fh, twiddle_x_.data(), twiddle_y_.data(), column_, true);
+
+    const float scale = 1.0f / static_cast<float>(n);
+    auto corr = [&](int x, int y) {
+        return cross_[static_cast<size_t>((y + fh) & (fh - 1)) * fw + static_cast<size_t>((x + fw) & (fw - 1))].real() *
+               scale;
+    };
+    int px = 0, py = 0;
+    float peak = -1.0f;
+    for (int y = 0; y < fh; ++y) {
+        for (int x = 0; x < fw; ++x) {
+            const float c = cross_[static_cast<size_t>(y) * fw + x].real();
+            if (c > peak) {
+                peak = c;
+                px = x;
+                py = y;
+            }
+        }
+    }
+    peak *= scale;
+    float rival = 0.0f;
+    for (int y = 0; y < fh; ++y) {
+        const int ddy = std::min((y - py + fh) & (fh - 1), (py - y + fh) & (fh - 1));
+        for (int x = 0; x < fw; ++x) {
+            const int ddx = std::min((x - px + fw) & (fw - 1), (px - x + fw) & (fw - 1));
+            if (ddx <= kPeakRadius && ddy <= kPeakRadius) continue;
+            rival = std::max(rival, cross_[static_cast<size_t>(y) * fw + x].real() * scale);
+        }
+    }
+    if (peak < kMinPeak || peak < kMinPeakRatio * rival) return false;
+
+    const float sx = SubpixelPeak(corr(px - 1, py), peak, corr(px + 1, py));
+    const float sy = SubpixelPeak(corr(px, py - 1), peak, corr(px, py + 1));
+    dx = static_cast<float>(px < fw / 2 ? px : px - fw) + sx;
+    dy = static_cast<float>(py < fh / 2 ? py : py - fh) + sy;
+    return true;
+}
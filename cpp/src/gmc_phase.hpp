@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+/**
+ * FFT phase correlation on luma planes, the fallback GMC backend for
+ * translation-dominant footage (GmcConfig::Fallback::PhaseCorrelation).
+ *
+ * The largest power-of-two region around the plane centre is windowed
+ * (Hann) in both planes, and the peak of the inverse-transformed
+ * normalized cross-power spectrum gives the shift, refined to subpixel
+ * precision from its neighbours. The cost is
+ * O(N log N) in the region's pixels whatever the motion, and shifts up to
+ * half the region's side are found. Both planes go through one complex
+ * FFT (one as the real part, one as the imaginary part).
+ */
+class PhaseCorrelator {
+public:
+    using Boxes = std::vector<std::array<float, 4>>;
+
+    /**
+     * Shift (dx, dy) of `curr` against `prev` (planes of the same size), in
+     * plane pixels. Pixels inside `exclude` (plane pixels) are left out.
+     *
+     * @return false if there is no distinct correlation peak
+     */
+    bool estimate(const uint8_t* curr, const uint8_t* prev, int w, int h, const Boxes& exclude,
+                  float& dx, float& dy);
+
+private:
+    using Complex = std::complex<float>;
+
+    // Per region size: Hann windows and FFT twiddles (not thread-safe).
+    int fw_ = 0;
+    int fh_ = 0;
+    std::vector<float> window_x_;
+    std::vector<float> window_y_;
+    std::vector<Complex> twiddle_x_;
+    std::vector<Complex> twiddle_y_;
+    std::vector<Complex> data_;   // both planes, then their spectra
+    std::vector<Complex> cross_;  // normalized cross-power spectrum, then the correlation
+    std::vector<Complex> column_;
+    std::vector<uint8_t> keep_;   // region pixels outside the exclusions
+};
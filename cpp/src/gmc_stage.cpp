@@ -0,0 +1,102 @@
+#include "gmc_stage.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+GmcStage::GmcStage(int count, int workers, FrameCache::Loader decode, GmcConfig cfg, int first,
+                   MemoryBudget* budget, StageProfile* profile, int max_workers)
+    : decode_(std::move(decode)),
+      cfg_(cfg),
+      next_decode_(std::max(0, first)),
+      profile_(profile),
+      // Two frames in flight per worker, as the detection scheduler keeps.
+      prefetch_(count, workers, 2 * std::max({1, workers, max_workers}),
+                [this](int index, LoadedRgbFrame& out) { return load(index, out); },
+                first, budget ? budget->open("gmc queue") : nullptr, max_workers) {}
+
+bool GmcStage::take(int index, LoadedRgbFrame& out) {
+    return prefetch_.take(index, out);
+}
+
+bool GmcStage::takeWarp(int index, Mat3f& warp, bool& ok) {
+    std::lock_guard<std::mutex> lock(mu_);
+    warps_.erase(warps_.begin(), warps_.lower_bound(index));
+    auto it = warps_.find(index);
+    if (it == warps_.end()) return false;
+    warp = it->second.warp;
+    ok = it->second.ok;
+    warps_.erase(it);
+    return true;
+}
+
+void GmcStage::setPaused(bool paused) {
+    std::lock_guard<std::mutex> lock(mu_);
+    paused_ = paused;
+}
+
+bool GmcStage::load(int index, LoadedRgbFrame& out) {
+    // Workers claim frames in order but reach here in any order: wait for
+    // this frame's turn at the decoder.
+    Planes prev;
+    bool have_prev = false;
+    bool paused = false;
+    bool ok = false;
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_turn_.wait(lock, [&] { return next_decode_ == index; });
+        lock.unlock();
+        ok = decode_(index, out);
+        lock.lock();
+        // The next pair reads this frame's planes after the consumer may
+        // have recycled the frame, so they are copied.
+        if (ok && out.hasLuma()) {
+            Planes& planes = planes_[index];
+            const size_t size = static_cast<size_t>(out.luma_w) * static_cast<size_t>(out.luma_h);
+            planes.luma.assign(out.lumaData(), out.lumaData() + size);
+            planes.coarse = out.luma_coarse;
+            planes.w = out.luma_w;
+            planes.h = out.luma_h;
+        }
+        auto it = planes_.find(index - 1);
+        if (it != planes_.end()) {
+            prev = std::move(it->second);
+            have_prev = true;
+            planes_.erase(it);
+        }
+        paused = paused_;
+        next_decode_++;
+    }
+    cv_turn_.notify_all();
+    if (!ok || !have_prev || paused || !out.hasLuma() || prev.w != out.luma_w || prev.h != out.luma_h) return ok;
+
+    std::unique_ptr<GmcEstimator> gmc;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (!idle_.empty()) {
+            gmc = std::move(idle_.back());
+            idle_.pop_back();
+        }
+    }
+    if (!gmc) gmc = std::make_unique<GmcEstimator>(cfg_);
+    Warp w;
+    AllocStats::Scope counted(ProfileStage::Gmc);
+    const auto start = std::chrono::steady_clock::now();
+    w.ok = gmc->EstimateLuma(out.lumaData(), prev.luma.data(), out.luma_w, out.luma_h, out.luma_scale, w.warp,
+                             out.luma_coarse.empty() ? nullptr : out.luma_coarse.data(),
+                             prev.coarse.empty() ? nullptr : prev.coarse.data());
+    const auto end = std::chrono::steady_clock::now();
+    busy_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    if (profile_) profile_->record(ProfileStage::Gmc, start, end, index);
+    std::lock_guard<std::mutex> lock(mu_);
+    idle_.push_back(std::move(gmc));
+    warps_[index] = w;
+    return ok;
+}
+
+int GmcStage::ResolveWorkerCount(int requested) {
+    if (requested > 0) return requested;
+    // A pair costs a fraction of a detection: a few workers keep up.
+    const int hw = PipelineCoreCount();
+    return hw < 2 ? 1 : std::max(2, std::min(4, hw / 4));
+}
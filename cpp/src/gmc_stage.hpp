@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_cache.hpp"
+#include "gmc.hpp"
+#include "prefetcher.hpp"
+#include "stage_profile.hpp"
+
+/**
+ * Estimates GMC warps ahead of the tracker, several frame pairs at once.
+ *
+ * A warp depends on two consecutive frames only, not on tracker state. The
+ * stage sits between the decoders and the tracking loop: its workers take
+ * decoded frames from `decode` in order, keep a copy of each frame's luma
+ * planes for the next pair, and estimate the warp of pair (i - 1, i) with
+ * an estimator of their own. Frames are handed on in order, and by the time
+ * frame i is, its warp is ready (takeWarp()).
+ *
+ * Only the taking of frames from `decode` is serialized, so `decode` sees
+ * one caller at a time, in increasing index order.
+ */
+class GmcStage {
+public:
+    /**
+     * @param count Number of frames
+     * @param workers Frame pairs estimated concurrently
+     * @param decode In-order loader of the decoded frames
+     * @param first First frame (a resumed run starts past 0; it has no pair)
+     * @param budget Frames in flight are charged to it (nullptr = no budget)
+     * @param profile Each estimate is recorded in it (nullptr = none)
+     * @param max_workers Workers setActiveWorkers() may wake (0 = `workers`)
+     */
+    GmcStage(int count, int workers, FrameCache::Loader decode, GmcConfig cfg = {}, int first = 0,
+             MemoryBudget* budget = nullptr, StageProfile* profile = nullptr, int max_workers = 0);
+
+    /**
+     * Block until frame `index` is decoded and its warp estimated; move the
+     * frame into `out`. Frames must be taken in increasing order.
+     *
+     * @return false if the frame could not be decoded
+     */
+    bool take(int index, LoadedRgbFrame& out);
+
+    /**
+     * The warp of pair (index - 1, index) and whether estimation succeeded.
+     * Warps of earlier frames are dropped.
+     *
+     * @return false if the stage did not estimate this pair (no previous
+     *         frame, or planes of different sizes)
+     */
+    bool takeWarp(int index, Mat3f& warp, bool& ok);
+
+    /**
+     * Stop (or resume) estimating pairs not yet started, e.g. while the
+     * camera is static. takeWarp() reports the pairs skipped meanwhile as
+     * not estimated.
+     */
+    void setPaused(bool paused);
+
+    int numWorkers() const { return prefetch_.numThreads(); }
+    void setActiveWorkers(int n) { prefetch_.setActiveThreads(n); }
+    int activeWorkers() { return prefetch_.activeThreads(); }
+    int ready() { return prefetch_.ready(); }  // frames with their warps waiting (FramePrefetcher::ready)
+
+    /** Time the workers spent estimating, summed over them. */
+    double busyMs() const { return static_cast<double>(busy_ns_.load()) * 1e-6; }
+
+    /**
+     * Resolve a worker count (`requested <= 0` = auto).
+     */
+    static int ResolveWorkerCount(int requested);
+
+private:
+    // Luma planes of a frame, kept until the pair it starts is estimated.
+    struct Planes {
+        std::vector<uint8_t> luma;
+        std::vector<uint8_t> coarse;
+        int w = 0;
+        int h = 0;
+    };
+    struct Warp {
+        Mat3f warp = Mat3f::Identity();
+        bool ok = false;
+    };
+
+    bool load(int index, LoadedRgbFrame& out);
+
+    FrameCache::Loader decode_;
+    GmcConfig cfg_;
+    std::mutex mu_;
+    std::condition_variable cv_turn_;
+    int next_decode_ = 0;  // next frame to take from decode_
+    bool paused_ = false;
+    std::atomic<int64_t> busy_ns_{0};
+    StageProfile* profile_;
+    std::map<int, Planes> planes_;
+    std::map<int, Warp> warps_;
+    std::vector<std::unique_ptr<GmcEstimator>> idle_;  // estimators not in use
+    FramePrefetcher prefetch_;  // declared after the members its workers use
+};
@@ -0,0 +1,182 @@
+#include "gpu_preprocess.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#if NCNN_VULKAN
+#include "command.h"
+#include "gpu.h"
+#include "pipeline.h"
+#endif
+
+#if NCNN_VULKAN
+namespace {
+// One invocation per output pixel writes all three planes. The source is
+// the region's packed RGB bytes, four to a uint.
+const char kShader[] = R"glsl(
+#version 450
+layout (local_size_x_id = 233) in;
+layout (local_size_y_id = 234) in;
+layout (local_size_z_id = 235) in;
+
+layout (binding = 0) readonly buffer src_blob { uint src[]; };
+layout (binding = 1) writeonly buffer dst_blob { float dst[]; };
+
+layout (push_constant) uniform parameter {
+    int w; int h; int stride;
+    int dst_w; int dst_h; int pad_w; int pad_h; int cstep;
+    float mean0; float mean1; float mean2;
+    float norm0; float norm1; float norm2;
+} p;
+
+float src_at(int x, int y, int c) {
+    const int i = y * p.stride + x * 3 + c;
+    return float((src[i >> 2] >> ((i & 3) * 8)) & 0xffu);
+}
+
+// The CPU path's taps (image_ops.cpp BilinearTaps).
+void taps(int d, int src_n, int dst_n, out int s0, out int s1, out float f) {
+    f = (float(d) + 0.5) * float(src_n) / float(dst_n) - 0.5;
+    s0 = int(floor(f));
+    f -= float(s0);
+    if (s0 < 0) { s0 = 0; f = 0.0; }
+    if (s0 >= src_n - 1) { s0 = max(0, src_n - 2); f = 1.0; }
+    s1 = min(s0 + 1, src_n - 1);
+}
+
+void main() {
+    const int gx = int(gl_GlobalInvocationID.x);
+    const int gy = int(gl_GlobalInvocationID.y);
+    if (gx >= p.pad_w || gy >= p.pad_h) return;
+    const vec3 mean = vec3(p.mean0, p.mean1, p.mean2);
+    const vec3 norm = vec3(p.norm0, p.norm1, p.norm2);
+    vec3 v = vec3(0.0);
+    if (gx < p.dst_w && gy < p.dst_h) {
+        int x0, x1, y0, y1;
+        float fx, fy;
+        taps(gx, p.w, p.dst_w, x0, x1, fx);
+        taps(gy, p.h, p.dst_h, y0, y1, fy);
+        for (int c = 0; c < 3; ++c) {
+            const float top = mix(src_at(x0, y0, c), src_at(x1, y0, c), fx);
+            const float bottom = mix(src_at(x0, y1, c), src_at(x1, y1, c), fx);
+            v[c] = mix(top, bottom, fy);
+        }
+    }
+    v = (v - mean) * norm;
+    const int o = gy * p.pad_w + gx;
+    dst[o] = v.x;
+    dst[p.cstep + o] = v.y;
+    dst[2 * p.cstep + o] = v.z;
+}
+)glsl";
+}  // namespace
+
+struct GpuPreprocessor::Impl {
+    const ncnn::VulkanDevice* vkdev = nullptr;
+    ncnn::Option opt;
+    std::unique_ptr<ncnn::Pipeline> pipeline;
+    mutable std::atomic<size_t> uploaded{0};
+};
+
+std::unique_ptr<GpuPreprocessor> GpuPreprocessor::Create(const ncnn::Net& net) {
+    const ncnn::VulkanDevice* vkdev = net.vulkan_device();
+    if (!net.opt.use_vulkan_compute || !vkdev) return nullptr;
+    auto impl = std::make_unique<Impl>();
+    impl->vkdev = vkdev;
+    impl->opt = net.opt;
+    // The input blob stays fp32: the net's first layer converts it to its
+    // own storage and packing, as for an uploaded CPU blob.
+    impl->opt.use_fp16_storage = false;
+    impl->opt.use_fp16_packed = false;
+    std::vector<uint32_t> spirv;
+    if (ncnn::compile_spirv_module(kShader, static_cast<int>(sizeof(kShader) - 1), impl->opt, spirv) != 0) {
+        return nullptr;
+    }
+    impl->pipeline = std::make_unique<ncnn::Pipeline>(vkdev);
+    impl->pipeline->set_optimal_local_size_xyz(8, 8, 1);
+    if (impl->pipeline->create(spirv.data(), spirv.size() * 4, std::vector<ncnn::vk_specialization_type>()) != 0) {
+        return nullptr;
+    }
+    return std::unique_ptr<GpuPreprocessor>(new GpuPreprocessor(std::move(impl)));
+}
+
+bool GpuPreprocessor::run(ncnn::Extractor& ex, const char* input,
+                          const uint8_t* rgb, int w, int h, int stride,
+                          int dst_w, int dst_h, int pad_w, int pad_h,
+                          const float mean[3], const float norm[3],
+                          const std::function<void(ncnn::Extractor&)>& extract) const {
+    if (!rgb || w <= 0 || h <= 0 || pad_w <= 0 || pad_h <= 0) return false;
+    const ncnn::VulkanDevice* vkdev = impl_->vkdev;
+    ncnn::VkAllocator* blob_allocator = vkdev->acquire_blob_allocator();
+    ncnn::VkAllocator* staging_allocator = vkdev->acquire_staging_allocator();
+    ncnn::Option opt = impl_->opt;
+    opt.blob_vkallocator = blob_allocator;
+    opt.workspace_vkallocator = blob_allocator;
+    opt.staging_vkallocator = staging_allocator;
+
+    // The region's rows, packed: only w * 3 of each frame row are read.
+    const int row = w * 3;
+    const size_t bytes = static_cast<size_t>(row) * static_cast<size_t>(h);
+    ncnn::Mat packed(static_cast<int>((bytes + 3) / 4), static_cast<size_t>(4u));
+    auto* out = static_cast<uint8_t*>(packed.data);
+    for (int y = 0; y < h; ++y) {
+        std::memcpy(out + static_cast<size_t>(y) * row, rgb + static_cast<size_t>(y) * stride, static_cast<size_t>(row));
+    }
+
+    bool ok = false;
+    {
+        ncnn::VkCompute cmd(vkdev);
+        ncnn::VkMat src;
+        cmd.record_clone(packed, src, opt);
+        ncnn::VkMat dst;
+        dst.create(pad_w, pad_h, 3, static_cast<size_t>(4u), 1, blob_allocator);
+        if (!src.empty() && !dst.empty()) {
+            std::vector<ncnn::VkMat> bindings = {src, dst};
+            std::vector<ncnn::vk_constant_type> constants(14);
+            const int ints[] = {w, h, row, dst_w, dst_h, pad_w, pad_h, static_cast<int>(dst.cstep)};
+            for (int k = 0; k < 8; ++k) constants[k].i = ints[k];
+            for (int c = 0; c < 3; ++c) {
+                constants[8 + c].f = mean[c];
+                constants[11 + c].f = norm[c];
+            }
+            cmd.record_pipeline(impl_->pipeline.get(), bindings, constants, dst);
+            ok = cmd.submit_and_wait() == 0;
+        }
+        if (ok) {
+            impl_->uploaded += bytes;
+            ex.input(input, dst);
+            extract(ex);
+            // The extractor's device blobs go back before the allocators do.
+            ex.clear();
+        }
+    }
+    vkdev->reclaim_blob_allocator(blob_allocator);
+    vkdev->reclaim_staging_allocator(staging_allocator);
+    return ok;
+}
+
+size_t GpuPreprocessor::uploadedBytes() const {
+    return impl_->uploaded.load();
+}
+#else
+struct GpuPreprocessor::Impl {};
+
+std::unique_ptr<GpuPreprocessor> GpuPreprocessor::Create(const ncnn::Net& net) {
+    (void)net;
+    return nullptr;
+}
+
+bool GpuPreprocessor::run(ncnn::Extractor&, const char*, const uint8_t*, int, int, int, int, int, int, int,
+                          const float[3], const float[3], const std::function<void(ncnn::Extractor&)>&) const {
+    return false;
+}
+
+size_t GpuPreprocessor::uploadedBytes() const {
+    return 0;
+}
+#endif
+
+GpuPreprocessor::GpuPreprocessor(std::unique_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
+GpuPreprocessor::~GpuPreprocessor() = default;
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "net.h"
+
+/**
+ * Detector input preparation on the Vulkan device (GpuOptions::preprocess).
+ *
+ * With the net on the GPU, the CPU still resizes, letterboxes and
+ * normalizes each frame into a float blob that ncnn then uploads: the
+ * resize pass becomes the slowest step, and the upload carries 4 bytes per
+ * channel. Here the region's uint8 RGB rows go up as they are, and one
+ * compute shader does the bilinear resize (the CPU path's half-pixel taps),
+ * the padding and the normalization into the net's input blob on the
+ * device. ReID's 112x112 crops stay on the CPU: they are small to upload,
+ * and their alignment reads full-resolution frames the detector never sees.
+ */
+class GpuPreprocessor {
+public:
+    /**
+     * Shader pipeline for `net`'s Vulkan device; nullptr if the net is not
+     * on one, or ncnn was built without Vulkan.
+     */
+    static std::unique_ptr<GpuPreprocessor> Create(const ncnn::Net& net);
+
+    ~GpuPreprocessor();
+
+    /**
+     * Prepare the detector input from the `w x h` RGB region at `rgb` (rows
+     * `stride` bytes apart), feed it to `ex` as blob `input`, and run
+     * `extract` while it is on the device. Same geometry and normalization
+     * as ResizeRgbToPlanarNormalized(). Safe to call concurrently.
+     *
+     * @return false if the device work failed (nothing was extracted)
+     */
+    bool run(ncnn::Extractor& ex, const char* input,
+             const uint8_t* rgb, int w, int h, int stride,
+             int dst_w, int dst_h, int pad_w, int pad_h,
+             const float mean[3], const float norm[3],
+             const std::function<void(ncnn::Extractor&)>& extract) const;
+
+    /** Bytes uploaded so far. */
+    size_t uploadedBytes() const;
+
+private:
+    struct Impl;
+    explicit GpuPreprocessor(std::unique_ptr<Impl> impl);
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,78 @@
+#include "huge_pages.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace {
+constexpr size_t kHugePageSize = size_t{2} << 20;  // x86-64 and arm64 with 4 KiB base pages
+constexpr size_t kMaxAdvisedBlocks = 4096;         // per pool; past it, blocks are advised again
+
+std::atomic<bool> g_enabled{false};
+std::atomic<size_t> g_advised_bytes{0};
+}  // namespace
+
+void EnableHugePages(bool enabled) {
+    g_enabled = enabled;
+}
+
+bool HugePagesEnabled() {
+    return g_enabled.load();
+}
+
+size_t HugePageAdvisedBytes() {
+    return g_advised_bytes.load();
+}
+
+size_t HugePageResidentBytes() {
+    size_t bytes = 0;
+#if defined(__linux__)
+    FILE* f = std::fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return 0;
+    char line[256];
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::strncmp(line, "AnonHugePages:", 14) == 0) {
+            bytes = static_cast<size_t>(std::strtoull(line + 14, nullptr, 10)) * 1024;  // kB
+            break;
+        }
+    }
+    std::fclose(f);
+#endif
+    return bytes;
+}
+
+void AdviseHugePages(void* data, size_t bytes) {
+    if (!g_enabled.load() || !data || bytes < 2 * kHugePageSize) return;
+#if defined(__linux__)
+    const uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes) & ~(kHugePageSize - 1);
+    if (end <= begin) return;
+    if (::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) == 0) g_advised_bytes += end - begin;
+#endif
+}
+
+void ReserveHugePages(std::vector<uint8_t>& buffer, size_t bytes) {
+    if (!g_enabled.load() || buffer.capacity() >= bytes || !buffer.empty()) return;
+    // An empty vector reallocates without copying, and reserve() leaves the
+    // new pages untouched until the decoder writes them.
+    buffer.shrink_to_fit();
+    buffer.reserve(bytes);
+    AdviseHugePages(buffer.data(), buffer.capacity());
+}
+
+void* HugePagePoolAllocator::fastMalloc(size_t size) {
+    void* ptr = ncnn::PoolAllocator::fastMalloc(size);
+    if (!g_enabled.load() || size < 2 * kHugePageSize) return ptr;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (advised_.size() >= kMaxAdvisedBlocks) advised_.clear();
+        if (!advised_.insert(ptr).second) return ptr;
+    }
+    AdviseHugePages(ptr, size);
+    return ptr;
+}
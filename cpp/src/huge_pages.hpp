@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "allocator.h"
+
+/**
+ * Huge pages for the large, long-lived buffers: decoded frame planes and
+ * the ncnn blob pools (--huge-pages).
+ *
+ * A 4K frame plane or an early SCRFD blob spans thousands of 4 KiB pages,
+ * and resize, GMC and warp passes over them miss the TLB on most rows. On
+ * Linux, such buffers are advised for transparent huge pages
+ * (madvise(MADV_HUGEPAGE)) before they are first written, so the kernel
+ * backs them with 2 MiB pages when it has them. That needs no reserved
+ * hugetlbfs pages and no privileges, and falls back to normal pages on its
+ * own. Elsewhere the calls do nothing: macOS superpages and Windows large
+ * pages need their own allocations (and privileges on Windows).
+ */
+void EnableHugePages(bool enabled);
+bool HugePagesEnabled();
+
+/**
+ * Bytes advised so far, and the process' anonymous memory the kernel
+ * currently backs with huge pages (/proc/self/smaps_rollup; 0 where unknown).
+ */
+size_t HugePageAdvisedBytes();
+size_t HugePageResidentBytes();
+
+/**
+ * Advise the whole huge pages inside [data, data + bytes) (no-op while
+ * disabled, or for buffers shorter than two huge pages).
+ */
+void AdviseHugePages(void* data, size_t bytes);
+
+/**
+ * Give an empty `buffer` capacity for `bytes` in advised memory, before
+ * anything is written to it. Buffers that already have it are left alone.
+ */
+void ReserveHugePages(std::vector<uint8_t>& buffer, size_t bytes);
+
+/**
+ * ncnn::PoolAllocator whose new blocks are advised for huge pages while
+ * they are enabled. Blocks the pool hands out again are not advised twice.
+ */
+class HugePagePoolAllocator : public ncnn::PoolAllocator {
+public:
+    void* fastMalloc(size_t size) override;
+
+private:
+    std::mutex mu_;
+    std::unordered_set<void*> advised_;
+};
@@ -8,6 +8,7 @@
  */
 
 #include "hungarian.hpp"
+#include "tracy_zones.hpp"
 
 #include <algorithm>
 #include <cfloat>
@@ -17,57 +18,55 @@
 double HungarianAlgorithm::solve(const std::vector<std::vector<double>>& cost_matrix,
                                   std::vector<int>& assignment) {
     int n_rows = static_cast<int>(cost_matrix.size());
-    if (n_rows == 0) {
-        assignment.clear();
-        return 0.0;
-    }
-    
-    int n_cols = static_cast<int>(cost_matrix[0].size());
-    if (n_cols == 0) {
-        assignment.assign(n_rows, -1);
-        return 0.0;
-    }
+    int n_cols = n_rows > 0 ? static_cast<int>(cost_matrix[0].size()) : 0;
     
     // Flatten cost matrix to 1D array (column-major for algorithm)
-    std::vector<double> dist_matrix(n_rows * n_cols);
+    flat_.resize(static_cast<size_t>(n_rows) * static_cast<size_t>(n_cols));
     for (int i = 0; i < n_rows; ++i) {
         for (int j = 0; j < n_cols; ++j) {
-            dist_matrix[i + n_rows * j] = cost_matrix[i][j];
+            flat_[i + static_cast<size_t>(n_rows) * j] = cost_matrix[i][j];
         }
     }
-    
-    // Allocate assignment array
-    std::vector<int> assign_arr(n_rows);
-    double cost = 0.0;
+    return solve(flat_.data(), n_rows, n_cols, assignment);
+}
+
+double HungarianAlgorithm::solve(double* cost_col_major, int n_rows, int n_cols, std::vector<int>& assignment) {
+    FACE_PIPELINE_ZONE("HungarianAlgorithm::solve");
+    if (n_rows <= 0) {
+        assignment.clear();
+        return 0.0;
+    }
+    if (n_cols <= 0) {
+        assignment.assign(n_rows, -1);
+        return 0.0;
+    }
     
     // Solve
-    assignmentOptimal(assign_arr.data(), &cost, dist_matrix.data(), n_rows, n_cols);
-    
-    // Copy result
-    assignment = std::move(assign_arr);
-    
+    assignment.resize(n_rows);
+    double cost = 0.0;
+    assignmentOptimal(assignment.data(), &cost, cost_col_major, n_rows, n_cols);
     return cost;
 }
 
 void HungarianAlgorithm::assignmentOptimal(int* assignment, double* cost,
                                             double* dist_matrix,
                                             int n_of_rows, int n_of_cols) {
-    // Allocate working arrays (using char instead of bool for data() access)
+    // Working arrays, reused across calls (char instead of bool for data() access)
     int n_of_elements = n_of_rows * n_of_cols;
     int min_dim = std::min(n_of_rows, n_of_cols);
     
-    std::vector<char> covered_cols_v(n_of_cols, 0);
-    std::vector<char> covered_rows_v(n_of_rows, 0);
-    std::vector<char> star_matrix_v(n_of_elements, 0);
-    std::vector<char> prime_matrix_v(n_of_elements, 0);
-    std::vector<char> new_star_matrix_v(n_of_elements, 0);
+    covered_cols_v_.assign(n_of_cols, 0);
+    covered_rows_v_.assign(n_of_rows, 0);
+    star_matrix_v_.assign(n_of_elements, 0);
+    prime_matrix_v_.assign(n_of_elements, 0);
+    new_star_matrix_v_.assign(n_of_elements, 0);
     
     // Convert to bool pointers for internal use
-    bool* covered_cols = reinterpret_cast<bool*>(covered_cols_v.data());
-    bool* covered_rows = reinterpret_cast<bool*>(covered_rows_v.data());
-    bool* star_matrix = reinterpret_cast<bool*>(star_matrix_v.data());
-    bool* prime_matrix = reinterpret_cast<bool*>(prime_matrix_v.data());
-    bool* new_star_matrix = reinterpret_cast<bool*>(new_star_matrix_v.data());
+    bool* covered_cols = reinterpret_cast<bool*>(covered_cols_v_.data());
+    bool* covered_rows = reinterpret_cast<bool*>(covered_rows_v_.data());
+    bool* star_matrix = reinterpret_cast<bool*>(star_matrix_v_.data());
+    bool* prime_matrix = reinterpret_cast<bool*>(prime_matrix_v_.data());
+    bool* new_star_matrix = reinterpret_cast<bool*>(new_star_matrix_v_.data());
     
     // Preliminary steps
     if (n_of_rows <= n_of_cols) {
@@ -24,7 +24,23 @@ public:
     double solve(const std::vector<std::vector<double>>& cost_matrix,
                  std::vector<int>& assignment);
 
+    /**
+     * Solve on a flat column-major matrix, cost_col_major[row + n_rows * col],
+     * without copying it. The buffer is the working matrix: it is left
+     * reduced, and the returned cost is taken from the reduced values, as
+     * with the nested overload.
+     */
+    double solve(double* cost_col_major, int n_rows, int n_cols, std::vector<int>& assignment);
+
 private:
+    // Working storage, kept between calls so solving does not allocate.
+    std::vector<double> flat_;
+    std::vector<char> covered_cols_v_;
+    std::vector<char> covered_rows_v_;
+    std::vector<char> star_matrix_v_;
+    std::vector<char> prime_matrix_v_;
+    std::vector<char> new_star_matrix_v_;
+
     void assignmentOptimal(int* assignment, double* cost, double* dist_matrix,
                           int n_of_rows, int n_of_cols);
     
@@ -0,0 +1,136 @@
+#include "identity_gallery.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr char kMagic[8] = {'F', 'P', 'G', 'A', 'L', 'L', 'R', '1'};
+constexpr uint32_t kGalleryVersion = 1;
+constexpr uint32_t kMaxDim = 4096;  // sanity bound on a file's dimension
+
+// Little-endian on every target we build for; the header records the
+// layout so a mismatched file is rejected rather than misread.
+struct GalleryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t storage;
+    uint32_t count;
+    int32_t next_id;
+    uint32_t reserved;
+};
+
+struct IdentityRecord {
+    int32_t id;
+    int32_t tracks;
+    float scale;
+};
+}  // namespace
+
+bool IdentityGallery::load(const std::string& path, std::string& error) {
+    identities_.clear();
+    next_id_ = 0;
+    dim_ = 0;
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return true;  // first run
+
+    GalleryHeader hdr{};
+    bool ok = std::fread(&hdr, sizeof(hdr), 1, f) == 1 && std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) == 0 &&
+              hdr.version == kGalleryVersion && hdr.dim <= kMaxDim &&
+              hdr.storage <= static_cast<uint32_t>(EmbeddingStorage::Int8);
+    if (ok) {
+        storage_ = static_cast<EmbeddingStorage>(hdr.storage);
+        dim_ = static_cast<int>(hdr.dim);
+        const size_t payload = PackedEmbedding::PayloadBytes(storage_, dim_);
+        std::vector<unsigned char> bytes(payload);
+        identities_.reserve(hdr.count);
+        for (uint32_t i = 0; ok && i < hdr.count; ++i) {
+            IdentityRecord rec{};
+            ok = std::fread(&rec, sizeof(rec), 1, f) == 1 && std::fread(bytes.data(), 1, payload, f) == payload;
+            if (!ok) break;
+            Identity id;
+            id.id = rec.id;
+            id.tracks = rec.tracks;
+            id.appearance = PackedEmbedding::FromPayload(storage_, dim_, rec.scale, bytes.data());
+            identities_.push_back(std::move(id));
+        }
+        next_id_ = hdr.next_id;
+    }
+    std::fclose(f);
+    if (!ok) {
+        identities_.clear();
+        next_id_ = 0;
+        dim_ = 0;
+        error = path + " is not a face gallery (or is truncated)";
+    }
+    return ok;
+}
+
+bool IdentityGallery::save(const std::string& path, std::string& error) const {
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        error = "cannot create " + tmp;
+        return false;
+    }
+    GalleryHeader hdr{};
+    std::memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version = kGalleryVersion;
+    hdr.dim = static_cast<uint32_t>(dim_);
+    hdr.storage = static_cast<uint32_t>(storage_);
+    hdr.count = static_cast<uint32_t>(identities_.size());
+    hdr.next_id = next_id_;
+    bool ok = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    for (const Identity& id : identities_) {
+        if (!ok) break;
+        const IdentityRecord rec{id.id, id.tracks, id.appearance.scale()};
+        ok = std::fwrite(&rec, sizeof(rec), 1, f) == 1 &&
+             std::fwrite(id.appearance.payload(), 1, id.appearance.bytes(), f) == id.appearance.bytes();
+    }
+    ok = (std::fclose(f) == 0) && ok;
+    if (ok) {
+        std::remove(path.c_str());  // rename does not replace on Windows
+        ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        std::remove(tmp.c_str());
+        error = "cannot write " + path;
+    }
+    return ok;
+}
+
+std::vector<float> IdentityGallery::similarities(const EmbeddingF32& appearance) const {
+    // One query per track: pack it like the gallery so Int8 stays in integers.
+    const PackedEmbedding q(appearance, storage_);
+    std::vector<float> out;
+    out.reserve(identities_.size());
+    for (const Identity& id : identities_) out.push_back(CosineSimilarity(q, id.appearance));
+    return out;
+}
+
+int IdentityGallery::add(const EmbeddingF32& appearance) {
+    if (appearance.empty() || (dim_ > 0 && static_cast<int>(appearance.size()) != dim_)) return -1;
+    dim_ = static_cast<int>(appearance.size());
+    Identity id;
+    id.id = next_id_++;
+    id.tracks = 1;
+    id.appearance = PackedEmbedding(appearance, storage_);
+    identities_.push_back(std::move(id));
+    return identities_.back().id;
+}
+
+void IdentityGallery::update(int id, const EmbeddingF32& appearance) {
+    for (Identity& g : identities_) {
+        if (g.id != id) continue;
+        EmbeddingF32 mean = g.appearance.unpack();
+        if (mean.size() != appearance.size()) return;
+        const float w = static_cast<float>(std::max(1, g.tracks));
+        for (size_t k = 0; k < mean.size(); ++k) mean[k] = (mean[k] * w + appearance[k]) / (w + 1.0f);
+        L2Normalize(mean);
+        g.appearance = PackedEmbedding(mean, storage_);
+        g.tracks++;
+        return;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "embedding.hpp"
+
+/**
+ * Face identities remembered across runs (--gallery <file>).
+ *
+ * Each identity keeps one L2-normalized mean appearance, quantized to the
+ * gallery's EmbeddingStorage (Int8 by default: 132 bytes per identity for
+ * 128-D embeddings). All identities share one dimension, fixed by the
+ * file or by the first identity added.
+ * The pipeline matches every output track of a run against it and folds
+ * the track in, so the same person gets the same identity in every clip.
+ *
+ * The file is small and read whole; save() writes a temporary file and
+ * renames it over the old one.
+ */
+class IdentityGallery {
+public:
+    struct Identity {
+        int id = -1;
+        int tracks = 0;  // tracks folded into the appearance so far
+        PackedEmbedding appearance;
+    };
+
+    explicit IdentityGallery(EmbeddingStorage storage = EmbeddingStorage::Int8) : storage_(storage) {}
+
+    /**
+     * Replace the contents with `path`. A missing file is an empty gallery.
+     *
+     * @return false (with `error`) if the file exists but cannot be read
+     */
+    bool load(const std::string& path, std::string& error);
+
+    bool save(const std::string& path, std::string& error) const;
+
+    const std::vector<Identity>& identities() const { return identities_; }
+
+    /** Embedding dimension of the identities (0 while none is known). */
+    int dim() const { return dim_; }
+
+    /** Similarity of `appearance` to every identity, in identities() order. */
+    std::vector<float> similarities(const EmbeddingF32& appearance) const;
+
+    /**
+     * New identity seeded with `appearance`.
+     * @return Its id, or -1 if `appearance` does not have dim() entries
+     */
+    int add(const EmbeddingF32& appearance);
+
+    /** Fold `appearance` into identity `id` (running mean, re-normalized). */
+    void update(int id, const EmbeddingF32& appearance);
+
+private:
+    EmbeddingStorage storage_;
+    int dim_ = 0;
+    std::vector<Identity> identities_;
+    int next_id_ = 0;
+};
@@ -0,0 +1,750 @@
+#include "image_decoder.hpp"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "image_ops.hpp"
+#include "stb_image.h"
+#include "thread_pool.hpp"
+
+#ifdef FACE_PIPELINE_DECODE_JPEG
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+#ifdef FACE_PIPELINE_DECODE_PNG
+#include <png.h>
+#endif
+
+namespace {
+// Fill the luma plane from a decoded plane (`is_rgb` interleaved RGB or gray)
+// that is already `plane_scale`x smaller than the full-resolution frame.
+void FinishLuma(const uint8_t* px, int pw, int ph, bool is_rgb, int plane_scale,
+                const FrameRequest& req, LoadedRgbFrame& out) {
+    if (req.luma_downscale <= 0) return;
+    const int k = std::max(1, req.luma_downscale / std::max(1, plane_scale));
+    if (is_rgb) {
+        RgbToLumaDownsample(px, pw, ph, k, out.luma);
+    } else {
+        DownsampleLuma(px, pw, ph, k, out.luma);
+    }
+    out.luma_w = DownscaledSize(pw, k);
+    out.luma_h = DownscaledSize(ph, k);
+    out.luma_scale = req.luma_downscale;
+}
+
+class StbDecoder final : public ImageDecoder {
+public:
+    const char* name() const override { return "stb"; }
+    bool accepts(const uint8_t*, size_t) const override { return true; }
+
+    bool decode(const std::string& path, const uint8_t* data, size_t size, const FrameRequest& req,
+                LoadedRgbFrame& out) const override {
+        out.clear();
+        // Always decode RGB: stb materializes the source channels internally
+        // anyway, and deriving luma from RGB keeps it identical across backends.
+        int w = 0, h = 0, ch = 0;
+        unsigned char* px = data ? stbi_load_from_memory(data, static_cast<int>(size), &w, &h, &ch, 3)
+                                 : stbi_load(path.c_str(), &w, &h, &ch, 3);
+        if (!px || w <= 0 || h <= 0) {
+            if (px) stbi_image_free(px);
+            return false;
+        }
+        out.w = w;
+        out.h = h;
+        FinishLuma(px, w, h, true, 1, req, out);
+        if (req.rgb) {
+            // stb allocates its own buffer; adopt it instead of copying.
+            out.storage = std::shared_ptr<const void>(px, [](const void* p) {
+                stbi_image_free(const_cast<void*>(p));
+            });
+            out.rgb_view = px;
+            out.rgb_w = w;
+            out.rgb_h = h;
+        } else {
+            stbi_image_free(px);
+        }
+        return true;
+    }
+};
+
+// Decoder-owned scratch for planes that are reduced further before use.
+thread_local std::vector<uint8_t> g_gray_scratch;
+thread_local std::vector<uint8_t> g_row_scratch;
+
+#ifdef FACE_PIPELINE_DECODE_JPEG
+struct JpegError {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+};
+
+void JpegErrorExit(j_common_ptr cinfo) {
+    std::longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jump, 1);
+}
+
+void JpegSilent(j_common_ptr, int) {}
+
+// Largest DCT scale-down (1/1..1/8) whose RGB long side still satisfies the
+// request. The luma plane is point-sampled from the decoded plane, so the
+// scale must divide the luma downscale.
+int PickJpegScale(int w, int h, const FrameRequest& req) {
+    if (!req.rgb || req.rgb_min_long_side <= 0) return 1;
+    const int long_side = std::max(w, h);
+    for (int s = 8; s > 1; s /= 2) {
+        if (req.luma_downscale > 0 && req.luma_downscale % s != 0) continue;
+        if ((long_side + s - 1) / s < req.rgb_min_long_side) continue;
+        return s;
+    }
+    return 1;
+}
+
+#ifdef LIBJPEG_TURBO_VERSION
+// Full-resolution RGB of one rectangle: libjpeg-turbo decodes only the
+// iMCU columns it spans (jpeg_crop_scanline) and skips the rows above it
+// without the IDCT; rows below it are never read.
+bool DecodeJpegRegion(const std::string& path, int x, int y, int w, int h, std::vector<uint8_t>& rgb) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    jpeg_decompress_struct cinfo;
+    JpegError err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = JpegErrorExit;
+    err.pub.emit_message = JpegSilent;
+    // As in JpegDecoder::decode(): only `rgb` and thread_local scratch from here.
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        std::fclose(f);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, f);
+    jpeg_read_header(&cinfo, TRUE);
+    const bool inside = x >= 0 && y >= 0 && w > 0 && h > 0 && x + w <= static_cast<int>(cinfo.image_width) &&
+                        y + h <= static_cast<int>(cinfo.image_height);
+    if (!inside) {
+        jpeg_destroy_decompress(&cinfo);
+        std::fclose(f);
+        return false;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    JDIMENSION crop_x = static_cast<JDIMENSION>(x);
+    JDIMENSION crop_w = static_cast<JDIMENSION>(w);
+    jpeg_crop_scanline(&cinfo, &crop_x, &crop_w);  // widens to iMCU boundaries
+    if (y > 0) jpeg_skip_scanlines(&cinfo, static_cast<JDIMENSION>(y));
+
+    std::vector<uint8_t>& row_buf = g_row_scratch;
+    row_buf.resize(static_cast<size_t>(cinfo.output_width) * 3u);
+    const size_t skip = (static_cast<size_t>(x) - crop_x) * 3u;
+    const size_t row_bytes = static_cast<size_t>(w) * 3u;
+    rgb.resize(row_bytes * static_cast<size_t>(h));
+    for (int r = 0; r < h; ++r) {
+        JSAMPROW row = row_buf.data();
+        jpeg_read_scanlines(&cinfo, &row, 1);
+        std::memcpy(rgb.data() + static_cast<size_t>(r) * row_bytes, row_buf.data() + skip, row_bytes);
+    }
+    // The rows below are not needed: abort instead of finishing.
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    std::fclose(f);
+    return true;
+}
+#endif
+
+// Restart-marker-parallel decode (FrameRequest::decode_threads). Each RST
+// marker resets the Huffman and DC predictor state, so a scan whose restart
+// interval ends on MCU rows can be cut there into stand-alone JPEGs: the
+// original headers with the SOF height patched, then that stripe's entropy
+// segments with their markers renumbered from RST0. Every stripe is decoded
+// with one extra MCU row above and below (where the image has them) that is
+// then dropped, so fancy chroma upsampling sees the same neighbours as in
+// the sequential decode.
+struct JpegRestartLayout {
+    size_t sof_height_at = 0;  // offset of the SOF height field
+    size_t scan_begin = 0;     // first entropy-coded byte
+    int width = 0;
+    int height = 0;
+    int mcu_w = 8;
+    int mcu_h = 8;
+    int restart_interval = 0;  // MCUs per entropy segment
+    std::vector<std::pair<size_t, size_t>> segments;  // [begin, end) without the trailing marker
+};
+
+thread_local std::vector<uint8_t> g_file_scratch;
+thread_local std::vector<uint8_t> g_stripe_scratch;
+
+// False unless `d` is a single-scan baseline JPEG with a restart interval.
+bool ParseJpegRestartLayout(const uint8_t* d, size_t n, JpegRestartLayout& layout) {
+    if (n < 4 || d[0] != 0xFF || d[1] != 0xD8) return false;
+    size_t p = 2;
+    int components = 0;
+    for (;;) {
+        while (p + 1 < n && d[p] == 0xFF && d[p + 1] == 0xFF) ++p;  // fill bytes
+        if (p + 4 > n || d[p] != 0xFF) return false;
+        const uint8_t m = d[p + 1];
+        const size_t len = static_cast<size_t>(d[p + 2]) << 8 | d[p + 3];
+        if (len < 2 || p + 2 + len > n) return false;
+        const uint8_t* s = d + p + 4;
+        if (m == 0xC0 || m == 0xC1) {
+            if (len < 8) return false;
+            layout.sof_height_at = p + 5;
+            layout.height = s[1] << 8 | s[2];
+            layout.width = s[3] << 8 | s[4];
+            components = s[5];
+            if (components < 1 || len < 8 + 3 * static_cast<size_t>(components)) return false;
+            int h_max = 1, v_max = 1;
+            for (int c = 0; c < components; ++c) {
+                h_max = std::max(h_max, s[7 + 3 * c] >> 4);
+                v_max = std::max(v_max, s[7 + 3 * c] & 15);
+            }
+            // A single-component scan is not interleaved: one block per MCU.
+            layout.mcu_w = components > 1 ? 8 * h_max : 8;
+            layout.mcu_h = components > 1 ? 8 * v_max : 8;
+        } else if (m >= 0xC2 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC) {
+            return false;  // progressive, lossless or arithmetic-coded
+        } else if (m == 0xDD) {
+            if (len < 4) return false;
+            layout.restart_interval = s[0] << 8 | s[1];
+        } else if (m == 0xDA) {
+            if (components == 0 || s[0] != components) return false;
+            layout.scan_begin = p + 2 + len;
+            break;
+        } else if (m == 0xD9 || (m >= 0xD0 && m <= 0xD8)) {
+            return false;
+        }
+        p += 2 + len;
+    }
+    if (layout.restart_interval <= 0 || layout.width <= 0 || layout.height <= 0) return false;
+
+    layout.segments.clear();
+    size_t begin = layout.scan_begin;
+    for (size_t q = begin; q + 1 < n;) {
+        const void* ff = std::memchr(d + q, 0xFF, n - q - 1);
+        if (!ff) break;
+        q = static_cast<size_t>(static_cast<const uint8_t*>(ff) - d);
+        const uint8_t m = d[q + 1];
+        if (m == 0x00 || m == 0xFF) {  // stuffed byte, or fill before a marker
+            q += m == 0x00 ? 2 : 1;
+        } else if (m >= 0xD0 && m <= 0xD7) {
+            layout.segments.emplace_back(begin, q);
+            q += 2;
+            begin = q;
+        } else if (m == 0xD9) {
+            layout.segments.emplace_back(begin, q);
+            const long long mcus = static_cast<long long>((layout.width + layout.mcu_w - 1) / layout.mcu_w) *
+                                   ((layout.height + layout.mcu_h - 1) / layout.mcu_h);
+            return static_cast<long long>(layout.segments.size()) ==
+                   (mcus + layout.restart_interval - 1) / layout.restart_interval;
+        } else {
+            return false;  // DNL, a second scan, ...
+        }
+    }
+    return false;
+}
+
+// Decode the MCU rows [first, end) of `layout` as one stand-alone JPEG and
+// keep output rows [keep_begin, keep_end) of the full image in `plane`.
+bool DecodeJpegStripe(const uint8_t* d, const JpegRestartLayout& layout, int first, int end, int scale,
+                      J_COLOR_SPACE color, int keep_begin, int keep_end, int pw, uint8_t* plane, size_t row_bytes) {
+    const int mcus_x = (layout.width + layout.mcu_w - 1) / layout.mcu_w;
+    const size_t seg_first = static_cast<size_t>(first) * static_cast<size_t>(mcus_x) /
+                             static_cast<size_t>(layout.restart_interval);
+    const size_t seg_end = std::min(layout.segments.size(), (static_cast<size_t>(end) * static_cast<size_t>(mcus_x) +
+                                                             static_cast<size_t>(layout.restart_interval) - 1) /
+                                                                static_cast<size_t>(layout.restart_interval));
+    const int stripe_h = std::min(layout.height, end * layout.mcu_h) - first * layout.mcu_h;
+
+    std::vector<uint8_t>& buf = g_stripe_scratch;
+    buf.assign(d, d + layout.scan_begin);
+    buf[layout.sof_height_at] = static_cast<uint8_t>(stripe_h >> 8);
+    buf[layout.sof_height_at + 1] = static_cast<uint8_t>(stripe_h & 0xFF);
+    for (size_t k = seg_first; k < seg_end; ++k) {
+        if (k > seg_first) {
+            buf.push_back(0xFF);
+            buf.push_back(static_cast<uint8_t>(0xD0 + ((k - seg_first - 1) & 7)));
+        }
+        buf.insert(buf.end(), d + layout.segments[k].first, d + layout.segments[k].second);
+    }
+    buf.push_back(0xFF);
+    buf.push_back(0xD9);
+
+    jpeg_decompress_struct cinfo;
+    JpegError err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = JpegErrorExit;
+    err.pub.emit_message = JpegSilent;
+    // Only `plane` and thread_local scratch from here, as in decode().
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, buf.data(), static_cast<unsigned long>(buf.size()));
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = static_cast<unsigned int>(scale);
+    cinfo.out_color_space = color;
+    jpeg_start_decompress(&cinfo);
+    const int row0 = first * layout.mcu_h / scale;  // first row decoded, in full-image output rows
+    if (static_cast<int>(cinfo.output_width) != pw ||
+        static_cast<size_t>(pw) * static_cast<size_t>(cinfo.output_components) != row_bytes ||
+        row0 + static_cast<int>(cinfo.output_height) < keep_end) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    std::vector<uint8_t>& discard = g_row_scratch;
+    discard.resize(row_bytes);
+    while (static_cast<int>(cinfo.output_scanline) + row0 < keep_end) {
+        const int r = row0 + static_cast<int>(cinfo.output_scanline);
+        JSAMPROW row = r >= keep_begin ? plane + static_cast<size_t>(r) * row_bytes : discard.data();
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    // The margin rows below are not needed.
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+// Stripe-parallel decode into `plane`; false (and nothing decoded) where the
+// file has no usable restart markers.
+bool DecodeJpegStripes(const std::string& path, const uint8_t* data, size_t size, const FrameRequest& req,
+                       std::vector<uint8_t>& plane, LoadedRgbFrame& out, int& pw, int& ph, int& scale) {
+    if (!data) {
+        FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) return false;
+        std::vector<uint8_t>& file = g_file_scratch;
+        std::fseek(f, 0, SEEK_END);
+        const long bytes = std::ftell(f);
+        std::fseek(f, 0, SEEK_SET);
+        file.resize(bytes > 0 ? static_cast<size_t>(bytes) : 0);
+        const size_t got = file.empty() ? 0 : std::fread(file.data(), 1, file.size(), f);
+        std::fclose(f);
+        if (got != file.size() || file.empty()) return false;
+        data = file.data();
+        size = file.size();
+    }
+    JpegRestartLayout layout;
+    if (!ParseJpegRestartLayout(data, size, layout)) return false;
+
+    // Split points: MCU rows that start an entropy segment, nearest to an
+    // even split, with at least kMinStripeRows rows per stripe.
+    constexpr int kMinStripeRows = 4;
+    const int mcus_x = (layout.width + layout.mcu_w - 1) / layout.mcu_w;
+    const int mcus_y = (layout.height + layout.mcu_h - 1) / layout.mcu_h;
+    std::vector<int> aligned;  // rows that start a segment, then mcus_y
+    for (size_t k = 0; k < layout.segments.size(); ++k) {
+        const long long mcu = static_cast<long long>(k) * layout.restart_interval;
+        if (mcu % mcus_x == 0) aligned.push_back(static_cast<int>(mcu / mcus_x));
+    }
+    aligned.push_back(mcus_y);
+    const int stripes = std::min(req.decode_threads, mcus_y / kMinStripeRows);
+    std::vector<int> cuts = {0};
+    for (int i = 1; i < stripes; ++i) {
+        const int target = static_cast<int>(static_cast<long long>(i) * mcus_y / stripes);
+        auto it = std::lower_bound(aligned.begin(), aligned.end(), target);
+        if (it != aligned.begin() && (it == aligned.end() || target - *(it - 1) < *it - target)) --it;
+        if (it != aligned.end() && *it - cuts.back() >= kMinStripeRows && mcus_y - *it >= kMinStripeRows) {
+            cuts.push_back(*it);
+        }
+    }
+    if (cuts.size() < 2) return false;
+    cuts.push_back(mcus_y);
+
+    // Each stripe also decodes the nearest segment-aligned MCU row on either
+    // side. Sparse markers make those margins large; past a quarter more
+    // rows, the sequential decode is cheaper.
+    const int n = static_cast<int>(cuts.size()) - 1;
+    std::vector<std::pair<int, int>> ranges;
+    int decoded_rows = 0;
+    for (int i = 0; i < n; ++i) {
+        auto lo = std::lower_bound(aligned.begin(), aligned.end(), cuts[static_cast<size_t>(i)]);
+        auto hi = std::lower_bound(aligned.begin(), aligned.end(), cuts[static_cast<size_t>(i) + 1]);
+        ranges.emplace_back(lo == aligned.begin() ? 0 : *(lo - 1), hi + 1 < aligned.end() ? *(hi + 1) : mcus_y);
+        decoded_rows += ranges.back().second - ranges.back().first;
+    }
+    if (decoded_rows * 4 > mcus_y * 5) return false;
+
+    out.w = layout.width;
+    out.h = layout.height;
+    scale = PickJpegScale(out.w, out.h, req);
+    pw = (layout.width + scale - 1) / scale;
+    ph = (layout.height + scale - 1) / scale;
+    const size_t row_bytes = static_cast<size_t>(pw) * (req.rgb ? 3u : 1u);
+    plane.resize(row_bytes * static_cast<size_t>(ph));
+    std::vector<char> ok(static_cast<size_t>(n), 0);
+    ThreadPool::Shared().parallelFor(n, n, [&](int i) {
+        const int first = ranges[static_cast<size_t>(i)].first;
+        const int end = ranges[static_cast<size_t>(i)].second;
+        const int keep_begin = cuts[static_cast<size_t>(i)] * layout.mcu_h / scale;
+        const int keep_end = std::min(ph, cuts[static_cast<size_t>(i) + 1] * layout.mcu_h / scale);
+        ok[static_cast<size_t>(i)] = DecodeJpegStripe(data, layout, first, end, scale,
+                                                      req.rgb ? JCS_RGB : JCS_GRAYSCALE, keep_begin, keep_end, pw,
+                                                      plane.data(), row_bytes);
+    });
+    return std::all_of(ok.begin(), ok.end(), [](char v) { return v != 0; });
+}
+
+class JpegDecoder final : public ImageDecoder {
+public:
+    const char* name() const override { return "libjpeg-turbo"; }
+    bool accepts(const uint8_t* head, size_t n) const override {
+        return n >= 3 && head[0] == 0xFF && head[1] == 0xD8 && head[2] == 0xFF;
+    }
+
+    bool decode(const std::string& path, const uint8_t* data, size_t size, const FrameRequest& req,
+                LoadedRgbFrame& out) const override {
+        out.clear();
+        std::vector<uint8_t>& plane = req.rgb ? out.rgb : g_gray_scratch;
+        int pw = 0, ph = 0, scale = 1;
+        if (req.decode_threads > 1 && DecodeJpegStripes(path, data, size, req, plane, out, pw, ph, scale)) {
+            finish(path, plane, pw, ph, scale, req, out);
+            return true;
+        }
+        FILE* f = data ? nullptr : std::fopen(path.c_str(), "rb");
+        if (!data && !f) return false;
+
+        jpeg_decompress_struct cinfo;
+        JpegError err;
+        cinfo.err = jpeg_std_error(&err.pub);
+        err.pub.error_exit = JpegErrorExit;
+        err.pub.emit_message = JpegSilent;
+        // Only non-local state (`out`, thread_local scratch) is touched after
+        // this point, so it stays well defined across longjmp.
+        if (setjmp(err.jump)) {
+            jpeg_destroy_decompress(&cinfo);
+            if (f) std::fclose(f);
+            out.clear();
+            return false;
+        }
+        jpeg_create_decompress(&cinfo);
+        if (data) {
+            jpeg_mem_src(&cinfo, data, static_cast<unsigned long>(size));
+        } else {
+            jpeg_stdio_src(&cinfo, f);
+        }
+        jpeg_read_header(&cinfo, TRUE);
+
+        out.w = static_cast<int>(cinfo.image_width);
+        out.h = static_cast<int>(cinfo.image_height);
+        scale = PickJpegScale(out.w, out.h, req);
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = static_cast<unsigned int>(scale);
+        // GMC-only frames decode just the Y channel, which skips chroma
+        // upsampling and colour conversion entirely.
+        cinfo.out_color_space = req.rgb ? JCS_RGB : JCS_GRAYSCALE;
+        jpeg_start_decompress(&cinfo);
+
+        pw = static_cast<int>(cinfo.output_width);
+        ph = static_cast<int>(cinfo.output_height);
+        const size_t row_bytes = static_cast<size_t>(pw) * static_cast<size_t>(cinfo.output_components);
+        plane.resize(row_bytes * static_cast<size_t>(ph));
+        while (cinfo.output_scanline < cinfo.output_height) {
+            JSAMPROW row = plane.data() + static_cast<size_t>(cinfo.output_scanline) * row_bytes;
+            jpeg_read_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_decompress(&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+        if (f) std::fclose(f);
+
+        finish(path, plane, pw, ph, scale, req, out);
+        return true;
+    }
+
+private:
+    // Luma and RGB geometry from the decoded `pw` x `ph` plane.
+    static void finish(const std::string& path, const std::vector<uint8_t>& plane, int pw, int ph, int scale,
+                       const FrameRequest& req, LoadedRgbFrame& out) {
+        FinishLuma(plane.data(), pw, ph, req.rgb, scale, req, out);
+        if (req.rgb) {
+            out.rgb_w = pw;
+            out.rgb_h = ph;
+#ifdef LIBJPEG_TURBO_VERSION
+            if (scale > 1) {
+                out.read_full_res = [path](int x, int y, int w, int h, std::vector<uint8_t>& rgb) {
+                    return DecodeJpegRegion(path, x, y, w, h, rgb);
+                };
+            }
+#endif
+        }
+    }
+};
+#endif
+
+#ifdef FACE_PIPELINE_DECODE_PNG
+void PngSilentWarning(png_structp, png_const_charp) {}
+
+// Read cursor over a file already in memory.
+struct PngMemory {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+};
+
+void PngReadMemory(png_structp png, png_bytep out, png_size_t n) {
+    auto* mem = static_cast<PngMemory*>(png_get_io_ptr(png));
+    if (n > mem->size - mem->pos) png_error(png, "truncated");
+    std::memcpy(out, mem->data + mem->pos, n);
+    mem->pos += n;
+}
+
+// Normalize rows to 8-bit RGB, alpha dropped (same as stb with 3 channels).
+// Returns the interlace passes.
+int SetPngRgb(png_structp png, png_infop info) {
+    const int color = png_get_color_type(png, info);
+    png_set_expand(png);
+    png_set_strip_16(png);
+    png_set_strip_alpha(png);
+    if ((color & PNG_COLOR_MASK_COLOR) == 0) png_set_gray_to_rgb(png);
+    const int passes = png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+    return passes;
+}
+
+// Full-resolution RGB of one rectangle of a non-interlaced PNG: rows are
+// inflated up to its bottom edge, one at a time, and only its columns kept.
+bool DecodePngRegion(const std::string& path, int x, int y, int w, int h, std::vector<uint8_t>& rgb) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, PngSilentWarning);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!png || !info) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        std::fclose(f);
+        return false;
+    }
+    // Only `rgb` and thread_local scratch from here, as in PngDecoder::decode().
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        std::fclose(f);
+        return false;
+    }
+    png_init_io(png, f);
+    png_read_info(png, info);
+    const int iw = static_cast<int>(png_get_image_width(png, info));
+    const int ih = static_cast<int>(png_get_image_height(png, info));
+    const bool inside = x >= 0 && y >= 0 && w > 0 && h > 0 && x + w <= iw && y + h <= ih;
+    const size_t image_row = static_cast<size_t>(iw) * 3u;
+    if (!inside || SetPngRgb(png, info) != 1 || png_get_rowbytes(png, info) != image_row) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        std::fclose(f);
+        return false;
+    }
+    std::vector<uint8_t>& row_buf = g_row_scratch;
+    row_buf.resize(image_row);
+    const size_t row_bytes = static_cast<size_t>(w) * 3u;
+    rgb.resize(row_bytes * static_cast<size_t>(h));
+    for (int r = 0; r < y + h; ++r) {
+        png_read_row(png, row_buf.data(), nullptr);
+        if (r >= y) {
+            std::memcpy(rgb.data() + static_cast<size_t>(r - y) * row_bytes,
+                        row_buf.data() + static_cast<size_t>(x) * 3u, row_bytes);
+        }
+    }
+    // The rows below are not needed.
+    png_destroy_read_struct(&png, &info, nullptr);
+    std::fclose(f);
+    return true;
+}
+
+class PngDecoder final : public ImageDecoder {
+public:
+    const char* name() const override { return "libpng"; }
+    bool accepts(const uint8_t* head, size_t n) const override {
+        return n >= 8 && png_sig_cmp(head, 0, 8) == 0;
+    }
+
+    bool decode(const std::string& path, const uint8_t* data, size_t size, const FrameRequest& req,
+                LoadedRgbFrame& out) const override {
+        out.clear();
+        FILE* f = data ? nullptr : std::fopen(path.c_str(), "rb");
+        if (!data && !f) return false;
+        PngMemory mem{data, size, 0};
+
+        png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, PngSilentWarning);
+        png_infop info = png ? png_create_info_struct(png) : nullptr;
+        if (!png || !info) {
+            png_destroy_read_struct(&png, &info, nullptr);
+            if (f) std::fclose(f);
+            return false;
+        }
+        if (setjmp(png_jmpbuf(png))) {
+            png_destroy_read_struct(&png, &info, nullptr);
+            if (f) std::fclose(f);
+            out.clear();
+            return false;
+        }
+        if (data) {
+            png_set_read_fn(png, &mem, PngReadMemory);
+        } else {
+            png_init_io(png, f);
+        }
+        png_read_info(png, info);
+
+        out.w = static_cast<int>(png_get_image_width(png, info));
+        out.h = static_cast<int>(png_get_image_height(png, info));
+        const int passes = SetPngRgb(png, info);
+
+        const size_t row_bytes = static_cast<size_t>(out.w) * 3u;
+        if (png_get_rowbytes(png, info) != row_bytes) {
+            png_destroy_read_struct(&png, &info, nullptr);
+            if (f) std::fclose(f);
+            out.clear();
+            return false;
+        }
+
+        const int reduce = req.rgb ? RgbReduction(out.w, out.h, req.rgb_min_long_side) : 1;
+        if (passes == 1 && (req.rgb ? reduce > 1 : req.luma_downscale > 0)) {
+            streamRows(png, req, reduce, out);
+            if (req.rgb) {
+                out.read_full_res = [path](int x, int y, int w, int h, std::vector<uint8_t>& rgb) {
+                    return DecodePngRegion(path, x, y, w, h, rgb);
+                };
+            }
+        } else {
+            std::vector<uint8_t>& plane = req.rgb ? out.rgb : g_gray_scratch;
+            plane.resize(row_bytes * static_cast<size_t>(out.h));
+            for (int pass = 0; pass < passes; ++pass) {
+                for (int y = 0; y < out.h; ++y) {
+                    png_read_row(png, plane.data() + static_cast<size_t>(y) * row_bytes, nullptr);
+                }
+            }
+            FinishLuma(plane.data(), out.w, out.h, true, 1, req, out);
+            if (req.rgb) {
+                out.rgb_w = out.w;
+                out.rgb_h = out.h;
+            }
+        }
+        png_read_end(png, nullptr);
+        png_destroy_read_struct(&png, &info, nullptr);
+        if (f) std::fclose(f);
+        return true;
+    }
+
+private:
+    // Non-interlaced rows one at a time into the planes `req` asks for, so
+    // the full-resolution frame is never held: the luma plane takes the rows
+    // GmcLumaTaps() names (as FinishLuma() would), and the RGB plane
+    // is box-reduced by `reduce` (as Nv12ToRgbReduced() reduces video).
+    static void streamRows(png_structp png, const FrameRequest& req, int reduce, LoadedRgbFrame& out) {
+        const int w = out.w;
+        const int h = out.h;
+        const int k = std::max(1, req.luma_downscale);
+        const int lw = DownscaledSize(w, k);
+        const int lh = DownscaledSize(h, k);
+        if (req.luma_downscale > 0) out.luma.resize(static_cast<size_t>(lw) * static_cast<size_t>(lh));
+        const int ow = (w + reduce - 1) / reduce;
+        const int oh = (h + reduce - 1) / reduce;
+        thread_local std::vector<uint32_t> sums;
+        if (req.rgb) {
+            out.rgb.resize(static_cast<size_t>(ow) * static_cast<size_t>(oh) * 3u);
+            sums.assign(static_cast<size_t>(ow) * 3u, 0u);
+        }
+        std::vector<uint8_t>& row = g_row_scratch;
+        row.resize(static_cast<size_t>(w) * 3u);
+        int offset = 0;
+        const int taps = GmcLumaTaps(k, offset);
+        thread_local std::vector<uint8_t> first_tap;  // the luma row's first source row, with two taps
+        for (int y = 0; y < h; ++y) {
+            png_read_row(png, row.data(), nullptr);
+            // An output row's last tap row; past the plane's last one, rows only feed RGB.
+            const int oy = (y - offset - (taps - 1)) / k;
+            const bool last_tap = y >= offset + taps - 1 && (y - offset - (taps - 1)) % k == 0;
+            if (req.luma_downscale > 0 && taps == 2 && y >= offset && (y - offset) % k == 0 && (y - offset) / k < lh) {
+                first_tap.assign(row.begin(), row.end());
+            }
+            if (req.luma_downscale > 0 && last_tap && oy < lh) {
+                RgbRowsToLumaRow(taps == 2 ? first_tap.data() : row.data(), row.data(), w, k,
+                                 out.luma.data() + static_cast<std::ptrdiff_t>(oy) * lw);
+            }
+            if (!req.rgb) continue;
+            const uint8_t* px = row.data();
+            for (int ox = 0; ox < ow; ++ox) {
+                uint32_t* s = sums.data() + static_cast<size_t>(ox) * 3u;
+                const int x1 = std::min(w, (ox + 1) * reduce);
+                for (int x = ox * reduce; x < x1; ++x, px += 3) {
+                    s[0] += px[0];
+                    s[1] += px[1];
+                    s[2] += px[2];
+                }
+            }
+            if (y % reduce != reduce - 1 && y != h - 1) continue;
+            const int rows = y % reduce + 1;
+            uint8_t* dst = out.rgb.data() + static_cast<size_t>(y / reduce) * static_cast<size_t>(ow) * 3u;
+            for (int ox = 0; ox < ow; ++ox) {
+                const uint32_t n = static_cast<uint32_t>((std::min(w, (ox + 1) * reduce) - ox * reduce) * rows);
+                uint32_t* s = sums.data() + static_cast<size_t>(ox) * 3u;
+                for (int c = 0; c < 3; ++c) {
+                    dst[ox * 3 + c] = static_cast<uint8_t>((s[c] + n / 2) / n);
+                    s[c] = 0;
+                }
+            }
+        }
+        if (req.luma_downscale > 0) {
+            out.luma_w = lw;
+            out.luma_h = lh;
+            out.luma_scale = req.luma_downscale;
+        }
+        if (req.rgb) {
+            out.rgb_w = ow;
+            out.rgb_h = oh;
+        }
+    }
+};
+#endif
+}  // namespace
+
+const std::vector<const ImageDecoder*>& ImageDecoders() {
+    static const std::vector<const ImageDecoder*> decoders = [] {
+        static const StbDecoder stb;
+        std::vector<const ImageDecoder*> list;
+        const char* force = std::getenv("FACE_PIPELINE_DECODER");
+        const bool stb_only = force && std::strcmp(force, "stb") == 0;
+        if (!stb_only) {
+#ifdef FACE_PIPELINE_DECODE_JPEG
+            static const JpegDecoder jpeg;
+            list.push_back(&jpeg);
+#endif
+#ifdef FACE_PIPELINE_DECODE_PNG
+            static const PngDecoder png;
+            list.push_back(&png);
+#endif
+        }
+        list.push_back(&stb);
+        return list;
+    }();
+    return decoders;
+}
+
+bool DecodeImageFile(const std::string& path, const FrameRequest& req, LoadedRgbFrame& out) {
+    uint8_t head[8] = {0};
+    size_t n = 0;
+    if (FILE* f = std::fopen(path.c_str(), "rb")) {
+        n = std::fread(head, 1, sizeof(head), f);
+        std::fclose(f);
+    }
+    if (n == 0) {
+        out.clear();
+        return false;
+    }
+    for (const ImageDecoder* d : ImageDecoders()) {
+        if (d->accepts(head, n)) return d->decode(path, nullptr, 0, req, out);
+    }
+    return false;
+}
+
+bool DecodeImageBuffer(const std::string& path, const uint8_t* data, size_t size, const FrameRequest& req,
+                       LoadedRgbFrame& out) {
+    if (!data || size == 0) {
+        out.clear();
+        return false;
+    }
+    for (const ImageDecoder* d : ImageDecoders()) {
+        if (d->accepts(data, size)) return d->decode(path, data, size, req, out);
+    }
+    return false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_cache.hpp"
+
+/**
+ * Still-image decoder backend.
+ *
+ * Backends are picked per file by sniffing its leading bytes. stb_image is
+ * always available as the catch-all; libjpeg-turbo and libpng backends are
+ * compiled in when found (FACE_PIPELINE_DECODE_JPEG / FACE_PIPELINE_DECODE_PNG).
+ *
+ * A backend must honour FrameRequest: produce RGB only if `req.rgb`, a luma
+ * plane if `req.luma_downscale > 0`, and may reduce the RGB plane (rgb_w x
+ * rgb_h) as long as its long side stays >= `req.rgb_min_long_side`.
+ * libjpeg-turbo reduces in the DCT. libpng streams non-interlaced rows
+ * into the reduced RGB (a box filter) and the luma plane as they inflate,
+ * so an 8K frame is never held at full resolution; both read full
+ * resolution regions back through `read_full_res`.
+ *
+ * `req.decode_threads` > 1 lets a backend split one image across threads.
+ * Only libjpeg-turbo does, for baseline JPEGs written with a restart
+ * interval that ends on MCU rows (e.g. cjpeg -restart 1): the scan is cut
+ * at its RST markers into row stripes decoded concurrently, byte-identical
+ * to the sequential decode. Anything else decodes on the calling thread.
+ */
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() = default;
+
+    virtual const char* name() const = 0;
+
+    /**
+     * True if this backend handles a file starting with `head`.
+     */
+    virtual bool accepts(const uint8_t* head, size_t n) const = 0;
+
+    /**
+     * Decode `path`, or the `size` bytes at `data` when not null (the file
+     * read ahead, see read_ahead.hpp). `path` names the file either way.
+     */
+    virtual bool decode(const std::string& path, const uint8_t* data, size_t size, const FrameRequest& req,
+                        LoadedRgbFrame& out) const = 0;
+};
+
+/**
+ * Registered backends in priority order (catch-all last).
+ *
+ * FACE_PIPELINE_DECODER=stb forces the stb backend for A/B comparisons.
+ */
+const std::vector<const ImageDecoder*>& ImageDecoders();
+
+/**
+ * Decode an image file with the first backend that accepts it.
+ *
+ * @return false if the file could not be read or decoded
+ */
+bool DecodeImageFile(const std::string& path, const FrameRequest& req, LoadedRgbFrame& out);
+
+/**
+ * Decode the `size` bytes of image file `path` already in memory at `data`.
+ *
+ * @return false if the bytes could not be decoded
+ */
+bool DecodeImageBuffer(const std::string& path, const uint8_t* data, size_t size, const FrameRequest& req,
+                       LoadedRgbFrame& out);
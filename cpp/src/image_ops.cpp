@@ -0,0 +1,456 @@
+#include "image_ops.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#ifdef FACE_PIPELINE_ACCELERATE
+#include <Accelerate/Accelerate.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+inline uint32_t luma_u8(uint32_t r, uint32_t g, uint32_t b) {
+    // Integer approx of BT.601: 0.299 R + 0.587 G + 0.114 B
+    return (77u * r + 150u * g + 29u * b + 128u) >> 8;
+}
+
+inline uint8_t clamp_u8(int v) {
+    return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// ncnn's bilinear filter works in 11-bit fixed point.
+constexpr int kResizeCoefBits = 11;
+constexpr int kResizeCoefScale = 1 << kResizeCoefBits;
+
+inline int16_t saturate_short(float x) {
+    const int v = static_cast<int>(x + (x >= 0.f ? 0.5f : -0.5f));
+    return static_cast<int16_t>(std::min(std::max(v, SHRT_MIN), SHRT_MAX));
+}
+
+// Source taps and weights for each output position along one axis, computed
+// exactly like ncnn's resize_bilinear (half-pixel centers, edge clamping).
+void BilinearTaps(int src, int dst, std::vector<int>& ofs0, std::vector<int>& ofs1, std::vector<int16_t>& coef) {
+    const double scale = static_cast<double>(src) / dst;
+    ofs0.resize(static_cast<size_t>(dst));
+    ofs1.resize(static_cast<size_t>(dst));
+    coef.resize(static_cast<size_t>(dst) * 2u);
+    for (int d = 0; d < dst; ++d) {
+        float f = static_cast<float>((d + 0.5) * scale - 0.5);
+        int s = static_cast<int>(std::floor(f));
+        f -= static_cast<float>(s);
+        if (s < 0) {
+            s = 0;
+            f = 0.f;
+        }
+        if (s >= src - 1) {
+            s = std::max(0, src - 2);
+            f = 1.f;
+        }
+        ofs0[static_cast<size_t>(d)] = s;
+        ofs1[static_cast<size_t>(d)] = std::min(s + 1, src - 1);
+        coef[static_cast<size_t>(d) * 2u] = saturate_short((1.f - f) * kResizeCoefScale);
+        coef[static_cast<size_t>(d) * 2u + 1u] = saturate_short(f * kResizeCoefScale);
+    }
+}
+
+// Horizontal pass of `Rows` source rows, each into three planar rows of
+// `dst_w`. Doing both vertical taps in one loop shares the tap lookups.
+template <int Rows>
+void HResizeRgbRows(const uint8_t* const* src, int dst_w, const int* xofs0, const int* xofs1,
+                    const int16_t* alpha, int16_t* const* out) {
+    for (int dx = 0; dx < dst_w; ++dx) {
+        const int o0 = xofs0[dx] * 3;
+        const int o1 = xofs1[dx] * 3;
+        const int a0 = alpha[dx * 2];
+        const int a1 = alpha[dx * 2 + 1];
+        for (int k = 0; k < Rows; ++k) {
+            const uint8_t* p0 = src[k] + o0;
+            const uint8_t* p1 = src[k] + o1;
+            out[k][dx] = static_cast<int16_t>((p0[0] * a0 + p1[0] * a1) >> 4);
+            out[k][dx + dst_w] = static_cast<int16_t>((p0[1] * a0 + p1[1] * a1) >> 4);
+            out[k][dx + 2 * dst_w] = static_cast<int16_t>((p0[2] * a0 + p1[2] * a1) >> 4);
+        }
+    }
+}
+
+// Vertical pass of one plane row, straight to normalized float.
+void VResizeNormalizeRow(const int16_t* rows0, const int16_t* rows1, int n, int16_t b0, int16_t b1,
+                         float norm, float bias, float* out) {
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i vb0 = _mm_set1_epi16(b0);
+    const __m128i vb1 = _mm_set1_epi16(b1);
+    const __m128i v2 = _mm_set1_epi16(2);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vnorm = _mm_set1_ps(norm);
+    const __m128 vbias = _mm_set1_ps(bias);
+    for (; x + 7 < n; x += 8) {
+        const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows0 + x));
+        const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows1 + x));
+        __m128i acc = _mm_add_epi16(_mm_mulhi_epi16(r0, vb0), _mm_mulhi_epi16(r1, vb1));
+        acc = _mm_srai_epi16(_mm_add_epi16(acc, v2), 2);
+        // Values are 0..255 here, so zero-extending is exact.
+        const __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(acc, zero));
+        const __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(acc, zero));
+        _mm_storeu_ps(out + x, _mm_add_ps(_mm_mul_ps(lo, vnorm), vbias));
+        _mm_storeu_ps(out + x + 4, _mm_add_ps(_mm_mul_ps(hi, vnorm), vbias));
+    }
+#elif defined(__ARM_NEON)
+    const int16x4_t vb0 = vdup_n_s16(b0);
+    const int16x4_t vb1 = vdup_n_s16(b1);
+    const int32x4_t v2 = vdupq_n_s32(2);
+    const float32x4_t vnorm = vdupq_n_f32(norm);
+    const float32x4_t vbias = vdupq_n_f32(bias);
+    for (; x + 3 < n; x += 4) {
+        const int16x4_t r0 = vld1_s16(rows0 + x);
+        const int16x4_t r1 = vld1_s16(rows1 + x);
+        int32x4_t acc = vaddq_s32(vshrq_n_s32(vmull_s16(r0, vb0), 16), vshrq_n_s32(vmull_s16(r1, vb1), 16));
+        acc = vshrq_n_s32(vaddq_s32(acc, v2), 2);
+        vst1q_f32(out + x, vaddq_f32(vmulq_f32(vcvtq_f32_s32(acc), vnorm), vbias));
+    }
+#endif
+    for (; x < n; ++x) {
+        const int v = (static_cast<int16_t>((b0 * rows0[x]) >> 16) + static_cast<int16_t>((b1 * rows1[x]) >> 16) + 2) >> 2;
+        out[x] = static_cast<float>(v) * norm + bias;
+    }
+}
+
+// One output row of a reduction of packed pixels of `Bpp` bytes (R/G/B at
+// the given offsets) from its source rows, `taps` x `taps` pixels each.
+template <int Bpp, int R, int G, int B>
+void PackedRowsToLuma(const uint8_t* row0, const uint8_t* row1, int w, int down, int offset, int taps,
+                      uint8_t* dst) {
+    const int ow = DownscaledSize(w, down);
+    for (int ox = 0; ox < ow; ++ox) {
+        const int x0 = std::min(ox * down + offset, w - 1);
+        const uint8_t* q = row0 + static_cast<size_t>(x0) * Bpp;
+        if (taps == 1) {
+            dst[ox] = static_cast<uint8_t>(luma_u8(q[R], q[G], q[B]));
+            continue;
+        }
+        const size_t dx = static_cast<size_t>(std::min(x0 + 1, w - 1) - x0) * Bpp;
+        const uint8_t* r = row1 + static_cast<size_t>(x0) * Bpp;
+        auto mean = [&](int c) { return (static_cast<uint32_t>(q[c]) + q[c + dx] + r[c] + r[c + dx] + 2u) >> 2; };
+        dst[ox] = static_cast<uint8_t>(luma_u8(mean(R), mean(G), mean(B)));
+    }
+}
+
+template <int Bpp, int R, int G, int B>
+void PackedToLumaDownsample(const uint8_t* px, int w, int h, int down, std::vector<uint8_t>& out) {
+    down = std::max(1, down);
+    const int ow = DownscaledSize(w, down);
+    const int oh = DownscaledSize(h, down);
+    out.resize(static_cast<size_t>(ow) * static_cast<size_t>(oh));
+    if (!px || w <= 0 || h <= 0) return;
+
+    int offset = 0;
+    const int taps = GmcLumaTaps(down, offset);
+    const size_t pitch = static_cast<size_t>(w) * Bpp;
+    for (int oy = 0; oy < oh; ++oy) {
+        const int y0 = std::min(oy * down + offset, h - 1);
+        const int y1 = std::min(y0 + taps - 1, h - 1);
+        PackedRowsToLuma<Bpp, R, G, B>(px + static_cast<size_t>(y0) * pitch, px + static_cast<size_t>(y1) * pitch, w,
+                                       down, offset, taps, out.data() + static_cast<size_t>(oy) * ow);
+    }
+}
+}  // namespace
+
+LumaFilter GmcLumaFilter() {
+#ifdef FACE_PIPELINE_GMC_OPENCV
+    return LumaFilter::Linear;
+#else
+    return LumaFilter::Point;
+#endif
+}
+
+int GmcLumaTaps(int down, int& offset) {
+    down = std::max(1, down);
+    if (GmcLumaFilter() == LumaFilter::Point) {
+        offset = 0;
+        return 1;
+    }
+    // INTER_LINEAR samples at (o + 0.5) * down - 0.5.
+    offset = (down - 1) / 2;
+    return down % 2 == 0 ? 2 : 1;
+}
+
+void DownsampleLuma(const uint8_t* luma, int w, int h, int down, std::vector<uint8_t>& out) {
+    down = std::max(1, down);
+    const int ow = DownscaledSize(w, down);
+    const int oh = DownscaledSize(h, down);
+    out.resize(static_cast<size_t>(ow) * static_cast<size_t>(oh));
+    if (!luma || w <= 0 || h <= 0) return;
+
+    int offset = 0;
+    const int taps = GmcLumaTaps(down, offset);
+    for (int oy = 0; oy < oh; ++oy) {
+        const int y0 = std::min(oy * down + offset, h - 1);
+        const uint8_t* row = luma + static_cast<size_t>(y0) * static_cast<size_t>(w);
+        uint8_t* dst = out.data() + static_cast<size_t>(oy) * static_cast<size_t>(ow);
+        if (down == 1) {
+            std::copy(row, row + ow, dst);
+            continue;
+        }
+        if (taps == 1) {
+            for (int ox = 0; ox < ow; ++ox) dst[ox] = row[std::min(ox * down + offset, w - 1)];
+            continue;
+        }
+        const uint8_t* next = luma + static_cast<size_t>(std::min(y0 + 1, h - 1)) * static_cast<size_t>(w);
+        for (int ox = 0; ox < ow; ++ox) {
+            const int x0 = std::min(ox * down + offset, w - 1);
+            const int x1 = std::min(x0 + 1, w - 1);
+            dst[ox] = static_cast<uint8_t>((static_cast<uint32_t>(row[x0]) + row[x1] + next[x0] + next[x1] + 2u) >> 2);
+        }
+    }
+}
+
+void RgbToLumaDownsample(const uint8_t* rgb, int w, int h, int down, std::vector<uint8_t>& out) {
+    PackedToLumaDownsample<3, 0, 1, 2>(rgb, w, h, down, out);
+}
+
+void RgbRowsToLumaRow(const uint8_t* row0, const uint8_t* row1, int w, int down, uint8_t* out) {
+    down = std::max(1, down);
+    int offset = 0;
+    const int taps = GmcLumaTaps(down, offset);
+    PackedRowsToLuma<3, 0, 1, 2>(row0, row1, w, down, offset, taps, out);
+}
+
+void BgraToLumaDownsample(const uint8_t* bgra, int w, int h, int down, std::vector<uint8_t>& out) {
+    PackedToLumaDownsample<4, 2, 1, 0>(bgra, w, h, down, out);
+}
+
+void BgraToRgb(const uint8_t* bgra, int w, int h, std::vector<uint8_t>& out) {
+    const size_t n = static_cast<size_t>(std::max(0, w)) * static_cast<size_t>(std::max(0, h));
+    out.resize(n * 3u);
+    if (!bgra) return;
+#ifdef FACE_PIPELINE_ACCELERATE
+    // A byte shuffle either way, so vImage's result is the same.
+    vImage_Buffer src{const_cast<uint8_t*>(bgra), static_cast<vImagePixelCount>(h), static_cast<vImagePixelCount>(w),
+                      static_cast<size_t>(w) * 4u};
+    vImage_Buffer dst{out.data(), static_cast<vImagePixelCount>(h), static_cast<vImagePixelCount>(w),
+                      static_cast<size_t>(w) * 3u};
+    if (n > 0 && vImageConvert_BGRA8888toRGB888(&src, &dst, kvImageNoFlags) == kvImageNoError) return;
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        out[i * 3u + 0] = bgra[i * 4u + 2];
+        out[i * 3u + 1] = bgra[i * 4u + 1];
+        out[i * 3u + 2] = bgra[i * 4u + 0];
+    }
+}
+
+void ShrinkRgb(const uint8_t* src, int sw, int sh, int dw, int dh, std::vector<uint8_t>& dst) {
+    dst.resize(static_cast<size_t>(dw) * dh * 3);
+#ifdef FACE_PIPELINE_ACCELERATE
+    // vImage scales 4-channel pixels only: widen to ARGB (the channel order
+    // does not matter to the filter), scale, and narrow again.
+    thread_local std::vector<uint8_t> wide_src, wide_dst;
+    wide_src.resize(static_cast<size_t>(sw) * sh * 4);
+    wide_dst.resize(static_cast<size_t>(dw) * dh * 4);
+    vImage_Buffer rgb_in{const_cast<uint8_t*>(src), static_cast<vImagePixelCount>(sh), static_cast<vImagePixelCount>(sw),
+                         static_cast<size_t>(sw) * 3};
+    vImage_Buffer argb_in{wide_src.data(), static_cast<vImagePixelCount>(sh), static_cast<vImagePixelCount>(sw),
+                          static_cast<size_t>(sw) * 4};
+    vImage_Buffer argb_out{wide_dst.data(), static_cast<vImagePixelCount>(dh), static_cast<vImagePixelCount>(dw),
+                           static_cast<size_t>(dw) * 4};
+    vImage_Buffer rgb_out{dst.data(), static_cast<vImagePixelCount>(dh), static_cast<vImagePixelCount>(dw),
+                          static_cast<size_t>(dw) * 3};
+    if (vImageConvert_RGB888toARGB8888(&rgb_in, nullptr, 255, &argb_in, false, kvImageNoFlags) == kvImageNoError &&
+        vImageScale_ARGB8888(&argb_in, &argb_out, nullptr, kvImageNoFlags) == kvImageNoError &&
+        vImageConvert_ARGB8888toRGB888(&argb_out, &rgb_out, kvImageNoFlags) == kvImageNoError) {
+        return;
+    }
+#endif
+    std::vector<int> x0(static_cast<size_t>(dw) + 1);
+    for (int x = 0; x <= dw; ++x) x0[x] = static_cast<int>(static_cast<int64_t>(x) * sw / dw);
+    std::vector<uint32_t> row(static_cast<size_t>(dw) * 3);
+    for (int y = 0; y < dh; ++y) {
+        const int y_begin = static_cast<int>(static_cast<int64_t>(y) * sh / dh);
+        const int y_end = std::max(y_begin + 1, static_cast<int>(static_cast<int64_t>(y + 1) * sh / dh));
+        std::fill(row.begin(), row.end(), 0u);
+        for (int sy = y_begin; sy < y_end; ++sy) {
+            const uint8_t* line = src + static_cast<size_t>(sy) * sw * 3;
+            for (int x = 0; x < dw; ++x) {
+                const int x_end = std::max(x0[x] + 1, x0[x + 1]);
+                uint32_t r = 0, g = 0, b = 0;
+                for (int sx = x0[x]; sx < x_end; ++sx) {
+                    r += line[sx * 3];
+                    g += line[sx * 3 + 1];
+                    b += line[sx * 3 + 2];
+                }
+                row[x * 3] += r;
+                row[x * 3 + 1] += g;
+                row[x * 3 + 2] += b;
+            }
+        }
+        uint8_t* out = dst.data() + static_cast<size_t>(y) * dw * 3;
+        for (int x = 0; x < dw; ++x) {
+            const uint32_t n = static_cast<uint32_t>((std::max(x0[x] + 1, x0[x + 1]) - x0[x]) * (y_end - y_begin));
+            for (int c = 0; c < 3; ++c) out[x * 3 + c] = static_cast<uint8_t>((row[x * 3 + c] + n / 2) / n);
+        }
+    }
+}
+
+void Nv12ToRgb(const uint8_t* nv12, int w, int h, std::vector<uint8_t>& out) {
+    Nv12RegionToRgb(nv12, w, h, 0, 0, w, h, out);
+}
+
+void Nv12RegionToRgb(const uint8_t* nv12, int w, int h, int x, int y, int rw, int rh, std::vector<uint8_t>& out) {
+    out.resize(static_cast<size_t>(std::max(0, rw)) * static_cast<size_t>(std::max(0, rh)) * 3u);
+    if (!nv12 || w <= 0 || h <= 0 || rw <= 0 || rh <= 0) return;
+    const uint8_t* y_plane = nv12;
+    const uint8_t* uv_plane = nv12 + static_cast<size_t>(w) * static_cast<size_t>(h);
+    for (int r = 0; r < rh; ++r) {
+        const int sy = y + r;
+        const uint8_t* yrow = y_plane + static_cast<size_t>(sy) * static_cast<size_t>(w);
+        const uint8_t* uvrow = uv_plane + static_cast<size_t>(sy / 2) * static_cast<size_t>(w);
+        uint8_t* dst = out.data() + static_cast<size_t>(r) * static_cast<size_t>(rw) * 3u;
+        for (int i = 0; i < rw; ++i) {
+            const int sx = x + i;
+            const int c = 298 * (static_cast<int>(yrow[sx]) - 16);
+            const int d = static_cast<int>(uvrow[sx & ~1]) - 128;
+            const int e = static_cast<int>(uvrow[sx | 1]) - 128;
+            dst[i * 3 + 0] = clamp_u8((c + 409 * e + 128) >> 8);
+            dst[i * 3 + 1] = clamp_u8((c - 100 * d - 208 * e + 128) >> 8);
+            dst[i * 3 + 2] = clamp_u8((c + 516 * d + 128) >> 8);
+        }
+    }
+}
+
+int RgbReduction(int w, int h, int min_long_side) {
+    if (min_long_side <= 0) return 1;
+    const int long_side = std::max(w, h);
+    for (int s = 8; s > 1; s /= 2) {
+        if ((long_side + s - 1) / s >= min_long_side) return s;
+    }
+    return 1;
+}
+
+void Nv12ToRgbReduced(const uint8_t* nv12, int w, int h, int factor, std::vector<uint8_t>& out) {
+    if (factor <= 1) {
+        Nv12ToRgb(nv12, w, h, out);
+        return;
+    }
+    const int ow = w > 0 ? (w + factor - 1) / factor : 0;
+    const int oh = h > 0 ? (h + factor - 1) / factor : 0;
+    out.resize(static_cast<size_t>(ow) * static_cast<size_t>(oh) * 3u);
+    if (!nv12 || w <= 0 || h <= 0) return;
+    const uint8_t* y_plane = nv12;
+    const uint8_t* uv_plane = nv12 + static_cast<size_t>(w) * static_cast<size_t>(h);
+    // Per output column of the current block row: Y sum, U sum, V sum.
+    std::vector<uint32_t> sums(static_cast<size_t>(ow) * 3u);
+    for (int oy = 0; oy < oh; ++oy) {
+        const int y0 = oy * factor;
+        const int y1 = std::min(h, y0 + factor);
+        std::fill(sums.begin(), sums.end(), 0u);
+        for (int y = y0; y < y1; ++y) {
+            const uint8_t* yrow = y_plane + static_cast<size_t>(y) * static_cast<size_t>(w);
+            uint32_t* s = sums.data();
+            for (int ox = 0; ox < ow; ++ox, s += 3) {
+                const int x1 = std::min(w, (ox + 1) * factor);
+                for (int x = ox * factor; x < x1; ++x) s[0] += yrow[x];
+            }
+            // A chroma row covers two Y rows (blocks start on even rows).
+            if ((y & 1) != 0) continue;
+            const uint8_t* uvrow = uv_plane + static_cast<size_t>(y / 2) * static_cast<size_t>(w);
+            s = sums.data();
+            for (int ox = 0; ox < ow; ++ox, s += 3) {
+                const int x1 = std::min(w, (ox + 1) * factor);
+                for (int x = ox * factor; x < x1; x += 2) {
+                    s[1] += uvrow[x];
+                    s[2] += uvrow[x + 1];
+                }
+            }
+        }
+        const int chroma_rows = (y1 - 1) / 2 - y0 / 2 + 1;
+        uint8_t* dst = out.data() + static_cast<size_t>(oy) * static_cast<size_t>(ow) * 3u;
+        const uint32_t* s = sums.data();
+        for (int ox = 0; ox < ow; ++ox, s += 3, dst += 3) {
+            const int x0 = ox * factor;
+            const int x1 = std::min(w, x0 + factor);
+            const uint32_t ny = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+            const uint32_t nc = static_cast<uint32_t>(((x1 - 1) / 2 - x0 / 2 + 1) * chroma_rows);
+            const int c = 298 * (static_cast<int>((s[0] + ny / 2) / ny) - 16);
+            const int d = static_cast<int>((s[1] + nc / 2) / nc) - 128;
+            const int e = static_cast<int>((s[2] + nc / 2) / nc) - 128;
+            dst[0] = clamp_u8((c + 409 * e + 128) >> 8);
+            dst[1] = clamp_u8((c - 100 * d - 208 * e + 128) >> 8);
+            dst[2] = clamp_u8((c + 516 * d + 128) >> 8);
+        }
+    }
+}
+
+void ResizeRgbToPlanarNormalized(const uint8_t* rgb, int w, int h, int stride,
+                                 int dst_w, int dst_h, int pad_w, int pad_h,
+                                 const float mean[3], const float norm[3],
+                                 float* dst, size_t plane_step) {
+    if (!rgb || !dst || w <= 0 || h <= 0 || pad_w <= 0 || pad_h <= 0) return;
+    dst_w = std::min(dst_w, pad_w);
+    dst_h = std::min(dst_h, pad_h);
+
+    // A padded (zero) pixel normalizes to the bias.
+    float bias[3];
+    for (int c = 0; c < 3; ++c) bias[c] = -mean[c] * norm[c];
+
+    std::vector<int> xofs0, xofs1, yofs0, yofs1;
+    std::vector<int16_t> alpha, beta;
+    BilinearTaps(w, dst_w, xofs0, xofs1, alpha);
+    BilinearTaps(h, dst_h, yofs0, yofs1, beta);
+
+    // Two horizontally resized source rows (planar), reused while the
+    // vertical taps stay on them.
+    const size_t row_len = static_cast<size_t>(dst_w) * 3u;
+    std::vector<int16_t> buf(row_len * 2u);
+    int16_t* rows0 = buf.data();
+    int16_t* rows1 = buf.data() + row_len;
+    int have0 = -1;
+    int have1 = -1;
+
+    for (int dy = 0; dy < dst_h; ++dy) {
+        const int sy0 = yofs0[static_cast<size_t>(dy)];
+        const int sy1 = yofs1[static_cast<size_t>(dy)];
+        if (sy0 == have1) {
+            std::swap(rows0, rows1);
+            std::swap(have0, have1);
+        }
+        auto src_row = [&](int sy) { return rgb + static_cast<size_t>(sy) * static_cast<size_t>(stride); };
+        if (sy0 != have0 && sy1 != have1 && sy1 != sy0) {
+            const uint8_t* src[2] = {src_row(sy0), src_row(sy1)};
+            int16_t* out[2] = {rows0, rows1};
+            HResizeRgbRows<2>(src, dst_w, xofs0.data(), xofs1.data(), alpha.data(), out);
+        } else {
+            if (sy0 != have0) {
+                const uint8_t* src[1] = {src_row(sy0)};
+                HResizeRgbRows<1>(src, dst_w, xofs0.data(), xofs1.data(), alpha.data(), &rows0);
+            }
+            if (sy1 != have1) {
+                if (sy1 == sy0) {
+                    std::copy(rows0, rows0 + row_len, rows1);
+                } else {
+                    const uint8_t* src[1] = {src_row(sy1)};
+                    HResizeRgbRows<1>(src, dst_w, xofs0.data(), xofs1.data(), alpha.data(), &rows1);
+                }
+            }
+        }
+        have0 = sy0;
+        have1 = sy1;
+        const int16_t b0 = beta[static_cast<size_t>(dy) * 2u];
+        const int16_t b1 = beta[static_cast<size_t>(dy) * 2u + 1u];
+        for (int c = 0; c < 3; ++c) {
+            float* out = dst + static_cast<size_t>(c) * plane_step + static_cast<size_t>(dy) * static_cast<size_t>(pad_w);
+            VResizeNormalizeRow(rows0 + static_cast<size_t>(c) * dst_w, rows1 + static_cast<size_t>(c) * dst_w,
+                                dst_w, b0, b1, norm[c], bias[c], out);
+            std::fill(out + dst_w, out + pad_w, bias[c]);
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        float* plane = dst + static_cast<size_t>(c) * plane_step;
+        std::fill(plane + static_cast<size_t>(dst_h) * static_cast<size_t>(pad_w),
+                  plane + static_cast<size_t>(pad_h) * static_cast<size_t>(pad_w), bias[c]);
+    }
+}
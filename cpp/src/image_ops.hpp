@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Small pixel kernels shared by the decode stage, GMC and ReID.
+ *
+ * Built with FACE_PIPELINE_ACCELERATE (macOS), the kernels whose output
+ * is free to change go through vImage. Detector preprocessing and the GMC
+ * planes stay on the kernels here everywhere: their exact pixels are
+ * what ncnn's reference and the GMC estimates expect.
+ */
+
+// Size of a plane reduced by `downscale` (each side floored, at least 1).
+inline int DownscaledSize(int full, int downscale) {
+    const int d = downscale > 0 ? downscale : 1;
+    const int s = full / d;
+    return s > 0 ? s : 1;
+}
+
+/**
+ * How the reduced GMC luma planes sample the frame. The built-in
+ * estimators search the grid at (x*down, y*down) they have always used
+ * (Point), so reduced planes match their original estimates. The OpenCV
+ * backend was given frames cv::resize()d with INTER_LINEAR, and keeps that
+ * filter (Linear): for an integer factor, the mean of the 2x2 pixels at the
+ * center of each output pixel's footprint when `down` is even, the center
+ * pixel when it is odd.
+ */
+enum class LumaFilter { Point, Linear };
+
+/** The filter of this build's GMC backend. */
+LumaFilter GmcLumaFilter();
+
+/**
+ * Source rows (and columns) of output row `o` of a reduction by `down`
+ * under GmcLumaFilter(): `o * down + offset`, and the next one too when
+ * this returns 2.
+ */
+int GmcLumaTaps(int down, int& offset);
+
+/**
+ * Reduce an 8-bit luma plane by an integer factor.
+ *
+ * Output is `DownscaledSize(w, down) x DownscaledSize(h, down)`, tightly packed,
+ * sampled as GmcLumaFilter() says.
+ */
+void DownsampleLuma(const uint8_t* luma, int w, int h, int down, std::vector<uint8_t>& out);
+
+/**
+ * Convert interleaved RGB to luma (BT.601 integer approximation) and reduce it
+ * by an integer factor in a single pass (sampled like DownsampleLuma; with
+ * two taps the RGB is averaged first, as resizing then converting would).
+ */
+void RgbToLumaDownsample(const uint8_t* rgb, int w, int h, int down, std::vector<uint8_t>& out);
+
+/**
+ * One output row of RgbToLumaDownsample() (DownscaledSize(w, down) pixels)
+ * from its source rows, for decoders that see one row at a time: `row1` is
+ * the second of GmcLumaTaps() rows, `row0` itself with one tap.
+ */
+void RgbRowsToLumaRow(const uint8_t* row0, const uint8_t* row1, int w, int down, uint8_t* out);
+
+/**
+ * Convert interleaved BGRA to reduced luma in a single pass (alpha ignored).
+ */
+void BgraToLumaDownsample(const uint8_t* bgra, int w, int h, int down, std::vector<uint8_t>& out);
+
+/**
+ * Convert interleaved BGRA to tightly packed RGB (alpha dropped).
+ */
+void BgraToRgb(const uint8_t* bgra, int w, int h, std::vector<uint8_t>& out);
+
+/**
+ * Shrink interleaved RGB `src` (sw x sh) to `dw x dh`, tightly packed, for
+ * previews: a box filter, each output pixel averaging the source pixels its
+ * footprint starts in (vImage's resampling filter with Accelerate).
+ */
+void ShrinkRgb(const uint8_t* src, int sw, int sh, int dw, int dh, std::vector<uint8_t>& dst);
+
+/**
+ * Convert NV12 (full-size Y plane followed by interleaved half-size UV plane)
+ * to tightly packed RGB using BT.601 limited-range coefficients.
+ *
+ * `w` and `h` must be even.
+ */
+void Nv12ToRgb(const uint8_t* nv12, int w, int h, std::vector<uint8_t>& out);
+
+/**
+ * Nv12ToRgb() of the `rw x rh` rectangle at (x, y) of a `w x h` NV12 image
+ * only. The rectangle must lie within the image.
+ */
+void Nv12RegionToRgb(const uint8_t* nv12, int w, int h, int x, int y, int rw, int rh, std::vector<uint8_t>& out);
+
+/**
+ * Largest reduction of 1, 2, 4 or 8 that keeps a `w x h` frame's long side
+ * (rounded up) at least `min_long_side`, for decoders that can produce
+ * RGB smaller at no extra cost (1 if `min_long_side` <= 0).
+ */
+int RgbReduction(int w, int h, int min_long_side);
+
+/**
+ * Nv12ToRgb() fused with a box reduction by `factor` (2, 4 or 8; 1 is
+ * Nv12ToRgb()): each output pixel converts the mean Y of its factor x factor
+ * block and the mean chroma under it, so only the reduced image is ever
+ * written. Output is ceil(w / factor) x ceil(h / factor).
+ */
+void Nv12ToRgbReduced(const uint8_t* nv12, int w, int h, int factor, std::vector<uint8_t>& out);
+
+/**
+ * Bilinear-resize interleaved RGB to `dst_w x dst_h`, letterbox it into a
+ * `pad_w x pad_h` canvas (image top-left, zero padding) and normalize it to
+ * planar float as `(v - mean[c]) * norm[c]`, all in one pass.
+ *
+ * Uses ncnn's fixed-point bilinear filter, so the result matches
+ * `from_pixels_resize` + `copy_make_border` + `substract_mean_normalize`
+ * without their two intermediate images. Channel `c` starts at
+ * `dst + c * plane_step`; rows are `pad_w` floats apart. `stride` is the
+ * source row pitch in bytes.
+ */
+void ResizeRgbToPlanarNormalized(const uint8_t* rgb, int w, int h, int stride,
+                                 int dst_w, int dst_h, int pad_w, int pad_h,
+                                 const float mean[3], const float norm[3],
+                                 float* dst, size_t plane_step);
@@ -0,0 +1,261 @@
+#include "inference_backend.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "datareader.h"
+#include "embedded_models.hpp"
+#include "frame_container.hpp"
+
+#if NCNN_VULKAN
+#include "gpu.h"
+#endif
+
+namespace {
+std::atomic<bool> g_mapped_models{false};
+std::atomic<size_t> g_mapped_model_bytes{0};
+
+// ncnn::DataReaderFromMemory bounded by the end of a mapped file, so a
+// truncated .bin fails to load instead of reading past the mapping.
+class MappedBinReader : public ncnn::DataReader {
+public:
+    MappedBinReader(const uint8_t* data, size_t size) : p_(data), end_(data + size) {}
+
+    size_t read(void* buf, size_t size) const override {
+        size = std::min(size, static_cast<size_t>(end_ - p_));
+        std::memcpy(buf, p_, size);
+        p_ += size;
+        return size;
+    }
+
+    size_t reference(size_t size, const void** buf) const override {
+        if (size > static_cast<size_t>(end_ - p_)) return 0;  // ModelBin falls back to read()
+        *buf = p_;
+        p_ += size;
+        return size;
+    }
+
+private:
+    mutable const uint8_t* p_;
+    const uint8_t* end_;
+};
+
+// The mapping of a .bin, kept until exit: nets reference weights in it, and
+// a model loaded again (another detection worker, a reload) reuses it.
+std::shared_ptr<MappedFile> MapModelBin(const std::string& path) {
+    static std::mutex mu;
+    static std::map<std::string, std::shared_ptr<MappedFile>> files;
+    std::lock_guard<std::mutex> lock(mu);
+    std::shared_ptr<MappedFile>& file = files[path];
+    if (!file) {
+        file = MappedFile::Open(path);
+        if (file) g_mapped_model_bytes += file->size();
+    }
+    return file;
+}
+
+bool LoadFromMemory(ncnn::Net& net, const char* param, const unsigned char* bin) {
+    const unsigned char* param_mem = reinterpret_cast<const unsigned char*>(param);
+    ncnn::DataReaderFromMemory param_reader(param_mem);
+    if (net.load_param(param_reader) != 0) return false;
+    // Weights that layers keep as-is are referenced in place, not copied.
+    ncnn::DataReaderFromMemory bin_reader(bin);
+    return net.load_model(bin_reader) == 0;
+}
+
+// "<kBuiltinModelDir>/<stem>.param" -> the embedded model <stem>.
+bool IsBuiltinPath(const std::string& path, std::string& stem) {
+    const size_t prefix = sizeof(kBuiltinModelDir) - 1;
+    if (path.size() <= prefix || path.compare(0, prefix, kBuiltinModelDir) != 0 || path[prefix] != '/') {
+        return false;
+    }
+    stem = path.substr(prefix + 1);
+    const size_t dot = stem.rfind('.');
+    if (dot != std::string::npos) stem.resize(dot);
+    return true;
+}
+
+// "<fnv1a64> <size> <file>" a line, written by scripts/prepare_models.py.
+constexpr const char* kModelManifest = "manifest.txt";
+
+// False (with a warning) if the manifest next to `path` lists the file with
+// another size or checksum. Files it does not list, and directories
+// without one, pass.
+bool MatchesManifest(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+    const std::string dir = slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    const std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    const std::string manifest = dir + "/" + kModelManifest;
+    FILE* m = std::fopen(manifest.c_str(), "r");
+    if (!m) return true;
+    bool listed = false;
+    unsigned long long want_hash = 0, want_size = 0;
+    char line[1024];
+    char file[768];
+    while (!listed && std::fgets(line, sizeof(line), m)) {
+        listed = std::sscanf(line, "%llx %llu %767s", &want_hash, &want_size, file) == 3 && name == file;
+    }
+    std::fclose(m);
+    if (!listed) return true;
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return true;  // the load reports it
+    uint64_t hash = 14695981039346656037ull;  // FNV-1a 64, byte by byte
+    unsigned long long size = 0;
+    unsigned char buf[1 << 16];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+        for (size_t i = 0; i < n; ++i) hash = (hash ^ buf[i]) * 1099511628211ull;
+        size += n;
+    }
+    std::fclose(f);
+    if (hash == want_hash && size == want_size) return true;
+    fprintf(stderr, "Warning: %s does not match %s; not loading it (re-run the prepare_models target)\n",
+            path.c_str(), manifest.c_str());
+    return false;
+}
+
+bool LoadParamAndModel(ncnn::Net& net, const std::string& param_path, const std::string& bin_path) {
+    std::string stem;
+    if (IsBuiltinPath(param_path, stem)) {
+        const EmbeddedModel* model = FindEmbeddedModel(stem);
+        return model && LoadFromMemory(net, model->param, model->bin);
+    }
+    if (!MatchesManifest(param_path) || !MatchesManifest(bin_path)) return false;
+    if (net.load_param(param_path.c_str()) != 0) return false;
+    if (g_mapped_models.load()) {
+        // Raw fp32 weights that layers keep as-is stay in the page cache,
+        // shared with every process that maps the same file.
+        if (const std::shared_ptr<MappedFile> file = MapModelBin(bin_path)) {
+            MappedBinReader reader(file->data(), file->size());
+            return net.load_model(reader) == 0;
+        }
+    }
+    return net.load_model(bin_path.c_str()) == 0;
+}
+
+bool FileExists(const std::string& path) {
+#ifdef _WIN32
+    struct _stat64 st;
+    return _stat64(path.c_str(), &st) == 0;
+#else
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+#endif
+}
+
+// Run `load` on the requested device, falling back to the CPU.
+template <typename Load>
+bool LoadWithFallback(ncnn::Net& net, const char* what, const GpuOptions& gpu, bool& on_gpu, const Load& load) {
+    on_gpu = false;
+    if (gpu.enabled) {
+#if NCNN_VULKAN
+        const int count = ncnn::get_gpu_count();
+        const int device = gpu.device >= 0 ? gpu.device : ncnn::get_default_gpu_index();
+        if (count > 0 && device < count) {
+            net.opt.use_vulkan_compute = true;
+            net.set_vulkan_device(device);
+            if (load()) {
+                on_gpu = true;
+                return true;
+            }
+            fprintf(stderr, "Warning: %s could not be set up on Vulkan device %d; using CPU\n", what, device);
+            net.clear();
+        } else {
+            fprintf(stderr, "Warning: Vulkan device %d not available (%d found); using CPU\n", device, count);
+        }
+#else
+        (void)what;
+        static bool warned = false;
+        if (!warned) {
+            fprintf(stderr, "Warning: ncnn was built without Vulkan; using CPU\n");
+            warned = true;
+        }
+#endif
+    }
+    net.opt.use_vulkan_compute = false;
+    return load();
+}
+}  // namespace
+
+void EnableMappedModels(bool enabled) {
+    g_mapped_models = enabled;
+}
+
+size_t MappedModelBytes() {
+    return g_mapped_model_bytes.load();
+}
+
+bool ParseCoreMlUnits(const char* name, CoreMlOptions::Units& out) {
+    if (std::strcmp(name, "all") == 0) {
+        out = CoreMlOptions::Units::All;
+    } else if (std::strcmp(name, "ane") == 0) {
+        out = CoreMlOptions::Units::CpuAndNeuralEngine;
+    } else if (std::strcmp(name, "gpu") == 0) {
+        out = CoreMlOptions::Units::CpuAndGpu;
+    } else if (std::strcmp(name, "cpu") == 0) {
+        out = CoreMlOptions::Units::CpuOnly;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#ifndef FACE_PIPELINE_COREML
+// The Core ML backend lives in coreml_backend.mm (Apple builds only).
+bool CoreMlAvailable() { return false; }
+
+std::unique_ptr<NetBackend> LoadCoreMlModel(const std::string& mlmodelc_path,
+                                            const CoreMlOptions& options,
+                                            std::string& error) {
+    (void)mlmodelc_path;
+    (void)options;
+    error = "this build has no Core ML support";
+    return nullptr;
+}
+#endif
+
+bool GpuAvailable() {
+#if NCNN_VULKAN
+    return ncnn::get_gpu_count() > 0;
+#else
+    return false;
+#endif
+}
+
+bool LoadNcnnNet(ncnn::Net& net,
+                 const std::string& param_path,
+                 const std::string& bin_path,
+                 const GpuOptions& gpu,
+                 bool& on_gpu) {
+    return LoadWithFallback(net, param_path.c_str(), gpu, on_gpu,
+                            [&] { return LoadParamAndModel(net, param_path, bin_path); });
+}
+
+bool LoadNcnnNetFromMemory(ncnn::Net& net,
+                           const char* param,
+                           const unsigned char* bin,
+                           const GpuOptions& gpu,
+                           bool& on_gpu) {
+    return LoadWithFallback(net, "in-memory model", gpu, on_gpu,
+                            [&] { return LoadFromMemory(net, param, bin); });
+}
+
+std::string FindModelStem(const std::string& dir, std::initializer_list<const char*> stems) {
+    for (const char* stem : stems) {
+        const std::string path = dir + "/" + stem;
+        if (dir == kBuiltinModelDir) {
+            if (FindEmbeddedModel(stem)) return path;
+        } else if (FileExists(path + ".param") && FileExists(path + ".bin")) {
+            return path;
+        }
+    }
+    return std::string();
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "net.h"
+
+/**
+ * Vulkan execution request for an ncnn network.
+ */
+struct GpuOptions {
+    bool enabled = false;  // run on a Vulkan device when one is available
+    int device = -1;       // Vulkan device index (-1 = ncnn's default device)
+    bool preprocess = true;  // detector: upload uint8 frames and resize / normalize them on the device (see gpu_preprocess.hpp)
+};
+
+/**
+ * Core ML execution request (Apple platforms). The model is the compiled
+ * `<stem>.mlmodelc` next to the ncnn files, converted from the same network.
+ */
+struct CoreMlOptions {
+    enum class Units {
+        All,             // Core ML's choice of Neural Engine, GPU and CPU
+        CpuAndNeuralEngine,
+        CpuAndGpu,
+        CpuOnly,
+    };
+
+    bool enabled = false;  // run on Core ML when the model exists (falls back to ncnn)
+    Units units = Units::All;
+};
+
+/**
+ * ONNX Runtime execution request, for GPUs ncnn's Vulkan path does not cover
+ * (DirectML on Windows). Models are `<stem>.onnx` exports of the same network.
+ */
+struct OnnxRuntimeOptions {
+    bool enabled = false;   // run on ONNX Runtime when the model exists (falls back to ncnn)
+    bool directml = true;   // DirectML execution provider when the build has it, else ORT's CPU provider
+    int device = 0;         // DirectML adapter index
+};
+
+/**
+ * Parse "all", "ane", "gpu" or "cpu".
+ */
+bool ParseCoreMlUnits(const char* name, CoreMlOptions::Units& out);
+
+/**
+ * A model on a runtime other than ncnn (Core ML, ONNX Runtime), driven with the same
+ * ncnn::Mat blobs so callers keep one pre- and post-processing path.
+ */
+class NetBackend {
+public:
+    virtual ~NetBackend() = default;
+
+    virtual const char* name() const = 0;
+
+    /**
+     * Input size the model was converted with; 0 if it accepts any size.
+     */
+    virtual int inputWidth() const = 0;
+    virtual int inputHeight() const = 0;
+
+    virtual bool hasOutput(const char* name) const = 0;
+
+    /**
+     * Run on a planar float input (w, h, c) and fetch `names`. A leading
+     * batch dimension of 1 is dropped: [1, C, H, W] outputs come back as
+     * (w, h, c) mats, [1, N, K] and [N, K] as 2-D (w = K, h = N). Safe to
+     * call concurrently.
+     *
+     * @return false if the runtime failed; `outputs` is then unspecified
+     */
+    virtual bool run(const ncnn::Mat& input,
+                     const std::vector<const char*>& names,
+                     std::vector<ncnn::Mat>& outputs) const = 0;
+};
+
+/**
+ * True if this build has the Core ML backend (macOS builds).
+ */
+bool CoreMlAvailable();
+
+/**
+ * Load a compiled Core ML model (.mlmodelc directory).
+ *
+ * @return nullptr with `error` set if Core ML is not available or the model
+ *         cannot be loaded
+ */
+std::unique_ptr<NetBackend> LoadCoreMlModel(const std::string& mlmodelc_path,
+                                            const CoreMlOptions& options,
+                                            std::string& error);
+
+/**
+ * True if this build links ONNX Runtime.
+ */
+bool OnnxRuntimeAvailable();
+
+/**
+ * Load an ONNX model into an ONNX Runtime session (DirectML when requested
+ * and built in).
+ *
+ * @return nullptr with `error` set if ONNX Runtime is not available or the
+ *         model cannot be loaded
+ */
+std::unique_ptr<NetBackend> LoadOnnxModel(const std::string& onnx_path,
+                                          const OnnxRuntimeOptions& options,
+                                          std::string& error);
+
+/**
+ * True if the linked ncnn has Vulkan support and sees at least one device.
+ */
+bool GpuAvailable();
+
+/**
+ * Load model weights from read-only memory mappings of the .bin files
+ * (--mmap-models) instead of reading them into the heap. ncnn references
+ * raw fp32 weights in place, so processes running the same model files
+ * (batch jobs beside the panel's server) share those pages in the page
+ * cache. fp16 weights and the ones layers repack when they are set up
+ * (most convolutions) are still private copies. Embedded models are always
+ * used in place. A mapped file is kept for the life of the process, and
+ * must not be rewritten meanwhile.
+ */
+void EnableMappedModels(bool enabled);
+
+/**
+ * Bytes of .bin files mapped so far.
+ */
+size_t MappedModelBytes();
+
+/**
+ * Load a network, on the GPU if requested, otherwise (or on failure) on the CPU.
+ *
+ * `net.opt` must already hold the CPU execution options. When the GPU is
+ * used, ncnn's extractor uploads inputs and downloads outputs through its
+ * own VkCompute command buffers, so callers keep passing CPU mats. If ncnn
+ * was built without Vulkan, the device does not exist, or the model cannot
+ * be set up on it, the net is reloaded on the CPU with a warning.
+ *
+ * Paths inside kBuiltinModelDir load the embedded model of that stem.
+ * Files that a manifest.txt next to them lists (scripts/prepare_models.py)
+ * must have the listed size and checksum.
+ *
+ * @param on_gpu Output: true if the net runs on a Vulkan device
+ * @return false if the model could not be loaded at all
+ */
+bool LoadNcnnNet(ncnn::Net& net,
+                 const std::string& param_path,
+                 const std::string& bin_path,
+                 const GpuOptions& gpu,
+                 bool& on_gpu);
+
+/**
+ * LoadNcnnNet() for a model already in memory: `param` is the NUL-terminated
+ * text .param, `bin` the 4-byte aligned weights. Some weights are used in
+ * place, so `bin` must outlive the net.
+ */
+bool LoadNcnnNetFromMemory(ncnn::Net& net,
+                           const char* param,
+                           const unsigned char* bin,
+                           const GpuOptions& gpu,
+                           bool& on_gpu);
+
+/**
+ * First of `stems` whose "<dir>/<stem>.param" and "<dir>/<stem>.bin" both
+ * exist, e.g. {"mobilefacenet-opt", "mobilefacenet"}. In kBuiltinModelDir
+ * the stem has to be embedded instead.
+ *
+ * @return "<dir>/<stem>" without extension, or an empty string if none exists
+ */
+std::string FindModelStem(const std::string& dir, std::initializer_list<const char*> stems);
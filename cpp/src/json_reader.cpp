@@ -0,0 +1,189 @@
+#include "json_reader.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else {
+        out.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    }
+}
+}  // namespace
+
+bool JsonParser::parse(Json& out) {
+    if (!value(out, 0)) return false;
+    skipSpace();
+    return pos_ == s_.size();
+}
+
+void JsonParser::skipSpace() {
+    while (more() && (s_[pos_] == ' ' || s_[pos_] == '\t' || s_[pos_] == '\r' || s_[pos_] == '\n')) pos_++;
+}
+
+bool JsonParser::literal(const char* word) {
+    const size_t n = std::strlen(word);
+    if (s_.compare(pos_, n, word) != 0) return false;
+    pos_ += n;
+    return true;
+}
+
+bool JsonParser::value(Json& out, int depth) {
+    skipSpace();
+    if (!more() || depth > kMaxDepth) return false;
+    out.begin = pos_;
+    bool ok = false;
+    switch (s_[pos_]) {
+        case '{': ok = object(out, depth); break;
+        case '[': ok = array(out, depth); break;
+        case '"':
+            out.type = Json::Type::String;
+            ok = string(out.text);
+            break;
+        case 't':
+            out.type = Json::Type::Bool;
+            out.boolean = true;
+            ok = literal("true");
+            break;
+        case 'f':
+            out.type = Json::Type::Bool;
+            ok = literal("false");
+            break;
+        case 'n': ok = literal("null"); break;
+        default: ok = number(out); break;
+    }
+    out.end = pos_;
+    return ok;
+}
+
+bool JsonParser::object(Json& out, int depth) {
+    out.type = Json::Type::Object;
+    pos_++;
+    skipSpace();
+    if (at('}')) {
+        pos_++;
+        return true;
+    }
+    for (;;) {
+        skipSpace();
+        std::string key;
+        if (!at('"') || !string(key)) return false;
+        skipSpace();
+        if (!at(':')) return false;
+        pos_++;
+        Json v;
+        if (!value(v, depth + 1)) return false;
+        out.fields.emplace_back(std::move(key), std::move(v));
+        skipSpace();
+        if (at(',')) {
+            pos_++;
+        } else if (at('}')) {
+            pos_++;
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+bool JsonParser::array(Json& out, int depth) {
+    out.type = Json::Type::Array;
+    pos_++;
+    skipSpace();
+    if (at(']')) {
+        pos_++;
+        return true;
+    }
+    for (;;) {
+        Json v;
+        if (!value(v, depth + 1)) return false;
+        out.items.push_back(std::move(v));
+        skipSpace();
+        if (at(',')) {
+            pos_++;
+        } else if (at(']')) {
+            pos_++;
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+bool JsonParser::number(Json& out) {
+    const size_t start = pos_;
+    while (more() && std::strchr("+-.0123456789eE", s_[pos_]) != nullptr) pos_++;
+    if (pos_ == start) return false;
+    const std::string digits = s_.substr(start, pos_ - start);
+    char* end = nullptr;
+    out.type = Json::Type::Number;
+    out.number = std::strtod(digits.c_str(), &end);
+    return end == digits.c_str() + digits.size();
+}
+
+bool JsonParser::hex4(uint32_t& v) {
+    if (pos_ + 4 > s_.size()) return false;
+    v = 0;
+    for (int k = 0; k < 4; ++k) {
+        const char c = s_[pos_++];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= static_cast<uint32_t>(c - '0');
+        else if (c >= 'a' && c <= 'f') v |= static_cast<uint32_t>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v |= static_cast<uint32_t>(c - 'A' + 10);
+        else return false;
+    }
+    return true;
+}
+
+bool JsonParser::string(std::string& out) {
+    pos_++;  // opening quote
+    while (more()) {
+        const char c = s_[pos_++];
+        if (c == '"') return true;
+        if (static_cast<unsigned char>(c) < 0x20) return false;
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        if (!more()) return false;
+        switch (s_[pos_++]) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t cp = 0;
+                if (!hex4(cp)) return false;
+                if (cp >= 0xd800 && cp < 0xdc00) {
+                    uint32_t low = 0;
+                    if (s_.compare(pos_, 2, "\\u") != 0) return false;
+                    pos_ += 2;
+                    if (!hex4(low) || low < 0xdc00 || low >= 0xe000) return false;
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                } else if (cp >= 0xdc00 && cp < 0xe000) {
+                    return false;
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
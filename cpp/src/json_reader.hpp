@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A parsed JSON value; [begin, end) is its text in the parsed string.
+ */
+struct Json {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string text;                                  // String
+    std::vector<Json> items;                           // Array
+    std::vector<std::pair<std::string, Json>> fields;  // Object
+    size_t begin = 0;
+    size_t end = 0;
+
+    const Json* get(const char* key) const {
+        for (const auto& f : fields) {
+            if (f.first == key) return &f.second;
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * Recursive-descent parser for one JSON text (RFC 8259), for requests and
+ * manifests; the counterpart of JsonWriter.
+ */
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : s_(text) {}
+
+    /** @return false unless the whole text is one JSON value */
+    bool parse(Json& out);
+
+private:
+    static constexpr int kMaxDepth = 64;
+
+    bool more() const { return pos_ < s_.size(); }
+    bool at(char c) const { return more() && s_[pos_] == c; }
+
+    void skipSpace();
+    bool literal(const char* word);
+    bool value(Json& out, int depth);
+    bool object(Json& out, int depth);
+    bool array(Json& out, int depth);
+    bool number(Json& out);
+    bool hex4(uint32_t& v);
+    bool string(std::string& out);
+
+    const std::string& s_;
+    size_t pos_ = 0;
+};
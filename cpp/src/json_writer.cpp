@@ -0,0 +1,87 @@
+#include "json_writer.hpp"
+
+#include <charconv>
+#include <cmath>
+
+namespace {
+constexpr uint64_t kPow10[] = {1,         10,         100,         1000,         10000,
+                               100000,    1000000,    10000000,    100000000,    1000000000};
+}  // namespace
+
+JsonWriter::JsonWriter(FILE* out, size_t buffer_bytes) : file_(out), limit_(buffer_bytes), buf_(own_) {
+    own_.reserve(buffer_bytes + 256);
+}
+
+JsonWriter::JsonWriter(std::string& out) : buf_(out) {}
+
+JsonWriter& JsonWriter::integer(int64_t v) {
+    char digits[24];
+    const auto res = std::to_chars(digits, digits + sizeof(digits), v);
+    return raw(digits, static_cast<size_t>(res.ptr - digits));
+}
+
+JsonWriter& JsonWriter::fixed(double v, int decimals) {
+    // Past 1e9 (or not finite) the scaled value no longer fits the integer
+    // path; printf handles those rare values.
+    if (decimals < 0 || decimals > 9 || !(std::fabs(v) < 1e9)) {
+        char text[64];
+        const int n = std::snprintf(text, sizeof(text), "%.*f", decimals < 0 ? 0 : decimals, v);
+        return raw(text, n > 0 ? static_cast<size_t>(n) : 0);
+    }
+    // A float times 10^decimals is exact in a double, so rounding it to the
+    // nearest integer, half to even, gives printf's digits.
+    const uint64_t scale = kPow10[decimals];
+    const uint64_t units = static_cast<uint64_t>(std::nearbyint(std::fabs(v) * static_cast<double>(scale)));
+    char text[40];
+    char* p = text;
+    if (std::signbit(v)) *p++ = '-';
+    p = std::to_chars(p, text + sizeof(text), units / scale).ptr;
+    if (decimals > 0) {
+        *p++ = '.';
+        uint64_t frac = units % scale;
+        for (int d = decimals - 1; d >= 0; --d) {
+            p[d] = static_cast<char>('0' + frac % 10);
+            frac /= 10;
+        }
+        p += decimals;
+    }
+    return raw(text, static_cast<size_t>(p - text));
+}
+
+JsonWriter& JsonWriter::string(const std::string& text) {
+    buf_.push_back('"');
+    AppendJsonEscaped(buf_, text);
+    buf_.push_back('"');
+    return spill();
+}
+
+bool JsonWriter::flush() {
+    if (file_ != nullptr && !buf_.empty()) {
+        ok_ = std::fwrite(buf_.data(), 1, buf_.size(), file_) == buf_.size() && ok_;
+        buf_.clear();
+    }
+    return ok_;
+}
+
+void AppendJsonEscaped(std::string& out, const std::string& text) {
+    static const char kHex[] = "0123456789abcdef";
+    for (const char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out += "\\u00";
+                    out.push_back(kHex[(c >> 4) & 0xf]);
+                    out.push_back(kHex[c & 0xf]);
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/**
+ * Buffered writer of JSON text, for outputs with one entry per frame.
+ *
+ * Text collects in a buffer that goes out with one fwrite() whenever it
+ * passes `buffer_bytes` (and on flush() or destruction), or straight into
+ * a caller's string. Numbers are formatted in place: integers with
+ * std::to_chars, fixed-point decimals by scaling and rounding half to even
+ * the way printf's "%.Nf" rounds (the same digits for float values), with
+ * no format string parsed and nothing allocated per value.
+ *
+ * The writer adds no separators or indentation of its own: the caller
+ * writes the punctuation, so pretty and compact layouts are both just text.
+ */
+class JsonWriter {
+public:
+    /** Write to `out`, flushing every `buffer_bytes`. */
+    explicit JsonWriter(FILE* out, size_t buffer_bytes = 1 << 16);
+    /** Append to `out`; nothing is written anywhere. */
+    explicit JsonWriter(std::string& out);
+    ~JsonWriter() { flush(); }
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& raw(const char* text, size_t n) {
+        buf_.append(text, n);
+        return spill();
+    }
+    JsonWriter& raw(const char* text) { return raw(text, std::strlen(text)); }
+    JsonWriter& raw(const std::string& text) { return raw(text.data(), text.size()); }
+    JsonWriter& ch(char c) {
+        buf_.push_back(c);
+        return spill();
+    }
+
+    JsonWriter& integer(int64_t v);
+    /** `v` with exactly `decimals` (0-9) digits after the point, like "%.<decimals>f". */
+    JsonWriter& fixed(double v, int decimals);
+    /** `text` as a quoted JSON string. */
+    JsonWriter& string(const std::string& text);
+
+    /** Write out what is buffered (FILE mode). @return false once any write failed */
+    bool flush();
+
+private:
+    JsonWriter& spill() {
+        if (file_ != nullptr && buf_.size() >= limit_) flush();
+        return *this;
+    }
+
+    FILE* file_ = nullptr;
+    size_t limit_ = 0;
+    std::string own_;
+    std::string& buf_;
+    bool ok_ = true;
+};
+
+/** Append `text` to `out` with JSON string escapes (no quotes). */
+void AppendJsonEscaped(std::string& out, const std::string& text);
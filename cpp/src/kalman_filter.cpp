@@ -1,19 +1,10 @@
 #include "kalman_filter.hpp"
+#include "checkpoint.hpp"
 
 #include <algorithm>
 #include <cmath>
-#include <stdexcept>
 
 namespace {
-inline void l2_normalize(std::array<float, Detection::kReidDim>& v) {
-    double ss = 0.0;
-    for (float x : v) ss += static_cast<double>(x) * static_cast<double>(x);
-    const double inv = 1.0 / (std::sqrt(ss) + 1e-12);
-    for (float& x : v) x = static_cast<float>(static_cast<double>(x) * inv);
-}
-
-constexpr float kMinReidUpdateQuality = 0.40f;
-
 inline void warp_point_px(const Mat3f& M, float x, float y, float& ox, float& oy) {
     const float nx = M(0, 0) * x + M(0, 1) * y + M(0, 2);
     const float ny = M(1, 0) * x + M(1, 1) * y + M(1, 2);
@@ -58,316 +49,448 @@ inline BBox warp_bbox_norm(const BBox& b_norm, const Mat3f& M, int w, int h) {
     const float inv_h = 1.0f / static_cast<float>(h);
     return BBox{minx * inv_w, miny * inv_h, maxx * inv_w, maxy * inv_h};
 }
-}  // namespace
 
-// =============================================================================
-// Matrix Implementation
-// =============================================================================
-
-Matrix::Matrix(int rows, int cols)
-    : rows_(rows), cols_(cols), data_(rows * cols, 0.0f) {}
-
-Matrix::Matrix(int rows, int cols, const std::vector<float>& data)
-    : rows_(rows), cols_(cols), data_(data) {
-    if (static_cast<int>(data.size()) != rows * cols) {
-        throw std::invalid_argument("Matrix data size mismatch");
+// a after b
+Mat3f Compose(const Mat3f& a, const Mat3f& b) {
+    Mat3f out;
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            out.m[static_cast<size_t>(r * 3 + c)] = a(r, 0) * b(0, c) + a(r, 1) * b(1, c) + a(r, 2) * b(2, c);
+        }
     }
+    return out;
+}
+
+template <typename T>
+void PutOptional(CheckpointWriter& w, const std::optional<T>& v) {
+    w.put(v.has_value());
+    if (v) w.put(*v);
+}
+
+template <typename T>
+void GetOptional(CheckpointReader& r, std::optional<T>& v) {
+    v.reset();
+    if (r.get<bool>()) v = r.get<T>();
+}
+
+// Matrices shared by every track (SORT / OC-SORT defaults).
+struct KalmanModel {
+    Mat<7, 7> F;  // State transition matrix
+    Mat<4, 7> H;  // Measurement matrix
+    Mat<7, 7> Q;  // Process noise covariance
+    Mat<4, 4> R;  // Measurement noise covariance
+};
+
+const KalmanModel& Model() {
+    static const KalmanModel model = [] {
+        KalmanModel m;
+        // State transition matrix F (constant velocity model)
+        // x' = x + vx, y' = y + vy, s' = s + vs, r' = r
+        m.F.setIdentity();
+        m.F(0, 4) = 1.0f;  // x += vx
+        m.F(1, 5) = 1.0f;  // y += vy
+        m.F(2, 6) = 1.0f;  // s += vs
+
+        // Measurement matrix H (observe x, y, s, r)
+        m.H(0, 0) = 1.0f;
+        m.H(1, 1) = 1.0f;
+        m.H(2, 2) = 1.0f;
+        m.H(3, 3) = 1.0f;
+
+        // Process noise covariance Q
+        // Matches official: Q[-1,-1]*=0.01; Q[4:,4:]*=0.01
+        m.Q.setIdentity();
+        m.Q(6, 6) *= 0.01f;
+        m.Q(4, 4) *= 0.01f;
+        m.Q(5, 5) *= 0.01f;
+        m.Q(6, 6) *= 0.01f;  // applied twice as in the official implementation
+
+        // Measurement noise covariance R
+        // Matches official: R[2:,2:] *= 10
+        m.R.setIdentity();
+        m.R(2, 2) *= 10.0f;
+        m.R(3, 3) *= 10.0f;
+        return m;
+    }();
+    return model;
 }
+}  // namespace
 
-float& Matrix::operator()(int r, int c) {
-    return data_[r * cols_ + c];
+void SaveDetection(CheckpointWriter& w, const Detection& d) {
+    w.put(d.bbox);
+    w.put(d.score);
+    w.putVector(d.reid);
+    w.put(d.has_reid);
+    w.put(d.reid_quality);
+    w.put(d.pixel_bbox);
+    w.put(d.landmarks);
 }
 
-float Matrix::operator()(int r, int c) const {
-    return data_[r * cols_ + c];
+void LoadDetection(CheckpointReader& r, Detection& d) {
+    r.get(d.bbox);
+    r.get(d.score);
+    r.getVector(d.reid);
+    r.get(d.has_reid);
+    r.get(d.reid_quality);
+    r.get(d.pixel_bbox);
+    r.get(d.landmarks);
 }
 
-Matrix Matrix::operator+(const Matrix& other) const {
-    if (rows_ != other.rows_ || cols_ != other.cols_) {
-        throw std::invalid_argument("Matrix dimensions mismatch for addition");
-    }
-    Matrix result(rows_, cols_);
-    for (int i = 0; i < rows_ * cols_; ++i) {
-        result.data_[i] = data_[i] + other.data_[i];
+// =============================================================================
+// BBox Implementation
+// =============================================================================
+
+float BBox::iou(const BBox& other) const {
+    float ix1 = std::max(x1, other.x1);
+    float iy1 = std::max(y1, other.y1);
+    float ix2 = std::min(x2, other.x2);
+    float iy2 = std::min(y2, other.y2);
+    
+    if (ix2 < ix1 || iy2 < iy1) {
+        return 0.0f;
     }
-    return result;
+    
+    float intersection = (ix2 - ix1) * (iy2 - iy1);
+    float union_area = area() + other.area() - intersection;
+    
+    return union_area > 0 ? intersection / union_area : 0.0f;
 }
 
-Matrix Matrix::operator-(const Matrix& other) const {
-    if (rows_ != other.rows_ || cols_ != other.cols_) {
-        throw std::invalid_argument("Matrix dimensions mismatch for subtraction");
-    }
-    Matrix result(rows_, cols_);
-    for (int i = 0; i < rows_ * cols_; ++i) {
-        result.data_[i] = data_[i] - other.data_[i];
+// =============================================================================
+// KalmanStateBank Implementation
+// =============================================================================
+
+int KalmanStateBank::acquire() {
+    int slot;
+    if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+    } else {
+        slot = size_++;
+        for (auto& v : x_) v.push_back(0.0f);
+        for (auto& v : P_) v.push_back(0.0f);
     }
-    return result;
+    for (auto& v : x_) v[slot] = 0.0f;
+    for (auto& v : P_) v[slot] = 0.0f;
+    return slot;
 }
 
-Matrix Matrix::operator*(const Matrix& other) const {
-    if (cols_ != other.rows_) {
-        throw std::invalid_argument("Matrix dimensions mismatch for multiplication");
-    }
-    Matrix result(rows_, other.cols_);
-    for (int i = 0; i < rows_; ++i) {
-        for (int j = 0; j < other.cols_; ++j) {
-            float sum = 0.0f;
-            for (int k = 0; k < cols_; ++k) {
-                sum += (*this)(i, k) * other(k, j);
-            }
-            result(i, j) = sum;
-        }
-    }
-    return result;
+void KalmanStateBank::release(int slot) {
+    free_.push_back(slot);
 }
 
-Matrix Matrix::operator*(float scalar) const {
-    Matrix result(rows_, cols_);
-    for (int i = 0; i < rows_ * cols_; ++i) {
-        result.data_[i] = data_[i] * scalar;
+void KalmanStateBank::start(int slot, const std::array<float, 4>& z) {
+    // Initialize state from bbox [x, y, s, r, vx, vy, vs]
+    Mat<7, 1> x;
+    x(0, 0) = z[0];  // x (center)
+    x(1, 0) = z[1];  // y (center)
+    x(2, 0) = z[2];  // s (area)
+    x(3, 0) = z[3];  // r (aspect ratio)
+    // vx, vy, vs start at 0
+
+    // Initial state covariance P (SORT / OC-SORT defaults)
+    // Matches official: P[4:,4:] *= 1000; P *= 10
+    Mat<7, 7> P = Mat<7, 7>::Identity();
+    P(4, 4) *= 1000.0f;
+    P(5, 5) *= 1000.0f;
+    P(6, 6) *= 1000.0f;
+    for (int i = 0; i < 7; ++i) {
+        P(i, i) *= 10.0f;
     }
-    return result;
+    set(slot, x, P);
 }
 
-Matrix Matrix::transpose() const {
-    Matrix result(cols_, rows_);
-    for (int i = 0; i < rows_; ++i) {
-        for (int j = 0; j < cols_; ++j) {
-            result(j, i) = (*this)(i, j);
-        }
-    }
-    return result;
+Mat<7, 1> KalmanStateBank::state(int slot) const {
+    Mat<7, 1> x;
+    for (int i = 0; i < kStateDim; ++i) x(i, 0) = x_[i][slot];
+    return x;
 }
 
-void Matrix::setIdentity() {
-    setZero();
-    int n = std::min(rows_, cols_);
-    for (int i = 0; i < n; ++i) {
-        (*this)(i, i) = 1.0f;
+Mat<7, 7> KalmanStateBank::covariance(int slot) const {
+    Mat<7, 7> P;
+    for (int r = 0; r < kStateDim; ++r) {
+        for (int c = 0; c < kStateDim; ++c) P(r, c) = P_[r * kStateDim + c][slot];
     }
+    return P;
 }
 
-void Matrix::setZero() {
-    std::fill(data_.begin(), data_.end(), 0.0f);
+void KalmanStateBank::set(int slot, const Mat<7, 1>& x, const Mat<7, 7>& P) {
+    for (int i = 0; i < kStateDim; ++i) x_[i][slot] = x(i, 0);
+    for (int r = 0; r < kStateDim; ++r) {
+        for (int c = 0; c < kStateDim; ++c) P_[r * kStateDim + c][slot] = P(r, c);
+    }
 }
 
-std::vector<float> Matrix::getCol(int c) const {
-    std::vector<float> col(rows_);
-    for (int i = 0; i < rows_; ++i) {
-        col[i] = (*this)(i, c);
-    }
-    return col;
+void KalmanStateBank::predict(int slot) {
+    predictRange(slot, slot + 1);
 }
 
-void Matrix::setCol(int c, const std::vector<float>& v) {
-    for (int i = 0; i < rows_ && i < static_cast<int>(v.size()); ++i) {
-        (*this)(i, c) = v[i];
-    }
+void KalmanStateBank::predictAll() {
+    predictRange(0, size_);
 }
 
-// Gauss-Jordan elimination for matrix inverse (works for small matrices)
-Matrix Matrix::inverse() const {
-    if (rows_ != cols_) {
-        throw std::invalid_argument("Cannot invert non-square matrix");
+void KalmanStateBank::predictRange(int begin, int end) {
+    // F is the identity plus x += vx, y += vy, s += vs, so x = F * x and
+    // P = F * P * F' + Q reduce to adding rows and columns 4-6 onto 0-2.
+    // The terms F's zeros drop are exact zeros, so this matches the full
+    // products bit for bit.
+    float* s = x_[2].data();
+    float* vs = x_[6].data();
+    for (int i = begin; i < end; ++i) {
+        // Handle potential negative scale prediction
+        if (vs[i] + s[i] <= 0) vs[i] = 0.0f;
     }
-    
-    int n = rows_;
-    Matrix aug(n, 2 * n);
-    
-    // Create augmented matrix [A | I]
-    for (int i = 0; i < n; ++i) {
-        for (int j = 0; j < n; ++j) {
-            aug(i, j) = (*this)(i, j);
+    for (int k = 0; k < 3; ++k) {
+        float* d = x_[k].data();
+        const float* v = x_[k + 4].data();
+        for (int i = begin; i < end; ++i) d[i] += v[i];
+    }
+    // F * P
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < kStateDim; ++c) {
+            float* d = P_[r * kStateDim + c].data();
+            const float* a = P_[(r + 4) * kStateDim + c].data();
+            for (int i = begin; i < end; ++i) d[i] += a[i];
         }
-        aug(i, n + i) = 1.0f;
     }
-    
-    // Forward elimination with partial pivoting
-    for (int col = 0; col < n; ++col) {
-        // Find pivot
-        int maxRow = col;
-        float maxVal = std::abs(aug(col, col));
-        for (int row = col + 1; row < n; ++row) {
-            if (std::abs(aug(row, col)) > maxVal) {
-                maxVal = std::abs(aug(row, col));
-                maxRow = row;
-            }
+    // (F * P) * F'
+    for (int r = 0; r < kStateDim; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            float* d = P_[r * kStateDim + c].data();
+            const float* a = P_[r * kStateDim + c + 4].data();
+            for (int i = begin; i < end; ++i) d[i] += a[i];
         }
-        
-        // Swap rows
-        if (maxRow != col) {
-            for (int j = 0; j < 2 * n; ++j) {
-                std::swap(aug(col, j), aug(maxRow, j));
+    }
+    // + Q (diagonal)
+    const Mat<7, 7>& Q = Model().Q;
+    for (int k = 0; k < kStateDim; ++k) {
+        float* d = P_[k * kStateDim + k].data();
+        const float q = Q(k, k);
+        for (int i = begin; i < end; ++i) d[i] += q;
+    }
+}
+
+void KalmanStateBank::update(int slot, const std::array<float, 4>& z_arr) {
+    // H selects the first four states, so H * x, H * P * H' and P * H' are
+    // slices of x and P, and S = P[0:4, 0:4] + R is solved by Cholesky
+    // rather than inverted.
+    constexpr int n = kStateDim;
+    const Mat<4, 4>& R = Model().R;
+    Mat<n, 1> x = state(slot);
+    Mat<n, n> P = covariance(slot);
+
+    // y = z - H * x (innovation)
+    float y[4];
+    for (int i = 0; i < 4; ++i) y[i] = z_arr[static_cast<size_t>(i)] - x(i, 0);
+
+    // S = H * P * H' + R = L * L' (innovation covariance)
+    float L[4][4] = {};
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            float sum = P(i, j) + R(i, j);
+            for (int k = 0; k < j; ++k) sum -= L[i][k] * L[j][k];
+            if (i == j) {
+                // S is P's positive block plus R's positive diagonal; the
+                // floor only guards against a corrupted covariance.
+                L[i][i] = std::sqrt(std::max(sum, 1e-12f));
+            } else {
+                L[i][j] = sum / L[j][j];
             }
         }
-        
-        // Check for singular matrix
-        float pivot = aug(col, col);
-        if (std::abs(pivot) < 1e-10f) {
-            // Near-singular matrix, add small regularization
-            pivot = 1e-6f;
-            aug(col, col) = pivot;
+    }
+
+    // K = P * H' * S^-1, from S * K' = H * P (P symmetric): one forward
+    // and one back substitution per state.
+    Mat<n, 4> K;
+    for (int c = 0; c < n; ++c) {
+        float t[4];
+        for (int i = 0; i < 4; ++i) {
+            float sum = P(i, c);
+            for (int k = 0; k < i; ++k) sum -= L[i][k] * t[k];
+            t[i] = sum / L[i][i];
         }
-        
-        // Scale pivot row
-        for (int j = 0; j < 2 * n; ++j) {
-            aug(col, j) /= pivot;
-        }
-        
-        // Eliminate column
-        for (int row = 0; row < n; ++row) {
-            if (row != col) {
-                float factor = aug(row, col);
-                for (int j = 0; j < 2 * n; ++j) {
-                    aug(row, j) -= factor * aug(col, j);
-                }
-            }
+        for (int i = 3; i >= 0; --i) {
+            float sum = t[i];
+            for (int k = i + 1; k < 4; ++k) sum -= L[k][i] * K(c, k);
+            K(c, i) = sum / L[i][i];
         }
     }
-    
-    // Extract inverse from right half
-    Matrix inv(n, n);
-    for (int i = 0; i < n; ++i) {
-        for (int j = 0; j < n; ++j) {
-            inv(i, j) = aug(i, n + j);
+
+    // x = x + K * y (state update)
+    for (int r = 0; r < n; ++r) {
+        x(r, 0) += K(r, 0) * y[0] + K(r, 1) * y[1] + K(r, 2) * y[2] + K(r, 3) * y[3];
+    }
+
+    if (joseph_) {
+        // P = (I - K * H) * P * (I - K * H)' + K * R * K'
+        Mat<n, n> A = Mat<n, n>::Identity();
+        for (int r = 0; r < n; ++r) {
+            for (int c = 0; c < 4; ++c) A(r, c) -= K(r, c);
+        }
+        P = A * P * A.transpose() + K * R * K.transpose();
+    } else {
+        // P = (I - K * H) * P = P - K * P[0:4, :]
+        Mat<n, n> out;
+        for (int r = 0; r < n; ++r) {
+            for (int c = 0; c < n; ++c) {
+                out(r, c) = P(r, c) - (K(r, 0) * P(0, c) + K(r, 1) * P(1, c) + K(r, 2) * P(2, c) + K(r, 3) * P(3, c));
+            }
         }
+        P = out;
     }
-    
-    return inv;
+    set(slot, x, P);
 }
 
-// =============================================================================
-// BBox Implementation
-// =============================================================================
+void KalmanStateBank::warp(int slot, const Mat3f& warp, int frame_width, int frame_height) {
+    if (frame_width <= 0 || frame_height <= 0) return;
 
-float BBox::iou(const BBox& other) const {
-    float ix1 = std::max(x1, other.x1);
-    float iy1 = std::max(y1, other.y1);
-    float ix2 = std::min(x2, other.x2);
-    float iy2 = std::min(y2, other.y2);
-    
-    if (ix2 < ix1 || iy2 < iy1) {
-        return 0.0f;
+    // Warp current KF state bbox (normalized), then rewrite (x,y,s,r).
+    const KalmanBoxTracker::Measurement cur = {x_[0][slot], x_[1][slot], x_[2][slot], x_[3][slot]};
+    const BBox warped = warp_bbox_norm(KalmanBoxTracker::measurementToBbox(cur), warp, frame_width, frame_height);
+    const KalmanBoxTracker::Measurement z = KalmanBoxTracker::bboxToMeasurement(warped);
+    for (int k = 0; k < 4; ++k) x_[k][slot] = z[k];
+
+    // Approximate velocity transform using affine part (ignore projective terms).
+    const float vx_px = x_[4][slot] * static_cast<float>(frame_width);
+    const float vy_px = x_[5][slot] * static_cast<float>(frame_height);
+    const float nvx_px = warp(0, 0) * vx_px + warp(0, 1) * vy_px;
+    const float nvy_px = warp(1, 0) * vx_px + warp(1, 1) * vy_px;
+    x_[4][slot] = nvx_px / static_cast<float>(frame_width);
+    x_[5][slot] = nvy_px / static_cast<float>(frame_height);
+
+    // Scale vs by local area scale (determinant of 2x2 affine part).
+    const float detA = warp(0, 0) * warp(1, 1) - warp(0, 1) * warp(1, 0);
+    if (std::isfinite(detA) && detA > 0.0f) {
+        x_[6][slot] *= detA;
     }
-    
-    float intersection = (ix2 - ix1) * (iy2 - iy1);
-    float union_area = area() + other.area() - intersection;
-    
-    return union_area > 0 ? intersection / union_area : 0.0f;
+}
+
+void KalmanStateBank::warpAll(const Mat3f& warp, int frame_width, int frame_height) {
+    for (int slot = 0; slot < size_; ++slot) this->warp(slot, warp, frame_width, frame_height);
 }
 
 // =============================================================================
 // KalmanBoxTracker Implementation
 // =============================================================================
 
-KalmanBoxTracker::KalmanBoxTracker(const Detection& det, int track_id, int delta_t)
+KalmanBoxTracker::KalmanBoxTracker(const Detection& det, int track_id, int delta_t,
+                                   float min_reid_quality, KalmanStateBank* bank)
     : track_id_(track_id),
       time_since_update_(0),
       hits_(1),
       hit_streak_(1),
       age_(0),
       delta_t_(delta_t),
-      x_(7, 1),
-      P_(7, 7),
-      F_(7, 7),
-      H_(4, 7),
-      Q_(7, 7),
-      R_(4, 4) {
-    
-    // Initialize state from bbox [x, y, s, r, vx, vy, vs]
-    auto z = bboxToMeasurement(det.bbox);
-    x_(0, 0) = z[0];  // x (center)
-    x_(1, 0) = z[1];  // y (center)
-    x_(2, 0) = z[2];  // s (area)
-    x_(3, 0) = z[3];  // r (aspect ratio)
-    x_(4, 0) = 0.0f;  // vx
-    x_(5, 0) = 0.0f;  // vy
-    x_(6, 0) = 0.0f;  // vs
-    
-    // State transition matrix F (constant velocity model)
-    // x' = x + vx, y' = y + vy, s' = s + vs, r' = r
-    F_.setIdentity();
-    F_(0, 4) = 1.0f;  // x += vx
-    F_(1, 5) = 1.0f;  // y += vy
-    F_(2, 6) = 1.0f;  // s += vs
-    
-    // Measurement matrix H (observe x, y, s, r)
-    H_.setZero();
-    H_(0, 0) = 1.0f;
-    H_(1, 1) = 1.0f;
-    H_(2, 2) = 1.0f;
-    H_(3, 3) = 1.0f;
-    
-    // Process noise covariance Q (SORT / OC-SORT defaults)
-    // Matches official: Q[-1,-1]*=0.01; Q[4:,4:]*=0.01
-    Q_.setIdentity();
-    Q_(6, 6) *= 0.01f;
-    Q_(4, 4) *= 0.01f;
-    Q_(5, 5) *= 0.01f;
-    Q_(6, 6) *= 0.01f;  // applied twice as in the official implementation
-    
-    // Measurement noise covariance R (SORT / OC-SORT defaults)
-    // Matches official: R[2:,2:] *= 10
-    R_.setIdentity();
-    R_(2, 2) *= 10.0f;
-    R_(3, 3) *= 10.0f;
-    
-    // Initial state covariance P (SORT / OC-SORT defaults)
-    // Matches official: P[4:,4:] *= 1000; P *= 10
-    P_.setIdentity();
-    P_(4, 4) *= 1000.0f;
-    P_(5, 5) *= 1000.0f;
-    P_(6, 6) *= 1000.0f;
-    for (int i = 0; i < 7; ++i) {
-        P_(i, i) *= 10.0f;
-    }
+      min_reid_quality_(min_reid_quality),
+      own_bank_(bank ? nullptr : std::make_unique<KalmanStateBank>()),
+      bank_(bank ? bank : own_bank_.get()),
+      slot_(bank_->acquire()),
+      observations_(static_cast<size_t>(std::max(1, delta_t))) {
+    start(det);
+}
+
+void KalmanBoxTracker::reinit(const Detection& det, int track_id, int delta_t, float min_reid_quality) {
+    track_id_ = track_id;
+    time_since_update_ = 0;
+    hits_ = 1;
+    hit_streak_ = 1;
+    age_ = 0;
+    delta_t_ = delta_t;
+    min_reid_quality_ = min_reid_quality;
+    if (slot_ < 0) slot_.index = bank_->acquire();
+    if (observations_.capacity() != static_cast<size_t>(std::max(1, delta_t))) {
+        observations_ = RingBuffer<AgedObservation>(static_cast<size_t>(std::max(1, delta_t)));
+    }
+    observations_.clear();
+    appearance_.clear();
+    has_appearance_ = false;
+    appearance_bank_q_.fill(0.0f);
+    appearance_dim_ = 0;
+    appearance_bank_size_ = 0;
+    observations_since_reid_ = 0;
+    oru_samples_.clear();
+    oru_steps_ = 0;
+    history_warp_ = Mat3f::Identity();
+    history_warped_ = false;
+    history_width_ = 0;
+    history_height_ = 0;
+    start(det);
+}
+
+void KalmanBoxTracker::retire() {
+    if (slot_ >= 0) bank_->release(slot_);
+    slot_.index = -1;
+}
+
+void KalmanBoxTracker::start(const Detection& det) {
+    const Measurement z = bboxToMeasurement(det.bbox);
+    bank_->start(slot_, z);
+    observed_pos_var_ = bank_->P(slot_, 0, 0) + bank_->P(slot_, 1, 1);
 
     // OC-SORT observation state
-    last_observation_ = det;
-    observations_by_age_[age_] = det;
+    last_observation_.emplace(det);
+    observations_.push({age_, TrackObservation(det)});
     velocity_dir_.reset();
 
-    if (det.has_reid && det.reid_quality >= kMinReidUpdateQuality) {
+    if (det.has_reid && !det.reid.empty() && det.reid_quality >= min_reid_quality_) {
         // Seed appearance bank with the first high-quality sample.
-        appearance_bank_[0] = det.reid;
-        l2_normalize(appearance_bank_[0]);
+        storeAppearanceSample(0, det.reid);
         appearance_bank_q_[0] = std::max(0.0f, det.reid_quality);
         appearance_bank_size_ = 1;
-        appearance_ = appearance_bank_[0];
+        appearance_.assign(appearance_bank_.begin(), appearance_bank_.begin() + appearance_dim_);
         has_appearance_ = true;
     }
 
     // ORU history starts with the initial observation
-    oru_history_.push_back(z);
+    oru_samples_.push({oru_steps_++, z});
     oru_observed_ = true;
-    oru_saved_x_ = x_;
-    oru_saved_P_ = P_;
+    oru_saved_x_ = bank_->state(slot_);
+    oru_saved_P_ = bank_->covariance(slot_);
     oru_saved_age_ = age_;
 }
 
+KalmanBoxTracker::~KalmanBoxTracker() {
+    retire();
+}
+
+void KalmanBoxTracker::storeAppearanceSample(int slot, const EmbeddingF32& reid) {
+    if (appearance_dim_ == 0) {
+        appearance_dim_ = static_cast<int>(reid.size());
+        appearance_bank_.assign(static_cast<size_t>(kAppearanceBankK) * reid.size(), 0.0f);
+    }
+    // Normalize in place in the bank, like the prototype.
+    EmbeddingF32 v = reid;
+    L2Normalize(v);
+    std::copy(v.begin(), v.end(), appearance_bank_.begin() + static_cast<size_t>(slot) * v.size());
+}
+
 BBox KalmanBoxTracker::predict() {
-    predictKF();
+    bank_->predict(slot_);
+    markPredicted();
+    return getState();
+}
+
+void KalmanBoxTracker::markPredicted() {
     age_++;
     if (time_since_update_ > 0) {
         hit_streak_ = 0;
     }
     time_since_update_++;
-    
-    return getState();
 }
 
 void KalmanBoxTracker::update(const std::optional<Detection>& det) {
     if (!det.has_value()) {
         // No observation this frame (unmatched track)
-        oru_history_.push_back(std::nullopt);
+        oru_steps_++;
         oru_observed_ = false;
         return;
     }
 
-    // Observation present
+    // Observation present: history is read below, bring it to this frame.
+    flushHistoryWarp();
     const Detection& d = *det;
     Measurement z_arr = bboxToMeasurement(d.bbox);
-    oru_history_.push_back(z_arr);
+    oru_samples_.push({oru_steps_++, z_arr});
 
     if (!oru_observed_) {
         // Track was unobserved; re-activation triggers ORU
@@ -376,16 +499,8 @@ void KalmanBoxTracker::update(const std::optional<Detection>& det) {
 
     // Compute inertia direction (dy, dx) using observations delta_t steps apart
     if (last_observation_.has_value() && last_observation_->score >= 0.0f) {
-        Detection prev = *last_observation_;
-        for (int i = 0; i < delta_t_; ++i) {
-            int dt = delta_t_ - i;
-            auto it = observations_by_age_.find(age_ - dt);
-            if (it != observations_by_age_.end()) {
-                prev = it->second;
-                break;
-            }
-        }
-        velocity_dir_ = speedDirection(prev.bbox, d.bbox);
+        const TrackObservation* o = oldestObservationSince(age_ - delta_t_);
+        velocity_dir_ = speedDirection(o ? o->bbox : last_observation_->bbox, d.bbox);
     }
 
     // Update track counters
@@ -394,13 +509,19 @@ void KalmanBoxTracker::update(const std::optional<Detection>& det) {
     hit_streak_++;
 
     // Store observation state for OCR/OCM
-    last_observation_ = d;
-    observations_by_age_[age_] = d;
+    last_observation_.emplace(d);
+    if (!observations_.empty() && observations_.back().age == age_) {
+        observations_.back().obs = TrackObservation(d);
+    } else {
+        observations_.push({age_, TrackObservation(d)});
+    }
 
     // Update appearance: keep only the best few samples (avoid drift from bad crops).
-    if (d.has_reid) {
+    observations_since_reid_ = d.has_reid ? 0 : observations_since_reid_ + 1;
+    // An embedding of another length (a different model) cannot join the bank.
+    if (d.has_reid && !d.reid.empty() && (appearance_dim_ == 0 || static_cast<int>(d.reid.size()) == appearance_dim_)) {
         const float q = std::max(0.0f, d.reid_quality);
-        if (q >= kMinReidUpdateQuality) {
+        if (q >= min_reid_quality_) {
             // Insert into bank if it improves the set.
             int insert_at = -1;
             if (appearance_bank_size_ < kAppearanceBankK) {
@@ -418,114 +539,121 @@ void KalmanBoxTracker::update(const std::optional<Detection>& det) {
             }
 
             if (insert_at >= 0) {
-                appearance_bank_[insert_at] = d.reid;
-                l2_normalize(appearance_bank_[insert_at]);
+                storeAppearanceSample(insert_at, d.reid);
                 appearance_bank_q_[insert_at] = q;
 
                 // Recompute prototype as a quality-weighted mean.
-                std::array<float, Detection::kReidDim> proto{};
+                const size_t dim = static_cast<size_t>(appearance_dim_);
+                EmbeddingF32 proto(dim, 0.0f);
                 double wsum = 0.0;
                 for (int i = 0; i < appearance_bank_size_; ++i) {
                     const double w = static_cast<double>(std::max(0.0f, appearance_bank_q_[i]));
                     wsum += w;
-                    for (int k = 0; k < Detection::kReidDim; ++k) {
-                        proto[k] += static_cast<float>(w * static_cast<double>(appearance_bank_[i][k]));
+                    const float* sample = appearance_bank_.data() + static_cast<size_t>(i) * dim;
+                    for (size_t k = 0; k < dim; ++k) {
+                        proto[k] += static_cast<float>(w * static_cast<double>(sample[k]));
                     }
                 }
                 if (wsum <= 1e-9) {
-                    proto = appearance_bank_[0];
+                    proto.assign(appearance_bank_.begin(), appearance_bank_.begin() + appearance_dim_);
                 }
-                l2_normalize(proto);
-                appearance_ = proto;
+                L2Normalize(proto);
+                appearance_ = std::move(proto);
                 has_appearance_ = true;
             } else if (!has_appearance_) {
                 // Should be rare: if bank is empty but we rejected insert (e.g. q==0).
-                appearance_bank_[0] = d.reid;
-                l2_normalize(appearance_bank_[0]);
+                storeAppearanceSample(0, d.reid);
                 appearance_bank_q_[0] = q;
                 appearance_bank_size_ = 1;
-                appearance_ = appearance_bank_[0];
+                appearance_.assign(appearance_bank_.begin(), appearance_bank_.begin() + appearance_dim_);
                 has_appearance_ = true;
             }
         }
     }
 
     // Standard KF update with the real measurement
-    updateKF(z_arr);
+    bank_->update(slot_, z_arr);
+    observed_pos_var_ = bank_->P(slot_, 0, 0) + bank_->P(slot_, 1, 1);
 
     // Save state snapshot for future ORU rollback
-    oru_saved_x_ = x_;
-    oru_saved_P_ = P_;
+    oru_saved_x_ = bank_->state(slot_);
+    oru_saved_P_ = bank_->covariance(slot_);
     oru_saved_age_ = age_;
     oru_observed_ = true;
 }
 
+float KalmanBoxTracker::covarianceGrowth() const {
+    return (bank_->P(slot_, 0, 0) + bank_->P(slot_, 1, 1)) / std::max(observed_pos_var_, 1e-6f);
+}
+
 BBox KalmanBoxTracker::getState() const {
     Measurement z = {
-        x_(0, 0),  // x
-        x_(1, 0),  // y
-        x_(2, 0),  // s
-        x_(3, 0)   // r
+        bank_->x(slot_, 0),  // x
+        bank_->x(slot_, 1),  // y
+        bank_->x(slot_, 2),  // s
+        bank_->x(slot_, 3)   // r
     };
     return measurementToBbox(z);
 }
 
 void KalmanBoxTracker::applyWarp(const Mat3f& warp, int frame_width, int frame_height) {
     if (frame_width <= 0 || frame_height <= 0) return;
+    bank_->warp(slot_, warp, frame_width, frame_height);
+    warpHistory(warp, frame_width, frame_height);
+}
 
-    // Warp current KF state bbox (normalized), then rewrite (x,y,s,r).
-    const BBox cur = getState();
-    const BBox warped = warp_bbox_norm(cur, warp, frame_width, frame_height);
-    const Measurement z = bboxToMeasurement(warped);
-    x_(0, 0) = z[0];
-    x_(1, 0) = z[1];
-    x_(2, 0) = z[2];
-    x_(3, 0) = z[3];
-
-    // Approximate velocity transform using affine part (ignore projective terms).
-    const float vx_px = x_(4, 0) * static_cast<float>(frame_width);
-    const float vy_px = x_(5, 0) * static_cast<float>(frame_height);
-    const float nvx_px = warp(0, 0) * vx_px + warp(0, 1) * vy_px;
-    const float nvy_px = warp(1, 0) * vx_px + warp(1, 1) * vy_px;
-    x_(4, 0) = nvx_px / static_cast<float>(frame_width);
-    x_(5, 0) = nvy_px / static_cast<float>(frame_height);
-
-    // Scale vs by local area scale (determinant of 2x2 affine part).
-    const float detA = warp(0, 0) * warp(1, 1) - warp(0, 1) * warp(1, 0);
-    if (std::isfinite(detA) && detA > 0.0f) {
-        x_(6, 0) *= detA;
+void KalmanBoxTracker::warpHistory(const Mat3f& warp, int frame_width, int frame_height) {
+    if (frame_width <= 0 || frame_height <= 0) return;
+    if (history_warped_ && (frame_width != history_width_ || frame_height != history_height_)) {
+        flushHistoryWarp();  // pixel warps of different frame sizes do not compose
     }
+    history_warp_ = history_warped_ ? Compose(warp, history_warp_) : warp;
+    history_warped_ = true;
+    history_width_ = frame_width;
+    history_height_ = frame_height;
+    velocity_dir_.reset();
+}
+
+BBox KalmanBoxTracker::historyToCurrent(const BBox& b) const {
+    return history_warped_ ? warp_bbox_norm(b, history_warp_, history_width_, history_height_) : b;
+}
 
+void KalmanBoxTracker::flushHistoryWarp() {
+    if (!history_warped_) return;
     // Transport observation state forward as well (OCR/OCM/ORU benefit from GMC).
     if (last_observation_.has_value() && last_observation_->score >= 0.0f) {
-        last_observation_->bbox = warp_bbox_norm(last_observation_->bbox, warp, frame_width, frame_height);
+        last_observation_->bbox = historyToCurrent(last_observation_->bbox);
     }
-    for (auto& kv : observations_by_age_) {
-        if (kv.second.score >= 0.0f) {
-            kv.second.bbox = warp_bbox_norm(kv.second.bbox, warp, frame_width, frame_height);
+    for (size_t i = 0; i < observations_.size(); ++i) {
+        TrackObservation& o = observations_[i].obs;
+        if (o.score >= 0.0f) {
+            o.bbox = historyToCurrent(o.bbox);
         }
     }
 
-    for (auto& opt : oru_history_) {
-        if (!opt.has_value()) continue;
-        const BBox hb = measurementToBbox(*opt);
-        const BBox hw = warp_bbox_norm(hb, warp, frame_width, frame_height);
-        *opt = bboxToMeasurement(hw);
+    for (size_t i = 0; i < oru_samples_.size(); ++i) {
+        Measurement& z = oru_samples_[i].z;
+        z = bboxToMeasurement(historyToCurrent(measurementToBbox(z)));
     }
 
     if (oru_saved_x_.has_value()) {
         // Keep ORU rollback state in the same (camera-compensated) coordinate system.
         Measurement saved = {(*oru_saved_x_)(0, 0), (*oru_saved_x_)(1, 0), (*oru_saved_x_)(2, 0), (*oru_saved_x_)(3, 0)};
-        const BBox sb = measurementToBbox(saved);
-        const BBox sw = warp_bbox_norm(sb, warp, frame_width, frame_height);
-        const Measurement zs = bboxToMeasurement(sw);
+        const Measurement zs = bboxToMeasurement(historyToCurrent(measurementToBbox(saved)));
         (*oru_saved_x_)(0, 0) = zs[0];
         (*oru_saved_x_)(1, 0) = zs[1];
         (*oru_saved_x_)(2, 0) = zs[2];
         (*oru_saved_x_)(3, 0) = zs[3];
     }
 
-    velocity_dir_.reset();
+    history_warp_ = Mat3f::Identity();
+    history_warped_ = false;
+}
+
+std::optional<BBox> KalmanBoxTracker::lastObservedBox() const {
+    if (!last_observation_.has_value()) return std::nullopt;
+    if (last_observation_->score < 0.0f) return last_observation_->bbox;
+    return historyToCurrent(last_observation_->bbox);
 }
 
 std::array<float, 2> KalmanBoxTracker::velocityDir() const {
@@ -535,61 +663,34 @@ std::array<float, 2> KalmanBoxTracker::velocityDir() const {
     return *velocity_dir_;
 }
 
-Detection KalmanBoxTracker::kPreviousObservation(int k) const {
+TrackObservation KalmanBoxTracker::kPreviousObservation(int k) const {
     // Placeholder: score < 0 indicates invalid
-    Detection placeholder{BBox{-1.0f, -1.0f, -1.0f, -1.0f}, -1.0f};
-    if (observations_by_age_.empty()) {
-        return placeholder;
+    if (observations_.empty()) {
+        return TrackObservation(BBox{-1.0f, -1.0f, -1.0f, -1.0f}, -1.0f);
     }
 
-    for (int i = 0; i < k; ++i) {
-        int dt = k - i;
-        auto it = observations_by_age_.find(age_ - dt);
-        if (it != observations_by_age_.end()) {
-            return it->second;
-        }
-    }
-    // Return the most recent observation
-    return observations_by_age_.rbegin()->second;
+    // The oldest observation within k steps, else the most recent one
+    const TrackObservation* o = oldestObservationSince(age_ - k);
+    TrackObservation out = o ? *o : observations_.back().obs;
+    if (out.score >= 0.0f) out.bbox = historyToCurrent(out.bbox);
+    return out;
 }
 
-void KalmanBoxTracker::predictKF() {
-    // Handle potential negative scale prediction
-    if ((x_(6, 0) + x_(2, 0)) <= 0) {
-        x_(6, 0) = 0.0f;
-    }
-
-    // Predict state: x = F * x
-    x_ = F_ * x_;
-
-    // Predict covariance: P = F * P * F' + Q
-    P_ = F_ * P_ * F_.transpose() + Q_;
+std::optional<BBox> KalmanBoxTracker::kPreviousObservedBox(int k) const {
+    if (observations_.empty()) return std::nullopt;
+    const TrackObservation* o = oldestObservationSince(age_ - k);
+    const TrackObservation& d = o ? *o : observations_.back().obs;
+    if (d.score < 0.0f) return std::nullopt;
+    return historyToCurrent(d.bbox);
 }
 
-void KalmanBoxTracker::updateKF(const Measurement& z_arr) {
-    Matrix z(4, 1);
-    z(0, 0) = z_arr[0];
-    z(1, 0) = z_arr[1];
-    z(2, 0) = z_arr[2];
-    z(3, 0) = z_arr[3];
-
-    // Kalman update equations
-    // y = z - H * x (innovation)
-    Matrix y = z - H_ * x_;
-
-    // S = H * P * H' + R (innovation covariance)
-    Matrix S = H_ * P_ * H_.transpose() + R_;
-
-    // K = P * H' * S^-1 (Kalman gain)
-    Matrix K = P_ * H_.transpose() * S.inverse();
-
-    // x = x + K * y (state update)
-    x_ = x_ + K * y;
-
-    // P = (I - K * H) * P (covariance update)
-    Matrix I(7, 7);
-    I.setIdentity();
-    P_ = (I - K * H_) * P_;
+const TrackObservation* KalmanBoxTracker::oldestObservationSince(int min_age) const {
+    // Ages ascend, so the first one at or past min_age is the oldest in range.
+    for (size_t i = 0; i < observations_.size(); ++i) {
+        const int age = observations_[i].age;
+        if (age >= min_age) return age < age_ ? &observations_[i].obs : nullptr;
+    }
+    return nullptr;
 }
 
 void KalmanBoxTracker::maybeRunORU(const Measurement& current_meas) {
@@ -597,34 +698,21 @@ void KalmanBoxTracker::maybeRunORU(const Measurement& current_meas) {
         return;
     }
 
-    // Find the last two real observations in history (previous + current)
-    int idx2 = -1;
-    int idx1 = -1;
-    for (int i = static_cast<int>(oru_history_.size()) - 1; i >= 0; --i) {
-        if (oru_history_[i].has_value()) {
-            if (idx2 < 0) {
-                idx2 = i;
-            } else {
-                idx1 = i;
-                break;
-            }
-        }
-    }
-    if (idx1 < 0 || idx2 < 0) {
+    // The last two real observations (previous + current)
+    if (oru_samples_.size() < 2) {
         return;
     }
 
-    const int gap = idx2 - idx1;
+    const int gap = oru_samples_[1].step - oru_samples_[0].step;
     if (gap < 2) {
         // No missing steps between observations
         return;
     }
 
-    const Measurement& prev_meas = *oru_history_[idx1];
+    const Measurement& prev_meas = oru_samples_[0].z;
 
     // Restore KF to last observed state (paper: rollback to last matched obs)
-    x_ = *oru_saved_x_;
-    P_ = *oru_saved_P_;
+    bank_->set(slot_, *oru_saved_x_, *oru_saved_P_);
 
     // Interpolate a virtual trajectory for intermediate timesteps (t1 < t < t2)
     float x1, y1, w1, h1;
@@ -640,12 +728,12 @@ void KalmanBoxTracker::maybeRunORU(const Measurement& current_meas) {
         const float hi = h1 + alpha * (h2 - h1);
 
         // Step forward one frame, then correct with virtual observation
-        predictKF();
-        updateKF(xywhToMeasurement(xi, yi, wi, hi));
+        bank_->predict(slot_);
+        bank_->update(slot_, xywhToMeasurement(xi, yi, wi, hi));
     }
 
     // Finally, predict to the current frame; the caller will apply the real update
-    predictKF();
+    bank_->predict(slot_);
 }
 
 KalmanBoxTracker::Measurement KalmanBoxTracker::bboxToMeasurement(const BBox& bbox) {
@@ -695,3 +783,161 @@ std::array<float, 2> KalmanBoxTracker::speedDirection(const BBox& from, const BB
     const float norm = std::sqrt(dx * dx + dy * dy) + 1e-6f;
     return {dy / norm, dx / norm};
 }
+
+// =============================================================================
+// FixedLagSmoother Implementation
+// =============================================================================
+
+void FixedLagSmoother::smooth(const std::vector<int>& frames, const std::vector<char>& observed,
+                              std::vector<BBox>& boxes) {
+    const int n = static_cast<int>(boxes.size());
+    int first = -1, count = 0;
+    for (int k = 0; k < n; ++k) {
+        if (!observed[k]) continue;
+        if (first < 0) first = k;
+        count++;
+    }
+    if (count < 2) return;
+
+    // Forward pass: the tracker's filter, observed boxes as measurements.
+    x_filt_.resize(n);
+    x_pred_.resize(n);
+    P_filt_.resize(n);
+    gain_.resize(n);
+    const int slot = bank_.acquire();
+    bank_.start(slot, KalmanBoxTracker::bboxToMeasurement(boxes[first]));
+    x_filt_[first] = x_pred_[first] = bank_.state(slot);
+    P_filt_[first] = bank_.covariance(slot);
+    const Mat<7, 7>& F = Model().F;
+    for (int k = first + 1; k < n; ++k) {
+        // F^steps across skipped frames: velocities add once per frame.
+        Mat<7, 7> F_gap = Mat<7, 7>::Identity();
+        for (int step = frames[k - 1]; step < frames[k]; ++step) {
+            bank_.predict(slot);
+            F_gap = F * F_gap;
+        }
+        x_pred_[k] = bank_.state(slot);
+        gain_[k - 1] = P_filt_[k - 1] * F_gap.transpose() * bank_.covariance(slot).inverse();
+        if (observed[k]) bank_.update(slot, KalmanBoxTracker::bboxToMeasurement(boxes[k]));
+        x_filt_[k] = bank_.state(slot);
+        P_filt_[k] = bank_.covariance(slot);
+    }
+    bank_.release(slot);
+
+    // Backward pass, restarted at most `lag_` boxes ahead of each box.
+    for (int k = first; k < n; ++k) {
+        const int end = std::min(n - 1, k + lag_);
+        Mat<7, 1> x = x_filt_[end];
+        for (int j = end - 1; j >= k; --j) {
+            x = x_filt_[j] + gain_[j] * (x - x_pred_[j + 1]);
+        }
+        if (!(x(2, 0) > 0.0f) || !(x(3, 0) > 0.0f)) continue;  // degenerate scale or aspect
+        boxes[k] = KalmanBoxTracker::measurementToBbox({x(0, 0), x(1, 0), x(2, 0), x(3, 0)});
+    }
+}
+
+// =============================================================================
+// KalmanBoxTracker checkpoints
+// =============================================================================
+
+void KalmanBoxTracker::save(CheckpointWriter& w) const {
+    w.put(track_id_);
+    w.put(time_since_update_);
+    w.put(hits_);
+    w.put(hit_streak_);
+    w.put(age_);
+    w.put(delta_t_);
+    w.put(min_reid_quality_);
+    w.put(bank_->state(slot_));
+    w.put(bank_->covariance(slot_));
+
+    w.put(last_observation_.has_value());
+    if (last_observation_) w.put(*last_observation_);
+    w.put(static_cast<uint32_t>(observations_.size()));
+    for (size_t i = 0; i < observations_.size(); ++i) {
+        w.put(observations_[i].age);
+        w.put(observations_[i].obs);
+    }
+    PutOptional(w, velocity_dir_);
+
+    w.putVector(appearance_);
+    w.put(has_appearance_);
+    w.putVector(appearance_bank_);
+    w.put(appearance_bank_q_);
+    w.put(appearance_dim_);
+    w.put(appearance_bank_size_);
+    w.put(observations_since_reid_);
+
+    w.put(static_cast<uint32_t>(oru_samples_.size()));
+    for (size_t i = 0; i < oru_samples_.size(); ++i) w.put(oru_samples_[i]);
+    w.put(oru_steps_);
+    w.put(oru_observed_);
+    PutOptional(w, oru_saved_x_);
+    PutOptional(w, oru_saved_P_);
+    PutOptional(w, oru_saved_age_);
+
+    w.put(history_warp_);
+    w.put(history_warped_);
+    w.put(history_width_);
+    w.put(history_height_);
+    w.put(observed_pos_var_);
+}
+
+bool KalmanBoxTracker::load(CheckpointReader& r) {
+    r.get(track_id_);
+    r.get(time_since_update_);
+    r.get(hits_);
+    r.get(hit_streak_);
+    r.get(age_);
+    r.get(delta_t_);
+    r.get(min_reid_quality_);
+    const Mat<7, 1> x = r.get<Mat<7, 1>>();
+    const Mat<7, 7> P = r.get<Mat<7, 7>>();
+    bank_->set(slot_, x, P);
+
+    last_observation_.reset();
+    if (r.get<bool>()) {
+        last_observation_ = r.get<TrackObservation>();
+    }
+    const size_t ring = static_cast<size_t>(std::max(1, delta_t_));
+    if (observations_.capacity() != ring) observations_ = RingBuffer<AgedObservation>(ring);
+    observations_.clear();
+    const uint32_t n_obs = r.get<uint32_t>();
+    if (n_obs > ring) r.fail();
+    AgedObservation obs;
+    for (uint32_t i = 0; r.ok() && i < n_obs; ++i) {
+        r.get(obs.age);
+        r.get(obs.obs);
+        observations_.push(obs);
+    }
+    GetOptional(r, velocity_dir_);
+
+    r.getVector(appearance_);
+    r.get(has_appearance_);
+    r.getVector(appearance_bank_);
+    r.get(appearance_bank_q_);
+    r.get(appearance_dim_);
+    r.get(appearance_bank_size_);
+    r.get(observations_since_reid_);
+    if (appearance_dim_ < 0 || appearance_bank_size_ < 0 || appearance_bank_size_ > kAppearanceBankK ||
+        appearance_bank_.size() != static_cast<size_t>(kAppearanceBankK) * static_cast<size_t>(appearance_dim_)) {
+        r.fail();
+    }
+
+    oru_samples_.clear();
+    const uint32_t n_oru = r.get<uint32_t>();
+    if (n_oru > oru_samples_.capacity()) r.fail();
+    for (uint32_t i = 0; r.ok() && i < n_oru; ++i) oru_samples_.push(r.get<OruSample>());
+    r.get(oru_steps_);
+    r.get(oru_observed_);
+    GetOptional(r, oru_saved_x_);
+    GetOptional(r, oru_saved_P_);
+    GetOptional(r, oru_saved_age_);
+
+    r.get(history_warp_);
+    r.get(history_warped_);
+    r.get(history_width_);
+    r.get(history_height_);
+    r.get(observed_pos_var_);
+    return r.ok();
+}
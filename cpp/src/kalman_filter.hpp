@@ -1,47 +1,151 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
-#include <map>
+#include <cmath>
+#include <memory>
 #include <optional>
+#include <utility>
 #include <vector>
 
+#include "embedding.hpp"
+#include "ring_buffer.hpp"
 #include "transform.hpp"
 
+class CheckpointReader;
+class CheckpointWriter;
+
 /**
- * Simple matrix class for Kalman filter operations.
- * Uses row-major storage for small fixed-size matrices.
+ * Fixed-size row-major matrix for the Kalman filter. The dimensions are
+ * template parameters, so every product lives on the stack, mismatched
+ * shapes fail to compile, and the small loops unroll.
  */
-class Matrix {
+template <int R, int C>
+class Mat {
 public:
-    Matrix(int rows, int cols);
-    Matrix(int rows, int cols, const std::vector<float>& data);
-    
-    int rows() const { return rows_; }
-    int cols() const { return cols_; }
-    
-    float& operator()(int r, int c);
-    float operator()(int r, int c) const;
-    
-    Matrix operator+(const Matrix& other) const;
-    Matrix operator-(const Matrix& other) const;
-    Matrix operator*(const Matrix& other) const;
-    Matrix operator*(float scalar) const;
-    
-    Matrix transpose() const;
-    Matrix inverse() const;  // For small matrices (up to 7x7)
-    
-    void setIdentity();
-    void setZero();
-    
-    // Get/set column vector
-    std::vector<float> getCol(int c) const;
-    void setCol(int c, const std::vector<float>& v);
+    static constexpr int kRows = R;
+    static constexpr int kCols = C;
+
+    static constexpr int rows() { return R; }
+    static constexpr int cols() { return C; }
+
+    static Mat Zero() { return Mat{}; }
+    static Mat Identity() {
+        static_assert(R == C, "identity of a non-square matrix");
+        Mat m;
+        for (int i = 0; i < R; ++i) m(i, i) = 1.0f;
+        return m;
+    }
+
+    float& operator()(int r, int c) { return data_[r * C + c]; }
+    float operator()(int r, int c) const { return data_[r * C + c]; }
+
+    Mat operator+(const Mat& other) const {
+        Mat result;
+        for (int i = 0; i < R * C; ++i) result.data_[i] = data_[i] + other.data_[i];
+        return result;
+    }
+
+    Mat operator-(const Mat& other) const {
+        Mat result;
+        for (int i = 0; i < R * C; ++i) result.data_[i] = data_[i] - other.data_[i];
+        return result;
+    }
+
+    template <int K>
+    Mat<R, K> operator*(const Mat<C, K>& other) const {
+        Mat<R, K> result;
+        for (int i = 0; i < R; ++i) {
+            for (int j = 0; j < K; ++j) {
+                float sum = 0.0f;
+                for (int k = 0; k < C; ++k) sum += (*this)(i, k) * other(k, j);
+                result(i, j) = sum;
+            }
+        }
+        return result;
+    }
+
+    Mat operator*(float scalar) const {
+        Mat result;
+        for (int i = 0; i < R * C; ++i) result.data_[i] = data_[i] * scalar;
+        return result;
+    }
+
+    Mat<C, R> transpose() const {
+        Mat<C, R> result;
+        for (int i = 0; i < R; ++i) {
+            for (int j = 0; j < C; ++j) result(j, i) = (*this)(i, j);
+        }
+        return result;
+    }
+
+    Mat inverse() const;  // Gauss-Jordan with partial pivoting
+
+    void setIdentity() { *this = Identity(); }
+    void setZero() { data_.fill(0.0f); }
 
 private:
-    int rows_, cols_;
-    std::vector<float> data_;
+    std::array<float, R * C> data_{};
 };
 
+template <int R, int C>
+Mat<R, C> Mat<R, C>::inverse() const {
+    static_assert(R == C, "inverse of a non-square matrix");
+    constexpr int n = R;
+    Mat<n, 2 * n> aug;
+
+    // Create augmented matrix [A | I]
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            aug(i, j) = (*this)(i, j);
+        }
+        aug(i, n + i) = 1.0f;
+    }
+
+    // Forward elimination with partial pivoting
+    for (int col = 0; col < n; ++col) {
+        int maxRow = col;
+        float maxVal = std::abs(aug(col, col));
+        for (int row = col + 1; row < n; ++row) {
+            if (std::abs(aug(row, col)) > maxVal) {
+                maxVal = std::abs(aug(row, col));
+                maxRow = row;
+            }
+        }
+        if (maxRow != col) {
+            for (int j = 0; j < 2 * n; ++j) {
+                std::swap(aug(col, j), aug(maxRow, j));
+            }
+        }
+
+        float pivot = aug(col, col);
+        if (std::abs(pivot) < 1e-10f) {
+            // Near-singular matrix, add small regularization
+            pivot = 1e-6f;
+            aug(col, col) = pivot;
+        }
+        for (int j = 0; j < 2 * n; ++j) {
+            aug(col, j) /= pivot;
+        }
+        for (int row = 0; row < n; ++row) {
+            if (row != col) {
+                const float factor = aug(row, col);
+                for (int j = 0; j < 2 * n; ++j) {
+                    aug(row, j) -= factor * aug(col, j);
+                }
+            }
+        }
+    }
+
+    Mat inv;
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            inv(i, j) = aug(i, n + j);
+        }
+    }
+    return inv;
+}
+
 /**
  * Bounding box representation for tracking.
  */
@@ -69,12 +173,104 @@ struct Detection {
     BBox bbox;
     float score = 1.0f;
 
-    // Optional appearance embedding for ReID-enabled association.
-    // MobileFaceNet ArcFace checkpoint in this repo outputs 128-D.
-    static constexpr int kReidDim = 128;
-    std::array<float, kReidDim> reid{};
+    // Optional appearance embedding for ReID-enabled association, as long
+    // as the ReID model's output (128-D for the bundled MobileFaceNet);
+    // left empty without ReID so plain detections stay small.
+    EmbeddingF32 reid{};
     bool has_reid = false;
     float reid_quality = 0.0f;  // [0,1], used to keep only high-quality samples
+
+    // Detector geometry in frame pixels, so the embedding can also be
+    // computed after association starts (lazy ReID, see OCSort::setLazyReid).
+    BBox pixel_bbox{};
+    std::array<std::array<float, 2>, 5> landmarks{};
+};
+
+/** Detection as checkpoint bytes (see checkpoint.hpp), embedding included. */
+void SaveDetection(CheckpointWriter& w, const Detection& d);
+void LoadDetection(CheckpointReader& r, Detection& d);
+
+/**
+ * What a track remembers of a detection it was matched to: the geometry
+ * and score OCM, OCR and the inertia direction read, without the
+ * embedding, pixel box and landmarks. Score < 0 marks a placeholder.
+ */
+struct TrackObservation {
+    BBox bbox;
+    float score = -1.0f;
+
+    TrackObservation() = default;
+    TrackObservation(const BBox& b, float s) : bbox(b), score(s) {}
+    explicit TrackObservation(const Detection& d) : bbox(d.bbox), score(d.score) {}
+};
+
+/**
+ * Kalman states of many tracks in structure-of-arrays form: each of the 7
+ * state entries and 49 covariance entries is one contiguous array indexed
+ * by slot, and the model matrices (F, H, Q, R) are shared by every slot.
+ * predictAll() and warpAll() then advance every track in one pass whose
+ * inner loops run over slots and vectorize.
+ *
+ * Slots of released tracks are reused by later ones; a free slot is
+ * carried along by the batched passes, which is cheaper than skipping it.
+ */
+class KalmanStateBank {
+public:
+    static constexpr int kStateDim = 7;  // [x, y, s, r, vx, vy, vs]
+
+    KalmanStateBank() = default;
+    KalmanStateBank(const KalmanStateBank&) = delete;
+    KalmanStateBank& operator=(const KalmanStateBank&) = delete;
+
+    /** A slot with zero state and covariance. */
+    int acquire();
+    void release(int slot);
+
+    /**
+     * A new track's state: measurement [x, y, s, r], zero velocities and
+     * the SORT / OC-SORT initial covariance.
+     */
+    void start(int slot, const std::array<float, 4>& z);
+
+    float& x(int slot, int i) { return x_[i][slot]; }
+    float x(int slot, int i) const { return x_[i][slot]; }
+    float& P(int slot, int r, int c) { return P_[r * kStateDim + c][slot]; }
+    float P(int slot, int r, int c) const { return P_[r * kStateDim + c][slot]; }
+
+    Mat<kStateDim, 1> state(int slot) const;
+    Mat<kStateDim, kStateDim> covariance(int slot) const;
+    void set(int slot, const Mat<kStateDim, 1>& x, const Mat<kStateDim, kStateDim>& P);
+
+    /** Constant-velocity predict of one slot / of every slot. */
+    void predict(int slot);
+    void predictAll();
+
+    /** Kalman update of one slot with measurement [x, y, s, r]. */
+    void update(int slot, const std::array<float, 4>& z);
+
+    /**
+     * Covariance update in Joseph form, (I - KH) P (I - KH)' + K R K':
+     * stays symmetric positive definite under rounding, for a few hundred
+     * more flops per update (default: the shorter (I - KH) P).
+     */
+    void setJosephForm(bool on) { joseph_ = on; }
+
+    /**
+     * Global warp (prev -> curr) of one slot's / every slot's state: the
+     * box through the full homography, velocities through its affine part.
+     * `frame_width/height` are the pixel dimensions of the current frame.
+     */
+    void warp(int slot, const Mat3f& warp, int frame_width, int frame_height);
+    void warpAll(const Mat3f& warp, int frame_width, int frame_height);
+
+private:
+    void predictRange(int begin, int end);
+
+    std::array<std::vector<float>, kStateDim> x_;
+    std::array<std::vector<float>, kStateDim * kStateDim> P_;
+    std::vector<int> free_;
+    int size_ = 0;
+    bool joseph_ = false;
 };
 
 /**
@@ -89,13 +285,46 @@ struct Detection {
  */
 class KalmanBoxTracker {
 public:
-    KalmanBoxTracker(const Detection& det, int track_id, int delta_t = 3);
+    /**
+     * @param min_reid_quality ReID samples below this quality never enter
+     *        the appearance bank (see ReidConfig::min_update_quality)
+     * @param bank Holds the Kalman state (one slot); must outlive the
+     *        tracker. Null gives the tracker a bank of its own.
+     */
+    KalmanBoxTracker(const Detection& det, int track_id, int delta_t = 3,
+                     float min_reid_quality = 0.40f, KalmanStateBank* bank = nullptr);
+    ~KalmanBoxTracker();
+
+    // Movable (trackers are pooled in a vector), never copied: the bank
+    // slot moves with the tracker.
+    KalmanBoxTracker(KalmanBoxTracker&&) = default;
+    KalmanBoxTracker(const KalmanBoxTracker&) = delete;
+    KalmanBoxTracker& operator=(const KalmanBoxTracker&) = delete;
+    KalmanBoxTracker& operator=(KalmanBoxTracker&&) = delete;
+
+    /**
+     * Start over as a new track, exactly as if constructed with these
+     * arguments and the same bank, reusing this tracker's buffers.
+     */
+    void reinit(const Detection& det, int track_id, int delta_t, float min_reid_quality);
+
+    /**
+     * End the track: its bank slot is released. Appearance and history
+     * stay readable until reinit().
+     */
+    void retire();
     
     /**
      * Predict next state.
      * @return Predicted bounding box
      */
     BBox predict();
+
+    /**
+     * Bookkeeping half of predict(), for a tracker whose state
+     * KalmanStateBank::predictAll() has already advanced.
+     */
+    void markPredicted();
     
     /**
      * Update state with a detection (or no observation).
@@ -117,6 +346,18 @@ public:
      * `frame_width/height` are the pixel dimensions of the current frame.
      */
     void applyWarp(const Mat3f& warp, int frame_width, int frame_height);
+
+    /**
+     * applyWarp() apart from the Kalman state (observation history, ORU
+     * snapshot), for a tracker whose state KalmanStateBank::warpAll() has
+     * already warped.
+     *
+     * The history is not touched here: the warp is composed into one
+     * pending transform, applied to the entries that are read (OCM, OCR)
+     * and folded into the history on the next observation. A coasting
+     * track pays one 3x3 product per frame.
+     */
+    void warpHistory(const Mat3f& warp, int frame_width, int frame_height);
     
     int trackId() const { return track_id_; }
     int timeSinceUpdate() const { return time_since_update_; }
@@ -125,14 +366,21 @@ public:
     int age() const { return age_; }
     
     /**
-     * Last observed detection (if any).
+     * Box of the last observed detection in the current frame's
+     * coordinates (if any).
      *
      * When not observed yet, returns `std::nullopt`.
      */
-    const std::optional<Detection>& lastObservation() const { return last_observation_; }
+    std::optional<BBox> lastObservedBox() const;
+
+    /** Detector score of the last observation (-1 if none). */
+    float lastObservedScore() const { return last_observation_ ? last_observation_->score : -1.0f; }
 
     bool hasAppearance() const { return has_appearance_; }
-    const std::array<float, Detection::kReidDim>& appearance() const { return appearance_; }
+    const EmbeddingF32& appearance() const { return appearance_; }
+
+    /** Observations since the last one that carried an embedding. */
+    int observationsSinceReid() const { return observations_since_reid_; }
 
     /**
      * Track inertia direction as (dy, dx) unit vector.
@@ -147,8 +395,28 @@ public:
      *
      * Used for OCM to compute observation-centric direction.
      * If no observations exist, returns placeholder with score < 0.
+     * Only the last max(1, delta_t) observations are kept, which is all
+     * a lookback of k <= delta_t can reach.
      */
-    Detection kPreviousObservation(int k) const;
+    TrackObservation kPreviousObservation(int k) const;
+
+    /** Box of kPreviousObservation(k), or std::nullopt when that is the placeholder. */
+    std::optional<BBox> kPreviousObservedBox(int k) const;
+
+    /**
+     * Growth of the center position variance (P_xx + P_yy) since the last
+     * observation: 1 right after an update, rising with every predict-only
+     * frame. Tracks with an unsettled velocity estimate grow fastest.
+     */
+    float covarianceGrowth() const;
+
+    /**
+     * Write / restore the whole track (counters, Kalman state, observation
+     * history, appearance bank, ORU state). load() keeps this tracker's bank
+     * slot and overwrites everything else; false if the stream is bad.
+     */
+    void save(CheckpointWriter& w) const;
+    bool load(CheckpointReader& r);
 
 private:
     int track_id_;
@@ -157,42 +425,80 @@ private:
     int hit_streak_;
     int age_;
     int delta_t_;
+    float min_reid_quality_;
     
-    // Kalman filter matrices
-    Matrix x_;  // State vector (7x1)
-    Matrix P_;  // State covariance (7x7)
-    Matrix F_;  // State transition matrix (7x7)
-    Matrix H_;  // Measurement matrix (4x7)
-    Matrix Q_;  // Process noise covariance (7x7)
-    Matrix R_;  // Measurement noise covariance (4x4)
+    // Bank slot index (-1 when none). Moving hands the slot over, so only
+    // one tracker ever releases it.
+    struct BankSlot {
+        int index = -1;
+        BankSlot() = default;
+        explicit BankSlot(int i) : index(i) {}
+        BankSlot(BankSlot&& other) noexcept : index(other.index) { other.index = -1; }
+        BankSlot& operator=(const BankSlot&) = delete;
+        operator int() const { return index; }
+    };
+
+    // Kalman state and covariance live in bank_ (slot_); declared first.
+    std::unique_ptr<KalmanStateBank> own_bank_;
+    KalmanStateBank* bank_;
+    BankSlot slot_;
     
-    // OC-SORT observation state
-    std::optional<Detection> last_observation_;          // bbox + score
-    std::map<int, Detection> observations_by_age_;       // key: age_
+    // OC-SORT observation state, in the coordinates of the frame it was
+    // last observed in; history_warp_ takes it to the current frame.
+    std::optional<TrackObservation> last_observation_;
+    struct AgedObservation {
+        int age = 0;
+        TrackObservation obs;
+    };
+    RingBuffer<AgedObservation> observations_;           // ascending age_, last delta_t
     std::optional<std::array<float, 2>> velocity_dir_;   // (dy, dx) unit vector
 
     // Appearance (ReID) state (L2-normalized). Updated with EMA on matched detections.
-    std::array<float, Detection::kReidDim> appearance_{};
+    EmbeddingF32 appearance_;
     bool has_appearance_ = false;
 
-    // Keep only a tiny bank of high-quality appearance samples.
+    // Keep only a tiny bank of high-quality appearance samples, stored
+    // back to back (slot i at appearance_bank_[i * dim]) and allocated
+    // with the first embedding, whose length fixes the track's dimension.
     static constexpr int kAppearanceBankK = 5;
-    std::array<std::array<float, Detection::kReidDim>, kAppearanceBankK> appearance_bank_{};
+    std::vector<float> appearance_bank_;
     std::array<float, kAppearanceBankK> appearance_bank_q_{};
+    int appearance_dim_ = 0;
     int appearance_bank_size_ = 0;
+    int observations_since_reid_ = 0;
+
+    void storeAppearanceSample(int slot, const EmbeddingF32& reid);
 
-    // ORU: history of measurements (per-frame), for gap detection
+    // ORU: the last two real measurements and the update() step each came
+    // in (one step per frame, observed or not), for gap detection.
     using Measurement = std::array<float, 4>;  // [x, y, s, r]
-    std::vector<std::optional<Measurement>> oru_history_;
+    struct OruSample {
+        int step = 0;
+        Measurement z{};
+    };
+    RingBuffer<OruSample> oru_samples_{2};
+    int oru_steps_ = 0;
     bool oru_observed_ = true;
-    std::optional<Matrix> oru_saved_x_;
-    std::optional<Matrix> oru_saved_P_;
+    std::optional<Mat<7, 1>> oru_saved_x_;
+    std::optional<Mat<7, 7>> oru_saved_P_;
     std::optional<int> oru_saved_age_;
 
-    // Internal KF predict/update helpers (do not touch counters)
-    void predictKF();
-    void updateKF(const Measurement& z_arr);
+    // GMC warps (prev -> curr, pixels) since the history above was last in
+    // current-frame coordinates, newest applied last.
+    Mat3f history_warp_ = Mat3f::Identity();
+    bool history_warped_ = false;
+    int history_width_ = 0;
+    int history_height_ = 0;
+
+    // Center position variance right after the last KF update.
+    float observed_pos_var_ = 1.0f;
+
+    void start(const Detection& det);  // initial state and history (ctor and reinit)
     void maybeRunORU(const Measurement& current_meas);
+    // Oldest kept observation with min_age <= age < age_ (null if none).
+    const TrackObservation* oldestObservationSince(int min_age) const;
+    BBox historyToCurrent(const BBox& b) const;
+    void flushHistoryWarp();
     
     // Convert between bbox and state representation
     static Measurement bboxToMeasurement(const BBox& bbox);
@@ -202,4 +508,40 @@ private:
     static void measurementToXYWH(const Measurement& z, float& x, float& y, float& w, float& h);
     static Measurement xywhToMeasurement(float x, float y, float w, float h);
     static std::array<float, 2> speedDirection(const BBox& from, const BBox& to);
+
+    friend class KalmanStateBank;  // box <-> measurement conversions
+    friend class FixedLagSmoother;
+};
+
+/**
+ * Fixed-lag Rauch-Tung-Striebel smoother for the boxes of one track.
+ *
+ * The boxes are filtered forward with the tracker's own model (F, Q, R and
+ * initial covariance), observed boxes as measurements, and each frame's
+ * state is then corrected backwards from at most `lag` frames ahead:
+ *   x_s(k) = x_f(k) + C(k) (x_s(k+1) - x_p(k+1)),  C(k) = P_f(k) F' P_p(k+1)^-1
+ * Frames between observations are drawn towards the next observation
+ * rather than extrapolated from the last one, and observed frames no longer
+ * snap to the raw detection box.
+ *
+ * Buffers are kept between calls, so one smoother serves many tracks.
+ */
+class FixedLagSmoother {
+public:
+    explicit FixedLagSmoother(int lag) : lag_(std::max(1, lag)) {}
+
+    /**
+     * Smooth `boxes` in place. `frames` are their frame indices (ascending;
+     * a gap is predicted over frame by frame) and `observed[k]` marks boxes
+     * that are detections. Boxes before the first observation, and tracks
+     * with fewer than two, are left unchanged.
+     */
+    void smooth(const std::vector<int>& frames, const std::vector<char>& observed, std::vector<BBox>& boxes);
+
+private:
+    int lag_;
+    KalmanStateBank bank_;
+    std::vector<Mat<7, 1>> x_filt_, x_pred_;  // per box: after the update / before it
+    std::vector<Mat<7, 7>> P_filt_;
+    std::vector<Mat<7, 7>> gain_;             // C(k), from box k + 1 back to k
 };
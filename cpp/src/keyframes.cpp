@@ -0,0 +1,63 @@
+#include "keyframes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+namespace {
+// Largest edge error, in pixels, of frames (first, last) interpolated
+// between `first` and `last`; `worst` gets the frame it occurs on.
+float MaxInterpolationError(const std::vector<TrackFrame>& frames, size_t first, size_t last, float width,
+                            float height, size_t& worst) {
+    const BBox& a = frames[first].bbox;
+    const BBox& b = frames[last].bbox;
+    const float span = static_cast<float>(frames[last].frame_index - frames[first].frame_index);
+    float max_error = 0.0f;
+    worst = first;
+    for (size_t k = first + 1; k < last; ++k) {
+        const float t = static_cast<float>(frames[k].frame_index - frames[first].frame_index) / span;
+        const BBox& box = frames[k].bbox;
+        const float error = std::max(std::max(std::fabs(a.x1 + (b.x1 - a.x1) * t - box.x1) * width,
+                                              std::fabs(a.x2 + (b.x2 - a.x2) * t - box.x2) * width),
+                                     std::max(std::fabs(a.y1 + (b.y1 - a.y1) * t - box.y1) * height,
+                                              std::fabs(a.y2 + (b.y2 - a.y2) * t - box.y2) * height));
+        if (error > max_error) {
+            max_error = error;
+            worst = k;
+        }
+    }
+    return max_error;
+}
+}  // namespace
+
+void ReduceToKeyframes(std::vector<TrackFrame>& frames, float tolerance_px, int width, int height) {
+    if (frames.size() < 3 || tolerance_px <= 0.0f || width <= 0 || height <= 0) return;
+    std::vector<char> keep(frames.size(), 0);
+    std::vector<std::pair<size_t, size_t>> pending;  // spans still to check, explicit so long runs cannot overflow the stack
+    size_t run_start = 0;
+    for (size_t i = 1; i <= frames.size(); ++i) {
+        if (i < frames.size() && frames[i].frame_index == frames[i - 1].frame_index + 1) continue;
+        keep[run_start] = 1;
+        keep[i - 1] = 1;
+        pending.emplace_back(run_start, i - 1);
+        while (!pending.empty()) {
+            const std::pair<size_t, size_t> span = pending.back();
+            pending.pop_back();
+            if (span.second - span.first < 2) continue;
+            size_t worst = span.first;
+            const float error = MaxInterpolationError(frames, span.first, span.second, static_cast<float>(width),
+                                                      static_cast<float>(height), worst);
+            if (error <= tolerance_px) continue;
+            keep[worst] = 1;
+            pending.emplace_back(span.first, worst);
+            pending.emplace_back(worst, span.second);
+        }
+        run_start = i;
+    }
+    size_t out = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (keep[i]) frames[out++] = frames[i];
+    }
+    frames.resize(out);
+}
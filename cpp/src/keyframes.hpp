@@ -0,0 +1,19 @@
+#pragma once
+
+#include "pipeline.hpp"
+
+#include <vector>
+
+/**
+ * Keyframe reduction of an output track (PipelineOptions::keyframe_tolerance).
+ *
+ * Ramer-Douglas-Peucker over each run of consecutive frames: a frame is
+ * kept when linear interpolation between the kept frames around it would
+ * move one of its box edges by more than `tolerance_px` pixels of a
+ * `width` x `height` frame. The first and last frame of every run are
+ * kept, so gaps in a track stay gaps. The kept frames' boxes are the
+ * original ones, untouched.
+ *
+ * @param frames A track's frames in frame order, reduced in place
+ */
+void ReduceToKeyframes(std::vector<TrackFrame>& frames, float tolerance_px, int width, int height);
@@ -0,0 +1,138 @@
+#include "landmark_flow.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+using Corner = FeatureMotionEstimator::Corner;
+
+constexpr float kMaxFbError = 1.0f;     // forward-backward mismatch of a kept landmark (plane pixels)
+constexpr int kMinPoints = 3;           // landmarks that must survive for a cue
+constexpr float kMinSpread = 2.0f;      // mean landmark distance from their centroid (plane pixels)
+constexpr float kMaxScaleStep = 1.25f;  // per-frame box scale change a cue may carry
+constexpr float kMaxShift = 0.5f;       // per-frame center shift a cue may carry, in box sizes
+constexpr float kMinSeedIou = 0.5f;     // of a track's box with the detection that seeds it
+
+bool HasLandmarks(const Detection& d) {
+    return d.pixel_bbox.width() > 0.0f && d.pixel_bbox.height() > 0.0f && d.bbox.width() > 0.0f &&
+           d.bbox.height() > 0.0f;
+}
+}  // namespace
+
+void LandmarkFlow::track(const uint8_t* prev_luma, const uint8_t* curr_luma, int w, int h, int frame,
+                         std::vector<TrackCue>& cues) {
+    cues.clear();
+    flowed_.clear();
+    if (tracks_.empty() || !prev_luma || !curr_luma) {
+        prev_frame_ = -1;
+        return;
+    }
+    const bool cached = prev_frame_ == frame - 1 && !prev_pyramid_.empty() && prev_pyramid_[0].w == w &&
+                        prev_pyramid_[0].h == h;
+    if (!cached) BuildFlowPyramid(prev_luma, w, h, prev_pyramid_);
+    BuildFlowPyramid(curr_luma, w, h, curr_pyramid_);
+
+    const float fw = static_cast<float>(w);
+    const float fh = static_cast<float>(h);
+    for (const Track& t : tracks_) {
+        // Plane pixel centers sit half a pixel in from the normalized grid.
+        Corner p[5], q[5];
+        bool kept[5];
+        int n = 0;
+        float c0x = 0.0f, c0y = 0.0f, c1x = 0.0f, c1y = 0.0f;
+        for (int k = 0; k < 5; ++k) {
+            p[k] = Corner{t.points[k][0] * fw - 0.5f, t.points[k][1] * fh - 0.5f};
+            Corner back;
+            kept[k] = TrackFlowPoint(prev_pyramid_, curr_pyramid_, p[k], q[k]) &&
+                      TrackFlowPoint(curr_pyramid_, prev_pyramid_, q[k], back) &&
+                      (back.x - p[k].x) * (back.x - p[k].x) + (back.y - p[k].y) * (back.y - p[k].y) <=
+                          kMaxFbError * kMaxFbError;
+            if (!kept[k]) continue;
+            c0x += p[k].x;
+            c0y += p[k].y;
+            c1x += q[k].x;
+            c1y += q[k].y;
+            n++;
+        }
+        if (n < kMinPoints) {
+            lost_++;
+            continue;
+        }
+        c0x /= static_cast<float>(n);
+        c0y /= static_cast<float>(n);
+        c1x /= static_cast<float>(n);
+        c1y /= static_cast<float>(n);
+        float r0 = 0.0f, r1 = 0.0f;
+        for (int k = 0; k < 5; ++k) {
+            if (!kept[k]) continue;
+            r0 += std::hypot(p[k].x - c0x, p[k].y - c0y);
+            r1 += std::hypot(q[k].x - c1x, q[k].y - c1y);
+        }
+        const float scale = r0 > 0.0f ? r1 / r0 : 0.0f;
+        const float box_side = std::max(t.bbox.width() * fw, t.bbox.height() * fh);
+        const float shift = std::hypot(c1x - c0x, c1y - c0y);
+        if (r0 < kMinSpread * static_cast<float>(n) || !(scale >= 1.0f / kMaxScaleStep) || scale > kMaxScaleStep ||
+            shift > kMaxShift * box_side) {
+            lost_++;
+            continue;
+        }
+
+        // The box and the lost landmarks move with the kept ones' shift and scale.
+        auto move = [&](float x, float y) {
+            return Corner{c1x + scale * (x - c0x), c1y + scale * (y - c0y)};
+        };
+        Track next = t;
+        const Corner a = move(t.bbox.x1 * fw - 0.5f, t.bbox.y1 * fh - 0.5f);
+        const Corner b = move(t.bbox.x2 * fw - 0.5f, t.bbox.y2 * fh - 0.5f);
+        next.bbox = BBox{(a.x + 0.5f) / fw, (a.y + 0.5f) / fh, (b.x + 0.5f) / fw, (b.y + 0.5f) / fh};
+        for (int k = 0; k < 5; ++k) {
+            const Corner m = kept[k] ? q[k] : move(p[k].x, p[k].y);
+            next.points[k] = {(m.x + 0.5f) / fw, (m.y + 0.5f) / fh};
+        }
+        cues.push_back(TrackCue{next.track_id, next.bbox, next.score});
+        flowed_.push_back(next);
+        cued_++;
+    }
+
+    std::swap(prev_pyramid_, curr_pyramid_);
+    prev_frame_ = frame;
+}
+
+void LandmarkFlow::observe(const std::vector<TrackResult>& tracks, const std::vector<Detection>& dets,
+                           const std::vector<TrackCue>& cues) {
+    next_.clear();
+    size_t cue = 0;
+    for (const TrackResult& r : tracks) {
+        if (r.time_since_update != 0) continue;
+        const Detection* best = nullptr;
+        float best_iou = kMinSeedIou;
+        for (const Detection& d : dets) {
+            if (!HasLandmarks(d)) continue;
+            const float iou = r.bbox.iou(d.bbox);
+            if (iou >= best_iou) {
+                best = &d;
+                best_iou = iou;
+            }
+        }
+        if (best) {
+            Track t;
+            t.track_id = r.track_id;
+            t.bbox = best->bbox;
+            t.score = best->score;
+            // Landmarks are in the detector's frame pixels, like pixel_bbox.
+            const BBox& px = best->pixel_bbox;
+            const float sx = best->bbox.width() / px.width();
+            const float sy = best->bbox.height() / px.height();
+            for (int k = 0; k < 5; ++k) {
+                t.points[k] = {best->bbox.x1 + (best->landmarks[k][0] - px.x1) * sx,
+                               best->bbox.y1 + (best->landmarks[k][1] - px.y1) * sy};
+            }
+            next_.push_back(t);
+            continue;
+        }
+        while (cue < cues.size() && cues[cue].track_id < r.track_id) cue++;
+        if (cue < cues.size() && cues[cue].track_id == r.track_id) next_.push_back(flowed_[cue]);
+    }
+    std::swap(tracks_, next_);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "gmc_features.hpp"
+#include "ocsort.hpp"
+
+/**
+ * Landmark flow between sparse detections (--landmark-flow).
+ *
+ * Between SCRFD samples a track's box is the Kalman filter's constant
+ * velocity prediction, which falls behind on head turns and sudden moves.
+ * Each track matched to a detection keeps that detection's five landmarks;
+ * on the frames in between they are followed by pyramidal Lucas-Kanade
+ * (TrackFlowPoint) across the reduced luma planes the GMC stage already
+ * decodes, with a forward-backward check. The points that survive give a
+ * shift and a scale for the box, which goes to the tracker as a TrackCue:
+ * an observation of that track only, so
+ * flow never starts a track or takes another track's detection.
+ *
+ * A track keeps its landmarks until a frame without either a cue or a
+ * detection near it; detections replace them, so flow only bridges from
+ * one detection to the next. Not thread-safe.
+ */
+class LandmarkFlow {
+public:
+    /** What is followed for one track, normalized to the frame. */
+    struct Track {
+        int track_id = -1;
+        BBox bbox{};
+        float score = 0.0f;
+        std::array<std::array<float, 2>, 5> points{};
+    };
+
+    /**
+     * Cues for frame `frame` (by ascending track_id) from the flow of every
+     * track's landmarks from `prev_luma` to `curr_luma` (w x h planes of
+     * consecutive frames). Tracks whose landmarks are lost get none.
+     */
+    void track(const uint8_t* prev_luma, const uint8_t* curr_luma, int w, int h, int frame,
+               std::vector<TrackCue>& cues);
+
+    /**
+     * After the tracker's update with `dets` and `cues`: tracks observed
+     * this frame take the landmarks of the detection over them, or keep the
+     * flowed ones of their cue; every other track is dropped.
+     */
+    void observe(const std::vector<TrackResult>& tracks, const std::vector<Detection>& dets,
+                 const std::vector<TrackCue>& cues);
+
+    /** A new shot. */
+    void reset() {
+        tracks_.clear();
+        prev_frame_ = -1;
+    }
+
+    int cued() const { return cued_; }
+    int lost() const { return lost_; }
+
+    /** The followed tracks, by ascending track_id (for checkpoints). */
+    std::vector<Track>& tracks() { return tracks_; }
+
+private:
+    std::vector<Track> tracks_;
+    std::vector<Track> next_;
+    std::vector<Track> flowed_;  // this frame's cue state, parallel to the cues
+    std::vector<FeatureMotionEstimator::Level> prev_pyramid_;
+    std::vector<FeatureMotionEstimator::Level> curr_pyramid_;
+    int prev_frame_ = -1;  // frame of prev_pyramid_
+    int cued_ = 0;
+    int lost_ = 0;
+};
@@ -0,0 +1,229 @@
+#include "lapjv.hpp"
+#include "tracy_zones.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr double kInf = std::numeric_limits<double>::infinity();
+}  // namespace
+
+double LapjvSolver::solve(const std::vector<std::vector<double>>& cost_matrix, std::vector<int>& assignment) {
+    const int n_rows = static_cast<int>(cost_matrix.size());
+    const int n_cols = n_rows > 0 ? static_cast<int>(cost_matrix[0].size()) : 0;
+    flat_.resize(static_cast<size_t>(n_rows) * static_cast<size_t>(n_cols));
+    for (int i = 0; i < n_rows; ++i) {
+        for (int j = 0; j < n_cols; ++j) {
+            flat_[i + static_cast<size_t>(n_rows) * j] = cost_matrix[i][j];
+        }
+    }
+    return solve(flat_.data(), n_rows, n_cols, assignment);
+}
+
+double LapjvSolver::solve(const double* cost_col_major, int n_rows, int n_cols, std::vector<int>& assignment) {
+    if (n_rows <= 0) {
+        assignment.clear();
+        return 0.0;
+    }
+    if (n_cols <= 0) {
+        assignment.assign(n_rows, -1);
+        return 0.0;
+    }
+
+    // List every finite entry, shifted to be non-negative. An unassigned
+    // row then costs more than any full assignment could (the largest
+    // spread times the pairs assigned), so min(M, N) pairs are always made.
+    double lo = kInf, hi = -kInf;
+    for (size_t k = 0; k < static_cast<size_t>(n_rows) * static_cast<size_t>(n_cols); ++k) {
+        if (!std::isfinite(cost_col_major[k])) continue;
+        lo = std::min(lo, cost_col_major[k]);
+        hi = std::max(hi, cost_col_major[k]);
+    }
+    if (!std::isfinite(lo)) {
+        assignment.assign(n_rows, -1);
+        return 0.0;
+    }
+    dense_begin_.assign(1, 0);
+    dense_cols_.clear();
+    dense_costs_.clear();
+    for (int i = 0; i < n_rows; ++i) {
+        for (int j = 0; j < n_cols; ++j) {
+            const double c = cost_col_major[i + static_cast<size_t>(n_rows) * j];
+            if (!std::isfinite(c)) continue;
+            dense_cols_.push_back(j);
+            dense_costs_.push_back(c - lo);
+        }
+        dense_begin_.push_back(static_cast<int>(dense_cols_.size()));
+    }
+    const double limit = (hi - lo + 1.0) * (std::min(n_rows, n_cols) + 1);
+    solveSparse(n_rows, n_cols, dense_begin_.data(), dense_cols_.data(), dense_costs_.data(), limit, assignment);
+
+    double total = 0.0;
+    for (int i = 0; i < n_rows; ++i) {
+        if (assignment[i] >= 0) total += cost_col_major[i + static_cast<size_t>(n_rows) * assignment[i]];
+    }
+    return total;
+}
+
+double LapjvSolver::solveSparse(int n_rows, int n_cols, const int* row_begin, const int* cols, const double* costs,
+                                double cost_limit, std::vector<int>& assignment, double* col_prices) {
+    FACE_PIPELINE_ZONE("LapjvSolver::solveSparse");
+    if (n_rows <= 0) {
+        assignment.clear();
+        return 0.0;
+    }
+
+    // Adjacency: the useful listed pairs, then the row's private column,
+    // taken at `cost_limit` when the row stays unassigned.
+    adj_begin_.assign(1, 0);
+    adj_col_.clear();
+    adj_cost_.clear();
+    for (int i = 0; i < n_rows; ++i) {
+        for (int k = row_begin[i]; k < row_begin[i + 1]; ++k) {
+            if (!(costs[k] < cost_limit) || cols[k] < 0 || cols[k] >= n_cols) continue;
+            adj_col_.push_back(cols[k]);
+            adj_cost_.push_back(costs[k]);
+        }
+        adj_col_.push_back(n_cols + i);
+        adj_cost_.push_back(cost_limit);
+        adj_begin_.push_back(static_cast<int>(adj_col_.size()));
+    }
+
+    solveRows(n_rows, n_cols, assignment, col_prices);
+
+    double total = 0.0;
+    for (int i = 0; i < n_rows; ++i) {
+        if (assignment[i] < 0) continue;
+        for (int k = adj_begin_[i]; k < adj_begin_[i + 1]; ++k) {
+            if (adj_col_[k] == assignment[i]) {
+                total += adj_cost_[k];
+                break;
+            }
+        }
+    }
+    return total;
+}
+
+void LapjvSolver::seedRows(int n_rows, int n_cols) {
+    // Optimality needs every priced column matched in the end, and matched
+    // columns stay matched, so a priced column no row starts at drops its
+    // price and the rows are reduced again. Each pass drops at least one.
+    for (bool dropped = true; dropped;) {
+        std::fill(col4row_.begin(), col4row_.end(), -1);
+        std::fill(row4col_.begin(), row4col_.end(), -1);
+        for (int i = 0; i < n_rows; ++i) {
+            // Every reduced cost of the row non-negative, its cheapest zero;
+            // the row's private column always has one.
+            int best = -1;
+            double best_cost = kInf;
+            for (int k = adj_begin_[i]; k < adj_begin_[i + 1]; ++k) {
+                const double c = adj_cost_[k] - v_[adj_col_[k]];
+                if (c < best_cost) {
+                    best_cost = c;
+                    best = adj_col_[k];
+                }
+            }
+            u_[i] = best_cost;
+            if (row4col_[best] < 0) {
+                row4col_[best] = i;
+                col4row_[i] = best;
+            }
+        }
+        dropped = false;
+        for (int j = 0; j < n_cols; ++j) {
+            if (v_[j] != 0.0 && row4col_[j] < 0) {
+                v_[j] = 0.0;
+                dropped = true;
+            }
+        }
+    }
+    seeded_ = 0;
+    for (int i = 0; i < n_rows; ++i) seeded_ += col4row_[i] >= 0 ? 1 : 0;
+}
+
+void LapjvSolver::solveRows(int n_rows, int n_cols, std::vector<int>& assignment, double* col_prices) {
+    const int n_all = n_cols + n_rows;
+    u_.assign(n_rows, 0.0);
+    v_.assign(n_all, 0.0);
+    dist_.assign(n_all, kInf);
+    col4row_.assign(n_rows, -1);
+    row4col_.assign(n_all, -1);
+    path_.assign(n_all, -1);
+    scanned_col_.assign(n_all, 0);
+    reaugmented_ = 0;
+    seeded_ = 0;
+    if (col_prices) {
+        for (int j = 0; j < n_cols; ++j) v_[j] = std::isfinite(col_prices[j]) ? std::min(0.0, col_prices[j]) : 0.0;
+        seedRows(n_rows, n_cols);
+    }
+
+    for (int cur = 0; cur < n_rows; ++cur) {
+        if (col4row_[cur] >= 0) continue;  // seeded
+        // Dijkstra from `cur` over the columns its alternating paths reach.
+        scanned_rows_.clear();
+        scanned_cols_.clear();
+        todo_.clear();
+        double min_val = 0.0;
+        int i = cur;
+        int sink = -1;
+        while (sink < 0) {
+            scanned_rows_.push_back(i);
+            for (int k = adj_begin_[i]; k < adj_begin_[i + 1]; ++k) {
+                const int j = adj_col_[k];
+                if (scanned_col_[j]) continue;
+                const double r = min_val + adj_cost_[k] - u_[i] - v_[j];
+                if (r < dist_[j]) {
+                    if (dist_[j] == kInf) todo_.push_back(j);
+                    dist_[j] = r;
+                    path_[j] = i;
+                }
+            }
+            // Closest unscanned column; a free one wins ties (shorter path).
+            size_t best = 0;
+            for (size_t t = 1; t < todo_.size(); ++t) {
+                const double d = dist_[todo_[t]], b = dist_[todo_[best]];
+                if (d < b || (d == b && row4col_[todo_[t]] < 0 && row4col_[todo_[best]] >= 0)) best = t;
+            }
+            // `cur` always reaches its private column, so todo_ is never empty.
+            const int j = todo_[best];
+            todo_[best] = todo_.back();
+            todo_.pop_back();
+            min_val = dist_[j];
+            scanned_col_[j] = 1;
+            scanned_cols_.push_back(j);
+            if (row4col_[j] < 0) {
+                sink = j;
+            } else {
+                i = row4col_[j];
+            }
+        }
+
+        if (scanned_rows_.size() > 1) reaugmented_++;
+
+        // Potentials keep every reduced cost non-negative and the matched ones zero.
+        u_[cur] += min_val;
+        for (int r : scanned_rows_) {
+            if (r != cur) u_[r] += min_val - dist_[col4row_[r]];
+        }
+        for (int j : scanned_cols_) v_[j] -= min_val - dist_[j];
+
+        // Flip the path.
+        for (int j = sink;;) {
+            const int r = path_[j];
+            row4col_[j] = r;
+            std::swap(col4row_[r], j);
+            if (r == cur) break;
+        }
+
+        for (int j : scanned_cols_) {
+            dist_[j] = kInf;
+            scanned_col_[j] = 0;
+        }
+        for (int j : todo_) dist_[j] = kInf;
+    }
+
+    assignment.resize(n_rows);
+    for (int r = 0; r < n_rows; ++r) assignment[r] = col4row_[r] < n_cols ? col4row_[r] : -1;
+    if (col_prices) std::copy(v_.begin(), v_.begin() + n_cols, col_prices);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * Linear assignment by shortest augmenting paths (Jonker-Volgenant).
+ *
+ * Rows are added one at a time. Each one takes a Dijkstra shortest path in
+ * reduced costs to a free column, and the row and column potentials keep
+ * every reduced cost non-negative. This is the augmentation phase of LAPJV,
+ * in Crouse's rectangular form. It works on adjacency lists, so a sparse
+ * problem costs time in proportion to the pairs it lists, not to rows x
+ * columns.
+ *
+ * A row whose cheapest column is still free settles in one scan of its
+ * pairs, without touching the others. From one frame to the next most
+ * tracks keep their cheapest box, so a tracker's problems cost about their
+ * pair count; only rows that contend for a column are re-augmented.
+ *
+ * solveSparse() can also start from the column prices of a similar earlier
+ * problem (a warm start, e.g. the previous frame's, with columns matched
+ * up by track). Each row then starts at its cheapest column at those
+ * prices, and rows that get it need no search at all; the others are
+ * augmented as usual. The result is optimal either way.
+ *
+ * Drop-in for HungarianAlgorithm's dense interface, plus solveSparse() for
+ * gated pair lists.
+ */
+class LapjvSolver {
+public:
+    /**
+     * Solve a dense MxN problem (any shape): min(M, N) pairs are assigned
+     * at minimum total cost. Same contract as HungarianAlgorithm::solve().
+     *
+     * @param cost_matrix cost_matrix[i][j] is the cost of assigning row i to column j
+     * @param assignment  Output: assignment[i] = j, or -1 if row i is unassigned
+     * @return Total cost of the assigned pairs
+     */
+    double solve(const std::vector<std::vector<double>>& cost_matrix, std::vector<int>& assignment);
+
+    /** Dense problem as a flat column-major matrix, cost_col_major[row + n_rows * col] (left unchanged). */
+    double solve(const double* cost_col_major, int n_rows, int n_cols, std::vector<int>& assignment);
+
+    /**
+     * Solve a sparse problem.
+     *
+     * The pairs of row i are cols[row_begin[i] ... row_begin[i + 1] - 1],
+     * with costs[] alongside. Pairs that are not listed are infeasible. A
+     * row may also stay unassigned, at a cost of `cost_limit`; a pair is
+     * therefore used only if that lowers the total, and listed pairs that
+     * cost `cost_limit` or more are never used. This is equivalent to a
+     * dense matrix that holds `cost_limit` in every unlisted entry, whose
+     * assignments to such entries are then discarded.
+     *
+     * @param row_begin Pair offsets per row (n_rows + 1 entries)
+     * @param cols      Column of each pair (each column listed once per row)
+     * @param costs     Cost of each pair
+     * @param assignment Output: assignment[i] = j, or -1 if row i is unassigned
+     * @param col_prices If set, n_cols column prices (<= 0; 0 = none) to
+     *                   start from, and on return this solve's prices
+     * @return Total cost of the assigned pairs
+     */
+    double solveSparse(int n_rows, int n_cols, const int* row_begin, const int* cols, const double* costs,
+                       double cost_limit, std::vector<int>& assignment, double* col_prices = nullptr);
+
+    /** Rows of the last solve whose augmenting path displaced an assigned row. */
+    int lastReaugmented() const { return reaugmented_; }
+    /** Rows of the last solve the column prices settled without a search. */
+    int lastSeeded() const { return seeded_; }
+
+private:
+    int reaugmented_ = 0;
+    int seeded_ = 0;
+    // Working storage, kept between calls so solving does not allocate.
+    // Columns n_cols + i are row i's private "unassigned" columns.
+    std::vector<int> adj_begin_, adj_col_;
+    std::vector<double> adj_cost_;
+    std::vector<double> u_, v_, dist_;
+    std::vector<int> col4row_, row4col_, path_;
+    std::vector<char> scanned_col_;
+    std::vector<int> scanned_rows_, scanned_cols_, todo_;
+    std::vector<double> flat_;
+    std::vector<int> dense_begin_, dense_cols_;
+    std::vector<double> dense_costs_;
+
+    // Assign rows one by one over the adjacency built by solveSparse(),
+    // after seeding from `col_prices` if set.
+    void solveRows(int n_rows, int n_cols, std::vector<int>& assignment, double* col_prices);
+
+    // Row potentials and the rows' cheapest free columns at the column
+    // prices in v_ (see solveSparse()).
+    void seedRows(int n_rows, int n_cols);
+};
@@ -0,0 +1,153 @@
+#include "light_detector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+
+#include "nms.hpp"
+#include "tracy_zones.hpp"
+
+namespace {
+constexpr int kStrides[] = {8, 16, 32};
+constexpr float kNmsThresh = 0.3f;  // FaceDetectorYN's default
+
+class YuNetDetector : public FaceDetector {
+public:
+    YuNetDetector(const std::string& stem, int input_side, float conf_thresh, const DetectorOptions& options)
+        : input_side_(std::max(kStrides[2], input_side)), conf_thresh_(conf_thresh) {
+        if (options.num_threads > 0) net_.opt.num_threads = options.num_threads;
+        net_.opt.use_fp16_packed = options.use_fp16_packed;
+        net_.opt.use_fp16_storage = options.use_fp16_storage;
+        net_.opt.use_fp16_arithmetic = options.use_fp16_arithmetic;
+        net_.opt.use_packing_layout = options.use_packing_layout;
+        net_.opt.lightmode = options.lightmode;
+        bool on_gpu = false;
+        loaded_ = LoadNcnnNet(net_, stem + ".param", stem + ".bin", options.gpu, on_gpu) &&
+                  !net_.input_names().empty();
+    }
+
+    bool IsLoaded() const override { return loaded_; }
+    const char* Name() const override { return "yunet"; }
+
+    std::vector<ScrfdFace> DetectFaces(const unsigned char* rgb, int width, int height) const override {
+        FACE_PIPELINE_ZONE("YuNetDetector::DetectFaces");
+        std::vector<ScrfdFace> faces;
+        if (!loaded_ || !rgb || width <= 0 || height <= 0) return faces;
+        // The long side to the input side; both sides padded to the largest
+        // stride, at the bottom and right so boxes only need scaling back.
+        const float scale = static_cast<float>(input_side_) / static_cast<float>(std::max(width, height));
+        const int new_w = std::max(1, static_cast<int>(std::lround(width * scale)));
+        const int new_h = std::max(1, static_cast<int>(std::lround(height * scale)));
+        const int align = kStrides[2];
+        const int pad_w = (new_w + align - 1) / align * align;
+        const int pad_h = (new_h + align - 1) / align * align;
+        ncnn::Mat resized =
+            ncnn::Mat::from_pixels_resize(rgb, ncnn::Mat::PIXEL_RGB2BGR, width, height, new_w, new_h, &blob_pool_);
+        ncnn::Mat in;
+        ncnn::copy_make_border(resized, in, 0, pad_h - new_h, 0, pad_w - new_w, ncnn::BORDER_CONSTANT, 0.0f, net_.opt);
+
+        ncnn::Extractor ex = net_.create_extractor();
+        ex.set_light_mode(true);
+        ex.set_blob_allocator(&blob_pool_);
+        ex.set_workspace_allocator(&workspace_pool_);
+        ex.input(net_.input_names()[0], in);
+        std::vector<std::array<float, 4>> boxes;
+        std::vector<float> scores;
+        std::vector<ScrfdFace> candidates;
+        for (const int stride : kStrides) {
+            const std::string suffix = "_" + std::to_string(stride);
+            ncnn::Mat cls, obj, bbox, kps;
+            if (ex.extract(("cls" + suffix).c_str(), cls) != 0 || ex.extract(("obj" + suffix).c_str(), obj) != 0 ||
+                ex.extract(("bbox" + suffix).c_str(), bbox) != 0) {
+                continue;
+            }
+            const bool has_kps = ex.extract(("kps" + suffix).c_str(), kps) == 0 && kps.w == 10;
+            const int cols = pad_w / stride;
+            const int cells = cols * (pad_h / stride);
+            // [1, cells, k] heads come out of onnx2ncnn as w = k, h = cells.
+            if (cls.h != cells || obj.h != cells || bbox.h != cells || bbox.w != 4) continue;
+            for (int idx = 0; idx < cells; ++idx) {
+                const float c = std::min(1.0f, std::max(0.0f, cls.row(idx)[0]));
+                const float o = std::min(1.0f, std::max(0.0f, obj.row(idx)[0]));
+                const float score = std::sqrt(c * o);
+                if (score < conf_thresh_) continue;
+                const float gx = static_cast<float>(idx % cols);
+                const float gy = static_cast<float>(idx / cols);
+                const float* b = bbox.row(idx);
+                const float cx = (gx + b[0]) * stride;
+                const float cy = (gy + b[1]) * stride;
+                const float w = std::exp(b[2]) * stride;
+                const float h = std::exp(b[3]) * stride;
+                ScrfdFace f;
+                f.score = score;
+                f.bbox = {std::max(0.0f, (cx - 0.5f * w) / scale), std::max(0.0f, (cy - 0.5f * h) / scale),
+                          std::min(static_cast<float>(width), (cx + 0.5f * w) / scale),
+                          std::min(static_cast<float>(height), (cy + 0.5f * h) / scale)};
+                if (has_kps) {
+                    const float* k = kps.row(idx);
+                    for (int p = 0; p < 5; ++p) {
+                        f.landmarks[p] = {(gx + k[2 * p]) * stride / scale, (gy + k[2 * p + 1]) * stride / scale};
+                    }
+                }
+                boxes.push_back(f.bbox);
+                scores.push_back(score);
+                candidates.push_back(f);
+            }
+        }
+        for (const int k : GreedyNms(boxes, scores, kNmsThresh)) faces.push_back(candidates[static_cast<size_t>(k)]);
+        return faces;
+    }
+
+private:
+    // Declared before net_ to outlive it (see ScrfdDetector).
+    mutable ncnn::PoolAllocator blob_pool_;
+    mutable ncnn::PoolAllocator workspace_pool_;
+    ncnn::Net net_;
+    int input_side_ = 320;
+    float conf_thresh_ = 0.6f;
+    bool loaded_ = false;
+};
+
+// The .param text names the output blobs.
+bool ParamMentions(const std::string& param, const char* blob) {
+    std::ifstream f(param);
+    const std::string text((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    const std::string word = std::string(" ") + blob;
+    for (size_t at = text.find(word); at != std::string::npos; at = text.find(word, at + 1)) {
+        const size_t end = at + word.size();
+        if (end == text.size() || text[end] == ' ' || text[end] == '\n' || text[end] == '\r') return true;
+    }
+    return false;
+}
+}  // namespace
+
+std::unique_ptr<FaceDetector> LoadLightDetector(const std::string& stem,
+                                                int input_side,
+                                                float conf_thresh,
+                                                const DetectorOptions& options,
+                                                std::string& error) {
+    const std::string param = stem + ".param";
+    if (!std::ifstream(param).good()) {
+        error = "no light detector " + param;
+        return nullptr;
+    }
+    std::unique_ptr<FaceDetector> detector;
+    if (ParamMentions(param, "cls_8") && ParamMentions(param, "obj_8")) {
+        detector = std::make_unique<YuNetDetector>(stem, input_side, conf_thresh, options);
+    } else if (ParamMentions(param, "score_8")) {
+        DetectorOptions scrfd = options;
+        scrfd.tiles = TileOptions{};
+        scrfd.landmarks = false;  // its faces are tracked without ReID
+        detector = std::make_unique<ScrfdDetector>(param, stem + ".bin", input_side, input_side, conf_thresh, 0.4f,
+                                                   scrfd);
+    } else {
+        error = param + " is neither a YuNet (cls_8, obj_8, ...) nor an SCRFD (score_8, ...) export";
+        return nullptr;
+    }
+    if (!detector->IsLoaded()) {
+        error = "cannot load light detector " + stem;
+        return nullptr;
+    }
+    return detector;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "face_detector.hpp"
+#include "scrfd.hpp"
+
+/**
+ * Ultra-light detectors for the hybrid schedule (--light-detector).
+ *
+ * SCRFD at the sampled rate leaves faces that enter between samples to the
+ * next detection. A model a few times cheaper can run on every frame in
+ * between instead: its faces feed the tracker like any detection (without
+ * ReID), and SCRFD still runs on the sampled frames to confirm them and
+ * embed. The backend follows the model files:
+ *
+ * - YuNet (libfacedetection / OpenCV's FaceDetectorYN), converted with
+ *   onnx2ncnn so the heads keep their ONNX names (cls_8, obj_8, bbox_8,
+ *   kps_8, ... for strides 8, 16 and 32). BGR input, no normalization.
+ * - Any SCRFD export (say scrfd_500m at a 320 input), through ScrfdDetector.
+ */
+
+/**
+ * Load the detector `stem` (.param / .bin) at `input_side` (long side).
+ *
+ * @return nullptr with `error` set if the files are missing or are neither
+ *         YuNet nor SCRFD
+ */
+std::unique_ptr<FaceDetector> LoadLightDetector(const std::string& stem,
+                                                int input_side,
+                                                float conf_thresh,
+                                                const DetectorOptions& options,
+                                                std::string& error);
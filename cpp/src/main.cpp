@@ -1,16 +1,49 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
-#include "stb_image.h"
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
+#include "autotune.hpp"
+#include "blur_render.hpp"
+#include "calibration.hpp"
+#include "chunk_stitch.hpp"
+#include "detection_scheduler.hpp"
+#include "embedded_models.hpp"
+#include "evaluation.hpp"
+#include "frame_container.hpp"
+#include "huge_pages.hpp"
+#include "inference_backend.hpp"
+#include "json_writer.hpp"
+#include "keyframes.hpp"
+#include "memory_budget.hpp"
+#include "mogrt_keyframes.hpp"
+#include "numa.hpp"
 #include "scrfd.hpp"
 #include "pipeline.hpp"
+#include "power_state.hpp"
+#include "server.hpp"
+#include "streaming.hpp"
+#include "sweep.hpp"
+#include "thread_pool.hpp"
+#include "track_binary.hpp"
+#include "video_source.hpp"
+#include "watch_source.hpp"
 
 // Exit codes
 enum ExitCode {
@@ -28,22 +61,338 @@ void PrintUsage(const char* prog) {
     fprintf(stderr, "Usage:\n");
     fprintf(stderr, "  Single image detection:\n");
     fprintf(stderr, "    %s --model <dir> --image <path> [--conf <float>] [--nms <float>]\n\n", prog);
+    fprintf(stderr, "  Detection on many images (one JSON line per image as it finishes):\n");
+    fprintf(stderr, "    %s --model <dir> --detect-images [--images-file <path>] [--detect-workers <n>]\n", prog);
+    fprintf(stderr, "    (reads image paths from stdin, one per line, or from --images-file)\n");
     fprintf(stderr, "  Multi-frame tracking:\n");
     fprintf(stderr, "    %s --model <dir> --track [options]\n", prog);
-    fprintf(stderr, "    (reads image paths from stdin, one per line, or from --images-file)\n\n");
+    fprintf(stderr, "    (reads image paths from stdin, one per line, or from --images-file)\n");
+    fprintf(stderr, "    %s --model <dir> --frames <pattern> --range <first>:<last> [options]\n", prog);
+    fprintf(stderr, "    (image sequence described by a printf-style pattern)\n");
+    fprintf(stderr, "    %s --model <dir> --raw-input <path|-> [--raw-size WxH --raw-format <fmt>] [options]\n", prog);
+    fprintf(stderr, "    (reads packed raw frames from a file, FIFO or stdin)\n");
+    fprintf(stderr, "    %s --model <dir> --video <file> [--video-hwaccel <mode>] [options]\n", prog);
+    fprintf(stderr, "    (decodes a video file directly; requires an FFmpeg-enabled build)\n");
+    fprintf(stderr, "    %s --model <dir> --watch <dir> [--pattern <fmt>] (--watch-frames <n> | --watch-sentinel <name>) [options]\n", prog);
+    fprintf(stderr, "    (tracks an image sequence while it is still being exported into <dir>)\n");
+    fprintf(stderr, "  INT8 calibration (image sequences, see scripts/calibrate_int8.py):\n");
+    fprintf(stderr, "    %s --model <dir> --images-file <path> --export-calibration <out> [--reid-model <dir>]\n", prog);
+    fprintf(stderr, "    %s --model <dir> --images-file <path> --int8-parity [--reid-model <dir>]\n", prog);
+    fprintf(stderr, "  Per-machine thread counts (measured on the sequence, saved for later runs):\n");
+    fprintf(stderr, "    %s --model <dir> --images-file <path> --autotune [--reid-model <dir>] [options]\n", prog);
+    fprintf(stderr, "  Server (JSON-RPC requests one per line on stdin, models kept loaded; see server.hpp):\n");
+    fprintf(stderr, "    %s --model <dir> --serve [--reid-model <dir>] [options]\n", prog);
+    fprintf(stderr, "  Frames the settings need (JSON on stdout, for exporters choosing a render size):\n");
+    fprintf(stderr, "    %s --model <dir> --describe-requirements [--reid-model <dir>] [options]\n", prog);
+    fprintf(stderr, "  Batch (one JSON object a line: track params plus \"output\"; see server.hpp):\n");
+    fprintf(stderr, "    %s --model <dir> --batch <manifest> [--batch-workers <n>] [--numa <mode>] [options]\n", prog);
+    fprintf(stderr, "    (tracks the clips a few at a time with the models loaded once; \"-\" = stdin)\n");
+    fprintf(stderr, "  Long timelines in chunks (one process or machine each, then merged):\n");
+    fprintf(stderr, "    %s --model <dir> <input> --chunk <start>:<end> --emit-tracklets <file> [options]\n", prog);
+    fprintf(stderr, "    %s --stitch <file> <file> ... [--reid-link-* options]\n", prog);
+    fprintf(stderr, "  Accuracy and throughput against annotated clips (MOTChallenge gt.txt; see evaluation.hpp):\n");
+    fprintf(stderr, "    %s --model <dir> --evaluate <manifest> [--eval-baseline <report>] [options]\n", prog);
+    fprintf(stderr, "  Tracking parameter sweep (over a dump made with --dump-warps):\n");
+    fprintf(stderr, "    %s --sweep --replay-detections <file> [--sweep-iou <list>] [--sweep-max-age <list>] ...\n\n", prog);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  --model <dir>        Directory containing scrfd.param and scrfd.bin\n");
+    fprintf(stderr, "                       (\":builtin\" = models compiled in, the default in such builds)\n");
     fprintf(stderr, "  --image <path>       Single image path (detection mode)\n");
     fprintf(stderr, "  --track              Enable tracking mode (reads paths from stdin)\n");
     fprintf(stderr, "  --images-file <path> File containing image paths, one per line\n");
+    fprintf(stderr, "  --frames <pattern>   printf-style frame path, e.g. /tmp/x/frame%%06d.png (needs --range)\n");
+    fprintf(stderr, "  --range <a>:<b>      Inclusive frame number range for --frames\n");
+    fprintf(stderr, "  --chunk <s>:<e>      Track input frames s..e-1 (and the overlap around them); frame\n");
+    fprintf(stderr, "                       indices and frameCount in the output stay the input's\n");
+    fprintf(stderr, "  --chunk-overlap <n>  Frames also tracked before and after the chunk, where --stitch\n");
+    fprintf(stderr, "                       matches its tracks with the neighbours' (default: 30)\n");
+    fprintf(stderr, "  --emit-tracklets <f> Also write the tracks (with ReID, their appearances) to <f> for --stitch\n");
+    fprintf(stderr, "  --stitch <files>     Merge chunks' --emit-tracklets files into one output with track IDs\n");
+    fprintf(stderr, "                       over the whole timeline (overlap IoU, then offline ReID linking)\n");
+    fprintf(stderr, "  --stream-paths       Start tracking as paths arrive instead of waiting for EOF\n");
+    fprintf(stderr, "  --raw-input <path>   Raw frame stream (\"-\" = stdin); starts with\n");
+    fprintf(stderr, "                       'FPRAW <w> <h> <fmt> [frames]\\n' unless --raw-size is given\n");
+    fprintf(stderr, "  --raw-size <WxH>     Headerless raw stream geometry\n");
+    fprintf(stderr, "  --raw-format <fmt>   Headerless raw pixel format: rgb24, bgra, nv12 (default: rgb24)\n");
+    fprintf(stderr, "  --video <file>       Video file input (frame rate defaults to the stream's)\n");
+    fprintf(stderr, "  --video-hwaccel <m>  auto, none, videotoolbox, d3d11va, dxva2 (default: auto)\n");
+    fprintf(stderr, "  --watch <dir>        Folder an exporter is writing frames into\n");
+    fprintf(stderr, "  --pattern <fmt>      Frame file name pattern (default: frame%%06d.png)\n");
+    fprintf(stderr, "  --watch-start <n>    Number of the first frame file (default: 0)\n");
+    fprintf(stderr, "  --watch-frames <n>   Finish after this many frames\n");
+    fprintf(stderr, "  --watch-sentinel <f> Finish once this file appears in the watch folder\n");
+    fprintf(stderr, "  --frame-cache <file> Record decoded frames on the first run, memory-map them on later runs\n");
     fprintf(stderr, "  --conf <float>       Confidence threshold (default: 0.5)\n");
     fprintf(stderr, "  --nms <float>        NMS IoU threshold (default: 0.4)\n");
     fprintf(stderr, "  --iou <float>        Tracking IoU threshold (default: 0.15)\n");
+    fprintf(stderr, "  --max-age <n>        Frames a track survives without a detection (default: 90)\n");
+    fprintf(stderr, "  --tentative-max-age <n> Same for tracks with fewer than 3 detections, so false\n");
+    fprintf(stderr, "                       positives stop early (default: 0 = --max-age)\n");
+    fprintf(stderr, "  --dormant-after <n>  Frames without a detection after which a track is only recovered\n");
+    fprintf(stderr, "                       from its last observation and not output (default: 0 = never)\n");
+    fprintf(stderr, "  --inertia <f>        OC-SORT velocity direction weight (default: 0.2)\n");
+    fprintf(stderr, "  --motion-gate <chi2> Skip detection-track pairs past this Mahalanobis distance on center\n");
+    fprintf(stderr, "                       and scale, from each track's uncertainty (e.g. 11.34; default: off)\n");
+    fprintf(stderr, "  --kf-joseph          Joseph-form Kalman covariance updates (symmetric under rounding)\n");
     fprintf(stderr, "  --detection-fps <f>  Detection sampling rate (default: 5.0)\n");
     fprintf(stderr, "  --video-fps <float>  Source video FPS (default: 30.0)\n");
-    fprintf(stderr, "  --reid-model <dir>   Optional dir containing mobilefacenet-*.param/.bin\n");
+    fprintf(stderr, "  --reid-model <dir>   Optional dir containing mobilefacenet-*.param/.bin (or \":builtin\")\n");
     fprintf(stderr, "  --reid-weight <f>    ReID appearance weight (default: 0.35)\n");
     fprintf(stderr, "  --reid-cos <f>       ReID cosine gate threshold (default: 0.35)\n");
+    fprintf(stderr, "  --lazy-reid          Embed only new, ambiguous or stale-appearance faces\n");
+    fprintf(stderr, "  --reid-refresh <n>   Lazy ReID: re-embed a settled track every <n> observations\n");
+    fprintf(stderr, "                       (default: 10, 0 = never; implies --lazy-reid)\n");
+    fprintf(stderr, "  --reid-min-face <px> Skip ReID for faces whose shorter side is below <px>\n");
+    fprintf(stderr, "  --reid-min-score <f> Skip ReID for detections scoring below <f>\n");
+    fprintf(stderr, "  --reid-min-eye <px>  Skip ReID when the landmark eye distance is below <px>\n");
+    fprintf(stderr, "  --reid-blur-precheck Reject blurry faces from a half-size crop before the full warp\n");
+    fprintf(stderr, "  --reid-budget <n>    Embed at most <n> faces per frame, largest first (default: 0 = all)\n");
+    fprintf(stderr, "  --reid-sharpen-var <f> Sharpen ReID crops with Laplacian variance below <f> (default: 50)\n");
+    fprintf(stderr, "  --reid-skip-var <f>  Skip ReID crops with Laplacian variance below <f> (default: 12)\n");
+    fprintf(stderr, "  --reid-sharpen-alpha <f> Strength of that sharpening (default: 0.6)\n");
+    fprintf(stderr, "  --reid-min-quality <f> Crop quality a sample needs to update a track's appearance (default: 0.4)\n");
+    fprintf(stderr, "  --reid-link-gap <s>  Offline linking: plain cosine threshold for gaps up to <s> seconds (default: 2)\n");
+    fprintf(stderr, "  --reid-link-max-gap <s> Offline linking: longest gap bridged, in seconds (default: 10)\n");
+    fprintf(stderr, "  --reid-link-long-sim <f> Offline linking: cosine floor for longer gaps (default: 0.5)\n");
+    fprintf(stderr, "  --reid-storage <f32|f16|int8> Precision of track appearances kept for linking (default: f32)\n");
+    fprintf(stderr, "  --gallery <file>     Identity gallery shared across runs: tracks get an \"identity\" matched\n");
+    fprintf(stderr, "                       against it, and new people are added (needs --reid-model)\n");
+    fprintf(stderr, "  --gallery-min-sim <f> Cosine similarity needed to reuse a gallery identity (default: 0.5)\n");
+    fprintf(stderr, "  --decode-threads <n> Frame decoder threads (default: auto)\n");
+    fprintf(stderr, "  --cpu-powersave <n>  Cores to run on: 0 = all, 1 = efficiency/little, 2 = performance/big\n");
+    fprintf(stderr, "                       (default: 0; every thread quota is derived from them)\n");
+    fprintf(stderr, "  --energy-profile <p> off, auto (on battery or in low-power mode) or on: efficiency\n");
+    fprintf(stderr, "                       cores, half the detection rate and the fast speed profile unless\n");
+    fprintf(stderr, "                       set by their own flags; half the detector threads under thermal\n");
+    fprintf(stderr, "                       pressure (default: off)\n");
+    fprintf(stderr, "  --huge-pages         Back frame planes and detector blobs with transparent huge pages\n");
+    fprintf(stderr, "                       (Linux; fewer TLB misses on 4K/8K frames)\n");
+    fprintf(stderr, "  --numa <mode>        --batch on multi-socket machines: off, nodes (each clip on one node,\n");
+    fprintf(stderr, "                       its threads and frames local) or replicas (plus a model copy per\n");
+    fprintf(stderr, "                       node) (default: off)\n");
+    fprintf(stderr, "  --mmap-models        Map model weights read-only instead of reading them, so processes\n");
+    fprintf(stderr, "                       running the same models share the fp32 weights ncnn keeps as-is\n");
+    fprintf(stderr, "  --prefetch-depth <n> Max decoded frames buffered ahead (default: 8, 0 = off)\n");
+    fprintf(stderr, "  --autotune           Time the first frames of --images-file with different decoder,\n");
+    fprintf(stderr, "                       detection and GMC thread counts and prefetch depths, and save the\n");
+    fprintf(stderr, "                       fastest for this machine; later runs use it where flags leave auto\n");
+    fprintf(stderr, "  --autotune-frames <n> Frames each --autotune run tracks (default: 60)\n");
+    fprintf(stderr, "  --autotune-cores <n> Cores --autotune may give one stage (default: all)\n");
+    fprintf(stderr, "  --autotune-profile <file> Profile file (default: ~/.config/face_pipeline_autotune.json)\n");
+    fprintf(stderr, "  --no-autotune-profile Ignore the saved profile\n");
+    fprintf(stderr, "  --read-ahead <n>     Read image files up to n frames ahead of their decode, for\n");
+    fprintf(stderr, "                       network storage (default: 0 = off)\n");
+    fprintf(stderr, "  --read-ahead-threads <n> Image file reads in flight at once (default: 4)\n");
+    fprintf(stderr, "  --advise-ahead <n>   Hint the OS to read image files up to n frames ahead of the\n");
+    fprintf(stderr, "                       tracker, without buffering them (default: 0 = off)\n");
+    fprintf(stderr, "  --drop-file-cache    Drop image files from the OS page cache once tracked, so a long\n");
+    fprintf(stderr, "                       sequence does not evict other applications' cached media\n");
+    fprintf(stderr, "  --delete-consumed    Delete each image file once tracked (temporary exports: disk\n");
+    fprintf(stderr, "                       use stays at the frames ahead; disables --refine-boundaries)\n");
+    fprintf(stderr, "  --decode-long-side <px> Allow reduced-resolution RGB decode (JPEG, PNG, NV12, video) down to\n");
+    fprintf(stderr, "                       this long side\n");
+    fprintf(stderr, "                       (default: 1280, 0 = always full resolution)\n");
+    fprintf(stderr, "  --input-scale <n>    The frames are proxies at 1/n of the source resolution; output\n");
+    fprintf(stderr, "                       and pixel options are in source pixels (default: 1)\n");
+    fprintf(stderr, "  --detect-workers <n> Sampled frames detected concurrently (default: auto, 1 = inline)\n");
+    fprintf(stderr, "  --speculative-detect <n> While detection waits on the tracker, detect unsampled frames\n");
+    fprintf(stderr, "                       up to n ahead on a spare core (default: 0 = off; not repeatable)\n");
+    fprintf(stderr, "  --gmc-workers <n>    Frame pairs' camera motion estimated concurrently ahead of tracking\n");
+    fprintf(stderr, "                       (default: auto, 1 = inline; inline with --gmc-mask-faces)\n");
+    fprintf(stderr, "  --balance-stages     Move cores between decode, detection, ReID and GMC workers as their\n");
+    fprintf(stderr, "                       queues show the bottleneck (the worker counts are where they start)\n");
+    fprintf(stderr, "  --balance-period <ms> Rebalance at most this often (default: 250)\n");
+    fprintf(stderr, "  --track-workers <n>  Shots tracked concurrently after detection (default: 1 = inline,\n");
+    fprintf(stderr, "                       0 = auto); needs scene cuts, ignored with --adaptive-detect,\n");
+    fprintf(stderr, "                       --roi-side, --det-tile-refresh, --adaptive-input, --cascade-input,\n");
+    fprintf(stderr, "                       --prune-strides and --lazy-reid\n");
+    fprintf(stderr, "  --smooth-lag <n>     Smooth track boxes (fixed-lag RTS, n frames of look-ahead;\n");
+    fprintf(stderr, "                       default: 0 = off)\n");
+    fprintf(stderr, "  --refine-boundaries  Find each track's first and last frame exactly by detecting on the\n");
+    fprintf(stderr, "                       frames around them after the run (needs random access)\n");
+    fprintf(stderr, "  --keyframe-tolerance <px> Output only the frames of each track that linear interpolation\n");
+    fprintf(stderr, "                       between the others misses by more than px pixels (default: 0 = all)\n");
+    fprintf(stderr, "  --proxy-dir <dir>    Also write every decoded frame, scaled down, as <dir>/<frame>.jpg\n");
+    fprintf(stderr, "                       (frame index, 6 digits) for scrubbing; needs the whole input\n");
+    fprintf(stderr, "                       read forwards (not --chunk or --priority-frame)\n");
+    fprintf(stderr, "  --proxy-height <n>   Proxy rows (default: 480)\n");
+    fprintf(stderr, "  --compact-tracks     Keep finished tracks quantized (16-bit boxes, 8-bit confidence) as\n");
+    fprintf(stderr, "                       keyframes until output, for very long inputs\n");
+    fprintf(stderr, "  --track-spill-mb <n> With --compact-tracks: move finished tracks to a temporary file\n");
+    fprintf(stderr, "                       once they take n MB (default: 0 = keep in memory)\n");
+    fprintf(stderr, "  --memory-budget <mb> Keep frame queues, the detection cache and (--compact-tracks)\n");
+    fprintf(stderr, "                       finished tracks within mb MB together: queues decode fewer frames\n");
+    fprintf(stderr, "                       ahead, tracks spill, the cache stops growing; the peak is reported\n");
+    fprintf(stderr, "                       at exit (default: 0 = no limit)\n");
+    fprintf(stderr, "  --memory-report      Report peak memory at exit without a budget: caches, queues, the\n");
+    fprintf(stderr, "                       frames, detections and track data of the tracking loop, peak RSS,\n");
+    fprintf(stderr, "                       and allocations per stage in FACE_PIPELINE_ALLOC_STATS builds\n");
+    fprintf(stderr, "  --bidirectional-tracking Also track each shot backwards in time and fuse both passes:\n");
+    fprintf(stderr, "                       steadier boxes between sparse detections; same restrictions\n");
+    fprintf(stderr, "                       as --track-workers\n");
+    fprintf(stderr, "  --detection-cache <file> Keep each detection frame's faces and embeddings in <file>,\n");
+    fprintf(stderr, "                       keyed by frame content and models: re-runs with other tracking\n");
+    fprintf(stderr, "                       settings skip detection and ReID (not with --lazy-reid)\n");
+    fprintf(stderr, "  --dump-detections <file> Write the tracker input (detections with embeddings) to <file>\n");
+    fprintf(stderr, "  --dump-warps         With --dump-detections: every frame's GMC warp and shot flags too\n");
+    fprintf(stderr, "  --replay-detections <file> Track from a dump instead of running the models; a dump\n");
+    fprintf(stderr, "                       with warps needs no frames (--track alone), else give the input\n");
+    fprintf(stderr, "  --evaluate <manifest> Track each clip of <manifest> (one JSON object a line: \"name\",\n");
+    fprintf(stderr, "                       \"imagesFile\", \"groundTruth\", \"videoFps\") and print a JSON report of\n");
+    fprintf(stderr, "                       HOTA / IDF1 / MOTA, frames per second, stage times and peak memory\n");
+    fprintf(stderr, "  --eval-baseline <report> Fail (exit %d) if a clip or the total falls short of an earlier\n",
+            ERR_SELF_TEST_FAILED);
+    fprintf(stderr, "                       --evaluate report by more than the tolerances below\n");
+    fprintf(stderr, "  --eval-tolerance <f> Largest HOTA, IDF1 or MOTA drop allowed (default: 0.01)\n");
+    fprintf(stderr, "  --eval-fps-tolerance <f> Largest frames-per-second drop allowed, as a fraction of the\n");
+    fprintf(stderr, "                       baseline's (default: 0.25)\n");
+    fprintf(stderr, "  --sweep              Track the --replay-detections dump once per combination of the\n");
+    fprintf(stderr, "                       --sweep-* values, in parallel (JSON report per configuration)\n");
+    fprintf(stderr, "  --sweep-iou <list>   Comma-separated tracking IoU thresholds (default: --iou)\n");
+    fprintf(stderr, "  --sweep-max-age <list> Comma-separated max track ages (default: --max-age)\n");
+    fprintf(stderr, "  --sweep-inertia <list> Comma-separated inertia weights (default: --inertia)\n");
+    fprintf(stderr, "  --sweep-reid-weight <list> Comma-separated ReID weights (default: --reid-weight)\n");
+    fprintf(stderr, "  --sweep-reid-cos <list> Comma-separated ReID cosine gates (default: --reid-cos)\n");
+    fprintf(stderr, "  --sweep-workers <n>  Configurations tracked at once (default: 0 = one per core)\n");
+    fprintf(stderr, "  --segments <file>    Write each tracklet to <file> (JSON lines) as soon as it ends; the\n");
+    fprintf(stderr, "                       output then holds the open tracks and segmentLinks (tracks inline)\n");
+    fprintf(stderr, "  --stream-events      Output JSON lines as the run goes instead: \"progress\" events, a\n");
+    fprintf(stderr, "                       \"segment\" per tracklet as it ends, then \"done\" with the open\n");
+    fprintf(stderr, "                       tracks and segmentLinks (tracks inline; --segments is ignored)\n");
+    fprintf(stderr, "  --live               Track a feed as it arrives: each frame's boxes out as a JSON line\n");
+    fprintf(stderr, "                       within --live-latency, frames dropped rather than queued, the\n");
+    fprintf(stderr, "                       detector input shrunk to fit; online tracks only (no ReID, GMC or\n");
+    fprintf(stderr, "                       linking). Input of known length replays at --video-fps\n");
+    fprintf(stderr, "  --live-latency <n>   Frame periods a frame's boxes are due in (default: 1.5)\n");
+    fprintf(stderr, "  --live-min-input <n> Smallest detector input side (default: 192)\n");
+    fprintf(stderr, "  --output <file>      Write the result to <file> instead of stdout; with --stream-events\n");
+    fprintf(stderr, "                       it holds whole tracks (no \"segment\" events) and \"done\" names it\n");
+    fprintf(stderr, "  --output-format <f>  json, json-compact (one line, no spaces), binary (quantized boxes,\n");
+    fprintf(stderr, "                       little-endian; see track_binary.hpp) or binary-zstd (the same,\n");
+    fprintf(stderr, "                       compressed) (default: json)\n");
+    fprintf(stderr, "  --emit-mogrt-keyframes <file> Also write the tracks as the panel's MOGRT Mask Path\n");
+    fprintf(stderr, "                       keyframes (see mogrt_keyframes.hpp), reduced by --keyframe-tolerance;\n");
+    fprintf(stderr, "                       needs --ticks-per-frame <n> (Premiere ticks of one frame)\n");
+    fprintf(stderr, "  --render-blur <dir>  Also write the input frames with the tracked faces blurred in as\n");
+    fprintf(stderr, "                       <dir>/<frame>.jpg (frame index, 6 digits), the frames of the\n");
+    fprintf(stderr, "                       --chunk only; needs input read in any order (not --video,\n");
+    fprintf(stderr, "                       --raw-input or --watch)\n");
+    fprintf(stderr, "  --blur-amount <n>    Blur reach in pixels, as the panel's Blurriness (default: 50)\n");
+    fprintf(stderr, "  --blur-feather <px>  Mask edge softness, as the panel's Feather (default: 10)\n");
+    fprintf(stderr, "  --blur-expansion <px> Pixels the mask grows past the box, as the panel's Expansion\n");
+    fprintf(stderr, "                       (default: 0)\n");
+    fprintf(stderr, "  --render-format <f>  jpg or png (default: jpg, quality 90)\n");
+    fprintf(stderr, "  --profile <file>     Write per-stage timings of the run to <file> as JSON: calls, total,\n");
+    fprintf(stderr, "                       p50/p95/p99/max ms and wall share of decode, detect, reid, gmc,\n");
+    fprintf(stderr, "                       associate, link and wait, and frames per second\n");
+    fprintf(stderr, "  --trace <file>       Write every such call of the run as a span to <file>, in Chrome\n");
+    fprintf(stderr, "                       trace-event JSON (open it in Perfetto or chrome://tracing)\n");
+    fprintf(stderr, "  --metrics <file>     Write the run's statistics to <file> as JSON: counters, gauges and\n");
+    fprintf(stderr, "                       histograms of GMC, ReID, association, linking and the queues (with\n");
+    fprintf(stderr, "                       --serve or --batch: of every run, at exit)\n");
+    fprintf(stderr, "  --preview            With --stream-events (implied): first a quick coarse pass (320 px\n");
+    fprintf(stderr, "                       detector, 2 fps, no ReID) as a \"preview\" event, then the full\n");
+    fprintf(stderr, "                       run over the same decoded frames; its \"done\" replaces the preview\n");
+    fprintf(stderr, "  --priority-frame <n> Track outward from input frame n (the playhead) first: on to the end\n");
+    fprintf(stderr, "                       and, at the same time, back to the start, joined at n (reads\n");
+    fprintf(stderr, "                       --chunk-overlap frames past it both ways). Needs input read in\n");
+    fprintf(stderr, "                       any order (images, --frames, --frame-cache); streamed segments\n");
+    fprintf(stderr, "                       have provisional IDs and the output holds whole tracks\n");
+    fprintf(stderr, "  --time-budget <s>    Finish within <s> seconds: detect less, then skip ReID, then GMC\n");
+    fprintf(stderr, "                       while the run would not fit; tracks end where time runs out\n");
+    fprintf(stderr, "  --timeout <s>        Stop reading frames after <s> seconds and output what was tracked\n");
+    fprintf(stderr, "  --stop-on-stdin      A \"stop\" line on stdin ends the run like Ctrl-C: the frames read\n");
+    fprintf(stderr, "                       so far are linked and output (needs input not read from stdin)\n");
+    fprintf(stderr, "  --checkpoint <file>  Save the tracking state to <file>, and the track frames to\n");
+    fprintf(stderr, "                       <file>.tracks, as the run goes (fixed-stride detection only;\n");
+    fprintf(stderr, "                       tracks inline)\n");
+    fprintf(stderr, "  --checkpoint-every <n> Frames between checkpoints (default: 300)\n");
+    fprintf(stderr, "  --resume             Start from the --checkpoint file when it was made with the same\n");
+    fprintf(stderr, "                       settings on the same input, e.g. to extend a run over more frames\n");
+    fprintf(stderr, "  --no-reid-stage      With detect workers: embed faces on the detection workers instead\n");
+    fprintf(stderr, "                       of a ReID thread of their own\n");
+    fprintf(stderr, "  --speed-profile <p>  Pick the SCRFD variant and input size: fast, balanced, accurate\n");
+    fprintf(stderr, "                       (variants: scrfd_500m/2.5g/10g[_kps] in --model; default: scrfd at 640)\n");
+    fprintf(stderr, "  --ms-per-frame <ms>  Benchmark the variants once and take the most accurate within <ms>\n");
+    fprintf(stderr, "  --bench-cache <file> Benchmark results file (default: ~/.cache/face_pipeline_scrfd_bench.txt)\n");
+    fprintf(stderr, "  --gpu                Run detection and ReID on a Vulkan GPU (falls back to CPU)\n");
+    fprintf(stderr, "  --gpu-device <n>     Vulkan device index (default: ncnn's default device)\n");
+    fprintf(stderr, "  --gpu-cpu-preprocess With --gpu: resize and normalize frames on the CPU, not the device\n");
+    fprintf(stderr, "  --coreml             Detect with Core ML when the model has a .mlmodelc next to it (macOS)\n");
+    fprintf(stderr, "  --coreml-units <u>   Core ML compute units: all, ane, gpu, cpu (default: all; implies --coreml)\n");
+    fprintf(stderr, "  --onnx               Run detection and ReID on ONNX Runtime (DirectML on Windows) when\n");
+    fprintf(stderr, "                       the models have a .onnx export next to them\n");
+    fprintf(stderr, "  --onnx-device <n>    DirectML adapter index (default: 0; implies --onnx)\n");
+    fprintf(stderr, "  --det-threads <n>    Detector inference threads (default: ncnn, physical big cores)\n");
+    fprintf(stderr, "  --det-no-fp16        Disable fp16 packed/storage/arithmetic in the detector\n");
+    fprintf(stderr, "  --det-no-fp16-arith  Keep fp16 storage but compute in fp32\n");
+    fprintf(stderr, "  --det-no-winograd    Disable winograd convolution kernels\n");
+    fprintf(stderr, "  --det-no-sgemm       Disable sgemm convolution kernels\n");
+    fprintf(stderr, "  --det-no-packing     Disable packed (SIMD) blob layout\n");
+    fprintf(stderr, "  --det-square-input   Letterbox to the full 640x640 input instead of the frame's aspect\n");
+    fprintf(stderr, "  --det-no-lightmode   Keep intermediate blobs alive during inference\n");
+    fprintf(stderr, "  --det-tile <px>      Also detect in overlapping <px> tiles (small faces in 4K; default: off)\n");
+    fprintf(stderr, "  --det-tile-overlap <f> Fraction of a tile shared with its neighbours (default: 0.25)\n");
+    fprintf(stderr, "  --det-tile-workers <n> Tiles detected concurrently (default: auto)\n");
+    fprintf(stderr, "  --det-tile-no-full   Skip the whole-frame pass in tiled mode\n");
+    fprintf(stderr, "  --det-tile-refresh <n> Scan all tiles every nth detection, else only tiles near tracks\n");
+    fprintf(stderr, "  --adaptive-input <px> Shrink the detector input (down to 320) while the smallest track\n");
+    fprintf(stderr, "                       keeps <px> input pixels; inline detection only (default: 0 = off)\n");
+    fprintf(stderr, "  --adaptive-input-refresh <n> Full input every nth detection (default: 8)\n");
+    fprintf(stderr, "  --cascade-input <px> Detect at <px> first (e.g. 320) and run the full input only when\n");
+    fprintf(stderr, "                       that pass is in doubt; inline detection only (default: 0 = off)\n");
+    fprintf(stderr, "  --cascade-min-score <f> Coarse candidates from <f> up to --conf are doubtful (default: 0.3)\n");
+    fprintf(stderr, "  --cascade-refresh <n> Full input every nth cascaded detection (default: 8)\n");
+    fprintf(stderr, "  --min-face <px>      Smallest face side to detect: SCRFD skips the stride heads only\n");
+    fprintf(stderr, "                       smaller faces need (default: 0 = all strides)\n");
+    fprintf(stderr, "  --prune-strides      Skip the stride heads only faces under half the smallest track's\n");
+    fprintf(stderr, "                       size need; inline detection only\n");
+    fprintf(stderr, "  --prune-refresh <n>  Every stride every nth pruned detection (default: 8)\n");
+    fprintf(stderr, "  --roi-side <px>      Between detections, detect in crops around tracks letterboxed\n");
+    fprintf(stderr, "                       to at most <px> (e.g. 256; default: 0 = off)\n");
+    fprintf(stderr, "  --roi-margin <f>     Crop margin per side as a fraction of the box size (default: 0.5)\n");
+    fprintf(stderr, "  --roi-mosaic         Pack a frame's ROI crops side by side into one detector input\n");
+    fprintf(stderr, "  --landmark-flow      Between detections, follow each track's landmarks by optical flow\n");
+    fprintf(stderr, "                       and observe its box from them instead of only predicting it\n");
+    fprintf(stderr, "  --scan-fps <f>       Scan for faces at <f> fps first, then detect at --detection-fps only\n");
+    fprintf(stderr, "                       near faces found and while tracks live (default: 0 = off)\n");
+    fprintf(stderr, "  --adaptive-detect    Pick detection frames from track uncertainty and camera motion\n");
+    fprintf(stderr, "  --detect-budget-fps <f> Adaptive: average detections per second (default: --detection-fps)\n");
+    fprintf(stderr, "  --max-detect-interval <n> Adaptive: frames between forced detections (default: 3x stride)\n");
+    fprintf(stderr, "  --no-scene-cuts      Keep tracks alive across detected hard cuts\n");
+    fprintf(stderr, "  --cuts <list>        Frames the editor cut to (e.g. 120,340): reset tracks, detect\n");
+    fprintf(stderr, "                       and skip camera motion there, as at a detected cut\n");
+    fprintf(stderr, "  --cuts-file <file>   Read --cuts from a file (indices separated by whitespace or commas)\n");
+    fprintf(stderr, "  --duplicate-diff <f> Repeat the previous frame's tracks when no 16x16 luma block changed\n");
+    fprintf(stderr, "                       by more than <f> levels on average (default: 1.5, 0 = off)\n");
+    fprintf(stderr, "  --light-detector <stem> Hybrid schedule: run this ultra-light YuNet or SCRFD model on\n");
+    fprintf(stderr, "                       every frame between detections (a bare name is in the model dir)\n");
+    fprintf(stderr, "  --light-input <n>    Light detector input side (default: 320)\n");
+    fprintf(stderr, "  --light-conf <f>     Light detector confidence threshold (default: 0.6)\n");
+    fprintf(stderr, "  --idle-fast-forward  While no track is alive, skip decoding, camera motion and tracking\n");
+    fprintf(stderr, "                       of the frames between detections\n");
+    fprintf(stderr, "  --keyframe-snap <n>  --video: move a detection frame up to n frames onto the nearest\n");
+    fprintf(stderr, "                       keyframe, which decodes without the frames before it; with\n");
+    fprintf(stderr, "                       --idle-fast-forward, idle GOPs are skipped (default: 0 = off)\n");
+    fprintf(stderr, "  --gmc-features       Without OpenCV: estimate camera motion from tracked corners\n");
+    fprintf(stderr, "                       (rotation and zoom too) instead of a translation search\n");
+    fprintf(stderr, "  --gmc-phase          Without OpenCV: estimate camera translation by FFT phase correlation\n");
+    fprintf(stderr, "  --gmc-adaptive       Without OpenCV: per frame pair, the cheapest of translation, similarity\n");
+    fprintf(stderr, "                       and homography that fits (features only where a translation does not)\n");
+    fprintf(stderr, "  --gmc-motion-vectors With --video: fit camera motion to the decoder's motion vectors\n");
+    fprintf(stderr, "                       (decodes in software), pixels only on frames without them\n");
+    fprintf(stderr, "  --gmc-homography     Camera motion as a homography instead of a similarity\n");
+    fprintf(stderr, "  --no-static-camera   Estimate camera motion on every frame, also on shots it finds static\n");
+    fprintf(stderr, "  --gmc-interval <n>   On smooth motion, estimate camera motion every <n> frames and carry\n");
+    fprintf(stderr, "                       the per-frame step between (default: 0 = every frame pair)\n");
+    fprintf(stderr, "  --gmc-interval-residual <px> Corner miss of the carried steps that falls back to\n");
+    fprintf(stderr, "                       estimating every pair for an interval (default: 8)\n");
+    fprintf(stderr, "  --gmc-mask-faces     Leave detected faces out of camera motion (GMC) estimation\n");
+    fprintf(stderr, "  --int8               Load scrfd-int8 / mobilefacenet-int8 models when present\n");
+    fprintf(stderr, "  --export-calibration <dir> Write INT8 calibration samples from the sequence\n");
+    fprintf(stderr, "  --int8-parity        Compare INT8 models with fp32 on the sequence (JSON report)\n");
+    fprintf(stderr, "  --int8-min-recall <f> Parity fails below this detection recall (default: 0.95)\n");
+    fprintf(stderr, "  --calib-frames <n>   Frames sampled for calibration and parity (default: 100)\n");
     fprintf(stderr, "  --test-ocsort        Run a deterministic OC-SORT self-test\n");
     fprintf(stderr, "\nOutput: JSON to stdout\n");
     fprintf(stderr, "\nExit codes:\n");
@@ -53,7 +402,7 @@ void PrintUsage(const char* prog) {
     fprintf(stderr, "  3 - Image load failed\n");
     fprintf(stderr, "  4 - Inference error\n");
     fprintf(stderr, "  5 - No input provided\n");
-    fprintf(stderr, "  6 - Self-test failed\n");
+    fprintf(stderr, "  6 - Self-test failed (or INT8 parity below --int8-min-recall)\n");
 }
 
 // Read image paths from stdin (one per line)
@@ -91,47 +440,81 @@ std::vector<std::string> ReadPathsFromFile(const std::string& filepath) {
 
 // Escape string for JSON
 std::string JsonEscape(const std::string& s) {
-    std::ostringstream result;
-    for (char c : s) {
-        switch (c) {
-            case '\"': result << "\\\""; break;
-            case '\\': result << "\\\\"; break;
-            case '\b': result << "\\b"; break;
-            case '\f': result << "\\f"; break;
-            case '\n': result << "\\n"; break;
-            case '\r': result << "\\r"; break;
-            case '\t': result << "\\t"; break;
-            default: result << c;
-        }
-    }
-    return result.str();
+    std::string result;
+    result.reserve(s.size());
+    AppendJsonEscaped(result, s);
+    return result;
+}
+
+// Parse a comma-separated list of numbers; false if an item is not one.
+template <typename T>
+bool ParseNumberList(const char* text, std::vector<T>& out) {
+    out.clear();
+    std::stringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        char* end = nullptr;
+        const double v = strtod(item.c_str(), &end);
+        if (item.empty() || *end != '\0') return false;
+        out.push_back(static_cast<T>(v));
+    }
+    return !out.empty();
+}
+
+// Read frame indices separated by whitespace, commas or newlines; false if
+// the file cannot be read or an item is not one.
+bool ReadFrameList(const std::string& filepath, std::vector<int>& out) {
+    std::ifstream file(filepath);
+    if (!file.is_open()) return false;
+    out.clear();
+    std::string item;
+    while (file >> item) {
+        std::stringstream parts(item);
+        std::string part;
+        while (std::getline(parts, part, ',')) {
+            if (part.empty()) continue;
+            char* end = nullptr;
+            const long v = strtol(part.c_str(), &end, 10);
+            if (*end != '\0' || v < 0) return false;
+            out.push_back(static_cast<int>(v));
+        }
+    }
+    return true;
 }
 
 // Run single image detection (original mode)
 int RunDetection(const std::string& model_dir, const std::string& image_path,
-                 float conf_thresh, float nms_thresh) {
+                 float conf_thresh, float nms_thresh,
+                 const PipelineOptions& options) {
     // Build model paths
-    std::string param_path = model_dir + "/scrfd.param";
-    std::string bin_path = model_dir + "/scrfd.bin";
+    const std::string stem = ResolveDetectorStem(model_dir, options.detector_stem, options.int8);
+    if (options.int8 && stem == ResolveDetectorStem(model_dir, options.detector_stem, false)) {
+        fprintf(stderr, "Warning: no INT8 detector model in %s; using the fp32 detector\n", model_dir.c_str());
+    }
+    std::string param_path = stem + ".param";
+    std::string bin_path = stem + ".bin";
 
     // Load model
-    ScrfdDetector detector(param_path, bin_path, 640, 640, conf_thresh, nms_thresh);
+    ScrfdDetector detector(param_path, bin_path, options.detector_input, options.detector_input,
+                           conf_thresh, nms_thresh, options.detector);
     if (!detector.IsLoaded()) {
         fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
         return ERR_MODEL_NOT_FOUND;
     }
 
-    // Load image
-    int width, height, channels;
-    unsigned char* rgb = stbi_load(image_path.c_str(), &width, &height, &channels, 3);
-    if (!rgb) {
+    // Load image; nothing else runs meanwhile, so it may use every core
+    LoadedRgbFrame frame;
+    FrameRequest req;
+    req.decode_threads = PipelineCoreCount();
+    if (!LoadFrame(image_path, req, frame)) {
         fprintf(stderr, "Error: Failed to load image %s\n", image_path.c_str());
         return ERR_IMAGE_LOAD_FAILED;
     }
+    const int width = frame.w;
+    const int height = frame.h;
 
     // Run detection
-    std::vector<ScrfdFace> faces = detector.Detect(rgb, width, height);
-    stbi_image_free(rgb);
+    std::vector<ScrfdFace> faces = detector.Detect(frame.rgbData(), width, height);
 
     // Output JSON
     printf("{\n");
@@ -162,62 +545,638 @@ int RunDetection(const std::string& model_dir, const std::string& image_path,
     return SUCCESS;
 }
 
-// Run multi-frame tracking
-int RunTracking(const std::string& model_dir,
-                const std::vector<std::string>& image_paths,
-                float conf_thresh, float iou_thresh,
-                float detection_fps, float video_fps,
-                const std::string& reid_model_dir,
-                float reid_weight,
-                float reid_cos_thresh) {
-    
-    if (image_paths.empty()) {
-        fprintf(stderr, "Error: No image paths provided\n");
-        return ERR_NO_INPUT;
+// Detect every image of a list (--detect-images) with the model loaded once,
+// `detect_workers` images at a time, and print one JSON line per image as it
+// finishes: "index" is its line in the list. Images that fail to load get
+// an "error" line instead.
+int RunDetectionList(const std::string& model_dir, const std::vector<std::string>& image_paths,
+                     float conf_thresh, float nms_thresh,
+                     const PipelineOptions& options) {
+    const std::string stem = ResolveDetectorStem(model_dir, options.detector_stem, options.int8);
+    if (options.int8 && stem == ResolveDetectorStem(model_dir, options.detector_stem, false)) {
+        fprintf(stderr, "Warning: no INT8 detector model in %s; using the fp32 detector\n", model_dir.c_str());
     }
-    
-    // Create pipeline
-    FacePipeline pipeline(model_dir, conf_thresh, detection_fps, iou_thresh,
-                          reid_model_dir, reid_weight, reid_cos_thresh);
-    
-    if (!pipeline.isLoaded()) {
+    const int workers = std::max(1, std::min(DetectionScheduler::ResolveWorkerCount(options.detect_workers),
+                                             static_cast<int>(image_paths.size())));
+    // Concurrent images share the cores, as detection workers do.
+    DetectorOptions det = options.detector;
+    if (det.num_threads <= 0 && workers > 1) det.num_threads = std::max(1, PipelineCoreCount() / workers);
+    ScrfdDetector detector(stem + ".param", stem + ".bin", options.detector_input, options.detector_input,
+                           conf_thresh, nms_thresh, det);
+    if (!detector.IsLoaded()) {
         fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
         return ERR_MODEL_NOT_FOUND;
     }
-    
-    // Process frames
-    PipelineResult result = pipeline.process(image_paths, video_fps);
-    
-    // Output JSON
-    printf("{\n");
-    printf("  \"tracks\": [\n");
-    
+
+    std::atomic<size_t> next{0};
+    std::atomic<int> failed{0};
+    std::mutex out_mu;
+    auto work = [&]() {
+        ConfigureWorkerThread();
+        LoadedRgbFrame frame;
+        std::string line;
+        for (size_t i = next++; i < image_paths.size(); i = next++) {
+            line.clear();
+            {
+                JsonWriter w(line);
+                w.raw("{\"index\": ").integer(static_cast<int64_t>(i)).raw(", \"image\": ").string(image_paths[i]);
+                if (!LoadRgbFrame(image_paths[i], frame)) {
+                    failed++;
+                    w.raw(", \"error\": \"cannot load image\"}\n");
+                } else {
+                    const std::vector<ScrfdFace> faces = detector.Detect(frame.rgbData(), frame.w, frame.h);
+                    w.raw(", \"width\": ").integer(frame.w).raw(", \"height\": ").integer(frame.h);
+                    w.raw(", \"faces\": [");
+                    for (size_t f = 0; f < faces.size(); ++f) {
+                        const ScrfdFace& face = faces[f];
+                        w.raw(f > 0 ? ", {\"bbox\": [" : "{\"bbox\": [");
+                        for (int k = 0; k < 4; ++k) w.raw(k > 0 ? ", " : "").fixed(face.bbox[k], 2);
+                        w.raw("], \"confidence\": ").fixed(face.score, 4).raw(", \"landmarks\": [");
+                        for (int k = 0; k < 5; ++k) {
+                            w.raw(k > 0 ? ", [" : "[").fixed(face.landmarks[k][0], 2).raw(", ");
+                            w.fixed(face.landmarks[k][1], 2).ch(']');
+                        }
+                        w.raw("]}");
+                    }
+                    w.raw("]}\n");
+                }
+            }
+            std::lock_guard<std::mutex> lock(out_mu);
+            fwrite(line.data(), 1, line.size(), stdout);
+            fflush(stdout);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < workers; ++t) threads.emplace_back(work);
+    work();
+    for (std::thread& t : threads) t.join();
+
+    if (failed > 0) fprintf(stderr, "Error: %d of %zu images failed to load\n", failed.load(), image_paths.size());
+    return failed == static_cast<int>(image_paths.size()) ? ERR_IMAGE_LOAD_FAILED : SUCCESS;
+}
+
+// Ctrl-C, SIGTERM and --stop-on-stdin end a tracking run early; it still
+// links and outputs the frames it has read. A second signal kills.
+std::atomic<bool> g_stop_requested{false};
+
+extern "C" void RequestStop(int sig) {
+    g_stop_requested.store(true);
+    std::signal(sig, SIG_DFL);
+}
+
+// --preview: the coarse pass's detector input side and detection rate.
+constexpr int kPreviewDetectorInput = 320;
+constexpr float kPreviewDetectionFps = 2.0f;
+
+// A file name of its own in the temporary directory, for `what`.
+std::string TemporaryPath(const char* what) {
+    const char* dir = std::getenv("TMPDIR");
+#ifdef _WIN32
+    if (dir == nullptr) dir = std::getenv("TEMP");
+    const char* fallback = ".";
+#else
+    const char* fallback = "/tmp";
+#endif
+    const auto stamp = std::chrono::system_clock::now().time_since_epoch().count();
+    return std::string(dir != nullptr && *dir != '\0' ? dir : fallback) + "/face_pipeline-" + what + "-" +
+           std::to_string(stamp);
+}
+
+// Where tracking output goes besides the final JSON document.
+struct TrackingOutput {
+    std::string segments_path;   // --segments: finished tracklets, JSON lines
+    bool stream_events = false;  // --stream-events: everything as JSON lines on stdout
+    int chunk_start = -1;        // --chunk: first input frame the run owns (-1 = whole input)
+    int chunk_end = -1;          // one past its last
+    int chunk_overlap = 30;      // --chunk-overlap: frames also tracked on either side
+    std::string tracklets_path;  // --emit-tracklets: the tracks of the chunk, for --stitch
+    bool preview = false;        // --preview: a coarse pass's tracks first, then the refined ones (stream events)
+    int priority_frame = -1;     // --priority-frame: track both ways from this input frame (-1 = from the start)
+    bool binary = false;         // --output-format binary: the result as track_binary.hpp describes, not JSON
+    bool compact_json = false;   // --output-format json-compact: the JSON result on one line, without spaces
+    int zstd_level = 0;          // binary-zstd: payload compressed at this level (0 = stored)
+    std::string output_path;     // --output: the result goes to this file (stdout if empty)
+    std::string mogrt_keyframes_path;  // --emit-mogrt-keyframes: the tracks as MOGRT mask keyframes (mogrt_keyframes.hpp)
+    int64_t ticks_per_frame = 0;       // --ticks-per-frame: Premiere ticks of one frame, for those keyframes
+    BlurRenderOptions blur_render;     // --render-blur: frames with the faces blurred in (dir empty = off)
+    std::string profile_path;          // --profile: the run's per-stage timings (options.profile), as JSON
+    std::string trace_path;            // --trace: its spans as Chrome trace events
+    std::string metrics_path;          // --metrics: the run's statistics (options.metrics), as JSON
+    bool live = false;                 // --live: per-frame boxes within a latency budget (LivePipeline)
+    LiveConfig live_config;            // --live-latency, --live-min-input
+};
+
+// One track frame as a JSON object; `compact` leaves out the spaces.
+void WriteFrameJson(JsonWriter& w, const TrackFrame& frame, bool compact) {
+    const char* sep = compact ? "," : ", ";
+    w.raw(compact ? "{\"frameIndex\":" : "{\"frameIndex\": ").integer(frame.frame_index);
+    w.raw(compact ? ",\"bbox\":[" : ", \"bbox\": [").fixed(frame.bbox.x1, 6).raw(sep);
+    w.fixed(frame.bbox.y1, 6).raw(sep).fixed(frame.bbox.x2, 6).raw(sep);
+    w.fixed(frame.bbox.y2, 6).raw(compact ? "],\"confidence\":" : "], \"confidence\": ").fixed(frame.confidence, 4);
+    w.ch('}');
+}
+
+// A track's frames as a JSON array, on one line.
+void WriteFramesJson(JsonWriter& w, const std::vector<TrackFrame>& frames, bool compact = false) {
+    w.ch('[');
+    for (size_t f = 0; f < frames.size(); ++f) {
+        if (f > 0) w.raw(compact ? "," : ", ");
+        WriteFrameJson(w, frames[f], compact);
+    }
+    w.ch(']');
+}
+
+// Streamed segment -> output track it was linked into (-1 = dropped).
+void WriteSegmentLinksJson(JsonWriter& w, const PipelineResult& result, bool compact = false) {
+    w.ch('{');
+    size_t k = 0;
+    for (const auto& kv : result.segment_links) {
+        if (k++ > 0) w.raw(compact ? "," : ", ");
+        w.ch('"').integer(kv.first).raw(compact ? "\":" : "\": ").integer(kv.second);
+    }
+    w.ch('}');
+}
+
+// The result as one --stream-events event: "done", or "preview" (no segmentLinks).
+void PrintTracksEvent(const char* event, const PipelineResult& result, bool segment_links) {
+    JsonWriter w(stdout);
+    w.raw("{\"event\": \"").raw(event).raw("\", \"tracks\": [");
     for (size_t t = 0; t < result.tracks.size(); ++t) {
         const FaceTrack& track = result.tracks[t];
-        printf("    {\n");
-        printf("      \"id\": %d,\n", track.id);
-        printf("      \"frames\": [\n");
-        
+        if (t > 0) w.raw(", ");
+        w.raw("{\"id\": ").integer(track.id).raw(", ");
+        if (track.identity >= 0) w.raw("\"identity\": ").integer(track.identity).raw(", ");
+        w.raw("\"frames\": ");
+        WriteFramesJson(w, track.frames);
+        w.ch('}');
+    }
+    w.ch(']');
+    if (segment_links) {
+        w.raw(", \"segmentLinks\": ");
+        WriteSegmentLinksJson(w, result);
+    }
+    w.raw(", \"frameCount\": ").integer(result.frame_count);
+    if (result.stopped) w.raw(", \"stopped\": true");
+    w.raw("}\n");
+    w.flush();
+    fflush(stdout);
+}
+
+// The result as the JSON document tracking mode outputs: indented, or
+// (`compact`) on one line without spaces.
+bool PrintResultJson(FILE* out, const PipelineResult& result, bool segment_links, bool compact) {
+    JsonWriter w(out);
+    if (compact) {
+        w.raw("{\"tracks\":[");
+        for (size_t t = 0; t < result.tracks.size(); ++t) {
+            const FaceTrack& track = result.tracks[t];
+            if (t > 0) w.ch(',');
+            w.raw("{\"id\":").integer(track.id);
+            if (track.identity >= 0) w.raw(",\"identity\":").integer(track.identity);
+            w.raw(",\"frames\":");
+            WriteFramesJson(w, track.frames, true);
+            w.ch('}');
+        }
+        w.ch(']');
+        if (segment_links) {
+            w.raw(",\"segmentLinks\":");
+            WriteSegmentLinksJson(w, result, true);
+        }
+        w.raw(",\"frameCount\":").integer(result.frame_count);
+        if (result.stopped) w.raw(",\"stopped\":true");
+        w.raw("}\n");
+        return w.flush();
+    }
+
+    w.raw("{\n");
+    w.raw("  \"tracks\": [\n");
+    for (size_t t = 0; t < result.tracks.size(); ++t) {
+        const FaceTrack& track = result.tracks[t];
+        w.raw("    {\n");
+        w.raw("      \"id\": ").integer(track.id).raw(",\n");
+        if (track.identity >= 0) w.raw("      \"identity\": ").integer(track.identity).raw(",\n");
+        w.raw("      \"frames\": [\n");
         for (size_t f = 0; f < track.frames.size(); ++f) {
-            const TrackFrame& frame = track.frames[f];
-            printf("        {\"frameIndex\": %d, \"bbox\": [%.6f, %.6f, %.6f, %.6f], \"confidence\": %.4f}%s\n",
-                   frame.frame_index,
-                   frame.bbox.x1, frame.bbox.y1, frame.bbox.x2, frame.bbox.y2,
-                   frame.confidence,
-                   f < track.frames.size() - 1 ? "," : "");
+            w.raw("        ");
+            WriteFrameJson(w, track.frames[f], false);
+            w.raw(f < track.frames.size() - 1 ? ",\n" : "\n");
         }
-        
-        printf("      ]\n");
-        printf("    }%s\n", t < result.tracks.size() - 1 ? "," : "");
+        w.raw("      ]\n");
+        w.raw(t < result.tracks.size() - 1 ? "    },\n" : "    }\n");
+    }
+    w.raw("  ],\n");
+    if (segment_links) {
+        w.raw("  \"segmentLinks\": ");
+        WriteSegmentLinksJson(w, result);
+        w.raw(",\n");
     }
+    w.raw("  \"frameCount\": ").integer(result.frame_count);
+    w.raw(result.stopped ? ",\n  \"stopped\": true\n" : "\n");
+    w.raw("}\n");
+    return w.flush();
+}
+
+// The result in the --output-format, to --output or stdout.
+bool WriteResult(const PipelineResult& result, bool segment_links, const TrackingOutput& output) {
+    std::unique_ptr<FILE, int (*)(FILE*)> file(nullptr, &std::fclose);
+    FILE* out = stdout;
+    if (!output.output_path.empty()) {
+        file.reset(std::fopen(output.output_path.c_str(), output.binary ? "wb" : "w"));
+        if (!file) {
+            fprintf(stderr, "Error: cannot create %s\n", output.output_path.c_str());
+            return false;
+        }
+        out = file.get();
+    } else if (output.binary) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    if (output.binary) {
+        std::string error;
+        if (!WriteTracksBinary(out, result, segment_links, output.zstd_level, error)) {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+            return false;
+        }
+    } else if (!PrintResultJson(out, result, segment_links, output.compact_json)) {
+        fprintf(stderr, "Error: cannot write the tracks\n");
+        return false;
+    }
+    if (file && std::fclose(file.release()) != 0) {
+        fprintf(stderr, "Error: cannot write %s\n", output.output_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The last --stream-events event: the result inline, or where --output put
+// it (whole tracks then: no segments were streamed).
+int FinishStreamEvents(const PipelineResult& result, const TrackingOutput& output) {
+    if (output.output_path.empty()) {
+        PrintTracksEvent("done", result, true);
+        return SUCCESS;
+    }
+    if (!WriteResult(result, false, output)) return ERR_INVALID_ARGS;
+    printf("{\"event\": \"done\", \"output\": \"%s\", \"frameCount\": %d%s}\n",
+           JsonEscape(output.output_path).c_str(), result.frame_count, result.stopped ? ", \"stopped\": true" : "");
+    fflush(stdout);
+    return SUCCESS;
+}
+
+// The tracking passes of a run (RunTracking)
+int TrackPasses(const std::string& model_dir,
+              FrameSource& source,
+              float conf_thresh, float iou_thresh,
+              float detection_fps, float video_fps,
+              const std::string& reid_model_dir,
+              float reid_weight,
+              float reid_cos_thresh,
+              const PipelineOptions& options,
+              const TrackingOutput& output) {
+    // With --stream-events, frame progress comes in at most every 200 ms
+    // (and once all are read); the last event is the result.
+    auto stream_progress = [](bool preview) {
+        auto last = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+        return [last, preview](const char* stage, int done, int total) mutable {
+            const auto now = std::chrono::steady_clock::now();
+            if (std::strcmp(stage, "frames") == 0 && done != total) {
+                if (now - last < std::chrono::milliseconds(200)) return;
+                last = now;
+            }
+            printf("{\"event\": \"progress\", %s\"stage\": \"%s\", \"done\": %d, \"total\": %d}\n",
+                   preview ? "\"preview\": true, " : "", stage, done, total);
+            fflush(stdout);
+        };
+    };
+    PipelineOptions run_options = options;
+    run_options.keep_appearances = !output.tracklets_path.empty() || output.priority_frame >= 0;
+    // MOGRT keyframes and the render take the whole tracks, the output
+    // tracks are reduced after them.
+    const bool whole_tracks = !output.mogrt_keyframes_path.empty() || !output.blur_render.dir.empty();
+    if (whole_tracks) run_options.keyframe_tolerance = 0.0f;
+    if (!output.blur_render.dir.empty() && !source.randomAccess()) {
+        fprintf(stderr, "Error: --render-blur needs input that can be read again in any order\n");
+        return ERR_INVALID_ARGS;
+    }
+    if (output.stream_events) {
+        run_options.progress = stream_progress(false);
+        if (!output.segments_path.empty()) fprintf(stderr, "Warning: --segments is ignored with --stream-events\n");
+    }
+
+    // With --chunk, the pipeline reads the chunk and its overlap; frame
+    // indices in the output stay the input's.
+    FrameSource* input = &source;
+    std::unique_ptr<ChunkFrameSource> chunk;
+    int frame_offset = 0;
+    if (output.chunk_start >= 0) {
+        frame_offset = std::max(0, output.chunk_start - output.chunk_overlap);
+        chunk = std::make_unique<ChunkFrameSource>(source, frame_offset, output.chunk_end + output.chunk_overlap);
+        input = chunk.get();
+        // Editor cuts are input positions too.
+        std::vector<int>& cuts = run_options.cut_frames;
+        for (int& c : cuts) c -= frame_offset;
+        cuts.erase(std::remove_if(cuts.begin(), cuts.end(), [](int c) { return c <= 0; }), cuts.end());
+    }
+    auto to_input = [frame_offset](std::vector<TrackFrame>& frames) {
+        for (TrackFrame& f : frames) f.frame_index += frame_offset;
+    };
+
+    // The preview's recording is read in any order, whatever the input.
+    if (output.priority_frame >= 0 && (input->frameCount() < 0 || (!input->randomAccess() && !output.preview))) {
+        fprintf(stderr, "Error: --priority-frame needs input of known length that can be read in any order\n");
+        return ERR_INVALID_ARGS;
+    }
+
+    // --preview: a coarse pass (small detector input, sparse detection, no
+    // ReID, translation-only camera motion) goes out as a "preview" event
+    // first. It records the decoded frames into a temporary container,
+    // which the refined pass then reads instead of decoding again.
+    std::unique_ptr<ContainerFrameSource> recorded;
+    std::string recorded_path;
+    if (output.preview) {
+        PipelineOptions coarse = run_options;
+        coarse.progress = stream_progress(true);
+        coarse.detector_input = kPreviewDetectorInput;
+        coarse.gmc.fallback = GmcConfig::Fallback::Translation;
+        coarse.lazy_reid = false;
+        coarse.keep_appearances = false;
+        coarse.detection_cache_path.clear();
+        coarse.dump_detections_path.clear();
+        coarse.checkpoint_path.clear();
+        coarse.gallery_path.clear();
+        coarse.proxy_dir.clear();
+        FacePipeline coarse_pipeline(model_dir, conf_thresh, std::min(detection_fps, kPreviewDetectionFps), iou_thresh,
+                                     std::string(), reid_weight, reid_cos_thresh, coarse);
+        if (!coarse_pipeline.isLoaded()) {
+            fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
+            return ERR_MODEL_NOT_FOUND;
+        }
+        const int frame_count = input->frameCount();
+        std::unique_ptr<FrameContainerWriter> writer;
+        std::unique_ptr<RecordingFrameSource> recording;
+        if (frame_count >= 0 && !dynamic_cast<ContainerFrameSource*>(&source)) {
+            recorded_path = TemporaryPath("preview-frames");
+            writer = std::make_unique<FrameContainerWriter>(recorded_path, frame_count, 0);
+            recording = std::make_unique<RecordingFrameSource>(*input, *writer);
+        }
+        PipelineResult preview = coarse_pipeline.process(recording ? *recording : *input, video_fps);
+        for (FaceTrack& track : preview.tracks) to_input(track.frames);
+        preview.frame_count += frame_offset;
+        PrintTracksEvent("preview", preview, false);
+        if (preview.stopped) {
+            // Out of time or told to stop: the preview is all there is.
+            return FinishStreamEvents(preview, output);
+        }
+        if (writer && writer->finish()) recorded = ContainerFrameSource::Open(recorded_path, frame_count, 0);
+        if (recorded) {
+            input = recorded.get();
+        } else if (!input->randomAccess()) {
+            fprintf(stderr, "Error: the frames of the preview pass could not be kept for refinement\n");
+            std::remove(recorded_path.c_str());
+            return ERR_IMAGE_LOAD_FAILED;
+        }
+    }
+
+    // Create pipeline
+    FacePipeline pipeline(model_dir, conf_thresh, detection_fps, iou_thresh,
+                          reid_model_dir, reid_weight, reid_cos_thresh, run_options);
     
-    printf("  ],\n");
-    printf("  \"frameCount\": %d\n", result.frame_count);
-    printf("}\n");
+    if (!pipeline.isLoaded()) {
+        // A dump that cannot be read was reported by the pipeline.
+        if (!options.replay_detections_path.empty()) return ERR_NO_INPUT;
+        fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
+        return ERR_MODEL_NOT_FOUND;
+    }
     
+    // With --priority-frame, both ways from that frame at once.
+    std::string track_error;
+    auto track = [&](const TrackSegmentSink& on_segment) {
+        PipelineResult tracked;
+        if (output.priority_frame >= 0) {
+            TrackAroundFrame(pipeline, *input, output.priority_frame, output.chunk_overlap, video_fps, conf_thresh,
+                             on_segment, tracked, track_error);
+        } else if (on_segment) {
+            tracked = pipeline.process(*input, video_fps, on_segment);
+        } else {
+            tracked = pipeline.process(*input, video_fps);
+        }
+        return tracked;
+    };
+
+    // Process frames. With --segments (or --stream-events), each tracklet
+    // is written out as one JSON line once it ends, and the output below
+    // holds the open tracks. Streamed events with --output leave the
+    // tracks whole, for the file.
+    PipelineResult result;
+    const bool segments = output.stream_events ? output.output_path.empty() : !output.segments_path.empty();
+    if (segments) {
+        std::unique_ptr<FILE, int (*)(FILE*)> segments_file(nullptr, &std::fclose);
+        if (!output.stream_events) {
+            segments_file.reset(std::fopen(output.segments_path.c_str(), "w"));
+            if (!segments_file) {
+                fprintf(stderr, "Error: cannot create %s\n", output.segments_path.c_str());
+                return ERR_INVALID_ARGS;
+            }
+        }
+        FILE* out = output.stream_events ? stdout : segments_file.get();
+        const char* prefix = output.stream_events ? "\"event\": \"segment\", " : "";
+        result = track([out, prefix, &to_input](const FaceTrack& segment) {
+            std::vector<TrackFrame> frames = segment.frames;
+            to_input(frames);
+            JsonWriter w(out);
+            w.ch('{').raw(prefix).raw("\"id\": ").integer(segment.id).raw(", \"frames\": ");
+            WriteFramesJson(w, frames);
+            w.raw("}\n");
+            w.flush();
+            std::fflush(out);
+        });
+    } else {
+        result = track(TrackSegmentSink());
+    }
+    if (!track_error.empty()) {
+        fprintf(stderr, "Error: %s\n", track_error.c_str());
+        return ERR_INVALID_ARGS;
+    }
+    if (result.stopped && g_stop_requested.load()) {
+        fprintf(stderr, "Warning: stopped after %d frames; tracks end there\n", result.frame_count);
+    }
+    if (frame_offset > 0) {
+        for (FaceTrack& track : result.tracks) to_input(track.frames);
+        result.frame_count += frame_offset;
+    }
+    if (!output.blur_render.dir.empty()) {
+        const int first = std::max(0, output.chunk_start);
+        const int end = output.chunk_start >= 0 ? std::min(output.chunk_end, result.frame_count) : result.frame_count;
+        int written = 0;
+        std::string error;
+        if (!RenderBlurredFrames(source, result, first, end, output.blur_render, written, error)) {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+            return ERR_IMAGE_LOAD_FAILED;
+        }
+    }
+    if (!output.mogrt_keyframes_path.empty()) {
+        std::string error;
+        if (!WriteMogrtKeyframes(output.mogrt_keyframes_path, result, output.ticks_per_frame,
+                                 options.keyframe_tolerance, error)) {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+            return ERR_INVALID_ARGS;
+        }
+    }
+    if (whole_tracks && options.keyframe_tolerance > 0.0f) {
+        for (FaceTrack& track : result.tracks) {
+            ReduceToKeyframes(track.frames, options.keyframe_tolerance, result.frame_width, result.frame_height);
+        }
+    }
+
+    if (!output.tracklets_path.empty()) {
+        TrackChunk tracklets;
+        tracklets.start = std::max(0, output.chunk_start);
+        tracklets.end = output.chunk_start >= 0 ? output.chunk_end : result.frame_count;
+        if (!result.stopped) tracklets.end = std::max(tracklets.start, std::min(tracklets.end, result.frame_count));
+        tracklets.read_first = frame_offset;
+        tracklets.read_end = result.frame_count;
+        tracklets.video_fps = video_fps;
+        tracklets.conf_thresh = conf_thresh;
+        tracklets.reid_cos_thresh = reid_cos_thresh;
+        tracklets.stopped = result.stopped;
+        tracklets.tracks = result.tracks;
+        tracklets.appearances = std::move(result.appearances);
+        std::string error;
+        if (!tracklets.save(output.tracklets_path, error)) {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+            return ERR_INVALID_ARGS;
+        }
+    }
+
+    if (!recorded_path.empty()) {
+        recorded.reset();
+        std::remove(recorded_path.c_str());
+    }
+    if (pipeline.memoryBudget()) PrintMemoryReport(*pipeline.memoryBudget());
+
+    if (output.stream_events) return FinishStreamEvents(result, output);
+    return WriteResult(result, segments, output) ? SUCCESS : ERR_INVALID_ARGS;
+}
+
+// --metrics: what the runs recorded, once they are done.
+void WriteMetrics(const PipelineOptions& options, const std::string& path) {
+    std::string error;
+    if (options.metrics && !path.empty() && !options.metrics->write(path, error)) {
+        fprintf(stderr, "Warning: metrics not written: %s\n", error.c_str());
+    }
+}
+
+// --live: the frames go through a LivePipeline as they arrive, each one's
+// boxes out as a JSON line. Input of known length is replayed at the video
+// frame rate, as if it were being captured.
+int RunLive(const std::string& model_dir,
+            FrameSource& source,
+            float conf_thresh, float iou_thresh,
+            float detection_fps, float video_fps,
+            const PipelineOptions& options,
+            const TrackingOutput& output) {
+    FacePipeline pipeline(model_dir, conf_thresh, detection_fps, iou_thresh, std::string(), 0.0f, 0.0f, options);
+    if (!pipeline.isLoaded()) {
+        fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
+        return ERR_MODEL_NOT_FOUND;
+    }
+    JsonWriter w(stdout);
+    LivePipeline live(pipeline, video_fps, [&w](const LiveFrame& frame) {
+        w.raw("{\"frameIndex\": ").integer(frame.frame_index);
+        w.raw(", \"latencyMs\": ").fixed(frame.latency_ms, 2);
+        if (frame.dropped) w.raw(", \"dropped\": true");
+        if (frame.detected) w.raw(", \"detectorInput\": ").integer(frame.detector_input);
+        w.raw(", \"faces\": [");
+        for (size_t t = 0; t < frame.tracks.size(); ++t) {
+            const TrackResult& track = frame.tracks[t];
+            w.raw(t > 0 ? ", {\"id\": " : "{\"id\": ").integer(track.track_id).raw(", \"bbox\": [");
+            w.fixed(track.bbox.x1, 6).raw(", ").fixed(track.bbox.y1, 6).raw(", ");
+            w.fixed(track.bbox.x2, 6).raw(", ").fixed(track.bbox.y2, 6);
+            w.raw("], \"confidence\": ").fixed(track.confidence, 4).ch('}');
+        }
+        w.raw("]}\n");
+        w.flush();
+        fflush(stdout);
+    }, output.live_config);
+
+    const bool paced = source.frameCount() >= 0;
+    const auto period = std::chrono::duration<double>(1.0 / (video_fps > 0.0f ? video_fps : 30.0f));
+    const auto start = std::chrono::steady_clock::now();
+    FrameRequest req;
+    req.rgb_min_long_side = options.decode_long_side;
+    LoadedRgbFrame frame;
+    int read = 0;
+    for (int i = 0; !(options.stop && options.stop->load()); ++i) {
+        if (paced) std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::nanoseconds>(period * i));
+        if (!source.read(i, req, frame)) break;
+        live.pushFrame(frame.rgbData(), frame.rgb_w, frame.rgb_h);
+        read++;
+    }
+    const LiveStats stats = live.finish();
+    fprintf(stderr, "Live: frames=%d detected=%d reduced=%d dropped=%d late=%d max_latency_ms=%.1f tracks=%d\n",
+            stats.frames, stats.detected, stats.reduced, stats.dropped, stats.late, stats.max_latency_ms,
+            stats.tracks);
+    if (MetricsRegistry* metrics = options.metrics.get()) {
+        metrics->add("live.frames", stats.frames);
+        metrics->add("live.detected", stats.detected);
+        metrics->add("live.reducedInput", stats.reduced);
+        metrics->add("live.dropped", stats.dropped);
+        metrics->add("live.late", stats.late);
+        metrics->set("live.maxLatencyMs", stats.max_latency_ms);
+    }
+    WriteMetrics(options, output.metrics_path);
+    if (read == 0) {
+        fprintf(stderr, "Error: No frames could be read\n");
+        return ERR_NO_INPUT;
+    }
     return SUCCESS;
 }
 
+// Run multi-frame tracking; with --profile, --trace or --metrics, its
+// timings and statistics are written out however it ends.
+int RunTracking(const std::string& model_dir,
+                FrameSource& source,
+                float conf_thresh, float iou_thresh,
+                float detection_fps, float video_fps,
+                const std::string& reid_model_dir,
+                float reid_weight,
+                float reid_cos_thresh,
+                const PipelineOptions& options,
+                const TrackingOutput& output) {
+    if (output.live) {
+        return RunLive(model_dir, source, conf_thresh, iou_thresh, detection_fps, video_fps, options, output);
+    }
+    const int rc = TrackPasses(model_dir, source, conf_thresh, iou_thresh, detection_fps, video_fps, reid_model_dir,
+                               reid_weight, reid_cos_thresh, options, output);
+    std::string error;
+    if (options.profile && !output.profile_path.empty() && !options.profile->write(output.profile_path, error)) {
+        fprintf(stderr, "Warning: profile not written: %s\n", error.c_str());
+    }
+    if (options.profile && !output.trace_path.empty() && !options.profile->writeTrace(output.trace_path, error)) {
+        fprintf(stderr, "Warning: trace not written: %s\n", error.c_str());
+    }
+    WriteMetrics(options, output.metrics_path);
+    return rc;
+}
+
+// Merge the tracks of chunks tracked apart (--stitch) and output them like one run.
+int RunStitch(const std::vector<std::string>& paths, const ReidConfig& link, const TrackingOutput& output) {
+    std::vector<TrackChunk> chunks(paths.size());
+    std::string error;
+    for (size_t k = 0; k < paths.size(); ++k) {
+        if (!chunks[k].load(paths[k], error)) {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+            return ERR_NO_INPUT;
+        }
+    }
+    PipelineResult result;
+    if (!StitchChunks(chunks, link, result, error)) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return ERR_INVALID_ARGS;
+    }
+    return WriteResult(result, false, output) ? SUCCESS : ERR_INVALID_ARGS;
+}
+
 // Minimal deterministic self-test for ORU behavior (paper parity)
 int RunOcsortSelfTest() {
     // Deterministic ORU unit-ish test on a single track (bypasses association).
@@ -267,13 +1226,232 @@ int RunOcsortSelfTest() {
     return SUCCESS;
 }
 
+// Time the pipeline on a sample of an image sequence and save the fastest thread counts
+int RunAutotuneCommand(const std::vector<std::string>& sample,
+                       const std::string& model_dir,
+                       float conf_thresh, float iou_thresh, float detection_fps, float video_fps,
+                       const std::string& reid_model_dir,
+                       float reid_weight, float reid_cos_thresh,
+                       const PipelineOptions& options,
+                       const AutotuneOptions& autotune_options,
+                       const std::string& profile_path) {
+    bool load_failed = false;
+    const AutotuneMeasure measure = [&](const PipelineOptions& run_options) {
+        FacePipeline pipeline(model_dir, conf_thresh, detection_fps, iou_thresh,
+                              reid_model_dir, reid_weight, reid_cos_thresh, run_options);
+        if (!pipeline.isLoaded()) {
+            load_failed = true;
+            return 0.0;
+        }
+        ImageListSource source(sample);
+        const auto start = std::chrono::steady_clock::now();
+        const PipelineResult result = pipeline.process(source, video_fps);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return seconds > 0.0 ? result.frame_count / seconds : 0.0;
+    };
+    AutotuneProfile profile;
+    if (!RunAutotune(options, autotune_options, measure, profile)) {
+        if (load_failed) {
+            fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
+            return ERR_MODEL_NOT_FOUND;
+        }
+        fprintf(stderr, "Error: no frames tracked\n");
+        return ERR_INFERENCE_FAILED;
+    }
+    fprintf(stderr, "Autotune (%s): decode threads %d, detect workers %d x %d threads, GMC workers %d, "
+            "prefetch depth %d: %.2f fps\n", profile.machine.c_str(), profile.decode_threads,
+            profile.detect_workers, profile.detector_threads, profile.gmc_workers, profile.prefetch_depth,
+            profile.fps);
+    std::string error;
+    if (!SaveAutotuneProfile(profile_path, profile, error)) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return ERR_INFERENCE_FAILED;
+    }
+    fprintf(stderr, "Autotune profile saved to %s\n", profile_path.c_str());
+    return SUCCESS;
+}
+
+// Export INT8 calibration samples from an image sequence
+int RunCalibrationExport(FrameSource& source,
+                         const std::string& model_dir,
+                         const std::string& reid_model_dir,
+                         const std::string& out_dir,
+                         const CalibrationOptions& options) {
+    std::string error;
+    if (!ExportCalibrationSet(source, model_dir, reid_model_dir, out_dir, options, error)) {
+        fprintf(stderr, "Error: calibration export failed: %s\n", error.c_str());
+        return ERR_INFERENCE_FAILED;
+    }
+    fprintf(stderr, "Calibration samples written to %s\n", out_dir.c_str());
+    return SUCCESS;
+}
+
+// Compare the INT8 models with fp32 on an image sequence
+int RunInt8ParityCheck(FrameSource& source,
+                       const std::string& model_dir,
+                       const std::string& reid_model_dir,
+                       const CalibrationOptions& options,
+                       float min_recall) {
+    Int8ParityReport report;
+    std::string error;
+    if (!RunInt8Parity(source, model_dir, reid_model_dir, options, report, error)) {
+        fprintf(stderr, "Error: INT8 parity check failed: %s\n", error.c_str());
+        return ERR_MODEL_NOT_FOUND;
+    }
+
+    const bool passed = report.recall() >= min_recall;
+    printf("{\n");
+    printf("  \"frames\": %d,\n", report.frames);
+    printf("  \"fp32Faces\": %d,\n", report.fp32_faces);
+    printf("  \"int8Faces\": %d,\n", report.int8_faces);
+    printf("  \"recall\": %.4f,\n", report.recall());
+    printf("  \"precision\": %.4f,\n", report.precision());
+    printf("  \"meanIou\": %.4f,\n", report.mean_iou);
+    printf("  \"meanScoreDelta\": %.4f,\n", report.mean_score_delta);
+    printf("  \"fp32Ms\": %.2f,\n", report.fp32_ms);
+    printf("  \"int8Ms\": %.2f,\n", report.int8_ms);
+    printf("  \"reidPairs\": %d,\n", report.reid_pairs);
+    printf("  \"meanReidCosine\": %.4f,\n", report.mean_reid_cosine);
+    printf("  \"minReidCosine\": %.4f,\n", report.min_reid_cosine);
+    printf("  \"passed\": %s\n", passed ? "true" : "false");
+    printf("}\n");
+
+    if (!passed) {
+        fprintf(stderr, "INT8 parity below threshold: recall %.4f < %.4f\n", report.recall(), min_recall);
+        return ERR_SELF_TEST_FAILED;
+    }
+    return SUCCESS;
+}
+
+// Track a detection dump under every sweep configuration
+int RunSweep(const std::string& dump_path,
+             const std::vector<SweepConfig>& configs,
+             float conf_thresh, float detection_fps, float video_fps,
+             const PipelineOptions& options,
+             int workers) {
+    std::vector<SweepReport> reports;
+    std::string error;
+    const auto start = std::chrono::steady_clock::now();
+    if (!RunParameterSweep(dump_path, configs, conf_thresh, detection_fps, video_fps, options, workers, reports,
+                           error)) {
+        fprintf(stderr, "Error: sweep failed: %s\n", error.c_str());
+        return ERR_NO_INPUT;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("[\n");
+    for (size_t c = 0; c < reports.size(); ++c) {
+        const SweepReport& r = reports[c];
+        printf("  {\"iou\": %.4f, \"maxAge\": %d, \"inertia\": %.4f, \"reidWeight\": %.4f, \"reidCos\": %.4f,\n",
+               r.config.iou_thresh, r.config.max_age, r.config.inertia, r.config.reid_weight,
+               r.config.reid_cos_thresh);
+        printf("   \"tracks\": %d, \"meanTrackFrames\": %.2f, \"coverage\": %.4f, \"overlaps\": %d,\n",
+               r.tracks, r.mean_track_frames, r.coverage(), r.overlaps);
+        printf("   \"observedFrames\": %d, \"outputFrames\": %d, \"ms\": %.2f, \"fps\": %.1f}%s\n",
+               r.observed_frames, r.output_frames, r.ms, r.fps(), c + 1 < reports.size() ? "," : "");
+    }
+    printf("]\n");
+    fprintf(stderr, "Sweep: %zu configurations in %.2f s (%.1f configurations/s)\n", reports.size(), seconds,
+            seconds > 0.0 ? reports.size() / seconds : 0.0);
+    return SUCCESS;
+}
+
+// Track annotated clips and report how well and how fast
+int RunEvaluation(const std::string& manifest_path,
+                  const std::string& baseline_path,
+                  const EvalTolerance& tolerance,
+                  const std::string& model_dir,
+                  float conf_thresh, float iou_thresh, float detection_fps,
+                  const std::string& reid_model_dir,
+                  float reid_weight, float reid_cos_thresh,
+                  const PipelineOptions& options) {
+    std::vector<EvalClip> clips;
+    std::string error;
+    if (!LoadEvalManifest(manifest_path, clips, error)) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return ERR_NO_INPUT;
+    }
+    std::vector<EvalClipReport> reports;
+    for (const EvalClip& clip : clips) {
+        const std::vector<std::string> paths = ReadPathsFromFile(clip.images_file);
+        if (paths.empty()) {
+            fprintf(stderr, "Error: %s: no frames in %s\n", clip.name.c_str(), clip.images_file.c_str());
+            return ERR_NO_INPUT;
+        }
+        // A pipeline per clip, so each gets a profile of its own.
+        PipelineOptions run_options = options;
+        run_options.profile = std::make_shared<StageProfile>();
+        FacePipeline pipeline(model_dir, conf_thresh, detection_fps, iou_thresh,
+                              reid_model_dir, reid_weight, reid_cos_thresh, run_options);
+        if (!pipeline.isLoaded()) {
+            fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
+            return ERR_MODEL_NOT_FOUND;
+        }
+        ImageListSource source(paths);
+        const auto start = std::chrono::steady_clock::now();
+        const PipelineResult result = pipeline.process(source, clip.video_fps);
+        EvalClipReport report;
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<std::vector<GroundTruthBox>> ground_truth;
+        if (!LoadMotGroundTruth(clip.ground_truth, result.frame_width, result.frame_height, ground_truth, error)) {
+            fprintf(stderr, "Error: %s: %s\n", clip.name.c_str(), error.c_str());
+            return ERR_NO_INPUT;
+        }
+        report.name = clip.name;
+        report.frames = result.frame_count;
+        report.tracks = static_cast<int>(result.tracks.size());
+        report.counts = EvaluateTracks(ground_truth, result.tracks, result.frame_count);
+        for (int s = 0; s < static_cast<int>(ProfileStage::Count); ++s) {
+            report.stage_ms[static_cast<size_t>(s)] = run_options.profile->totalMs(static_cast<ProfileStage>(s));
+        }
+        report.peak_rss = MemoryBudget::ProcessPeakRss();
+        fprintf(stderr, "Evaluated %s: HOTA %.4f, IDF1 %.4f, MOTA %.4f at %.1f fps\n", clip.name.c_str(),
+                report.counts.hota(), report.counts.idf1(), report.counts.mota(), report.fps());
+        reports.push_back(std::move(report));
+    }
+
+    std::vector<std::string> regressions;
+    if (!baseline_path.empty() && !CompareEvalBaseline(baseline_path, reports, tolerance, regressions, error)) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return ERR_NO_INPUT;
+    }
+    if (!WriteEvalReport(stdout, reports, regressions)) return ERR_INVALID_ARGS;
+    for (const std::string& r : regressions) fprintf(stderr, "Regression: %s\n", r.c_str());
+    return regressions.empty() ? SUCCESS : ERR_SELF_TEST_FAILED;
+}
+
 int main(int argc, char** argv) {
     std::string model_dir;
     std::string image_path;
     std::string images_file;
+    TrackingOutput tracking_output;
     std::string reid_model_dir;
+    std::string raw_input;
+    std::string frame_cache_path;
+    std::string video_path;
+    VideoHwAccel video_hwaccel = VideoHwAccel::Auto;
+    bool video_motion_vectors = false;
+    bool video_fps_set = false;
+    RawStreamFormat raw_format;
+    WatchFolderOptions watch_options;
+    std::string frames_pattern;
+    int range_first = -1;
+    int range_last = -1;
     bool track_mode = false;
+    bool detect_images = false;
+    bool stream_paths = false;
+    bool stop_on_stdin = false;
     bool test_ocsort = false;
+    bool serve = false;
+    bool describe_requirements = false;
+    std::vector<std::string> stitch_paths;  // --stitch: chunk tracklet files to merge
+    std::string batch_manifest;  // --batch: clips to track, one JSON object a line ("-" = stdin)
+    int batch_workers = 0;
+    NumaPlacement numa = NumaPlacement::Off;
+    std::string eval_manifest;  // --evaluate: annotated clips to score
+    std::string eval_baseline;  // --eval-baseline: report to compare with
+    EvalTolerance eval_tolerance;
     float conf_thresh = 0.5f;
     float nms_thresh = 0.4f;
     float iou_thresh = 0.15f;
@@ -281,6 +1459,26 @@ int main(int argc, char** argv) {
     float video_fps = 30.0f;
     float reid_weight = 0.35f;
     float reid_cos_thresh = 0.35f;
+    PipelineOptions pipeline_options;
+    CpuPowersave cpu_powersave = CpuPowersave::All;
+    EnergyProfile energy_profile = EnergyProfile::Off;
+    bool detection_fps_set = false;
+    bool cpu_powersave_set = false;
+    std::string calibration_dir;
+    bool int8_parity = false;
+    float int8_min_recall = 0.95f;
+    CalibrationOptions calibration_options;
+    DetectorSelection detector_selection;
+    bool prefetch_depth_set = false;
+    bool autotune = false;
+    int autotune_frames = 60;
+    AutotuneOptions autotune_options;
+    std::string autotune_path;  // --autotune-profile (empty = DefaultAutotunePath())
+    bool use_autotune_profile = true;
+    bool sweep = false;
+    int sweep_workers = 0;
+    std::vector<float> sweep_iou, sweep_inertia, sweep_reid_weight, sweep_reid_cos;
+    std::vector<int> sweep_max_age;
 
     // Parse arguments
     for (int i = 1; i < argc; ++i) {
@@ -290,11 +1488,95 @@ int main(int argc, char** argv) {
             image_path = argv[++i];
         } else if (strcmp(argv[i], "--track") == 0) {
             track_mode = true;
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve = true;
+        } else if (strcmp(argv[i], "--describe-requirements") == 0) {
+            describe_requirements = true;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_manifest = argv[++i];
+        } else if (strcmp(argv[i], "--evaluate") == 0 && i + 1 < argc) {
+            eval_manifest = argv[++i];
+        } else if (strcmp(argv[i], "--eval-baseline") == 0 && i + 1 < argc) {
+            eval_baseline = argv[++i];
+        } else if (strcmp(argv[i], "--eval-tolerance") == 0 && i + 1 < argc) {
+            eval_tolerance.metric = std::max(0.0, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--eval-fps-tolerance") == 0 && i + 1 < argc) {
+            eval_tolerance.fps = std::max(0.0, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--batch-workers") == 0 && i + 1 < argc) {
+            batch_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--numa") == 0 && i + 1 < argc) {
+            if (!ParseNumaPlacement(argv[++i], numa)) {
+                fprintf(stderr, "Error: --numa takes off, nodes or replicas\n");
+                return ERR_INVALID_ARGS;
+            }
         } else if (strcmp(argv[i], "--test-ocsort") == 0) {
             test_ocsort = true;
+        } else if (strcmp(argv[i], "--detect-images") == 0) {
+            detect_images = true;
         } else if (strcmp(argv[i], "--images-file") == 0 && i + 1 < argc) {
             images_file = argv[++i];
             track_mode = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames_pattern = argv[++i];
+            track_mode = true;
+        } else if (strcmp(argv[i], "--range") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d", &range_first, &range_last) != 2) {
+                fprintf(stderr, "Error: --range expects <first>:<last>\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d", &tracking_output.chunk_start, &tracking_output.chunk_end) != 2 ||
+                tracking_output.chunk_start < 0 || tracking_output.chunk_end <= tracking_output.chunk_start) {
+                fprintf(stderr, "Error: --chunk expects <start>:<end> with 0 <= start < end\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--chunk-overlap") == 0 && i + 1 < argc) {
+            tracking_output.chunk_overlap = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--emit-tracklets") == 0 && i + 1 < argc) {
+            tracking_output.tracklets_path = argv[++i];
+        } else if (strcmp(argv[i], "--stitch") == 0) {
+            while (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0) stitch_paths.push_back(argv[++i]);
+            if (stitch_paths.empty()) {
+                fprintf(stderr, "Error: --stitch expects tracklet files (--emit-tracklets)\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--stream-paths") == 0) {
+            stream_paths = true;
+            track_mode = true;
+        } else if (strcmp(argv[i], "--raw-input") == 0 && i + 1 < argc) {
+            raw_input = argv[++i];
+            track_mode = true;
+        } else if (strcmp(argv[i], "--raw-size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &raw_format.width, &raw_format.height) != 2) {
+                fprintf(stderr, "Error: --raw-size expects WxH\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--raw-format") == 0 && i + 1 < argc) {
+            if (!ParseRawPixelFormat(argv[++i], raw_format.format)) {
+                fprintf(stderr, "Error: unknown --raw-format %s\n", argv[i]);
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+            video_path = argv[++i];
+            track_mode = true;
+        } else if (strcmp(argv[i], "--video-hwaccel") == 0 && i + 1 < argc) {
+            if (!ParseVideoHwAccel(argv[++i], video_hwaccel)) {
+                fprintf(stderr, "Error: unknown --video-hwaccel %s\n", argv[i]);
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            watch_options.dir = argv[++i];
+            track_mode = true;
+        } else if (strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+            watch_options.pattern = argv[++i];
+        } else if (strcmp(argv[i], "--watch-start") == 0 && i + 1 < argc) {
+            watch_options.start_number = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--watch-frames") == 0 && i + 1 < argc) {
+            watch_options.frame_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--watch-sentinel") == 0 && i + 1 < argc) {
+            watch_options.sentinel = argv[++i];
+        } else if (strcmp(argv[i], "--frame-cache") == 0 && i + 1 < argc) {
+            frame_cache_path = argv[++i];
         } else if (strcmp(argv[i], "--conf") == 0 && i + 1 < argc) {
             conf_thresh = static_cast<float>(atof(argv[++i]));
         } else if (strcmp(argv[i], "--nms") == 0 && i + 1 < argc) {
@@ -303,14 +1585,404 @@ int main(int argc, char** argv) {
             iou_thresh = static_cast<float>(atof(argv[++i]));
         } else if (strcmp(argv[i], "--detection-fps") == 0 && i + 1 < argc) {
             detection_fps = static_cast<float>(atof(argv[++i]));
+            detection_fps_set = true;
         } else if (strcmp(argv[i], "--video-fps") == 0 && i + 1 < argc) {
             video_fps = static_cast<float>(atof(argv[++i]));
+            video_fps_set = true;
         } else if (strcmp(argv[i], "--reid-model") == 0 && i + 1 < argc) {
             reid_model_dir = argv[++i];
         } else if (strcmp(argv[i], "--reid-weight") == 0 && i + 1 < argc) {
             reid_weight = static_cast<float>(atof(argv[++i]));
         } else if (strcmp(argv[i], "--reid-cos") == 0 && i + 1 < argc) {
             reid_cos_thresh = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--max-age") == 0 && i + 1 < argc) {
+            pipeline_options.track_max_age = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--dormant-after") == 0 && i + 1 < argc) {
+            pipeline_options.track_dormant_age = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tentative-max-age") == 0 && i + 1 < argc) {
+            pipeline_options.track_tentative_age = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--inertia") == 0 && i + 1 < argc) {
+            pipeline_options.track_inertia = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--motion-gate") == 0 && i + 1 < argc) {
+            pipeline_options.track_motion_gate = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--kf-joseph") == 0) {
+            pipeline_options.kalman_joseph = true;
+        } else if (strcmp(argv[i], "--lazy-reid") == 0) {
+            pipeline_options.lazy_reid = true;
+        } else if (strcmp(argv[i], "--reid-refresh") == 0 && i + 1 < argc) {
+            pipeline_options.lazy_reid = true;
+            pipeline_options.reid_refresh = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reid-min-face") == 0 && i + 1 < argc) {
+            pipeline_options.reid_gate.min_face_px = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-min-score") == 0 && i + 1 < argc) {
+            pipeline_options.reid_gate.min_score = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-min-eye") == 0 && i + 1 < argc) {
+            pipeline_options.reid_gate.min_eye_px = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-blur-precheck") == 0) {
+            pipeline_options.reid_gate.blur_precheck = true;
+        } else if (strcmp(argv[i], "--reid-budget") == 0 && i + 1 < argc) {
+            pipeline_options.reid_gate.max_per_frame = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reid-sharpen-var") == 0 && i + 1 < argc) {
+            pipeline_options.reid.blur_sharpen_var = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-skip-var") == 0 && i + 1 < argc) {
+            pipeline_options.reid.blur_skip_var = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-sharpen-alpha") == 0 && i + 1 < argc) {
+            pipeline_options.reid.sharpen_alpha = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-min-quality") == 0 && i + 1 < argc) {
+            pipeline_options.reid.min_update_quality = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-link-gap") == 0 && i + 1 < argc) {
+            pipeline_options.reid.link_short_gap_s = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-link-max-gap") == 0 && i + 1 < argc) {
+            pipeline_options.reid.link_long_gap_s = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-link-long-sim") == 0 && i + 1 < argc) {
+            pipeline_options.reid.link_long_min_sim = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--gallery") == 0 && i + 1 < argc) {
+            pipeline_options.gallery_path = argv[++i];
+        } else if (strcmp(argv[i], "--gallery-min-sim") == 0 && i + 1 < argc) {
+            pipeline_options.gallery_min_sim = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-storage") == 0 && i + 1 < argc) {
+            if (!ParseEmbeddingStorage(argv[++i], pipeline_options.reid.appearance_storage)) {
+                fprintf(stderr, "Error: unknown --reid-storage %s\n", argv[i]);
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--decode-threads") == 0 && i + 1 < argc) {
+            pipeline_options.decode_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--prefetch-depth") == 0 && i + 1 < argc) {
+            pipeline_options.prefetch_depth = atoi(argv[++i]);
+            prefetch_depth_set = true;
+        } else if (strcmp(argv[i], "--autotune") == 0) {
+            autotune = true;
+        } else if (strcmp(argv[i], "--autotune-frames") == 0 && i + 1 < argc) {
+            autotune_frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--autotune-cores") == 0 && i + 1 < argc) {
+            autotune_options.cores = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--autotune-profile") == 0 && i + 1 < argc) {
+            autotune_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-autotune-profile") == 0) {
+            use_autotune_profile = false;
+        } else if (strcmp(argv[i], "--read-ahead") == 0 && i + 1 < argc) {
+            pipeline_options.read_ahead = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--read-ahead-threads") == 0 && i + 1 < argc) {
+            pipeline_options.read_ahead_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--advise-ahead") == 0 && i + 1 < argc) {
+            pipeline_options.advise_ahead = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--drop-file-cache") == 0) {
+            pipeline_options.drop_file_cache = true;
+        } else if (strcmp(argv[i], "--delete-consumed") == 0) {
+            pipeline_options.delete_consumed = true;
+        } else if (strcmp(argv[i], "--decode-long-side") == 0 && i + 1 < argc) {
+            pipeline_options.decode_long_side = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--input-scale") == 0 && i + 1 < argc) {
+            pipeline_options.input_scale = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--detect-workers") == 0 && i + 1 < argc) {
+            pipeline_options.detect_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gmc-workers") == 0 && i + 1 < argc) {
+            pipeline_options.gmc_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--balance-stages") == 0) {
+            pipeline_options.balance_stages = true;
+        } else if (strcmp(argv[i], "--balance-period") == 0 && i + 1 < argc) {
+            pipeline_options.balance_period_ms = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--smooth-lag") == 0 && i + 1 < argc) {
+            pipeline_options.smooth_lag = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--proxy-dir") == 0 && i + 1 < argc) {
+            pipeline_options.proxy_dir = argv[++i];
+        } else if (strcmp(argv[i], "--proxy-height") == 0 && i + 1 < argc) {
+            pipeline_options.proxy_height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--refine-boundaries") == 0) {
+            pipeline_options.refine_boundaries = true;
+        } else if (strcmp(argv[i], "--keyframe-tolerance") == 0 && i + 1 < argc) {
+            pipeline_options.keyframe_tolerance = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--compact-tracks") == 0) {
+            pipeline_options.compact_tracks = true;
+        } else if (strcmp(argv[i], "--track-spill-mb") == 0 && i + 1 < argc) {
+            pipeline_options.track_spill_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc) {
+            pipeline_options.memory_budget_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--memory-report") == 0) {
+            pipeline_options.memory_report = true;
+        } else if (strcmp(argv[i], "--bidirectional-tracking") == 0) {
+            pipeline_options.bidirectional_tracking = true;
+        } else if (strcmp(argv[i], "--track-workers") == 0 && i + 1 < argc) {
+            pipeline_options.track_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--detection-cache") == 0 && i + 1 < argc) {
+            pipeline_options.detection_cache_path = argv[++i];
+        } else if (strcmp(argv[i], "--dump-detections") == 0 && i + 1 < argc) {
+            pipeline_options.dump_detections_path = argv[++i];
+        } else if (strcmp(argv[i], "--dump-warps") == 0) {
+            pipeline_options.dump_warps = true;
+        } else if (strcmp(argv[i], "--replay-detections") == 0 && i + 1 < argc) {
+            pipeline_options.replay_detections_path = argv[++i];
+        } else if (strcmp(argv[i], "--sweep") == 0) {
+            sweep = true;
+        } else if (strcmp(argv[i], "--sweep-workers") == 0 && i + 1 < argc) {
+            sweep_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep-iou") == 0 && i + 1 < argc) {
+            if (!ParseNumberList(argv[++i], sweep_iou)) {
+                fprintf(stderr, "Error: --sweep-iou expects comma-separated numbers\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--sweep-max-age") == 0 && i + 1 < argc) {
+            if (!ParseNumberList(argv[++i], sweep_max_age)) {
+                fprintf(stderr, "Error: --sweep-max-age expects comma-separated numbers\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--sweep-inertia") == 0 && i + 1 < argc) {
+            if (!ParseNumberList(argv[++i], sweep_inertia)) {
+                fprintf(stderr, "Error: --sweep-inertia expects comma-separated numbers\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--sweep-reid-weight") == 0 && i + 1 < argc) {
+            if (!ParseNumberList(argv[++i], sweep_reid_weight)) {
+                fprintf(stderr, "Error: --sweep-reid-weight expects comma-separated numbers\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--sweep-reid-cos") == 0 && i + 1 < argc) {
+            if (!ParseNumberList(argv[++i], sweep_reid_cos)) {
+                fprintf(stderr, "Error: --sweep-reid-cos expects comma-separated numbers\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--segments") == 0 && i + 1 < argc) {
+            tracking_output.segments_path = argv[++i];
+        } else if (strcmp(argv[i], "--stream-events") == 0) {
+            tracking_output.stream_events = true;
+        } else if (strcmp(argv[i], "--live") == 0) {
+            tracking_output.live = true;
+        } else if (strcmp(argv[i], "--live-latency") == 0 && i + 1 < argc) {
+            tracking_output.live_config.latency_frames = std::max(0.1f, static_cast<float>(atof(argv[++i])));
+        } else if (strcmp(argv[i], "--live-min-input") == 0 && i + 1 < argc) {
+            tracking_output.live_config.min_detector_input = std::max(32, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--output-format") == 0 && i + 1 < argc) {
+            const char* format = argv[++i];
+            tracking_output.compact_json = strcmp(format, "json-compact") == 0;
+            tracking_output.binary = strcmp(format, "binary") == 0 || strcmp(format, "binary-zstd") == 0;
+            tracking_output.zstd_level = strcmp(format, "binary-zstd") == 0 ? 3 : 0;
+            if (strcmp(format, "json") != 0 && !tracking_output.compact_json && !tracking_output.binary) {
+                fprintf(stderr, "Error: unknown --output-format %s (json, json-compact, binary, binary-zstd)\n",
+                        format);
+                return ERR_INVALID_ARGS;
+            }
+            if (tracking_output.zstd_level > 0 && !TrackBinaryZstdAvailable()) {
+                fprintf(stderr, "Error: --output-format binary-zstd: this build has no zstd\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            tracking_output.output_path = argv[++i];
+        } else if (strcmp(argv[i], "--emit-mogrt-keyframes") == 0 && i + 1 < argc) {
+            tracking_output.mogrt_keyframes_path = argv[++i];
+        } else if (strcmp(argv[i], "--ticks-per-frame") == 0 && i + 1 < argc) {
+            tracking_output.ticks_per_frame = std::strtoll(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--render-blur") == 0 && i + 1 < argc) {
+            tracking_output.blur_render.dir = argv[++i];
+        } else if (strcmp(argv[i], "--blur-amount") == 0 && i + 1 < argc) {
+            tracking_output.blur_render.blurriness = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--blur-feather") == 0 && i + 1 < argc) {
+            tracking_output.blur_render.feather = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--blur-expansion") == 0 && i + 1 < argc) {
+            tracking_output.blur_render.expansion = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--render-format") == 0 && i + 1 < argc) {
+            const char* format = argv[++i];
+            if (strcmp(format, "png") == 0) {
+                tracking_output.blur_render.png = true;
+            } else if (strcmp(format, "jpg") != 0) {
+                fprintf(stderr, "Error: unknown --render-format %s\n", format);
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            tracking_output.profile_path = argv[++i];
+            if (!pipeline_options.profile) pipeline_options.profile = std::make_shared<StageProfile>();
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracking_output.trace_path = argv[++i];
+            if (!pipeline_options.profile) pipeline_options.profile = std::make_shared<StageProfile>();
+            pipeline_options.profile->setTrace(true);
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            tracking_output.metrics_path = argv[++i];
+            pipeline_options.metrics = std::make_shared<MetricsRegistry>();
+        } else if (strcmp(argv[i], "--preview") == 0) {
+            tracking_output.preview = true;
+            tracking_output.stream_events = true;
+        } else if (strcmp(argv[i], "--priority-frame") == 0 && i + 1 < argc) {
+            tracking_output.priority_frame = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--time-budget") == 0 && i + 1 < argc) {
+            pipeline_options.time_budget_s = atof(argv[++i]);
+            pipeline_options.budget_degrade = true;
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            pipeline_options.time_budget_s = atof(argv[++i]);
+            pipeline_options.budget_degrade = false;
+        } else if (strcmp(argv[i], "--stop-on-stdin") == 0) {
+            stop_on_stdin = true;
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            pipeline_options.checkpoint_path = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            pipeline_options.checkpoint_every = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            pipeline_options.resume = true;
+        } else if (strcmp(argv[i], "--no-reid-stage") == 0) {
+            pipeline_options.reid_stage = false;
+        } else if (strcmp(argv[i], "--gpu") == 0) {
+            pipeline_options.detector.gpu.enabled = true;
+            pipeline_options.reid_gpu.enabled = true;
+        } else if (strcmp(argv[i], "--gpu-cpu-preprocess") == 0) {
+            pipeline_options.detector.gpu.preprocess = false;
+        } else if (strcmp(argv[i], "--gpu-device") == 0 && i + 1 < argc) {
+            pipeline_options.detector.gpu.device = atoi(argv[++i]);
+            pipeline_options.reid_gpu.device = pipeline_options.detector.gpu.device;
+        } else if (strcmp(argv[i], "--coreml") == 0) {
+            pipeline_options.detector.coreml.enabled = true;
+        } else if (strcmp(argv[i], "--coreml-units") == 0 && i + 1 < argc) {
+            if (!ParseCoreMlUnits(argv[++i], pipeline_options.detector.coreml.units)) {
+                fprintf(stderr, "Error: unknown --coreml-units %s\n", argv[i]);
+                return ERR_INVALID_ARGS;
+            }
+            pipeline_options.detector.coreml.enabled = true;
+        } else if (strcmp(argv[i], "--onnx") == 0) {
+            pipeline_options.detector.onnx.enabled = true;
+            pipeline_options.reid_onnx.enabled = true;
+        } else if (strcmp(argv[i], "--onnx-device") == 0 && i + 1 < argc) {
+            pipeline_options.detector.onnx.device = atoi(argv[++i]);
+            pipeline_options.detector.onnx.enabled = true;
+            pipeline_options.reid_onnx = pipeline_options.detector.onnx;
+        } else if (strcmp(argv[i], "--cpu-powersave") == 0 && i + 1 < argc) {
+            const int mode = atoi(argv[++i]);
+            if (mode < 0 || mode > 2) {
+                fprintf(stderr, "Error: --cpu-powersave takes 0, 1 or 2\n");
+                return ERR_INVALID_ARGS;
+            }
+            cpu_powersave = static_cast<CpuPowersave>(mode);
+            cpu_powersave_set = true;
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            EnableHugePages(true);
+        } else if (strcmp(argv[i], "--mmap-models") == 0) {
+            EnableMappedModels(true);
+        } else if (strcmp(argv[i], "--energy-profile") == 0 && i + 1 < argc) {
+            if (!ParseEnergyProfile(argv[++i], energy_profile)) {
+                fprintf(stderr, "Error: --energy-profile takes off, auto or on\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--det-threads") == 0 && i + 1 < argc) {
+            pipeline_options.detector.num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--det-no-fp16") == 0) {
+            pipeline_options.detector.use_fp16_packed = false;
+            pipeline_options.detector.use_fp16_storage = false;
+            pipeline_options.detector.use_fp16_arithmetic = false;
+        } else if (strcmp(argv[i], "--det-no-fp16-arith") == 0) {
+            pipeline_options.detector.use_fp16_arithmetic = false;
+        } else if (strcmp(argv[i], "--det-no-winograd") == 0) {
+            pipeline_options.detector.use_winograd_convolution = false;
+        } else if (strcmp(argv[i], "--det-no-sgemm") == 0) {
+            pipeline_options.detector.use_sgemm_convolution = false;
+        } else if (strcmp(argv[i], "--det-no-packing") == 0) {
+            pipeline_options.detector.use_packing_layout = false;
+        } else if (strcmp(argv[i], "--det-no-lightmode") == 0) {
+            pipeline_options.detector.lightmode = false;
+        } else if (strcmp(argv[i], "--det-square-input") == 0) {
+            pipeline_options.detector.dynamic_input = false;
+        } else if (strcmp(argv[i], "--det-tile") == 0 && i + 1 < argc) {
+            pipeline_options.detector.tiles.tile_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--det-tile-overlap") == 0 && i + 1 < argc) {
+            pipeline_options.detector.tiles.overlap = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--det-tile-workers") == 0 && i + 1 < argc) {
+            pipeline_options.detector.tiles.workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--det-tile-no-full") == 0) {
+            pipeline_options.detector.tiles.full_frame = false;
+        } else if (strcmp(argv[i], "--det-tile-refresh") == 0 && i + 1 < argc) {
+            pipeline_options.tile_refresh = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--speculative-detect") == 0 && i + 1 < argc) {
+            pipeline_options.speculative_ahead = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scan-fps") == 0 && i + 1 < argc) {
+            pipeline_options.scan_fps = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--adaptive-input") == 0 && i + 1 < argc) {
+            pipeline_options.adaptive_input_face = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--adaptive-input-refresh") == 0 && i + 1 < argc) {
+            pipeline_options.adaptive_input_refresh = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cascade-input") == 0 && i + 1 < argc) {
+            pipeline_options.cascade_input = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cascade-min-score") == 0 && i + 1 < argc) {
+            pipeline_options.cascade_min_score = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--cascade-refresh") == 0 && i + 1 < argc) {
+            pipeline_options.cascade_refresh = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-face") == 0 && i + 1 < argc) {
+            pipeline_options.detector.min_face = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--prune-strides") == 0) {
+            pipeline_options.prune_strides = true;
+        } else if (strcmp(argv[i], "--prune-refresh") == 0 && i + 1 < argc) {
+            pipeline_options.prune_refresh = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--roi-side") == 0 && i + 1 < argc) {
+            pipeline_options.roi_side = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--roi-margin") == 0 && i + 1 < argc) {
+            pipeline_options.roi_margin = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--roi-mosaic") == 0) {
+            pipeline_options.roi_mosaic = true;
+        } else if (strcmp(argv[i], "--landmark-flow") == 0) {
+            pipeline_options.landmark_flow = true;
+        } else if (strcmp(argv[i], "--duplicate-diff") == 0 && i + 1 < argc) {
+            pipeline_options.duplicate_block_diff = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--light-detector") == 0 && i + 1 < argc) {
+            pipeline_options.light_detector_stem = argv[++i];
+        } else if (strcmp(argv[i], "--light-input") == 0 && i + 1 < argc) {
+            pipeline_options.light_detector_input = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--light-conf") == 0 && i + 1 < argc) {
+            pipeline_options.light_detector_conf = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--idle-fast-forward") == 0) {
+            pipeline_options.idle_fast_forward = true;
+        } else if (strcmp(argv[i], "--keyframe-snap") == 0 && i + 1 < argc) {
+            pipeline_options.keyframe_snap = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gmc-features") == 0) {
+            pipeline_options.gmc.fallback = GmcConfig::Fallback::Features;
+        } else if (strcmp(argv[i], "--gmc-phase") == 0) {
+            pipeline_options.gmc.fallback = GmcConfig::Fallback::PhaseCorrelation;
+        } else if (strcmp(argv[i], "--gmc-adaptive") == 0) {
+            pipeline_options.gmc.fallback = GmcConfig::Fallback::Adaptive;
+        } else if (strcmp(argv[i], "--gmc-motion-vectors") == 0) {
+            video_motion_vectors = true;
+        } else if (strcmp(argv[i], "--gmc-homography") == 0) {
+            pipeline_options.gmc.model = GmcConfig::Model::Homography;
+        } else if (strcmp(argv[i], "--no-static-camera") == 0) {
+            pipeline_options.static_camera.enabled = false;
+        } else if (strcmp(argv[i], "--gmc-interval") == 0 && i + 1 < argc) {
+            pipeline_options.sparse_gmc.interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gmc-interval-residual") == 0 && i + 1 < argc) {
+            pipeline_options.sparse_gmc.max_residual = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--gmc-mask-faces") == 0) {
+            pipeline_options.gmc_mask_faces = true;
+        } else if (strcmp(argv[i], "--no-scene-cuts") == 0) {
+            pipeline_options.scene_cuts.enabled = false;
+        } else if (strcmp(argv[i], "--cuts") == 0 && i + 1 < argc) {
+            if (!ParseNumberList(argv[++i], pipeline_options.cut_frames)) {
+                fprintf(stderr, "Error: --cuts expects comma-separated frame indices\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--cuts-file") == 0 && i + 1 < argc) {
+            if (!ReadFrameList(argv[++i], pipeline_options.cut_frames)) {
+                fprintf(stderr, "Error: --cuts-file expects a readable list of frame indices\n");
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--adaptive-detect") == 0) {
+            pipeline_options.adaptive.enabled = true;
+        } else if (strcmp(argv[i], "--detect-budget-fps") == 0 && i + 1 < argc) {
+            pipeline_options.adaptive.budget_fps = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--max-detect-interval") == 0 && i + 1 < argc) {
+            pipeline_options.adaptive.max_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--speed-profile") == 0 && i + 1 < argc) {
+            if (!ParseSpeedProfile(argv[++i], detector_selection.profile)) {
+                fprintf(stderr, "Error: unknown --speed-profile %s\n", argv[i]);
+                return ERR_INVALID_ARGS;
+            }
+        } else if (strcmp(argv[i], "--ms-per-frame") == 0 && i + 1 < argc) {
+            detector_selection.ms_per_frame = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--bench-cache") == 0 && i + 1 < argc) {
+            detector_selection.bench_cache = argv[++i];
+        } else if (strcmp(argv[i], "--int8") == 0) {
+            pipeline_options.int8 = true;
+        } else if (strcmp(argv[i], "--export-calibration") == 0 && i + 1 < argc) {
+            calibration_dir = argv[++i];
+            track_mode = true;
+        } else if (strcmp(argv[i], "--int8-parity") == 0) {
+            int8_parity = true;
+            track_mode = true;
+        } else if (strcmp(argv[i], "--int8-min-recall") == 0 && i + 1 < argc) {
+            int8_min_recall = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--calib-frames") == 0 && i + 1 < argc) {
+            calibration_options.max_frames = atoi(argv[++i]);
         } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             PrintUsage(argv[0]);
             return SUCCESS;
@@ -321,30 +1993,400 @@ int main(int argc, char** argv) {
         return RunOcsortSelfTest();
     }
 
+    // Energy profile: on battery, all-core inference drains it and ends up
+    // throttled, so the run trades speed for energy where no flag chose.
+    PowerState power;
+    bool energy_saving = false;
+    if (energy_profile != EnergyProfile::Off) {
+        power = QueryPowerState();
+        energy_saving = energy_profile == EnergyProfile::On || power.saving();
+    }
+    if (energy_saving) {
+        if (!cpu_powersave_set) cpu_powersave = CpuPowersave::Efficiency;
+        if (!detection_fps_set) detection_fps *= 0.5f;
+        if (detector_selection.profile == SpeedProfile::Default && detector_selection.ms_per_frame <= 0.0f) {
+            detector_selection.profile = SpeedProfile::Fast;
+        }
+        fprintf(stderr, "Energy profile: %s; %.1f detections/s\n",
+                power.on_battery ? "on battery" : power.low_power ? "low-power mode" : "requested", detection_fps);
+    }
+
+    // Before any model loads or thread starts: quotas derive from these cores.
+    if (cpu_powersave != CpuPowersave::All) SetCpuPowersave(cpu_powersave);
+    // Under thermal pressure, fewer busy cores keep the clock, and with it
+    // the throughput, steadier than all of them throttled.
+    if (energy_profile != EnergyProfile::Off && power.thermal_pressure && pipeline_options.detector.num_threads <= 0) {
+        pipeline_options.detector.num_threads = std::max(1, PipelineCoreCount() / 2);
+        fprintf(stderr, "Energy profile: thermal pressure; detecting on %d threads\n",
+                pipeline_options.detector.num_threads);
+    }
+
+    if (!stitch_paths.empty()) {
+        return RunStitch(stitch_paths, pipeline_options.reid, tracking_output);
+    }
+
+    if (sweep) {
+        if (pipeline_options.replay_detections_path.empty()) {
+            fprintf(stderr, "Error: --sweep needs --replay-detections <file>\n");
+            return ERR_INVALID_ARGS;
+        }
+        SweepConfig base{iou_thresh, pipeline_options.track_max_age, pipeline_options.track_inertia, reid_weight,
+                         reid_cos_thresh};
+        const std::vector<SweepConfig> configs =
+            ExpandSweep(base, sweep_iou, sweep_max_age, sweep_inertia, sweep_reid_weight, sweep_reid_cos);
+        return RunSweep(pipeline_options.replay_detections_path, configs, conf_thresh, detection_fps, video_fps,
+                        pipeline_options, sweep_workers);
+    }
+
     // Validate required arguments
+    if (model_dir.empty() && FindEmbeddedModel("scrfd")) {
+        model_dir = kBuiltinModelDir;
+    }
     if (model_dir.empty()) {
         fprintf(stderr, "Error: --model is required\n\n");
         PrintUsage(argv[0]);
         return ERR_INVALID_ARGS;
     }
 
+    if (pipeline_options.detector.coreml.enabled && !CoreMlAvailable()) {
+        fprintf(stderr, "Warning: this build has no Core ML support; detecting with ncnn\n");
+        pipeline_options.detector.coreml.enabled = false;
+    }
+    if (pipeline_options.detector.onnx.enabled && !OnnxRuntimeAvailable()) {
+        fprintf(stderr, "Warning: this build has no ONNX Runtime support; running inference with ncnn\n");
+        pipeline_options.detector.onnx.enabled = false;
+        pipeline_options.reid_onnx.enabled = false;
+    }
+
+    // Speed target: pick the SCRFD variant and input size once, up front.
+    if (detector_selection.profile != SpeedProfile::Default || detector_selection.ms_per_frame > 0.0f) {
+        detector_selection.landmarks = !reid_model_dir.empty();
+        DetectorChoice choice;
+        std::string error;
+        if (!SelectScrfdVariant(model_dir, detector_selection, pipeline_options.detector, choice, error)) {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+            return ERR_MODEL_NOT_FOUND;
+        }
+        pipeline_options.detector_stem = choice.stem;
+        pipeline_options.detector_input = choice.input_side;
+        if (choice.ms > 0.0) {
+            fprintf(stderr, "Detector: %s (SCRFD %s) at %d px, %.1f ms/frame\n",
+                    choice.stem.c_str(), choice.name.c_str(), choice.input_side, choice.ms);
+        } else {
+            fprintf(stderr, "Detector: %s (SCRFD %s) at %d px\n",
+                    choice.stem.c_str(), choice.name.c_str(), choice.input_side);
+        }
+    }
+
+    if (autotune_path.empty()) autotune_path = DefaultAutotunePath();
+    if (autotune) {
+        if (images_file.empty()) {
+            fprintf(stderr, "Error: --autotune needs --images-file <path>\n");
+            return ERR_INVALID_ARGS;
+        }
+        std::vector<std::string> sample = ReadPathsFromFile(images_file);
+        if (sample.empty()) {
+            fprintf(stderr, "Error: No image paths provided\n");
+            return ERR_NO_INPUT;
+        }
+        if (autotune_frames > 0 && sample.size() > static_cast<size_t>(autotune_frames)) {
+            sample.resize(static_cast<size_t>(autotune_frames));
+        }
+        autotune_options.prefetch_fixed = prefetch_depth_set;
+        return RunAutotuneCommand(sample, model_dir, conf_thresh, iou_thresh, detection_fps, video_fps,
+                                  reid_model_dir, reid_weight, reid_cos_thresh, pipeline_options, autotune_options,
+                                  autotune_path);
+    }
+    // A saved profile fills in the thread counts no flag set.
+    AutotuneProfile autotune_profile;
+    if (use_autotune_profile && LoadAutotuneProfile(autotune_path, MachineKey(), autotune_profile)) {
+        ApplyAutotuneProfile(autotune_profile, prefetch_depth_set, pipeline_options);
+    }
+
     // Determine mode and run
+    if (describe_requirements) {
+        const FrameRequirements req = DescribeFrameRequirements(pipeline_options, !reid_model_dir.empty());
+        printf("%s\n", FrameRequirementsJson(req).c_str());
+        return SUCCESS;
+    }
+    if (!eval_manifest.empty()) {
+        return RunEvaluation(eval_manifest, eval_baseline, eval_tolerance, model_dir, conf_thresh, iou_thresh,
+                             detection_fps, reid_model_dir, reid_weight, reid_cos_thresh, pipeline_options);
+    }
+    if (serve || !batch_manifest.empty()) {
+        ServerConfig config;
+        config.model_dir = model_dir;
+        config.conf_thresh = conf_thresh;
+        config.detection_fps = detection_fps;
+        config.iou_thresh = iou_thresh;
+        config.reid_model_dir = reid_model_dir;
+        config.reid_weight = reid_weight;
+        config.reid_cos_thresh = reid_cos_thresh;
+        config.video_fps = video_fps;
+        config.options = pipeline_options;
+        // The server answers "metrics" requests whether or not --metrics saves them.
+        if (!config.options.metrics) config.options.metrics = std::make_shared<MetricsRegistry>();
+        config.video_hwaccel = video_hwaccel;
+        config.video_motion_vectors = video_motion_vectors;
+        if (!batch_manifest.empty()) {
+            std::signal(SIGINT, RequestStop);
+            std::signal(SIGTERM, RequestStop);
+            config.options.stop = std::shared_ptr<const std::atomic<bool>>(std::shared_ptr<void>(), &g_stop_requested);
+            std::ifstream file;
+            if (batch_manifest != "-") {
+                file.open(batch_manifest);
+                if (!file.is_open()) {
+                    fprintf(stderr, "Error: cannot open %s\n", batch_manifest.c_str());
+                    return ERR_NO_INPUT;
+                }
+            }
+            const int failed = RunBatch(config, batch_manifest == "-" ? std::cin : file, batch_workers, stdout, numa);
+            WriteMetrics(config.options, tracking_output.metrics_path);
+            if (failed < 0) {
+                fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
+                return ERR_MODEL_NOT_FOUND;
+            }
+            if (failed > 0) fprintf(stderr, "Error: %d clips failed\n", failed);
+            return failed > 0 ? ERR_INFERENCE_FAILED : SUCCESS;
+        }
+        if (!RunServer(config, std::cin, stdout)) {
+            fprintf(stderr, "Error: Failed to load model from %s\n", model_dir.c_str());
+            return ERR_MODEL_NOT_FOUND;
+        }
+        WriteMetrics(config.options, tracking_output.metrics_path);
+        return SUCCESS;
+    }
+    if (detect_images) {
+        const std::vector<std::string> image_paths =
+            images_file.empty() ? ReadPathsFromStdin() : ReadPathsFromFile(images_file);
+        if (image_paths.empty()) {
+            fprintf(stderr, "Error: No image paths provided\n");
+            return ERR_NO_INPUT;
+        }
+        return RunDetectionList(model_dir, image_paths, conf_thresh, nms_thresh, pipeline_options);
+    }
     if (track_mode) {
         // Tracking mode
+        if (tracking_output.binary && tracking_output.stream_events && tracking_output.output_path.empty()) {
+            fprintf(stderr, "Error: --output-format binary with --stream-events needs --output <file>\n");
+            return ERR_INVALID_ARGS;
+        }
+        if (!tracking_output.tracklets_path.empty() &&
+            (tracking_output.stream_events || !tracking_output.segments_path.empty())) {
+            fprintf(stderr, "Error: --emit-tracklets needs whole tracks (not --segments or --stream-events)\n");
+            return ERR_INVALID_ARGS;
+        }
+        if (!pipeline_options.proxy_dir.empty() &&
+            (tracking_output.chunk_start >= 0 || tracking_output.priority_frame >= 0)) {
+            fprintf(stderr, "Error: --proxy-dir needs the whole input read forwards (not --chunk or "
+                            "--priority-frame)\n");
+            return ERR_INVALID_ARGS;
+        }
+        if (!tracking_output.mogrt_keyframes_path.empty()) {
+            if (tracking_output.ticks_per_frame <= 0) {
+                fprintf(stderr, "Error: --emit-mogrt-keyframes needs --ticks-per-frame <n>\n");
+                return ERR_INVALID_ARGS;
+            }
+            if (!tracking_output.segments_path.empty() ||
+                (tracking_output.stream_events && tracking_output.output_path.empty())) {
+                fprintf(stderr, "Error: --emit-mogrt-keyframes needs whole tracks (not --segments, nor "
+                                "--stream-events without --output)\n");
+                return ERR_INVALID_ARGS;
+            }
+        }
+        if (tracking_output.preview &&
+            (!pipeline_options.replay_detections_path.empty() || !video_path.empty() || !raw_input.empty())) {
+            fprintf(stderr, "Error: --preview reads the frames twice: not with --replay-detections, --video or "
+                            "--raw-input\n");
+            return ERR_INVALID_ARGS;
+        }
+        if (tracking_output.priority_frame >= 0 &&
+            (tracking_output.chunk_start >= 0 || !tracking_output.tracklets_path.empty() ||
+             !pipeline_options.checkpoint_path.empty() || !pipeline_options.dump_detections_path.empty() ||
+             !pipeline_options.replay_detections_path.empty())) {
+            fprintf(stderr, "Error: --priority-frame tracks two runs at once: not with --chunk, --emit-tracklets, "
+                            "--checkpoint, --dump-detections or --replay-detections\n");
+            return ERR_INVALID_ARGS;
+        }
+        if (tracking_output.chunk_start >= 0 && !frame_cache_path.empty()) {
+            // The cache records a whole sequence.
+            fprintf(stderr, "Warning: --frame-cache is ignored with --chunk\n");
+            frame_cache_path.clear();
+        }
+        std::signal(SIGINT, RequestStop);
+        std::signal(SIGTERM, RequestStop);
+        // The flag lives as long as the process (not owned).
+        pipeline_options.stop = std::shared_ptr<const std::atomic<bool>>(std::shared_ptr<void>(), &g_stop_requested);
+        if (stop_on_stdin) {
+            const bool reads_stdin = raw_input == "-" ||
+                                     (video_path.empty() && watch_options.dir.empty() && raw_input.empty() &&
+                                      frames_pattern.empty() && images_file.empty() &&
+                                      pipeline_options.replay_detections_path.empty());
+            if (reads_stdin) {
+                fprintf(stderr, "Error: --stop-on-stdin needs input that is not read from stdin\n");
+                return ERR_INVALID_ARGS;
+            }
+            // Detached: it may block in getline until the process exits.
+            std::thread([]() {
+                std::string line;
+                while (std::getline(std::cin, line)) {
+                    if (line == "stop" || line == "stop\r") {
+                        g_stop_requested.store(true);
+                        return;
+                    }
+                }
+            }).detach();
+        }
+        if ((!calibration_dir.empty() || int8_parity) &&
+            (!video_path.empty() || !watch_options.dir.empty() || !raw_input.empty() || stream_paths)) {
+            fprintf(stderr, "Error: --export-calibration and --int8-parity need --images-file, stdin paths or --frames\n");
+            return ERR_INVALID_ARGS;
+        }
+        if (!video_path.empty()) {
+            VideoFrameSource source(video_path, video_hwaccel, video_motion_vectors);
+            if (!source.isOpen()) {
+                fprintf(stderr, "Error: %s\n", source.error().c_str());
+                return ERR_IMAGE_LOAD_FAILED;
+            }
+            if (!video_fps_set && source.frameRate() > 0.0) {
+                video_fps = static_cast<float>(source.frameRate());
+            }
+            return RunTracking(model_dir, source, conf_thresh, iou_thresh,
+                              detection_fps, video_fps,
+                              reid_model_dir, reid_weight, reid_cos_thresh,
+                              pipeline_options, tracking_output);
+        }
+
+        if (!watch_options.dir.empty()) {
+            if (watch_options.frame_count < 0 && watch_options.sentinel.empty()) {
+                fprintf(stderr, "Error: --watch needs --watch-frames or --watch-sentinel to know when to finish\n");
+                return ERR_INVALID_ARGS;
+            }
+            WatchFolderSource source(watch_options);
+            if (!source.isOpen()) {
+                fprintf(stderr, "Error: %s\n", source.error().c_str());
+                return ERR_INVALID_ARGS;
+            }
+            if (!source.waitForFrame(0)) {
+                fprintf(stderr, "Error: No frames appeared in %s\n", watch_options.dir.c_str());
+                return ERR_NO_INPUT;
+            }
+            return RunTracking(model_dir, source, conf_thresh, iou_thresh,
+                              detection_fps, video_fps,
+                              reid_model_dir, reid_weight, reid_cos_thresh,
+                              pipeline_options, tracking_output);
+        }
+
+        if (!raw_input.empty()) {
+            RawStreamSource source(raw_input, raw_format);
+            if (!source.isOpen()) {
+                fprintf(stderr, "Error: %s\n", source.error().c_str());
+                return ERR_IMAGE_LOAD_FAILED;
+            }
+            return RunTracking(model_dir, source, conf_thresh, iou_thresh,
+                              detection_fps, video_fps,
+                              reid_model_dir, reid_weight, reid_cos_thresh,
+                              pipeline_options, tracking_output);
+        }
+
+        if (stream_paths) {
+            // Paths are consumed as the producer writes them; only the final
+            // linking pass waits for EOF. The frame cache needs the whole list
+            // for its sequence hash, so it is not used here.
+            if (!frame_cache_path.empty()) {
+                fprintf(stderr, "Warning: --frame-cache is ignored with --stream-paths\n");
+            }
+            std::ifstream file;
+            if (!images_file.empty()) {
+                file.open(images_file);
+            }
+            PathStreamSource source(images_file.empty() ? std::cin : file);
+            if (!source.waitForFrame(0)) {
+                fprintf(stderr, "Error: No image paths provided\n");
+                return ERR_NO_INPUT;
+            }
+            return RunTracking(model_dir, source, conf_thresh, iou_thresh,
+                              detection_fps, video_fps,
+                              reid_model_dir, reid_weight, reid_cos_thresh,
+                              pipeline_options, tracking_output);
+        }
+
+        // Image sequences (pattern or path list) may go through the frame cache
+        // or feed the INT8 calibration tools instead of tracking.
+        calibration_options.detector = pipeline_options.detector;
+        auto run_sequence = [&](FrameSource& source, uint64_t sequence_hash) {
+            if (!calibration_dir.empty()) {
+                return RunCalibrationExport(source, model_dir, reid_model_dir, calibration_dir, calibration_options);
+            }
+            if (int8_parity) {
+                return RunInt8ParityCheck(source, model_dir, reid_model_dir, calibration_options, int8_min_recall);
+            }
+            if (frame_cache_path.empty()) {
+                return RunTracking(model_dir, source, conf_thresh, iou_thresh,
+                                  detection_fps, video_fps,
+                                  reid_model_dir, reid_weight, reid_cos_thresh,
+                                  pipeline_options, tracking_output);
+            }
+            const int frame_count = source.frameCount();
+            if (auto cached = ContainerFrameSource::Open(frame_cache_path, frame_count, sequence_hash)) {
+                return RunTracking(model_dir, *cached, conf_thresh, iou_thresh,
+                                  detection_fps, video_fps,
+                                  reid_model_dir, reid_weight, reid_cos_thresh,
+                                  pipeline_options, tracking_output);
+            }
+            FrameContainerWriter writer(frame_cache_path, frame_count, sequence_hash);
+            RecordingFrameSource recording(source, writer);
+            const int rc = RunTracking(model_dir, recording, conf_thresh, iou_thresh,
+                                       detection_fps, video_fps,
+                                       reid_model_dir, reid_weight, reid_cos_thresh,
+                                       pipeline_options, tracking_output);
+            if (rc == SUCCESS && !writer.finish()) {
+                fprintf(stderr, "Warning: frame cache %s was not written\n", frame_cache_path.c_str());
+            }
+            return rc;
+        };
+
+        if (!frames_pattern.empty()) {
+            if (!IsValidFramePattern(frames_pattern)) {
+                fprintf(stderr, "Error: --frames expects a pattern with one %%d conversion, e.g. frame%%06d.png\n");
+                return ERR_INVALID_ARGS;
+            }
+            if (range_first < 0 || range_last < range_first) {
+                fprintf(stderr, "Error: --frames needs --range <first>:<last>\n");
+                return ERR_INVALID_ARGS;
+            }
+            ImagePatternSource source(frames_pattern, range_first, range_last);
+            const uint64_t sequence_hash = frame_cache_path.empty() ? 0 :
+                HashFrameSequence(source.frameCount(), [&source](int i) { return source.framePath(i); });
+            return run_sequence(source, sequence_hash);
+        }
+
         std::vector<std::string> image_paths;
+        if (!pipeline_options.replay_detections_path.empty() && images_file.empty()) {
+            // Replay without input: the dump must hold every frame.
+            ImageListSource source(image_paths);
+            return RunTracking(model_dir, source, conf_thresh, iou_thresh,
+                              detection_fps, video_fps,
+                              reid_model_dir, reid_weight, reid_cos_thresh,
+                              pipeline_options, tracking_output);
+        }
         
         if (!images_file.empty()) {
             image_paths = ReadPathsFromFile(images_file);
         } else {
             image_paths = ReadPathsFromStdin();
         }
+
+        if (image_paths.empty()) {
+            fprintf(stderr, "Error: No image paths provided\n");
+            return ERR_NO_INPUT;
+        }
         
-        return RunTracking(model_dir, image_paths, conf_thresh, iou_thresh,
-                          detection_fps, video_fps,
-                          reid_model_dir, reid_weight, reid_cos_thresh);
+        ImageListSource source(image_paths);
+        return run_sequence(source, frame_cache_path.empty() ? 0 : HashFrameSequence(image_paths));
     } else if (!image_path.empty()) {
         // Single image detection mode
-        return RunDetection(model_dir, image_path, conf_thresh, nms_thresh);
+        return RunDetection(model_dir, image_path, conf_thresh, nms_thresh, pipeline_options);
     } else {
         fprintf(stderr, "Error: Either --image or --track is required\n\n");
         PrintUsage(argv[0]);
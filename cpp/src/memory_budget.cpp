@@ -0,0 +1,112 @@
+#include "memory_budget.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "alloc_stats.hpp"
+#include "stage_profile.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+void MemoryBudget::Account::set(size_t bytes) {
+    if (bytes == bytes_) return;
+    budget_.change(name_, budgeted_, bytes_, bytes);
+    bytes_ = bytes;
+}
+
+void MemoryBudget::change(const std::string& name, bool budgeted, size_t before, size_t after) {
+    if (budgeted) {
+        const size_t used = after >= before ? used_.fetch_add(after - before) + (after - before)
+                                            : used_.fetch_sub(before - after) - (before - after);
+        size_t peak = peak_.load(std::memory_order_relaxed);
+        while (used > peak && !peak_.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+        }
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    Entry& entry = by_name_[name];
+    entry.held = entry.held + after - before;
+    entry.peak = std::max(entry.peak, entry.held);
+    entry.budgeted = budgeted;
+}
+
+std::vector<std::pair<std::string, size_t>> MemoryBudget::peaks(bool budgeted) const {
+    std::vector<std::pair<std::string, size_t>> out;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        for (const auto& entry : by_name_) {
+            if (entry.second.budgeted == budgeted) out.emplace_back(entry.first, entry.second.peak);
+        }
+    }
+    std::stable_sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    return out;
+}
+
+namespace {
+// "12.3 MB", or "45 KB" for what would round to nothing in MB.
+void PrintBytes(const char* prefix, const char* name, size_t bytes) {
+    if (bytes < (size_t(1) << 20)) {
+        fprintf(stderr, "%s%s %.0f KB", prefix, name, static_cast<double>(bytes) / 1024.0);
+    } else {
+        fprintf(stderr, "%s%s %.1f MB", prefix, name, static_cast<double>(bytes) / (1 << 20));
+    }
+}
+}  // namespace
+
+void PrintMemoryReport(const MemoryBudget& budget) {
+    constexpr double kMb = 1.0 / (1 << 20);
+    if (budget.limit() > 0) {
+        fprintf(stderr, "Memory: peak %.1f MB of a %.0f MB budget", static_cast<double>(budget.peak()) * kMb,
+                static_cast<double>(budget.limit()) * kMb);
+    } else {
+        fprintf(stderr, "Memory: peak %.1f MB in caches and queues", static_cast<double>(budget.peak()) * kMb);
+    }
+    const char* sep = " (";
+    for (const auto& entry : budget.peaks()) {
+        fprintf(stderr, "%s%s %.1f MB", sep, entry.first.c_str(), static_cast<double>(entry.second) * kMb);
+        sep = ", ";
+    }
+    if (*sep == ',') fprintf(stderr, ")");
+    sep = "; high-water ";
+    for (const auto& entry : budget.peaks(false)) {
+        PrintBytes(sep, entry.first.c_str(), entry.second);
+        sep = ", ";
+    }
+    const size_t rss = MemoryBudget::ProcessPeakRss();
+    if (rss > 0) fprintf(stderr, "; process peak RSS %.1f MB", static_cast<double>(rss) * kMb);
+    fprintf(stderr, "\n");
+    if (!AllocStats::kEnabled) return;
+    fprintf(stderr, "Allocations: heap peak %.1f MB", static_cast<double>(AllocStats::heapPeak()) * kMb);
+    for (int s = 0; s <= static_cast<int>(ProfileStage::Count); ++s) {
+        const ProfileStage stage = static_cast<ProfileStage>(s);
+        const AllocStats::Counts counts = AllocStats::of(stage);
+        if (counts.allocations == 0) continue;
+        const char* name = stage == ProfileStage::Count ? "other" : ProfileStageName(stage);
+        fprintf(stderr, "; %s %llu allocations,", name, static_cast<unsigned long long>(counts.allocations));
+        PrintBytes("", "", counts.bytes);
+    }
+    fprintf(stderr, "\n");
+}
+
+size_t MemoryBudget::ProcessPeakRss() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);  // bytes
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // kilobytes
+#endif
+#endif
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Memory budget shared by a pipeline's caches and queues
+ * (PipelineOptions::memory_budget_mb).
+ *
+ * Each consumer opens an Account and keeps it set to the bytes it holds;
+ * the budget sums them over all consumers (and concurrent runs). Consumers
+ * that can give memory back consult fits() before they grow:
+ *
+ *   - frame queues (decode prefetch, detection and GMC workers) decode a
+ *     frame ahead only while it fits, so their depth shrinks with the
+ *     frame size, down to one frame in flight;
+ *   - compact track storage spills to its temporary file once the budget
+ *     is spent;
+ *   - the detection cache stops taking new frames.
+ *
+ * Without a limit the budget only keeps count, for the report at exit.
+ * Working buffers of the stages themselves (the frames being tracked, the
+ * networks) are not accounted; the limit is best set somewhat under the
+ * memory the process should stay in. Some of them are watched instead
+ * (--memory-report): their accounts report a high-water mark but are not
+ * part of the budget.
+ */
+class MemoryBudget {
+public:
+    /** One consumer's share of the budget, given back when it is destroyed. */
+    class Account {
+    public:
+        Account(MemoryBudget& budget, std::string name, bool budgeted = true)
+            : budget_(budget), name_(std::move(name)), budgeted_(budgeted) {}
+        ~Account() { set(0); }
+
+        Account(const Account&) = delete;
+        Account& operator=(const Account&) = delete;
+
+        /** The bytes this consumer holds now. */
+        void set(size_t bytes);
+        size_t bytes() const { return bytes_; }
+
+        /** True if `more` bytes (on top of what everyone holds) stay within the budget. */
+        bool fits(size_t more) const { return budget_.fits(more); }
+
+    private:
+        MemoryBudget& budget_;
+        std::string name_;
+        bool budgeted_;
+        size_t bytes_ = 0;  // set() is called by one thread at a time
+    };
+
+    /** @param limit_bytes Bytes all accounts may hold together (0 = no limit, only count) */
+    explicit MemoryBudget(size_t limit_bytes = 0) : limit_(limit_bytes) {}
+
+    /** Open an account for a consumer; accounts of the same name are reported together. */
+    std::unique_ptr<Account> open(const std::string& name) { return std::make_unique<Account>(*this, name); }
+
+    /** Open an account that only records its high-water mark, outside the budget. */
+    std::unique_ptr<Account> watch(const std::string& name) { return std::make_unique<Account>(*this, name, false); }
+
+    size_t limit() const { return limit_; }
+    size_t used() const { return used_.load(std::memory_order_relaxed); }
+    size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+    bool fits(size_t more) const { return limit_ == 0 || used() + more <= limit_; }
+
+    /** Highest bytes held by each consumer name, largest first (budgeted or watched ones). */
+    std::vector<std::pair<std::string, size_t>> peaks(bool budgeted = true) const;
+
+    /** Peak resident set size of the process so far (0 if unknown). */
+    static size_t ProcessPeakRss();
+
+private:
+    void change(const std::string& name, bool budgeted, size_t before, size_t after);
+
+    struct Entry {
+        size_t held = 0;
+        size_t peak = 0;
+        bool budgeted = true;
+    };
+
+    const size_t limit_;
+    std::atomic<size_t> used_{0};
+    std::atomic<size_t> peak_{0};
+    mutable std::mutex mu_;
+    std::map<std::string, Entry> by_name_;
+};
+
+/**
+ * Report peak use to stderr (at exit): the budget, each consumer, the
+ * watched buffers and the process's peak RSS, then the allocations of each
+ * stage in FACE_PIPELINE_ALLOC_STATS builds.
+ */
+void PrintMemoryReport(const MemoryBudget& budget);
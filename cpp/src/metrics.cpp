@@ -0,0 +1,123 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+#include "json_writer.hpp"
+
+namespace {
+int BucketOf(double value) {
+    if (!(value > 0.0)) return 0;
+    int exponent = 0;
+    std::frexp(value, &exponent);  // value < 2^exponent
+    return std::max(1, std::min(MetricsRegistry::Histogram::kBuckets - 1, exponent + 33));
+}
+}  // namespace
+
+void MetricsRegistry::Histogram::observe(double value) {
+    if (!std::isfinite(value)) return;
+    min_ = count_ > 0 ? std::min(min_, value) : value;
+    max_ = count_ > 0 ? std::max(max_, value) : value;
+    count_++;
+    sum_ += value;
+    buckets_[static_cast<size_t>(BucketOf(value))]++;
+}
+
+void MetricsRegistry::Histogram::merge(const Histogram& other) {
+    if (other.count_ == 0) return;
+    min_ = count_ > 0 ? std::min(min_, other.min_) : other.min_;
+    max_ = count_ > 0 ? std::max(max_, other.max_) : other.max_;
+    count_ += other.count_;
+    sum_ += other.sum_;
+    for (int b = 0; b < kBuckets; ++b) buckets_[static_cast<size_t>(b)] += other.buckets_[static_cast<size_t>(b)];
+}
+
+double MetricsRegistry::Histogram::quantile(double q) const {
+    if (count_ == 0) return 0.0;
+    const int64_t rank = std::max<int64_t>(1, static_cast<int64_t>(q * static_cast<double>(count_) + 0.5));
+    int64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += buckets_[static_cast<size_t>(b)];
+        if (seen >= rank) {
+            const double upper = b == 0 ? 0.0 : std::ldexp(1.0, b - 33);
+            return std::max(min_, std::min(max_, upper));
+        }
+    }
+    return max_;
+}
+
+void MetricsRegistry::add(const std::string& name, int64_t delta) {
+    std::lock_guard<std::mutex> lock(mu_);
+    counters_[name] += delta;
+}
+
+void MetricsRegistry::set(const std::string& name, double value) {
+    std::lock_guard<std::mutex> lock(mu_);
+    gauges_[name] = value;
+}
+
+void MetricsRegistry::observe(const std::string& name, double value) {
+    std::lock_guard<std::mutex> lock(mu_);
+    histograms_[name].observe(value);
+}
+
+void MetricsRegistry::merge(const std::string& name, const Histogram& histogram) {
+    if (histogram.count() == 0) return;
+    std::lock_guard<std::mutex> lock(mu_);
+    histograms_[name].merge(histogram);
+}
+
+int64_t MetricsRegistry::counter(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    const auto it = counters_.find(name);
+    return it != counters_.end() ? it->second : 0;
+}
+
+std::string MetricsRegistry::json() const {
+    std::string out;
+    JsonWriter w(out);
+    std::lock_guard<std::mutex> lock(mu_);
+    const char* sep = "";
+    w.raw("{\"counters\": {");
+    for (const auto& entry : counters_) {
+        w.raw(sep).string(entry.first).raw(": ").integer(entry.second);
+        sep = ", ";
+    }
+    sep = "";
+    w.raw("}, \"gauges\": {");
+    for (const auto& entry : gauges_) {
+        w.raw(sep).string(entry.first).raw(": ").fixed(std::isfinite(entry.second) ? entry.second : 0.0, 4);
+        sep = ", ";
+    }
+    sep = "";
+    w.raw("}, \"histograms\": {");
+    for (const auto& entry : histograms_) {
+        const Histogram& h = entry.second;
+        w.raw(sep).string(entry.first).raw(": {\"count\": ").integer(h.count());
+        w.raw(", \"sum\": ").fixed(h.sum(), 4).raw(", \"min\": ").fixed(h.min(), 4);
+        w.raw(", \"max\": ").fixed(h.max(), 4).raw(", \"mean\": ").fixed(h.mean(), 4);
+        w.raw(", \"p50\": ").fixed(h.quantile(0.50), 4).raw(", \"p95\": ").fixed(h.quantile(0.95), 4);
+        w.raw(", \"p99\": ").fixed(h.quantile(0.99), 4).ch('}');
+        sep = ", ";
+    }
+    w.raw("}}");
+    w.flush();
+    return out;
+}
+
+bool MetricsRegistry::write(const std::string& path, std::string& error) const {
+    const std::string text = json();
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "w"), &std::fclose);
+    if (!file) {
+        error = "cannot create " + path;
+        return false;
+    }
+    const bool written = std::fputs(text.c_str(), file.get()) >= 0 && std::fputc('\n', file.get()) != EOF;
+    if (std::fclose(file.release()) != 0 || !written) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Run statistics of every stage in one place (--metrics, the server's
+ * "metrics" method): counters that add up over runs, gauges that hold the
+ * latest run's value and histograms of per-call values, under dotted names
+ * such as "gmc.ok" or "associate.detections". The whole registry is one
+ * JSON object, so dashboards can follow the same names from build to
+ * build.
+ *
+ * Recording takes a lock, so stages record once per run; per-frame values
+ * collect in a Histogram of the caller's own, merged in one call.
+ */
+class MetricsRegistry {
+public:
+    /**
+     * Distribution of values: count, sum, min, max and one bucket per
+     * power of two (2^-32 .. 2^30), enough for quantiles within a factor
+     * of two.
+     */
+    class Histogram {
+    public:
+        void observe(double value);
+        void merge(const Histogram& other);
+
+        int64_t count() const { return count_; }
+        double sum() const { return sum_; }
+        double min() const { return count_ > 0 ? min_ : 0.0; }
+        double max() const { return count_ > 0 ? max_ : 0.0; }
+        double mean() const { return count_ > 0 ? sum_ / static_cast<double>(count_) : 0.0; }
+        /** Upper bound of the q-quantile's bucket, within [min(), max()]. */
+        double quantile(double q) const;
+
+        static constexpr int kBuckets = 64;  // 0 holds values <= 0, b > 0 those below 2^(b - 33)
+
+    private:
+        int64_t count_ = 0;
+        double sum_ = 0.0;
+        double min_ = 0.0;
+        double max_ = 0.0;
+        std::array<int64_t, kBuckets> buckets_{};
+    };
+
+    void add(const std::string& name, int64_t delta = 1);
+    void set(const std::string& name, double value);
+    void observe(const std::string& name, double value);
+    void merge(const std::string& name, const Histogram& histogram);
+
+    int64_t counter(const std::string& name) const;
+
+    /**
+     * The registry as JSON: {"counters": {name: n}, "gauges": {name: x},
+     * "histograms": {name: {"count", "sum", "min", "max", "mean", "p50",
+     * "p95", "p99"}}}, names in order.
+     */
+    std::string json() const;
+
+    /** @return false (with `error`) if the file cannot be written */
+    bool write(const std::string& path, std::string& error) const;
+
+private:
+    mutable std::mutex mu_;
+    std::map<std::string, int64_t> counters_;
+    std::map<std::string, double> gauges_;
+    std::map<std::string, Histogram> histograms_;
+};
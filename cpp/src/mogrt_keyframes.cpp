@@ -0,0 +1,132 @@
+#include "mogrt_keyframes.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "json_writer.hpp"
+#include "keyframes.hpp"
+
+namespace {
+// mogrt/index.ts: COMP_BASE_TICKS (01:00:00:00) and one 48 kHz sample of
+// forward bias, so Premiere does not round a keyframe into the previous frame.
+constexpr int64_t kCompBaseTicks = 914457600000000LL;
+constexpr int64_t kAudioSampleTicks = 254016000000LL / 48000;
+constexpr float kTinyMaskSide = 0.001f;  // createTinyMaskPath()
+
+using Corners = std::array<std::array<float, 2>, 4>;
+
+Corners BoxCorners(const BBox& b) {
+    return {{{b.x1, b.y1}, {b.x2, b.y1}, {b.x2, b.y2}, {b.x1, b.y2}}};
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int s = 0; s < 32; s += 8) out.push_back(static_cast<uint8_t>(v >> s));
+}
+
+void PutF32(std::vector<uint8_t>& out, float v) {
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    PutU32(out, bits);
+}
+
+// encodeMaskPathBinary(): "2cin", closed flag 2, 0, point count, then per
+// point its type (0), position, in and out tangents (the position: straight
+// edges) and 0x01000000.
+std::string EncodeMaskPath(const Corners& points) {
+    std::vector<uint8_t> bytes;
+    bytes.reserve(16 + points.size() * 32);
+    const char magic[4] = {'2', 'c', 'i', 'n'};
+    bytes.insert(bytes.end(), magic, magic + 4);
+    PutU32(bytes, 2);
+    PutU32(bytes, 0);
+    PutU32(bytes, static_cast<uint32_t>(points.size()));
+    for (const auto& p : points) {
+        PutU32(bytes, 0);
+        for (int k = 0; k < 3; ++k) {
+            PutF32(bytes, p[0]);
+            PutF32(bytes, p[1]);
+        }
+        PutU32(bytes, 0x01000000u);
+    }
+
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string text;
+    text.reserve((bytes.size() + 2) / 3 * 4);
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        const size_t n = std::min<size_t>(3, bytes.size() - i);
+        const uint32_t v = (static_cast<uint32_t>(bytes[i]) << 16) |
+                           (n > 1 ? static_cast<uint32_t>(bytes[i + 1]) << 8 : 0) | (n > 2 ? bytes[i + 2] : 0);
+        text.push_back(kAlphabet[(v >> 18) & 63]);
+        text.push_back(kAlphabet[(v >> 12) & 63]);
+        text.push_back(n > 1 ? kAlphabet[(v >> 6) & 63] : '=');
+        text.push_back(n > 2 ? kAlphabet[v & 63] : '=');
+    }
+    return text;
+}
+}  // namespace
+
+int64_t MogrtKeyframeTicks(int frame, int64_t ticks_per_frame) {
+    return kCompBaseTicks + static_cast<int64_t>(frame) * ticks_per_frame + kAudioSampleTicks;
+}
+
+bool WriteMogrtKeyframes(const std::string& path, const PipelineResult& result, int64_t ticks_per_frame,
+                         float tolerance_px, std::string& error) {
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "w"), &std::fclose);
+    if (!file) {
+        error = "cannot create " + path;
+        return false;
+    }
+    const std::string tiny = EncodeMaskPath(BoxCorners({0.0f, 0.0f, kTinyMaskSide, kTinyMaskSide}));
+    const int frame_count = result.frame_count;
+    const bool reduce = tolerance_px > 0.0f && result.frame_width > 0 && result.frame_height > 0;
+
+    JsonWriter w(file.get());
+    w.raw("{\"ticksPerFrame\": \"").integer(ticks_per_frame).raw("\", \"frameCount\": ").integer(frame_count);
+    w.raw(", \"tracks\": [");
+    std::vector<TrackFrame> run;
+    for (size_t t = 0; t < result.tracks.size(); ++t) {
+        const FaceTrack& track = result.tracks[t];
+        w.raw(t == 0 ? "\n" : ",\n").raw("{\"id\": ").integer(track.id).raw(", \"keyframes\": \"");
+        auto key = [&](int frame, const std::string& mask) {
+            w.integer(MogrtKeyframeTicks(frame, ticks_per_frame)).ch(',').raw(mask).ch(';');
+        };
+        // Frames [from, to] without the face: a tiny mask on each, or on the
+        // two ends only when interpolating between them keeps it tiny.
+        auto absent = [&](int from, int to) {
+            for (int f = from; f <= to; ++f) {
+                if (!reduce || f == from || f == to) key(f, tiny);
+            }
+        };
+        int next = 0;  // first frame not keyed yet
+        size_t i = 0;
+        const std::vector<TrackFrame>& frames = track.frames;
+        while (i < frames.size()) {
+            if (frames[i].frame_index < next || frames[i].frame_index >= frame_count) {
+                ++i;
+                continue;
+            }
+            run.clear();
+            run.push_back(frames[i++]);
+            while (i < frames.size() && frames[i].frame_index == run.back().frame_index + 1 &&
+                   frames[i].frame_index < frame_count) {
+                run.push_back(frames[i++]);
+            }
+            absent(next, run.front().frame_index - 1);
+            next = run.back().frame_index + 1;
+            if (reduce) ReduceToKeyframes(run, tolerance_px, result.frame_width, result.frame_height);
+            for (const TrackFrame& f : run) key(f.frame_index, EncodeMaskPath(BoxCorners(f.bbox)));
+        }
+        absent(next, frame_count - 1);
+        w.raw("\"}");
+    }
+    w.raw(result.tracks.empty() ? "]}\n" : "\n]}\n");
+    if (!w.flush() || std::fclose(file.release()) != 0) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
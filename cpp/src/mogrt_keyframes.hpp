@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "pipeline.hpp"
+
+/**
+ * Mask Path keyframes of the panel's MOGRT template, built from output
+ * tracks (--emit-mogrt-keyframes) so the panel only patches them in.
+ *
+ * Each keyframe is "<ticks>,<base64 mask path>;" exactly as
+ * src/js/lib/utils/mogrt/index.ts writes a <Keyframes> element: ticks from
+ * the template's 01:00:00:00 comp start plus one audio sample, the path in
+ * encoder.ts's "2cin" layout (16-byte header, 32 bytes a point) with the
+ * box's four corners clockwise from the top left. Frames of the run where
+ * a track has no box get a near-invisible mask at the origin.
+ *
+ * The file is JSON:
+ *
+ *   {"ticksPerFrame": "<n>", "frameCount": n,
+ *    "tracks": [{"id": n, "keyframes": "<ticks>,<base64>;..."}, ...]}
+ */
+
+/** Ticks (254016000000 a second) of the keyframe on `frame`. */
+int64_t MogrtKeyframeTicks(int frame, int64_t ticks_per_frame);
+
+/**
+ * Write the MOGRT keyframes of `result`'s tracks, frames 0 to
+ * result.frame_count - 1, to `path`. The tracks must hold every frame they
+ * cover: not streamed out, not reduced by PipelineOptions::keyframe_tolerance.
+ *
+ * @param tolerance_px Above 0: a keyframe only where linear interpolation
+ *        misses the box by more than this many pixels (see keyframes.hpp),
+ *        and at each end of a stretch without the face; 0 = every frame
+ * @return false (with `error`) if the file cannot be written
+ */
+bool WriteMogrtKeyframes(const std::string& path, const PipelineResult& result, int64_t ticks_per_frame,
+                         float tolerance_px, std::string& error);
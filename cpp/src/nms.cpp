@@ -0,0 +1,120 @@
+#include "nms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+// Grid resolution limit per axis; finer grids only cost memory.
+constexpr int kMaxCells = 64;
+
+float Iou(const std::array<float, 4>& a, const std::array<float, 4>& b) {
+    const float inter_w = std::max(0.0f, std::min(a[2], b[2]) - std::max(a[0], b[0]));
+    const float inter_h = std::max(0.0f, std::min(a[3], b[3]) - std::max(a[1], b[1]));
+    const float inter = inter_w * inter_h;
+    const float area_a = (a[2] - a[0]) * (a[3] - a[1]);
+    const float area_b = (b[2] - b[0]) * (b[3] - b[1]);
+    return inter / (area_a + area_b - inter + 1e-6f);
+}
+
+// Kept boxes of one suppression level, binned by the grid cells they cover.
+class KeptGrid {
+public:
+    KeptGrid(float x0, float y0, float cell, int cols, int rows)
+        : x0_(x0), y0_(y0), inv_cell_(1.0f / cell), cols_(cols), rows_(rows),
+          cells_(static_cast<size_t>(cols) * static_cast<size_t>(rows)) {}
+
+    // True if a kept box overlaps `b` by IoU > thresh. `stamp` and `seen`
+    // make sure a box spanning several cells is tested once per query.
+    bool suppresses(const std::vector<std::array<float, 4>>& boxes, const std::array<float, 4>& b, float thresh,
+                    std::vector<uint32_t>& seen, uint32_t stamp) const {
+        int cx0, cy0, cx1, cy1;
+        span(b, cx0, cy0, cx1, cy1);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                for (int k : cells_[static_cast<size_t>(cy) * cols_ + cx]) {
+                    if (seen[static_cast<size_t>(k)] == stamp) continue;
+                    seen[static_cast<size_t>(k)] = stamp;
+                    if (Iou(boxes[static_cast<size_t>(k)], b) > thresh) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void insert(const std::array<float, 4>& b, int index) {
+        int cx0, cy0, cx1, cy1;
+        span(b, cx0, cy0, cx1, cy1);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                cells_[static_cast<size_t>(cy) * cols_ + cx].push_back(index);
+            }
+        }
+    }
+
+private:
+    int cell(float v, float origin, int n) const {
+        const int c = static_cast<int>(std::floor((v - origin) * inv_cell_));
+        return std::max(0, std::min(n - 1, c));
+    }
+
+    void span(const std::array<float, 4>& b, int& cx0, int& cy0, int& cx1, int& cy1) const {
+        cx0 = cell(b[0], x0_, cols_);
+        cy0 = cell(b[1], y0_, rows_);
+        cx1 = cell(b[2], x0_, cols_);
+        cy1 = cell(b[3], y0_, rows_);
+    }
+
+    float x0_, y0_, inv_cell_;
+    int cols_, rows_;
+    std::vector<std::vector<int>> cells_;
+};
+}  // namespace
+
+std::vector<int> GreedyNms(const std::vector<std::array<float, 4>>& boxes,
+                           const std::vector<float>& scores,
+                           float iou_thresh,
+                           float second_thresh) {
+    const int n = static_cast<int>(std::min(boxes.size(), scores.size()));
+    std::vector<int> order(static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i) order[static_cast<size_t>(i)] = i;
+    std::stable_sort(order.begin(), order.end(), [&scores](int a, int b) { return scores[a] > scores[b]; });
+    if (n <= 1) return order;
+
+    // Overlapping boxes always share a cell whatever its size; cells about
+    // the size of a typical box keep each query to a few cells.
+    float x0 = boxes[0][0], y0 = boxes[0][1], x1 = boxes[0][2], y1 = boxes[0][3];
+    std::vector<float> sides(static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i) {
+        const auto& b = boxes[static_cast<size_t>(i)];
+        x0 = std::min(x0, b[0]);
+        y0 = std::min(y0, b[1]);
+        x1 = std::max(x1, b[2]);
+        y1 = std::max(y1, b[3]);
+        sides[static_cast<size_t>(i)] = std::max(b[2] - b[0], b[3] - b[1]);
+    }
+    std::nth_element(sides.begin(), sides.begin() + n / 2, sides.end());
+    const float extent = std::max(x1 - x0, y1 - y0);
+    const float cell = std::max({sides[static_cast<size_t>(n / 2)], extent / kMaxCells, 1e-6f});
+    const int cols = std::max(1, std::min(kMaxCells, static_cast<int>((x1 - x0) / cell) + 1));
+    const int rows = std::max(1, std::min(kMaxCells, static_cast<int>((y1 - y0) / cell) + 1));
+
+    const bool two_levels = second_thresh >= 0.0f;
+    KeptGrid first(x0, y0, cell, cols, rows);
+    KeptGrid second(x0, y0, cell, cols, rows);
+    std::vector<uint32_t> seen(static_cast<size_t>(n), 0);
+    uint32_t stamp = 0;
+
+    std::vector<int> keep;
+    for (int idx : order) {
+        const auto& b = boxes[static_cast<size_t>(idx)];
+        if (first.suppresses(boxes, b, iou_thresh, seen, ++stamp)) continue;
+        first.insert(b, idx);
+        if (two_levels) {
+            if (second.suppresses(boxes, b, second_thresh, seen, ++stamp)) continue;
+            second.insert(b, idx);
+        }
+        keep.push_back(idx);
+    }
+    return keep;
+}
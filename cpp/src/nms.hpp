@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+/**
+ * Greedy non-maximum suppression over axis-aligned boxes (x1, y1, x2, y2).
+ *
+ * Boxes are sorted by score once and visited in that order. A box is kept
+ * unless an already kept box overlaps it by IoU > `iou_thresh`. An optional
+ * second, stricter threshold is applied in the same sweep and behaves exactly
+ * like running NMS again at `second_thresh` on the survivors of the first
+ * level.
+ *
+ * Kept boxes are binned on a coarse grid, so each box is only compared with
+ * kept boxes that share a cell.
+ *
+ * @param boxes Box corners; degenerate boxes never suppress anything
+ * @param scores One score per box
+ * @param iou_thresh First-level IoU threshold (>= 0)
+ * @param second_thresh Second-level IoU threshold (< 0 = off)
+ * @return Indices of the boxes kept by both levels, by descending score
+ */
+std::vector<int> GreedyNms(const std::vector<std::array<float, 4>>& boxes,
+                           const std::vector<float>& scores,
+                           float iou_thresh,
+                           float second_thresh = -1.0f);
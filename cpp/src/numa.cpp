@@ -0,0 +1,118 @@
+#include "numa.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+namespace {
+// "0-3,8-11" -> 0 1 2 3 8 9 10 11.
+std::vector<int> ParseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    const char* p = text.c_str();
+    while (*p) {
+        char* end = nullptr;
+        const long first = std::strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = std::strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long c = first; c <= last; ++c) cpus.push_back(static_cast<int>(c));
+        if (*p != ',') break;
+        ++p;
+    }
+    return cpus;
+}
+
+// CPUs of each node that has any, in node order.
+const std::vector<std::vector<int>>& Nodes() {
+    static const std::vector<std::vector<int>> nodes = [] {
+        std::vector<std::vector<int>> out;
+#if defined(__linux__)
+        std::vector<int> ids;
+        if (DIR* d = opendir("/sys/devices/system/node")) {
+            while (const dirent* e = readdir(d)) {
+                if (std::strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+                    ids.push_back(std::atoi(e->d_name + 4));
+                }
+            }
+            closedir(d);
+        }
+        std::sort(ids.begin(), ids.end());
+        for (const int id : ids) {
+            std::ifstream f("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string line;
+            if (!std::getline(f, line)) continue;
+            std::vector<int> cpus = ParseCpuList(line);
+            if (!cpus.empty()) out.push_back(std::move(cpus));
+        }
+#endif
+        if (out.empty()) out.emplace_back();
+        return out;
+    }();
+    return nodes;
+}
+}  // namespace
+
+bool ParseNumaPlacement(const char* name, NumaPlacement& out) {
+    if (std::strcmp(name, "off") == 0) {
+        out = NumaPlacement::Off;
+    } else if (std::strcmp(name, "nodes") == 0) {
+        out = NumaPlacement::Nodes;
+    } else if (std::strcmp(name, "replicas") == 0) {
+        out = NumaPlacement::Replicas;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int NumaNodeCount() {
+    return static_cast<int>(Nodes().size());
+}
+
+const std::vector<int>& NumaNodeCpus(int node) {
+    static const std::vector<int> kNone;
+    return node >= 0 && node < NumaNodeCount() ? Nodes()[static_cast<size_t>(node)] : kNone;
+}
+
+bool BindThreadToNumaNode(int node) {
+    const std::vector<int>& cpus = NumaNodeCpus(node);
+    if (cpus.empty()) return false;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int c : cpus) {
+        if (c < CPU_SETSIZE) CPU_SET(c, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+int CurrentNumaNode() {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return -1;
+    for (int node = 0; node < NumaNodeCount(); ++node) {
+        const std::vector<int>& cpus = NumaNodeCpus(node);
+        int inside = 0;
+        for (const int c : cpus) {
+            if (c < CPU_SETSIZE && CPU_ISSET(c, &set)) inside++;
+        }
+        if (inside > 0 && inside == CPU_COUNT(&set)) return node;
+    }
+#endif
+    return -1;
+}
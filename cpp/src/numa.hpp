@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * NUMA placement of a batch on multi-socket machines (--numa).
+ *
+ * On Linux the nodes and their CPUs come from sysfs, and threads are bound
+ * with sched_setaffinity. Memory follows by first touch (the kernel's
+ * default local policy): threads a bound thread starts inherit its CPUs, so
+ * the frames a clip's decoders fill and the blobs its detectors allocate
+ * land on the node that reads them. Elsewhere, and on single-node
+ * machines, there is one node and binding does nothing.
+ */
+enum class NumaPlacement {
+    Off,       // clips run wherever the scheduler puts them (default)
+    Nodes,     // each clip runs on one node with that node's worker pool
+    Replicas,  // as Nodes, plus a copy of the models on every node
+};
+
+/**
+ * Parse "off", "nodes" or "replicas".
+ */
+bool ParseNumaPlacement(const char* name, NumaPlacement& out);
+
+/**
+ * Nodes that have CPUs (at least 1).
+ */
+int NumaNodeCount();
+
+/**
+ * CPUs of `node` (0 .. NumaNodeCount() - 1); empty where unknown.
+ */
+const std::vector<int>& NumaNodeCpus(int node);
+
+/**
+ * Restrict the calling thread to the CPUs of `node`.
+ *
+ * @return false if the platform cannot bind threads or the node is unknown
+ */
+bool BindThreadToNumaNode(int node);
+
+/**
+ * Node whose CPUs hold every CPU the calling thread may run on; -1 if it
+ * spans nodes or cannot tell.
+ */
+int CurrentNumaNode();
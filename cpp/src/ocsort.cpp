@@ -1,11 +1,43 @@
 #include "ocsort.hpp"
+#include "checkpoint.hpp"
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include "tracy_zones.hpp"
 
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <utility>
 
 namespace {
-constexpr float kPi = 3.14159265358979323846f;
+constexpr float kGatedScore = -1e6f;  // association score of a pair below the IoU gate
+constexpr size_t kParallelAssignmentPairs = 4096;  // ambiguous pairs before components go to the pool
+constexpr uint32_t kMaxCheckpointTracks = 1u << 20;  // sanity bound on a checkpoint's track count
+constexpr int kMaxEmbeddingDim = 4096;
+// Motion gate innovation std per unit of covariance growth (see OCSort::setMotionGate).
+constexpr float kGateCenterSigma = 0.1f;  // box sizes
+constexpr float kGateScaleSigma = 0.2f;   // log area
+
+void PutPackedEmbedding(CheckpointWriter& w, const PackedEmbedding& e) {
+    w.put(static_cast<uint32_t>(e.storage()));
+    w.put(static_cast<int32_t>(e.dim()));
+    w.put(e.scale());
+    w.bytes(e.payload(), e.bytes());
+}
+
+PackedEmbedding GetPackedEmbedding(CheckpointReader& r) {
+    const uint32_t storage = r.get<uint32_t>();
+    const int32_t dim = r.get<int32_t>();
+    const float scale = r.get<float>();
+    if (!r.ok() || storage > static_cast<uint32_t>(EmbeddingStorage::Int8) || dim < 0 || dim > kMaxEmbeddingDim) {
+        r.fail();
+        return {};
+    }
+    const EmbeddingStorage st = static_cast<EmbeddingStorage>(storage);
+    std::vector<unsigned char> bytes(PackedEmbedding::PayloadBytes(st, dim));
+    r.bytes(bytes.data(), bytes.size());
+    return PackedEmbedding::FromPayload(st, dim, scale, bytes.data());
+}
 inline float clampf(float v, float lo, float hi) {
     return std::max(lo, std::min(hi, v));
 }
@@ -28,27 +60,6 @@ inline float center_dist_norm_max_diag(const BBox& a, const BBox& b) {
     const float diag = std::max(bbox_diag(a), bbox_diag(b)) + 1e-6f;
     return std::sqrt(dx * dx + dy * dy) / diag;
 }
-
-inline float cosine_sim(const std::array<float, Detection::kReidDim>& a,
-                        const std::array<float, Detection::kReidDim>& b) {
-    double dot = 0.0;
-    for (int i = 0; i < Detection::kReidDim; ++i) {
-        dot += static_cast<double>(a[i]) * static_cast<double>(b[i]);
-    }
-    // Both vectors are expected L2-normalized; clamp for numerical safety.
-    return clampf(static_cast<float>(dot), -1.0f, 1.0f);
-}
-
-inline std::array<float, 2> speed_direction(const BBox& from, const BBox& to) {
-    const float cx1 = (from.x1 + from.x2) / 2.0f;
-    const float cy1 = (from.y1 + from.y2) / 2.0f;
-    const float cx2 = (to.x1 + to.x2) / 2.0f;
-    const float cy2 = (to.y1 + to.y2) / 2.0f;
-    const float dy = cy2 - cy1;
-    const float dx = cx2 - cx1;
-    const float norm = std::sqrt(dx * dx + dy * dy) + 1e-6f;
-    return {dy / norm, dx / norm};  // (dy, dx)
-}
 }  // namespace
 
 OCSort::OCSort(float iou_thresh,
@@ -74,72 +85,150 @@ std::map<int, TrackResult> OCSort::update(const std::vector<Detection>& detectio
                                            const Mat3f* warp_prev_to_curr,
                                            int frame_width,
                                            int frame_height) {
+    std::vector<TrackResult> tracks;
+    update(detections, tracks, return_all, warp_prev_to_curr, frame_width, frame_height);
+    std::map<int, TrackResult> result;
+    for (const TrackResult& t : tracks) result[t.track_id] = t;
+    return result;
+}
+
+void OCSort::update(const std::vector<Detection>& detections,
+                    std::vector<TrackResult>& out,
+                    bool return_all,
+                    const Mat3f* warp_prev_to_curr,
+                    int frame_width,
+                    int frame_height,
+                    const std::vector<TrackCue>* cues) {
+    FACE_PIPELINE_ZONE("OCSort::update");
     frame_count_++;
 
-    // Predict next state for all trackers
-    for (auto& tracker : trackers_) {
-        tracker->predict();
+    // Predict next state for all trackers (one batched pass over the bank)
+    bank_.predictAll();
+    for (int slot : live_) {
+        pool_[slot].markPredicted();
+    }
+    for (int slot : dormant_) {
+        pool_[slot].markPredicted();
     }
 
     // Apply global motion compensation (prev -> curr) after prediction.
     // This keeps association and output in the current frame's coordinate system.
     if (warp_prev_to_curr && frame_width > 0 && frame_height > 0) {
-        for (auto& tracker : trackers_) {
-            tracker->applyWarp(*warp_prev_to_curr, frame_width, frame_height);
+        bank_.warpAll(*warp_prev_to_curr, frame_width, frame_height);
+        for (int slot : live_) {
+            pool_[slot].warpHistory(*warp_prev_to_curr, frame_width, frame_height);
+        }
+        for (int slot : dormant_) {
+            pool_[slot].warpHistory(*warp_prev_to_curr, frame_width, frame_height);
         }
     }
     
+    // Lazy ReID: embed only the detections geometry does not settle.
+    const bool lazy = use_reid_ && lazy_embed_ && !detections.empty();
+    std::vector<Detection> embedded;
+    std::vector<char> asked;  // by detection: embedded already
+    if (lazy) {
+        embedded = detections;
+        const std::vector<int> need = lazyReidCandidates(embedded);
+        asked.assign(embedded.size(), 0);
+        for (int d : need) asked[d] = 1;
+        if (!need.empty()) lazy_embed_(embedded, need);
+    }
+    const std::vector<Detection>& dets = lazy ? embedded : detections;
+
     // Associate detections to trackers
-    std::vector<std::pair<int, int>> matched_indices;
-    std::vector<int> unmatched_detections;
-    std::vector<int> unmatched_trackers;
-    associate(detections, matched_indices, unmatched_detections, unmatched_trackers);
+    std::vector<std::pair<int, int>>& matched_indices = scratch_.matched;
+    std::vector<int>& unmatched_detections = scratch_.unmatched_dets;
+    std::vector<int>& unmatched_trackers = scratch_.unmatched_trks;
+    associate(dets, matched_indices, unmatched_detections, unmatched_trackers);
+
+    // Dormant tracks take part from OCR on, after the active ones.
+    const int n_active = static_cast<int>(live_.size());
+    for (size_t k = 0; k < dormant_.size(); ++k) {
+        unmatched_trackers.push_back(n_active + static_cast<int>(k));
+    }
+    live_.insert(live_.end(), dormant_.begin(), dormant_.end());
+    dormant_.clear();
     
     // Update matched trackers
     for (const auto& [d_idx, t_idx] : matched_indices) {
-        auto& tracker = trackers_[t_idx];
-        tracker->update(detections[d_idx]);
+        tracker(t_idx).update(dets[d_idx]);
+    }
+
+    // A settled row (one overlap) the first round did not take after all
+    // goes on to OCR and may start a track, both of which read appearance.
+    if (lazy) {
+        std::vector<int> late;
+        for (int d : unmatched_detections) {
+            if (!asked[d]) late.push_back(d);
+        }
+        if (!late.empty()) lazy_embed_(embedded, late);
+        association_stats_.lazy_late += late.size();
     }
 
     // Second round of association by OCR (observation-centric recovery)
-    std::vector<std::pair<int, int>> ocr_matches;
-    associateOCR(detections, ocr_matches, unmatched_detections, unmatched_trackers);
+    std::vector<std::pair<int, int>>& ocr_matches = scratch_.ocr_matched;
+    associateOCR(dets, ocr_matches, unmatched_detections, unmatched_trackers);
     for (const auto& [d_idx, t_idx] : ocr_matches) {
-        auto& tracker = trackers_[t_idx];
-        tracker->update(detections[d_idx]);
+        tracker(t_idx).update(dets[d_idx]);
+        if (t_idx >= n_active) association_stats_.dormant_recovered++;
     }
 
-    // Explicitly update unmatched trackers with "no observation" (required for ORU)
+    // Explicitly update unmatched trackers with "no observation" (required for ORU),
+    // unless a cue observes them.
     for (int t_idx : unmatched_trackers) {
-        trackers_[t_idx]->update(std::nullopt);
+        KalmanBoxTracker& t = tracker(t_idx);
+        if (cues && !cues->empty()) {
+            const auto cue = std::lower_bound(cues->begin(), cues->end(), t.trackId(),
+                                              [](const TrackCue& c, int id) { return c.track_id < id; });
+            if (cue != cues->end() && cue->track_id == t.trackId()) {
+                t.update(Detection{cue->bbox, cue->score});
+                association_stats_.cue_updates++;
+                continue;
+            }
+        }
+        t.update(std::nullopt);
     }
     
-    // Create new trackers for unmatched detections
+    // Create new trackers for unmatched detections, in slots freed by
+    // aged-out tracks first.
     for (int d_idx : unmatched_detections) {
-        trackers_.push_back(
-            std::make_unique<KalmanBoxTracker>(detections[d_idx], next_id_++, delta_t_));
+        if (!free_slots_.empty()) {
+            const int slot = free_slots_.back();
+            free_slots_.pop_back();
+            pool_[slot].reinit(dets[d_idx], next_id_++, delta_t_, min_reid_quality_);
+            live_.push_back(slot);
+        } else {
+            live_.push_back(static_cast<int>(pool_.size()));
+            pool_.emplace_back(dets[d_idx], next_id_++, delta_t_, min_reid_quality_, &bank_);
+        }
     }
     
-    // Remove old trackers
+    // Remove old trackers; their slots go back to the free list.
     {
-        std::vector<std::unique_ptr<KalmanBoxTracker>> kept;
-        kept.reserve(trackers_.size());
-        for (auto& t : trackers_) {
-            if (t->timeSinceUpdate() > max_age_) {
-                if (t->hasAppearance()) {
-                    finished_appearances_[t->trackId()] = t->appearance();
+        size_t kept = 0;
+        for (int slot : live_) {
+            KalmanBoxTracker& t = pool_[slot];
+            const bool tentative = tentative_max_age_ > 0 && t.hits() < tentative_hits_;
+            if (t.timeSinceUpdate() > (tentative ? std::min(tentative_max_age_, max_age_) : max_age_)) {
+                if (tentative) association_stats_.tentative_retired++;
+                if (t.hasAppearance()) {
+                    appearances_.put(t.trackId(), t.appearance());
                 }
+                t.retire();
+                free_slots_.push_back(slot);
                 continue;
             }
-            kept.push_back(std::move(t));
+            live_[kept++] = slot;
         }
-        trackers_.swap(kept);
+        live_.resize(kept);
     }
+    retier();
     
-    // Return confirmed tracks
-    std::map<int, TrackResult> result;
-    
-    for (const auto& tracker : trackers_) {
+    // Return confirmed tracks (live_ is in creation, i.e. track_id, order)
+    out.clear();
+    for (int slot : live_) {
+        const KalmanBoxTracker& tracker = pool_[slot];
         // Only return confirmed tracks.
         //
         // Note: When `return_all=true` (prediction frames included), using
@@ -148,69 +237,340 @@ std::map<int, TrackResult> OCSort::update(const std::vector<Detection>& detectio
         // mode we instead gate on total hits, which matches typical MOT usage:
         // once confirmed, a track stays confirmed until aged out.
         const bool confirmed =
-            ((return_all ? (tracker->hits() >= min_hits_) : (tracker->hitStreak() >= min_hits_)) ||
+            ((return_all ? (tracker.hits() >= min_hits_) : (tracker.hitStreak() >= min_hits_)) ||
              (frame_count_ <= min_hits_));
         if (!confirmed) continue;
 
         // By default, only return tracks updated this frame
-        if (!return_all && tracker->timeSinceUpdate() >= 1) {
+        if (!return_all && tracker.timeSinceUpdate() >= 1) {
             continue;
         }
         
         // Prefer returning the most recent observation when updated this frame;
         // otherwise return the KF prediction.
-        BBox out_bbox = tracker->getState();
+        BBox out_bbox = tracker.getState();
         float base_conf = 1.0f;
-        if (tracker->lastObservation().has_value()) {
-            base_conf = tracker->lastObservation()->score;
-            if (tracker->timeSinceUpdate() == 0) {
-                out_bbox = tracker->lastObservation()->bbox;
+        const std::optional<BBox> last = tracker.lastObservedBox();
+        if (last.has_value()) {
+            base_conf = tracker.lastObservedScore();
+            if (tracker.timeSinceUpdate() == 0) {
+                out_bbox = *last;
             }
         }
-        if (tracker->timeSinceUpdate() > 0) {
-            base_conf *= std::max(0.0f, 1.0f - 0.05f * static_cast<float>(tracker->timeSinceUpdate()));
+        if (tracker.timeSinceUpdate() > 0) {
+            base_conf *= std::max(0.0f, 1.0f - 0.05f * static_cast<float>(tracker.timeSinceUpdate()));
+        }
+
+        float drift = 0.0f;
+        if (tracker.timeSinceUpdate() > 0 && last.has_value()) {
+            const BBox& obs = *last;
+            const float dx = (out_bbox.centerX() - obs.centerX()) / std::max(obs.width(), 1e-6f);
+            const float dy = (out_bbox.centerY() - obs.centerY()) / std::max(obs.height(), 1e-6f);
+            drift = std::sqrt(dx * dx + dy * dy);
         }
 
-        result[tracker->trackId()] = TrackResult{
+        out.push_back(TrackResult{
+            tracker.trackId(),
             out_bbox,
-            base_conf
-        };
+            base_conf,
+            tracker.timeSinceUpdate(),
+            tracker.covarianceGrowth(),
+            drift
+        });
     }
-    
-    return result;
+}
+
+void OCSort::retier() {
+    if (dormant_after_ <= 0) return;
+    std::vector<int>& active = tier_scratch_;
+    active.clear();
+    for (int slot : live_) {
+        if (pool_[slot].timeSinceUpdate() > dormant_after_) {
+            dormant_.push_back(slot);
+        } else {
+            active.push_back(slot);
+        }
+    }
+    live_.swap(active);
+    auto by_id = [this](int a, int b) { return pool_[a].trackId() < pool_[b].trackId(); };
+    std::sort(live_.begin(), live_.end(), by_id);
+    std::sort(dormant_.begin(), dormant_.end(), by_id);
+}
+
+bool OCSort::isDormant(int track_id) const {
+    const auto it = std::lower_bound(dormant_.begin(), dormant_.end(), track_id,
+                                     [this](int slot, int id) { return pool_[slot].trackId() < id; });
+    return it != dormant_.end() && pool_[*it].trackId() == track_id;
+}
+
+void OCSort::setLazyReid(EmbedFn embed, int refresh_interval) {
+    lazy_embed_ = std::move(embed);
+    lazy_refresh_ = refresh_interval;
+}
+
+std::vector<int> OCSort::lazyReidCandidates(const std::vector<Detection>& detections) {
+    const int n_dets = static_cast<int>(detections.size());
+    const int n_trks = static_cast<int>(live_.size());
+    AssociationScratch& sc = scratch_;
+    sc.det_boxes.clear();
+    for (const Detection& d : detections) sc.det_boxes.push_back(d.bbox);
+    sc.track_boxes.clear();
+    for (int slot : live_) {
+        sc.track_boxes.push_back(pool_[slot].getState());
+    }
+
+    // Overlaps at the gate appearance is allowed to act on (see associate()).
+    const OverlapPairs& pairs = sc.pairs;
+    FindOverlapPairs(sc.det_boxes, sc.track_boxes, iou_thresh_, sc.grid, sc.pairs, motionGate());  // gated counted by associate()
+    std::vector<int>& col_count = sc.col_count;
+    col_count.assign(n_trks, 0);
+    for (int t : pairs.box) col_count[t]++;
+
+    std::vector<int> need;
+    for (int d = 0; d < n_dets; ++d) {
+        if (pairs.begin[d + 1] - pairs.begin[d] != 1) {
+            need.push_back(d);  // new-track candidate or ambiguous row
+            continue;
+        }
+        const int track = pairs.box[pairs.begin[d]];
+        const KalmanBoxTracker& t = tracker(track);
+        const bool stale = lazy_refresh_ > 0 && t.observationsSinceReid() >= lazy_refresh_;
+        if (col_count[track] > 1 || !t.hasAppearance() || stale) need.push_back(d);
+    }
+    return need;
 }
 
 void OCSort::reset() {
-    trackers_.clear();
+    retireAll();
     next_id_ = 0;
-    finished_appearances_.clear();
+    appearances_.clear();
+    first_prices_.clear();
+    ocr_prices_.clear();
+}
+
+void OCSort::endShot() {
+    live_.insert(live_.end(), dormant_.begin(), dormant_.end());
+    dormant_.clear();
+    for (int slot : live_) {
+        const KalmanBoxTracker& t = pool_[slot];
+        if (t.hasAppearance()) {
+            appearances_.put(t.trackId(), t.appearance());
+        }
+    }
+    retireAll();
+}
+
+void OCSort::retireAll() {
+    live_.insert(live_.end(), dormant_.begin(), dormant_.end());
+    dormant_.clear();
+    for (int slot : live_) {
+        pool_[slot].retire();
+        free_slots_.push_back(slot);
+    }
+    live_.clear();
+}
+
+void OCSort::storeActiveAppearances() {
+    for (const std::vector<int>* tier : {&live_, &dormant_}) {
+        for (int slot : *tier) {
+            const KalmanBoxTracker& t = pool_[slot];
+            if (t.hasAppearance()) appearances_.put(t.trackId(), t.appearance());
+        }
+    }
+}
+
+void OCSort::save(CheckpointWriter& w) const {
+    w.put(next_id_);
+    w.put(frame_count_);
+    // Both tiers in one track_id order; load() splits them again.
+    std::vector<int> slots(live_);
+    slots.insert(slots.end(), dormant_.begin(), dormant_.end());
+    std::sort(slots.begin(), slots.end(), [this](int a, int b) { return pool_[a].trackId() < pool_[b].trackId(); });
+    w.put(static_cast<uint32_t>(slots.size()));
+    for (int slot : slots) pool_[slot].save(w);
+    w.put(static_cast<uint32_t>(appearances_.count()));
+    for (int id = 0; id < appearances_.idLimit(); ++id) {
+        const PackedEmbedding* appearance = appearances_.get(id);
+        if (!appearance) continue;
+        w.put(id);
+        PutPackedEmbedding(w, *appearance);
+    }
+    w.putVector(first_prices_);
+    w.putVector(ocr_prices_);
 }
 
-OCSort::AppearanceMap OCSort::takeFinishedAppearances() {
-    AppearanceMap out;
-    out.swap(finished_appearances_);
-    return out;
+bool OCSort::load(CheckpointReader& r) {
+    reset();
+    pool_.clear();
+    free_slots_.clear();
+    r.get(next_id_);
+    r.get(frame_count_);
+    const uint32_t n_tracks = r.get<uint32_t>();
+    if (n_tracks > kMaxCheckpointTracks) r.fail();
+    // Placeholder tracks, overwritten by load(); live_ stays in track ID order.
+    const Detection placeholder{BBox{0.0f, 0.0f, 1.0f, 1.0f}};
+    int prev_id = -1;
+    for (uint32_t i = 0; r.ok() && i < n_tracks; ++i) {
+        live_.push_back(static_cast<int>(pool_.size()));
+        pool_.emplace_back(placeholder, 0, delta_t_, min_reid_quality_, &bank_);
+        if (!pool_.back().load(r) || pool_.back().trackId() <= prev_id || pool_.back().trackId() >= next_id_) {
+            r.fail();
+        }
+        prev_id = pool_.back().trackId();
+    }
+    const uint32_t n_finished = r.get<uint32_t>();
+    for (uint32_t i = 0; r.ok() && i < n_finished; ++i) {
+        const int id = r.get<int>();
+        if (id < 0 || id >= next_id_) r.fail();  // rows are indexed by ID
+        PackedEmbedding appearance = GetPackedEmbedding(r);
+        if (r.ok()) appearances_.put(id, std::move(appearance));
+    }
+    r.getVector(first_prices_);
+    r.getVector(ocr_prices_);
+    if (first_prices_.size() > static_cast<size_t>(next_id_) || ocr_prices_.size() > static_cast<size_t>(next_id_)) {
+        r.fail();  // by track ID
+    }
+    if (!r.ok()) {
+        reset();
+        frame_count_ = 0;
+        return false;
+    }
+    retier();
+    return true;
+}
+
+template <bool kReid>
+float OCSort::scorePairs(const std::vector<Detection>& detections) {
+    AssociationScratch& sc = scratch_;
+    const OverlapPairs& pairs = sc.pairs;
+    const int n_dets = static_cast<int>(detections.size());
+    std::vector<float>& pair_score = sc.pair_score;
+    pair_score.assign(pairs.box.size(), 0.0f);
+    if (kReid) sc.pair_sim.assign(pairs.box.size(), std::numeric_limits<float>::quiet_NaN());
+    // The direction costs of all pairs go to one batch kernel: gather
+    // them as structure-of-arrays first.
+    const size_t n_pairs = pairs.box.size();
+    sc.ocm_dx.resize(n_pairs);
+    sc.ocm_dy.resize(n_pairs);
+    sc.ocm_ix.resize(n_pairs);
+    sc.ocm_iy.resize(n_pairs);
+    sc.ocm_weight.resize(n_pairs);
+    sc.angle_cost.resize(n_pairs);
+    for (int d = 0; d < n_dets; ++d) {
+        const BBox& b = detections[d].bbox;
+        const float cx = (b.x1 + b.x2) / 2.0f;
+        const float cy = (b.y1 + b.y2) / 2.0f;
+        for (int k = pairs.begin[d]; k < pairs.begin[d + 1]; ++k) {
+            const int t = pairs.box[k];
+            sc.ocm_dx[k] = cx - sc.prev_cx[t];
+            sc.ocm_dy[k] = cy - sc.prev_cy[t];
+            sc.ocm_ix[k] = sc.inertia_x[t];
+            sc.ocm_iy[k] = sc.inertia_y[t];
+            // No reference observation: no direction cost.
+            sc.ocm_weight[k] = sc.prev_valid[t] ? detections[d].score : 0.0f;
+        }
+    }
+    OcmAngleCosts(sc.ocm_dx.data(), sc.ocm_dy.data(), sc.ocm_ix.data(), sc.ocm_iy.data(), sc.ocm_weight.data(),
+                  static_cast<int>(n_pairs), inertia_, sc.angle_cost.data());
+
+    float max_combined = -std::numeric_limits<float>::infinity();
+    for (int d = 0; d < n_dets; ++d) {
+        for (int k = pairs.begin[d]; k < pairs.begin[d + 1]; ++k) {
+            const int t = pairs.box[k];
+            const float iou = pairs.iou[k];
+            const float angle_cost = sc.angle_cost[k];
+
+            float total = iou + angle_cost;
+            // Geometry-first: only let appearance influence pairs that already overlap.
+            // This avoids appearance-only "teleport" matches under shaky camera.
+            if (kReid && detections[d].has_reid && tracker(t).hasAppearance()) {
+                const float sim = CosineSimilarity(detections[d].reid, tracker(t).appearance());
+                sc.pair_sim[k] = sim;
+                if (sim >= reid_cos_thresh_) {
+                    const float app_score01 = (sim + 1.0f) * 0.5f;  // [-1,1] -> [0,1]
+                    total += reid_weight_ * app_score01;
+                }
+            }
+
+            pair_score[k] = total;
+            max_combined = std::max(max_combined, total);
+        }
+    }
+    return max_combined;
 }
 
-OCSort::AppearanceMap OCSort::getActiveAppearances() const {
-    AppearanceMap out;
-    for (const auto& t : trackers_) {
-        if (t->hasAppearance()) {
-            out[t->trackId()] = t->appearance();
+template <bool kReid>
+void OCSort::costOcrPairs(const std::vector<Detection>& detections,
+                          const std::vector<int>& unmatched_detections,
+                          const std::vector<int>& unmatched_trackers) {
+    AssociationScratch& sc = scratch_;
+    const OverlapPairs& pairs = sc.pairs;
+    const int n_dets = static_cast<int>(unmatched_detections.size());
+    std::vector<double>& pair_cost = sc.pair_cost;
+    pair_cost.resize(pairs.box.size());
+    for (int di = 0; di < n_dets; ++di) {
+        const Detection& det = detections[unmatched_detections[di]];
+        for (int k = pairs.begin[di]; k < pairs.begin[di + 1]; ++k) {
+            const float iou = pairs.iou[k];
+            float cost = 1.0f - iou;
+            // Geometry-first: only use appearance when overlap already passes IoU gate.
+            if (kReid && iou >= iou_thresh_ && det.has_reid) {
+                const int track = unmatched_trackers[pairs.box[k]];
+                const KalmanBoxTracker& t = tracker(track);
+                if (t.hasAppearance()) {
+                    // The first stage scored this pair too if it also overlapped there.
+                    const int cached = sc.sims_cached ? sc.sim_pairs.find(unmatched_detections[di], track) : -1;
+                    const float sim =
+                        cached >= 0 ? sc.pair_sim[cached] : CosineSimilarity(det.reid, t.appearance());
+                    const float app_cost = 1.0f - (sim + 1.0f) * 0.5f;
+                    if (sim >= reid_cos_thresh_ && app_cost < 1.0f) {
+                        cost = (1.0f - reid_weight_) * cost + reid_weight_ * app_cost;
+                    }
+                }
+            }
+            pair_cost[k] = static_cast<double>(cost);
         }
     }
-    return out;
+}
+
+const MotionGate* OCSort::motionGate() {
+    if (motion_gate_chi2_ <= 0.0f) return nullptr;
+    MotionGate& gate = scratch_.gate;
+    const std::vector<BBox>& boxes = scratch_.track_boxes;
+    const size_t n_trks = boxes.size();
+    gate.chi2 = motion_gate_chi2_;
+    gate.cx.resize(n_trks);
+    gate.cy.resize(n_trks);
+    gate.log_area.resize(n_trks);
+    gate.inv_var_x.resize(n_trks);
+    gate.inv_var_y.resize(n_trks);
+    gate.inv_var_s.resize(n_trks);
+    for (size_t t = 0; t < n_trks; ++t) {
+        const BBox& b = boxes[t];
+        const float w = std::max(b.width(), 1e-6f);
+        const float h = std::max(b.height(), 1e-6f);
+        const float growth = std::max(1.0f, tracker(static_cast<int>(t)).covarianceGrowth());
+        gate.cx[t] = b.centerX();
+        gate.cy[t] = b.centerY();
+        gate.log_area[t] = MotionGate::logArea(b);
+        gate.inv_var_x[t] = 1.0f / (kGateCenterSigma * kGateCenterSigma * w * w * growth);
+        gate.inv_var_y[t] = 1.0f / (kGateCenterSigma * kGateCenterSigma * h * h * growth);
+        gate.inv_var_s[t] = 1.0f / (kGateScaleSigma * kGateScaleSigma * growth);
+    }
+    return &gate;
 }
 
 void OCSort::associate(const std::vector<Detection>& detections,
                        std::vector<std::pair<int, int>>& matched_indices,
                        std::vector<int>& unmatched_detections,
                        std::vector<int>& unmatched_trackers) {
+    FACE_PIPELINE_ZONE("OCSort::associate");
+    scratch_.sims_cached = false;
     matched_indices.clear();
     unmatched_detections.clear();
     unmatched_trackers.clear();
     
-    if (trackers_.empty()) {
+    if (live_.empty()) {
         // All detections are unmatched
         for (int i = 0; i < static_cast<int>(detections.size()); ++i) {
             unmatched_detections.push_back(i);
@@ -220,87 +580,68 @@ void OCSort::associate(const std::vector<Detection>& detections,
     
     if (detections.empty()) {
         // No detections: all trackers are unmatched
-        for (int t = 0; t < static_cast<int>(trackers_.size()); ++t) {
+        for (int t = 0; t < static_cast<int>(live_.size()); ++t) {
             unmatched_trackers.push_back(t);
         }
         return;
     }
     
+    AssociationScratch& sc = scratch_;
+
     // Get predicted states for all trackers
-    std::vector<BBox> predicted_bboxes;
-    predicted_bboxes.reserve(trackers_.size());
-    for (const auto& tracker : trackers_) {
-        predicted_bboxes.push_back(tracker->getState());
+    sc.track_boxes.clear();
+    for (int slot : live_) {
+        sc.track_boxes.push_back(pool_[slot].getState());
+    }
+
+    // OCM reference observations, once per track (each is a history read).
+    sc.prev_cx.clear();
+    sc.prev_cy.clear();
+    sc.prev_valid.clear();
+    sc.inertia_x.clear();
+    sc.inertia_y.clear();
+    for (int slot : live_) {
+        const std::optional<BBox> prev = pool_[slot].kPreviousObservedBox(delta_t_);
+        const BBox b = prev.value_or(BBox{-1.0f, -1.0f, -1.0f, -1.0f});
+        sc.prev_cx.push_back((b.x1 + b.x2) / 2.0f);
+        sc.prev_cy.push_back((b.y1 + b.y2) / 2.0f);
+        sc.prev_valid.push_back(prev.has_value());
+        const auto inertia = pool_[slot].velocityDir();  // (dy, dx)
+        sc.inertia_x.push_back(inertia[1]);
+        sc.inertia_y.push_back(inertia[0]);
     }
     
-    // Build IoU matrix and OCM (velocity-direction consistency) augmentation
     int n_dets = static_cast<int>(detections.size());
-    int n_trks = static_cast<int>(trackers_.size());
-    
-    std::vector<std::vector<float>> iou_matrix(n_dets, std::vector<float>(n_trks, 0.0f));
-    std::vector<std::vector<float>> score_matrix(n_dets, std::vector<float>(n_trks, 0.0f));
-    std::vector<std::vector<float>> reid_sim_matrix(n_dets, std::vector<float>(n_trks, -1.0f));
-    std::vector<std::vector<bool>> reid_valid(n_dets, std::vector<bool>(n_trks, false));
-
-    float max_combined = -std::numeric_limits<float>::infinity();
-    for (int d = 0; d < n_dets; ++d) {
-        for (int t = 0; t < n_trks; ++t) {
-            const float iou = detections[d].bbox.iou(predicted_bboxes[t]);
-            iou_matrix[d][t] = iou;
-
-            const Detection prev_obs = trackers_[t]->kPreviousObservation(delta_t_);
-            const bool valid_prev = prev_obs.score >= 0.0f;
-            const auto inertia = trackers_[t]->velocityDir();  // (dy, dx)
-            const auto dir = speed_direction(prev_obs.bbox, detections[d].bbox);  // (dy, dx)
-
-            float angle_cost = 0.0f;
-            if (valid_prev) {
-                const float inertia_Y = inertia[0];
-                const float inertia_X = inertia[1];
-                const float Y = dir[0];
-                const float X = dir[1];
-                const float cosv = clampf(inertia_X * X + inertia_Y * Y, -1.0f, 1.0f);
-                const float angle = std::acos(cosv);
-                const float diff = (kPi / 2.0f - std::abs(angle)) / kPi;
-                angle_cost = diff * inertia_ * detections[d].score;
-            }
+    int n_trks = static_cast<int>(live_.size());
 
-            const float combined = iou + angle_cost;
-            float reid_bonus = 0.0f;
-            // Geometry-first: only let appearance influence pairs that already overlap.
-            // This avoids appearance-only "teleport" matches under shaky camera.
-            if (iou >= iou_thresh_ &&
-                use_reid_ && detections[d].has_reid && trackers_[t]->hasAppearance()) {
-                const float sim = cosine_sim(detections[d].reid, trackers_[t]->appearance());
-                reid_sim_matrix[d][t] = sim;
-                reid_valid[d][t] = true;
-                if (sim >= reid_cos_thresh_) {
-                    const float app_score01 = (sim + 1.0f) * 0.5f;  // [-1,1] -> [0,1]
-                    reid_bonus = reid_weight_ * app_score01;
-                }
-            }
+    // Pairs below the IoU gate can never match and all cost the same, so
+    // only the pairs at the gate are scored (a sparse score list). The grid
+    // keeps the search to predicted boxes near each detection.
+    sc.det_boxes.clear();
+    for (const Detection& d : detections) sc.det_boxes.push_back(d.bbox);
+    // The motion gate drops implausible pairs before their IoU.
+    FindOverlapPairs(sc.det_boxes, sc.track_boxes, iou_thresh_, sc.grid, sc.pairs, motionGate());
+    association_stats_.motion_gated += sc.pairs.gated;
+    const OverlapPairs& pairs = sc.pairs;
 
-            // Hard-gate invalid geometry in the assignment cost.
-            const float total = (iou >= iou_thresh_) ? (combined + reid_bonus) : -1e6f;
-            score_matrix[d][t] = total;
-            if (iou >= iou_thresh_) {
-                max_combined = std::max(max_combined, total);
-            }
-        }
-    }
+    const float max_combined = use_reid_ ? scorePairs<true>(detections) : scorePairs<false>(detections);
+    scratch_.sims_cached = use_reid_;
 
-    std::vector<int> assignment(n_dets, -1);
+    std::vector<int>& assignment = sc.assignment;
+    assignment.assign(n_dets, -1);
 
     // Fast-path: unique 1-1 matching above IoU threshold (when not using ReID).
-    if (!use_reid_) {
-        bool use_fast_path = true;
-        std::vector<int> row_sum(n_dets, 0);
-        std::vector<int> col_sum(n_trks, 0);
+    bool use_fast_path = !use_reid_;
+    if (use_fast_path) {
+        std::vector<int>& row_sum = sc.row_count;
+        std::vector<int>& col_sum = sc.col_count;
+        row_sum.assign(n_dets, 0);
+        col_sum.assign(n_trks, 0);
         for (int d = 0; d < n_dets; ++d) {
-            for (int t = 0; t < n_trks; ++t) {
-                if (iou_matrix[d][t] > iou_thresh_) {
+            for (int k = pairs.begin[d]; k < pairs.begin[d + 1]; ++k) {
+                if (pairs.iou[k] > iou_thresh_) {
                     row_sum[d] += 1;
-                    col_sum[t] += 1;
+                    col_sum[pairs.box[k]] += 1;
                 }
             }
             if (row_sum[d] > 1) use_fast_path = false;
@@ -308,49 +649,47 @@ void OCSort::associate(const std::vector<Detection>& detections,
         for (int t = 0; t < n_trks; ++t) {
             if (col_sum[t] > 1) use_fast_path = false;
         }
+    }
 
-        if (use_fast_path) {
-            for (int d = 0; d < n_dets; ++d) {
-                for (int t = 0; t < n_trks; ++t) {
-                    if (iou_matrix[d][t] > iou_thresh_) {
-                        assignment[d] = t;
-                        break;
-                    }
-                }
-            }
-        } else {
-            std::vector<std::vector<double>> cost_matrix(n_dets, std::vector<double>(n_trks, 0.0));
-            const float shift = std::isfinite(max_combined) ? max_combined : 0.0f;
-            for (int d = 0; d < n_dets; ++d) {
-                for (int t = 0; t < n_trks; ++t) {
-                    cost_matrix[d][t] = static_cast<double>(shift - score_matrix[d][t]);  // minimize
+    association_stats_.associations++;
+    if (use_fast_path) {
+        association_stats_.fast_path++;
+        for (int d = 0; d < n_dets; ++d) {
+            for (int k = pairs.begin[d]; k < pairs.begin[d + 1]; ++k) {
+                if (pairs.iou[k] > iou_thresh_) {
+                    assignment[d] = pairs.box[k];
+                    break;
                 }
             }
-            hungarian_.solve(cost_matrix, assignment);
         }
     } else {
-        std::vector<std::vector<double>> cost_matrix(n_dets, std::vector<double>(n_trks, 0.0));
+        // Hard-gate invalid geometry: pairs below the gate are not listed,
+        // and leaving a detection unmatched costs what a gated pair would.
         const float shift = std::isfinite(max_combined) ? max_combined : 0.0f;
-        for (int d = 0; d < n_dets; ++d) {
-            for (int t = 0; t < n_trks; ++t) {
-                cost_matrix[d][t] = static_cast<double>(shift - score_matrix[d][t]);  // minimize
-            }
+        std::vector<double>& cost = sc.pair_cost;
+        cost.resize(pairs.box.size());
+        for (size_t k = 0; k < pairs.box.size(); ++k) {
+            cost[k] = static_cast<double>(shift - sc.pair_score[k]);  // minimize
         }
-        hungarian_.solve(cost_matrix, assignment);
+        sc.col_track.clear();
+        for (int slot : live_) sc.col_track.push_back(pool_[slot].trackId());
+        solveGated(n_dets, n_trks, pairs, cost, static_cast<double>(shift - kGatedScore), assignment,
+                   warm_assignment_ ? &first_prices_ : nullptr);
     }
 
-    std::vector<bool> det_matched(n_dets, false);
-    std::vector<bool> trk_matched(n_trks, false);
+    std::vector<char>& det_matched = sc.det_used;
+    std::vector<char>& trk_matched = sc.trk_used;
+    det_matched.assign(n_dets, 0);
+    trk_matched.assign(n_trks, 0);
 
     for (int d = 0; d < n_dets; ++d) {
         const int t = assignment[d];
         if (t < 0) continue;
-        const float iou = iou_matrix[d][t];
-        const bool iou_ok = (iou >= iou_thresh_);
-        if (iou_ok) {
+        // Only listed pairs, i.e. those at the IoU gate, are ever assigned.
+        if (pairs.find(d, t) >= 0) {
             matched_indices.emplace_back(d, t);
-            det_matched[d] = true;
-            trk_matched[t] = true;
+            det_matched[d] = 1;
+            trk_matched[t] = 1;
             continue;
         }
     }
@@ -367,87 +706,263 @@ void OCSort::associateOCR(const std::vector<Detection>& detections,
                           std::vector<std::pair<int, int>>& matched_indices,
                           std::vector<int>& unmatched_detections,
                           std::vector<int>& unmatched_trackers) {
+    FACE_PIPELINE_ZONE("OCSort::associateOCR");
     matched_indices.clear();
     if (unmatched_detections.empty() || unmatched_trackers.empty()) return;
     if (detections.empty()) return;
 
     const int n_dets = static_cast<int>(unmatched_detections.size());
     const int n_trks = static_cast<int>(unmatched_trackers.size());
-    std::vector<std::vector<double>> cost_matrix(n_dets, std::vector<double>(n_trks, 1.0));
-    std::vector<std::vector<float>> iou_matrix(n_dets, std::vector<float>(n_trks, 0.0f));
-    std::vector<std::vector<float>> reid_sim_matrix(n_dets, std::vector<float>(n_trks, -1.0f));
-    std::vector<std::vector<bool>> reid_valid(n_dets, std::vector<bool>(n_trks, false));
-
-    float max_iou = 0.0f;
-    for (int di = 0; di < n_dets; ++di) {
-        const int d_idx = unmatched_detections[di];
-        for (int ti = 0; ti < n_trks; ++ti) {
-            const int t_idx = unmatched_trackers[ti];
-            const auto& last = trackers_[t_idx]->lastObservation();
-            float iou = 0.0f;
-            if (last.has_value() && last->score >= 0.0f) {
-                iou = detections[d_idx].bbox.iou(last->bbox);
-            }
-            iou_matrix[di][ti] = iou;
-            max_iou = std::max(max_iou, iou);
 
-            if (use_reid_ && detections[d_idx].has_reid && trackers_[t_idx]->hasAppearance()) {
-                const float sim = cosine_sim(detections[d_idx].reid, trackers_[t_idx]->appearance());
-                reid_sim_matrix[di][ti] = sim;
-                reid_valid[di][ti] = true;
-            }
-        }
+    // Last observations, once per track (each is a history read). A track
+    // without one gets a NaN box: it overlaps nothing and its IoU is 0.
+    AssociationScratch& sc = scratch_;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    std::vector<BBox>& last_boxes = sc.track_boxes;
+    last_boxes.assign(n_trks, BBox{nan, nan, nan, nan});
+    for (int ti = 0; ti < n_trks; ++ti) {
+        const KalmanBoxTracker& t = tracker(unmatched_trackers[ti]);
+        if (t.lastObservedScore() < 0.0f) continue;
+        if (const std::optional<BBox> last = t.lastObservedBox()) last_boxes[ti] = *last;
     }
+    sc.det_boxes.clear();
+    for (int d_idx : unmatched_detections) sc.det_boxes.push_back(detections[d_idx].bbox);
+    // The first stage's pairs index its similarities; this pass lists its own.
+    if (sc.sims_cached) std::swap(sc.sim_pairs, sc.pairs);
+
+    // Every overlap lowers the cost below the 1.0 of a disjoint pair, even
+    // under the gate, so all overlapping pairs are listed, not only gated ones.
+    const float min_iou = std::min(iou_thresh_, std::numeric_limits<float>::denorm_min());
+    FindOverlapPairs(sc.det_boxes, last_boxes, min_iou, sc.grid, sc.pairs);
+    const OverlapPairs& pairs = sc.pairs;
 
+    float max_iou = 0.0f;
+    for (float iou : pairs.iou) max_iou = std::max(max_iou, iou);
     if (!use_reid_ && max_iou <= iou_thresh_) {
         return;
     }
 
-    for (int di = 0; di < n_dets; ++di) {
-        for (int ti = 0; ti < n_trks; ++ti) {
-            const float iou_cost = 1.0f - iou_matrix[di][ti];
-            float app_cost = 1.0f;
-            if (use_reid_ && reid_valid[di][ti] && reid_sim_matrix[di][ti] >= reid_cos_thresh_) {
-                const float app_score01 = (reid_sim_matrix[di][ti] + 1.0f) * 0.5f;
-                app_cost = 1.0f - app_score01;
-            }
-            // Geometry-first: only use appearance when overlap already passes IoU gate.
-            const float w = (use_reid_ && iou_matrix[di][ti] >= iou_thresh_ && app_cost < 1.0f) ? reid_weight_ : 0.0f;
-            const float cost = (1.0f - w) * iou_cost + w * app_cost;
-            cost_matrix[di][ti] = static_cast<double>(cost);
-        }
+    if (use_reid_) {
+        costOcrPairs<true>(detections, unmatched_detections, unmatched_trackers);
+    } else {
+        costOcrPairs<false>(detections, unmatched_detections, unmatched_trackers);
     }
 
-    std::vector<int> assignment(n_dets, -1);
-    hungarian_.solve(cost_matrix, assignment);
+    // A disjoint pair costs 1.0, so a detection goes unmatched at just over
+    // that: a listed pair costing exactly 1.0 is still taken, as in a dense
+    // matrix holding 1.0 everywhere else.
+    std::vector<int>& assignment = sc.assignment;
+    sc.col_track.clear();
+    for (int t_idx : unmatched_trackers) sc.col_track.push_back(tracker(t_idx).trackId());
+    solveGated(n_dets, n_trks, pairs, sc.pair_cost, std::nextafter(1.0, 2.0), assignment,
+               warm_assignment_ ? &ocr_prices_ : nullptr);
 
-    std::vector<bool> det_used(n_dets, false);
-    std::vector<bool> trk_used(n_trks, false);
+    std::vector<char>& det_used = sc.det_used;
+    std::vector<char>& trk_used = sc.trk_used;
+    det_used.assign(n_dets, 0);
+    trk_used.assign(n_trks, 0);
 
     for (int di = 0; di < n_dets; ++di) {
         const int ti = assignment[di];
         if (ti < 0) continue;
-        const bool iou_ok = (iou_matrix[di][ti] >= iou_thresh_);
+        const int k = pairs.find(di, ti);
+        const bool iou_ok = (k >= 0 ? pairs.iou[k] : 0.0f) >= iou_thresh_;
         if (iou_ok) {
-            det_used[di] = true;
-            trk_used[ti] = true;
+            det_used[di] = 1;
+            trk_used[ti] = 1;
             matched_indices.emplace_back(unmatched_detections[di], unmatched_trackers[ti]);
             continue;
         }
     }
 
     // Remove matched entries from unmatched lists
-    std::vector<int> new_unmatched_dets;
-    new_unmatched_dets.reserve(unmatched_detections.size());
+    std::vector<int>& kept = sc.kept;
+    kept.clear();
     for (int di = 0; di < n_dets; ++di) {
-        if (!det_used[di]) new_unmatched_dets.push_back(unmatched_detections[di]);
+        if (!det_used[di]) kept.push_back(unmatched_detections[di]);
     }
-    unmatched_detections.swap(new_unmatched_dets);
+    unmatched_detections.swap(kept);
 
-    std::vector<int> new_unmatched_trks;
-    new_unmatched_trks.reserve(unmatched_trackers.size());
+    kept.clear();
     for (int ti = 0; ti < n_trks; ++ti) {
-        if (!trk_used[ti]) new_unmatched_trks.push_back(unmatched_trackers[ti]);
+        if (!trk_used[ti]) kept.push_back(unmatched_trackers[ti]);
+    }
+    unmatched_trackers.swap(kept);
+}
+
+void OCSort::solveGated(int n_rows,
+                        int n_cols,
+                        const OverlapPairs& pairs,
+                        const std::vector<double>& cost,
+                        double cost_limit,
+                        std::vector<int>& assignment,
+                        std::vector<double>* prices) {
+    AssociationScratch& sc = scratch_;
+    assignment.assign(n_rows, -1);
+    association_stats_.gated_solves++;
+    if (prices) prices->resize(static_cast<size_t>(next_id_), 0.0);
+    // Columns no solved component holds leave this solve unpriced.
+    auto unprice_unsolved = [&](const std::vector<int>& solved_comps) {
+        if (!prices) return;
+        sc.col_solved.assign(n_cols, 0);
+        for (int c : solved_comps) {
+            for (int k = sc.comp_cols[c]; k < sc.comp_cols[c + 1]; ++k) sc.col_solved[sc.cols_of[k]] = 1;
+        }
+        for (int j = 0; j < n_cols; ++j) {
+            if (!sc.col_solved[j]) (*prices)[sc.col_track[j]] = 0.0;
+        }
+    };
+
+    // Union-find over rows (0 .. n_rows - 1) and columns (n_rows + col),
+    // joined by every pair worth assigning.
+    std::vector<int>& parent = sc.parent;
+    parent.resize(static_cast<size_t>(n_rows + n_cols));
+    for (size_t v = 0; v < parent.size(); ++v) parent[v] = static_cast<int>(v);
+    auto root = [&parent](int v) {
+        while (parent[v] != v) {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    };
+    for (int r = 0; r < n_rows; ++r) {
+        for (int k = pairs.begin[r]; k < pairs.begin[r + 1]; ++k) {
+            if (!(cost[k] < cost_limit)) continue;
+            const int a = root(r), b = root(n_rows + pairs.box[k]);
+            if (a != b) parent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+
+    // Components numbered by their first row; rows with no usable pair
+    // belong to none and stay unassigned.
+    std::vector<int>& comp_of = sc.comp_of;  // per union-find root
+    comp_of.assign(parent.size(), -1);
+    std::vector<int>& row_comp = sc.row_comp;
+    row_comp.assign(n_rows, -1);
+    int n_comps = 0;
+    for (int r = 0; r < n_rows; ++r) {
+        bool usable = false;
+        for (int k = pairs.begin[r]; k < pairs.begin[r + 1] && !usable; ++k) usable = cost[k] < cost_limit;
+        if (!usable) continue;
+        int& c = comp_of[root(r)];
+        if (c < 0) c = n_comps++;
+        row_comp[r] = c;
+    }
+    if (n_comps == 0) {
+        unprice_unsolved({});
+        return;
+    }
+
+    // Rows grouped by component, then each component's pairs renumbered
+    // to local columns in one compressed-row list (see solveSparse()).
+    std::vector<int>& comp_rows = sc.comp_rows;  // component c: rows_of[comp_rows[c] .. comp_rows[c + 1])
+    comp_rows.assign(static_cast<size_t>(n_comps) + 1, 0);
+    for (int r = 0; r < n_rows; ++r) {
+        if (row_comp[r] >= 0) comp_rows[row_comp[r] + 1]++;
+    }
+    for (int c = 0; c < n_comps; ++c) comp_rows[c + 1] += comp_rows[c];
+    std::vector<int>& rows_of = sc.rows_of;
+    rows_of.resize(static_cast<size_t>(comp_rows[n_comps]));
+    std::vector<int>& cursor = sc.kept;
+    cursor.assign(comp_rows.begin(), comp_rows.end() - 1);
+    for (int r = 0; r < n_rows; ++r) {
+        if (row_comp[r] >= 0) rows_of[cursor[row_comp[r]]++] = r;
+    }
+
+    std::vector<int>& local_col = sc.local_col;
+    local_col.assign(n_cols, -1);
+    std::vector<int>& comp_cols = sc.comp_cols;  // component c: cols_of[comp_cols[c] .. comp_cols[c + 1])
+    std::vector<int>& cols_of = sc.cols_of;
+    std::vector<int>& sub_begin = sc.sub_begin;
+    std::vector<int>& sub_col = sc.sub_col;
+    std::vector<double>& sub_cost = sc.sub_cost;
+    comp_cols.assign(1, 0);
+    cols_of.clear();
+    sub_begin.assign(1, 0);
+    sub_col.clear();
+    sub_cost.clear();
+    for (int c = 0; c < n_comps; ++c) {
+        const int first_col = static_cast<int>(cols_of.size());
+        for (int i = comp_rows[c]; i < comp_rows[c + 1]; ++i) {
+            const int r = rows_of[i];
+            for (int k = pairs.begin[r]; k < pairs.begin[r + 1]; ++k) {
+                if (!(cost[k] < cost_limit)) continue;
+                int& lc = local_col[pairs.box[k]];
+                if (lc < 0) {
+                    lc = static_cast<int>(cols_of.size()) - first_col;
+                    cols_of.push_back(pairs.box[k]);
+                }
+                sub_col.push_back(lc);
+                sub_cost.push_back(cost[k]);
+            }
+            sub_begin.push_back(static_cast<int>(sub_col.size()));
+        }
+        comp_cols.push_back(static_cast<int>(cols_of.size()));
+    }
+
+    // A 1x1 component is its own answer; the rest are solved one by one.
+    std::vector<int>& ambiguous = sc.ambiguous;
+    ambiguous.clear();
+    size_t ambiguous_pairs = 0;
+    for (int c = 0; c < n_comps; ++c) {
+        if (comp_rows[c + 1] - comp_rows[c] == 1 && comp_cols[c + 1] - comp_cols[c] == 1) {
+            assignment[rows_of[comp_rows[c]]] = cols_of[comp_cols[c]];
+            association_stats_.trivial_components++;
+            continue;
+        }
+        ambiguous.push_back(c);
+        association_stats_.largest_component = std::max(association_stats_.largest_component, comp_rows[c + 1] - comp_rows[c]);
+        ambiguous_pairs += static_cast<size_t>(sub_begin[comp_rows[c + 1]] - sub_begin[comp_rows[c]]);
+    }
+    unprice_unsolved(ambiguous);
+    if (ambiguous.empty()) return;
+
+    // Components share no row or column, so they solve independently; a
+    // thread pays off only for large crowds.
+    const bool parallel = ambiguous.size() > 1 && ambiguous_pairs >= kParallelAssignmentPairs;
+    const size_t n_solvers = parallel ? ambiguous.size() : 1;
+    association_stats_.solved_components += static_cast<int64_t>(ambiguous.size());
+    if (parallel) association_stats_.parallel_solves++;
+    if (sc.solvers.size() < n_solvers) sc.solvers.resize(n_solvers);
+    sc.reaugmented.assign(ambiguous.size(), 0);
+    sc.seeded.assign(ambiguous.size(), 0);
+    auto solve = [&](int a, ComponentSolver& slot) {
+        const int c = ambiguous[a];
+        const int n_comp_rows = comp_rows[c + 1] - comp_rows[c];
+        const int n_comp_cols = comp_cols[c + 1] - comp_cols[c];
+        // Components share no column, so no two write the same price.
+        double* col_prices = nullptr;
+        if (prices) {
+            slot.prices.resize(static_cast<size_t>(n_comp_cols));
+            for (int lc = 0; lc < n_comp_cols; ++lc) {
+                slot.prices[lc] = (*prices)[sc.col_track[cols_of[comp_cols[c] + lc]]];
+            }
+            col_prices = slot.prices.data();
+        }
+        slot.solver.solveSparse(n_comp_rows, n_comp_cols, sub_begin.data() + comp_rows[c], sub_col.data(),
+                                sub_cost.data(), cost_limit, slot.assignment, col_prices);
+        if (prices) {
+            for (int lc = 0; lc < n_comp_cols; ++lc) {
+                (*prices)[sc.col_track[cols_of[comp_cols[c] + lc]]] = slot.prices[lc];
+            }
+        }
+        sc.reaugmented[static_cast<size_t>(a)] = slot.solver.lastReaugmented();
+        sc.seeded[static_cast<size_t>(a)] = slot.solver.lastSeeded();
+        for (int i = 0; i < n_comp_rows; ++i) {
+            const int lc = slot.assignment[i];
+            if (lc >= 0) assignment[rows_of[comp_rows[c] + i]] = cols_of[comp_cols[c] + lc];
+        }
+    };
+    if (parallel) {
+        ThreadPool::Shared().parallelFor(static_cast<int>(ambiguous.size()), PipelineCoreCount(),
+                                         [&](int a) { solve(a, sc.solvers[static_cast<size_t>(a)]); });
+    } else {
+        for (int a = 0; a < static_cast<int>(ambiguous.size()); ++a) solve(a, sc.solvers[0]);
+    }
+    for (size_t a = 0; a < ambiguous.size(); ++a) {
+        const int c = ambiguous[a];
+        association_stats_.solved_rows += comp_rows[c + 1] - comp_rows[c];
+        association_stats_.reaugmented_rows += sc.reaugmented[a];
+        association_stats_.seeded_rows += sc.seeded[a];
     }
-    unmatched_trackers.swap(new_unmatched_trks);
 }
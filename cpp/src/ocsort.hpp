@@ -1,18 +1,35 @@
 #pragma once
 
+#include "appearance_table.hpp"
+#include "box_grid.hpp"
 #include "kalman_filter.hpp"
-#include "hungarian.hpp"
+#include "lapjv.hpp"
 
+#include <cstdint>
+#include <functional>
 #include <map>
-#include <memory>
 #include <vector>
 
 /**
  * Result for a single tracked object.
  */
 struct TrackResult {
+    int track_id = -1;
     BBox bbox;
     float confidence;
+    int time_since_update = 0;
+    float covariance_growth = 1.0f;  // see KalmanBoxTracker::covarianceGrowth()
+    float drift = 0.0f;              // predicted center travel since the last observation, in box sizes
+};
+
+/**
+ * An observation of a known track from outside detection, e.g. its
+ * landmarks followed by optical flow (see OCSort::update).
+ */
+struct TrackCue {
+    int track_id = -1;
+    BBox bbox;
+    float score = 0.0f;
 };
 
 /**
@@ -20,16 +37,17 @@ struct TrackResult {
  * 
  * Implements OC-SORT (Cao et al., CVPR 2023) with:
  * - Kalman filter motion prediction
- * - Hungarian algorithm for optimal assignment
+ * - Sparse linear assignment (Jonker-Volgenant) over IoU-gated pairs
  * - Observation-Centric Re-Update (ORU) for occlusion recovery
  * - Observation-Centric Momentum (OCM) in association cost
  * - Observation-Centric Recovery (OCR) second-pass association
  * 
  * Usage:
  *   OCSort tracker(0.3f, 30, 3);
+ *   std::vector<TrackResult> tracks;
  *   for each frame:
- *     auto tracks = tracker.update(detections);
- *     // tracks[track_id] = {bbox, confidence}
+ *     tracker.update(detections, tracks);
+ *     // tracks: {track_id, bbox, confidence, ...} by ascending track_id
  */
 class OCSort {
 public:
@@ -66,21 +84,193 @@ public:
                                        const Mat3f* warp_prev_to_curr = nullptr,
                                        int frame_width = 0,
                                        int frame_height = 0);
+
+    /**
+     * Same as above, writing the confirmed tracks into `out` (cleared
+     * first) by ascending track_id. Reusing one vector across frames makes
+     * this allocation-free once it has grown to the largest frame.
+     *
+     * `cues` (by ascending track_id) observe the tracks no detection
+     * matched, in place of the "no observation" update; they take no part
+     * in association and start no tracks.
+     */
+    void update(const std::vector<Detection>& detections,
+                std::vector<TrackResult>& out,
+                bool return_all = false,
+                const Mat3f* warp_prev_to_curr = nullptr,
+                int frame_width = 0,
+                int frame_height = 0,
+                const std::vector<TrackCue>* cues = nullptr);
     
+    /**
+     * Computes embeddings in place for detections[indices] (has_reid,
+     * reid, reid_quality).
+     */
+    using EmbedFn = std::function<void(std::vector<Detection>& detections, const std::vector<int>& indices)>;
+
+    /**
+     * Lazy ReID: update() receives detections without embeddings and asks
+     * `embed` only for those geometry does not settle. These are:
+     *   - detections overlapping no predicted track (new-track candidates);
+     *   - detections in an ambiguous row or column (several overlaps at the
+     *     IoU gate);
+     *   - detections whose only track has no appearance yet, or has gone
+     *     `refresh_interval` observations without one (0 = never refresh);
+     *   - after the first round, any other detection it left unmatched:
+     *     these go on to OCR (dormant tracks included) or start tracks,
+     *     which read their appearance.
+     * A 1-to-1 overlap is matched the same with or without appearance, so
+     * association is unchanged; only the appearance banks update less often.
+     * Offline linking reads those banks, so linked tracks can differ.
+     * Has no effect unless ReID is enabled. An empty `embed` turns it off.
+     */
+    void setLazyReid(EmbedFn embed, int refresh_interval);
+
+    /**
+     * Quality a ReID sample needs to enter a track's appearance bank
+     * (applies to tracks created afterwards; default 0.40).
+     */
+    void setMinReidQuality(float quality) { min_reid_quality_ = quality; }
+
+    /**
+     * Format of the appearances kept for offline linking (default F32).
+     * Finished tracks accumulate for the whole job, so F16/Int8 bound
+     * that memory on long footage.
+     */
+    void setAppearanceStorage(EmbeddingStorage storage) { appearances_.setStorage(storage); }
+
+    /**
+     * Tentative tracks: a track with fewer than `hits` observations is
+     * retired once it has gone `max_age` frames without one, instead of the
+     * tracker's max_age. A one-off false positive then stops coasting,
+     * being associated, warped and reported after a few frames. Its
+     * appearance still goes to appearances(). 0 = off.
+     */
+    void setTentative(int hits, int max_age) {
+        tentative_hits_ = hits;
+        tentative_max_age_ = max_age;
+    }
+
+    /**
+     * Dormant tracks: a track that has gone `frames` frames without an
+     * observation leaves the first association stage and the output.
+     * OCR still matches detections to its last observation, with ReID
+     * when on, and a match brings it back. Until it ages out it costs one
+     * predict and one pending-warp product per frame. Association then
+     * scales with the faces in view, not with those that recently left.
+     * 0 = off.
+     */
+    void setDormantAfter(int frames) { dormant_after_ = frames; }
+
+    /**
+     * Motion gate: the first association stage (and lazy ReID's choice of
+     * detections to embed) drops the grid's candidate pairs whose
+     * Mahalanobis distance on center and log area exceeds `chi2` (3 degrees
+     * of freedom: 7.81 passes 95% of plausible matches, 11.34 99%), before
+     * their IoU, OCM and appearance terms are computed (FindOverlapPairs
+     * with a MotionGate). The innovation covariance is set
+     * once per track per frame: diagonal, in units of the predicted box
+     * (0.1 box sizes of center, 0.2 of log area), times the track's
+     * covarianceGrowth(). The filter runs in normalized coordinates on
+     * OC-SORT's pixel-tuned unit noise, so P's absolute values bound
+     * nothing there, but its growth since the last observation does follow
+     * coasting and an unsettled velocity. A track fresh from an update then
+     * cannot take a detection a third of a box away, while a coasting or
+     * new one keeps the IoU gate. Dense crowds have fewer ambiguous pairs
+     * to score and solve. 0 = off.
+     */
+    void setMotionGate(float chi2) { motion_gate_chi2_ = chi2; }
+
+    /**
+     * Warm-started assignment (on by default): each stage's solver starts
+     * from the column prices its tracks had in the previous frame's solve
+     * (LapjvSolver::solveSparse), so rows that keep their track need no
+     * augmenting search. Assignments are optimal either way; off solves
+     * every frame from scratch, for comparison.
+     */
+    void setWarmAssignment(bool on) { warm_assignment_ = on; }
+
+    /** Whether track `track_id` is dormant (setDormantAfter): alive, but in no update() output. */
+    bool isDormant(int track_id) const;
+
+    /** Joseph-form Kalman covariance updates (see KalmanStateBank::setJosephForm). */
+    void setJosephUpdate(bool on) { bank_.setJosephForm(on); }
+
     /**
      * Reset tracker state (call at scene boundaries).
      */
     void reset();
+
+    /**
+     * Retire every track at a shot boundary.
+     *
+     * Unlike reset(), track IDs keep counting and the retired appearances
+     * stay in appearances(), so offline linking can
+     * still join a face that reappears in a later shot.
+     */
+    void endShot();
     
     /**
-     * Get current number of active trackers.
+     * Get current number of active trackers (dormant ones not counted).
+     */
+    size_t numTrackers() const { return live_.size(); }
+
+    /**
+     * No track at all, live or dormant: an update without detections would
+     * change nothing but the frame count.
+     */
+    bool idle() const { return live_.empty() && dormant_.empty(); }
+
+    /**
+     * Count a frame an idle tracker is not updated on (see idle()).
      */
-    size_t numTrackers() const { return trackers_.size(); }
+    void skipIdleFrame() { frame_count_++; }
 
-    // Appearance summaries for offline tracklet linking.
-    using AppearanceMap = std::map<int, std::array<float, Detection::kReidDim>>;
-    AppearanceMap takeFinishedAppearances();     // drains
-    AppearanceMap getActiveAppearances() const;  // snapshot
+    /**
+     * Track IDs handed out so far (IDs are 0 ... tracksStarted() - 1).
+     */
+    int tracksStarted() const { return next_id_; }
+
+    /** How association went, over every update since construction. */
+    struct AssociationStats {
+        int64_t associations = 0;       // first-stage matchings of detections to live tracks
+        int64_t fast_path = 0;          // of them, settled by the unique-overlap fast path
+        int64_t gated_solves = 0;       // gated assignment problems (first stage and OCR)
+        int64_t trivial_components = 0; // their 1x1 components, assigned directly
+        int64_t solved_components = 0;  // components that went to the solver
+        int64_t parallel_solves = 0;    // problems whose components were solved on the pool
+        int64_t solved_rows = 0;        // rows of the solved components
+        int64_t reaugmented_rows = 0;   // of them, displaced another row's assignment (LapjvSolver::lastReaugmented)
+        int64_t seeded_rows = 0;        // of them, settled by the warm start without a search (LapjvSolver::lastSeeded)
+        int largest_component = 0;      // rows of the largest solved component
+        int64_t tentative_retired = 0;  // tracks retired while still tentative (setTentative)
+        int64_t dormant_recovered = 0;  // dormant tracks OCR matched again (setDormantAfter)
+        int64_t motion_gated = 0;       // candidate pairs the motion gate dropped before their IoU (setMotionGate)
+        int64_t cue_updates = 0;        // unmatched tracks observed by a TrackCue instead
+        int64_t lazy_late = 0;          // lazy ReID: settled detections embedded after all, left for OCR
+    };
+    const AssociationStats& associationStats() const { return association_stats_; }
+
+    /**
+     * Appearance summaries for offline tracklet linking, by track ID. A
+     * track's row is written when it ends; storeActiveAppearances() writes
+     * the ones still alive (live and dormant) too, so that after it the
+     * table covers every track. Linking reads it in place.
+     */
+    const AppearanceTable& appearances() const { return appearances_; }
+    AppearanceTable& appearances() { return appearances_; }
+    void storeActiveAppearances();
+
+    /**
+     * Checkpoint of the tracking state: every live track, the next track
+     * ID, the frame count, the finished appearances and the assignment
+     * prices (setWarmAssignment). Settings are not
+     * included; load() into a tracker built with the same ones, and it
+     * continues exactly as the saved one would have. A failed load()
+     * leaves the tracker reset.
+     */
+    void save(CheckpointWriter& w) const;
+    bool load(CheckpointReader& r);
 
 private:
     float iou_thresh_;
@@ -88,27 +278,135 @@ private:
     int min_hits_;
     int delta_t_;
     float inertia_;
+    int tentative_hits_ = 0;
+    int tentative_max_age_ = 0;
+    int dormant_after_ = 0;
+    float motion_gate_chi2_ = 0.0f;
+    bool warm_assignment_ = true;
+    // By track ID: column prices of the last solve of each stage (first
+    // round, OCR), 0 = none; see setWarmAssignment.
+    std::vector<double> first_prices_;
+    std::vector<double> ocr_prices_;
 
     // Optional appearance (ReID) association.
     bool use_reid_ = false;
     float reid_weight_ = 0.35f;       // how much to trust appearance vs motion/IoU
     float reid_cos_thresh_ = 0.35f;   // cosine similarity gate for low-IoU matches
+    float min_reid_quality_ = 0.40f;  // appearance bank entry quality
+    EmbedFn lazy_embed_;
+    int lazy_refresh_ = 0;
     
-    std::vector<std::unique_ptr<KalmanBoxTracker>> trackers_;
+    // Kalman states of every tracker; declared before pool_, whose
+    // trackers release their slots on destruction.
+    KalmanStateBank bank_;
+    // Trackers live in one contiguous pool. Slots of aged-out tracks are
+    // retired onto free_slots_ and reinitialized for the next birth, so
+    // steady-state tracking does not allocate. live_ holds the slots of the
+    // current tracks in creation (track_id) order; association indexes
+    // tracks by their position in live_. Dormant tracks wait in dormant_,
+    // also in track_id order, and join live_ for the OCR stage only.
+    std::vector<KalmanBoxTracker> pool_;
+    std::vector<int> free_slots_;
+    std::vector<int> live_;
+    std::vector<int> dormant_;
+    std::vector<int> tier_scratch_;  // retier()'s split
     int next_id_ = 0;
     int frame_count_ = 0;
 
-    AppearanceMap finished_appearances_;
+    AppearanceTable appearances_;
+    AssociationStats association_stats_;
     
-    HungarianAlgorithm hungarian_;
+
+    // One assignment solver and its output, per connected component in flight.
+    struct ComponentSolver {
+        LapjvSolver solver;
+        std::vector<int> assignment;
+        std::vector<double> prices;  // the component's column prices (warm start)
+    };
+
+    /**
+     * Per-frame association buffers. Every pass resizes them in place, so
+     * once a scene's largest frame has been seen tracking stops allocating.
+     */
+    struct AssociationScratch {
+        BoxGrid grid;
+        OverlapPairs pairs;             // gated (detection, track) pairs of the current pass
+        std::vector<BBox> det_boxes;
+        std::vector<BBox> track_boxes;  // predicted, or last observed for OCR
+        // Per track: OCM reference observation's center, whether there is
+        // one, and the inertia direction.
+        std::vector<float> prev_cx, prev_cy, inertia_x, inertia_y;
+        std::vector<char> prev_valid;
+        MotionGate gate;                // per track of `track_boxes` (setMotionGate)
+        // Per entry of `pairs`: OcmAngleCosts() inputs and costs.
+        std::vector<float> ocm_dx, ocm_dy, ocm_ix, ocm_iy, ocm_weight, angle_cost;
+        std::vector<float> pair_score;  // one per entry of `pairs`
+        std::vector<double> pair_cost;  // assignment cost of each entry of `pairs`
+        // associate()'s appearance similarities, which OCR looks up for
+        // the pairs both stages score: the first stage's pairs and each
+        // one's similarity (NaN where none was computed).
+        OverlapPairs sim_pairs;
+        std::vector<float> pair_sim;
+        bool sims_cached = false;
+        std::vector<int> assignment;
+        std::vector<int> row_count;
+        std::vector<int> col_count;
+        std::vector<char> det_used;
+        std::vector<char> trk_used;
+        std::vector<int> kept;          // unmatched lists being compacted
+
+        // Connected components of the gated pairs (see solveGated()).
+        std::vector<int> parent, comp_of, row_comp;
+        std::vector<int> comp_rows, rows_of, comp_cols, cols_of, local_col;
+        std::vector<int> sub_begin, sub_col;
+        std::vector<double> sub_cost;
+        std::vector<int> ambiguous;
+        std::vector<int> reaugmented;  // per ambiguous component
+        std::vector<int> seeded;       // per ambiguous component
+        std::vector<int> col_track;    // track ID of each column
+        std::vector<char> col_solved;  // by column: in an ambiguous component
+        std::vector<ComponentSolver> solvers;
+
+        // update()'s matching results.
+        std::vector<std::pair<int, int>> matched;
+        std::vector<std::pair<int, int>> ocr_matched;
+        std::vector<int> unmatched_dets;
+        std::vector<int> unmatched_trks;
+    };
+    AssociationScratch scratch_;
     
     /**
-     * Associate detections to trackers using Hungarian algorithm.
+     * Associate detections to trackers by linear assignment.
      * 
      * @param detections List of detected bounding boxes
      * @param matched_indices Output: pairs of (detection_idx, tracker_idx)
      * @param unmatched_detections Output: indices of unmatched detections
      */
+    /**
+     * Indices of the detections lazy ReID must embed (see setLazyReid).
+     * Expects predicted (and warped) tracks.
+     */
+    std::vector<int> lazyReidCandidates(const std::vector<Detection>& detections);
+
+    /** The t-th current track (an index into live_). */
+    KalmanBoxTracker& tracker(int t) { return pool_[static_cast<size_t>(live_[static_cast<size_t>(t)])]; }
+    const KalmanBoxTracker& tracker(int t) const { return pool_[static_cast<size_t>(live_[static_cast<size_t>(t)])]; }
+
+    /** Retire every current track into the free list. */
+    void retireAll();
+
+    /**
+     * Move tracks of live_ past dormant_after_ into dormant_, keeping
+     * both in track_id order (live_ may hold former dormant tracks).
+     */
+    void retier();
+
+    /**
+     * The motion gate (setMotionGate) of the tracks in scratch_.track_boxes,
+     * for FindOverlapPairs; null when it is off.
+     */
+    const MotionGate* motionGate();
+
     void associate(const std::vector<Detection>& detections,
                    std::vector<std::pair<int, int>>& matched_indices,
                    std::vector<int>& unmatched_detections,
@@ -118,4 +416,38 @@ private:
                       std::vector<std::pair<int, int>>& matched_indices,
                       std::vector<int>& unmatched_detections,
                       std::vector<int>& unmatched_trackers);
+
+    /**
+     * Score the gated pairs of associate() (IoU, OCM and the ReID bonus)
+     * into scratch_.pair_score; returns the highest score. Instantiated on
+     * whether ReID is on, so the ReID-off pass has no appearance branch per
+     * pair.
+     */
+    template <bool kReid>
+    float scorePairs(const std::vector<Detection>& detections);
+
+    /** associateOCR()'s counterpart: pair costs into scratch_.pair_cost. */
+    template <bool kReid>
+    void costOcrPairs(const std::vector<Detection>& detections,
+                      const std::vector<int>& unmatched_detections,
+                      const std::vector<int>& unmatched_trackers);
+
+    /**
+     * Assign rows to columns over gated pairs, as LapjvSolver::solveSparse()
+     * with `cost[k]` for pair k of `pairs`. The pairs split into connected
+     * components that share no row or column: a lone pair is assigned
+     * directly and only the larger components are solved, on the shared
+     * pool when there are many pairs.
+     *
+     * With `prices` (by track ID, see setWarmAssignment), column j, track
+     * scratch_.col_track[j], starts from its price there, and leaves this
+     * solve's price, or none if it was in no solved component.
+     */
+    void solveGated(int n_rows,
+                    int n_cols,
+                    const OverlapPairs& pairs,
+                    const std::vector<double>& cost,
+                    double cost_limit,
+                    std::vector<int>& assignment,
+                    std::vector<double>* prices = nullptr);
 };
@@ -0,0 +1,195 @@
+#include "inference_backend.hpp"
+
+#ifdef FACE_PIPELINE_ONNXRUNTIME
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <set>
+
+#include <onnxruntime_cxx_api.h>
+#ifdef FACE_PIPELINE_ONNXRUNTIME_DML
+#include <dml_provider_factory.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+Ort::Env& OrtEnv() {
+    static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "face_pipeline");
+    return env;
+}
+
+#ifdef _WIN32
+std::wstring Widen(const std::string& utf8) {
+    const int n = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, nullptr, 0);
+    std::wstring out(static_cast<size_t>(n > 0 ? n : 1), L'\0');
+    if (n > 0) MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, &out[0], n);
+    out.resize(out.size() - 1);
+    return out;
+}
+#endif
+
+// Same shape rules as the other backends: a leading batch of 1 is dropped,
+// [C, H, W] -> (w, h, c) and [N, K] -> (K, N).
+bool CopyToMat(const Ort::Value& value, ncnn::Mat& out) {
+    if (!value.IsTensor()) return false;
+    const Ort::TensorTypeAndShapeInfo info = value.GetTensorTypeAndShapeInfo();
+    if (info.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) return false;
+    std::vector<int64_t> shape = info.GetShape();
+    if (shape.size() == 4 || (shape.size() == 3 && shape[0] == 1)) shape.erase(shape.begin());
+    if (shape.size() == 1) shape.insert(shape.begin(), 1);
+    const float* data = value.GetTensorData<float>();
+    if (shape.size() == 3) {
+        const int c = static_cast<int>(shape[0]);
+        const int h = static_cast<int>(shape[1]);
+        const int w = static_cast<int>(shape[2]);
+        out.create(w, h, c);
+        if (out.empty()) return false;
+        // ncnn channels start at aligned offsets (cstep).
+        for (int q = 0; q < c; ++q) {
+            std::memcpy(out.channel(q).data, data + static_cast<size_t>(q) * w * h, sizeof(float) * w * h);
+        }
+        return true;
+    }
+    if (shape.size() != 2) return false;
+    out.create(static_cast<int>(shape[1]), static_cast<int>(shape[0]));
+    if (out.empty()) return false;
+    std::memcpy(out.data, data, sizeof(float) * out.total());
+    return true;
+}
+
+class OnnxBackend final : public NetBackend {
+public:
+    OnnxBackend(Ort::Session session, bool directml, std::string input,
+                std::vector<int64_t> input_shape, std::set<std::string> outputs)
+        : session_(std::move(session)),
+          directml_(directml),
+          input_(std::move(input)),
+          input_shape_(std::move(input_shape)),
+          outputs_(std::move(outputs)) {}
+
+    const char* name() const override { return directml_ ? "ONNX Runtime (DirectML)" : "ONNX Runtime (CPU)"; }
+
+    // NCHW; symbolic dimensions are reported as -1.
+    int inputWidth() const override {
+        return input_shape_.size() == 4 && input_shape_[3] > 0 ? static_cast<int>(input_shape_[3]) : 0;
+    }
+    int inputHeight() const override {
+        return input_shape_.size() == 4 && input_shape_[2] > 0 ? static_cast<int>(input_shape_[2]) : 0;
+    }
+
+    bool hasOutput(const char* name) const override { return outputs_.count(name) != 0; }
+
+    bool run(const ncnn::Mat& input,
+             const std::vector<const char*>& names,
+             std::vector<ncnn::Mat>& outputs) const override {
+        // ONNX Runtime wants a dense tensor; ncnn may pad each channel.
+        const size_t plane = static_cast<size_t>(input.w) * input.h;
+        std::vector<float> dense;
+        const float* data = static_cast<const float*>(input.data);
+        if (input.c > 1 && input.cstep != plane) {
+            dense.resize(plane * input.c);
+            for (int q = 0; q < input.c; ++q) {
+                std::memcpy(dense.data() + plane * q, input.channel(q).data, sizeof(float) * plane);
+            }
+            data = dense.data();
+        }
+        const int64_t shape[4] = {1, input.c, input.h, input.w};
+        const Ort::MemoryInfo memory = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        const Ort::Value tensor = Ort::Value::CreateTensor<float>(
+            memory, const_cast<float*>(data), plane * input.c, shape, 4);
+        const char* input_names[] = {input_.c_str()};
+        try {
+            // CPU sessions run concurrently; DirectML serializes on its queue anyway.
+            std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+            if (directml_) lock.lock();
+            std::vector<Ort::Value> values = session_.Run(Ort::RunOptions{nullptr}, input_names, &tensor, 1,
+                                                          names.data(), names.size());
+            if (lock.owns_lock()) lock.unlock();
+            outputs.resize(names.size());
+            for (size_t i = 0; i < names.size(); ++i) {
+                if (!CopyToMat(values[i], outputs[i])) return false;
+            }
+        } catch (const Ort::Exception&) {
+            return false;
+        }
+        return true;
+    }
+
+private:
+    mutable Ort::Session session_;
+    bool directml_ = false;
+    std::string input_;
+    std::vector<int64_t> input_shape_;
+    std::set<std::string> outputs_;
+    mutable std::mutex mutex_;
+};
+}  // namespace
+
+bool OnnxRuntimeAvailable() { return true; }
+
+std::unique_ptr<NetBackend> LoadOnnxModel(const std::string& onnx_path,
+                                          const OnnxRuntimeOptions& options,
+                                          std::string& error) {
+    try {
+        Ort::SessionOptions session_options;
+        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        bool directml = false;
+#ifdef FACE_PIPELINE_ONNXRUNTIME_DML
+        if (options.directml) {
+            // Required by the DirectML execution provider.
+            session_options.DisableMemPattern();
+            session_options.SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
+            Ort::ThrowOnError(OrtSessionOptionsAppendExecutionProvider_DML(session_options, options.device));
+            directml = true;
+        }
+#else
+        if (options.directml) {
+            static bool warned = false;
+            if (!warned) {
+                fprintf(stderr, "Warning: ONNX Runtime was built without DirectML; running it on the CPU\n");
+                warned = true;
+            }
+        }
+#endif
+#ifdef _WIN32
+        Ort::Session session(OrtEnv(), Widen(onnx_path).c_str(), session_options);
+#else
+        Ort::Session session(OrtEnv(), onnx_path.c_str(), session_options);
+#endif
+        if (session.GetInputCount() != 1) {
+            error = onnx_path + ": expected a single input";
+            return nullptr;
+        }
+        Ort::AllocatorWithDefaultOptions allocator;
+        const std::string input = session.GetInputNameAllocated(0, allocator).get();
+        const std::vector<int64_t> input_shape =
+            session.GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        std::set<std::string> outputs;
+        for (size_t i = 0; i < session.GetOutputCount(); ++i) {
+            outputs.insert(session.GetOutputNameAllocated(i, allocator).get());
+        }
+        return std::unique_ptr<NetBackend>(
+            new OnnxBackend(std::move(session), directml, input, input_shape, std::move(outputs)));
+    } catch (const Ort::Exception& e) {
+        error = std::string("cannot load ") + onnx_path + ": " + e.what();
+        return nullptr;
+    }
+}
+
+#else
+
+bool OnnxRuntimeAvailable() { return false; }
+
+std::unique_ptr<NetBackend> LoadOnnxModel(const std::string& onnx_path,
+                                          const OnnxRuntimeOptions& options,
+                                          std::string& error) {
+    (void)onnx_path;
+    (void)options;
+    error = "this build has no ONNX Runtime support";
+    return nullptr;
+}
+
+#endif
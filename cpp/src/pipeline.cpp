@@ -1,115 +1,357 @@
 #include "pipeline.hpp"
+#include "appearance_table.hpp"
+#include "checkpoint.hpp"
+#include "embedded_models.hpp"
+#include "frame_cache.hpp"
+#include "frame_proxies.hpp"
+#include "detection_dump.hpp"
+#include "detection_scheduler.hpp"
 #include "gmc.hpp"
-#include "stb_image.h"
+#include "gmc_stage.hpp"
+#include "huge_pages.hpp"
+#include "inference_backend.hpp"
+#include "image_decoder.hpp"
+#include "json_writer.hpp"
+#include "keyframes.hpp"
+#include "landmark_flow.hpp"
+#include "light_detector.hpp"
+#include "prefetcher.hpp"
+#include "read_ahead.hpp"
+#include "sample_grid.hpp"
+#include "simd_kernels.hpp"
+#include "speculative_detector.hpp"
+#include "stage_balancer.hpp"
+#include "stage_profile.hpp"
+#include "thread_pool.hpp"
+#include "time_budget.hpp"
+#include "track_store.hpp"
+#include "tracy_zones.hpp"
+#include "tracklet_linking.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
-#include <fstream>
+#include <cstring>
 #include <limits>
 #include <map>
+#include <mutex>
 
 namespace {
-std::vector<Detection> NmsDetections(std::vector<Detection> dets, float iou_thresh) {
-    if (dets.size() <= 1) return dets;
-    std::sort(dets.begin(), dets.end(),
-              [](const Detection& a, const Detection& b) { return a.score > b.score; });
-
-    std::vector<Detection> kept;
-    kept.reserve(dets.size());
-    for (const auto& d : dets) {
-        bool suppressed = false;
-        for (const auto& k : kept) {
-            if (d.bbox.iou(k.bbox) > iou_thresh) {
-                suppressed = true;
-                break;
-            }
-        }
-        if (!suppressed) kept.push_back(d);
-    }
-    return kept;
+// Observations a track needs to survive the noise filter after linking;
+// until then it is tentative (PipelineOptions::track_tentative_age).
+constexpr int kMinTrackObservations = 3;
+
+inline float clampf(float v, float lo, float hi) {
+    return std::max(lo, std::min(hi, v));
 }
 
-inline bool FileExists(const std::string& path) {
-    std::ifstream f(path.c_str(), std::ios::binary);
-    return f.good();
+// Resumable runs (--checkpoint): the state of the tracking loop after one
+// frame. The header pins the settings that shape that state and the input
+// it was made on; a checkpoint made with different ones is ignored rather
+// than misread.
+constexpr char kCheckpointMagic[8] = {'F', 'P', 'C', 'K', 'P', 'T', '0', '1'};
+constexpr uint32_t kCheckpointVersion = 15;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t frame;   // last frame the saved state has seen
+    int32_t stride;
+    uint32_t reid;   // ReID in association
+    float iou_thresh;
+    float conf_thresh;
+    int32_t max_age;
+    float inertia;
+    int32_t tentative_age;
+    int32_t dormant_age;
+    uint64_t settings;      // CheckpointSettingsKey()
+    uint64_t frame_names;   // file names of frames 0 ... frame (none for sources without files)
+    int32_t input_frames;   // frames of the input, -1 if open-ended; a resumed input may only be longer
+    int32_t frame_width;    // of frame `frame`, 0 if it could not be read
+    int32_t frame_height;
+};
+
+// The settings side; the input side depends on the saved frame (see process).
+bool CheckpointHeaderMatches(const CheckpointHeader& a, const CheckpointHeader& b) {
+    return std::memcmp(a.magic, b.magic, sizeof(a.magic)) == 0 && a.version == b.version && a.stride == b.stride &&
+           a.reid == b.reid && a.iou_thresh == b.iou_thresh && a.conf_thresh == b.conf_thresh &&
+           a.max_age == b.max_age && a.inertia == b.inertia && a.tentative_age == b.tentative_age &&
+           a.dormant_age == b.dormant_age && a.settings == b.settings;
 }
 
-struct LoadedRgbFrame {
-    int w = 0;
-    int h = 0;
-    std::vector<uint8_t> rgb;  // RGB, size = w*h*3
+// One frame of a track as the checkpoint's track journal holds it.
+struct TrackJournalRecord {
+    int32_t track_id;
+    TrackFrame frame;
+};
+
+// Time one kind of work took, summed over every thread that ran it
+// (FACE_PIPELINE_LOG_STAGES), and each call in the run's profile if it has
+// one (--profile, --trace). Scopes count their allocations too (AllocStats).
+class StageClock {
+public:
+    StageClock(StageProfile* profile, ProfileStage stage) : profile_(profile), stage_(stage) {}
+
+    // Calls stop going to the profile (another component records them).
+    void detachProfile() { profile_ = nullptr; }
+
+    class Scope {
+    public:
+        explicit Scope(StageClock& clock, int frame = -1)
+            : clock_(clock), frame_(frame), start_(std::chrono::steady_clock::now()), counted_(clock.stage_) {}
+        ~Scope() {
+            const auto end = std::chrono::steady_clock::now();
+            clock_.ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count();
+            if (clock_.profile_) clock_.profile_->record(clock_.stage_, start_, end, frame_);
+        }
+
+    private:
+        StageClock& clock_;
+        int frame_;
+        std::chrono::steady_clock::time_point start_;
+        AllocStats::Scope counted_;
+    };
+
+    double ms() const { return static_cast<double>(ns_.load()) * 1e-6; }
+
+private:
+    std::atomic<int64_t> ns_{0};
+    StageProfile* profile_;
+    ProfileStage stage_;
 };
 
-inline bool LoadRgbFrame(const std::string& path, LoadedRgbFrame& out) {
-    out = LoadedRgbFrame{};
-    int w = 0, h = 0, ch = 0;
-    unsigned char* rgb = stbi_load(path.c_str(), &w, &h, &ch, 3);
-    if (!rgb || w <= 0 || h <= 0) {
-        if (rgb) stbi_image_free(rgb);
-        return false;
-    }
-    out.w = w;
-    out.h = h;
-    out.rgb.assign(rgb, rgb + static_cast<size_t>(w) * static_cast<size_t>(h) * 3u);
-    stbi_image_free(rgb);
-    return true;
+inline bool same_box(const BBox& a, const BBox& b) {
+    return a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2;
 }
 
-inline float clampf(float v, float lo, float hi) {
-    return std::max(lo, std::min(hi, v));
+// Fold a reverse-time tracking pass of a shot into its forward tracklets
+// (both indexed by track ID, frames ascending). On a frame where a track is
+// observed both passes emit exactly the detection box, so each reverse
+// tracklet belongs to the forward one it shares the most such boxes with.
+// Where both passes have a box they are blended by confidence, which decays
+// with frames since the last observation, so between detections the box
+// leans on the nearer one. Frames only the reverse pass covers (before a
+// face's first detection, or after the forward pass let it fade) are added.
+void FuseReverseTracks(const std::vector<std::vector<TrackFrame>>& reverse,
+                       std::vector<std::vector<TrackFrame>>& forward) {
+    int lo = std::numeric_limits<int>::max(), hi = -1;
+    for (const auto& frames : forward) {
+        if (frames.empty()) continue;
+        lo = std::min(lo, frames.front().frame_index);
+        hi = std::max(hi, frames.back().frame_index);
+    }
+    if (hi < lo) return;
+
+    // Forward entries by frame: (track, position).
+    std::vector<std::vector<std::pair<int, int>>> at(static_cast<size_t>(hi - lo + 1));
+    for (size_t t = 0; t < forward.size(); ++t) {
+        for (size_t k = 0; k < forward[t].size(); ++k) {
+            at[static_cast<size_t>(forward[t][k].frame_index - lo)].emplace_back(static_cast<int>(t),
+                                                                               static_cast<int>(k));
+        }
+    }
+
+    // Best reverse estimate per (forward track, frame).
+    std::vector<std::map<int, TrackFrame>> extra(forward.size());
+    for (const auto& frames : reverse) {
+        std::map<int, int> votes;
+        for (const TrackFrame& f : frames) {
+            if (f.frame_index < lo || f.frame_index > hi) continue;
+            for (const auto& [t, k] : at[static_cast<size_t>(f.frame_index - lo)]) {
+                if (same_box(forward[static_cast<size_t>(t)][static_cast<size_t>(k)].bbox, f.bbox)) votes[t]++;
+            }
+        }
+        int owner = -1, best = 0;
+        for (const auto& [t, n] : votes) {
+            if (n > best) owner = t, best = n;
+        }
+        if (owner < 0) continue;  // never observed with a forward track
+        auto& mine = extra[static_cast<size_t>(owner)];
+        for (const TrackFrame& f : frames) {
+            auto it = mine.find(f.frame_index);
+            if (it == mine.end()) {
+                mine.emplace(f.frame_index, f);
+            } else if (f.confidence > it->second.confidence) {
+                it->second = f;
+            }
+        }
+    }
+
+    std::vector<TrackFrame> fused;
+    for (size_t t = 0; t < forward.size(); ++t) {
+        if (extra[t].empty()) continue;
+        const std::vector<TrackFrame>& fwd = forward[t];
+        fused.clear();
+        size_t k = 0;
+        for (const auto& [frame, rev] : extra[t]) {
+            while (k < fwd.size() && fwd[k].frame_index < frame) fused.push_back(fwd[k++]);
+            if (k == fwd.size() || fwd[k].frame_index != frame) {
+                fused.push_back(rev);
+                continue;
+            }
+            const TrackFrame& f = fwd[k++];
+            if (same_box(f.bbox, rev.bbox)) {
+                fused.push_back(f);
+                continue;
+            }
+            const float wf = f.confidence, wr = rev.confidence;
+            const float inv = 1.0f / std::max(wf + wr, 1e-6f);
+            fused.push_back(TrackFrame{frame,
+                                       BBox{(wf * f.bbox.x1 + wr * rev.bbox.x1) * inv,
+                                            (wf * f.bbox.y1 + wr * rev.bbox.y1) * inv,
+                                            (wf * f.bbox.x2 + wr * rev.bbox.x2) * inv,
+                                            (wf * f.bbox.y2 + wr * rev.bbox.y2) * inv},
+                                       std::max(wf, wr)});
+        }
+        while (k < fwd.size()) fused.push_back(fwd[k++]);
+        forward[t].swap(fused);
+    }
+}
+
+// SCRFD model file with extension `ext`; none when replaying a detection dump.
+std::string DetectorFile(const std::string& model_dir, const PipelineOptions& options, const char* ext) {
+    if (options.replay || !options.replay_detections_path.empty()) return std::string();
+    return ResolveDetectorStem(model_dir, options.detector_stem, options.int8) + ext;
 }
 
-inline float cosine_sim(const std::array<float, Detection::kReidDim>& a,
-                        const std::array<float, Detection::kReidDim>& b) {
-    double dot = 0.0;
-    for (int i = 0; i < Detection::kReidDim; ++i) {
-        dot += static_cast<double>(a[i]) * static_cast<double>(b[i]);
+// Network files of model `stem` (.param and .bin, or the embedded copies).
+void HashModel(DetectionCache::Hasher& h, const std::string& stem) {
+    const std::string builtin = std::string(kBuiltinModelDir) + "/";
+    if (stem.compare(0, builtin.size(), builtin) == 0) {
+        const EmbeddedModel* model = FindEmbeddedModel(stem.substr(builtin.size()));
+        if (model) {
+            h.bytes(model->param, std::strlen(model->param));
+            h.bytes(model->bin, model->bin_size);
+        }
+        return;
     }
-    return clampf(static_cast<float>(dot), -1.0f, 1.0f);
+    h.file(stem + ".param");
+    h.file(stem + ".bin");
 }
 
-inline float bbox_diag(const BBox& b) {
-    const float w = std::max(0.0f, b.width());
-    const float h = std::max(0.0f, b.height());
-    return std::sqrt(w * w + h * h);
+// Everything a cached frame's detections and embeddings depend on besides
+// its pixels: the models and the settings that shape their output.
+uint64_t DetectionModelKey(const std::string& detector_stem, const std::string& reid_stem, float conf_thresh,
+                           const DetectorOptions& det, const PipelineOptions& options) {
+    DetectionCache::Hasher h;
+    HashModel(h, detector_stem);
+    h.value(options.detector_input);
+    h.value(conf_thresh);
+    h.value(det.use_fp16_packed);
+    h.value(det.use_fp16_storage);
+    h.value(det.use_fp16_arithmetic);
+    h.value(det.dynamic_input);
+    h.value(det.landmarks);
+    h.value(det.merge_iou);
+    if (det.min_face > 0) h.value(det.min_face);
+    h.value(det.gpu.enabled);
+    if (det.gpu.enabled && det.gpu.preprocess) h.value(true);  // device-side resize rounds differently
+    h.value(det.coreml.enabled);
+    h.value(det.onnx.enabled);
+    h.value(det.tiles.tile_size);
+    h.value(det.tiles.overlap);
+    h.value(det.tiles.full_frame);
+    h.value(!reid_stem.empty());
+    if (!reid_stem.empty()) {
+        HashModel(h, reid_stem);
+        h.value(options.reid_gpu.enabled);
+        h.value(options.reid_onnx.enabled);
+        h.value(options.reid_gate.min_face_px);
+        h.value(options.reid_gate.min_score);
+        h.value(options.reid_gate.min_eye_px);
+        h.value(options.reid_gate.blur_precheck);
+        h.value(options.reid_gate.max_per_frame);
+        h.value(options.input_scale);
+        h.value(options.reid.blur_sharpen_var);
+        h.value(options.reid.blur_skip_var);
+        h.value(options.reid.sharpen_alpha);
+    }
+    return h.digest();
 }
 
-inline float center_dist_norm_max_diag(const BBox& a, const BBox& b) {
-    const float acx = (a.x1 + a.x2) * 0.5f;
-    const float acy = (a.y1 + a.y2) * 0.5f;
-    const float bcx = (b.x1 + b.x2) * 0.5f;
-    const float bcy = (b.y1 + b.y2) * 0.5f;
-    const float dx = acx - bcx;
-    const float dy = acy - bcy;
-    const float diag = std::max(bbox_diag(a), bbox_diag(b)) + 1e-6f;
-    return std::sqrt(dx * dx + dy * dy) / diag;
+// What a checkpoint's loop state depends on besides its header's own
+// fields: what is detected and how (`model_key`, a DetectionModelKey), which
+// frames are and what runs on the frames in between.
+uint64_t CheckpointSettingsKey(uint64_t model_key, const PipelineOptions& options, const PipelineOptions& tracking,
+                               float reid_weight, float reid_cos_thresh) {
+    DetectionCache::Hasher h;
+    h.value(model_key);
+    h.bytes(options.replay_detections_path.data(), options.replay_detections_path.size());
+    h.value(options.decode_long_side);
+    h.value(options.input_scale);
+    h.value(options.tile_refresh);
+    h.bytes(options.light_detector_stem.data(), options.light_detector_stem.size());
+    h.value(options.light_detector_input);
+    h.value(options.light_detector_conf);
+    h.value(options.adaptive_input_face);
+    h.value(options.adaptive_input_refresh);
+    h.value(options.cascade_input);
+    h.value(options.cascade_min_score);
+    h.value(options.cascade_refresh);
+    h.value(options.prune_strides);
+    h.value(options.prune_refresh);
+    h.value(options.roi_side);
+    h.value(options.roi_margin);
+    h.value(options.roi_mosaic);
+    h.value(options.landmark_flow);
+    h.value(options.scan_fps);
+    h.value(options.keyframe_snap);
+    h.value(options.scene_cuts.enabled);
+    h.value(options.scene_cuts.hist_threshold);
+    h.value(options.scene_cuts.sad_threshold);
+    h.value(options.scene_cuts.sad_ratio);
+    h.value(options.scene_cuts.min_shot_frames);
+    h.value(options.cut_frames.size());
+    h.bytes(options.cut_frames.data(), options.cut_frames.size() * sizeof(options.cut_frames[0]));
+    h.value(options.gmc.downscale);
+    h.value(options.gmc.model);
+    h.value(options.gmc.fallback);
+    h.value(options.gmc.exclude_margin);
+    h.value(options.gmc.adaptive_residual);
+    h.value(options.gmc.adaptive_inliers);
+    h.value(options.static_camera.enabled);
+    h.value(options.static_camera.probe_frames);
+    h.value(options.static_camera.recheck_every);
+    h.value(options.static_camera.max_shift);
+    h.value(options.sparse_gmc.interval);
+    h.value(options.sparse_gmc.max_residual);
+    h.value(options.duplicate_block_diff);
+    h.value(options.idle_fast_forward);
+    h.value(options.gmc_mask_faces);
+    h.value(options.lazy_reid);
+    h.value(options.reid_refresh);
+    h.value(tracking.track_motion_gate);
+    h.value(tracking.kalman_joseph);
+    h.value(reid_weight);
+    h.value(reid_cos_thresh);
+    return h.digest();
 }
 
-struct UnionFind {
-    std::map<int, int> parent;
-    int find(int x) {
-        auto it = parent.find(x);
-        if (it == parent.end()) {
-            parent[x] = x;
-            return x;
-        }
-        int p = it->second;
-        if (p == x) return x;
-        int r = find(p);
-        parent[x] = r;
-        return r;
-    }
-    void unite(int a, int b) {
-        int ra = find(a);
-        int rb = find(b);
-        if (ra == rb) return;
-        // Keep smallest ID as the representative for stable output.
-        if (ra < rb) parent[rb] = ra;
-        else parent[ra] = rb;
+// Landmarks only feed ReID alignment and landmark flow.
+DetectorOptions ResolveDetectorOptions(const PipelineOptions& options, bool use_reid) {
+    DetectorOptions det = options.detector;
+    // Tiles are sized in source pixels, the frames are the proxy's.
+    if (options.input_scale > 1.0f && det.tiles.tile_size > 0) {
+        det.tiles.tile_size = std::max(1, static_cast<int>(std::lround(det.tiles.tile_size / options.input_scale)));
     }
-};
+    if (options.input_scale > 1.0f && det.min_face > 0) {
+        det.min_face = std::max(1, static_cast<int>(det.min_face / options.input_scale));
+    }
+    det.landmarks = det.landmarks && (use_reid || options.landmark_flow);
+    // SCRFD can occasionally produce multiple highly-overlapping boxes on the
+    // same face (e.g. near-profile / partial occlusion). A stricter second NMS
+    // level reduces duplicate track births downstream.
+    if (det.merge_iou <= 0.0f) det.merge_iou = 0.30f;
+    // With a core policy, ncnn's default (all physical big cores) would
+    // not match the cores the pipeline plans for. Concurrent detection
+    // frames split this further, see FacePipeline::process.
+    if (det.num_threads <= 0 && GetCpuPowersave() != CpuPowersave::All) det.num_threads = PipelineCoreCount();
+    return det;
+}
 }  // namespace
 
 FacePipeline::FacePipeline(const std::string& model_dir,
@@ -118,38 +360,107 @@ FacePipeline::FacePipeline(const std::string& model_dir,
                            float iou_thresh,
                            const std::string& reid_model_dir,
                            float reid_weight,
-                           float reid_cos_thresh)
-    : detector_(model_dir + "/scrfd.param",
-                model_dir + "/scrfd.bin",
-                640, 640,
+                           float reid_cos_thresh,
+                           const PipelineOptions& options)
+    : detector_(DetectorFile(model_dir, options, ".param"),
+                DetectorFile(model_dir, options, ".bin"),
+                options.detector_input, options.detector_input,
                 conf_thresh,
-                0.4f),  // NMS threshold
+                0.4f,  // NMS threshold
+                ResolveDetectorOptions(options, !reid_model_dir.empty())),
       conf_thresh_(conf_thresh),
       detection_fps_(detection_fps),
       iou_thresh_(iou_thresh),
+      options_(options),
       use_reid_(!reid_model_dir.empty()),
       reid_weight_(reid_weight),
       reid_cos_thresh_(reid_cos_thresh) {
-    if (!use_reid_) return;
+    if (options_.memory_budget_mb > 0 || options_.memory_report) {
+        memory_budget_ = std::make_unique<MemoryBudget>(static_cast<size_t>(std::max(0, options_.memory_budget_mb)) << 20);
+    }
+    if (options_.replay) {
+        replay_ = options_.replay;
+        use_reid_ = replay_->reid;
+        return;
+    }
+    if (!options_.replay_detections_path.empty()) {
+        // The dump stands in for both models; its embeddings decide ReID.
+        auto dump = std::make_shared<DetectionDump>();
+        std::string error;
+        if (dump->load(options_.replay_detections_path, error)) {
+            replay_ = std::move(dump);
+        } else {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+        }
+        use_reid_ = replay_ && replay_->reid;
+        return;
+    }
+    if (options_.int8 && ResolveDetectorStem(model_dir, options_.detector_stem, true) ==
+                             ResolveDetectorStem(model_dir, options_.detector_stem, false)) {
+        fprintf(stderr, "Warning: no INT8 detector model in %s; using the fp32 detector\n", model_dir.c_str());
+    }
+    const std::string reid_stem = use_reid_ ? loadReid(reid_model_dir) : std::string();
 
-    // Prefer optimized files if present.
-    std::string param_path = reid_model_dir + "/mobilefacenet-opt.param";
-    std::string bin_path = reid_model_dir + "/mobilefacenet-opt.bin";
-    if (!FileExists(param_path) || !FileExists(bin_path)) {
-        param_path = reid_model_dir + "/mobilefacenet.param";
-        bin_path = reid_model_dir + "/mobilefacenet.bin";
+    if (!options_.light_detector_stem.empty()) {
+        const std::string& stem = options_.light_detector_stem;
+        std::string error;
+        light_detector_ = LoadLightDetector(stem.find('/') == std::string::npos ? model_dir + "/" + stem : stem,
+                                            options_.light_detector_input, options_.light_detector_conf,
+                                            options_.detector, error);
+        if (!light_detector_) fprintf(stderr, "Warning: %s; detecting at the sampled rate only\n", error.c_str());
+    }
+
+    // Lazy ReID embeds only some faces, after association, so its
+    // detections are not worth keeping.
+    if (!options_.detection_cache_path.empty() && options_.lazy_reid && use_reid_) {
+        fprintf(stderr, "Warning: --detection-cache is ignored with --lazy-reid\n");
+    } else if (!options_.detection_cache_path.empty()) {
+        detection_cache_ = std::make_unique<DetectionCache>(DetectionModelKey(
+            ResolveDetectorStem(model_dir, options_.detector_stem, options_.int8), reid_stem, conf_thresh,
+            ResolveDetectorOptions(options_, !reid_model_dir.empty()), options_));
+        std::string error;
+        if (!detection_cache_->load(options_.detection_cache_path, error)) {
+            fprintf(stderr, "Warning: %s; starting the detection cache afresh\n", error.c_str());
+        }
+        if (memory_budget_) detection_cache_->setAccount(memory_budget_->open("detection cache"));
     }
+    if (!options_.checkpoint_path.empty()) {
+        checkpoint_model_key_ = DetectionModelKey(
+            ResolveDetectorStem(model_dir, options_.detector_stem, options_.int8), reid_stem, conf_thresh,
+            ResolveDetectorOptions(options_, !reid_model_dir.empty()), options_);
+    }
+}
 
-    if (!FileExists(param_path) || !FileExists(bin_path)) {
+std::string FacePipeline::loadReid(const std::string& reid_model_dir) {
+    std::string stem;
+    if (options_.int8) {
+        stem = FindModelStem(reid_model_dir, {"mobilefacenet-int8"});
+        if (stem.empty()) {
+            fprintf(stderr, "Warning: no mobilefacenet-int8 model in %s; using fp32 ReID\n", reid_model_dir.c_str());
+        }
+    }
+    // Prefer optimized files if present.
+    if (stem.empty()) stem = FindModelStem(reid_model_dir, {"mobilefacenet-opt", "mobilefacenet"});
+    if (stem.empty()) {
         use_reid_ = false;
-        return;
+        return std::string();
     }
 
-    reid_ = std::make_unique<MobileFaceNetReid>(param_path, bin_path);
+    reid_ = std::make_unique<MobileFaceNetReid>(stem + ".param", stem + ".bin", options_.reid_gpu, options_.reid_onnx);
     if (!reid_->IsLoaded()) {
         reid_.reset();
         use_reid_ = false;
+        return std::string();
     }
+    // Gate sizes are in source pixels; crops are cut from the proxy's.
+    ReidGateOptions gate = options_.reid_gate;
+    if (options_.input_scale > 1.0f) {
+        gate.min_face_px /= options_.input_scale;
+        gate.min_eye_px /= options_.input_scale;
+    }
+    reid_->SetGate(gate);
+    reid_->SetConfig(options_.reid);
+    return stem;
 }
 
 BBox FacePipeline::scrfdToBBox(const ScrfdFace& face, int width, int height) {
@@ -164,129 +475,860 @@ BBox FacePipeline::scrfdToBBox(const ScrfdFace& face, int width, int height) {
 
 std::vector<Detection> FacePipeline::detectSingle(const std::string& image_path,
                                                   int& width, int& height) {
-    std::vector<Detection> result;
-    
     if (!detector_.IsLoaded()) {
-        return result;
+        return {};
     }
     
-    // Load image
-    int channels;
-    unsigned char* rgb = stbi_load(image_path.c_str(), &width, &height, &channels, 3);
-    if (!rgb) {
+    // Load image; nothing else runs meanwhile, so it may use every core
+    LoadedRgbFrame frame;
+    FrameRequest req;
+    req.decode_threads = PipelineCoreCount();
+    if (!LoadFrame(image_path, req, frame)) {
+        return {};
+    }
+    width = frame.w;
+    height = frame.h;
+
+    return detectRgb(frame.rgbData(), frame.rgb_w, frame.rgb_h);
+}
+
+std::vector<Detection> FacePipeline::detectRgb(const unsigned char* rgb, int width, int height,
+                                               const std::vector<std::array<float, 4>>* tile_focus, int max_side,
+                                               const LoadedRgbFrame* frame, int min_face) {
+    std::vector<Detection> result;
+    if (!detector_.IsLoaded() || !rgb) {
         return result;
     }
     
-    // Detect faces
-    std::vector<ScrfdFace> faces = detector_.Detect(rgb, width, height);
-    
+    // Full scans of a frame seen before (in this run or an earlier one) are
+    // looked up instead of detected again.
+    const bool cacheable = detection_cache_ && !tile_focus && max_side <= 0 && min_face <= 0;
+    uint64_t key = 0;
+    if (cacheable) {
+        key = DetectionCache::FrameKey(rgb, width, height);
+        if (detection_cache_->find(key, result)) return result;
+    }
+
+    // Detect faces; lazy ReID embeds them later, inside the tracker.
+    result = toDetections(detector_.Detect(rgb, width, height, tile_focus, max_side, 0.0f, min_face), rgb, width,
+                          height, !options_.lazy_reid, frame);
+    if (cacheable) detection_cache_->insert(key, result);
+    return result;
+}
+
+FrameRequirements DescribeFrameRequirements(const PipelineOptions& options, bool reid) {
+    FrameRequirements req;
+    req.detector_input = options.detector_input;
+    req.tiled = options.detector.tiles.tile_size > 0;
+    req.reid = reid;
+    if (req.tiled) {
+        req.min_long_side = 0;
+    } else if (reid || options.roi_side > 0) {
+        // Face crops: what the decoders may already reduce to.
+        req.min_long_side =
+            options.decode_long_side > 0 ? std::max(options.decode_long_side, options.detector_input) : 0;
+    } else {
+        req.min_long_side = options.detector_input;
+    }
+    // NV12 carries luma as is and converts to RGB at the reduced size;
+    // JPEG decodes DCT-scaled and reads face regions back at full size.
+    req.pixel_format = "nv12";
+    req.container = "png";
+    for (const ImageDecoder* decoder : ImageDecoders()) {
+        if (std::strcmp(decoder->name(), "libjpeg-turbo") == 0) req.container = "jpeg";
+    }
+    return req;
+}
+
+std::string FrameRequirementsJson(const FrameRequirements& requirements) {
+    std::string out;
+    JsonWriter w(out);
+    w.raw("{\"minLongSide\": ").integer(requirements.min_long_side);
+    w.raw(", \"detectorInput\": ").integer(requirements.detector_input);
+    w.raw(", \"tiled\": ").raw(requirements.tiled ? "true" : "false");
+    w.raw(", \"reid\": ").raw(requirements.reid ? "true" : "false");
+    w.raw(", \"pixelFormat\": ").string(requirements.pixel_format);
+    w.raw(", \"container\": ").string(requirements.container).ch('}');
+    return out;
+}
+
+RunTuning FacePipeline::tuning() const {
+    RunTuning tuning;
+    tuning.detection_fps = detection_fps_;
+    tuning.iou_thresh = iou_thresh_;
+    tuning.reid_weight = reid_weight_;
+    tuning.reid_cos_thresh = reid_cos_thresh_;
+    tuning.tracking = options_;
+    return tuning;
+}
+
+std::vector<Detection> FacePipeline::toDetections(const std::vector<ScrfdFace>& faces,
+                                                  const unsigned char* rgb, int width, int height,
+                                                  bool with_reid, const LoadedRgbFrame* frame) {
     // Convert to normalized Detection (bbox + score)
+    std::vector<Detection> result;
     result.reserve(faces.size());
     for (const auto& face : faces) {
         Detection det{scrfdToBBox(face, width, height), face.score};
-        if (use_reid_ && reid_ && reid_->IsLoaded()) {
-            // ReID crop uses absolute pixel bbox.
-            const BBox abs_bbox{face.bbox[0], face.bbox[1], face.bbox[2], face.bbox[3]};
-            bool ok = false;
-            float q = 0.0f;
-            det.reid = reid_->Extract(rgb, width, height, abs_bbox, &face.landmarks, ok, &q);
-            det.reid_quality = q;
-            // ReID may be used for association even if quality is low;
-            // bank updates are gated inside the tracker by reid_quality.
-            det.has_reid = ok;
-        }
+        det.pixel_bbox = BBox{face.bbox[0], face.bbox[1], face.bbox[2], face.bbox[3]};
+        det.landmarks = face.landmarks;
         result.push_back(det);
     }
+    if (!with_reid || !use_reid_ || !reid_ || !reid_->IsLoaded() || faces.empty()) {
+        return result;
+    }
 
-    // SCRFD can occasionally produce multiple highly-overlapping boxes on the same face
-    // (e.g. near-profile / partial occlusion). A small NMS pass here reduces duplicate
-    // track births downstream.
-    result = NmsDetections(std::move(result), 0.30f);
-
-    stbi_image_free(rgb);
-    
+    // ReID crops use the pixel bboxes; all faces of the frame go in one batch.
+    std::vector<int> all(result.size());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = static_cast<int>(i);
+    embedDetections(result, all, rgb, width, height, frame);
     return result;
 }
 
+void FacePipeline::embedDetections(std::vector<Detection>& dets, const std::vector<int>& indices,
+                                   const unsigned char* rgb, int width, int height,
+                                   const LoadedRgbFrame* frame) const {
+    std::vector<BBox> boxes;
+    std::vector<std::array<std::array<float, 2>, 5>> landmarks;
+    std::vector<float> scores;
+    boxes.reserve(indices.size());
+    landmarks.reserve(indices.size());
+    scores.reserve(indices.size());
+    for (int i : indices) {
+        boxes.push_back(dets[i].pixel_bbox);
+        landmarks.push_back(dets[i].landmarks);
+        scores.push_back(dets[i].score);
+    }
+    // Reduced frames that can read full-resolution regions back give small
+    // faces their crops from those.
+    ReidFullRes full_res;
+    if (frame && frame->read_full_res && frame->w > width) {
+        full_res.width = frame->w;
+        full_res.height = frame->h;
+        full_res.read = &frame->read_full_res;
+    }
+    std::vector<MobileFaceNetReid::Embedding> embeddings =
+        reid_->ExtractBatch(rgb, width, height, boxes, &landmarks, &scores, full_res.read ? &full_res : nullptr);
+    for (size_t k = 0; k < indices.size(); ++k) {
+        Detection& det = dets[indices[k]];
+        det.reid = std::move(embeddings[k].feature);
+        det.reid_quality = embeddings[k].quality;
+        // ReID may be used for association even if quality is low;
+        // bank updates are gated inside the tracker by reid_quality.
+        det.has_reid = embeddings[k].ok;
+    }
+}
+
 PipelineResult FacePipeline::process(const std::vector<std::string>& image_paths,
                                       float video_fps) {
+    ImageListSource source(image_paths);
+    return process(source, video_fps);
+}
+
+PipelineResult FacePipeline::process(FrameSource& source, float video_fps) {
+    return process(source, video_fps, TrackSegmentSink{});
+}
+
+PipelineResult FacePipeline::process(FrameSource& source, float video_fps, const TrackSegmentSink& on_segment) {
+    return process(source, video_fps, on_segment, tuning());
+}
+
+PipelineResult FacePipeline::process(FrameSource& input, float video_fps, const TrackSegmentSink& on_segment,
+                                     const RunTuning& run) {
+    // Proxy frames are read as if they were the source's.
+    std::unique_ptr<ScaledFrameSource> scaled;
+    if (options_.input_scale > 1.0f) scaled = std::make_unique<ScaledFrameSource>(input, options_.input_scale);
+    FrameSource& source = scaled ? *scaled : input;
+    // This run's tuning; every other option is the loaded one.
+    const PipelineOptions& tracking = run.tracking;
+    const float iou_thresh = run.iou_thresh;
+    const float reid_weight = run.reid_weight;
+    const float reid_cos_thresh = run.reid_cos_thresh;
     PipelineResult result;
-    result.frame_count = static_cast<int>(image_paths.size());
-    
-    if (image_paths.empty() || !detector_.IsLoaded()) {
+    result.frame_count = 0;
+
+    // Replaying a dump: its detections replace the models. A dump with warps
+    // is the whole tracker input, so the frames are not read at all.
+    const bool replay_all = replay_ && replay_->warps;
+    if (replay_ && !replay_all && source.frameCount() == 0) {
+        fprintf(stderr, "Error: %s has no GMC warps; replaying it needs the frames\n",
+                options_.replay_detections_path.c_str());
         return result;
     }
-    
+    const int known_count = replay_all ? replay_->frame_count : source.frameCount();
+    if (known_count == 0 || !isLoaded()) {
+        return result;
+    }
+
     // Calculate detection stride (how many frames between detections)
-    int stride = std::max(1, static_cast<int>(video_fps / detection_fps_));
-    
-    // Phase 1: Run face detection on sampled frames
-    // Store detections as map: frame_index -> list of bboxes
-    std::map<int, std::vector<Detection>> detections;
-    int last_width = 0, last_height = 0;
+    int stride = std::max(1, static_cast<int>(video_fps / run.detection_fps));
+    if (replay_) stride = replay_->stride;
 
-    // Dev-only: ReID quality gate health counters.
-    int reid_attempted = 0;
-    int reid_kept = 0;
-    double reid_q_sum = 0.0;
-    double reid_q_min = std::numeric_limits<double>::infinity();
-    double reid_q_max = -std::numeric_limits<double>::infinity();
-    
-    for (int i = 0; i < result.frame_count; i += stride) {
-        int width, height;
-        auto faces = detectSingle(image_paths[i], width, height);
-        if (use_reid_) {
-            for (const auto& d : faces) {
-                reid_attempted++;
-                reid_q_sum += static_cast<double>(d.reid_quality);
-                reid_q_min = std::min(reid_q_min, static_cast<double>(d.reid_quality));
-                reid_q_max = std::max(reid_q_max, static_cast<double>(d.reid_quality));
-                if (d.has_reid) reid_kept++;
-            }
+    // Open-ended sources only know their last frame once they reach it; see below.
+    const int last_frame = known_count - 1;
+
+    // Wall-clock budget: its clock starts with the run. Worker stages read
+    // its level to detect less and skip ReID when the run would not fit.
+    std::unique_ptr<TimeBudget> budget;
+    if (tracking.time_budget_s > 0.0) {
+        budget = std::make_unique<TimeBudget>(tracking.time_budget_s, tracking.budget_degrade);
+    }
+    const TimeBudget* budget_view = budget.get();
+    auto degraded = [budget_view](TimeBudget::Level level) { return budget_view && budget_view->degraded(level); };
+    // Once ReID is dropped, frames are detected without it and bypass the
+    // detection cache, which keeps embedded frames.
+    auto detect_frame = [this, degraded](const LoadedRgbFrame& f, const std::vector<std::array<float, 4>>* tile_focus,
+                                         int max_side, int min_face = 0) {
+        const unsigned char* rgb = f.rgbData();
+        if (!use_reid_ || options_.lazy_reid || !degraded(TimeBudget::NoReid)) {
+            return detectRgb(rgb, f.rgb_w, f.rgb_h, tile_focus, max_side, &f, min_face);
         }
-        if (!faces.empty()) {
-            detections[i] = std::move(faces);
-            last_width = width;
-            last_height = height;
+        return toDetections(detector_.Detect(rgb, f.rgb_w, f.rgb_h, tile_focus, max_side, 0.0f, min_face), rgb,
+                            f.rgb_w, f.rgb_h, false);
+    };
+
+    // Global Motion Compensation (GMC): estimate camera warp between consecutive frames
+    // and apply it to track predictions before association.
+#ifdef FACE_PIPELINE_GMC_OPENCV
+    constexpr int kGmcCompiled = 1;  // OpenCV videostab backend
+#elif defined(FACE_PIPELINE_GMC_FALLBACK)
+    constexpr int kGmcCompiled = 2;  // dependency-free fallback backend
+#else
+    constexpr int kGmcCompiled = 0;  // disabled
+#endif
+    GmcEstimator gmc(options_.gmc);
+    int gmc_attempts = 0;
+    int gmc_ok = 0;
+    int gmc_frame_load_ok = 0;
+
+    // Shot boundaries are found on the same luma planes. Tracks do not
+    // survive a hard cut, so they are retired rather than left to coast.
+    SceneCutDetector scene_cuts(options_.scene_cuts);
+    // Locked-off shots skip GMC but for periodic re-checks.
+    StaticCameraGate static_camera(options_.static_camera);
+    // Smooth motion: one estimate per interval against the last keyframe.
+    SparseGmc sparse_gmc(options_.sparse_gmc);
+
+    // Every frame is decoded exactly once into a small ring shared by detection,
+    // ReID and GMC. GMC only ever looks one frame back, so two slots suffice.
+    // Decoding runs ahead of the tracker on a prefetch pool when enabled.
+    // Frames between detections only feed GMC, so they are decoded straight to
+    // a reduced luma plane; detection frames keep full RGB plus the same plane.
+    // Luma planes feed GMC, scene cuts and duplicate frames; with none of
+    // them on, frames are decoded for detection alone.
+    const bool luma_needed = kGmcCompiled != 0 || options_.scene_cuts.enabled || options_.duplicate_block_diff > 0.0f;
+    const int gmc_down = luma_needed ? gmc.downscale() : 0;
+    // Tiles look at full-resolution pixels, so decoders must not shrink RGB.
+    const int decode_long_side = options_.detector.tiles.tile_size > 0 ? 0 : options_.decode_long_side;
+    // Two-pass detection (scan_fps): a coarse scan first detects one frame
+    // every `scan_stride`; sampled frames then detect only within one scan
+    // interval of a scanned frame with faces, or while tracks are alive.
+    // Scanned frames keep their detections. The loop reads its tracks, so
+    // detection stays inline; it needs to know the whole input up front.
+    const int scan_stride = options_.scan_fps > 0.0f
+                                ? std::max(1, static_cast<int>(video_fps / options_.scan_fps)) / stride * stride
+                                : 0;
+    const bool coarse_scan =
+        scan_stride > stride && !options_.adaptive.enabled && !replay_ && known_count > 0 && source.randomAccess();
+    std::vector<char> dense;  // per detection ordinal (frame / stride): detect there
+    auto in_scan_window = [stride, coarse_scan, &dense](int index) {
+        return !coarse_scan || dense[static_cast<size_t>(index / stride)] != 0;
+    };
+    // Keyframe snapping (see SampleGrid). Dumps and checkpoints record the
+    // plain stride, and replays, the coarse scan and the policy work on it.
+    std::vector<int> keyframes;
+    if (options_.keyframe_snap > 0 && !replay_ && !options_.adaptive.enabled && !coarse_scan &&
+        options_.dump_detections_path.empty() && options_.checkpoint_path.empty()) {
+        keyframes = source.keyframes();
+        if (keyframes.empty()) fprintf(stderr, "Warning: the input has no keyframe index; not snapping samples\n");
+    } else if (options_.keyframe_snap > 0) {
+        fprintf(stderr, "Warning: keyframe snapping needs fixed-stride detection without replays, dumps, "
+                        "checkpoints or a coarse scan; not snapping samples\n");
+    }
+    const SampleGrid grid(stride, options_.keyframe_snap, keyframes);
+    auto is_sampled = [&grid, last_frame, in_scan_window](int index) {
+        return (grid.contains(index) && in_scan_window(index)) || index == last_frame;
+    };
+    // ROI detection looks at the frames in between too, so they keep RGB.
+    const bool roi_detect = options_.roi_side > 0 && stride > 1 && !replay_;
+    // Adaptive scheduling picks detection frames as it goes. Random-access
+    // frames it picks are read again with RGB; streams keep RGB throughout.
+    std::unique_ptr<DetectionPolicy> policy;
+    if (options_.adaptive.enabled) {
+        policy = std::make_unique<DetectionPolicy>(options_.adaptive, stride, video_fps);
+    }
+    // Scrub proxies are made from the decoded frames, so every frame keeps RGB.
+    std::unique_ptr<ProxyWriter> proxies;
+    if (!options_.proxy_dir.empty()) {
+        if (replay_all) {
+            fprintf(stderr, "Warning: a replay with warps decodes no frames; not writing proxies\n");
+        } else {
+            proxies = std::make_unique<ProxyWriter>(options_.proxy_dir, options_.proxy_height, 80);
+            if (!proxies->ok()) {
+                fprintf(stderr, "Warning: cannot create %s; not writing proxies\n", options_.proxy_dir.c_str());
+                proxies.reset();
+            }
         }
     }
-    
-    // Always detect on last frame if not already done
-    int last_frame = result.frame_count - 1;
-    if (detections.find(last_frame) == detections.end()) {
-        int width, height;
-        auto faces = detectSingle(image_paths[last_frame], width, height);
-        if (use_reid_) {
-            for (const auto& d : faces) {
-                reid_attempted++;
-                reid_q_sum += static_cast<double>(d.reid_quality);
-                reid_q_min = std::min(reid_q_min, static_cast<double>(d.reid_quality));
-                reid_q_max = std::max(reid_q_max, static_cast<double>(d.reid_quality));
-                if (d.has_reid) reid_kept++;
+    // The hybrid schedule's light detector runs on the frames between detections.
+    const bool light_detect = light_detector_ && stride > 1 && !replay_;
+    // Landmark flow follows tracks across the GMC stage's luma planes.
+    const bool landmark_flow = options_.landmark_flow && (stride > 1 || policy) && gmc_down > 0 && !replay_all;
+    if (options_.landmark_flow && !landmark_flow && gmc_down == 0) {
+        fprintf(stderr, "Warning: landmark flow needs the GMC luma planes; tracks only predict between detections\n");
+    }
+    const bool rgb_always =
+        roi_detect || light_detect || (policy && !source.randomAccess() && !replay_) || proxies != nullptr;
+    // Stage timing (FACE_PIPELINE_LOG_STAGES): where the frames' time goes,
+    // whichever thread the work runs on.
+    StageProfile* const profile = options_.profile.get();
+    MetricsRegistry* const metrics = options_.metrics.get();
+    StageClock decode_clock(profile, ProfileStage::Decode), detect_clock(profile, ProfileStage::Detect),
+        reid_clock(profile, ProfileStage::Reid), gmc_clock(profile, ProfileStage::Gmc),
+        wait_clock(profile, ProfileStage::Wait);
+    std::unique_ptr<FileReadAhead> read_ahead;  // set up below, once the frames wanted are known
+    auto read_frame = [&source, gmc_down, decode_long_side, &decode_clock, &read_ahead](int index, bool rgb,
+                                                                                      LoadedRgbFrame& out) {
+        StageClock::Scope timed(decode_clock, index);
+        FrameRequest req;
+        req.rgb = rgb;
+        req.rgb_min_long_side = decode_long_side;
+        req.luma_downscale = gmc_down;
+        thread_local std::vector<uint8_t> bytes;
+        if (read_ahead && read_ahead->take(index, bytes)) {
+            if (!DecodeImageBuffer(source.filePath(index), bytes.data(), bytes.size(), req, out)) return false;
+        } else if (!source.read(index, req, out)) {
+            return false;
+        }
+        // GMC's coarse level, built here on the decode thread once per frame.
+        if (out.hasLuma()) GmcEstimator::BuildCoarseLuma(out.lumaData(), out.luma_w, out.luma_h, out.luma_coarse);
+        return true;
+    };
+
+    std::map<int, std::vector<Detection>> scanned_dets;
+    int scan_hits = 0;
+    if (coarse_scan) {
+        dense.assign(static_cast<size_t>(last_frame / stride + 1), 0);
+        LoadedRgbFrame scanned;
+        for (int f = 0; f <= last_frame; f += scan_stride) {
+            std::vector<Detection> dets;
+            if (read_frame(f, true, scanned) && scanned.hasRgb()) {
+                StageClock::Scope timed(detect_clock, f);
+                dets = detect_frame(scanned, nullptr, 0);
+            }
+            dense[static_cast<size_t>(f / stride)] = 1;
+            if (!dets.empty()) {
+                scan_hits++;
+                const int from = std::max(0, f - scan_stride) / stride;
+                const int to = std::min(last_frame, f + scan_stride) / stride;
+                std::fill(dense.begin() + from, dense.begin() + to + 1, 1);
             }
+            scanned_dets[f] = std::move(dets);
+        }
+    }
+
+    // Resumable runs: with a fixed stride, the loop state after a frame is
+    // all that later frames depend on, so a checkpoint of it lets a re-run
+    // over the same input (say, over a longer range) start past the frames
+    // it has already tracked. It starts decoding mid-input, which needs
+    // random access.
+    const bool checkpoints = !options_.checkpoint_path.empty() && !policy && !replay_all && !on_segment;
+    if (!options_.checkpoint_path.empty() && policy) {
+        fprintf(stderr, "Warning: checkpoints need fixed-stride detection; not checkpointing\n");
+    }
+    if (!options_.checkpoint_path.empty() && on_segment) {
+        fprintf(stderr, "Warning: checkpoints keep every track, streamed segments do not; not checkpointing\n");
+    }
+    CheckpointHeader checkpoint_hdr{};
+    std::memcpy(checkpoint_hdr.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+    checkpoint_hdr.version = kCheckpointVersion;
+    checkpoint_hdr.frame = -1;
+    checkpoint_hdr.stride = stride;
+    checkpoint_hdr.reid = use_reid_ ? 1u : 0u;
+    checkpoint_hdr.iou_thresh = iou_thresh;
+    checkpoint_hdr.conf_thresh = conf_thresh_;
+    checkpoint_hdr.max_age = tracking.track_max_age;
+    checkpoint_hdr.inertia = tracking.track_inertia;
+    checkpoint_hdr.tentative_age = tracking.track_tentative_age;
+    checkpoint_hdr.dormant_age = tracking.track_dormant_age;
+    checkpoint_hdr.settings =
+        CheckpointSettingsKey(checkpoint_model_key_, options_, tracking, reid_weight, reid_cos_thresh);
+    checkpoint_hdr.input_frames = known_count;
+    // The input side: a checkpoint is only resumed on the input it was made
+    // on, or that input extended (the same frame files up to its frame,
+    // that frame the same size, no fewer frames). Names are hashed as the
+    // checkpoints advance, not from the first frame each time.
+    DetectionCache::Hasher frame_names;
+    int frames_named = 0;
+    auto frame_names_key = [&source, &frame_names, &frames_named](int frame) {
+        if (frame + 1 < frames_named) {
+            frame_names = DetectionCache::Hasher();
+            frames_named = 0;
         }
-        if (!faces.empty()) {
-            detections[last_frame] = std::move(faces);
+        for (; frames_named <= frame; ++frames_named) {
+            const std::string path = source.filePath(frames_named);
+            frame_names.value(path.size());
+            frame_names.bytes(path.data(), path.size());
         }
+        return frame_names.digest();
+    };
+    auto fits_input = [&source, known_count, &frame_names_key](const CheckpointHeader& hdr) {
+        if ((hdr.input_frames < 0) != (known_count < 0) || known_count < hdr.input_frames) return false;
+        if (hdr.frame_names != frame_names_key(hdr.frame)) return false;
+        FrameRequest req;
+        req.rgb = false;
+        req.luma_downscale = 8;
+        LoadedRgbFrame probe;
+        if (!source.read(hdr.frame, req, probe)) probe.w = probe.h = 0;
+        return probe.w == hdr.frame_width && probe.h == hdr.frame_height;
+    };
+    std::unique_ptr<FILE, int (*)(FILE*)> resume_file(nullptr, &std::fclose);
+    int resume_frame = -1;
+    if (checkpoints && options_.resume && !source.randomAccess()) {
+        fprintf(stderr, "Warning: resuming needs random access to the frames; starting from the first frame\n");
+    } else if (checkpoints && options_.resume) {
+        const char* path = options_.checkpoint_path.c_str();
+        resume_file.reset(std::fopen(path, "rb"));
+        CheckpointHeader hdr{};
+        if (!resume_file) {
+            fprintf(stderr, "Warning: no checkpoint %s; starting from the first frame\n", path);
+        } else if (std::fread(&hdr, sizeof(hdr), 1, resume_file.get()) != 1 ||
+                   !CheckpointHeaderMatches(hdr, checkpoint_hdr) || hdr.frame < 0 ||
+                   (known_count >= 0 && hdr.frame >= last_frame) || !fits_input(hdr)) {
+            fprintf(stderr, "Warning: checkpoint %s does not fit this input and these settings; "
+                            "starting from the first frame\n", path);
+            resume_file.reset();
+        } else {
+            resume_frame = hdr.frame;
+        }
+    }
+
+    // Without luma, frames between detections have no consumer at all. Input
+    // whose end is known and that need not be read in order leaves them
+    // undecoded (tile gating and the policy still look at every frame).
+    const bool skip_unused = !luma_needed && !rgb_always && !policy && !coarse_scan && known_count >= 0 &&
+                             source.randomAccess() && !(options_.tile_refresh > 0 && options_.detector.tiles.tile_size > 0);
+    // Idle fast-forward: while the tracker holds no track, frames between
+    // detections are not decoded. The loop raises this as its tracker
+    // empties; decoders run ahead of it, so a frame they passed over that
+    // the loop turns out to need (a track started just before) is read again.
+    std::atomic<bool> idle_hint{false};
+
+    // Image files read ahead of their decode, in frame order, so decoders
+    // stop waiting on storage latency. Frames are then taken in roughly that
+    // order, which adaptive detection, the coarse scan and replays do not keep.
+    if (options_.read_ahead > 0 && known_count > 0 && source.randomAccess() && !policy && !coarse_scan &&
+        !replay_all && !source.filePath(0).empty()) {
+        read_ahead = std::make_unique<FileReadAhead>(
+            known_count, options_.read_ahead, options_.read_ahead_threads,
+            [&source](int index) { return source.filePath(index); },
+            [skip_unused, is_sampled, &idle_hint](int index) {
+                return !(skip_unused || idle_hint.load(std::memory_order_relaxed)) || is_sampled(index);
+            },
+            std::max(0, resume_frame));
+    }
+
+    // Sampled frames are independent, so with random access they are decoded
+    // and detected several at a time ahead of the tracker. The scheduler works
+    // in detection ordinals: j -> frame j * stride, plus the last frame when
+    // it is off-stride.
+    // Declared before the scheduler, so its workers are gone when the
+    // detector gets its own thread count back.
+    struct DetectorThreads {
+        ScrfdDetector& detector;
+        const int inline_threads;
+        ~DetectorThreads() { detector.SetNumThreads(inline_threads); }
+    } detector_threads{detector_, detector_.NumThreads()};
+    std::unique_ptr<DetectionScheduler> scheduler;
+    std::map<int, std::vector<Detection>> scheduled_dets = std::move(scanned_dets);
+    std::mutex scheduled_mu;  // with a GMC stage, its workers fill scheduled_dets while the loop drains it
+    // On auto, even a single worker is worth it with a core to spare: SCRFD
+    // then overlaps decoding and tracking instead of running in the loop
+    // (tile gating and the adaptive input, which need the loop's tracks,
+    // keep it inline). Stage balancing starts from one worker it can grow.
+    const int detect_workers = DetectionScheduler::ResolveWorkerCount(options_.detect_workers);
+    const bool detect_stage = detect_workers > 1 || (options_.balance_stages && PipelineCoreCount() >= 2) ||
+                              (options_.detect_workers <= 0 && PipelineCoreCount() >= 2 &&
+                               !(options_.tile_refresh > 0 && options_.detector.tiles.tile_size > 0) &&
+                               options_.adaptive_input_face <= 0 && options_.cascade_input <= 0 &&
+                               !options_.prune_strides);
+    if (detect_stage && options_.prefetch_depth > 0 && source.randomAccess() && !policy && !replay_ && !coarse_scan &&
+        !grid.snapped()) {
+        const int det_count = known_count < 0 ? std::numeric_limits<int>::max()
+                                              : last_frame / stride + 1 + (last_frame % stride != 0 ? 1 : 0);
+        // Concurrent frames share the cores: unless the thread count is
+        // pinned, each extractor gets its slice instead of every core.
+        if (options_.detector.num_threads <= 0 && detect_workers > 1) {
+            detector_.SetNumThreads(std::max(1, PipelineCoreCount() / detect_workers));
+        }
+        auto frame_of = [stride, last_frame, known_count](int j) {
+            const int64_t f = static_cast<int64_t>(j) * stride;
+            if (known_count >= 0 && f > last_frame) return last_frame;
+            return static_cast<int>(std::min<int64_t>(f, std::numeric_limits<int>::max()));
+        };
+        // ReID as its own stage: the workers only detect, and MobileFaceNet
+        // embeds frame j while SCRFD is already on the following frames.
+        const bool reid_stage = options_.reid_stage && use_reid_ && !options_.lazy_reid;
+        DetectionScheduler::Embedder embed;
+        if (reid_stage) {
+            embed = [this, degraded, &reid_clock](const LoadedRgbFrame& f, std::vector<Detection>& dets) {
+                if (!f.hasRgb() || degraded(TimeBudget::NoReid)) return;
+                StageClock::Scope timed(reid_clock);
+                // Cached frames arrive embedded. The lookup also covers a
+                // repeat of a frame that was embedded after the repeat was
+                // detected: it has the very same detections.
+                uint64_t key = 0;
+                if (detection_cache_) {
+                    key = DetectionCache::FrameKey(f.rgbData(), f.rgb_w, f.rgb_h);
+                    if (detection_cache_->get(key, dets)) return;
+                }
+                std::vector<int> all(dets.size());
+                for (size_t i = 0; i < all.size(); ++i) all[i] = static_cast<int>(i);
+                embedDetections(dets, all, f.rgbData(), f.rgb_w, f.rgb_h, &f);
+                if (detection_cache_) detection_cache_->insert(key, dets);
+            };
+        }
+        scheduler = std::make_unique<DetectionScheduler>(
+            det_count, detect_workers,
+            [read_frame, frame_of, degraded, det_count](int j, LoadedRgbFrame& out) {
+                // Under time pressure odd ordinals but the last are decoded
+                // without RGB, which leaves them undetected.
+                const bool thin = degraded(TimeBudget::HalfDetection) && j % 2 == 1 && j != det_count - 1;
+                return read_frame(frame_of(j), !thin, out);
+            },
+            [this, reid_stage, &detect_frame, &detect_clock](const LoadedRgbFrame& f) {
+                StageClock::Scope timed(detect_clock);
+                if (!f.hasRgb()) return std::vector<Detection>{};
+                if (!reid_stage) return detect_frame(f, nullptr, 0);
+                std::vector<Detection> cached;
+                if (detection_cache_ &&
+                    detection_cache_->find(DetectionCache::FrameKey(f.rgbData(), f.rgb_w, f.rgb_h), cached)) {
+                    return cached;
+                }
+                return toDetections(detector_.Detect(f.rgbData(), f.rgb_w, f.rgb_h), f.rgbData(), f.rgb_w, f.rgb_h,
+                                    false);
+            },
+            std::move(embed),
+            resume_frame >= 0 ? (resume_frame + stride - 1) / stride : 0, memory_budget_.get(),
+            options_.balance_stages ? PipelineCoreCount() / std::max(1, detector_.NumThreads()) : 0);
+    }
+    // Speculative detection: while detected frames wait for the tracker,
+    // a spare core detects the unsampled frames just ahead of it (eager
+    // ReID included). Lazy ReID embeds in the loop, so it goes without.
+    std::unique_ptr<SpeculativeDetector> speculative;
+    if (scheduler && options_.speculative_ahead > 0 && !options_.lazy_reid && known_count > 0) {
+        speculative = std::make_unique<SpeculativeDetector>(
+            known_count, options_.speculative_ahead,
+            [read_frame](int index, LoadedRgbFrame& out) { return read_frame(index, true, out); },
+            [&detect_frame, &detect_clock](const LoadedRgbFrame& f) {
+                StageClock::Scope timed(detect_clock);
+                return detect_frame(f, nullptr, 0);
+            },
+            [is_sampled](int index) { return !is_sampled(index); },
+            [&scheduler, degraded] { return scheduler->ready() > 0 && !degraded(TimeBudget::HalfDetection); },
+            std::max(0, resume_frame));
     }
+
+    // A replay detects nothing, so no frame needs RGB.
+    const bool sampled_rgb = !policy && !replay_;
+    FrameCache::Loader decode = [read_frame, is_sampled, rgb_always, sampled_rgb, skip_unused, &scheduler,
+                                 &idle_hint](int index, LoadedRgbFrame& out) {
+        // Sampled frames come from the scheduler when there is one.
+        const bool rgb = rgb_always || (sampled_rgb && is_sampled(index));
+        const bool idle = !is_sampled(index) && idle_hint.load(std::memory_order_relaxed);
+        if ((scheduler && is_sampled(index)) || (skip_unused && !rgb) || idle) {
+            out.clear();
+            return false;
+        }
+        return read_frame(index, rgb, out);
+    };
+    std::unique_ptr<FramePrefetcher> prefetch;
+    if (options_.prefetch_depth > 0 && !replay_all) {
+        // Streams must be read in order, so they get exactly one decoder.
+        prefetch = std::make_unique<FramePrefetcher>(
+            known_count >= 0 ? known_count : std::numeric_limits<int>::max(),
+            source.randomAccess() ? FramePrefetcher::ResolveThreadCount(options_.decode_threads) : 1,
+            options_.prefetch_depth,
+            decode,
+            std::max(0, resume_frame),
+            memory_budget_ ? memory_budget_->open("decode prefetch") : nullptr,
+            options_.balance_stages && source.randomAccess() ? PipelineCoreCount() : 0);
+        decode = [&prefetch](int index, LoadedRgbFrame& out) { return prefetch->take(index, out); };
+    }
+    if (scheduler) {
+        decode = [decode, is_sampled, stride, last_frame, &scheduler, &scheduled_dets, &scheduled_mu](
+                     int index, LoadedRgbFrame& out) {
+            // Keep the decode prefetcher in step even for frames it skips.
+            const bool ok = decode(index, out);
+            if (!is_sampled(index)) return ok;
+            const int j = (index % stride == 0) ? index / stride : last_frame / stride + 1;
+            std::vector<Detection> dets;
+            const bool sampled_ok = scheduler->take(j, out, dets);
+            std::lock_guard<std::mutex> lock(scheduled_mu);
+            scheduled_dets[index] = std::move(dets);
+            return sampled_ok;
+        };
+    }
+    // Warps need only the frames, so with a known frame count they are
+    // estimated ahead of the tracker too, several pairs at once. Face masks
+    // depend on the previous frame's detections, so they keep GMC inline.
+    // Stage balancing runs even one worker as a stage, so it can grow.
+    std::unique_ptr<GmcStage> gmc_stage;
+    const int gmc_workers = GmcStage::ResolveWorkerCount(options_.gmc_workers);
+    const bool gmc_staged = gmc_workers > 1 || (options_.balance_stages && PipelineCoreCount() >= 2);
+    if (kGmcCompiled != 0 && gmc_staged && options_.prefetch_depth > 0 && known_count > 0 && !replay_all &&
+        !options_.gmc_mask_faces && !sparse_gmc.enabled()) {
+        gmc_stage = std::make_unique<GmcStage>(known_count, gmc_workers, decode, options_.gmc,
+                                               std::max(0, resume_frame), memory_budget_.get(), profile,
+                                               options_.balance_stages ? PipelineCoreCount() : 0);
+        // The stage's workers profile the estimates; the loop only picks them up.
+        gmc_clock.detachProfile();
+        decode = [&gmc_stage](int index, LoadedRgbFrame& out) { return gmc_stage->take(index, out); };
+    }
+    FrameCache frames(2, decode);
+
+    // Stage balancing: the stages ahead of the tracker trade cores as the
+    // shots change (see StageBalancer). Streams keep their one decoder.
+    std::unique_ptr<StageBalancer> balancer;
+    if (options_.balance_stages) {
+        balancer = std::make_unique<StageBalancer>(PipelineCoreCount(), options_.balance_period_ms);
+        if (prefetch && source.randomAccess()) {
+            StageBalancer::Stage st;
+            st.name = "decode";
+            st.busy_ms = [&prefetch] { return prefetch->busyMs(); };
+            st.queued = [&prefetch] { return prefetch->ready(); };
+            st.depth = options_.prefetch_depth;
+            st.units = prefetch->activeThreads();
+            st.max_units = prefetch->numThreads();
+            st.resize = [&prefetch](int n) { prefetch->setActiveThreads(n); };
+            balancer->addStage(std::move(st));
+        }
+        if (scheduler) {
+            StageBalancer::Stage st;
+            st.name = "detect";
+            st.busy_ms = [&scheduler] { return scheduler->busyMs(); };
+            st.queued = [&scheduler] { return scheduler->ready(); };
+            st.depth = 2 * scheduler->numWorkers();
+            st.units = scheduler->activeWorkers();
+            st.max_units = scheduler->numWorkers();
+            st.cores_per_unit = std::max(1, detector_.NumThreads());
+            st.resize = [&scheduler](int n) { scheduler->setActiveWorkers(n); };
+            balancer->addStage(std::move(st));
+        }
+        if (scheduler && scheduler->hasReidStage() && reid_) {
+            // One thread embeds in order; its units are the faces of a frame embedded at once.
+            StageBalancer::Stage st;
+            st.name = "reid";
+            st.busy_ms = [&scheduler] { return scheduler->embedBusyMs(); };
+            st.queued = [&scheduler] { return scheduler->embedReady(); };
+            st.depth = 2;
+            st.units = reid_->BatchWorkers();
+            st.cores_per_unit = std::max(1, reid_->NumThreads());
+            st.max_units = std::max(st.units, PipelineCoreCount() / st.cores_per_unit);
+            st.serial = true;
+            st.resize = [this](int n) { reid_->SetBatchWorkers(n); };
+            balancer->addStage(std::move(st));
+        }
+        if (gmc_stage) {
+            StageBalancer::Stage st;
+            st.name = "gmc";
+            st.busy_ms = [&gmc_stage] { return gmc_stage->busyMs(); };
+            st.queued = [&gmc_stage] { return gmc_stage->ready(); };
+            st.depth = 2 * gmc_stage->numWorkers();
+            st.units = gmc_stage->activeWorkers();
+            st.max_units = gmc_stage->numWorkers();
+            st.resize = [&gmc_stage](int n) { gmc_stage->setActiveWorkers(n); };
+            balancer->addStage(std::move(st));
+        }
+        if (balancer->stages().size() < 2) {
+            fprintf(stderr, "Warning: stage balancing needs two stages running ahead of the tracker; "
+                            "keeping their sizes\n");
+            balancer.reset();
+        }
+    }
+
+    // Dev-only: ReID quality gate health counters.
+    int reid_attempted = 0;
+    int reid_kept = 0;
+    double reid_q_sum = 0.0;
+    double reid_q_min = std::numeric_limits<double>::infinity();
+    double reid_q_max = -std::numeric_limits<double>::infinity();
+    MetricsRegistry::Histogram reid_quality;
     
-    // Phase 2: Track across all frames
+    // Phase 1+2: Detect on sampled frames and track across all frames in one pass.
     // IoU threshold controls how strict matching is between detections and predictions
     // max_age=90 (3 seconds at 30fps) allows tracks to survive long gaps
     // min_hits=1 to allow tracks from single detections (we filter later)
-    OCSort tracker(iou_thresh_, 90, 1, 3, 0.2f, use_reid_, reid_weight_, reid_cos_thresh_);
+    auto configure_tracker = [this, &tracking](OCSort& t) {
+        t.setTentative(kMinTrackObservations, tracking.track_tentative_age);
+        t.setDormantAfter(tracking.track_dormant_age);
+        t.setMinReidQuality(options_.reid.min_update_quality);
+        t.setJosephUpdate(options_.kalman_joseph);
+        t.setMotionGate(tracking.track_motion_gate);
+        t.setAppearanceStorage(options_.reid.appearance_storage);
+    };
+    OCSort tracker(iou_thresh, tracking.track_max_age, 1, 3, tracking.track_inertia, use_reid_,
+                   reid_weight, reid_cos_thresh);
+    configure_tracker(tracker);
 
-    // Global Motion Compensation (GMC): estimate camera warp between consecutive frames
-    // and apply it to track predictions before association.
-    GmcEstimator gmc(GmcConfig{});
-    LoadedRgbFrame prev_frame;
-    bool prev_ok = false;
-    int gmc_attempts = 0;
-    int gmc_ok = 0;
-    int gmc_frame_load_ok = 0;
-    
-    // Collect track data: track_id -> list of TrackFrames
-    std::map<int, std::vector<TrackFrame>> track_data;
+    // Lazy ReID: detection frames reach the tracker without embeddings, and
+    // it asks for the few it needs. `reid_frame` is the frame they came from.
+    const LoadedRgbFrame* reid_frame = nullptr;
+    int reid_offered = 0;
+    const bool lazy_reid = options_.lazy_reid && use_reid_ && !replay_;
+    if (lazy_reid) {
+        tracker.setLazyReid(
+            [&](std::vector<Detection>& dets, const std::vector<int>& indices) {
+                if (!reid_frame || degraded(TimeBudget::NoReid)) return;
+                StageClock::Scope timed(reid_clock);
+                embedDetections(dets, indices, reid_frame->rgbData(), reid_frame->rgb_w, reid_frame->rgb_h, reid_frame);
+                for (int k : indices) {
+                    const Detection& d = dets[k];
+                    reid_attempted++;
+                    reid_q_sum += static_cast<double>(d.reid_quality);
+                    reid_q_min = std::min(reid_q_min, static_cast<double>(d.reid_quality));
+                    reid_q_max = std::max(reid_q_max, static_cast<double>(d.reid_quality));
+                    reid_quality.observe(d.reid_quality);
+                    if (d.has_reid) reid_kept++;
+                }
+            },
+            options_.reid_refresh);
+    }
+
+    // Collect track data: track_data[track_id] lists its TrackFrames (the
+    // tracker numbers tracks densely from 0, so no lookup is needed)
+    std::vector<std::vector<TrackFrame>> track_data;
+    // With a budget or --memory-report, the high-water marks of the loop's
+    // own buffers are watched too (outside the budget).
+    std::unique_ptr<MemoryBudget::Account> frames_watch, dets_watch, tracks_watch;
+    if (memory_budget_) {
+        frames_watch = memory_budget_->watch("frame cache");
+        dets_watch = memory_budget_->watch("detections");
+        tracks_watch = memory_budget_->watch("track data");
+    }
+    // --metrics: per-frame association sizes and frames waiting in the queues.
+    MetricsRegistry::Histogram association_dets, association_tracks, decode_queue, detection_queue, gmc_queue;
+    auto watch_track_data = [&]() {
+        if (!tracks_watch) return;
+        size_t bytes = track_data.capacity() * sizeof(track_data[0]);
+        for (const auto& frames_of : track_data) bytes += frames_of.capacity() * sizeof(TrackFrame);
+        tracks_watch->set(bytes);
+    };
+
+    // Tile gating: between full scans only tiles around live tracks run. The
+    // scheduler detects ahead of the tracker, so gating needs inline detection.
+    const bool gate_tiles = options_.tile_refresh > 0 && options_.detector.tiles.tile_size > 0 && !scheduler;
+    std::vector<std::array<float, 4>> track_focus;  // pixel boxes, grown by their own size
+    // Adaptive input: while every track's face is large, SCRFD runs on a
+    // smaller input that still gives the smallest one adaptive_input_face
+    // input pixels (not below kMinAdaptiveInput). Every Nth detection and
+    // every shot's first runs the full input, so new small faces are found.
+    constexpr int kMinAdaptiveInput = 320;
+    const bool adaptive_input = options_.adaptive_input_face > 0 && !scheduler && !replay_;
+    int input_side = 0;  // next detection's input cap (0 = full), from the last frame's tracks
+    int reduced_detections = 0;
+    // Cascaded detection: an inline detection first runs SCRFD at
+    // cascade_input, and keeps that pass's faces unless it is in doubt: a
+    // candidate between cascade_min_score and the threshold, a face under
+    // kCascadeSmallFace coarse input pixels, or a track of the last frame
+    // no coarse face overlaps. Shot starts, tiled frames and every Nth
+    // detection run the full pass outright.
+    constexpr int kCascadeSmallFace = 16;
+    constexpr float kCascadeMatchIou = 0.3f;
+    const bool cascade =
+        options_.cascade_input > 0 && options_.cascade_input < options_.detector_input && !scheduler && !replay_;
+    std::vector<BBox> cascade_expect;  // the last frame's output tracks
+    int cascade_coarse = 0;            // detections the coarse pass settled
+    int cascade_escalated = 0;         // coarse passes the full pass ran after
+    // Stride pruning: while every track's face is large, SCRFD skips the
+    // heads only faces under half the smallest one's size need. Shot starts
+    // and every Nth detection run them all, so new small faces are found.
+    const bool prune_strides = options_.prune_strides && !scheduler && !replay_;
+    float prune_face = 0.0f;  // half the last frame's smallest track, as a fraction of the long side (0 = none)
+    int pruned_detections = 0;
+    auto detect_coarse = [&](const LoadedRgbFrame& f, std::vector<Detection>& dets) {
+        const unsigned char* rgb = f.rgbData();
+        const int w = f.rgb_w, h = f.rgb_h;
+        std::vector<ScrfdFace> faces =
+            detector_.Detect(rgb, w, h, nullptr, options_.cascade_input, std::min(options_.cascade_min_score, conf_thresh_));
+        int new_w = 0, new_h = 0, pad_w = 0, pad_h = 0;
+        const float scale = detector_.InputShape(w, h, new_w, new_h, pad_w, pad_h, options_.cascade_input);
+        std::vector<BBox> boxes;
+        for (const ScrfdFace& face : faces) {
+            if (face.score < conf_thresh_) return false;
+            const float short_side = std::min(face.bbox[2] - face.bbox[0], face.bbox[3] - face.bbox[1]);
+            if (short_side * scale < kCascadeSmallFace) return false;
+            boxes.push_back(scrfdToBBox(face, w, h));
+        }
+        for (const BBox& expected : cascade_expect) {
+            bool found = false;
+            for (const BBox& b : boxes) found = found || b.iou(expected) >= kCascadeMatchIou;
+            if (!found) return false;
+        }
+        dets = toDetections(faces, rgb, w, h, !options_.lazy_reid && !degraded(TimeBudget::NoReid), &f);
+        return true;
+    };
+    // Boundary refinement reads frames again after the run, so it needs
+    // random access and the detector; it looks between detection frames
+    // and never across a shot boundary.
+    const bool refine = tracking.refine_boundaries && !replay_ && !on_segment && source.randomAccess() &&
+                        !options_.delete_consumed;
+    if (tracking.refine_boundaries && options_.delete_consumed) {
+        fprintf(stderr, "Warning: boundary refinement reads deleted frames again; not refining\n");
+    }
+    std::vector<int> detected_at;  // detection frames, ascending
+    // Cuts the editor knows of are taken as they are: they reset the tracker,
+    // detect and skip GMC like detected ones, and split shot-parallel work.
+    std::vector<int> editor_cuts = tracking.cut_frames;
+    std::sort(editor_cuts.begin(), editor_cuts.end());
+    editor_cuts.erase(std::unique(editor_cuts.begin(), editor_cuts.end()), editor_cuts.end());
+    std::vector<int> shot_starts;  // frames a scene cut started a shot on
+    // Foreground left out of GMC: the latest frame's detections, in its
+    // pixels. Detections rather than tracks, so deferred tracking sees the
+    // same warps as inline tracking.
+    GmcEstimator::ExcludeBoxes gmc_exclude;
+    int inline_detections = 0;
+    int detection_frames = 0;
+    LoadedRgbFrame redecoded;  // detection frames first decoded without RGB
+
+    // Shot-parallel tracking: no track survives a scene cut, so each shot can
+    // be tracked by an OCSort of its own. When nothing in the loop feeds on
+    // tracker output, the loop only records each frame's tracker input per
+    // shot, and the shots are tracked concurrently afterwards. The recorded
+    // input also serves a second, reverse-time pass (bidirectional tracking).
+    const int track_workers = options_.track_workers > 0 ? options_.track_workers : PipelineCoreCount();
+    // Checkpoints save the tracker as it goes, and streamed segments leave
+    // as their tracks end, so they count as well.
+    const bool loop_reads_tracks =
+        policy || roi_detect || landmark_flow || gate_tiles || adaptive_input || cascade || prune_strides ||
+        coarse_scan || lazy_reid || checkpoints || on_segment;
+    const bool bidirectional = options_.bidirectional_tracking && (!loop_reads_tracks || replay_all);
+    if (options_.bidirectional_tracking && !bidirectional) {
+        fprintf(stderr, "Warning: bidirectional tracking needs fixed-stride, full-frame detection, eager ReID "
+                        "and no checkpoints; tracking forward only\n");
+    }
+    const bool defer_tracking =
+        replay_all || bidirectional ||
+        (track_workers > 1 && (options_.scene_cuts.enabled || !editor_cuts.empty()) && !loop_reads_tracks);
+    std::vector<std::vector<TrackerInputFrame>> shots(1);
+
+    // ROI detection: between detections, SCRFD runs only on crops around the
+    // boxes the tracks had on the previous frame, so tracks get observations
+    // on every frame instead of coasting. New faces still wait for the next
+    // full-frame detection.
+    std::vector<BBox> roi_boxes;  // normalized, from the previous frame
+    LandmarkFlow flow;
+    std::vector<TrackCue> flow_cues;
+    std::vector<std::array<int, 4>> rois;
+    int roi_mosaic_passes = 0;  // detector inputs the ROI crops were packed into
+    int roi_mosaic_crops = 0;
+
+    // Duplicate frames (freeze frames, stills, slow-motion repeats) skip GMC,
+    // detection and the tracker: the previous frame's tracks are emitted
+    // again, and a detection they were due moves to the next new frame.
+    std::vector<TrackResult> active_tracks;
+    int duplicate_frames = 0;
+    bool detection_pending = false;
 
     auto clamp01 = [](float v) { return std::max(0.0f, std::min(1.0f, v)); };
     auto clampBBox01 = [&](const BBox& b) {
@@ -297,82 +1339,998 @@ PipelineResult FacePipeline::process(const std::vector<std::string>& image_paths
             clamp01(b.y2),
         };
     };
+    // Record track frames (skip degenerate bboxes)
+    // Note: When `return_all=true`, OC-SORT will also emit predictions on frames
+    // without a matched detection. We drop ultra-low-confidence predictions to
+    // avoid "ghost" boxes lingering and accidentally blurring the wrong region.
+    constexpr float kMinOutputConfidence = 0.05f;
+    auto record_tracks = [&](const std::vector<TrackResult>& tracks,
+                             std::vector<std::vector<TrackFrame>>& sink,
+                             int frame_index) {
+        for (const TrackResult& track_result : tracks) {
+            const BBox bbox = clampBBox01(track_result.bbox);
+            // Skip degenerate boxes (zero or near-zero dimensions)
+            if (bbox.width() < 0.01f || bbox.height() < 0.01f) {
+                continue;
+            }
+            if (track_result.confidence < kMinOutputConfidence) {
+                continue;
+            }
+            const size_t track_id = static_cast<size_t>(track_result.track_id);
+            if (track_id >= sink.size()) sink.resize(track_id + 1);
+            sink[track_id].push_back(TrackFrame{
+                frame_index,
+                bbox,
+                track_result.confidence,
+                track_result.time_since_update == 0
+            });
+        }
+    };
     
-    for (int i = 0; i < result.frame_count; ++i) {
-        LoadedRgbFrame cur_frame;
-        const bool cur_ok = LoadRgbFrame(image_paths[i], cur_frame);
+    auto summarize = [this](int id, const std::vector<TrackFrame>& frames) {
+        return SummarizeTracklet(id, frames, conf_thresh_);
+    };
+    // Fixed-lag RTS smoothing of a tracklet's boxes.
+    FixedLagSmoother smoother(tracking.smooth_lag);
+    std::vector<int> smooth_frames;
+    std::vector<char> smooth_observed;
+    std::vector<BBox> smooth_boxes;
+    auto smooth_track = [&](std::vector<TrackFrame>& frames) {
+        smooth_frames.clear();
+        smooth_observed.clear();
+        smooth_boxes.clear();
+        for (const TrackFrame& f : frames) {
+            smooth_frames.push_back(f.frame_index);
+            smooth_observed.push_back(f.observed);
+            smooth_boxes.push_back(f.bbox);
+        }
+        smoother.smooth(smooth_frames, smooth_observed, smooth_boxes);
+        for (size_t k = 0; k < frames.size(); ++k) frames[k].bbox = clampBBox01(smooth_boxes[k]);
+    };
+
+    // Streaming: a track the tracker dropped never comes back, so its frames
+    // go to `on_segment` and only its summary stays for offline linking.
+    // Every live track is in active_tracks (min_hits = 1) or dormant, so the
+    // ones that were there after the previous update and are gone now have
+    // ended.
+    std::map<int, TrackletSummary> released_segments;
+    // Compact tracks: finished tracklets leave track_data for the store,
+    // summarized first. In the loop they leave as they end, like streamed
+    // ones (not with checkpoints, which save track_data), the others once
+    // tracking is done.
+    TrackStore store(static_cast<size_t>(std::max(0, options_.track_spill_mb)) << 20,
+                     memory_budget_ ? memory_budget_->open("tracks") : nullptr);
+    std::map<int, TrackletSummary> stored_summaries;
+    const bool compact_in_loop = options_.compact_tracks && !on_segment && !checkpoints && !defer_tracking;
+    auto store_tracklet = [&](int id) {
+        stored_summaries[id] = summarize(id, track_data[id]);
+        store.put(id, track_data[id]);
+        std::vector<TrackFrame>().swap(track_data[id]);
+    };
+    std::vector<int> live_ids;
+    std::vector<int> ended_ids;
+    std::vector<int> dormant_ids;
+    auto release_ended = [&]() {
+        ended_ids.clear();
+        dormant_ids.clear();
+        size_t k = 0;
+        for (int id : live_ids) {
+            while (k < active_tracks.size() && active_tracks[k].track_id < id) k++;
+            if (k < active_tracks.size() && active_tracks[k].track_id == id) continue;
+            (tracker.isDormant(id) ? dormant_ids : ended_ids).push_back(id);
+        }
+        live_ids.clear();
+        for (const TrackResult& t : active_tracks) live_ids.push_back(t.track_id);
+        if (!dormant_ids.empty()) {
+            const auto mid = live_ids.insert(live_ids.end(), dormant_ids.begin(), dormant_ids.end());
+            std::inplace_merge(live_ids.begin(), mid, live_ids.end());
+        }
+        for (int id : ended_ids) {
+            if (static_cast<size_t>(id) >= track_data.size() || track_data[id].empty()) continue;
+            if (tracking.smooth_lag > 0) smooth_track(track_data[id]);
+            if (!on_segment) {
+                store_tracklet(id);
+                continue;
+            }
+            released_segments[id] = summarize(id, track_data[id]);
+            FaceTrack segment;
+            segment.id = id;
+            segment.frames.swap(track_data[id]);
+            on_segment(segment);
+        }
+    };
+
+    // Appearance eviction: linking pairs a tracklet only with one starting
+    // within the long link gap after it ends (LinkMaxGapFrames), so once
+    // that window has passed without a track starting in it, and no track
+    // could have ended in the window before it started, its appearance is
+    // never compared and its row is freed. Tracks have summaries by then
+    // only when they leave as they end; the gallery and kept appearances
+    // need every row.
+    const bool evict_appearances = use_reid_ && (on_segment || compact_in_loop) && options_.gallery_path.empty() &&
+                                   !options_.keep_appearances;
+    const int link_gap = LinkMaxGapFrames(video_fps, options_.reid);
+    std::vector<int> track_starts;       // start frame of every track seen, in ID order
+    std::vector<char> may_follow;        // by ID: a track could have ended within the gap before it started
+    std::vector<std::pair<int, int>> unfollowed;  // (ID, end frame) of ended tracks nothing could follow yet
+    int last_end = std::numeric_limits<int>::min() / 2;  // latest end frame of an ended track
+    int appearances_evicted = 0;
+    auto evict_unlinkable = [&](int frame) {
+        for (int id : ended_ids) {
+            const auto released = released_segments.find(id);
+            const auto stored = stored_summaries.find(id);
+            const TrackletSummary* summary = released != released_segments.end() ? &released->second
+                                             : stored != stored_summaries.end() ? &stored->second
+                                                                                : nullptr;
+            if (!summary) {
+                if (tracker.appearances().get(id)) appearances_evicted++;
+                tracker.appearances().evict(id);  // no tracklet, nothing to link
+                continue;
+            }
+            last_end = std::max(last_end, summary->end_frame);
+            if (static_cast<size_t>(id) < may_follow.size() && may_follow[id]) continue;
+            unfollowed.emplace_back(id, summary->end_frame);
+        }
+        const int seen = static_cast<int>(track_starts.size());
+        size_t born = 0;
+        for (const TrackResult& t : active_tracks) born += t.track_id >= seen ? 1 : 0;
+        for (const TrackResult& t : active_tracks) {
+            if (t.track_id < static_cast<int>(track_starts.size())) continue;
+            const std::vector<TrackFrame>& data = track_data[t.track_id];
+            const int start = data.empty() ? frame : std::min(frame, data.front().frame_index);
+            // IDs skipped (tracks that never reached the output) get this start too.
+            track_starts.resize(static_cast<size_t>(t.track_id) + 1, start);
+            may_follow.resize(track_starts.size(), 1);
+            // Whatever ends within the gap before it is still alive, or has ended already.
+            may_follow[t.track_id] = live_ids.size() > born || last_end >= start - link_gap;
+        }
+        size_t kept = 0;
+        for (const auto& [id, end] : unfollowed) {
+            const auto next = std::upper_bound(track_starts.begin(), track_starts.end(), end);
+            if (next != track_starts.end() && *next <= end + link_gap) continue;  // may link to it
+            if (frame <= end + link_gap) {
+                unfollowed[kept++] = {id, end};
+                continue;
+            }
+            if (tracker.appearances().get(id)) appearances_evicted++;
+            tracker.appearances().evict(id);
+        }
+        unfollowed.resize(kept);
+    };
+
+    // Checkpoint layout: the header, the loop state in this order, then the
+    // tracker (OCSort::save). Track frames only grow while checkpointing
+    // (no track is released in the loop), so they go to a journal next to
+    // the checkpoint instead: each checkpoint appends the frames recorded
+    // since the previous one and keeps how many records it covers. A
+    // checkpoint costs its loop state and tracker, not the whole run so far.
+    const std::string journal_path = options_.checkpoint_path + ".tracks";
+    std::unique_ptr<FILE, int (*)(FILE*)> journal(nullptr, &std::fclose);
+    uint64_t journal_records = 0;
+    std::vector<size_t> journaled;  // by track ID: frames already in the journal
+    auto append_journal = [&]() {
+        if (!journal) journal.reset(std::fopen(journal_path.c_str(), "wb"));
+        if (!journal) return false;
+        CheckpointWriter w(journal.get());
+        journaled.resize(track_data.size(), 0);
+        for (size_t id = 0; id < track_data.size(); ++id) {
+            for (size_t k = journaled[id]; k < track_data[id].size(); ++k) {
+                w.put(TrackJournalRecord{static_cast<int32_t>(id), track_data[id][k]});
+                journal_records++;
+            }
+            journaled[id] = track_data[id].size();
+        }
+        return w.ok() && std::fflush(journal.get()) == 0;
+    };
+    auto write_checkpoint = [&](int frame, int frame_width, int frame_height) {
+        if (!append_journal()) return false;
+        const std::string tmp = options_.checkpoint_path + ".tmp";
+        FILE* f = std::fopen(tmp.c_str(), "wb");
+        bool ok = f != nullptr;
+        if (f) {
+            CheckpointWriter w(f);
+            CheckpointHeader hdr = checkpoint_hdr;
+            hdr.frame = frame;
+            hdr.frame_names = frame_names_key(frame);
+            hdr.frame_width = frame_width;
+            hdr.frame_height = frame_height;
+            w.put(hdr);
+            w.put(result.frame_count);
+            w.put(gmc_attempts);
+            w.put(gmc_ok);
+            w.put(gmc_frame_load_ok);
+            w.put(detection_frames);
+            w.put(inline_detections);
+            w.put(duplicate_frames);
+            w.put(detection_pending);
+            w.put(scene_cuts.state());
+            w.put(static_camera.state());
+            w.put(sparse_gmc.state());
+            w.putVector(sparse_gmc.keyLumaPlane());
+            w.putVector(sparse_gmc.keyCoarsePlane());
+            w.putVector(active_tracks);
+            w.putVector(roi_boxes);
+            w.putVector(flow.tracks());
+            w.putVector(track_focus);
+            w.put(input_side);
+            w.put(reduced_detections);
+            w.putVector(cascade_expect);
+            w.put(cascade_coarse);
+            w.put(cascade_escalated);
+            w.put(prune_face);
+            w.put(pruned_detections);
+            w.put(roi_mosaic_passes);
+            w.put(roi_mosaic_crops);
+            w.putVector(gmc_exclude);
+            w.put<uint64_t>(track_data.size());
+            w.put(journal_records);
+            tracker.save(w);
+            ok = (std::fclose(f) == 0) && w.ok();
+        }
+        if (ok) {
+            std::remove(options_.checkpoint_path.c_str());  // rename does not replace on Windows
+            ok = std::rename(tmp.c_str(), options_.checkpoint_path.c_str()) == 0;
+        }
+        if (!ok) std::remove(tmp.c_str());
+        return ok;
+    };
+    int first_frame = 0;
+    if (resume_file) {
+        constexpr uint64_t kMaxTrackIds = uint64_t{1} << 24;  // sanity bound on track_data
+        CheckpointReader r(resume_file.get());
+        r.get(result.frame_count);
+        r.get(gmc_attempts);
+        r.get(gmc_ok);
+        r.get(gmc_frame_load_ok);
+        r.get(detection_frames);
+        r.get(inline_detections);
+        r.get(duplicate_frames);
+        r.get(detection_pending);
+        scene_cuts.restore(r.get<SceneCutDetector::State>());
+        static_camera.restore(r.get<StaticCameraGate::State>());
+        sparse_gmc.restore(r.get<SparseGmc::State>());
+        r.getVector(sparse_gmc.keyLumaPlane());
+        r.getVector(sparse_gmc.keyCoarsePlane());
+        r.getVector(active_tracks);
+        r.getVector(roi_boxes);
+        r.getVector(flow.tracks());
+        r.getVector(track_focus);
+        r.get(input_side);
+        r.get(reduced_detections);
+        r.getVector(cascade_expect);
+        r.get(cascade_coarse);
+        r.get(cascade_escalated);
+        r.get(prune_face);
+        r.get(pruned_detections);
+        r.get(roi_mosaic_passes);
+        r.get(roi_mosaic_crops);
+        r.getVector(gmc_exclude);
+        const uint64_t track_ids = r.get<uint64_t>();
+        if (track_ids > kMaxTrackIds) r.fail();
+        if (r.ok()) track_data.resize(static_cast<size_t>(track_ids));
+        const uint64_t records = r.get<uint64_t>();
+        // Records past the checkpoint's (a later checkpoint that never got
+        // renamed in) are written over from here on.
+        journal.reset(r.ok() ? std::fopen(journal_path.c_str(), "r+b") : nullptr);
+        if (!journal) r.fail();
+        CheckpointReader jr(journal.get());
+        for (uint64_t k = 0; k < records && r.ok() && jr.ok(); ++k) {
+            const TrackJournalRecord rec = jr.get<TrackJournalRecord>();
+            if (rec.track_id < 0 || static_cast<uint64_t>(rec.track_id) >= track_ids) jr.fail();
+            if (jr.ok()) track_data[static_cast<size_t>(rec.track_id)].push_back(rec.frame);
+        }
+        if (!jr.ok() || (journal && std::fseek(journal.get(), 0, SEEK_CUR) != 0)) r.fail();
+        journal_records = records;
+        journaled.resize(track_data.size());
+        for (size_t id = 0; id < track_data.size(); ++id) journaled[id] = track_data[id].size();
+        if (tracker.load(r) && r.ok()) {
+            // The resumed frame is decoded again: GMC and duplicate
+            // detection on the next frame look back at it.
+            frames.get(resume_frame);
+            std::lock_guard<std::mutex> lock(scheduled_mu);
+            scheduled_dets.erase(resume_frame);
+            first_frame = resume_frame + 1;
+        } else {
+            fprintf(stderr, "Warning: checkpoint %s is truncated; starting from the first frame\n",
+                    options_.checkpoint_path.c_str());
+            result.frame_count = 0;
+            gmc_attempts = gmc_ok = gmc_frame_load_ok = 0;
+            detection_frames = inline_detections = duplicate_frames = 0;
+            detection_pending = false;
+            scene_cuts.restore(SceneCutDetector::State{});
+            static_camera.restore(StaticCameraGate::State{});
+            sparse_gmc = SparseGmc(options_.sparse_gmc);
+            active_tracks.clear();
+            roi_boxes.clear();
+            track_focus.clear();
+            cascade_expect.clear();
+            gmc_exclude.clear();
+            track_data.clear();
+            journal.reset();
+            journal_records = 0;
+            journaled.clear();
+        }
+        resume_file.reset();
+    }
+    // Replays take the dump's detections like the scheduler's. A dump with
+    // warps is the recorded input of every shot, so there is no loop.
+    if (replay_all) {
+        for (const TrackerInputFrame& f : replay_->frames) {
+            if (f.scene_cut) shots.emplace_back();
+            shots.back().push_back(f);
+            if (f.duplicate) duplicate_frames++;
+            if (result.frame_width == 0 && f.width > 0) {
+                result.frame_width = f.width;
+                result.frame_height = f.height;
+            }
+        }
+        result.frame_count = known_count;
+        first_frame = known_count;
+    }
+    // Otherwise the loop copies each frame's detections out of the dump as
+    // it reaches the frame (records ascend by frame), so the run does not
+    // hold a second copy of the whole clip's detections.
+    size_t replay_next = 0;
+    std::unique_ptr<DetectionDumpWriter> dump;
+    if (!options_.dump_detections_path.empty() && !replay_all) {
+        if (lazy_reid) fprintf(stderr, "Warning: with lazy ReID the detection dump has no embeddings\n");
+        dump = std::make_unique<DetectionDumpWriter>();
+        std::string error;
+        if (!dump->open(options_.dump_detections_path, options_.dump_warps, use_reid_ && !lazy_reid, stride, error)) {
+            fprintf(stderr, "Warning: %s; not dumping detections\n", error.c_str());
+            dump.reset();
+        }
+    }
+    // Idle fast-forward (see idle_hint): frames with no track to follow
+    // and no detection due produce no output, so they skip GMC and the
+    // tracker as well. Frames it skips are never seen by anything that
+    // records every frame (dumps, proxies, deferred tracking) or detects
+    // between samples (the policy, speculative or light detection, replays).
+    // Video skips forward too; with samples on keyframes, whole GOPs go
+    // undecoded.
+    const bool fast_forward = options_.idle_fast_forward && !policy && !replay_ && !defer_tracking && !dump &&
+                              !proxies && !speculative && !light_detect &&
+                              (source.randomAccess() ? known_count > 0 : source.skipsForward());
+    if (options_.idle_fast_forward && !fast_forward) {
+        fprintf(stderr, "Warning: idle fast-forward needs fixed-stride detection of input that can skip frames, "
+                        "without dumps, proxies, speculative, light or deferred tracking; decoding every frame\n");
+    }
+    int idle_skipped = 0;
+    int light_detections = 0;  // frames the hybrid schedule's light detector ran on
+    const int checkpoint_every = std::max(1, options_.checkpoint_every);
+    int last_checkpoint = first_frame;
+    bool checkpoint_failed = false;
+
+    // Page-cache hints for image files: read the next ones in early, and
+    // let go of those behind the tracker (a re-read, e.g. by boundary
+    // refinement, just goes back to storage).
+    const int advise_ahead = known_count > 0 && !source.filePath(0).empty() ? std::max(0, options_.advise_ahead) : 0;
+    int advised = first_frame;
+    // Once the tracker is past a frame, every stage is done with its file:
+    // decoders, detection and GMC only work ahead of it, and lazy ReID and
+    // re-decodes for detection within its iteration. Temporary sequences
+    // (--delete-consumed) are then removed, so only the frames ahead of the
+    // tracker take disk space.
+    const bool release_files = options_.delete_consumed || options_.drop_file_cache;
+    int files_deleted = 0;
+    bool delete_failed = false;
+    auto release_file = [&](int index) {
+        const std::string path = source.filePath(index);
+        if (path.empty()) return;
+        if (!options_.delete_consumed) {
+            AdviseFileCache(path, FileCacheHint::Done);
+        } else if (std::remove(path.c_str()) == 0) {
+            files_deleted++;
+        } else if (!delete_failed) {
+            fprintf(stderr, "Warning: cannot delete consumed frame %s\n", path.c_str());
+            delete_failed = true;
+        }
+    };
+
+    const auto loop_start = std::chrono::steady_clock::now();
+    for (int i = first_frame; known_count < 0 || i < known_count; ++i) {
+        for (; advise_ahead > 0 && advised < std::min(known_count, i + advise_ahead + 1); ++advised) {
+            if (!skip_unused || is_sampled(advised)) {
+                AdviseFileCache(source.filePath(advised), FileCacheHint::WillNeed);
+            }
+        }
+        if (tracking.stop && tracking.stop->load()) {
+            result.stopped = true;
+            break;
+        }
+        if (budget) {
+            budget->observe(i - first_frame, known_count < 0 ? -1 : known_count - first_frame);
+            if (budget->expired()) {
+                result.stopped = true;
+                break;
+            }
+        }
+        FrameCache::FramePtr cur_frame;
+        {
+            StageClock::Scope timed(wait_clock, i);
+            cur_frame = frames.get(i);
+        }
+        if (release_files && i > first_frame) release_file(i - 1);
+        if (balancer) balancer->poll();
+        if (metrics) {
+            if (prefetch) decode_queue.observe(prefetch->ready());
+            if (scheduler) detection_queue.observe(scheduler->ready());
+            if (gmc_stage) gmc_queue.observe(gmc_stage->ready());
+        }
+        if (!cur_frame) {
+            const int end = source.endIndex();
+            if (end >= 0 && i >= end) break;
+        }
+        if (tracking.progress) tracking.progress("frames", i, known_count);
+        result.frame_count = i + 1;
+        if (fast_forward && tracker.idle()) {
+            // A detection pending since a repeated frame waits for the next
+            // sampled one: with no track, there is nothing for it to catch up.
+            const bool due = grid.contains(i) || i == last_frame ||
+                             std::binary_search(editor_cuts.begin(), editor_cuts.end(), i);
+            if (!due) {
+                // Camera-motion state would span the gap; start it afresh.
+                idle_skipped++;
+                tracker.skipIdleFrame();
+                static_camera.reset();
+                sparse_gmc.reset();
+                continue;
+            }
+        }
+        if (fast_forward && !cur_frame && !is_sampled(i) && source.randomAccess()) {
+            // Passed over while the tracker was idle, and needed after all
+            // (streams cannot go back: the track predicts without GMC).
+            cur_frame = frames.reload(i, [&read_frame, rgb_always](int index, LoadedRgbFrame& out) {
+                return read_frame(index, rgb_always, out);
+            });
+        }
+        const FrameCache::FramePtr prev_frame = (i > 0) ? frames.peek(i - 1) : nullptr;
+        const bool cur_ok = (cur_frame != nullptr);
         if (cur_ok) gmc_frame_load_ok++;
+        if (proxies && cur_ok) proxies->submit(i, cur_frame);
+        if (cur_ok && result.frame_width == 0) {
+            result.frame_width = cur_frame->w;
+            result.frame_height = cur_frame->h;
+        }
         Mat3f warp_prev_to_curr = Mat3f::Identity();
         bool warp_ok = false;
-        if (i > 0 && prev_ok && cur_ok) {
-            gmc_attempts++;
-            warp_ok = gmc.Estimate(cur_frame.rgb.data(), cur_frame.w, cur_frame.h,
-                                   prev_frame.rgb.data(), prev_frame.w, prev_frame.h,
-                                   warp_prev_to_curr);
-            if (warp_ok) gmc_ok++;
+        const bool luma_pair = prev_frame && cur_ok && cur_frame->hasLuma() && prev_frame->hasLuma() &&
+                               cur_frame->luma_w == prev_frame->luma_w && cur_frame->luma_h == prev_frame->luma_h;
+        if (options_.duplicate_block_diff > 0.0f && luma_pair &&
+            IsDuplicateFrame(cur_frame->lumaData(), prev_frame->lumaData(), cur_frame->luma_w, cur_frame->luma_h,
+                             options_.duplicate_block_diff)) {
+            duplicate_frames++;
+            if (!policy && grid.contains(i) && (in_scan_window(i) || !active_tracks.empty())) detection_pending = true;
+            {
+                std::lock_guard<std::mutex> lock(scheduled_mu);
+                scheduled_dets.erase(i);
+            }
+            if (defer_tracking || dump) {
+                TrackerInputFrame repeat;
+                repeat.frame_index = i;
+                repeat.duplicate = true;
+                if (dump) dump->write(repeat, false);
+                if (defer_tracking) shots.back().push_back(std::move(repeat));
+            }
+            if (!defer_tracking) record_tracks(active_tracks, track_data, i);
+            continue;
         }
+        const bool detected_cut = options_.scene_cuts.enabled && luma_pair &&
+                                  scene_cuts.Update(cur_frame->lumaData(), prev_frame->lumaData(),
+                                                    cur_frame->luma_w, cur_frame->luma_h);
+        const bool scene_cut =
+            detected_cut || (i > 0 && std::binary_search(editor_cuts.begin(), editor_cuts.end(), i));
+        if (scene_cut) {
+            if (refine) shot_starts.push_back(i);
+            tracker.endShot();
+            roi_boxes.clear();
+            flow.reset();
+            gmc_exclude.clear();
+            if (defer_tracking) shots.emplace_back();
+            static_camera.reset();
+            sparse_gmc.reset();
+            if (gmc_stage) gmc_stage->setPaused(degraded(TimeBudget::NoGmc));
+        } else if (degraded(TimeBudget::NoGmc)) {
+            if (gmc_stage) gmc_stage->setPaused(true);
+        } else if (kGmcCompiled != 0 && luma_pair && static_camera.shouldEstimate()) {
+            // Decoder motion vectors come for free; pixels cover frames
+            // without them (intra-coded, or vectors that fit no motion).
+            const GmcEstimator::ExcludeBoxes* exclude = options_.gmc_mask_faces ? &gmc_exclude : nullptr;
+            StageClock::Scope timed(gmc_clock, i);
+            const bool carried = cur_frame->motion_vectors.empty() && !static_camera.isStatic() &&
+                                 sparse_gmc.carry(warp_prev_to_curr);
+            if (carried) {
+                warp_ok = true;
+            } else {
+                gmc_attempts++;
+                if (!cur_frame->motion_vectors.empty()) {
+                    warp_ok = gmc.EstimateVectors(cur_frame->motion_vectors, cur_frame->w, cur_frame->h,
+                                                  warp_prev_to_curr, exclude);
+                }
+                auto estimate_luma = [&](const uint8_t* prev_luma, const uint8_t* prev_coarse) {
+                    return gmc.EstimateLuma(cur_frame->lumaData(), prev_luma, cur_frame->luma_w, cur_frame->luma_h,
+                                            cur_frame->luma_scale, warp_prev_to_curr,
+                                            cur_frame->luma_coarse.empty() ? nullptr : cur_frame->luma_coarse.data(),
+                                            prev_coarse, exclude);
+                };
+                bool from_key = !warp_ok && sparse_gmc.keyDue(cur_frame->luma_w, cur_frame->luma_h);
+                if (from_key) {
+                    warp_ok = estimate_luma(sparse_gmc.keyLuma(), sparse_gmc.keyCoarse());
+                    from_key = warp_ok;
+                }
+                if (!warp_ok && (!gmc_stage || !gmc_stage->takeWarp(i, warp_prev_to_curr, warp_ok))) {
+                    warp_ok = estimate_luma(prev_frame->lumaData(),
+                                            prev_frame->luma_coarse.empty() ? nullptr : prev_frame->luma_coarse.data());
+                }
+                sparse_gmc.observe(from_key, warp_ok, warp_prev_to_curr, cur_frame->lumaData(), cur_frame->luma_w,
+                                   cur_frame->luma_h, cur_frame->luma_coarse, cur_frame->w, cur_frame->h);
+                if (warp_ok) gmc_ok++;
+                static_camera.observe(warp_ok, warp_prev_to_curr);
+                if (static_camera.isStatic()) sparse_gmc.reset();
+            }
+            if (gmc_stage) gmc_stage->setPaused(static_camera.isStatic());
+        }
+        if (policy && warp_ok) policy->observeWarp(warp_prev_to_curr, cur_frame->w, cur_frame->h);
 
-        // Check if this is a detection frame
-        auto det_it = detections.find(i);
-        bool is_detection_frame = (det_it != detections.end());
-        
-        // Only pass detections on actual detection frames
+        // Sampled frames (plus the last frame) are detection frames, unless
+        // the adaptive policy picks them.
         // On non-detection frames, pass empty vector - tracker will predict only
+        bool at_end = (i == last_frame);
+        if (known_count < 0 && cur_ok && source.randomAccess() && (policy || !grid.contains(i)) &&
+            !source.waitForFrame(i + 1)) {
+            // Open-ended input only learns its last frame here.
+            at_end = true;
+        }
+        // Under time pressure every other sampled frame goes undetected (the
+        // scheduler decodes those without RGB).
+        const bool thinned = !policy && grid.contains(i) && !at_end && !scene_cut &&
+                             (scheduler ? budget && cur_ok && !cur_frame->hasRgb()
+                                        : degraded(TimeBudget::HalfDetection) && grid.ordinal(i) % 2 == 1);
+        // The first frame of a shot detects at once instead of waiting for
+        // the next sampled frame (streams have no RGB to detect on there).
+        const bool sampled = grid.contains(i) && (in_scan_window(i) || !active_tracks.empty());
+        const bool is_detection_frame = policy ? policy->decide(i == 0 || at_end || scene_cut)
+                                               : (sampled && !thinned) || at_end || scene_cut || detection_pending;
+        detection_pending = false;
+        if (is_detection_frame) detection_frames++;
+        if (refine && is_detection_frame) detected_at.push_back(i);
+        const LoadedRgbFrame* det_frame = cur_ok ? cur_frame.get() : nullptr;
+        if (is_detection_frame && det_frame && !det_frame->hasRgb() && source.randomAccess() && !replay_) {
+            // Decoded for GMC alone (the last frame of open-ended input, or a
+            // frame the policy picked), so read it again with RGB.
+            FrameRequest req;
+            req.rgb = true;
+            req.rgb_min_long_side = decode_long_side;
+            det_frame = source.read(i, req, redecoded) ? &redecoded : nullptr;
+        }
         std::vector<Detection> frame_dets;
-        if (is_detection_frame) {
-            frame_dets = det_it->second;
+        reid_frame = nullptr;
+        bool has_scheduled = false;
+        if (replay_ && !replay_all) {
+            // Records of frames skipped as duplicates are passed over here.
+            const std::vector<TrackerInputFrame>& recorded = replay_->frames;
+            while (replay_next < recorded.size() && recorded[replay_next].frame_index < i) replay_next++;
+            if (replay_next < recorded.size() && recorded[replay_next].frame_index == i) {
+                frame_dets = recorded[replay_next++].dets;
+                has_scheduled = true;
+            }
+        } else {
+            std::unique_lock<std::mutex> scheduled_lock(scheduled_mu);
+            auto scheduled = scheduled_dets.find(i);
+            // A scene cut on a frame the scheduler thinned out was read again
+            // above, and detects inline.
+            has_scheduled = scheduled != scheduled_dets.end() && det_frame == (cur_ok ? cur_frame.get() : nullptr);
+            if (scheduled != scheduled_dets.end()) {
+                if (has_scheduled) frame_dets = std::move(scheduled->second);
+                scheduled_dets.erase(scheduled);
+            }
         }
-        
+        if (has_scheduled) {
+            reid_frame = cur_ok && cur_frame->hasRgb() ? cur_frame.get() : nullptr;
+        } else if (is_detection_frame && det_frame && det_frame->hasRgb()) {
+            reid_frame = det_frame;
+            const bool full_scan = !gate_tiles || scene_cut || inline_detections % options_.tile_refresh == 0;
+            const bool full_input = !adaptive_input || scene_cut ||
+                                    inline_detections % std::max(1, options_.adaptive_input_refresh) == 0;
+            const int max_side = full_input ? 0 : input_side;
+            const bool coarse_first = cascade && max_side == 0 && !scene_cut &&
+                                      inline_detections % std::max(1, options_.cascade_refresh) != 0 &&
+                                      !detector_.UsesTiles(det_frame->rgb_w, det_frame->rgb_h);
+            const bool all_strides = !prune_strides || scene_cut ||
+                                     inline_detections % std::max(1, options_.prune_refresh) == 0;
+            const int min_face = all_strides ? 0
+                                             : static_cast<int>(prune_face *
+                                                                std::max(det_frame->rgb_w, det_frame->rgb_h));
+            if (max_side > 0) reduced_detections++;
+            if (min_face > 0) pruned_detections++;
+            inline_detections++;
+            StageClock::Scope timed(detect_clock, i);
+            if (coarse_first && detect_coarse(*det_frame, frame_dets)) {
+                cascade_coarse++;
+            } else {
+                if (coarse_first) cascade_escalated++;
+                frame_dets = detect_frame(*det_frame, full_scan ? nullptr : &track_focus, max_side, min_face);
+            }
+        } else if (speculative && !is_detection_frame && speculative->take(i, frame_dets)) {
+            // Detected on a spare core before the tracker got here.
+        } else if (light_detect && !is_detection_frame && cur_ok && cur_frame->hasRgb() &&
+                   !degraded(TimeBudget::HalfDetection)) {
+            // Between SCRFD's samples the light detector covers every frame;
+            // its faces go without ReID, SCRFD embeds the tracks it confirms.
+            StageClock::Scope timed(detect_clock, i);
+            frame_dets = toDetections(light_detector_->DetectFaces(cur_frame->rgbData(), cur_frame->rgb_w,
+                                                                    cur_frame->rgb_h),
+                                      cur_frame->rgbData(), cur_frame->rgb_w, cur_frame->rgb_h, false);
+            light_detections++;
+        } else if (roi_detect && !is_detection_frame && !roi_boxes.empty() && cur_ok && cur_frame->hasRgb() &&
+                   !degraded(TimeBudget::HalfDetection)) {
+            const int fw = cur_frame->rgb_w;
+            const int fh = cur_frame->rgb_h;
+            rois.clear();
+            int64_t roi_pixels = 0;
+            for (const BBox& b : roi_boxes) {
+                const float mx = b.width() * options_.roi_margin;
+                const float my = b.height() * options_.roi_margin;
+                const int x1 = std::max(0, static_cast<int>((b.x1 - mx) * fw));
+                const int y1 = std::max(0, static_cast<int>((b.y1 - my) * fh));
+                const int x2 = std::min(fw, static_cast<int>(std::ceil((b.x2 + mx) * fw)));
+                const int y2 = std::min(fh, static_cast<int>(std::ceil((b.y2 + my) * fh)));
+                if (x2 - x1 < 8 || y2 - y1 < 8) continue;
+                rois.push_back({x1, y1, x2 - x1, y2 - y1});
+                const int side = std::min(options_.roi_side, std::max(x2 - x1, y2 - y1));
+                roi_pixels += static_cast<int64_t>(side) * side;
+            }
+            // Crowded frames: once the crops cost more than a full-frame
+            // pass, leave them to the next detection.
+            int new_w = 0, new_h = 0, pad_w = 0, pad_h = 0;
+            detector_.InputShape(fw, fh, new_w, new_h, pad_w, pad_h);
+            if (!rois.empty() && roi_pixels < static_cast<int64_t>(pad_w) * pad_h) {
+                StageClock::Scope timed(detect_clock, i);
+                std::vector<ScrfdFace> faces;
+                if (options_.roi_mosaic && rois.size() > 1) {
+                    faces = detector_.DetectMosaic(cur_frame->rgbData(), fw, fh, rois, options_.roi_side,
+                                                   &roi_mosaic_passes);
+                    roi_mosaic_crops += static_cast<int>(rois.size());
+                } else {
+                    faces = detector_.DetectRegions(cur_frame->rgbData(), fw, fh, rois, options_.roi_side);
+                }
+                frame_dets = toDetections(faces, cur_frame->rgbData(), fw, fh, false);
+            }
+        }
+        if (lazy_reid && reid_frame) reid_offered += static_cast<int>(frame_dets.size());
+        if (use_reid_ && !lazy_reid) {
+            for (const auto& d : frame_dets) {
+                reid_attempted++;
+                reid_q_sum += static_cast<double>(d.reid_quality);
+                reid_q_min = std::min(reid_q_min, static_cast<double>(d.reid_quality));
+                reid_q_max = std::max(reid_q_max, static_cast<double>(d.reid_quality));
+                reid_quality.observe(d.reid_quality);
+                if (d.has_reid) reid_kept++;
+            }
+        }
+        if (options_.gmc_mask_faces && cur_ok && (is_detection_frame || !frame_dets.empty())) {
+            gmc_exclude.clear();
+            for (const Detection& d : frame_dets) {
+                gmc_exclude.push_back({d.bbox.x1 * cur_frame->w, d.bbox.y1 * cur_frame->h,
+                                       d.bbox.x2 * cur_frame->w, d.bbox.y2 * cur_frame->h});
+            }
+        }
+
+        if (defer_tracking || dump) {
+            TrackerInputFrame input;
+            input.frame_index = i;
+            input.scene_cut = scene_cut;
+            input.dets = std::move(frame_dets);
+            input.warp = warp_prev_to_curr;
+            input.warp_ok = warp_ok;
+            input.width = cur_ok ? cur_frame->w : 0;
+            input.height = cur_ok ? cur_frame->h : 0;
+            if (dump) dump->write(input, is_detection_frame);
+            if (defer_tracking) {
+                shots.back().push_back(std::move(input));
+                continue;
+            }
+            frame_dets = std::move(input.dets);
+        }
+
+        flow_cues.clear();
+        if (landmark_flow && !is_detection_frame && luma_pair) {
+            flow.track(prev_frame->lumaData(), cur_frame->lumaData(), cur_frame->luma_w, cur_frame->luma_h, i,
+                       flow_cues);
+        }
+
         // Update tracker
-        auto active_tracks = tracker.update(frame_dets,
-                                            true,  // return_all=true
-                                            warp_ok ? &warp_prev_to_curr : nullptr,
-                                            cur_ok ? cur_frame.w : 0,
-                                            cur_ok ? cur_frame.h : 0);
-
-        prev_frame = std::move(cur_frame);
-        prev_ok = cur_ok;
+        {
+            StageProfile::Scope timed(profile, ProfileStage::Associate, i);
+            if (metrics) {
+                association_dets.observe(static_cast<double>(frame_dets.size()));
+                association_tracks.observe(static_cast<double>(tracker.numTrackers()));
+            }
+            tracker.update(frame_dets,
+                           active_tracks,
+                           true,  // return_all=true
+                           warp_ok ? &warp_prev_to_curr : nullptr,
+                           cur_ok ? cur_frame->w : 0,
+                           cur_ok ? cur_frame->h : 0,
+                           flow_cues.empty() ? nullptr : &flow_cues);
+        }
+        if (landmark_flow) flow.observe(active_tracks, frame_dets, flow_cues);
+        if (fast_forward) idle_hint.store(tracker.idle(), std::memory_order_relaxed);
         
-        // Record track frames (skip degenerate bboxes)
-        // Note: When `return_all=true`, OC-SORT will also emit predictions on frames
-        // without a matched detection. We drop ultra-low-confidence predictions to
-        // avoid "ghost" boxes lingering and accidentally blurring the wrong region.
-        constexpr float kMinOutputConfidence = 0.05f;
-        for (const auto& [track_id, track_result] : active_tracks) {
-            const BBox bbox = clampBBox01(track_result.bbox);
-            // Skip degenerate boxes (zero or near-zero dimensions)
-            if (bbox.width() < 0.01f || bbox.height() < 0.01f) {
-                continue;
+        if (policy) policy->observeTracks(active_tracks, is_detection_frame);
+
+        if (gate_tiles && cur_ok) {
+            track_focus.clear();
+            const float fw = static_cast<float>(cur_frame->w);
+            const float fh = static_cast<float>(cur_frame->h);
+            for (const TrackResult& track_result : active_tracks) {
+                if (track_result.confidence < kMinOutputConfidence) continue;
+                const BBox& b = track_result.bbox;
+                const float mx = b.width(), my = b.height();
+                track_focus.push_back({(b.x1 - mx) * fw, (b.y1 - my) * fh, (b.x2 + mx) * fw, (b.y2 + my) * fh});
             }
-            if (track_result.confidence < kMinOutputConfidence) {
-                continue;
+        }
+        if (adaptive_input && cur_ok) {
+            // The smallest output track's short side, as a fraction of the
+            // frame's long side (what the letterbox scales to the input).
+            const float fw = static_cast<float>(cur_frame->w);
+            const float fh = static_cast<float>(cur_frame->h);
+            float smallest = std::numeric_limits<float>::infinity();
+            for (const TrackResult& track_result : active_tracks) {
+                if (track_result.confidence < kMinOutputConfidence) continue;
+                const BBox& b = track_result.bbox;
+                smallest = std::min(smallest, std::min(b.width() * fw, b.height() * fh) / std::max(fw, fh));
             }
-            track_data[track_id].push_back(TrackFrame{
-                i,
-                bbox,
-                track_result.confidence
+            input_side = 0;
+            if (std::isfinite(smallest) && smallest > 0.0f) {
+                const int align = 32;  // SCRFD's largest stride
+                const float needed = static_cast<float>(options_.adaptive_input_face) / smallest;
+                const int side =
+                    std::max(kMinAdaptiveInput, (static_cast<int>(std::ceil(needed)) + align - 1) / align * align);
+                if (side < options_.detector_input) input_side = side;
+            }
+        }
+        if (prune_strides && cur_ok) {
+            const float fw = static_cast<float>(cur_frame->w);
+            const float fh = static_cast<float>(cur_frame->h);
+            float smallest = std::numeric_limits<float>::infinity();
+            for (const TrackResult& track_result : active_tracks) {
+                if (track_result.confidence < kMinOutputConfidence) continue;
+                const BBox& b = track_result.bbox;
+                smallest = std::min(smallest, std::min(b.width() * fw, b.height() * fh) / std::max(fw, fh));
+            }
+            prune_face = std::isfinite(smallest) ? 0.5f * smallest : 0.0f;
+        }
+        if (cascade) {
+            cascade_expect.clear();
+            for (const TrackResult& track_result : active_tracks) {
+                if (track_result.confidence >= kMinOutputConfidence) cascade_expect.push_back(track_result.bbox);
+            }
+        }
+        if (roi_detect) {
+            roi_boxes.clear();
+            for (const TrackResult& track_result : active_tracks) {
+                if (track_result.confidence >= kMinOutputConfidence) roi_boxes.push_back(track_result.bbox);
+            }
+        }
+        record_tracks(active_tracks, track_data, i);
+        if (on_segment || compact_in_loop) release_ended();
+        if (evict_appearances) evict_unlinkable(i);
+        if (dets_watch) {
+            frames_watch->set(frames.residentBytes());
+            size_t bytes = frame_dets.capacity() * sizeof(Detection);
+            for (const Detection& d : frame_dets) bytes += d.reid.capacity() * sizeof(d.reid[0]);
+            dets_watch->set(bytes);
+            if (i % 32 == 0) watch_track_data();  // a scan over every track
+        }
+        // Never at the last frame: its forced detection would not happen
+        // there in a run over a longer range.
+        if (checkpoints && !checkpoint_failed && !at_end && i - last_checkpoint >= checkpoint_every) {
+            last_checkpoint = i;
+            if (!write_checkpoint(i, cur_ok ? cur_frame->w : 0, cur_ok ? cur_frame->h : 0)) {
+                checkpoint_failed = true;
+                fprintf(stderr, "Warning: cannot write checkpoint %s\n", options_.checkpoint_path.c_str());
+            }
+        }
+        FACE_PIPELINE_FRAME_MARK();
+    }
+    if (release_files && result.frame_count > first_frame) release_file(result.frame_count - 1);
+    if (balancer && reid_) reid_->SetBatchWorkers(0);  // the next run starts from the automatic count
+
+    watch_track_data();
+    const auto loop_end = std::chrono::steady_clock::now();
+    if (tracking.progress) tracking.progress("frames", result.frame_count, result.frame_count);
+    if (budget && budget->level() > TimeBudget::Full) {
+        static const char* const kDropped[] = {"", "every other detection", "ReID", "GMC"};
+        std::string dropped;
+        for (int level = TimeBudget::HalfDetection; level <= budget->level(); ++level) {
+            char part[64];
+            std::snprintf(part, sizeof(part), "%s%s from frame %d", dropped.empty() ? "" : ", ", kDropped[level],
+                          first_frame + budget->since(static_cast<TimeBudget::Level>(level)));
+            dropped += part;
+        }
+        fprintf(stderr, "Warning: to fit the %.1f s time budget, dropped %s\n", budget->seconds(), dropped.c_str());
+    }
+    if (budget && budget->expired()) {
+        fprintf(stderr, "Warning: %.1f s time budget used up after %d frames; tracks end there\n", budget->seconds(),
+                result.frame_count);
+    }
+
+    if (dump) {
+        std::string error;
+        if (!dump->finish(result.frame_count, error)) fprintf(stderr, "Warning: %s\n", error.c_str());
+    }
+    const int speculative_detected = speculative ? speculative->detected() : 0;
+    const int speculative_used = speculative ? speculative->used() : 0;
+    speculative.reset();
+
+    // Track the recorded shots. A fresh tracker acts like one just past
+    // endShot() (its frame count only confirms tracks while below
+    // min_hits = 1, which every track meets anyway), and each shot's IDs are
+    // offset by the IDs of the shots before it, so the result matches inline
+    // tracking exactly, whatever the number of workers.
+    if (defer_tracking) {
+        struct ShotResult {
+            std::vector<std::vector<TrackFrame>> tracks;
+            AppearanceTable appearances;
+            int ids = 0;
+        };
+        std::vector<ShotResult> shot_results(shots.size());
+        std::mutex progress_mu;
+        int shots_done = 0;
+        ThreadPool::Shared().parallelFor(
+            static_cast<int>(shots.size()), track_workers, [&](int s) {
+                OCSort shot_tracker(iou_thresh, tracking.track_max_age, 1, 3, tracking.track_inertia, use_reid_,
+                                    reid_weight, reid_cos_thresh);
+                configure_tracker(shot_tracker);
+                ShotResult& out = shot_results[static_cast<size_t>(s)];
+                const std::vector<TrackerInputFrame>& shot = shots[static_cast<size_t>(s)];
+                std::vector<TrackResult> tracks;
+                for (const TrackerInputFrame& f : shot) {
+                    if (tracking.stop && tracking.stop->load()) break;
+                    if (!f.duplicate) {
+                        StageProfile::Scope timed(profile, ProfileStage::Associate, f.frame_index);
+                        shot_tracker.update(f.dets, tracks, true, f.warp_ok ? &f.warp : nullptr, f.width, f.height);
+                    }
+                    record_tracks(tracks, out.tracks, f.frame_index);
+                }
+                if (bidirectional && !(tracking.stop && tracking.stop->load())) {
+                    // Same detections, last frame first. Each step undoes the
+                    // camera motion GMC measured into the later frame.
+                    OCSort reverse_tracker(iou_thresh, tracking.track_max_age, 1, 3, tracking.track_inertia, use_reid_,
+                                           reid_weight, reid_cos_thresh);
+                    configure_tracker(reverse_tracker);
+                    std::vector<std::vector<TrackFrame>> reverse;
+                    const TrackerInputFrame* later = nullptr;
+                    Mat3f warp_back;
+                    tracks.clear();
+                    for (auto f = shot.rbegin(); f != shot.rend(); ++f) {
+                        if (!f->duplicate) {
+                            StageProfile::Scope timed(profile, ProfileStage::Associate, f->frame_index);
+                            const bool back_ok = later && later->warp_ok && later->warp.inverse(warp_back);
+                            reverse_tracker.update(f->dets, tracks, true, back_ok ? &warp_back : nullptr,
+                                                   f->width, f->height);
+                            later = &*f;
+                        }
+                        record_tracks(tracks, reverse, f->frame_index);
+                    }
+                    for (auto& frames : reverse) std::reverse(frames.begin(), frames.end());
+                    FuseReverseTracks(reverse, out.tracks);
+                }
+                if (use_reid_) {
+                    shot_tracker.storeActiveAppearances();
+                    out.appearances.absorb(shot_tracker.appearances(), 0);
+                }
+                out.ids = shot_tracker.tracksStarted();
+                if (tracking.progress) {
+                    std::lock_guard<std::mutex> lock(progress_mu);
+                    tracking.progress("shots", ++shots_done, static_cast<int>(shots.size()));
+                }
             });
+        int id_offset = 0;
+        for (ShotResult& shot : shot_results) {
+            track_data.resize(static_cast<size_t>(id_offset + shot.ids));
+            for (size_t t = 0; t < shot.tracks.size(); ++t) {
+                track_data[static_cast<size_t>(id_offset) + t] = std::move(shot.tracks[t]);
+            }
+            tracker.appearances().absorb(shot.appearances, id_offset);
+            id_offset += shot.ids;
+        }
+        if (tracking.stop && tracking.stop->load()) result.stopped = true;
+        watch_track_data();
+    }
+
+    // Fixed-lag RTS smoothing of every tracklet's boxes (streamed ones
+    // were smoothed as they left).
+    if (tracking.smooth_lag > 0) {
+        for (auto& frames : track_data) smooth_track(frames);
+    }
+    if (options_.compact_tracks) {
+        for (size_t t = 0; t < track_data.size(); ++t) {
+            if (!track_data[t].empty()) store_tracklet(static_cast<int>(t));
+        }
+    }
+
+    if (detection_cache_) {
+        std::string error;
+        if (!detection_cache_->save(options_.detection_cache_path, error)) {
+            fprintf(stderr, "Warning: %s\n", error.c_str());
         }
     }
 
     // Dev-only: opt-in GMC health log (stderr), without polluting JSON output.
     if (std::getenv("FACE_PIPELINE_LOG_GMC") != nullptr) {
-#ifdef FACE_PIPELINE_GMC_OPENCV
-        constexpr int kGmcCompiled = 1;  // OpenCV videostab backend
-#elif defined(FACE_PIPELINE_GMC_FALLBACK)
-        constexpr int kGmcCompiled = 2;  // dependency-free fallback backend
-#else
-        constexpr int kGmcCompiled = 0;  // disabled
-#endif
         const float ok_ratio = (gmc_attempts > 0) ? (static_cast<float>(gmc_ok) / static_cast<float>(gmc_attempts)) : 0.0f;
         fprintf(stderr,
-                "GMC: compiled=%d frames_loaded=%d/%d attempts=%d ok=%d ok_ratio=%.3f\n",
+                "GMC: compiled=%d frames_loaded=%d/%d attempts=%d ok=%d ok_ratio=%.3f static_segments=%d "
+                "static_skipped=%d\n",
                 kGmcCompiled,
                 gmc_frame_load_ok,
                 result.frame_count,
                 gmc_attempts,
                 gmc_ok,
-                ok_ratio);
+                ok_ratio,
+                static_camera.segments(),
+                static_camera.skipped());
+    }
+
+    // Dev-only: decode/buffer reuse stats (frame allocations should stay flat).
+    if (std::getenv("FACE_PIPELINE_LOG_DECODE") != nullptr) {
+        fprintf(stderr,
+                "Decode: frames=%d decoded=%d frame_allocations=%d prefetch_threads=%d detect_workers=%d reid_stage=%d "
+                "cores=%d pool_threads=%d simd=%s\n",
+                result.frame_count,
+                frames.decodeCount(),
+                frames.frameAllocations(),
+                prefetch ? prefetch->numThreads() : 0,
+                scheduler ? scheduler->numWorkers() : 1,
+                scheduler && scheduler->hasReidStage() ? 1 : 0,
+                PipelineCoreCount(),
+                ThreadPool::Shared().numThreads(),
+                SimdLevelName(ActiveSimdLevel()));
+    }
+    if (options_.compact_tracks && std::getenv("FACE_PIPELINE_LOG_DECODE") != nullptr) {
+        fprintf(stderr, "TrackStore: tracklets=%zu frames=%zu keyframes=%zu memory_bytes=%zu spilled_bytes=%zu\n",
+                store.tracklets(), store.frames(), store.keyframes(), store.memoryBytes(), store.spilledBytes());
+    }
+
+    // Dev-only: where the time went. Stage times are summed over their
+    // threads; the loop waiting on frames means an upstream stage is the
+    // bottleneck, a loop that never waits means the tracker is.
+    if (std::getenv("FACE_PIPELINE_LOG_STAGES") != nullptr) {
+        const double wall_ms = std::chrono::duration<double, std::milli>(loop_end - loop_start).count();
+        fprintf(stderr,
+                "Stages: frames=%d wall_ms=%.1f decode_ms=%.1f decode_threads=%d detect_ms=%.1f detect_threads=%d "
+                "reid_ms=%.1f reid_stage=%d gmc_ms=%.1f gmc_threads=%d loop_wait_ms=%.1f loop_busy_ms=%.1f\n",
+                result.frame_count,
+                wall_ms,
+                decode_clock.ms(),
+                prefetch ? prefetch->numThreads() : 0,
+                detect_clock.ms(),
+                scheduler ? scheduler->numWorkers() : 0,
+                reid_clock.ms(),
+                scheduler && scheduler->hasReidStage() ? 1 : 0,
+                gmc_clock.ms() + (gmc_stage ? gmc_stage->busyMs() : 0.0),
+                gmc_stage ? gmc_stage->numWorkers() : 0,
+                wait_clock.ms(),
+                std::max(0.0, wall_ms - wait_clock.ms()));
+    }
+
+    // Dev-only: how many frames ran the detector (adaptive scheduling health).
+    if (std::getenv("FACE_PIPELINE_LOG_SCHEDULE") != nullptr) {
+        fprintf(stderr,
+                "Schedule: adaptive=%d frames=%d detections=%d urgent=%d fixed_stride=%d scene_cuts=%d duplicates=%d\n",
+                policy ? 1 : 0,
+                result.frame_count,
+                detection_frames,
+                policy ? policy->urgentDetections() : 0,
+                stride,
+                scene_cuts.cuts(),
+                duplicate_frames);
+        if (detection_cache_) {
+            fprintf(stderr, "DetectionCache: entries=%zu hits=%d misses=%d\n", detection_cache_->size(),
+                    detection_cache_->hits(), detection_cache_->misses());
+        }
     }
 
     if (use_reid_ && std::getenv("FACE_PIPELINE_LOG_REID") != nullptr) {
@@ -380,197 +2338,67 @@ PipelineResult FacePipeline::process(const std::vector<std::string>& image_paths
         const double qmin = std::isfinite(reid_q_min) ? reid_q_min : 0.0;
         const double qmax = std::isfinite(reid_q_max) ? reid_q_max : 0.0;
         fprintf(stderr,
-                "ReID: attempted=%d kept=%d kept_ratio=%.3f q_mean=%.3f q_min=%.3f q_max=%.3f\n",
+                "ReID: attempted=%d kept=%d kept_ratio=%.3f q_mean=%.3f q_min=%.3f q_max=%.3f lazy_skipped=%d\n",
                 reid_attempted,
                 reid_kept,
                 (reid_attempted > 0) ? (static_cast<double>(reid_kept) / static_cast<double>(reid_attempted)) : 0.0,
                 mean_q,
                 qmin,
-                qmax);
+                qmax,
+                lazy_reid ? reid_offered - reid_attempted : 0);
     }
     
     // Phase 3: Offline tracklet linking (Stage B) + build output tracks.
     // Link short/high-precision tracklets across gaps using appearance + time/space constraints.
-    std::map<int, std::array<float, Detection::kReidDim>> appearances;
-    if (use_reid_) {
-        auto finished = tracker.takeFinishedAppearances();
-        auto active = tracker.getActiveAppearances();
-        appearances = std::move(finished);
-        for (auto& kv : active) {
-            appearances[kv.first] = kv.second;
-        }
-    }
-
-    // Summarize tracklets from collected geometry.
-    struct TrackletSummary {
-        int id = -1;
-        int start_frame = 0;
-        int end_frame = 0;
-        BBox start_bbox{};
-        BBox end_bbox{};
-        int frame_count = 0;
-        int conf_ge_thresh = 0;  // frames with confidence >= conf_thresh_
-    };
+    const auto link_start = std::chrono::steady_clock::now();
+    AllocStats::Scope link_allocations(ProfileStage::Link);
+    FACE_PIPELINE_ZONE("Phase 3 linking");
+    if (use_reid_) tracker.storeActiveAppearances();
+    const AppearanceTable& appearances = tracker.appearances();
+
+    // Summarize tracklets from collected geometry; streamed and stored ones
+    // were summarized as they left.
     std::vector<TrackletSummary> tracklets;
     tracklets.reserve(track_data.size());
-    for (const auto& kv : track_data) {
-        const int id = kv.first;
-        const auto& frames = kv.second;
-        if (frames.empty()) continue;
-        TrackletSummary s;
-        s.id = id;
-        s.frame_count = static_cast<int>(frames.size());
-        // Trim extremely low-confidence prediction tails so tracklet spans reflect
-        // when the face was actually present (helps offline linking + removes ghosts).
-        const float span_conf = std::max(0.20f, conf_thresh_ * 0.60f);
-        int first = 0;
-        int last = static_cast<int>(frames.size()) - 1;
-        while (first < static_cast<int>(frames.size()) &&
-               frames[first].confidence < span_conf) {
-            first++;
-        }
-        while (last >= 0 && frames[last].confidence < span_conf) {
-            last--;
-        }
-        if (first >= static_cast<int>(frames.size()) || last < 0 || last < first) {
-            // Fallback: use raw endpoints.
-            first = 0;
-            last = static_cast<int>(frames.size()) - 1;
-        }
-        s.start_frame = frames[first].frame_index;
-        s.end_frame = frames[last].frame_index;
-        s.start_bbox = frames[first].bbox;
-        s.end_bbox = frames[last].bbox;
-
-        int ge = 0;
-        for (const auto& f : frames) {
-            if (f.confidence >= conf_thresh_) ge++;
+    for (size_t t = 0; t < track_data.size(); ++t) {
+        const int id = static_cast<int>(t);
+        const auto released = released_segments.find(id);
+        const auto stored = stored_summaries.find(id);
+        if (released != released_segments.end()) {
+            tracklets.push_back(released->second);
+        } else if (stored != stored_summaries.end()) {
+            tracklets.push_back(stored->second);
+        } else if (!track_data[t].empty()) {
+            tracklets.push_back(summarize(id, track_data[t]));
         }
-        s.conf_ge_thresh = ge;
-        tracklets.push_back(s);
     }
 
-    UnionFind uf;
-    for (const auto& s : tracklets) uf.parent[s.id] = s.id;
+    if (tracking.progress) tracking.progress("linking", 0, static_cast<int>(tracklets.size()));
+    UnionFind uf(static_cast<int>(track_data.size()));
 
     int links_made = 0;
+    MetricsRegistry::Histogram link_similarity;
     double sim_sum = 0.0;
     double sim_min = std::numeric_limits<double>::infinity();
     double sim_max = -std::numeric_limits<double>::infinity();
 
-    if (use_reid_ && !appearances.empty() && tracklets.size() >= 2) {
-        const int link_max_gap_short = std::max(1, static_cast<int>(std::round(video_fps * 2.0f)));   // ~2s
-        const int link_max_gap_long  = std::max(link_max_gap_short,
-                                               static_cast<int>(std::round(video_fps * 10.0f)));      // ~10s
-        constexpr float kMaxCenterDist = 2.0f;   // normalized by max diag
-        constexpr float kMaxAreaRatio = 4.0f;
-
-        const int n = static_cast<int>(tracklets.size());
-        std::vector<int> best_to(n, -1);
-        std::vector<float> best_to_sim(n, -1.0f);
-        std::vector<float> best_to_dist(n, 1e9f);
-
-        std::vector<int> best_from(n, -1);
-        std::vector<float> best_from_sim(n, -1.0f);
-        std::vector<float> best_from_dist(n, 1e9f);
-
-        // Debug: track best long-gap candidate per tracklet (helps threshold tuning).
-        std::vector<int> best_long_to(n, -1);
-        std::vector<float> best_long_to_sim(n, -1.0f);
-        std::vector<int> best_long_to_gap(n, 0);
-        std::vector<float> best_long_to_dist(n, 1e9f);
-
-        for (int i = 0; i < n; ++i) {
-            const auto& A = tracklets[i];
-            const auto itA = appearances.find(A.id);
-            if (itA == appearances.end()) continue;
-
-            for (int j = 0; j < n; ++j) {
-                if (i == j) continue;
-                const auto& B = tracklets[j];
-                if (B.start_frame <= A.end_frame) continue;
-
-                const int gap = B.start_frame - A.end_frame;
-                if (gap <= 0 || gap > link_max_gap_long) continue;
-
-                const auto itB = appearances.find(B.id);
-                if (itB == appearances.end()) continue;
-
-                const float dist = center_dist_norm_max_diag(A.end_bbox, B.start_bbox);
-                if (!(dist <= kMaxCenterDist)) continue;
-
-                const float aA = std::max(1e-6f, A.end_bbox.area());
-                const float aB = std::max(1e-6f, B.start_bbox.area());
-                float ar = aB / aA;
-                if (ar < 1.0f) ar = 1.0f / std::max(1e-6f, ar);
-                if (!(ar <= kMaxAreaRatio)) continue;
-
-                const float sim = cosine_sim(itA->second, itB->second);
-                const bool long_gap = (gap > link_max_gap_short);
-                if (long_gap) {
-                    if (sim > best_long_to_sim[i] || (sim == best_long_to_sim[i] && dist < best_long_to_dist[i])) {
-                        best_long_to[i] = j;
-                        best_long_to_sim[i] = sim;
-                        best_long_to_gap[i] = gap;
-                        best_long_to_dist[i] = dist;
-                    }
-                }
-
-                float sim_thresh = reid_cos_thresh_;
-                if (long_gap) {
-                    // Long gaps are much riskier. Require (a) enough confident frames in
-                    // both tracklets and (b) a moderate absolute similarity floor.
-                    if (A.conf_ge_thresh < 6 || B.conf_ge_thresh < 6) continue;
-                    sim_thresh = std::max(reid_cos_thresh_, 0.50f);
-                }
-                if (!(sim >= sim_thresh)) continue;
-
-                // Best-to (A -> B): maximize sim, break ties with smaller dist.
-                if (sim > best_to_sim[i] || (sim == best_to_sim[i] && dist < best_to_dist[i])) {
-                    best_to[i] = j;
-                    best_to_sim[i] = sim;
-                    best_to_dist[i] = dist;
-                }
-
-                // Best-from (B <- A): maximize sim, break ties with smaller dist.
-                if (sim > best_from_sim[j] || (sim == best_from_sim[j] && dist < best_from_dist[j])) {
-                    best_from[j] = i;
-                    best_from_sim[j] = sim;
-                    best_from_dist[j] = dist;
-                }
-            }
-        }
-
-        for (int i = 0; i < n; ++i) {
-            const int j = best_to[i];
-            if (j < 0) continue;
-            if (best_from[j] != i) continue;  // mutual nearest neighbor
-
-            const int idA = tracklets[i].id;
-            const int idB = tracklets[j].id;
+    if (use_reid_ && appearances.count() > 0 && tracklets.size() >= 2) {
+        std::vector<const PackedEmbedding*> appearance(tracklets.size(), nullptr);
+        for (size_t i = 0; i < tracklets.size(); ++i) appearance[i] = appearances.get(tracklets[i].id);
+        for (const TrackletLink& link :
+             FindTrackletLinks(tracklets, appearance, video_fps, reid_cos_thresh, options_.reid)) {
+            const int idA = tracklets[link.from].id;
+            const int idB = tracklets[link.to].id;
             if (uf.find(idA) == uf.find(idB)) continue;
             uf.unite(idA, idB);
             links_made++;
 
-            const double s = static_cast<double>(best_to_sim[i]);
+            const double s = static_cast<double>(link.sim);
+            link_similarity.observe(s);
             sim_sum += s;
             sim_min = std::min(sim_min, s);
             sim_max = std::max(sim_max, s);
         }
-
-        if (std::getenv("FACE_PIPELINE_LOG_REID_CANDS") != nullptr) {
-            for (int i = 0; i < n; ++i) {
-                if (best_long_to[i] < 0) continue;
-                const int idA = tracklets[i].id;
-                const int idB = tracklets[best_long_to[i]].id;
-                fprintf(stderr,
-                        "ReIDLinkLongCand: %d -> %d gap=%d sim=%.3f dist=%.3f\n",
-                        idA, idB,
-                        best_long_to_gap[i],
-                        best_long_to_sim[i],
-                        best_long_to_dist[i]);
-            }
-        }
     }
 
     if (use_reid_ && std::getenv("FACE_PIPELINE_LOG_REID") != nullptr) {
@@ -585,61 +2413,415 @@ PipelineResult FacePipeline::process(const std::vector<std::string>& image_paths
                 smax);
     }
 
-    // Merge track data by union-find representative.
-    std::map<int, std::vector<TrackFrame>> merged_data;
-    for (auto& kv : track_data) {
-        const int root = uf.find(kv.first);
-        auto& out = merged_data[root];
-        auto& frames = kv.second;
-        out.insert(out.end(), frames.begin(), frames.end());
+    if (metrics) {
+        // The same figures as the FACE_PIPELINE_LOG_* lines above, plus the
+        // tracker's and the queues' own, summed over runs.
+        const auto ratio = [](double part, double whole) { return whole > 0.0 ? part / whole : 0.0; };
+        metrics->add("runs");
+        metrics->add("frames", result.frame_count);
+        metrics->add("schedule.detectionFrames", detection_frames);
+        metrics->add("schedule.urgent", policy ? policy->urgentDetections() : 0);
+        metrics->add("schedule.sceneCuts", scene_cuts.cuts());
+        metrics->add("schedule.editorCuts",
+                     std::lower_bound(editor_cuts.begin(), editor_cuts.end(), result.frame_count) -
+                         std::upper_bound(editor_cuts.begin(), editor_cuts.end(), 0));
+        metrics->add("schedule.duplicates", duplicate_frames);
+        metrics->add("schedule.idleSkipped", idle_skipped);
+        metrics->add("schedule.keyframeSnaps", grid.snappedSamples());
+        if (balancer) {
+            metrics->add("balance.moves", balancer->moves());
+            for (const StageBalancer::Stage& st : balancer->stages()) metrics->add("balance." + st.name + "Units", st.units);
+        }
+        metrics->add("schedule.lightDetections", light_detections);
+        metrics->add("schedule.flowCues", flow.cued());
+        metrics->add("schedule.flowLost", flow.lost());
+        metrics->add("schedule.reducedInput", reduced_detections);
+        metrics->add("schedule.prunedStrides", pruned_detections);
+        metrics->add("schedule.roiMosaicPasses", roi_mosaic_passes);
+        metrics->add("schedule.roiMosaicCrops", roi_mosaic_crops);
+        metrics->add("schedule.cascadeCoarse", cascade_coarse);
+        metrics->add("schedule.cascadeEscalated", cascade_escalated);
+        metrics->add("schedule.speculativeDetected", speculative_detected);
+        metrics->add("schedule.speculativeUsed", speculative_used);
+        metrics->add("schedule.scanFrames", coarse_scan ? last_frame / scan_stride + 1 : 0);
+        metrics->add("schedule.scanHits", scan_hits);
+        metrics->add("decode.decoded", frames.decodeCount());
+        metrics->add("decode.frameAllocations", frames.frameAllocations());
+        metrics->add("decode.readAheadHits", read_ahead ? read_ahead->hits() : 0);
+        metrics->add("decode.readAheadMisses", read_ahead ? read_ahead->misses() : 0);
+        if (HugePagesEnabled()) {
+            // Process-wide: frame planes and ncnn pools of every run so far.
+            metrics->set("memory.hugePagesAdvised", static_cast<double>(HugePageAdvisedBytes()));
+            metrics->set("memory.hugePagesResident", static_cast<double>(HugePageResidentBytes()));
+        }
+        if (MappedModelBytes() > 0) metrics->set("memory.mappedModelBytes", static_cast<double>(MappedModelBytes()));
+        metrics->add("decode.filesDeleted", files_deleted);
+        metrics->add("gmc.framesLoaded", gmc_frame_load_ok);
+        metrics->add("gmc.attempts", gmc_attempts);
+        metrics->add("gmc.ok", gmc_ok);
+        metrics->add("gmc.staticSegments", static_camera.segments());
+        metrics->add("gmc.staticSkipped", static_camera.skipped());
+        metrics->add("gmc.sparseCarried", sparse_gmc.carried());
+        metrics->add("gmc.sparseKeyEstimates", sparse_gmc.keyEstimates());
+        metrics->add("gmc.sparseFallbacks", sparse_gmc.fallbacks());
+        metrics->set("gmc.okRatio", ratio(gmc_ok, gmc_attempts));
+        if (use_reid_) {
+            metrics->add("reid.attempted", reid_attempted);
+            metrics->add("reid.kept", reid_kept);
+            metrics->add("reid.lazySkipped", lazy_reid ? reid_offered - reid_attempted : 0);
+            metrics->set("reid.keptRatio", ratio(reid_kept, reid_attempted));
+            metrics->merge("reid.quality", reid_quality);
+        }
+        const OCSort::AssociationStats& as = tracker.associationStats();
+        metrics->add("associate.associations", as.associations);
+        metrics->add("associate.fastPath", as.fast_path);
+        metrics->add("associate.gatedSolves", as.gated_solves);
+        metrics->add("associate.trivialComponents", as.trivial_components);
+        metrics->add("associate.solvedComponents", as.solved_components);
+        metrics->add("associate.parallelSolves", as.parallel_solves);
+        metrics->add("associate.solvedRows", as.solved_rows);
+        metrics->add("associate.reaugmentedRows", as.reaugmented_rows);
+        metrics->add("associate.seededRows", as.seeded_rows);
+        metrics->add("associate.tentativeRetired", as.tentative_retired);
+        metrics->add("associate.dormantRecovered", as.dormant_recovered);
+        metrics->add("associate.motionGated", as.motion_gated);
+        metrics->add("associate.cueUpdates", as.cue_updates);
+        metrics->add("associate.lazyLate", as.lazy_late);
+        metrics->set("associate.fastPathRatio", ratio(static_cast<double>(as.fast_path),
+                                                      static_cast<double>(as.associations)));
+        metrics->set("associate.largestComponent", as.largest_component);
+        metrics->merge("associate.detections", association_dets);
+        metrics->merge("associate.tracks", association_tracks);
+        metrics->merge("queue.decode", decode_queue);
+        metrics->merge("queue.detection", detection_queue);
+        metrics->merge("queue.gmc", gmc_queue);
+        metrics->add("link.tracklets", static_cast<int64_t>(tracklets.size()));
+        metrics->add("link.links", links_made);
+        metrics->add("link.evictedAppearances", appearances_evicted);
+        metrics->merge("link.similarity", link_similarity);
+        if (detection_cache_) {
+            // The cache's own counts already span its runs.
+            metrics->set("detectionCache.hits", detection_cache_->hits());
+            metrics->set("detectionCache.misses", detection_cache_->misses());
+            metrics->set("detectionCache.hitRate", ratio(detection_cache_->hits(),
+                                                         detection_cache_->hits() + detection_cache_->misses()));
+        }
+        if (options_.compact_tracks) {
+            metrics->set("trackStore.memoryBytes", static_cast<double>(store.memoryBytes()));
+            metrics->set("trackStore.spilledBytes", static_cast<double>(store.spilledBytes()));
+            metrics->set("trackStore.frames", static_cast<double>(store.frames()));
+            metrics->set("trackStore.keyframes", static_cast<double>(store.keyframes()));
+        }
     }
 
-    // Deduplicate per-frame within merged tracks and sort.
-    for (auto& kv : merged_data) {
-        auto& frames = kv.second;
-        std::sort(frames.begin(), frames.end(), [](const TrackFrame& a, const TrackFrame& b) {
-            return a.frame_index < b.frame_index;
-        });
-        std::vector<TrackFrame> dedup;
-        dedup.reserve(frames.size());
-        for (const auto& f : frames) {
-            if (dedup.empty() || dedup.back().frame_index != f.frame_index) {
-                dedup.push_back(f);
-            } else if (f.confidence > dedup.back().confidence) {
-                dedup.back() = f;
+    // Merge track data by union-find representative, one merged track at a
+    // time: its members' frames are gathered, deduplicated, filtered and
+    // moved to the output before the next one is built.
+    // members[r] lists the tracklets of the merged track with ID r, in ID order.
+    const int id_count = static_cast<int>(track_data.size());
+    std::vector<std::vector<int>> members(track_data.size());
+    int merged_count = 0;
+    for (int id = 0; id < id_count; ++id) {
+        if (track_data[id].empty() && !released_segments.count(id) && !store.contains(id)) continue;
+        std::vector<int>& group = members[uf.representative(id)];
+        if (group.empty()) merged_count++;
+        group.push_back(id);
+    }
+    std::map<int, EmbeddingF32> merged_appearance;  // sum of the member tracklets' appearances
+    const int min_track_frames = 10;
+    if (tracking.keyframe_tolerance > 0.0f && result.frame_width <= 0) {
+        fprintf(stderr, "Warning: the frame size is unknown; keeping every frame of the tracks\n");
+    }
+    // Boundary refinement: a track's first observation may be up to a
+    // stride after the face appeared, and its last one up to a stride
+    // before it left. Presence is assumed to change once in between, so a
+    // binary search finds the frame with a few detections; frames seen by
+    // several tracks are detected once.
+    constexpr float kRefineIou = 0.3f;
+    std::map<int, std::vector<Detection>> refine_dets;
+    int refine_added = 0, refine_trimmed = 0;
+    LoadedRgbFrame refine_frame;
+    auto detections_at = [&](int f) -> const std::vector<Detection>& {
+        auto it = refine_dets.find(f);
+        if (it != refine_dets.end()) return it->second;
+        std::vector<Detection>& dets = refine_dets[f];
+        FrameRequest req;
+        req.rgb = true;
+        req.rgb_min_long_side = decode_long_side;
+        if (source.read(f, req, refine_frame) && refine_frame.hasRgb()) {
+            StageClock::Scope timed(detect_clock, f);
+            const unsigned char* rgb = refine_frame.rgbData();
+            dets = toDetections(detector_.Detect(rgb, refine_frame.rgb_w, refine_frame.rgb_h), rgb, refine_frame.rgb_w,
+                                refine_frame.rgb_h, false);
+        }
+        return dets;
+    };
+    // The best detection on frame `f` overlapping `box`, or nullptr.
+    auto match_at = [&](int f, const BBox& box) -> const Detection* {
+        const Detection* best = nullptr;
+        float best_iou = kRefineIou;
+        for (const Detection& d : detections_at(f)) {
+            const float iou = d.bbox.iou(box);
+            if (iou >= best_iou) {
+                best_iou = iou;
+                best = &d;
+            }
+        }
+        return best;
+    };
+    auto refine_track = [&](std::vector<TrackFrame>& frames) {
+        if (frames.empty()) return;
+        auto detection_before = [&](int f) {
+            auto it = std::lower_bound(detected_at.begin(), detected_at.end(), f);
+            return it == detected_at.begin() ? std::max(-1, f - stride) : *(it - 1);
+        };
+        auto detection_after = [&](int f) {
+            auto it = std::upper_bound(detected_at.begin(), detected_at.end(), f);
+            return it == detected_at.end() ? std::min(result.frame_count, f + stride) : *it;
+        };
+        std::vector<TrackFrame> head;
+        const TrackFrame first = frames.front();
+        if (first.observed && !std::binary_search(shot_starts.begin(), shot_starts.end(), first.frame_index)) {
+            // Absent at `lo`, present at `hi`.
+            int lo = detection_before(first.frame_index), hi = first.frame_index;
+            std::map<int, TrackFrame> seen;
+            while (hi - lo > 1) {
+                const int mid = lo + (hi - lo) / 2;
+                if (const Detection* d = match_at(mid, first.bbox)) {
+                    seen[mid] = TrackFrame{mid, d->bbox, d->score, true};
+                    hi = mid;
+                } else {
+                    lo = mid;
+                }
+            }
+            for (int f = hi; f < first.frame_index; ++f) {
+                const auto it = seen.find(f);
+                head.push_back(it != seen.end() ? it->second : TrackFrame{f, first.bbox, first.confidence, false});
+            }
+        }
+        size_t last = frames.size();
+        while (last > 0 && !frames[last - 1].observed) last--;
+        if (last > 0) {
+            // Present at `lo`, absent at `hi`; frames past the one found are
+            // the tracker coasting on a face that is gone.
+            const int last_seen = frames[last - 1].frame_index;
+            int lo = last_seen, hi = detection_after(last_seen);
+            BBox box = frames[last - 1].bbox;
+            std::map<int, const Detection*> seen;
+            while (hi - lo > 1) {
+                const int mid = lo + (hi - lo) / 2;
+                auto at = std::lower_bound(frames.begin(), frames.end(), mid,
+                                           [](const TrackFrame& t, int f) { return t.frame_index < f; });
+                if (at != frames.end() && at->frame_index == mid) box = at->bbox;
+                if (const Detection* d = match_at(mid, box)) {
+                    seen[mid] = d;
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            size_t keep = last;
+            while (keep < frames.size() && frames[keep].frame_index <= lo) {
+                const auto it = seen.find(frames[keep].frame_index);
+                if (it != seen.end()) frames[keep] = TrackFrame{it->first, it->second->bbox, it->second->score, true};
+                keep++;
+            }
+            refine_trimmed += static_cast<int>(frames.size() - keep);
+            frames.resize(keep);
+        }
+        if (!head.empty()) {
+            refine_added += static_cast<int>(head.size());
+            frames.insert(frames.begin(), head.begin(), head.end());
+        }
+    };
+    result.tracks.reserve(static_cast<size_t>(merged_count));
+    std::vector<char> kept(track_data.size(), 0);
+    std::vector<TrackFrame> gathered;
+    std::vector<size_t> runs;  // each member's frames in `gathered`, sorted by frame
+    auto by_frame = [](const TrackFrame& a, const TrackFrame& b) { return a.frame_index < b.frame_index; };
+    for (int root = 0; root < id_count; ++root) {
+        if (members[root].empty()) continue;
+        gathered.clear();
+        runs.assign(1, 0);
+        // Frames of the streamed members: (count, count with confidence >= conf_thresh_).
+        std::pair<int, int> streamed{};
+        for (int id : members[root]) {
+            const auto released = released_segments.find(id);
+            if (released != released_segments.end()) {
+                streamed.first += released->second.frame_count;
+                streamed.second += released->second.conf_ge_thresh;
+            }
+            if (store.contains(id)) {
+                if (!store.get(id, gathered)) {
+                    fprintf(stderr, "Warning: cannot read back the frames of track %d\n", id);
+                }
+            } else {
+                gathered.insert(gathered.end(), track_data[id].begin(), track_data[id].end());
+                std::vector<TrackFrame>().swap(track_data[id]);
+            }
+            if (!std::is_sorted(gathered.begin() + runs.back(), gathered.end(), by_frame)) {
+                std::stable_sort(gathered.begin() + runs.back(), gathered.end(), by_frame);
+            }
+            runs.push_back(gathered.size());
+            const PackedEmbedding* app = appearances.get(id);
+            if (app && (!options_.gallery_path.empty() || options_.keep_appearances)) {
+                const EmbeddingF32 v = app->unpack();
+                EmbeddingF32& sum = merged_appearance[root];
+                if (sum.empty()) sum.assign(v.size(), 0.0f);
+                if (sum.size() != v.size()) continue;
+                for (size_t k = 0; k < v.size(); ++k) sum[k] += v[k];
             }
         }
-        frames.swap(dedup);
-    }
 
-    // Filter out very short tracks (likely noise) AFTER linking.
-    const int min_track_frames = 10;
-    result.tracks.reserve(merged_data.size());
-    for (auto& kv : merged_data) {
-        const int id = kv.first;
-        auto& frames = kv.second;
-        if (static_cast<int>(frames.size()) < min_track_frames) continue;
+        // Deduplicate per-frame within the merged track.
+        std::vector<TrackFrame> dedup;
+        MergeFrameRuns(gathered, runs, dedup);
+        // Filter out very short tracks (likely noise) AFTER linking.
+        const int total = static_cast<int>(dedup.size()) + streamed.first;
+        if (total < min_track_frames) continue;
 
         // Drop tracks that are mostly low-confidence predictions / spurious detections.
         // This helps eliminate duplicate short-lived IDs under jitter.
-        int ge = 0;
-        for (const auto& f : frames) {
+        int ge = streamed.second;
+        for (const auto& f : dedup) {
             if (f.confidence >= conf_thresh_) ge++;
         }
-        const float frac_ge = static_cast<float>(ge) / static_cast<float>(frames.size());
-        if (ge < 3 || frac_ge < 0.15f) continue;
+        const float frac_ge = static_cast<float>(ge) / static_cast<float>(total);
+        if (ge < kMinTrackObservations || frac_ge < 0.15f) continue;
 
+        kept[root] = 1;
+        if (dedup.empty()) continue;  // every member was streamed already
         FaceTrack track;
-        track.id = id;
-        track.frames = std::move(frames);
+        track.id = root;
+        track.frames = std::move(dedup);
+        if (refine) refine_track(track.frames);
+        if (tracking.keyframe_tolerance > 0.0f) {
+            ReduceToKeyframes(track.frames, tracking.keyframe_tolerance, result.frame_width, result.frame_height);
+        }
         result.tracks.push_back(std::move(track));
     }
-    
+
+    for (const auto& kv : released_segments) {
+        const int root = uf.representative(kv.first);
+        result.segment_links[kv.first] = kept[root] ? root : -1;
+    }
+
     // Sort tracks by ID for consistent output
     std::sort(result.tracks.begin(), result.tracks.end(),
               [](const FaceTrack& a, const FaceTrack& b) {
                   return a.id < b.id;
               });
+
+    for (auto& kv : merged_appearance) L2Normalize(kv.second);
+    if (use_reid_ && !options_.gallery_path.empty()) assignIdentities(result.tracks, merged_appearance);
+    if (options_.keep_appearances) {
+        // Kept tracks, streamed ones included (their segments link to them).
+        for (auto& kv : merged_appearance) {
+            if (kept[kv.first]) result.appearances[kv.first] = std::move(kv.second);
+        }
+    }
+    if (profile) {
+        profile->record(ProfileStage::Link, link_start, std::chrono::steady_clock::now());
+        profile->addFrames(result.frame_count);
+    }
+    if (metrics) {
+        metrics->add("tracks.output", static_cast<int64_t>(result.tracks.size()));
+        if (refine) {
+            metrics->add("refine.detections", static_cast<int64_t>(refine_dets.size()));
+            metrics->add("refine.framesAdded", refine_added);
+            metrics->add("refine.framesTrimmed", refine_trimmed);
+        }
+        if (result.stopped) metrics->add("runs.stopped");
+    }
+    if (proxies) {
+        // Every proxy is on disk before the result goes out.
+        proxies->finish();
+        if (proxies->failed() > 0) {
+            fprintf(stderr, "Warning: %d of %d proxies could not be written to %s\n", proxies->failed(),
+                    proxies->failed() + proxies->written(), options_.proxy_dir.c_str());
+        }
+    }
     
     return result;
 }
+
+void FacePipeline::assignIdentities(std::vector<FaceTrack>& tracks,
+                                    const std::map<int, EmbeddingF32>& appearance) const {
+    std::lock_guard<std::mutex> lock(gallery_mu_);
+    IdentityGallery gallery;
+    std::string error;
+    if (!gallery.load(options_.gallery_path, error)) {
+        // Leave an unreadable file alone rather than overwrite it.
+        fprintf(stderr, "Warning: %s; not using the face gallery\n", error.c_str());
+        return;
+    }
+    if (gallery.dim() > 0 && !appearance.empty() &&
+        static_cast<int>(appearance.begin()->second.size()) != gallery.dim()) {
+        // Embeddings of another model are not comparable; keep the file as is.
+        fprintf(stderr, "Warning: %s holds %d-D embeddings, the ReID model gives %d-D; not using the face gallery\n",
+                options_.gallery_path.c_str(), gallery.dim(), static_cast<int>(appearance.begin()->second.size()));
+        return;
+    }
+
+    // Candidate (track, identity) pairs, most similar first.
+    struct Pair {
+        float sim;
+        int track;
+        int identity;
+    };
+    std::vector<Pair> pairs;
+    std::vector<const EmbeddingF32*> track_app(tracks.size(), nullptr);
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        const auto it = appearance.find(tracks[t].id);
+        if (it == appearance.end() || tracks[t].frames.empty()) continue;
+        track_app[t] = &it->second;
+        const std::vector<float> sims = gallery.similarities(it->second);
+        for (size_t g = 0; g < sims.size(); ++g) {
+            if (sims[g] >= options_.gallery_min_sim) {
+                pairs.push_back({sims[g], static_cast<int>(t), gallery.identities()[g].id});
+            }
+        }
+    }
+    std::stable_sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.sim > b.sim; });
+
+    // One person is never in two places at once: tracks that overlap in
+    // time cannot share an identity.
+    auto overlaps = [&tracks](int a, int b) {
+        return tracks[a].frames.front().frame_index <= tracks[b].frames.back().frame_index &&
+               tracks[b].frames.front().frame_index <= tracks[a].frames.back().frame_index;
+    };
+    std::map<int, std::vector<int>> taken;  // identity -> tracks of this run
+    for (const Pair& p : pairs) {
+        if (tracks[p.track].identity >= 0) continue;
+        std::vector<int>& users = taken[p.identity];
+        bool clash = false;
+        for (int u : users) clash = clash || overlaps(u, p.track);
+        if (clash) continue;
+        tracks[p.track].identity = p.identity;
+        users.push_back(p.track);
+    }
+
+    int matched = 0;
+    int added = 0;
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        if (!track_app[t]) continue;
+        if (tracks[t].identity >= 0) {
+            gallery.update(tracks[t].identity, *track_app[t]);
+            matched++;
+        } else {
+            tracks[t].identity = gallery.add(*track_app[t]);
+            added++;
+        }
+    }
+    if (!gallery.save(options_.gallery_path, error)) {
+        fprintf(stderr, "Warning: %s\n", error.c_str());
+    }
+    if (std::getenv("FACE_PIPELINE_LOG_REID") != nullptr) {
+        fprintf(stderr, "Gallery: identities=%zu matched=%d added=%d\n", gallery.identities().size(), matched, added);
+    }
+    if (MetricsRegistry* metrics = options_.metrics.get()) {
+        metrics->add("gallery.matched", matched);
+        metrics->add("gallery.added", added);
+        metrics->set("gallery.identities", static_cast<double>(gallery.identities().size()));
+    }
+}
@@ -1,11 +1,25 @@
 #pragma once
 
+#include "detection_cache.hpp"
+#include "detection_dump.hpp"
+#include "detection_policy.hpp"
+#include "frame_source.hpp"
+#include "gmc.hpp"
+#include "scene_cut.hpp"
 #include "scrfd.hpp"
+#include "scrfd_variants.hpp"
+#include "metrics.hpp"
+#include "stage_profile.hpp"
+#include "identity_gallery.hpp"
+#include "memory_budget.hpp"
 #include "ocsort.hpp"
 #include "reid.hpp"
 
+#include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -16,6 +30,7 @@ struct TrackFrame {
     int frame_index;
     BBox bbox;  // Normalized coordinates (0-1)
     float confidence;
+    bool observed = false;  // a detection updated the track on this frame
 };
 
 /**
@@ -24,6 +39,7 @@ struct TrackFrame {
 struct FaceTrack {
     int id;
     std::vector<TrackFrame> frames;
+    int identity = -1;  // IdentityGallery id (PipelineOptions::gallery_path), -1 = none
 };
 
 /**
@@ -31,9 +47,165 @@ struct FaceTrack {
  */
 struct PipelineResult {
     std::vector<FaceTrack> tracks;
-    int frame_count;
+    int frame_count = 0;
+    // Streaming (see TrackSegmentSink): segment id -> id of the output
+    // track it was linked into, -1 where the linked track was too short or
+    // unconfident to keep. That track's other frames are in `tracks` unless
+    // all of them were streamed too.
+    std::map<int, int> segment_links;
+    // The run ended early (PipelineOptions::stop or time budget): frames
+    // from frame_count on were not read.
+    bool stopped = false;
+    // With PipelineOptions::keep_appearances: output track id -> its
+    // L2-normalized mean appearance, for tracks that have one.
+    std::map<int, EmbeddingF32> appearances{};
+    // Size of the input frames in pixels (0 when none was read).
+    int frame_width = 0;
+    int frame_height = 0;
 };
 
+/**
+ * Receives a tracklet (its OC-SORT track ID and frames, boxes smoothed if
+ * enabled) as soon as the tracker drops it, before offline linking. Called
+ * on the thread running FacePipeline::process().
+ */
+using TrackSegmentSink = std::function<void(const FaceTrack& segment)>;
+
+/**
+ * Execution options for the pipeline (threads, buffering, detector backend).
+ */
+struct PipelineOptions {
+    DetectorOptions detector;  // ncnn execution options for SCRFD
+    GpuOptions reid_gpu;       // Vulkan execution for the ReID network
+    OnnxRuntimeOptions reid_onnx;  // ONNX Runtime execution of <reid stem>.onnx
+    ReidGateOptions reid_gate;     // faces turned away before ReID cropping, per-frame ReID budget
+    ReidConfig reid = ReidConfigFromEnv();  // crop blur handling, appearance bank quality, offline linking limits
+    int decode_threads = 0;   // frame decoder threads (0 = auto)
+    int prefetch_depth = 8;   // max decoded frames buffered ahead of the tracker (0 = no prefetch)
+    int read_ahead = 0;       // image files read up to this many frames ahead of their decode (0 = off; see read_ahead.hpp)
+    int read_ahead_threads = 4;  // image file reads in flight at once
+    int advise_ahead = 0;     // hint the OS to read the image files of frames up to this far past the tracker (0 = off)
+    bool drop_file_cache = false;  // let the OS drop an image file's cached pages once the tracker is past its frame
+    bool delete_consumed = false;  // delete an image file once the tracker is past its frame (temporary sequences; no boundary refinement)
+    int decode_long_side = 1280;  // decoders may shrink RGB (JPEG DCT scaling, fused YUV->RGB reduction) down to this long side (0 = full res)
+    float input_scale = 1.0f;     // the frames are proxies at 1/N of the source resolution: boxes, warps and pixel thresholds are in source pixels (see ScaledFrameSource)
+    int detect_workers = 0;   // sampled frames detected concurrently (0 = auto, 1 = inline)
+    int gmc_workers = 0;      // frame pairs' GMC warps estimated concurrently ahead of the tracker (0 = auto, 1 = inline)
+    bool balance_stages = false;  // move cores between decode, detection, ReID and GMC as their load shifts (see StageBalancer)
+    int balance_period_ms = 250;  // with balance_stages: how often the stages are measured
+    int track_workers = 1;    // shots tracked concurrently once detection is done (0 = auto, 1 = track inline during detection)
+    int speculative_ahead = 0;  // with detect workers: on spare cores, detect unsampled frames up to this far ahead of the tracker (0 = off; timing-dependent)
+    bool reid_stage = true;   // with detect workers: embed faces on a thread of its own, overlapping detection
+    int tile_refresh = 0;     // with tiling and inline detection: scan all tiles every Nth detection, else only tiles near tracks (0 = always all)
+    std::string detector_stem;  // SCRFD files without extension (empty = <model_dir>/scrfd; see scrfd_variants.hpp)
+    int detector_input = 640;   // SCRFD network input side
+    std::string light_detector_stem;  // hybrid schedule: an ultra-light detector run on every frame between detections (empty = off; a bare name is looked up in the model dir; see light_detector.hpp)
+    int light_detector_input = 320;   // its network input side
+    float light_detector_conf = 0.6f;  // its confidence threshold
+    bool int8 = false;        // load scrfd-int8 / mobilefacenet-int8 models when present (see calibration.hpp)
+    int adaptive_input_face = 0;   // inline detection: shrink the detector input while the smallest track keeps this many input pixels (0 = off)
+    int adaptive_input_refresh = 8;  // with adaptive_input_face: full input every Nth detection, for new small faces
+    int cascade_input = 0;    // inline detection: a coarse pass at this input side first, the full one only when it is in doubt (0 = off)
+    float cascade_min_score = 0.3f;  // with cascade_input: coarse candidates from this score up to the threshold count as doubtful
+    int cascade_refresh = 8;  // with cascade_input: full pass every Nth detection, for faces too small for the coarse one
+    bool prune_strides = false;  // inline detection: skip SCRFD stride heads only faces under half the smallest track's size need
+    int prune_refresh = 8;    // with prune_strides: every stride every Nth detection, for new small faces
+    int roi_side = 0;         // between detections: detect in crops around tracks, each letterboxed to at most this side (0 = off)
+    float roi_margin = 0.5f;  // ROI = the track's previous box grown by this fraction of its size on each side
+    bool roi_mosaic = false;  // pack a frame's ROI crops into shared detector inputs instead of one pass each
+    bool landmark_flow = false;  // between detections: follow each track's landmarks by optical flow on the GMC luma planes (see landmark_flow.hpp)
+    float scan_fps = 0.0f;    // two-pass detection: scan at this rate first, then detect densely only near faces found (0 = off)
+    DetectionPolicyOptions adaptive;  // pick detection frames from tracker state instead of a fixed stride
+    SceneCutConfig scene_cuts;        // retire tracks and detect at once on the first frame of each shot
+    std::vector<int> cut_frames;      // first frames of shots the editor cut to (0-based input positions): cuts without analysis
+    GmcConfig gmc;                     // camera motion model and (without OpenCV) fallback estimator
+    StaticCameraConfig static_camera;  // skip GMC on shots the camera does not move in
+    SparseGmcConfig sparse_gmc;        // estimate GMC once per interval on smooth motion, carrying the step between
+    float duplicate_block_diff = 1.5f;  // frames within this per-block luma difference repeat the previous one (0 = off)
+    bool idle_fast_forward = false;  // while no track is alive, leave the frames between detections undecoded and untracked
+    int keyframe_snap = 0;   // frames a detection sample may move to land on a video keyframe (0 = off; see SampleGrid)
+    bool gmc_mask_faces = false;  // GMC: leave the latest detected faces (grown) out of camera motion estimation
+    bool lazy_reid = false;   // tracking: embed only faces association cannot settle by geometry (see OCSort::setLazyReid)
+    int reid_refresh = 10;    // lazy ReID: re-embed a settled track after this many observations without (0 = never)
+    bool bidirectional_tracking = false;  // tracking: also track each shot backwards in time and fuse both passes
+    int smooth_lag = 0;       // output: fixed-lag RTS smoothing of track boxes, frames of look-ahead (0 = off)
+    bool refine_boundaries = false;  // output: detect on the frames around each track's first and last observation for frame-accurate in/out points
+    float keyframe_tolerance = 0.0f;  // output: keep only the frames linear interpolation misses by more pixels than this (0 = all; see keyframes.hpp)
+    std::string proxy_dir;    // output: a small JPEG of every decoded frame goes here, for scrubbing (empty = none; see frame_proxies.hpp)
+    int proxy_height = 480;   // proxy rows
+    bool compact_tracks = false;  // output: keep finished tracklets quantized (see TrackStore) until the output is built
+    int track_spill_mb = 0;       // compact tracks: move them to a temporary file past this many MB in memory (0 = never)
+    int memory_budget_mb = 0;     // frame queues, the detection cache and compact tracks stay within this many MB together (0 = no limit; see MemoryBudget)
+    bool memory_report = false;   // count the caches, queues and working buffers without a budget, for the report at exit (see PrintMemoryReport)
+    int track_max_age = 90;      // tracking: frames a track survives without a detection
+    int track_tentative_age = 0;  // tracking: same for tracks with fewer than 3 detections, which the noise filter drops unless linked (0 = track_max_age)
+    int track_dormant_age = 0;    // tracking: frames without a detection after which a track is only matched again by OCR and leaves the output (0 = never; see OCSort::setDormantAfter)
+    float track_inertia = 0.2f;  // tracking: OC-SORT velocity direction weight
+    float track_motion_gate = 0.0f;  // tracking: drop pairs past this chi-square Mahalanobis distance on center and scale before their IoU is computed (0 = off; see OCSort::setMotionGate)
+    bool kalman_joseph = false;  // tracking: Joseph-form covariance updates (see KalmanStateBank::setJosephForm)
+    std::string detection_cache_path;  // detections and embeddings of frames, kept across runs (empty = none)
+    std::string dump_detections_path;    // tracker input of the run, written for replay (empty = none)
+    bool dump_warps = false;             // dump: every frame's GMC warp too, so replay needs no frames
+    std::string replay_detections_path;  // track from a dump instead of running the models (empty = no)
+    std::shared_ptr<const DetectionDump> replay;  // same, from a dump already loaded (takes precedence)
+    std::string checkpoint_path;  // tracking state saved along the way, for resume (empty = none)
+    int checkpoint_every = 300;   // frames between checkpoints
+    bool resume = false;          // start from checkpoint_path when it fits this input and these settings
+    std::string gallery_path;     // ReID: identity gallery read and updated by each run (empty = none)
+    float gallery_min_sim = 0.50f;  // track <-> identity cosine similarity needed to reuse an identity
+    bool keep_appearances = false;  // ReID: return each output track's appearance (PipelineResult::appearances)
+    std::shared_ptr<const std::atomic<bool>> stop;  // once set, a run stops reading frames and links what it has
+    double time_budget_s = 0.0;  // wall-clock seconds a run may take, then it stops like on `stop` (0 = no limit)
+    bool budget_degrade = true;  // time budget: detect less, skip ReID, then GMC to fit it first (see TimeBudget)
+    // Progress of a run, one call at a time (maybe from worker threads): ("frames", done, total) as frames are
+    // read (total -1 while unknown), ("shots", done, total) as deferred tracking finishes shots, then
+    // ("linking", 0, tracklets) as offline linking starts.
+    std::function<void(const char* stage, int done, int total)> progress;
+    std::shared_ptr<StageProfile> profile;  // every run's per-stage timings go here (--profile, --trace; null = none)
+    std::shared_ptr<MetricsRegistry> metrics;  // every run's statistics go here (--metrics, the server's "metrics"; null = none)
+};
+
+/**
+ * What one run of a loaded pipeline may set for itself (a pipeline kept
+ * loaded between runs, see server.hpp): the detection rate, the tracker's
+ * IoU and ReID thresholds, and from `tracking` its track_max_age,
+ * track_tentative_age, track_dormant_age, track_inertia, smooth_lag, keyframe_tolerance, cut_frames, stop,
+ * time budget and progress. The detector's confidence threshold and every other option
+ * keep the values the pipeline was loaded with.
+ */
+struct RunTuning {
+    float detection_fps = 5.0f;
+    float iou_thresh = 0.15f;
+    float reid_weight = 0.35f;
+    float reid_cos_thresh = 0.35f;
+    PipelineOptions tracking;
+};
+
+/**
+ * Frames a run with given settings can use without losing accuracy
+ * (--describe-requirements, the server's "requirements"), so an exporter
+ * can render the cheapest input that still serves it.
+ */
+struct FrameRequirements {
+    int min_long_side = 0;         // frames may be scaled down to this long side (0 = full resolution only)
+    int detector_input = 640;      // SCRFD input side the frames are letterboxed to
+    bool tiled = false;            // tiled detection reads source pixels
+    bool reid = false;             // ReID crops want more than the detector sees
+    std::string pixel_format;      // preferred raw frame format (--raw-input)
+    std::string container;         // preferred image file format
+};
+
+/**
+ * What frames `options` (with ReID if `reid`) need. Detection letterboxes
+ * every frame to `detector_input`, so larger frames add nothing to it.
+ * ReID crops and ROI detection keep decode_long_side, the floor decoders
+ * already reduce to; tiles, and decode_long_side 0, need full resolution.
+ */
+FrameRequirements DescribeFrameRequirements(const PipelineOptions& options, bool reid);
+
+/** The requirements as a JSON object ("minLongSide", "detectorInput", "tiled", ...). */
+std::string FrameRequirementsJson(const FrameRequirements& requirements);
+
 /**
  * Face detection and tracking pipeline.
  * 
@@ -55,6 +227,7 @@ public:
      * @param conf_thresh Face detection confidence threshold (default: 0.5)
      * @param detection_fps FPS for sparse face detection (default: 5.0)
      * @param iou_thresh IoU threshold for tracking (default: 0.15)
+     * @param options Execution options (decoding, prefetch, detector backend)
      */
     FacePipeline(const std::string& model_dir,
                  float conf_thresh = 0.5f,
@@ -62,12 +235,17 @@ public:
                  float iou_thresh = 0.15f,
                  const std::string& reid_model_dir = "",
                  float reid_weight = 0.35f,
-                 float reid_cos_thresh = 0.35f);
+                 float reid_cos_thresh = 0.35f,
+                 const PipelineOptions& options = PipelineOptions{});
     
     /**
-     * Check if pipeline is ready (model loaded successfully).
+     * Check if pipeline is ready (model loaded successfully, or the
+     * detection dump it replays).
      */
-    bool isLoaded() const { return detector_.IsLoaded(); }
+    bool isLoaded() const { return detector_.IsLoaded() || replay_ != nullptr; }
+
+    /** What the caches and queues of all runs hold (nullptr without PipelineOptions::memory_budget_mb or memory_report). */
+    const MemoryBudget* memoryBudget() const { return memory_budget_.get(); }
     
     /**
      * Process a list of image frames.
@@ -78,6 +256,41 @@ public:
      */
     PipelineResult process(const std::vector<std::string>& image_paths,
                            float video_fps = 30.0f);
+
+    /**
+     * Process frames from an arbitrary source (image list, raw stream, ...).
+     *
+     * Open-ended sources are read until they report end of stream.
+     *
+     * @param source Frame source, read in increasing index order
+     * @param video_fps Source video FPS (for sparse detection stride calculation)
+     * @return PipelineResult containing all face tracks
+     */
+    PipelineResult process(FrameSource& source, float video_fps = 30.0f);
+
+    /**
+     * Same, handing each tracklet to `on_segment` once it has ended instead
+     * of keeping its frames (see StreamingPipeline). Memory then grows with
+     * the number of tracks rather than with their length: offline linking
+     * only needs a tracklet's endpoints, counts and appearance. The result
+     * holds the tracks still open at the end (linked to the streamed
+     * segments, see PipelineResult::segment_links). Tracking runs inline as
+     * the frames arrive, and checkpoints are not written.
+     */
+    PipelineResult process(FrameSource& source, float video_fps, const TrackSegmentSink& on_segment);
+
+    /**
+     * Same, with this run's own tuning instead of the loaded one. Runs may
+     * go on concurrently, each with its own tuning: they share the models,
+     * the detection cache and the gallery (updated one run at a time).
+     *
+     * @param on_segment Tracklet sink as above, or empty to keep every track
+     */
+    PipelineResult process(FrameSource& source, float video_fps, const TrackSegmentSink& on_segment,
+                           const RunTuning& tuning);
+
+    /** The tuning runs get unless they bring their own. */
+    RunTuning tuning() const;
     
     /**
      * Detect faces in a single image.
@@ -90,17 +303,69 @@ public:
     std::vector<Detection> detectSingle(const std::string& image_path,
                                         int& width, int& height);
 
+    /**
+     * Detect faces in an already decoded RGB frame.
+     *
+     * @param rgb Interleaved RGB pixels (uint8)
+     * @param width Frame width
+     * @param height Frame height
+     * @param tile_focus Pixel boxes restricting which tiles run (see ScrfdDetector::Detect)
+     * @param max_side Caps the detector input side (0 = the configured one)
+     * @param frame Optional frame `rgb` belongs to, whose full-resolution
+     *              regions (LoadedRgbFrame::read_full_res) ReID may read
+     * @param min_face Smallest face side to find in `rgb` pixels (see ScrfdDetector::Detect)
+     * @return List of detected faces as normalized detections (bbox + score)
+     */
+    std::vector<Detection> detectRgb(const unsigned char* rgb, int width, int height,
+                                     const std::vector<std::array<float, 4>>* tile_focus = nullptr,
+                                     int max_side = 0, const LoadedRgbFrame* frame = nullptr, int min_face = 0);
+
 private:
     ScrfdDetector detector_;
+    std::unique_ptr<FaceDetector> light_detector_;     // see PipelineOptions::light_detector_stem
     float conf_thresh_;
     float detection_fps_;
     float iou_thresh_;
+    PipelineOptions options_;
 
     std::unique_ptr<MobileFaceNetReid> reid_;
+    std::unique_ptr<MemoryBudget> memory_budget_;      // see PipelineOptions::memory_budget_mb, memory_report; outlives its accounts
+    std::unique_ptr<DetectionCache> detection_cache_;  // see PipelineOptions::detection_cache_path
+    uint64_t checkpoint_model_key_ = 0;                // DetectionModelKey of the models, for checkpoints
+    std::shared_ptr<const DetectionDump> replay_;      // see PipelineOptions::replay_detections_path
     bool use_reid_ = false;
     float reid_weight_ = 0.35f;
     float reid_cos_thresh_ = 0.35f;
+    mutable std::mutex gallery_mu_;  // concurrent runs read, update and save the gallery one at a time
     
+    /**
+     * Load the ReID network from `reid_model_dir` (use_reid_ is cleared if
+     * there is none). Returns its file stem, empty without one.
+     */
+    std::string loadReid(const std::string& reid_model_dir);
+
+    /**
+     * Normalize detector output, with ReID embeddings if `with_reid` and enabled.
+     */
+    std::vector<Detection> toDetections(const std::vector<ScrfdFace>& faces,
+                                        const unsigned char* rgb, int width, int height,
+                                        bool with_reid, const LoadedRgbFrame* frame = nullptr);
+
+    /**
+     * Fill the embeddings of dets[indices] from their pixel geometry in `rgb`
+     * (small faces from `frame`'s full-resolution regions if it has them).
+     */
+    void embedDetections(std::vector<Detection>& dets, const std::vector<int>& indices,
+                         const unsigned char* rgb, int width, int height,
+                         const LoadedRgbFrame* frame = nullptr) const;
+
+    /**
+     * Give each track with an appearance a gallery identity: the most
+     * similar one above gallery_min_sim that no time-overlapping track of
+     * this run took, else a new one. Updates and saves the gallery.
+     */
+    void assignIdentities(std::vector<FaceTrack>& tracks, const std::map<int, EmbeddingF32>& appearance) const;
+
     /**
      * Convert ScrfdFace to BBox with normalized coordinates.
      */
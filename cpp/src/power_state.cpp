@@ -0,0 +1,100 @@
+#include "power_state.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(__APPLE__)
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/ps/IOPowerSources.h>
+#include <notify.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace {
+#if !defined(__APPLE__) && !defined(_WIN32)
+// First line of a sysfs attribute (false if it cannot be read).
+bool ReadAttribute(const std::string& path, std::string& out) {
+    std::ifstream f(path);
+    return static_cast<bool>(std::getline(f, out));
+}
+
+// Names under `dir` starting with `prefix`.
+template <typename Fn>
+void ForEachEntry(const char* dir, const char* prefix, Fn fn) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+    const size_t n = std::strlen(prefix);
+    while (const dirent* e = readdir(d)) {
+        if (e->d_name[0] != '.' && std::strncmp(e->d_name, prefix, n) == 0) fn(std::string(dir) + "/" + e->d_name);
+    }
+    closedir(d);
+}
+#endif
+}  // namespace
+
+PowerState QueryPowerState() {
+    PowerState state;
+#if defined(__APPLE__)
+    if (CFTypeRef info = IOPSCopyPowerSourcesInfo()) {
+        CFStringRef type = IOPSGetProvidingPowerSourceType(info);
+        state.on_battery = type && CFStringCompare(type, CFSTR(kIOPSBatteryPowerValue), 0) == kCFCompareEqualTo;
+        CFRelease(info);
+    }
+    // kOSThermalPressureLevel*: 0 is nominal, 1 moderate and up. Low Power
+    // Mode has no C API; on a laptop it comes with the battery anyway.
+    int token = 0;
+    if (notify_register_check("com.apple.system.thermalpressurelevel", &token) == NOTIFY_STATUS_OK) {
+        uint64_t level = 0;
+        if (notify_get_state(token, &level) == NOTIFY_STATUS_OK) state.thermal_pressure = level >= 1;
+        notify_cancel(token);
+    }
+#elif defined(_WIN32)
+    SYSTEM_POWER_STATUS status;
+    if (GetSystemPowerStatus(&status)) {
+        state.on_battery = status.ACLineStatus == 0;
+        state.low_power = status.SystemStatusFlag == 1;  // battery saver
+    }
+#else
+    std::string value;
+    ForEachEntry("/sys/class/power_supply", "", [&](const std::string& supply) {
+        if (ReadAttribute(supply + "/type", value) && value == "Battery" && ReadAttribute(supply + "/status", value)) {
+            state.on_battery = state.on_battery || value == "Discharging";
+        }
+    });
+    if (ReadAttribute("/sys/firmware/acpi/platform_profile", value)) {
+        state.low_power = value == "low-power" || value == "quiet";
+    }
+    // A zone at or past a passive trip point is being cooled by throttling.
+    ForEachEntry("/sys/class/thermal", "thermal_zone", [&](const std::string& zone) {
+        if (!ReadAttribute(zone + "/temp", value)) return;
+        const long temp = std::atol(value.c_str());
+        for (int k = 0; ReadAttribute(zone + "/trip_point_" + std::to_string(k) + "_type", value); ++k) {
+            if (value != "passive") continue;
+            if (ReadAttribute(zone + "/trip_point_" + std::to_string(k) + "_temp", value) && temp > 0 &&
+                temp >= std::atol(value.c_str())) {
+                state.thermal_pressure = true;
+            }
+        }
+    });
+#endif
+    return state;
+}
+
+bool ParseEnergyProfile(const char* name, EnergyProfile& out) {
+    if (std::strcmp(name, "off") == 0) {
+        out = EnergyProfile::Off;
+    } else if (std::strcmp(name, "auto") == 0) {
+        out = EnergyProfile::Auto;
+    } else if (std::strcmp(name, "on") == 0) {
+        out = EnergyProfile::On;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+/**
+ * What the machine's power state asks of a long run (--energy-profile).
+ * Fields a platform cannot report stay false.
+ */
+struct PowerState {
+    bool on_battery = false;        // running from a discharging battery
+    bool low_power = false;         // the OS' low-power / battery-saver mode is on
+    bool thermal_pressure = false;  // the CPU is throttled or about to be
+
+    bool saving() const { return on_battery || low_power; }
+};
+
+/**
+ * The current power state: IOKit's power source and the thermal pressure
+ * notification on macOS, sysfs power supplies, platform profile and
+ * passive trip points on Linux, GetSystemPowerStatus() on Windows.
+ */
+PowerState QueryPowerState();
+
+/**
+ * When the energy profile applies (see main.cpp): never, when the machine
+ * saves power (PowerState::saving()), or always.
+ */
+enum class EnergyProfile { Off, Auto, On };
+
+/**
+ * Parse "off", "auto" or "on".
+ */
+bool ParseEnergyProfile(const char* name, EnergyProfile& out);
@@ -0,0 +1,147 @@
+#include "prefetcher.hpp"
+#include "huge_pages.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+FramePrefetcher::FramePrefetcher(int frame_count, int num_threads, int depth, FrameCache::Loader loader,
+                                 int first_frame, std::unique_ptr<MemoryBudget::Account> account, int max_threads)
+    : frame_count_(std::max(0, frame_count)),
+      loader_(std::move(loader)),
+      slots_(static_cast<size_t>(std::max(1, depth))),
+      next_claim_(std::max(0, first_frame)),
+      next_take_(std::max(0, first_frame)),
+      account_(std::move(account)) {
+    const int depth_cap = static_cast<int>(slots_.size());
+    const int n = std::max(1, std::min(num_threads, depth_cap));
+    const int spawned = std::max(n, std::min(max_threads, depth_cap));
+    active_ = n;
+    workers_.reserve(static_cast<size_t>(spawned));
+    for (int t = 0; t < spawned; ++t) {
+        workers_.emplace_back([this, t] { workerLoop(t); });
+    }
+}
+
+FramePrefetcher::~FramePrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_space_.notify_all();
+    cv_ready_.notify_all();
+    for (auto& t : workers_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+int FramePrefetcher::ResolveThreadCount(int requested) {
+    if (requested > 0) return requested;
+    // Leave a core for the tracking loop itself.
+    return std::max(1, std::min(4, PipelineCoreCount() - 1));
+}
+
+void FramePrefetcher::setActiveThreads(int n) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        active_ = std::max(1, std::min(n, numThreads()));
+    }
+    cv_space_.notify_all();
+}
+
+int FramePrefetcher::activeThreads() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return active_;
+}
+
+void FramePrefetcher::workerLoop(int id) {
+    ConfigureWorkerThread();
+    for (;;) {
+        int index = -1;
+        size_t rgb_bytes = 0, luma_bytes = 0;
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            cv_space_.wait(lock, [this, id] {
+                return stop_ || next_claim_ >= frame_count_ ||
+                       (id < active_ && next_claim_ < next_take_ + static_cast<int>(slots_.size()) &&
+                        (!account_ || next_claim_ == next_take_ || account_->fits(frame_bytes_)));
+            });
+            if (stop_ || next_claim_ >= frame_count_) return;
+            index = next_claim_++;
+            Slot& slot = slots_[static_cast<size_t>(index) % slots_.size()];
+            slot.index = index;
+            slot.done = false;
+            slot.ok = false;
+            rgb_bytes = rgb_bytes_;
+            luma_bytes = luma_bytes_;
+            if (account_) {
+                // Charged up front, so concurrent claims see each other.
+                held_bytes_ = held_bytes_ - slot.bytes + frame_bytes_;
+                slot.bytes = frame_bytes_;
+                account_->set(held_bytes_);
+            }
+        }
+
+        // The claimed slot is not touched by anyone else until it is marked
+        // done, so decode straight into its (recycled) buffers.
+        Slot& slot = slots_[static_cast<size_t>(index) % slots_.size()];
+        ReserveHugePages(slot.frame.rgb, rgb_bytes);
+        ReserveHugePages(slot.frame.luma, luma_bytes);
+        const auto start = std::chrono::steady_clock::now();
+        const bool ok = loader_ && loader_(index, slot.frame);
+        busy_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                        .count();
+
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            slot.ok = ok;
+            slot.done = true;
+            rgb_bytes_ = std::max(rgb_bytes_, slot.frame.rgb.capacity());
+            luma_bytes_ = std::max(luma_bytes_, slot.frame.luma.capacity());
+            if (account_) {
+                const size_t bytes = slot.frame.ownedBytes();
+                frame_bytes_ = std::max(frame_bytes_, bytes);
+                held_bytes_ = held_bytes_ - slot.bytes + bytes;
+                slot.bytes = bytes;
+                account_->set(held_bytes_);
+            }
+        }
+        cv_ready_.notify_all();
+    }
+}
+
+int FramePrefetcher::ready() {
+    std::lock_guard<std::mutex> lock(mu_);
+    int n = 0;
+    for (const Slot& slot : slots_) n += slot.done && slot.index >= next_take_ ? 1 : 0;
+    return n;
+}
+
+bool FramePrefetcher::take(int index, LoadedRgbFrame& out) {
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        if (index == next_take_ && index < frame_count_) {
+            Slot& slot = slots_[static_cast<size_t>(index) % slots_.size()];
+            cv_ready_.wait(lock, [&] { return stop_ || (slot.index == index && slot.done); });
+            if (stop_) return false;
+            // Swap rather than move: the consumer's previous buffers go back
+            // into the slot for the next frame decoded there.
+            std::swap(out, slot.frame);
+            if (account_) {
+                slot.frame = LoadedRgbFrame();
+                held_bytes_ -= slot.bytes;
+                slot.bytes = 0;
+                account_->set(held_bytes_);
+            } else {
+                slot.frame.clear();
+            }
+            const bool ok = slot.ok;
+            next_take_++;
+            lock.unlock();
+            cv_space_.notify_all();
+            return ok;
+        }
+    }
+    // Out-of-order request: decode synchronously on the caller.
+    return loader_ && loader_(index, out);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_cache.hpp"
+#include "memory_budget.hpp"
+
+/**
+ * Asynchronous, order-preserving frame prefetcher.
+ *
+ * A small pool of decoder threads decodes frames ahead of the consumer into a
+ * bounded window of `depth` slots, so decode overlaps with detection, GMC and
+ * tracking. Memory is capped at `depth` decoded frames in flight.
+ *
+ * Frames must be taken in increasing index order (the tracking loop does
+ * this); out-of-order requests fall back to a synchronous decode.
+ *
+ * With a memory budget account, the frames in flight are charged to it and
+ * a frame is only decoded ahead while another one (as large as the largest
+ * so far) fits the budget; one frame in flight is always allowed. Taken
+ * slots then give their buffers back instead of recycling them.
+ *
+ * With `max_threads` above `num_threads`, the extra threads start parked;
+ * setActiveThreads() wakes or parks them (StageBalancer moves cores this
+ * way). A parked thread finishes the frame it has claimed first.
+ *
+ * Usage:
+ *   FramePrefetcher prefetch(n, 4, 8, loader);
+ *   FrameCache cache(2, [&](int i, LoadedRgbFrame& f) { return prefetch.take(i, f); });
+ */
+class FramePrefetcher {
+public:
+    /** Decodes frames first_frame ... frame_count - 1 (a resumed run starts past 0). */
+    FramePrefetcher(int frame_count, int num_threads, int depth, FrameCache::Loader loader, int first_frame = 0,
+                    std::unique_ptr<MemoryBudget::Account> account = nullptr, int max_threads = 0);
+    ~FramePrefetcher();
+
+    FramePrefetcher(const FramePrefetcher&) = delete;
+    FramePrefetcher& operator=(const FramePrefetcher&) = delete;
+
+    /**
+     * Block until frame `index` is decoded and move it into `out`.
+     *
+     * @return false if the frame could not be decoded
+     */
+    bool take(int index, LoadedRgbFrame& out);
+
+    int numThreads() const { return static_cast<int>(workers_.size()); }
+
+    /** Threads claiming frames, 1 ... numThreads(); the others park. */
+    void setActiveThreads(int n);
+    int activeThreads();
+
+    /** Time spent in the loader, summed over the threads. */
+    double busyMs() const { return static_cast<double>(busy_ns_.load()) * 1e-6; }
+
+    /** Frames decoded ahead of the consumer, waiting to be taken. */
+    int ready();
+
+    /**
+     * Resolve a decoder thread count (`requested <= 0` = auto).
+     */
+    static int ResolveThreadCount(int requested);
+
+private:
+    struct Slot {
+        int index = -1;
+        bool done = false;
+        bool ok = false;
+        size_t bytes = 0;  // charged to account_
+        LoadedRgbFrame frame;
+    };
+
+    void workerLoop(int id);
+
+    const int frame_count_;
+    FrameCache::Loader loader_;
+
+    std::mutex mu_;
+    std::condition_variable cv_ready_;
+    std::condition_variable cv_space_;
+    std::vector<Slot> slots_;
+    int next_claim_ = 0;   // next frame index a worker will decode
+    int next_take_ = 0;    // next frame index the consumer expects
+    bool stop_ = false;
+    int active_ = 0;       // threads with a lower id claim frames
+    std::atomic<int64_t> busy_ns_{0};
+    std::unique_ptr<MemoryBudget::Account> account_;
+    size_t held_bytes_ = 0;   // charged for the slots in flight
+    size_t frame_bytes_ = 0;  // largest decoded frame so far
+    size_t rgb_bytes_ = 0;    // largest planes decoded so far, reserved in huge pages
+    size_t luma_bytes_ = 0;   // for slots without buffers (see huge_pages.hpp)
+
+    std::vector<std::thread> workers_;
+};
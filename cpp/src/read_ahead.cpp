@@ -0,0 +1,146 @@
+#include "read_ahead.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// The whole file at `path` into `out` (its capacity reused).
+bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& out) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    out.clear();
+    bool ok = std::fseek(f, 0, SEEK_END) == 0;
+    const long size = ok ? std::ftell(f) : -1;
+    ok = ok && size > 0 && std::fseek(f, 0, SEEK_SET) == 0;
+    if (ok) {
+        out.resize(static_cast<size_t>(size));
+        ok = std::fread(out.data(), 1, out.size(), f) == out.size();
+    }
+    std::fclose(f);
+    return ok;
+}
+}  // namespace
+
+void AdviseFileCache(const std::string& path, FileCacheHint hint) {
+#if defined(__APPLE__)
+    if (hint != FileCacheHint::WillNeed) return;
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        radvisory ra;
+        ra.ra_offset = 0;
+        ra.ra_count = static_cast<int>(std::min<off_t>(st.st_size, INT_MAX));
+        ::fcntl(fd, F_RDADVISE, &ra);
+    }
+    ::close(fd);
+#elif !defined(_WIN32)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    ::posix_fadvise(fd, 0, 0, hint == FileCacheHint::WillNeed ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED);
+    ::close(fd);
+#else
+    (void)path;
+    (void)hint;
+#endif
+}
+
+FileReadAhead::FileReadAhead(int count, int depth, int threads, PathAt path_at, Wanted wanted, int first)
+    : count_(std::max(0, count)),
+      depth_(std::max(1, depth)),
+      path_at_(std::move(path_at)),
+      wanted_(std::move(wanted)),
+      taken_(static_cast<size_t>(std::max(0, count)), 0),
+      low_(std::max(0, first)),
+      next_(std::max(0, first)) {
+    const int n = std::max(1, std::min(threads, depth_));
+    threads_.reserve(static_cast<size_t>(n));
+    for (int t = 0; t < n; ++t) {
+        threads_.emplace_back([this] { ioLoop(); });
+    }
+}
+
+FileReadAhead::~FileReadAhead() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_work_.notify_all();
+    cv_done_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+void FileReadAhead::advanceLow() {
+    while (low_ < count_ && (taken_[static_cast<size_t>(low_)] || !wanted_(low_))) low_++;
+}
+
+void FileReadAhead::ioLoop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    for (;;) {
+        while (next_ < count_ && next_ < low_ + depth_ && (taken_[static_cast<size_t>(next_)] || !wanted_(next_))) {
+            next_++;
+        }
+        if (stop_) return;
+        if (next_ >= count_ || next_ >= low_ + depth_) {
+            cv_work_.wait(lock);
+            continue;
+        }
+        const int index = next_++;
+        // std::map nodes stay put, and a take waits for the read to finish
+        // before it erases the entry.
+        Entry& entry = entries_[index];
+        std::vector<uint8_t> bytes;
+        if (!free_.empty()) {
+            bytes = std::move(free_.back());
+            free_.pop_back();
+        }
+        const std::string path = path_at_(index);
+        lock.unlock();
+        const bool ok = ReadWholeFile(path, bytes);
+        lock.lock();
+        entry.bytes = std::move(bytes);
+        entry.ok = ok;
+        entry.done = true;
+        cv_done_.notify_all();
+    }
+}
+
+bool FileReadAhead::take(int index, std::vector<uint8_t>& bytes) {
+    std::unique_lock<std::mutex> lock(mu_);
+    if (index < 0 || index >= count_) return false;
+    taken_[static_cast<size_t>(index)] = 1;
+    auto it = entries_.find(index);
+    bool ok = false;
+    if (it != entries_.end()) {
+        cv_done_.wait(lock, [&] { return stop_ || it->second.done; });
+        ok = it->second.done && it->second.ok;
+        if (ok) {
+            bytes.swap(it->second.bytes);
+            free_.push_back(std::move(it->second.bytes));
+        }
+        if (it->second.done) entries_.erase(it);
+    }
+    // A frame taken before its read was issued is skipped by the I/O loop.
+    advanceLow();
+    ok ? hits_++ : misses_++;
+    lock.unlock();
+    cv_work_.notify_all();
+    return ok;
+}
+
+int FileReadAhead::hits() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return hits_;
+}
+
+int FileReadAhead::misses() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return misses_;
+}
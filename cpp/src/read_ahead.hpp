@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Page-cache hints for a frame's file (see AdviseFileCache). */
+enum class FileCacheHint {
+    WillNeed,  // read soon: start reading it in now
+    Done,      // consumed: its cached pages may go
+};
+
+/**
+ * Tell the OS how frame file `path` will be used (--advise-ahead,
+ * --drop-file-cache): posix_fadvise WILLNEED / DONTNEED, or F_RDADVISE on
+ * macOS. Only a hint, and a no-op where there is none (macOS has no way to
+ * evict one file's pages, Windows no per-file hints at all).
+ */
+void AdviseFileCache(const std::string& path, FileCacheHint hint);
+
+/**
+ * Reads the files of upcoming frames ahead of their decode (--read-ahead).
+ *
+ * On network storage a frame's read waits on latency, not on the disk or
+ * the CPU, and a decoder that opens its own file waits through it. I/O
+ * threads here keep up to `depth` reads outstanding from the lowest frame
+ * not yet taken on, each wanted frame's whole file into a pooled buffer;
+ * decoders then take the bytes and decode them from memory.
+ *
+ * Frames are wanted in increasing order but may be taken in any order by
+ * several decoders. A frame not read ahead (outside the window, already
+ * taken, or a failed read) is simply not found: the caller reads it itself.
+ */
+class FileReadAhead {
+public:
+    using PathAt = std::function<std::string(int)>;  // file of frame `index`
+    using Wanted = std::function<bool(int)>;         // frame `index` will be decoded
+
+    /**
+     * @param count Number of frames
+     * @param depth Frames read ahead at most (read or in flight, not yet taken)
+     * @param threads I/O threads, i.e. reads in flight at once
+     * @param first First frame (a resumed run starts past 0)
+     */
+    FileReadAhead(int count, int depth, int threads, PathAt path_at, Wanted wanted, int first = 0);
+    ~FileReadAhead();
+
+    FileReadAhead(const FileReadAhead&) = delete;
+    FileReadAhead& operator=(const FileReadAhead&) = delete;
+
+    /**
+     * The bytes of frame `index`'s file, waiting for its read if it is in
+     * flight. `bytes`' old buffer goes back to the pool.
+     *
+     * @return false if the frame was not read ahead
+     */
+    bool take(int index, std::vector<uint8_t>& bytes);
+
+    int hits() const;    // takes served from the read-ahead
+    int misses() const;  // takes of frames it did not have
+
+private:
+    struct Entry {
+        bool done = false;
+        bool ok = false;
+        std::vector<uint8_t> bytes;
+    };
+
+    void ioLoop();
+    // Move low_ past frames taken or not wanted (mu_ held).
+    void advanceLow();
+
+    const int count_;
+    const int depth_;
+    PathAt path_at_;
+    Wanted wanted_;
+    mutable std::mutex mu_;
+    std::condition_variable cv_work_;
+    std::condition_variable cv_done_;
+    std::map<int, Entry> entries_;   // read or in flight
+    std::vector<char> taken_;        // per frame
+    std::vector<std::vector<uint8_t>> free_;  // pooled buffers
+    int low_;       // lowest frame not yet taken
+    int next_;      // next frame to read
+    bool stop_ = false;
+    int hits_ = 0;
+    int misses_ = 0;
+    std::vector<std::thread> threads_;  // declared last: they read the members above
+};
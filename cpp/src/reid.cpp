@@ -1,9 +1,13 @@
 #include "reid.hpp"
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include "tracy_zones.hpp"
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
-#include <thread>
+#include <cstring>
 
 namespace {
 inline int clampi(int v, int lo, int hi) {
@@ -23,13 +27,6 @@ inline float GetEnvFloat(const char* name, float fallback) {
     return out;
 }
 
-inline void l2_normalize(std::array<float, MobileFaceNetReid::kDim>& v) {
-    double ss = 0.0;
-    for (float x : v) ss += static_cast<double>(x) * static_cast<double>(x);
-    const double inv = 1.0 / (std::sqrt(ss) + 1e-12);
-    for (float& x : v) x = static_cast<float>(static_cast<double>(x) * inv);
-}
-
 struct Similarity2x3 {
     // [ a -b tx ]
     // [ b  a ty ]
@@ -101,77 +98,37 @@ inline void InvertSimilarity(const Similarity2x3& M, Similarity2x3& inv) {
     inv.ty = -(q * M.tx + p * M.ty);
 }
 
-inline void SampleBilinearRGB(const unsigned char* rgb, int w, int h,
-                              float x, float y, unsigned char out_rgb[3]) {
-    x = clampf(x, 0.0f, static_cast<float>(w - 1));
-    y = clampf(y, 0.0f, static_cast<float>(h - 1));
-
-    const int x0 = static_cast<int>(std::floor(x));
-    const int y0 = static_cast<int>(std::floor(y));
-    const int x1 = std::min(x0 + 1, w - 1);
-    const int y1 = std::min(y0 + 1, h - 1);
-    const float dx = x - static_cast<float>(x0);
-    const float dy = y - static_cast<float>(y0);
-
-    const int idx00 = (y0 * w + x0) * 3;
-    const int idx10 = (y0 * w + x1) * 3;
-    const int idx01 = (y1 * w + x0) * 3;
-    const int idx11 = (y1 * w + x1) * 3;
-
-    for (int c = 0; c < 3; ++c) {
-        const float v00 = static_cast<float>(rgb[idx00 + c]);
-        const float v10 = static_cast<float>(rgb[idx10 + c]);
-        const float v01 = static_cast<float>(rgb[idx01 + c]);
-        const float v11 = static_cast<float>(rgb[idx11 + c]);
-        const float v0 = v00 + (v10 - v00) * dx;
-        const float v1 = v01 + (v11 - v01) * dx;
-        const float v = v0 + (v1 - v0) * dy;
-        out_rgb[c] = static_cast<unsigned char>(clampf(v, 0.0f, 255.0f));
-    }
+constexpr int kCropSide = 112;
+
+// Rec. 601-ish luma of the 112x112 crop, shared by the quality checks below.
+inline void ComputeLuma112(const std::vector<unsigned char>& rgb112, std::vector<float>& luma) {
+    luma.assign(static_cast<size_t>(kCropSide * kCropSide), 0.0f);
+    if (rgb112.size() < luma.size() * 3u) return;
+    RgbToLumaF32(rgb112.data(), kCropSide * kCropSide, luma.data());
 }
 
-inline float Luma(const unsigned char rgb[3]) {
-    // Rec. 601-ish luma
-    return 0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2];
+inline float LaplacianAt(const std::vector<float>& luma, int i) {
+    return 4.0f * luma[i] - luma[i - kCropSide] - luma[i + kCropSide] - luma[i - 1] - luma[i + 1];
 }
 
-inline float LumaAt(const std::vector<unsigned char>& rgb, int idx) {
-    const unsigned char px[3] = {rgb[idx], rgb[idx + 1], rgb[idx + 2]};
-    return Luma(px);
+// Brightness, gradient and Laplacian sums of the crop's luma in one pass.
+inline LumaPlaneStats ComputeCropStats112(const std::vector<float>& luma112) {
+    return ComputeLumaPlaneStats(luma112.data(), kCropSide, kCropSide);
 }
 
-inline float ComputeLaplacianVariance112(const std::vector<unsigned char>& aligned_rgb112) {
-    constexpr int W = 112;
-    constexpr int H = 112;
-    if (aligned_rgb112.size() < static_cast<size_t>(W * H * 3)) return 0.0f;
-    double sum = 0.0;
-    double sum_sq = 0.0;
-    int count = 0;
-    for (int y = 1; y < H - 1; ++y) {
-        for (int x = 1; x < W - 1; ++x) {
-            const int idx = (y * W + x) * 3;
-            const float c = LumaAt(aligned_rgb112, idx);
-            const float n = LumaAt(aligned_rgb112, idx - W * 3);
-            const float s = LumaAt(aligned_rgb112, idx + W * 3);
-            const float w = LumaAt(aligned_rgb112, idx - 3);
-            const float e = LumaAt(aligned_rgb112, idx + 3);
-            const float lap = 4.0f * c - n - s - w - e;
-            sum += static_cast<double>(lap);
-            sum_sq += static_cast<double>(lap) * static_cast<double>(lap);
-            count++;
-        }
-    }
-    if (count <= 0) return 0.0f;
-    const double mean = sum / static_cast<double>(count);
-    const double var = (sum_sq / static_cast<double>(count)) - (mean * mean);
+inline float ComputeLaplacianVariance(const LumaPlaneStats& stats, int side) {
+    const int count = (side - 2) * (side - 2);
+    const double mean = stats.lap_sum / static_cast<double>(count);
+    const double var = (stats.lap_sum_sq / static_cast<double>(count)) - (mean * mean);
     return static_cast<float>(std::max(0.0, var));
 }
 
 inline void ApplyLaplacianSharpen112(const std::vector<unsigned char>& src,
+                                     const std::vector<float>& luma112,
                                      std::vector<unsigned char>& dst,
                                      float alpha) {
-    constexpr int W = 112;
-    constexpr int H = 112;
+    constexpr int W = kCropSide;
+    constexpr int H = kCropSide;
     if (src.size() < static_cast<size_t>(W * H * 3)) return;
     dst.resize(src.size());
     // Copy borders unchanged.
@@ -188,12 +145,7 @@ inline void ApplyLaplacianSharpen112(const std::vector<unsigned char>& src,
     for (int y = 1; y < H - 1; ++y) {
         for (int x = 1; x < W - 1; ++x) {
             const int idx = (y * W + x) * 3;
-            const float c = LumaAt(src, idx);
-            const float n = LumaAt(src, idx - W * 3);
-            const float s = LumaAt(src, idx + W * 3);
-            const float w = LumaAt(src, idx - 3);
-            const float e = LumaAt(src, idx + 3);
-            const float lap = 4.0f * c - n - s - w - e;
+            const float lap = LaplacianAt(luma112, y * W + x);
             for (int ch = 0; ch < 3; ++ch) {
                 const float v = static_cast<float>(src[idx + ch]) + alpha * lap;
                 dst[idx + ch] = static_cast<unsigned char>(clampf(v, 0.0f, 255.0f));
@@ -202,7 +154,7 @@ inline void ApplyLaplacianSharpen112(const std::vector<unsigned char>& src,
     }
 }
 
-inline float ComputeQuality112(const std::vector<unsigned char>& aligned_rgb112,
+inline float ComputeQuality112(const LumaPlaneStats& stats,
                               float box_w, float box_h, int img_w, int img_h) {
     // Size score (favor reasonably large faces; keep conservative for LivePD low-light).
     const float min_dim = static_cast<float>(std::max(1, std::min(img_w, img_h)));
@@ -210,29 +162,9 @@ inline float ComputeQuality112(const std::vector<unsigned char>& aligned_rgb112,
     const float size_score = clampf((diag_norm - 0.03f) / (0.15f - 0.03f), 0.0f, 1.0f);
 
     // Brightness + sharpness on aligned crop.
-    double mean_l = 0.0;
-    double mean_grad = 0.0;
-    const int W = 112, H = 112;
-    for (int y = 0; y < H; ++y) {
-        for (int x = 0; x < W; ++x) {
-            const int idx = (y * W + x) * 3;
-            unsigned char px[3] = {aligned_rgb112[idx], aligned_rgb112[idx + 1], aligned_rgb112[idx + 2]};
-            const float l = Luma(px);
-            mean_l += l;
-
-            if (x + 1 < W) {
-                unsigned char pxr[3] = {aligned_rgb112[idx + 3], aligned_rgb112[idx + 4], aligned_rgb112[idx + 5]};
-                mean_grad += std::abs(Luma(pxr) - l);
-            }
-            if (y + 1 < H) {
-                const int idy = ((y + 1) * W + x) * 3;
-                unsigned char pxb[3] = {aligned_rgb112[idy], aligned_rgb112[idy + 1], aligned_rgb112[idy + 2]};
-                mean_grad += std::abs(Luma(pxb) - l);
-            }
-        }
-    }
-    mean_l /= static_cast<double>(W * H);
-    mean_grad /= static_cast<double>((W - 1) * H + (H - 1) * W);
+    const int W = kCropSide, H = kCropSide;
+    const double mean_l = stats.sum / static_cast<double>(W * H);
+    const double mean_grad = stats.grad_sum / static_cast<double>((W - 1) * H + (H - 1) * W);
 
     const float brightness_score = clampf((static_cast<float>(mean_l) - 40.0f) / (180.0f - 40.0f), 0.0f, 1.0f);
     const float sharpness_score = clampf((static_cast<float>(mean_grad) - 2.0f) / 10.0f, 0.0f, 1.0f);
@@ -242,37 +174,73 @@ inline float ComputeQuality112(const std::vector<unsigned char>& aligned_rgb112,
 }
 }  // namespace
 
-MobileFaceNetReid::MobileFaceNetReid(const std::string& param_path, const std::string& bin_path) {
-    (void)Load(param_path, bin_path);
+ReidConfig ReidConfigFromEnv() {
+    ReidConfig config;
+    config.blur_sharpen_var = GetEnvFloat("FACE_PIPELINE_REID_BLUR_SHARPEN_VAR", config.blur_sharpen_var);
+    config.blur_skip_var = GetEnvFloat("FACE_PIPELINE_REID_BLUR_SKIP_VAR", config.blur_skip_var);
+    config.sharpen_alpha = GetEnvFloat("FACE_PIPELINE_REID_LAPLACIAN_ALPHA", config.sharpen_alpha);
+    return config;
 }
 
-bool MobileFaceNetReid::Load(const std::string& param_path, const std::string& bin_path) {
-    loaded_ = false;
+MobileFaceNetReid::MobileFaceNetReid(const std::string& param_path, const std::string& bin_path,
+                                     const GpuOptions& gpu, const OnnxRuntimeOptions& onnx) {
+    (void)Load(param_path, bin_path, gpu, onnx);
+}
 
-    // Ensure CPU-only. (This project ships CPU ncnn dylibs.)
-    net_.opt.use_vulkan_compute = false;
-    net_.opt.num_threads = static_cast<int>(std::max(1u, std::min(4u, std::thread::hardware_concurrency())));
+bool MobileFaceNetReid::Load(const std::string& param_path, const std::string& bin_path,
+                             const GpuOptions& gpu, const OnnxRuntimeOptions& onnx) {
+    loaded_ = false;
+    dim_ = 0;
+    backend_.reset();
+
+    // CPU unless a Vulkan device was requested (and found).
+    net_.opt.num_threads = std::min(4, PipelineCoreCount());
+
+    if (!LoadNcnnNet(net_, param_path, bin_path, gpu, on_gpu_)) return false;
+
+    if (onnx.enabled) {
+        const size_t dot = param_path.rfind('.');
+        const std::string onnx_path = param_path.substr(0, dot) + ".onnx";
+        std::string error;
+        backend_ = LoadOnnxModel(onnx_path, onnx, error);
+        if (backend_ && !backend_->hasOutput("fc1")) {
+            error = onnx_path + " has no fc1 output";
+            backend_.reset();
+        }
+        if (!backend_) fprintf(stderr, "Warning: %s; ReID runs on ncnn\n", error.c_str());
+    }
 
-    if (net_.load_param(param_path.c_str()) != 0) return false;
-    if (net_.load_model(bin_path.c_str()) != 0) return false;
+    // Warm-up on a grey crop: lazy setup and the allocation pools are paid
+    // here instead of on the first face. Its output also tells the
+    // embedding size, so models of any dimension load without a rebuild.
+    ncnn::Mat crop(input_w_, input_h_, 3);
+    crop.fill(127.0f);
+    std::vector<ncnn::Mat> outputs;
+    if (backend_) backend_->run(crop, {"fc1"}, outputs);
+    {
+        ncnn::Extractor ex = net_.create_extractor();
+        ex.set_light_mode(true);
+        ex.set_blob_allocator(&blob_pool_);
+        ex.set_workspace_allocator(&workspace_pool_);
+        ncnn::Mat feat;
+        if (ex.input("data", crop) == 0 && ex.extract("fc1", feat) == 0) {
+            dim_ = static_cast<int>(feat.total());
+        }
+    }
+    if (dim_ <= 0) {
+        fprintf(stderr, "Warning: %s has no usable fc1 output\n", param_path.c_str());
+        return false;
+    }
 
     loaded_ = true;
     return true;
 }
 
-std::array<float, MobileFaceNetReid::kDim> MobileFaceNetReid::Extract(const unsigned char* rgb,
-                                                                      int width,
-                                                                      int height,
-                                                                      const BBox& face_bbox_abs,
-                                                                      const std::array<std::array<float, 2>, 5>* landmarks_abs,
-                                                                      bool& ok,
-                                                                      float* quality_out) const {
-    ok = false;
-    std::array<float, kDim> out_feat{};
-    if (!loaded_ || !rgb || width <= 0 || height <= 0) return out_feat;
-    // Default: unknown quality unless requested.
-    float quality = 0.0f;
-
+bool MobileFaceNetReid::CropTransform(int width,
+                                      int height,
+                                      const BBox& face_bbox_abs,
+                                      const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                                      float m[6]) const {
     // ArcFace 112x112 canonical 5-point template.
     const std::array<std::array<float, 2>, 5> kDst = {{
         {38.2946f, 51.6963f},
@@ -282,9 +250,6 @@ std::array<float, MobileFaceNetReid::kDim> MobileFaceNetReid::Extract(const unsi
         {70.7299f, 92.2041f},
     }};
 
-    ncnn::Mat in;
-    std::vector<unsigned char> aligned_rgb;
-
     const float x1 = face_bbox_abs.x1;
     const float y1 = face_bbox_abs.y1;
     const float x2 = face_bbox_abs.x2;
@@ -315,22 +280,14 @@ std::array<float, MobileFaceNetReid::kDim> MobileFaceNetReid::Extract(const unsi
                 Similarity2x3 invM;
                 InvertSimilarity(M, invM);  // maps dst -> src
 
-                aligned_rgb.resize(static_cast<size_t>(input_w_) * static_cast<size_t>(input_h_) * 3u);
-                for (int v = 0; v < input_h_; ++v) {
-                    for (int u = 0; u < input_w_; ++u) {
-                        // src = invA * [u,v] + invt (packed into invM)
-                        const float x = invM.a * static_cast<float>(u) - invM.b * static_cast<float>(v) + invM.tx;
-                        const float y = invM.b * static_cast<float>(u) + invM.a * static_cast<float>(v) + invM.ty;
-                        unsigned char px[3];
-                        SampleBilinearRGB(rgb, width, height, x, y, px);
-                        const size_t idx = (static_cast<size_t>(v) * static_cast<size_t>(input_w_) + static_cast<size_t>(u)) * 3u;
-                        aligned_rgb[idx + 0] = px[0];
-                        aligned_rgb[idx + 1] = px[1];
-                        aligned_rgb[idx + 2] = px[2];
-                    }
-                }
+                // src = invA * [u,v] + invt (packed into invM)
+                m[0] = invM.a;
+                m[1] = -invM.b;
+                m[2] = invM.tx;
+                m[3] = invM.b;
+                m[4] = invM.a;
+                m[5] = invM.ty;
                 used_alignment = true;
-                quality = ComputeQuality112(aligned_rgb, bw, bh, width, height);
             }
         }
     }
@@ -352,62 +309,234 @@ std::array<float, MobileFaceNetReid::kDim> MobileFaceNetReid::Extract(const unsi
         roiw = clampi(roiw, 1, width - roix);
         roih = clampi(roih, 1, height - roiy);
 
-        aligned_rgb.resize(static_cast<size_t>(input_w_) * static_cast<size_t>(input_h_) * 3u);
-        for (int v = 0; v < input_h_; ++v) {
-            for (int u = 0; u < input_w_; ++u) {
-                const float fx = (input_w_ > 1) ? (static_cast<float>(u) / static_cast<float>(input_w_ - 1)) : 0.0f;
-                const float fy = (input_h_ > 1) ? (static_cast<float>(v) / static_cast<float>(input_h_ - 1)) : 0.0f;
-                const float x = static_cast<float>(roix) + fx * static_cast<float>(std::max(1, roiw - 1));
-                const float y = static_cast<float>(roiy) + fy * static_cast<float>(std::max(1, roih - 1));
-                unsigned char px[3];
-                SampleBilinearRGB(rgb, width, height, x, y, px);
-                const size_t idx = (static_cast<size_t>(v) * static_cast<size_t>(input_w_) + static_cast<size_t>(u)) * 3u;
-                aligned_rgb[idx + 0] = px[0];
-                aligned_rgb[idx + 1] = px[1];
-                aligned_rgb[idx + 2] = px[2];
-            }
+        // Stretch the ROI corners onto the crop corners.
+        const float sx = input_w_ > 1 ? static_cast<float>(std::max(1, roiw - 1)) / static_cast<float>(input_w_ - 1) : 0.0f;
+        const float sy = input_h_ > 1 ? static_cast<float>(std::max(1, roih - 1)) / static_cast<float>(input_h_ - 1) : 0.0f;
+        m[0] = sx;
+        m[1] = 0.0f;
+        m[2] = static_cast<float>(roix);
+        m[3] = 0.0f;
+        m[4] = sy;
+        m[5] = static_cast<float>(roiy);
+    }
+    return used_alignment;
+}
+
+bool MobileFaceNetReid::MakeCrop(const unsigned char* rgb,
+                                 int width,
+                                 int height,
+                                 const BBox& face_bbox_abs,
+                                 const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                                 std::vector<unsigned char>& crop) const {
+    float m[6];
+    const bool used_alignment = CropTransform(width, height, face_bbox_abs, landmarks_abs, m);
+    crop.resize(static_cast<size_t>(input_w_) * static_cast<size_t>(input_h_) * 3u);
+    WarpAffineBilinearRgb(rgb, width, height, m, crop.data(), input_w_, input_h_);
+    return used_alignment;
+}
+
+bool MobileFaceNetReid::PassesGate(const BBox& face_bbox_abs,
+                                   const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                                   float score) const {
+    const float side = std::min(face_bbox_abs.x2 - face_bbox_abs.x1, face_bbox_abs.y2 - face_bbox_abs.y1);
+    if (gate_.min_face_px > 0.0f && !(side >= gate_.min_face_px)) return false;
+    if (gate_.min_score > 0.0f && score >= 0.0f && score < gate_.min_score) return false;
+    if (gate_.min_eye_px > 0.0f && landmarks_abs) {
+        const float ex = (*landmarks_abs)[1][0] - (*landmarks_abs)[0][0];
+        const float ey = (*landmarks_abs)[1][1] - (*landmarks_abs)[0][1];
+        if (!(std::sqrt(ex * ex + ey * ey) >= gate_.min_eye_px)) return false;
+    }
+    return true;
+}
+
+bool MobileFaceNetReid::ReadFullResPatch(const ReidFullRes& full_res,
+                                         int width,
+                                         int height,
+                                         const BBox& face_bbox_abs,
+                                         const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                                         float m[6],
+                                         bool& used_alignment,
+                                         std::vector<unsigned char>& patch,
+                                         int& patch_w,
+                                         int& patch_h) const {
+    if (!full_res.read || !*full_res.read || full_res.width <= width || full_res.height <= height) return false;
+    // Reduced pixels per crop pixel: at one or more the reduced frame has
+    // all the detail the crop can hold.
+    if (std::fabs(m[0] * m[4] - m[1] * m[3]) >= 1.0f) return false;
+
+    const float sx = static_cast<float>(full_res.width) / static_cast<float>(width);
+    const float sy = static_cast<float>(full_res.height) / static_cast<float>(height);
+    const BBox box{face_bbox_abs.x1 * sx, face_bbox_abs.y1 * sy, face_bbox_abs.x2 * sx, face_bbox_abs.y2 * sy};
+    std::array<std::array<float, 2>, 5> landmarks{};
+    if (landmarks_abs) {
+        for (int i = 0; i < 5; ++i) {
+            landmarks[i] = {(*landmarks_abs)[i][0] * sx, (*landmarks_abs)[i][1] * sy};
+        }
+    }
+    float fm[6];
+    const bool aligned = CropTransform(full_res.width, full_res.height, box, landmarks_abs ? &landmarks : nullptr, fm);
+
+    // The crop's corners bound what it samples; one more pixel each side
+    // keeps the bilinear neighbours inside the patch.
+    float min_x = fm[2], max_x = fm[2], min_y = fm[5], max_y = fm[5];
+    for (int v = 0; v < 2; ++v) {
+        for (int u = 0; u < 2; ++u) {
+            const float cu = static_cast<float>(u * (input_w_ - 1));
+            const float cv = static_cast<float>(v * (input_h_ - 1));
+            const float x = fm[0] * cu + fm[1] * cv + fm[2];
+            const float y = fm[3] * cu + fm[4] * cv + fm[5];
+            min_x = std::min(min_x, x);
+            max_x = std::max(max_x, x);
+            min_y = std::min(min_y, y);
+            max_y = std::max(max_y, y);
         }
-        quality = 0.75f * ComputeQuality112(aligned_rgb, bw, bh, width, height);  // less trust without alignment
     }
+    if (!(std::isfinite(min_x) && std::isfinite(max_x) && std::isfinite(min_y) && std::isfinite(max_y))) return false;
+    const int x0 = static_cast<int>(clampf(std::floor(min_x) - 1.0f, 0.0f, static_cast<float>(full_res.width)));
+    const int y0 = static_cast<int>(clampf(std::floor(min_y) - 1.0f, 0.0f, static_cast<float>(full_res.height)));
+    const int x1 = static_cast<int>(clampf(std::ceil(max_x) + 2.0f, 0.0f, static_cast<float>(full_res.width)));
+    const int y1 = static_cast<int>(clampf(std::ceil(max_y) + 2.0f, 0.0f, static_cast<float>(full_res.height)));
+    if (x1 - x0 < 2 || y1 - y0 < 2) return false;
+    if (!(*full_res.read)(x0, y0, x1 - x0, y1 - y0, patch)) return false;
+
+    fm[2] -= static_cast<float>(x0);
+    fm[5] -= static_cast<float>(y0);
+    std::copy(fm, fm + 6, m);
+    used_alignment = aligned;
+    patch_w = x1 - x0;
+    patch_h = y1 - y0;
+    return true;
+}
 
-    const float blur_var = ComputeLaplacianVariance112(aligned_rgb);
-    const float kBlurSharpenVar = GetEnvFloat("FACE_PIPELINE_REID_BLUR_SHARPEN_VAR", 50.0f);
-    const float kBlurSkipVar = GetEnvFloat("FACE_PIPELINE_REID_BLUR_SKIP_VAR", 12.0f);
-    const float kSharpenAlpha = GetEnvFloat("FACE_PIPELINE_REID_LAPLACIAN_ALPHA", 0.6f);
+bool MobileFaceNetReid::PrepareCrop(const unsigned char* rgb,
+                                    int width,
+                                    int height,
+                                    const BBox& face_bbox_abs,
+                                    const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                                    const ReidFullRes* full_res,
+                                    unsigned char* crop_out,
+                                    float& quality) const {
+    const float kBlurSharpenVar = config_.blur_sharpen_var;
+    const float kBlurSkipVar = config_.blur_skip_var;
+    const float kSharpenAlpha = config_.sharpen_alpha;
+
+    float m[6];
+    bool used_alignment = CropTransform(width, height, face_bbox_abs, landmarks_abs, m);
+    // Small faces of a reduced frame are warped from full-resolution pixels.
+    std::vector<unsigned char> patch;
+    int src_w = width;
+    int src_h = height;
+    if (full_res &&
+        ReadFullResPatch(*full_res, width, height, face_bbox_abs, landmarks_abs, m, used_alignment, patch, src_w, src_h)) {
+        rgb = patch.data();
+    }
+    if (gate_.blur_precheck) {
+        // Same crop at half resolution, each pixel centred on a 2x2 block.
+        // Halving the scale raises the Laplacian variance of smooth
+        // content, so a crop already below the skip threshold here is
+        // below it at full size too.
+        constexpr int kHalf = kCropSide / 2;
+        const float mh[6] = {2.0f * m[0], 2.0f * m[1], m[2] + 0.5f * (m[0] + m[1]),
+                             2.0f * m[3], 2.0f * m[4], m[5] + 0.5f * (m[3] + m[4])};
+        std::vector<unsigned char> small(static_cast<size_t>(kHalf * kHalf) * 3u);
+        std::vector<float> small_luma(static_cast<size_t>(kHalf * kHalf));
+        WarpAffineBilinearRgb(rgb, src_w, src_h, mh, small.data(), kHalf, kHalf);
+        RgbToLumaF32(small.data(), kHalf * kHalf, small_luma.data());
+        const LumaPlaneStats small_stats = ComputeLumaPlaneStats(small_luma.data(), kHalf, kHalf);
+        if (ComputeLaplacianVariance(small_stats, kHalf) < kBlurSkipVar) {
+            quality = 0.0f;
+            return false;
+        }
+    }
 
+    std::vector<unsigned char> aligned_rgb(static_cast<size_t>(input_w_) * static_cast<size_t>(input_h_) * 3u);
+    WarpAffineBilinearRgb(rgb, src_w, src_h, m, aligned_rgb.data(), input_w_, input_h_);
+    const float bw = std::max(1.0f, face_bbox_abs.x2 - face_bbox_abs.x1);
+    const float bh = std::max(1.0f, face_bbox_abs.y2 - face_bbox_abs.y1);
+    std::vector<float> luma;
+    ComputeLuma112(aligned_rgb, luma);
+    const LumaPlaneStats stats = ComputeCropStats112(luma);
+    quality = ComputeQuality112(stats, bw, bh, width, height);
+    if (!used_alignment) quality *= 0.75f;  // less trust without alignment
+
+    const float blur_var = ComputeLaplacianVariance(stats, kCropSide);
     if (blur_var < kBlurSkipVar) {
-        if (quality_out) {
-            *quality_out = 0.0f;
-        }
-        return out_feat;
+        quality = 0.0f;
+        return false;
     }
 
     const bool apply_sharpen = blur_var < kBlurSharpenVar;
     std::vector<unsigned char> sharpened_rgb;
-    const unsigned char* input_rgb = aligned_rgb.data();
+    const std::vector<unsigned char>* input_rgb = &aligned_rgb;
     if (apply_sharpen) {
-        ApplyLaplacianSharpen112(aligned_rgb, sharpened_rgb, kSharpenAlpha);
-        input_rgb = sharpened_rgb.data();
+        ApplyLaplacianSharpen112(aligned_rgb, luma, sharpened_rgb, kSharpenAlpha);
+        input_rgb = &sharpened_rgb;
         const float denom = std::max(1e-3f, kBlurSharpenVar - kBlurSkipVar);
         const float blur_factor = clampf((blur_var - kBlurSkipVar) / denom, 0.0f, 1.0f);
         quality *= blur_factor;
     }
+    std::memcpy(crop_out, input_rgb->data(), input_rgb->size());
+    return true;
+}
 
-    in = ncnn::Mat::from_pixels(input_rgb, ncnn::Mat::PIXEL_RGB, input_w_, input_h_);
-
-    ncnn::Extractor ex = net_.create_extractor();
-    ex.set_light_mode(true);
+int MobileFaceNetReid::BatchWorkers() const {
+    const int set = batch_workers_.load();
+    return set > 0 ? set : std::max(1, PipelineCoreCount() / std::max(1, net_.opt.num_threads));
+}
 
-    if (ex.input("data", in) != 0) return out_feat;
+bool MobileFaceNetReid::Embed(const unsigned char* crop, EmbeddingF32& feature) const {
+    ncnn::Mat in = ncnn::Mat::from_pixels(crop, ncnn::Mat::PIXEL_RGB, input_w_, input_h_);
 
     ncnn::Mat feat;
-    if (ex.extract("fc1", feat) != 0) return out_feat;
-    if (feat.total() != kDim) return out_feat;
+    std::vector<ncnn::Mat> outputs;
+    if (backend_ && backend_->run(in, {"fc1"}, outputs)) {
+        feat = outputs[0];
+    } else {
+        ncnn::Extractor ex = net_.create_extractor();
+        ex.set_light_mode(true);
+        ex.set_blob_allocator(&blob_pool_);
+        ex.set_workspace_allocator(&workspace_pool_);
+
+        if (ex.input("data", in) != 0) return false;
+        if (ex.extract("fc1", feat) != 0) return false;
+    }
+    if (static_cast<int>(feat.total()) != dim_) return false;
+
+    feature.resize(static_cast<size_t>(dim_));
+    for (int i = 0; i < dim_; ++i) {
+        feature[i] = feat[i];
+    }
+    L2Normalize(feature);
+    return true;
+}
+
+EmbeddingF32 MobileFaceNetReid::Extract(const unsigned char* rgb,
+                                        int width,
+                                        int height,
+                                        const BBox& face_bbox_abs,
+                                        const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                                        bool& ok,
+                                        float* quality_out,
+                                        const ReidFullRes* full_res) const {
+    FACE_PIPELINE_ZONE("MobileFaceNetReid::Extract");
+    ok = false;
+    EmbeddingF32 out_feat;
+    if (!loaded_ || !rgb || width <= 0 || height <= 0) return out_feat;
 
-    for (int i = 0; i < kDim; ++i) {
-        out_feat[i] = feat[i];
+    std::vector<unsigned char> crop(static_cast<size_t>(input_w_) * static_cast<size_t>(input_h_) * 3u);
+    float quality = 0.0f;
+    if (!PassesGate(face_bbox_abs, landmarks_abs, -1.0f) ||
+        !PrepareCrop(rgb, width, height, face_bbox_abs, landmarks_abs, full_res, crop.data(), quality)) {
+        if (quality_out) {
+            *quality_out = 0.0f;
+        }
+        return out_feat;
+    }
+    if (!Embed(crop.data(), out_feat)) {
+        out_feat.clear();
+        return out_feat;
     }
-    l2_normalize(out_feat);
+
     ok = true;
     if (quality_out) {
         *quality_out = clampf(quality, 0.0f, 1.0f);
@@ -415,3 +544,59 @@ std::array<float, MobileFaceNetReid::kDim> MobileFaceNetReid::Extract(const unsi
     return out_feat;
 }
 
+std::vector<MobileFaceNetReid::Embedding> MobileFaceNetReid::ExtractBatch(
+    const unsigned char* rgb,
+    int width,
+    int height,
+    const std::vector<BBox>& boxes,
+    const std::vector<std::array<std::array<float, 2>, 5>>* landmarks,
+    const std::vector<float>* scores,
+    const ReidFullRes* full_res) const {
+    FACE_PIPELINE_ZONE("MobileFaceNetReid::ExtractBatch");
+    std::vector<Embedding> out(boxes.size());
+    if (!loaded_ || !rgb || width <= 0 || height <= 0 || boxes.empty()) return out;
+    if (landmarks && landmarks->size() != boxes.size()) landmarks = nullptr;
+    if (scores && scores->size() != boxes.size()) scores = nullptr;
+
+    std::vector<size_t> gated;
+    gated.reserve(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (PassesGate(boxes[i], landmarks ? &(*landmarks)[i] : nullptr, scores ? (*scores)[i] : -1.0f)) {
+            gated.push_back(i);
+        }
+    }
+    if (gate_.max_per_frame > 0 && static_cast<int>(gated.size()) > gate_.max_per_frame) {
+        // Over budget: the largest faces carry the most identity.
+        std::stable_sort(gated.begin(), gated.end(), [&](size_t a, size_t b) {
+            return boxes[a].area() > boxes[b].area();
+        });
+        gated.resize(static_cast<size_t>(gate_.max_per_frame));
+        std::sort(gated.begin(), gated.end());
+    }
+
+    // All network inputs side by side; a face too blurry to embed keeps its
+    // slot but is left out of the forward passes.
+    const size_t crop_bytes = static_cast<size_t>(input_w_) * static_cast<size_t>(input_h_) * 3u;
+    std::vector<unsigned char> crops(crop_bytes * boxes.size());
+    std::vector<float> quality(boxes.size(), 0.0f);
+    std::vector<size_t> todo;
+    todo.reserve(gated.size());
+    for (size_t i : gated) {
+        const auto* lm = landmarks ? &(*landmarks)[i] : nullptr;
+        if (PrepareCrop(rgb, width, height, boxes[i], lm, full_res, crops.data() + i * crop_bytes, quality[i])) {
+            todo.push_back(i);
+        }
+    }
+    if (todo.empty()) return out;
+
+    // One face per extractor at a time; each pass keeps the net's thread
+    // count, so the cores left over take further faces concurrently.
+    ThreadPool::Shared().parallelFor(static_cast<int>(todo.size()), BatchWorkers(), [&](int k) {
+        const size_t i = todo[static_cast<size_t>(k)];
+        Embedding& e = out[i];
+        e.ok = Embed(crops.data() + i * crop_bytes, e.feature);
+        if (e.ok) e.quality = clampf(quality[i], 0.0f, 1.0f);
+    });
+    return out;
+}
+
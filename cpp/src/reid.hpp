@@ -2,16 +2,74 @@
 
 #include "kalman_filter.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "frame_cache.hpp"
+#include "huge_pages.hpp"
+#include "inference_backend.hpp"
 #include "net.h"
 
+/**
+ * Cheap checks that turn a face away before any pixel work (all off by
+ * default). A rejected face gets no embedding and quality 0, like one too
+ * blurry to embed.
+ */
+struct ReidGateOptions {
+    float min_face_px = 0.0f;    // shorter bbox side below this
+    float min_score = 0.0f;      // detector score below this (ExtractBatch with scores)
+    float min_eye_px = 0.0f;     // landmark eye distance below this
+    bool blur_precheck = false;  // blur test on a half-resolution crop before the full warp
+    int max_per_frame = 0;       // ExtractBatch embeds at most this many faces, largest first (0 = all)
+};
+
+/**
+ * ReID tunables of one job: the crop blur handling, the quality a sample
+ * needs to enter a track's appearance bank, and the offline (Phase 3)
+ * tracklet linking limits. Resolved once, outside the per-face path.
+ */
+struct ReidConfig {
+    float blur_sharpen_var = 50.0f;  // crops with Laplacian variance below this are sharpened first
+    float blur_skip_var = 12.0f;     // ... and below this are not embedded at all
+    float sharpen_alpha = 0.6f;      // Laplacian sharpening strength
+    float min_update_quality = 0.40f;  // samples below this never enter a track's appearance bank
+    float link_short_gap_s = 2.0f;     // linking: gaps up to this use the plain cosine threshold
+    float link_long_gap_s = 10.0f;     // linking: longest gap bridged at all
+    float link_max_center_dist = 2.0f;  // linking: end -> start center distance, in max box diagonals
+    float link_max_area_ratio = 4.0f;   // linking: larger / smaller box area
+    int link_long_min_frames = 6;       // long gaps: confident frames both tracklets need
+    float link_long_min_sim = 0.50f;    // long gaps: cosine similarity floor
+    EmbeddingStorage appearance_storage = EmbeddingStorage::F32;  // track appearances kept for linking
+};
+
+/**
+ * The full-resolution frame behind reduced RGB handed to ReID
+ * (LoadedRgbFrame::read_full_res). A face the reduced frame holds fewer
+ * pixels of than the crop is warped from a full-resolution patch read
+ * just around it instead.
+ */
+struct ReidFullRes {
+    int width = 0;   // full-resolution frame size
+    int height = 0;
+    const RgbRegionReader* read = nullptr;
+};
+
+/**
+ * ReidConfig defaults with the FACE_PIPELINE_REID_BLUR_SHARPEN_VAR,
+ * FACE_PIPELINE_REID_BLUR_SKIP_VAR and FACE_PIPELINE_REID_LAPLACIAN_ALPHA
+ * overrides applied.
+ */
+ReidConfig ReidConfigFromEnv();
+
 /**
  * MobileFaceNet (ArcFace) embedding extractor.
  *
  * - Input: RGB face crop (expected ~112x112)
- * - Output: L2-normalized embedding vector (kDim)
+ * - Output: L2-normalized embedding vector (Dim(), read from the model)
  *
  * Notes:
  * - This project currently uses the MXNet-converted model where input blob is
@@ -20,13 +78,47 @@
  */
 class MobileFaceNetReid {
 public:
-    static constexpr int kDim = 128;
+    /** One face of ExtractBatch(). */
+    struct Embedding {
+        EmbeddingF32 feature;  // empty when !ok
+        float quality = 0.0f;  // as Extract()'s quality_out; 0 when !ok
+        bool ok = false;
+    };
 
     MobileFaceNetReid() = default;
-    MobileFaceNetReid(const std::string& param_path, const std::string& bin_path);
+    MobileFaceNetReid(const std::string& param_path, const std::string& bin_path,
+                      const GpuOptions& gpu = GpuOptions{},
+                      const OnnxRuntimeOptions& onnx = OnnxRuntimeOptions{});
 
-    bool Load(const std::string& param_path, const std::string& bin_path);
+    /**
+     * Load the ncnn model, plus `<stem>.onnx` on ONNX Runtime when `onnx` is
+     * enabled (ncnn stays the fallback).
+     */
+    bool Load(const std::string& param_path, const std::string& bin_path,
+              const GpuOptions& gpu = GpuOptions{},
+              const OnnxRuntimeOptions& onnx = OnnxRuntimeOptions{});
     bool IsLoaded() const { return loaded_; }
+    /** Embedding length of the loaded model (0 until loaded). */
+    int Dim() const { return dim_; }
+    bool UsesGpu() const { return on_gpu_; }
+
+    /** ncnn threads of each forward pass from now on (Load() picks min(4, PipelineCoreCount())). */
+    void SetNumThreads(int n) { net_.opt.num_threads = std::max(1, n); }
+    int NumThreads() const { return net_.opt.num_threads; }
+
+    /**
+     * Faces ExtractBatch() embeds concurrently from now on (0 = the cores
+     * left by each pass's threads); safe while a batch runs elsewhere.
+     */
+    void SetBatchWorkers(int n) { batch_workers_.store(std::max(0, n)); }
+    int BatchWorkers() const;
+
+    void SetGate(const ReidGateOptions& gate) { gate_ = gate; }
+    const ReidGateOptions& Gate() const { return gate_; }
+
+    /** Crop blur handling (the blur_* and sharpen_alpha fields) for later calls. */
+    void SetConfig(const ReidConfig& config) { config_ = config; }
+    const ReidConfig& Config() const { return config_; }
 
     /**
      * Extract an embedding for a face region, optionally using 5-point landmark alignment.
@@ -38,19 +130,118 @@ public:
      * @param landmarks_abs Optional SCRFD 5-point landmarks in absolute pixels (x,y)
      * @param ok Output: true if embedding was produced
      * @param quality_out Optional output: lightweight quality score in [0,1]
+     * @param full_res Optional full-resolution frame when `rgb` is reduced
+     */
+    EmbeddingF32 Extract(const unsigned char* rgb,
+                         int width,
+                         int height,
+                         const BBox& face_bbox_abs,
+                         const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                         bool& ok,
+                         float* quality_out = nullptr,
+                         const ReidFullRes* full_res = nullptr) const;
+
+    /**
+     * Extract() for every face of a frame. The crops are built into one
+     * contiguous buffer first, then the forward passes run in parallel on
+     * separate extractors (MobileFaceNet has no batch dimension in ncnn)
+     * on the cores a single pass leaves idle.
+     *
+     * The gate (SetGate) runs first: faces it turns away, and those beyond
+     * its per-frame budget, are never cropped.
+     *
+     * @param landmarks Optional, one entry per box
+     * @param scores Optional detector scores, one per box (for min_score)
+     * @param full_res Optional full-resolution frame when `rgb` is reduced
+     * @return One entry per box, in order
      */
-    std::array<float, kDim> Extract(const unsigned char* rgb,
-                                    int width,
-                                    int height,
-                                    const BBox& face_bbox_abs,
-                                    const std::array<std::array<float, 2>, 5>* landmarks_abs,
-                                    bool& ok,
-                                    float* quality_out = nullptr) const;
+    std::vector<Embedding> ExtractBatch(const unsigned char* rgb,
+                                        int width,
+                                        int height,
+                                        const std::vector<BBox>& boxes,
+                                        const std::vector<std::array<std::array<float, 2>, 5>>* landmarks,
+                                        const std::vector<float>* scores = nullptr,
+                                        const ReidFullRes* full_res = nullptr) const;
+
+    /**
+     * Build the network input crop for a face: 5-point aligned to the ArcFace
+     * template when the landmarks are usable, else a padded square around the
+     * bbox. Extract() embeds this crop (sharpened first when it is blurry).
+     *
+     * @param crop Output: input_w x input_h interleaved RGB
+     * @return true if the crop is landmark-aligned
+     */
+    bool MakeCrop(const unsigned char* rgb,
+                  int width,
+                  int height,
+                  const BBox& face_bbox_abs,
+                  const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                  std::vector<unsigned char>& crop) const;
 
 private:
+    /**
+     * Source coordinates of the crop: pixel (u, v) samples
+     * x = m[0] u + m[1] v + m[2], y = m[3] u + m[4] v + m[5].
+     * @return true if landmark-aligned
+     */
+    bool CropTransform(int width,
+                       int height,
+                       const BBox& face_bbox_abs,
+                       const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                       float m[6]) const;
+
+    /** Geometry/score part of the gate; `score` < 0 skips the score test. */
+    bool PassesGate(const BBox& face_bbox_abs,
+                    const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                    float score) const;
+
+    /**
+     * Crop, quality and blur gate of one face: writes the network input
+     * (sharpened when blurry) to `crop_out` (input_w x input_h RGB).
+     * @return false if the face is too blurry to embed (quality 0)
+     */
+    bool PrepareCrop(const unsigned char* rgb,
+                     int width,
+                     int height,
+                     const BBox& face_bbox_abs,
+                     const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                     const ReidFullRes* full_res,
+                     unsigned char* crop_out,
+                     float& quality) const;
+
+    /**
+     * If the crop transform `m` of a `width x height` frame samples it more
+     * sparsely than one pixel per crop pixel, read the full-resolution patch
+     * the crop covers into `patch`, and rewrite `m` (with `used_alignment`)
+     * against it and `patch_w x patch_h`.
+     * @return false to warp from the reduced frame as it is
+     */
+    bool ReadFullResPatch(const ReidFullRes& full_res,
+                          int width,
+                          int height,
+                          const BBox& face_bbox_abs,
+                          const std::array<std::array<float, 2>, 5>* landmarks_abs,
+                          float m[6],
+                          bool& used_alignment,
+                          std::vector<unsigned char>& patch,
+                          int& patch_w,
+                          int& patch_h) const;
+
+    /** Forward pass + L2 normalization of a PrepareCrop() output. */
+    bool Embed(const unsigned char* crop, EmbeddingF32& feature) const;
+
+    // Pooled for the model's lifetime (see ScrfdDetector); declared before net_.
+    mutable HugePagePoolAllocator blob_pool_;
+    mutable HugePagePoolAllocator workspace_pool_;
     ncnn::Net net_;
+    std::unique_ptr<NetBackend> backend_;
+    ReidGateOptions gate_;
+    ReidConfig config_;
     bool loaded_ = false;
+    bool on_gpu_ = false;
     int input_w_ = 112;
     int input_h_ = 112;
+    int dim_ = 0;
+    std::atomic<int> batch_workers_{0};
 };
 
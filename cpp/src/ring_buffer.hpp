@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Fixed-capacity FIFO that overwrites its oldest entry when full.
+ *
+ * Storage is allocated once, at construction, so pushing never
+ * allocates; slots are reused by assignment, which lets element types
+ * that own buffers (e.g. a Detection's embedding) keep their capacity.
+ * Index 0 is the oldest entry, size() - 1 the newest.
+ */
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 1) : slots_(std::max<size_t>(1, capacity)) {}
+
+    size_t capacity() const { return slots_.size(); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    void push(const T& value) {
+        if (size_ < slots_.size()) {
+            slots_[(head_ + size_) % slots_.size()] = value;
+            size_++;
+        } else {
+            slots_[head_] = value;
+            head_ = (head_ + 1) % slots_.size();
+        }
+    }
+
+    T& operator[](size_t i) { return slots_[(head_ + i) % slots_.size()]; }
+    const T& operator[](size_t i) const { return slots_[(head_ + i) % slots_.size()]; }
+
+    T& back() { return (*this)[size_ - 1]; }
+    const T& back() const { return (*this)[size_ - 1]; }
+
+private:
+    std::vector<T> slots_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
@@ -0,0 +1,40 @@
+#include "sample_grid.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+SampleGrid::SampleGrid(int stride, int tolerance, const std::vector<int>& keyframes) : stride_(std::max(1, stride)) {
+    if (tolerance <= 0 || keyframes.empty()) return;
+    // Nearest keyframes are non-decreasing in the stride position, and a
+    // sample that stays put lies more than `tolerance` from any keyframe,
+    // so the snapped samples ascend; equal ones merge.
+    std::vector<int> samples;
+    const int64_t last = static_cast<int64_t>(keyframes.back()) + tolerance;
+    int64_t nominal = 0;
+    for (; nominal <= last; nominal += stride_) {
+        const int n = static_cast<int>(nominal);
+        auto it = std::lower_bound(keyframes.begin(), keyframes.end(), n);
+        int best = -1;
+        if (it != keyframes.end() && *it - n <= tolerance) best = *it;
+        if (it != keyframes.begin() && n - *(it - 1) <= tolerance && (best < 0 || n - *(it - 1) <= best - n)) {
+            best = *(it - 1);
+        }
+        const int sample = best >= 0 ? best : n;
+        if (sample != n) moved_++;
+        if (samples.empty() || sample > samples.back()) samples.push_back(sample);
+    }
+    if (moved_ == 0) return;
+    samples_ = std::move(samples);
+    tail_ = static_cast<int>(nominal);
+}
+
+int SampleGrid::ordinal(int index) const {
+    if (index < 0) return -1;
+    if (samples_.empty()) return index % stride_ == 0 ? index / stride_ : -1;
+    if (index > samples_.back()) {
+        if (index < tail_ || index % stride_ != 0) return -1;
+        return static_cast<int>(samples_.size()) + (index - tail_) / stride_;
+    }
+    auto it = std::lower_bound(samples_.begin(), samples_.end(), index);
+    return *it == index ? static_cast<int>(it - samples_.begin()) : -1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * Frames a fixed detection stride samples, optionally snapped to keyframes
+ * (--keyframe-snap).
+ *
+ * Without keyframes the samples are every `stride`th frame. With them, a
+ * sample within `tolerance` frames of a keyframe moves onto the nearest
+ * one: a video decoder reaches it from the frame before the gap without
+ * decoding the frames in between. Samples that snap onto the same
+ * keyframe become one, so a tolerance of half the GOP (or more) detects
+ * on keyframes only. Past the last keyframe there is only the stride.
+ */
+class SampleGrid {
+public:
+    /**
+     * @param keyframes Ascending frame indices (FrameSource::keyframes())
+     */
+    explicit SampleGrid(int stride, int tolerance = 0, const std::vector<int>& keyframes = {});
+
+    /** Frame `index` is a sample. */
+    bool contains(int index) const { return ordinal(index) >= 0; }
+
+    /** Position of sample `index` among the samples, or -1 if it is none. */
+    int ordinal(int index) const;
+
+    /** True if keyframes moved any sample. */
+    bool snapped() const { return !samples_.empty(); }
+
+    /** Stride positions whose sample moved to a keyframe. */
+    int snappedSamples() const { return moved_; }
+
+private:
+    int stride_;
+    std::vector<int> samples_;  // of the stride positions up to the last keyframe's reach (empty = none moved)
+    int tail_ = 0;              // first stride position past them
+    int moved_ = 0;
+};
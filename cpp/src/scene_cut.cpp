@@ -0,0 +1,81 @@
+#include "scene_cut.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <vector>
+
+#include "simd_kernels.hpp"
+
+namespace {
+constexpr int kBins = 32;
+constexpr int kStep = 2;  // sample every other pixel in both directions
+
+void Histogram(const uint8_t* plane, int w, int h, std::array<int, kBins>& hist) {
+    hist.fill(0);
+    for (int y = 0; y < h; y += kStep) {
+        const uint8_t* row = plane + static_cast<size_t>(y) * w;
+        for (int x = 0; x < w; x += kStep) hist[row[x] * kBins / 256]++;
+    }
+}
+}  // namespace
+
+SceneCutDetector::SceneCutDetector(SceneCutConfig cfg) : cfg_(cfg), since_cut_(cfg.min_shot_frames) {}
+
+bool SceneCutDetector::Update(const uint8_t* curr, const uint8_t* prev, int w, int h) {
+    since_cut_++;
+    if (!curr || !prev || w <= 0 || h <= 0) return false;
+
+    std::array<int, kBins> hc{};
+    std::array<int, kBins> hp{};
+    Histogram(curr, w, h, hc);
+    Histogram(prev, w, h, hp);
+    int64_t hist_l1 = 0;
+    int64_t samples = 0;
+    for (int b = 0; b < kBins; ++b) {
+        hist_l1 += std::abs(hc[b] - hp[b]);
+        samples += hc[b];
+    }
+    if (samples == 0) return false;
+    const float hist_dist = 0.5f * static_cast<float>(hist_l1) / static_cast<float>(samples);
+
+    int64_t sad = 0;
+    for (int y = 0; y < h; y += kStep) {
+        const uint8_t* rc = curr + static_cast<size_t>(y) * w;
+        const uint8_t* rp = prev + static_cast<size_t>(y) * w;
+        for (int x = 0; x < w; x += kStep) sad += std::abs(static_cast<int>(rc[x]) - static_cast<int>(rp[x]));
+    }
+    const float mean_sad = static_cast<float>(sad) / static_cast<float>(samples);
+
+    const float sad_gate = std::max(cfg_.sad_threshold, have_mean_ ? cfg_.sad_ratio * mean_sad_ : 0.0f);
+    const bool cut = hist_dist >= cfg_.hist_threshold && mean_sad >= sad_gate && since_cut_ >= cfg_.min_shot_frames;
+    if (cut) {
+        // The new shot has its own motion level.
+        have_mean_ = false;
+        since_cut_ = 0;
+        cuts_++;
+        return true;
+    }
+    mean_sad_ = have_mean_ ? 0.9f * mean_sad_ + 0.1f * mean_sad : mean_sad;
+    have_mean_ = true;
+    return false;
+}
+
+bool IsDuplicateFrame(const uint8_t* curr, const uint8_t* prev, int w, int h, float max_block_diff) {
+    if (!curr || !prev || w <= 0 || h <= 0) return false;
+    constexpr int kBlock = 16;
+    const int blocks = (w + kBlock - 1) / kBlock;
+    std::vector<uint32_t> sad(static_cast<size_t>(blocks));
+    for (int by = 0; by < h; by += kBlock) {
+        const int bh = std::min(kBlock, h - by);
+        std::fill(sad.begin(), sad.end(), 0u);
+        for (int y = by; y < by + bh; ++y) {
+            AccumulateBlockSad16(curr + static_cast<size_t>(y) * w, prev + static_cast<size_t>(y) * w, w, sad.data());
+        }
+        for (int b = 0; b < blocks; ++b) {
+            const int bw = std::min(kBlock, w - b * kBlock);
+            if (static_cast<float>(sad[static_cast<size_t>(b)]) > max_block_diff * static_cast<float>(bw * bh)) return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Scene cut detection thresholds (see SceneCutDetector).
+ */
+struct SceneCutConfig {
+    bool enabled = true;
+    float hist_threshold = 0.4f;  // luma histogram distance in [0,1] (half the L1 distance)
+    float sad_threshold = 30.0f;  // mean absolute luma difference, in levels
+    float sad_ratio = 3.0f;       // ... and this many times the recent average (fast motion is not a cut)
+    int min_shot_frames = 5;      // cuts closer than this to the previous one are ignored (flashes)
+};
+
+/**
+ * Hard cut detector on the reduced luma planes the decode stage makes for GMC.
+ *
+ * A frame starts a new shot when both its luma histogram and its pixels
+ * jump against the previous frame. The histogram alone misses nothing but
+ * fires on lighting changes; the pixel difference alone fires on fast pans.
+ * Requiring both, with the difference measured against its recent average,
+ * keeps camera motion from reading as a cut.
+ */
+class SceneCutDetector {
+public:
+    explicit SceneCutDetector(SceneCutConfig cfg = {});
+
+    /**
+     * Compare a frame with the one before it (planes of the same size).
+     *
+     * @return true if `curr` starts a new shot
+     */
+    bool Update(const uint8_t* curr, const uint8_t* prev, int plane_w, int plane_h);
+
+    int cuts() const { return cuts_; }
+
+    /** Everything Update() carries from frame to frame (for checkpoints). */
+    struct State {
+        float mean_sad = 0.0f;  // running average over frames within a shot
+        bool have_mean = false;
+        int since_cut = 0;
+        int cuts = 0;
+    };
+    State state() const { return State{mean_sad_, have_mean_, since_cut_, cuts_}; }
+    void restore(const State& s) {
+        mean_sad_ = s.mean_sad;
+        have_mean_ = s.have_mean;
+        since_cut_ = s.since_cut;
+        cuts_ = s.cuts;
+    }
+
+private:
+    SceneCutConfig cfg_;
+    float mean_sad_ = 0.0f;  // running average over frames within a shot
+    bool have_mean_ = false;
+    int since_cut_ = 0;
+    int cuts_ = 0;
+};
+
+/**
+ * True if two luma planes show the same picture up to encoding noise: the
+ * mean absolute difference of every 16x16 block is at most `max_block_diff`
+ * levels. Judging blocks rather than the whole plane keeps a small moving
+ * region (a talking face on a static set) from passing as a duplicate.
+ */
+bool IsDuplicateFrame(const uint8_t* curr, const uint8_t* prev, int plane_w, int plane_h,
+                      float max_block_diff);
@@ -1,55 +1,164 @@
 #include "scrfd.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "image_ops.hpp"
+#include "nms.hpp"
+#include "thread_pool.hpp"
+#include "tracy_zones.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 // Strides used by SCRFD
 static const int STRIDES[] = {8, 16, 32};
 static const int NUM_ANCHORS = 2;
+// Faces of at least this many input pixels are the next stride's: its
+// head is not run below a minimum face this large (the last one always is).
+static const int kStrideMaxFace[] = {64, 256};
+
+static const char* const kScoreNames[] = {"score_8", "score_16", "score_32"};
+static const char* const kBboxNames[] = {"bbox_8", "bbox_16", "bbox_32"};
+static const char* const kKpsNames[] = {"kps_8", "kps_16", "kps_32"};
+
+// Input normalization: (pixel - 127.5) / 127.5.
+static const float kMeanVals[3] = {127.5f, 127.5f, 127.5f};
+static const float kNormVals[3] = {1.0f / 127.5f, 1.0f / 127.5f, 1.0f / 127.5f};
+
+// ONNX-derived exports keep the heads flattened as [h * w * anchors, k];
+// the decoder reads ncnn's planar [anchors * k, h, w].
+static bool ToAnchorPlanes(const ncnn::Mat& m, int fm_w, int fm_h, int k, ncnn::Mat& out) {
+    if (m.dims == 3 && m.w == fm_w && m.h == fm_h && m.c == NUM_ANCHORS * k) {
+        out = m;
+        return true;
+    }
+    if (m.dims != 2 || m.w != k || m.h != fm_w * fm_h * NUM_ANCHORS) return false;
+    out.create(fm_w, fm_h, NUM_ANCHORS * k);
+    for (int cell = 0; cell < fm_w * fm_h; ++cell) {
+        for (int a = 0; a < NUM_ANCHORS; ++a) {
+            const float* row = m.row(cell * NUM_ANCHORS + a);
+            for (int j = 0; j < k; ++j) out.channel(a * k + j)[cell] = row[j];
+        }
+    }
+    return true;
+}
 
-// Helper: compute IoU between two boxes
-static float ComputeIoU(const std::array<float, 4>& a, const std::array<float, 4>& b) {
-    float x1 = std::max(a[0], b[0]);
-    float y1 = std::max(a[1], b[1]);
-    float x2 = std::min(a[2], b[2]);
-    float y2 = std::min(a[3], b[3]);
-
-    float inter_w = std::max(0.0f, x2 - x1);
-    float inter_h = std::max(0.0f, y2 - y1);
-    float inter_area = inter_w * inter_h;
-
-    float area_a = (a[2] - a[0]) * (a[3] - a[1]);
-    float area_b = (b[2] - b[0]) * (b[3] - b[1]);
-
-    return inter_area / (area_a + area_b - inter_area + 1e-6f);
+// Indices of the scores >= thresh, in increasing order. Almost every cell is
+// below the threshold, so whole vectors are rejected with one compare.
+static void CollectAboveThreshold(const float* score, int n, float thresh, std::vector<int>& out) {
+    out.clear();
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 t = _mm_set1_ps(thresh);
+    for (; i + 7 < n; i += 8) {
+        const int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(score + i), t)) |
+                         (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(score + i + 4), t)) << 4);
+        if (mask == 0) continue;
+        for (int k = 0; k < 8; ++k) {
+            if (mask & (1 << k)) out.push_back(i + k);
+        }
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t t = vdupq_n_f32(thresh);
+    for (; i + 3 < n; i += 4) {
+        const uint32x4_t ge = vcgeq_f32(vld1q_f32(score + i), t);
+        const uint32x2_t any = vorr_u32(vget_low_u32(ge), vget_high_u32(ge));
+        if ((vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) == 0) continue;
+        for (int k = 0; k < 4; ++k) {
+            if (score[i + k] >= thresh) out.push_back(i + k);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (score[i] >= thresh) out.push_back(i);
+    }
 }
 
-// Helper: NMS
-static std::vector<int> NMS(const std::vector<ScrfdFace>& faces, float threshold) {
-    std::vector<int> indices(faces.size());
-    for (size_t i = 0; i < faces.size(); ++i) indices[i] = static_cast<int>(i);
+// Tile rectangles (x, y, w, h) covering the frame: `tile`-sized squares
+// (clipped to the frame), spread evenly so neighbours share >= `overlap`.
+static std::vector<std::array<int, 4>> TileGrid(int width, int height, int tile, float overlap) {
+    overlap = std::max(0.0f, std::min(overlap, 0.9f));
+    const int step = std::max(1, static_cast<int>(tile * (1.0f - overlap)));
+    auto starts = [tile, step](int extent) {
+        std::vector<int> v;
+        if (extent <= tile) {
+            v.push_back(0);
+            return v;
+        }
+        const int n = (extent - tile + step - 1) / step + 1;
+        for (int k = 0; k < n; ++k) {
+            v.push_back(static_cast<int>(static_cast<int64_t>(k) * (extent - tile) / (n - 1)));
+        }
+        return v;
+    };
+    std::vector<std::array<int, 4>> tiles;
+    for (int y : starts(height)) {
+        for (int x : starts(width)) {
+            tiles.push_back({x, y, std::min(tile, width - x), std::min(tile, height - y)});
+        }
+    }
+    return tiles;
+}
 
-    // Sort by score descending
-    std::sort(indices.begin(), indices.end(), [&faces](int a, int b) {
-        return faces[a].score > faces[b].score;
-    });
+static bool IntersectsAny(const std::array<int, 4>& r, const std::vector<std::array<float, 4>>& boxes) {
+    for (const auto& b : boxes) {
+        if (b[0] < r[0] + r[2] && b[2] > r[0] && b[1] < r[1] + r[3] && b[3] > r[1]) return true;
+    }
+    return false;
+}
 
-    std::vector<int> keep;
-    std::vector<bool> suppressed(faces.size(), false);
+// A face cut by an edge of region `r` (x, y, w, h) that lies inside the frame.
+static bool ClippedByRegion(const ScrfdFace& f, const std::array<int, 4>& r, int width, int height) {
+    return (r[0] > 0 && f.bbox[0] <= r[0]) ||
+           (r[1] > 0 && f.bbox[1] <= r[1]) ||
+           (r[0] + r[2] < width && f.bbox[2] >= r[0] + r[2]) ||
+           (r[1] + r[3] < height && f.bbox[3] >= r[1] + r[3]);
+}
 
-    for (int idx : indices) {
-        if (suppressed[idx]) continue;
-        keep.push_back(idx);
+// A face decoded in network pixels, from the region (x0, y0, w, h) resized
+// by `scale` and placed at (left, top) of the input, in frame pixels; the
+// box is clamped to the region.
+static void ToRegion(ScrfdFace& f, float left, float top, float scale, int x0, int y0, int w, int h, bool landmarks) {
+    const float x1 = std::max(0.0f, std::min((f.bbox[0] - left) / scale, static_cast<float>(w)));
+    const float y1 = std::max(0.0f, std::min((f.bbox[1] - top) / scale, static_cast<float>(h)));
+    const float x2 = std::max(0.0f, std::min((f.bbox[2] - left) / scale, static_cast<float>(w)));
+    const float y2 = std::max(0.0f, std::min((f.bbox[3] - top) / scale, static_cast<float>(h)));
+    f.bbox = {x0 + x1, y0 + y1, x0 + x2, y0 + y2};
+    if (landmarks) {
+        for (auto& p : f.landmarks) p = {x0 + (p[0] - left) / scale, y0 + (p[1] - top) / scale};
+    }
+}
 
-        for (int other : indices) {
-            if (suppressed[other] || other == idx) continue;
-            if (ComputeIoU(faces[idx].bbox, faces[other].bbox) > threshold) {
-                suppressed[other] = true;
-            }
-        }
+// "<stem>.onnx", or for the default 2.5g model the ONNX export shipped in
+// its NuGet package layout under the model directory.
+static std::string FindScrfdOnnx(const std::string& stem) {
+    const std::string own = stem + ".onnx";
+    if (std::ifstream(own).good()) return own;
+    const size_t slash = stem.rfind('/');
+    const std::string dir = slash == std::string::npos ? std::string(".") : stem.substr(0, slash);
+    const std::string name = stem.substr(slash == std::string::npos ? 0 : slash + 1);
+    if (name == "scrfd" || name == "scrfd_2.5g_kps") {
+        const std::string packaged = dir + "/scrfd_2.5g_kps_640x640/contentFiles/any/any/onnx/scrfd_2.5g_kps_640x640.onnx";
+        if (std::ifstream(packaged).good()) return packaged;
     }
+    return own;
+}
 
-    return keep;
+// Concurrent tiles share the cores: with the extractor thread count pinned,
+// one tile per slice; otherwise ncnn already spreads one tile over all cores.
+static int ResolveTileWorkers(int requested, int num_threads) {
+    if (requested > 0) return requested;
+    if (num_threads <= 0) return 1;
+    return std::max(1, PipelineCoreCount() / num_threads);
 }
 
 ScrfdDetector::ScrfdDetector(const std::string& param_path,
@@ -57,139 +166,437 @@ ScrfdDetector::ScrfdDetector(const std::string& param_path,
                              int input_width,
                              int input_height,
                              float conf_thresh,
-                             float nms_thresh)
+                             float nms_thresh,
+                             const DetectorOptions& options)
     : input_width_(input_width),
       input_height_(input_height),
       conf_thresh_(conf_thresh),
       nms_thresh_(nms_thresh),
+      options_(options),
       loaded_(false) {
-    
-    int ret = net_.load_param(param_path.c_str());
-    if (ret != 0) return;
 
-    ret = net_.load_model(bin_path.c_str());
-    if (ret != 0) return;
+    // Options must be set before loading: layers pick kernels at load time.
+    if (options_.num_threads > 0) net_.opt.num_threads = options_.num_threads;
+    net_.opt.use_fp16_packed = options_.use_fp16_packed;
+    net_.opt.use_fp16_storage = options_.use_fp16_storage;
+    net_.opt.use_fp16_arithmetic = options_.use_fp16_arithmetic;
+    net_.opt.use_winograd_convolution = options_.use_winograd_convolution;
+    net_.opt.use_sgemm_convolution = options_.use_sgemm_convolution;
+    net_.opt.use_packing_layout = options_.use_packing_layout;
+    net_.opt.lightmode = options_.lightmode;
+
+    // No path loads nothing (tracker replay runs without models).
+  loaded_ = !param_path.empty() && LoadNcnnNet(net_, param_path, bin_path, options_.gpu, on_gpu_);
+
+    // Head-only exports (no keypoint outputs) leave the landmarks zero.
+    const std::vector<const char*>& outputs = net_.output_names();
+    has_kps_ = outputs.empty();
+    for (const char* name : outputs) {
+        if (std::strcmp(name, "kps_8") == 0) has_kps_ = true;
+    }
+
+    if (loaded_ && (options_.coreml.enabled || options_.onnx.enabled)) {
+        // Converted from the same network, named like the ncnn files.
+        const std::string stem = param_path.size() > 6 && param_path.compare(param_path.size() - 6, 6, ".param") == 0
+                                     ? param_path.substr(0, param_path.size() - 6)
+                                     : param_path;
+        std::string error;
+        const char* model = options_.coreml.enabled ? ".mlmodelc" : ".onnx";
+        if (options_.coreml.enabled) {
+            backend_ = LoadCoreMlModel(stem + model, options_.coreml, error);
+        } else {
+            backend_ = LoadOnnxModel(FindScrfdOnnx(stem), options_.onnx, error);
+        }
+        if (backend_ && !backend_->hasOutput("score_8")) {
+            error = stem + model + " has no SCRFD outputs (score_8, ...)";
+            backend_.reset();
+        }
+        if (backend_) {
+            has_kps_ = has_kps_ && backend_->hasOutput("kps_8");
+        } else {
+            fprintf(stderr, "Warning: %s; detecting with ncnn\n", error.c_str());
+        }
+    }
+    options_.landmarks = options_.landmarks && has_kps_;
+    if (on_gpu_ && !backend_ && options_.gpu.preprocess) gpu_prep_ = GpuPreprocessor::Create(net_);
+
+    if (loaded_ && options_.warmup) {
+        // First inference pays for lazy setup and fills the pools; do it on a
+        // blank 16:9 frame (the usual video shape) rather than the first real one.
+        const int w = input_width_;
+        const int h = std::max(STRIDES[2], input_width_ * 9 / 16);
+        const std::vector<unsigned char> blank(static_cast<size_t>(w) * h * 3, 0);
+        std::vector<ScrfdFace> unused;
+        DetectRegion(blank.data(), w, 0, 0, w, h, unused);
+    }
+}
 
-    loaded_ = true;
+void ScrfdDetector::SetNumThreads(int n) {
+    options_.num_threads = std::max(0, n);
+    net_.opt.num_threads = n > 0 ? n : ncnn::Option().num_threads;
 }
 
 bool ScrfdDetector::IsLoaded() const {
     return loaded_;
 }
 
-std::vector<ScrfdFace> ScrfdDetector::Detect(const unsigned char* rgb,
-                                              int width,
-                                              int height) const {
-    std::vector<ScrfdFace> faces;
-    if (!loaded_) return faces;
+void ScrfdDetector::DetectRegion(const unsigned char* rgb, int frame_width,
+                                 int x0, int y0, int w, int h,
+                                 std::vector<ScrfdFace>& out,
+                                 int max_side, float min_score, int min_face) const {
+    int new_w = 0, new_h = 0, pad_w = 0, pad_h = 0;
+    const float scale = InputShape(w, h, new_w, new_h, pad_w, pad_h, max_side);
+    // Heads only faces below the smallest one asked for respond to are
+    // skipped; ncnn computes only layers on the path to extracted blobs.
+    const float min_input = static_cast<float>(std::max(options_.min_face, min_face)) * scale;
+    bool run_stride[3] = {true, true, true};
+    for (int s = 0; s < 2; ++s) run_stride[s] = min_input < kStrideMaxFace[s];
+
+    const unsigned char* origin = rgb + (static_cast<size_t>(y0) * frame_width + x0) * 3;
+    ncnn::Mat blobs[3][3];
+    bool inferred = false;
+    if (gpu_prep_) {
+        ncnn::Extractor ex = net_.create_extractor();
+        ex.set_light_mode(options_.lightmode);
+        ex.set_blob_allocator(&blob_pool_);
+        ex.set_workspace_allocator(&workspace_pool_);
+        inferred = gpu_prep_->run(ex, "input.1", origin, w, h, frame_width * 3, new_w, new_h, pad_w, pad_h,
+                                  kMeanVals, kNormVals,
+                                  [&](ncnn::Extractor& e) { ExtractHeads(e, run_stride, blobs); });
+    }
+    if (!inferred) {
+        // Resize, letterbox and normalize in one pass into an input blob each
+        // thread keeps across calls; create() only reallocates when the padded
+        // shape changes.
+        static thread_local ncnn::Mat in_pad;
+        in_pad.create(pad_w, pad_h, 3);
+        ResizeRgbToPlanarNormalized(origin, w, h, frame_width * 3, new_w, new_h, pad_w, pad_h,
+                                    kMeanVals, kNormVals, static_cast<float*>(in_pad.data), in_pad.cstep);
+        Infer(in_pad, run_stride, blobs);
+    }
+    const size_t first = out.size();
+    DecodeHeads(blobs, run_stride, min_score > 0.0f ? min_score : conf_thresh_, out);
+    for (size_t k = first; k < out.size(); ++k) ToRegion(out[k], 0.0f, 0.0f, scale, x0, y0, w, h, options_.landmarks);
+}
 
-    // Compute resize factor (letterbox style)
-    float scale = std::min(static_cast<float>(input_width_) / width,
-                           static_cast<float>(input_height_) / height);
-    int new_w = static_cast<int>(width * scale);
-    int new_h = static_cast<int>(height * scale);
-
-    // Create input mat from RGB, resize to target
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb, ncnn::Mat::PIXEL_RGB, width, height, new_w, new_h);
-
-    // Pad to input_width_ x input_height_ with letterbox
-    int wpad = input_width_ - new_w;
-    int hpad = input_height_ - new_h;
-    ncnn::Mat in_pad;
-    ncnn::copy_make_border(in, in_pad, 0, hpad, 0, wpad, ncnn::BORDER_CONSTANT, 0.f);
-
-    // Normalize: (pixel - 127.5) / 127.5
-    const float mean_vals[3] = {127.5f, 127.5f, 127.5f};
-    const float norm_vals[3] = {1.0f / 127.5f, 1.0f / 127.5f, 1.0f / 127.5f};
-    in_pad.substract_mean_normalize(mean_vals, norm_vals);
-
-    // Run inference
+void ScrfdDetector::Infer(const ncnn::Mat& in, const bool (&run_stride)[3], ncnn::Mat (&blobs)[3][3]) const {
+    if (backend_ && RunBackend(in, blobs)) return;
     ncnn::Extractor ex = net_.create_extractor();
-    ex.set_light_mode(true);
-    ex.input("input.1", in_pad);
-
-    // Extract outputs for each stride
-    const char* score_names[] = {"score_8", "score_16", "score_32"};
-    const char* bbox_names[] = {"bbox_8", "bbox_16", "bbox_32"};
-    const char* kps_names[] = {"kps_8", "kps_16", "kps_32"};
+    ex.set_light_mode(options_.lightmode);
+    ex.set_blob_allocator(&blob_pool_);
+    ex.set_workspace_allocator(&workspace_pool_);
+    ex.input("input.1", in);
+    ExtractHeads(ex, run_stride, blobs);
+}
 
-    std::vector<ScrfdFace> all_faces;
+void ScrfdDetector::ExtractHeads(ncnn::Extractor& ex, const bool (&run_stride)[3], ncnn::Mat (&blobs)[3][3]) const {
+    for (int s = 0; s < 3; ++s) {
+        if (!run_stride[s]) continue;
+        // Keypoint heads are only run when someone reads the landmarks.
+        ex.extract(kScoreNames[s], blobs[s][0]);
+        ex.extract(kBboxNames[s], blobs[s][1]);
+        if (options_.landmarks) ex.extract(kKpsNames[s], blobs[s][2]);
+    }
+}
 
+void ScrfdDetector::DecodeHeads(const ncnn::Mat (&blobs)[3][3], const bool (&run_stride)[3], float thresh,
+                                std::vector<ScrfdFace>& out) const {
+    std::vector<int> candidates;
     for (int s = 0; s < 3; ++s) {
-        int stride = STRIDES[s];
-        
-        ncnn::Mat score_blob, bbox_blob, kps_blob;
-        ex.extract(score_names[s], score_blob);
-        ex.extract(bbox_names[s], bbox_blob);
-        ex.extract(kps_names[s], kps_blob);
-
-        int fm_h = score_blob.h;
-        int fm_w = score_blob.w;
-
-        // Process each anchor position
-        // Model layout: score_blob [num_anchors, h, w], bbox_blob [num_anchors*4, h, w], kps_blob [num_anchors*10, h, w]
+        if (!run_stride[s]) continue;
+        const int stride = STRIDES[s];
+        const ncnn::Mat& score_blob = blobs[s][0];
+        const ncnn::Mat& bbox_blob = blobs[s][1];
+        const ncnn::Mat& kps_blob = blobs[s][2];
+
+        const int fm_w = score_blob.w;
+        const int fm_h = score_blob.h;
+
+        // Model layout: score_blob [num_anchors, h, w], bbox_blob [num_anchors*4, h, w],
+        // kps_blob [num_anchors*10, h, w]. Scores are thresholded first; only the
+        // few surviving cells are decoded.
         for (int q = 0; q < NUM_ANCHORS; ++q) {
-            const ncnn::Mat score = score_blob.channel(q);
-            
-            for (int y = 0; y < fm_h; ++y) {
-                for (int x = 0; x < fm_w; ++x) {
-                    int index = y * fm_w + x;
-                    float prob = score[index];
-                    
-                    if (prob < conf_thresh_) continue;
-
-                    // Anchor center
-                    float cx = (x + 0.5f) * stride;
-                    float cy = (y + 0.5f) * stride;
-
-                    // Decode bbox using distance format (left, top, right, bottom from anchor)
-                    // bbox_blob layout: [num_anchors*4, h, w] where channels are [dx, dy, dw, dh] per anchor
-                    float dx = bbox_blob.channel(q * 4 + 0)[index] * stride;
-                    float dy = bbox_blob.channel(q * 4 + 1)[index] * stride;
-                    float dw = bbox_blob.channel(q * 4 + 2)[index] * stride;
-                    float dh = bbox_blob.channel(q * 4 + 3)[index] * stride;
-
-                    float x1 = (cx - dx) / scale;
-                    float y1 = (cy - dy) / scale;
-                    float x2 = (cx + dw) / scale;
-                    float y2 = (cy + dh) / scale;
-
-                    // Clamp to image bounds
-                    x1 = std::max(0.0f, std::min(x1, static_cast<float>(width)));
-                    y1 = std::max(0.0f, std::min(y1, static_cast<float>(height)));
-                    x2 = std::max(0.0f, std::min(x2, static_cast<float>(width)));
-                    y2 = std::max(0.0f, std::min(y2, static_cast<float>(height)));
-
-                    ScrfdFace face;
-                    face.bbox = {x1, y1, x2, y2};
-                    face.score = prob;
-
-                    // Decode keypoints (5 points, 2 coords each)
-                    // kps_blob layout: [num_anchors*10, h, w]
+            const float* score = score_blob.channel(q);
+            CollectAboveThreshold(score, fm_w * fm_h, thresh, candidates);
+            if (candidates.empty()) continue;
+
+            // bbox channels are distances [left, top, right, bottom] from the anchor
+            const float* dist[4];
+            for (int k = 0; k < 4; ++k) dist[k] = bbox_blob.channel(q * 4 + k);
+            const float* kps[10] = {};
+            if (options_.landmarks) {
+                for (int k = 0; k < 10; ++k) kps[k] = kps_blob.channel(q * 10 + k);
+            }
+
+            for (int index : candidates) {
+                // Anchor center
+                const float cx = (index % fm_w + 0.5f) * stride;
+                const float cy = (index / fm_w + 0.5f) * stride;
+
+                ScrfdFace face;
+                face.bbox = {cx - dist[0][index] * stride, cy - dist[1][index] * stride,
+                             cx + dist[2][index] * stride, cy + dist[3][index] * stride};
+                face.score = score[index];
+
+                // Keypoints: 5 points, (dx, dy) offsets from the anchor
+                if (options_.landmarks) {
                     for (int k = 0; k < 5; ++k) {
-                        float kp_x = (cx + kps_blob.channel(q * 10 + k * 2)[index] * stride) / scale;
-                        float kp_y = (cy + kps_blob.channel(q * 10 + k * 2 + 1)[index] * stride) / scale;
-                        face.landmarks[k] = {kp_x, kp_y};
+                        face.landmarks[k] = {cx + kps[k * 2][index] * stride, cy + kps[k * 2 + 1][index] * stride};
                     }
-
-                    all_faces.push_back(face);
                 }
+
+                out.push_back(face);
             }
         }
     }
+}
+
+bool ScrfdDetector::RunBackend(const ncnn::Mat& in, ncnn::Mat (&blobs)[3][3]) const {
+    std::vector<const char*> names;
+    for (int s = 0; s < 3; ++s) {
+        names.push_back(kScoreNames[s]);
+        names.push_back(kBboxNames[s]);
+        if (options_.landmarks) names.push_back(kKpsNames[s]);
+    }
+    std::vector<ncnn::Mat> outputs;
+    bool ok = backend_->run(in, names, outputs);
+    const int per_stride = options_.landmarks ? 3 : 2;
+    const int ks[3] = {1, 4, 10};
+    for (int s = 0; ok && s < 3; ++s) {
+        const int fm_w = in.w / STRIDES[s];
+        const int fm_h = in.h / STRIDES[s];
+        for (int b = 0; ok && b < per_stride; ++b) {
+            ok = ToAnchorPlanes(outputs[static_cast<size_t>(s * per_stride + b)], fm_w, fm_h, ks[b], blobs[s][b]);
+        }
+    }
+    if (!ok) {
+        static std::atomic<bool> warned{false};
+        if (!warned.exchange(true)) {
+            fprintf(stderr, "Warning: %s detection failed for a %dx%d input; using ncnn\n", backend_->name(), in.w, in.h);
+        }
+    }
+    return ok;
+}
+
+float ScrfdDetector::InputShape(int width, int height, int& new_w, int& new_h, int& pad_w, int& pad_h,
+                                int max_side) const {
+    int input_w = max_side > 0 ? std::min(input_width_, max_side) : input_width_;
+    int input_h = max_side > 0 ? std::min(input_height_, max_side) : input_height_;
+    // A model converted for a fixed size caps the input and is always padded to it.
+    const int fixed_w = backend_ ? backend_->inputWidth() : 0;
+    const int fixed_h = backend_ ? backend_->inputHeight() : 0;
+    if (fixed_w > 0 && fixed_h > 0) {
+        input_w = std::min(input_w, fixed_w);
+        input_h = std::min(input_h, fixed_h);
+    }
+
+    // Compute resize factor (letterbox style)
+    const float scale = std::min(static_cast<float>(input_w) / width,
+                                 static_cast<float>(input_h) / height);
+    new_w = static_cast<int>(width * scale);
+    new_h = static_cast<int>(height * scale);
+
+    // Pad to input_w x input_h with letterbox. SCRFD is fully convolutional,
+    // so the dynamic mode only pads up to the next multiple of the largest
+    // stride (e.g. 640x360 -> 640x384) and skips the dead rows.
+    pad_w = input_w;
+    pad_h = input_h;
+    if (fixed_w > 0 && fixed_h > 0) {
+        pad_w = fixed_w;
+        pad_h = fixed_h;
+    } else if (options_.dynamic_input) {
+        const int align = STRIDES[2];
+        pad_w = (new_w + align - 1) / align * align;
+        pad_h = (new_h + align - 1) / align * align;
+    }
+    return scale;
+}
+
+bool ScrfdDetector::UsesTiles(int width, int height) const {
+    const int tile = options_.tiles.tile_size;
+    return tile > 0 && std::max(width, height) > tile;
+}
+
+std::vector<ScrfdFace> ScrfdDetector::Detect(const unsigned char* rgb,
+                                              int width,
+                                              int height,
+                                              const std::vector<std::array<float, 4>>* focus,
+                                              int max_side,
+                                              float min_score,
+                                              int min_face) const {
+    FACE_PIPELINE_ZONE("ScrfdDetector::Detect");
+    if (!loaded_) return {};
 
-    // Apply NMS
-    std::vector<int> keep = NMS(all_faces, nms_thresh_);
-    
+    std::vector<ScrfdFace> all_faces;
+    if (!UsesTiles(width, height)) {
+        DetectRegion(rgb, width, 0, 0, width, height, all_faces, max_side, min_score, min_face);
+    } else {
+        const TileOptions& t = options_.tiles;
+        if (t.full_frame) DetectRegion(rgb, width, 0, 0, width, height, all_faces, max_side, min_score, min_face);
+
+        std::vector<std::array<int, 4>> tiles;
+        for (const auto& r : TileGrid(width, height, t.tile_size, t.overlap)) {
+            if (focus && !IntersectsAny(r, *focus)) continue;
+            tiles.push_back(r);
+        }
+
+        // Tiles are independent: each runs on its own extractor and keeps its
+        // candidates apart until the merge below.
+        std::vector<std::vector<ScrfdFace>> per_tile(tiles.size());
+        ThreadPool::Shared().parallelFor(static_cast<int>(tiles.size()),
+                                         ResolveTileWorkers(t.workers, options_.num_threads), [&](int k) {
+            const std::array<int, 4>& r = tiles[static_cast<size_t>(k)];
+            std::vector<ScrfdFace>& v = per_tile[static_cast<size_t>(k)];
+            DetectRegion(rgb, width, r[0], r[1], r[2], r[3], v, 0, min_score, min_face);
+            // A face cut by an inner tile edge lies whole in the neighbour.
+            v.erase(std::remove_if(v.begin(), v.end(),
+                                   [&](const ScrfdFace& f) { return ClippedByRegion(f, r, width, height); }),
+                    v.end());
+        });
+        for (const auto& v : per_tile) all_faces.insert(all_faces.end(), v.begin(), v.end());
+    }
+
+    return Suppress(all_faces);
+}
+
+std::vector<ScrfdFace> ScrfdDetector::DetectRegions(const unsigned char* rgb,
+                                                     int width,
+                                                     int height,
+                                                     const std::vector<std::array<int, 4>>& regions,
+                                                     int max_side) const {
+    FACE_PIPELINE_ZONE("ScrfdDetector::DetectRegions");
+    if (!loaded_) return {};
+
+    std::vector<ScrfdFace> all_faces;
+    std::vector<ScrfdFace> v;
+    for (const auto& r : regions) {
+        if (r[2] <= 0 || r[3] <= 0) continue;
+        v.clear();
+        DetectRegion(rgb, width, r[0], r[1], r[2], r[3], v, max_side);
+        for (const ScrfdFace& f : v) {
+            if (!ClippedByRegion(f, r, width, height)) all_faces.push_back(f);
+        }
+    }
+    return Suppress(all_faces);
+}
+
+std::vector<ScrfdFace> ScrfdDetector::DetectMosaic(const unsigned char* rgb,
+                                                    int width,
+                                                    int height,
+                                                    const std::vector<std::array<int, 4>>& regions,
+                                                    int max_side,
+                                                    int* passes) const {
+    FACE_PIPELINE_ZONE("ScrfdDetector::DetectMosaic");
+    if (!loaded_) return {};
+
+    // The canvas is one full network input. Cells start on the coarsest
+    // stride's grid, so each crop meets the anchors it would on its own.
+    const int align = STRIDES[2];
+    auto align_up = [align](int v) { return (v + align - 1) / align * align; };
+    int canvas_w = 0, canvas_h = 0, unused_w = 0, unused_h = 0;
+    InputShape(input_width_, input_height_, unused_w, unused_h, canvas_w, canvas_h);
+    const bool fixed = backend_ && backend_->inputWidth() > 0 && backend_->inputHeight() > 0;
+
+    struct Cell {
+        std::array<int, 4> region;
+        float scale;
+        int x, y, w, h;  // in the canvas
+    };
+    std::vector<Cell> cells;
+    std::vector<ScrfdFace> all_faces;
+    std::vector<ScrfdFace> faces;
+    auto run = [&]() {
+        if (cells.empty()) return;
+        int pad_w = canvas_w, pad_h = canvas_h;
+        if (options_.dynamic_input && !fixed) {
+            pad_w = pad_h = 0;
+            for (const Cell& c : cells) {
+                pad_w = std::max(pad_w, align_up(c.x + c.w));
+                pad_h = std::max(pad_h, align_up(c.y + c.h));
+            }
+        }
+        static thread_local ncnn::Mat mosaic;
+        static thread_local ncnn::Mat cell_in;
+        mosaic.create(pad_w, pad_h, 3);
+        mosaic.fill(-kMeanVals[0] * kNormVals[0]);  // what letterbox padding normalizes to
+        for (const Cell& c : cells) {
+            const std::array<int, 4>& r = c.region;
+            cell_in.create(c.w, c.h, 3);
+            const unsigned char* origin = rgb + (static_cast<size_t>(r[1]) * width + r[0]) * 3;
+            ResizeRgbToPlanarNormalized(origin, r[2], r[3], width * 3, c.w, c.h, c.w, c.h, kMeanVals, kNormVals,
+                                        static_cast<float*>(cell_in.data), cell_in.cstep);
+            for (int ch = 0; ch < 3; ++ch) {
+                const ncnn::Mat src = cell_in.channel(ch);
+                ncnn::Mat dst = mosaic.channel(ch);
+                for (int y = 0; y < c.h; ++y) std::copy(src.row(y), src.row(y) + c.w, dst.row(c.y + y) + c.x);
+            }
+        }
+
+        ncnn::Mat blobs[3][3];
+        const bool all_strides[3] = {true, true, true};
+        Infer(mosaic, all_strides, blobs);
+        faces.clear();
+        DecodeHeads(blobs, all_strides, conf_thresh_, faces);
+        // Each face goes back to the crop its center is in.
+        for (ScrfdFace& f : faces) {
+            const float cx = 0.5f * (f.bbox[0] + f.bbox[2]);
+            const float cy = 0.5f * (f.bbox[1] + f.bbox[3]);
+            for (const Cell& c : cells) {
+                if (cx < c.x || cx >= c.x + c.w || cy < c.y || cy >= c.y + c.h) continue;
+                const std::array<int, 4>& r = c.region;
+                ToRegion(f, static_cast<float>(c.x), static_cast<float>(c.y), c.scale, r[0], r[1], r[2], r[3],
+                         options_.landmarks);
+                if (!ClippedByRegion(f, r, width, height)) all_faces.push_back(f);
+                break;
+            }
+        }
+        cells.clear();
+        if (passes) (*passes)++;
+    };
+
+    // Shelf packing in the given order: left to right, a new row below the
+    // tallest cell once one does not fit, a new canvas once a row does not.
+    int x = 0, y = 0, row_h = 0;
+    for (const auto& r : regions) {
+        if (r[2] <= 0 || r[3] <= 0) continue;
+        int new_w = 0, new_h = 0, pad_w = 0, pad_h = 0;
+        const float scale = InputShape(r[2], r[3], new_w, new_h, pad_w, pad_h, max_side);
+        if (x > 0 && x + new_w > canvas_w) {
+            x = 0;
+            y += row_h;
+            row_h = 0;
+        }
+        if (y > 0 && y + new_h > canvas_h) {
+            run();
+            x = y = row_h = 0;
+        }
+        cells.push_back({r, scale, x, y, new_w, new_h});
+        x = align_up(x + new_w);
+        row_h = std::max(row_h, align_up(new_h));
+    }
+    run();
+    return Suppress(all_faces);
+}
+
+std::vector<ScrfdFace> ScrfdDetector::Suppress(const std::vector<ScrfdFace>& all_faces) const {
+    // Apply NMS (plus the optional duplicate-merge level in the same pass)
+    std::vector<std::array<float, 4>> boxes;
+    std::vector<float> scores;
+    boxes.reserve(all_faces.size());
+    scores.reserve(all_faces.size());
+    for (const auto& f : all_faces) {
+        boxes.push_back(f.bbox);
+        scores.push_back(f.score);
+    }
+    const float merge = options_.merge_iou > 0.0f ? options_.merge_iou : -1.0f;
+    const std::vector<int> keep = GreedyNms(boxes, scores, nms_thresh_, merge);
+
+    // Kept in descending score order
+    std::vector<ScrfdFace> faces;
     faces.reserve(keep.size());
     for (int idx : keep) {
         faces.push_back(all_faces[idx]);
     }
 
-    // Sort by score descending
-    std::sort(faces.begin(), faces.end(), [](const ScrfdFace& a, const ScrfdFace& b) {
-        return a.score > b.score;
-    });
-
     return faces;
 }
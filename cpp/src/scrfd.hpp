@@ -1,37 +1,190 @@
 #pragma once
 
 #include <array>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "face_detector.hpp"
+#include "gpu_preprocess.hpp"
+#include "huge_pages.hpp"
+#include "inference_backend.hpp"
 #include "net.h"
 
-struct ScrfdFace {
-  std::array<float, 4> bbox;
-  float score = 0.0f;
-  std::array<std::array<float, 2>, 5> landmarks{};
+/**
+ * Tiled detection for high-resolution frames.
+ *
+ * Downscaling a 4K frame to the 640 px input shrinks small faces below the
+ * stride-8 anchors. With tiling the frame is also cut into overlapping
+ * `tile_size` squares, each letterboxed to the network input on its own, and
+ * the candidates of all passes are merged by one NMS. A box clipped by an
+ * inner tile edge is dropped; the overlap puts that face whole into the
+ * neighbouring tile, and the full-frame pass catches faces larger than it.
+ */
+struct TileOptions {
+  int tile_size = 0;                   // tile side in frame pixels (0 = off)
+  float overlap = 0.25f;               // fraction of tile_size shared by neighbouring tiles
+  bool full_frame = true;              // also run the whole frame (large faces)
+  int workers = 0;                     // tiles detected concurrently (0 = auto)
 };
 
-class ScrfdDetector {
+/**
+ * Execution options for the detector. The ncnn fields default to ncnn's own
+ * values, so they behave exactly like a bare ncnn::Net unless changed.
+ */
+struct DetectorOptions {
+  int num_threads = 0;                 // 0 = ncnn default (physical big cores)
+  bool use_fp16_packed = true;
+  bool use_fp16_storage = true;
+  bool use_fp16_arithmetic = true;
+  bool use_winograd_convolution = true;
+  bool use_sgemm_convolution = true;
+  bool use_packing_layout = true;
+  bool lightmode = true;               // recycle intermediate blobs during inference
+  bool dynamic_input = true;           // pad to the frame's aspect (multiple of 32) instead of square
+  bool landmarks = true;               // decode the 5 keypoints (off leaves ScrfdFace::landmarks zero)
+  float merge_iou = 0.0f;              // second, stricter NMS level in the same pass (0 = off)
+  int min_face = 0;                    // smallest face side to find (frame pixels): stride heads only smaller faces need are skipped (0 = all)
+  GpuOptions gpu;                      // Vulkan execution (falls back to CPU)
+  CoreMlOptions coreml;                // Core ML execution of <stem>.mlmodelc (falls back to ncnn)
+  OnnxRuntimeOptions onnx;             // ONNX Runtime execution of <stem>.onnx (falls back to ncnn)
+  TileOptions tiles;                   // tiled high-resolution detection
+  bool warmup = true;                  // run one inference at load so the first frame is not the slow one
+};
+
+class ScrfdDetector : public FaceDetector {
 public:
   ScrfdDetector(const std::string& param_path,
                 const std::string& bin_path,
                 int input_width = 640,
                 int input_height = 640,
                 float conf_thresh = 0.5f,
-                float nms_thresh = 0.4f);
+                float nms_thresh = 0.4f,
+                const DetectorOptions& options = DetectorOptions{});
 
-  bool IsLoaded() const;
+  bool IsLoaded() const override;
+  const char* Name() const override { return "scrfd"; }
+  bool UsesGpu() const { return on_gpu_; }
+  const char* BackendName() const { return backend_ ? backend_->name() : "ncnn"; }
+  bool HasLandmarks() const { return has_kps_; }  // the model has the keypoint heads
 
+  /**
+   * ncnn threads of each Detect call from now on (0 = ncnn's default), e.g.
+   * a slice of the cores while several frames are detected at once. Not
+   * while a Detect call runs.
+   */
+  void SetNumThreads(int n);
+  int NumThreads() const { return options_.num_threads; }
+
+  /**
+   * Detect faces in an interleaved RGB frame. Safe to call concurrently:
+   * every call runs on its own extractor.
+   *
+   * @param focus With tiling on, only tiles intersecting one of these pixel
+   *              boxes (x1, y1, x2, y2) are run; nullptr runs every tile.
+   *              The full-frame pass is never skipped.
+   * @param max_side Caps the full-frame pass's input side below the
+   *                 configured one (0 = no cap); tiles keep the full input.
+   * @param min_score Keeps candidates down to this score instead of the
+   *                  configured threshold (0 = the threshold)
+   * @param min_face Smallest face side to find in frame pixels, above
+   *                 DetectorOptions::min_face (0 = that one)
+   */
   std::vector<ScrfdFace> Detect(const unsigned char* rgb,
                                 int width,
-                                int height) const;
+                                int height,
+                                const std::vector<std::array<float, 4>>* focus = nullptr,
+                                int max_side = 0,
+                                float min_score = 0.0f,
+                                int min_face = 0) const;
+
+  std::vector<ScrfdFace> DetectFaces(const unsigned char* rgb, int width, int height) const override {
+    return Detect(rgb, width, height);
+  }
+
+  /**
+   * Detect faces only inside the pixel regions (x, y, w, h), e.g. around
+   * tracked faces between full-frame detections. Each region is letterboxed
+   * on its own to at most `max_side` pixels (0 = the full input size); faces
+   * cut by a region edge inside the frame are dropped.
+   */
+  std::vector<ScrfdFace> DetectRegions(const unsigned char* rgb,
+                                       int width,
+                                       int height,
+                                       const std::vector<std::array<int, 4>>& regions,
+                                       int max_side = 0) const;
+
+  /**
+   * DetectRegions() with the letterboxed regions packed side by side into
+   * as few network inputs as hold them (--roi-mosaic): one forward pass for
+   * several crops instead of one each. A face goes back to the region its
+   * center falls in.
+   *
+   * @param passes If set, incremented by the forward passes run
+   */
+  std::vector<ScrfdFace> DetectMosaic(const unsigned char* rgb,
+                                      int width,
+                                      int height,
+                                      const std::vector<std::array<int, 4>>& regions,
+                                      int max_side = 0,
+                                      int* passes = nullptr) const;
+
+  /**
+   * True if frames of this size are split into tiles.
+   */
+  bool UsesTiles(int width, int height) const;
+
+  /**
+   * Network input geometry for a `width x height` region: the letterboxed
+   * image size and the padded blob it is placed in.
+   *
+   * @param max_side Caps the input size below the configured one (0 = no cap)
+   * @return Resize factor from region to network pixels
+   */
+  float InputShape(int width, int height, int& new_w, int& new_h, int& pad_w, int& pad_h,
+                   int max_side = 0) const;
 
 private:
+  // Run the network on the region (x0, y0, w, h) of the frame and append the
+  // raw (pre-NMS) candidates in frame coordinates, clamped to the region.
+  void DetectRegion(const unsigned char* rgb, int frame_width,
+                    int x0, int y0, int w, int h,
+                    std::vector<ScrfdFace>& out,
+                    int max_side = 0, float min_score = 0.0f, int min_face = 0) const;
+
+  // Score, bbox and keypoint blobs of the strides in `run_stride` for the
+  // input blob `in`.
+  void Infer(const ncnn::Mat& in, const bool (&run_stride)[3], ncnn::Mat (&blobs)[3][3]) const;
+
+  // Extract the blobs of the strides in `run_stride` from a prepared extractor.
+  void ExtractHeads(ncnn::Extractor& ex, const bool (&run_stride)[3], ncnn::Mat (&blobs)[3][3]) const;
+
+  // Candidates of the heads in `run_stride` scoring at least `thresh`,
+  // appended in network input pixels.
+  void DecodeHeads(const ncnn::Mat (&blobs)[3][3], const bool (&run_stride)[3], float thresh,
+                   std::vector<ScrfdFace>& out) const;
+
+  // NMS over the candidates of all passes, by descending score.
+  std::vector<ScrfdFace> Suppress(const std::vector<ScrfdFace>& all_faces) const;
+
+  // Score, bbox and keypoint blobs of the three strides from the alternative
+  // backend, in ncnn's [anchors * k, h, w] layout; false to use ncnn instead.
+  bool RunBackend(const ncnn::Mat& in, ncnn::Mat (&blobs)[3][3]) const;
+
+  // Blob and scratch memory pooled for the detector's lifetime, so steady-state
+  // inference reuses earlier buffers instead of allocating. Locked pools:
+  // Detect() runs concurrently. Declared before net_ to outlive it.
+  mutable HugePagePoolAllocator blob_pool_;
+  mutable HugePagePoolAllocator workspace_pool_;
   ncnn::Net net_;
+  std::unique_ptr<NetBackend> backend_;  // Core ML / ONNX Runtime when requested and available
+  std::unique_ptr<GpuPreprocessor> gpu_prep_;  // on Vulkan: input prepared on the device (GpuOptions::preprocess)
   int input_width_ = 640;
   int input_height_ = 640;
   float conf_thresh_ = 0.5f;
   float nms_thresh_ = 0.4f;
+  DetectorOptions options_;
   bool loaded_ = false;
+  bool on_gpu_ = false;
+  bool has_kps_ = false;
 };
@@ -0,0 +1,225 @@
+#include "scrfd_variants.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "inference_backend.hpp"
+
+namespace {
+// Input sides tried for every variant, largest first.
+constexpr int kInputSides[] = {640, 512, 416, 320};
+
+constexpr int kBenchWidth = 1280;
+constexpr int kBenchHeight = 720;
+constexpr int kBenchRuns = 3;
+
+struct Candidate {
+    ScrfdVariant variant;
+    std::string stem;
+    int side = 640;
+    float gflops = 0.0f;  // at this side
+};
+
+float ProfileGflops(SpeedProfile profile) {
+    switch (profile) {
+        case SpeedProfile::Fast: return 0.7f;
+        case SpeedProfile::Balanced: return 2.6f;
+        default: return std::numeric_limits<float>::infinity();
+    }
+}
+
+std::string DefaultBenchCache() {
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) return std::string(xdg) + "/face_pipeline_scrfd_bench.txt";
+    const char* home = std::getenv("HOME");
+    if (home && *home) return std::string(home) + "/.cache/face_pipeline_scrfd_bench.txt";
+    return std::string();
+}
+
+// Benchmarks are keyed by model file, its size (a re-export invalidates the
+// entry), input side and thread count.
+std::string BenchKey(const std::string& stem, int side, const DetectorOptions& det) {
+    long long bytes = 0;
+    std::ifstream bin(stem + ".bin", std::ios::binary | std::ios::ate);
+    if (bin) bytes = static_cast<long long>(bin.tellg());
+    std::ostringstream key;
+    key << stem << ' ' << bytes << ' ' << side << ' ' << det.num_threads << ' ' << (det.landmarks ? 1 : 0);
+    return key.str();
+}
+
+bool LookupBench(const std::string& cache, const std::string& key, double& ms) {
+    if (cache.empty()) return false;
+    std::ifstream in(cache);
+    std::string line;
+    bool found = false;
+    while (std::getline(in, line)) {
+        // Later entries win; the file is only ever appended to.
+        const size_t split = line.rfind(' ');
+        if (split == std::string::npos || line.compare(0, split, key) != 0 || split != key.size()) continue;
+        ms = std::atof(line.c_str() + split + 1);
+        found = true;
+    }
+    return found;
+}
+
+void StoreBench(const std::string& cache, const std::string& key, double ms) {
+    if (cache.empty()) return;
+    std::ofstream out(cache, std::ios::app);
+    if (out) out << key << ' ' << ms << '\n';
+}
+
+// Mean detector time on a synthetic frame; < 0 if the model does not load.
+double BenchmarkCandidate(const Candidate& c, DetectorOptions det) {
+    det.warmup = false;  // warmed up on the benchmark frame below
+    ScrfdDetector detector(c.stem + ".param", c.stem + ".bin", c.side, c.side, 0.5f, 0.4f, det);
+    if (!detector.IsLoaded()) return -1.0;
+    std::vector<unsigned char> frame(static_cast<size_t>(kBenchWidth) * kBenchHeight * 3);
+    for (size_t i = 0; i < frame.size(); ++i) {
+        frame[i] = static_cast<unsigned char>((i * 2654435761u) >> 24);
+    }
+    detector.Detect(frame.data(), kBenchWidth, kBenchHeight);  // warm-up (pipeline creation, allocations)
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < kBenchRuns; ++r) detector.Detect(frame.data(), kBenchWidth, kBenchHeight);
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count() / kBenchRuns;
+}
+}  // namespace
+
+bool ParseSpeedProfile(const char* name, SpeedProfile& out) {
+    if (std::strcmp(name, "fast") == 0) {
+        out = SpeedProfile::Fast;
+    } else if (std::strcmp(name, "balanced") == 0) {
+        out = SpeedProfile::Balanced;
+    } else if (std::strcmp(name, "accurate") == 0) {
+        out = SpeedProfile::Accurate;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const std::vector<ScrfdVariant>& ScrfdVariantRegistry() {
+    static const std::vector<ScrfdVariant> registry = {
+        {"500m", "scrfd_500m", 0.5f, false},
+        {"500m", "scrfd_500m_kps", 0.5f, true},
+        {"2.5g", "scrfd_2.5g", 2.5f, false},
+        {"2.5g", "scrfd_2.5g_kps", 2.5f, true},
+        {"2.5g", "scrfd", 2.5f, true},
+        {"10g", "scrfd_10g", 10.0f, false},
+        {"10g", "scrfd_10g_kps", 10.0f, true},
+    };
+    return registry;
+}
+
+bool SelectScrfdVariant(const std::string& model_dir,
+                        const DetectorSelection& selection,
+                        const DetectorOptions& detector,
+                        DetectorChoice& out,
+                        std::string& error) {
+    std::vector<ScrfdVariant> present;
+    bool any_kps = false;
+    for (const ScrfdVariant& v : ScrfdVariantRegistry()) {
+        if (FindModelStem(model_dir, {v.stem}).empty()) continue;
+        present.push_back(v);
+        any_kps = any_kps || v.kps;
+    }
+    if (present.empty()) {
+        error = "no SCRFD model in " + model_dir;
+        return false;
+    }
+    if (selection.landmarks && !any_kps) {
+        fprintf(stderr, "Warning: no SCRFD keypoint model in %s; ReID crops will not be aligned\n",
+                model_dir.c_str());
+    }
+
+    std::vector<Candidate> candidates;
+    for (const ScrfdVariant& v : present) {
+        // Keypoint heads when ReID aligns crops, else the cheaper export.
+        if (selection.landmarks && any_kps && !v.kps) continue;
+        for (int side : kInputSides) {
+            const float r = static_cast<float>(side) / 640.0f;
+            candidates.push_back(Candidate{v, model_dir + "/" + v.stem, side, v.gflops * r * r});
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [&selection](const Candidate& a, const Candidate& b) {
+        if (a.side != b.side) return a.side > b.side;
+        if (a.gflops != b.gflops) return a.gflops > b.gflops;
+        return !selection.landmarks && !a.variant.kps && b.variant.kps;
+    });
+
+    const float max_gflops = ProfileGflops(selection.profile);
+    std::vector<Candidate> allowed;
+    for (const Candidate& c : candidates) {
+        if (c.gflops <= max_gflops) allowed.push_back(c);
+    }
+    if (allowed.empty()) {
+        // Even the cheapest candidate is over the target: take it anyway.
+        allowed.push_back(*std::min_element(candidates.begin(), candidates.end(),
+                                            [](const Candidate& a, const Candidate& b) {
+                                                return a.gflops < b.gflops;
+                                            }));
+    }
+
+    const Candidate* chosen = &allowed.front();
+    double chosen_ms = 0.0;
+    if (selection.ms_per_frame > 0.0f) {
+        DetectorOptions det = detector;
+        det.landmarks = selection.landmarks;
+        const std::string cache = selection.bench_cache.empty() ? DefaultBenchCache() : selection.bench_cache;
+        const Candidate* fastest = nullptr;
+        double fastest_ms = std::numeric_limits<double>::infinity();
+        chosen = nullptr;
+        for (const Candidate& c : allowed) {
+            const std::string key = BenchKey(c.stem, c.side, det);
+            double ms = 0.0;
+            if (!LookupBench(cache, key, ms)) {
+                ms = BenchmarkCandidate(c, det);
+                if (ms < 0.0) continue;
+                StoreBench(cache, key, ms);
+            }
+            if (ms < fastest_ms) {
+                fastest = &c;
+                fastest_ms = ms;
+            }
+            if (ms <= selection.ms_per_frame) {
+                chosen = &c;
+                chosen_ms = ms;
+                break;
+            }
+        }
+        if (!chosen) {
+            if (!fastest) {
+                error = "no SCRFD model in " + model_dir + " could be loaded";
+                return false;
+            }
+            chosen = fastest;
+            chosen_ms = fastest_ms;
+        }
+    }
+
+    out.stem = chosen->stem;
+    out.name = chosen->variant.name;
+    out.input_side = chosen->side;
+    out.ms = chosen_ms;
+    return true;
+}
+
+std::string ResolveDetectorStem(const std::string& model_dir, const std::string& stem, bool int8) {
+    const std::string base = stem.empty() ? model_dir + "/scrfd" : stem;
+    const size_t slash = base.rfind('/');
+    const std::string dir = slash == std::string::npos ? std::string(".") : base.substr(0, slash);
+    const std::string name = base.substr(slash == std::string::npos ? 0 : slash + 1);
+    if (int8) {
+        const std::string found = FindModelStem(dir, {(name + "-int8").c_str()});
+        if (!found.empty()) return found;
+    }
+    // The optimized graph prepare_models writes, if there is one.
+    const std::string opt = FindModelStem(dir, {(name + "-opt").c_str()});
+    return opt.empty() ? base : opt;
+}
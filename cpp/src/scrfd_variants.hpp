@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "scrfd.hpp"
+
+/**
+ * SCRFD model variants and speed-based selection.
+ *
+ * A model directory may hold several SCRFD exports side by side, named by
+ * their upstream configs: `scrfd_500m[_kps]`, `scrfd_2.5g[_kps]` and
+ * `scrfd_10g[_kps]` (.param/.bin). The plain `scrfd` files are the 2.5g
+ * keypoint model and stay the default. Keypoints only matter for ReID
+ * alignment, so without ReID the cheaper head-only exports are preferred.
+ */
+enum class SpeedProfile {
+    Default,   // <model_dir>/scrfd at 640
+    Fast,      // about 0.5 GFLOPs per frame
+    Balanced,  // about 2.5 GFLOPs per frame
+    Accurate,  // the largest variant present
+};
+
+/**
+ * Parse "fast", "balanced" or "accurate".
+ */
+bool ParseSpeedProfile(const char* name, SpeedProfile& out);
+
+struct ScrfdVariant {
+    const char* name;  // "500m", "2.5g", "10g"
+    const char* stem;  // file name without extension
+    float gflops;      // at 640x640
+    bool kps;          // has the keypoint heads
+};
+
+/**
+ * All variants the pipeline knows about, smallest first.
+ */
+const std::vector<ScrfdVariant>& ScrfdVariantRegistry();
+
+/**
+ * Options for SelectScrfdVariant().
+ */
+struct DetectorSelection {
+    SpeedProfile profile = SpeedProfile::Default;
+    float ms_per_frame = 0.0f;  // > 0: benchmark candidates, take the most accurate within this time
+    bool landmarks = true;      // keypoints needed (ReID alignment)
+    std::string bench_cache;    // benchmark results file (empty = $XDG_CACHE_HOME or ~/.cache)
+};
+
+/**
+ * Detector model and input size picked for a speed target.
+ */
+struct DetectorChoice {
+    std::string stem;      // "<model_dir>/<stem>" without extension
+    std::string name;      // variant name, e.g. "2.5g"
+    int input_side = 640;  // network input (long side)
+    double ms = 0.0;       // measured time per frame (0 = not benchmarked)
+};
+
+/**
+ * Pick the SCRFD variant and input size for `selection`.
+ *
+ * Candidates are ordered by input side, then model size, largest first:
+ * small faces need the resolution more than a bigger backbone. Profiles take
+ * the first candidate within their FLOP target. A `ms_per_frame` budget runs
+ * each candidate on a synthetic 720p frame (results are cached per host, so
+ * this happens once) and takes the first that fits, else the fastest.
+ *
+ * @return false with `error` set if no variant exists in `model_dir`
+ */
+bool SelectScrfdVariant(const std::string& model_dir,
+                        const DetectorSelection& selection,
+                        const DetectorOptions& detector,
+                        DetectorChoice& out,
+                        std::string& error);
+
+/**
+ * Detector files to load: `stem` (empty = <model_dir>/scrfd), or its
+ * "-int8" export when `int8` is set and the files exist, else its "-opt"
+ * graph (scripts/prepare_models.py) when that exists.
+ */
+std::string ResolveDetectorStem(const std::string& model_dir, const std::string& stem, bool int8);
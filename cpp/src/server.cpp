@@ -0,0 +1,774 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "detection_cache.hpp"
+#include "detection_scheduler.hpp"
+#include "frame_source.hpp"
+#include "json_reader.hpp"
+#include "gmc_stage.hpp"
+#include "numa.hpp"
+#include "prefetcher.hpp"
+#include "shared_frames.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+// JSON-RPC error codes.
+constexpr int kParseError = -32700;
+constexpr int kInvalidRequest = -32600;
+constexpr int kMethodNotFound = -32601;
+constexpr int kInvalidParams = -32602;
+constexpr int kServerError = -32000;
+constexpr int kRequestCancelled = -32800;
+
+// Detect results kept for frames asked about again (scrubbing back and forth).
+constexpr size_t kDetectCacheEntries = 256;
+
+void AppendF(std::string& out, const char* format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    const int n = std::vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (n > 0) out.append(buf, static_cast<size_t>(std::min(n, static_cast<int>(sizeof(buf)) - 1)));
+}
+
+std::string Quote(const std::string& s) {
+    std::string out = "\"";
+    for (const char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    AppendF(out, "\\u%04x", static_cast<unsigned>(c));
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+    return out;
+}
+
+// Optional number parameter `key` into `value`; false if present but not a number.
+template <typename T>
+bool NumberParam(const Json& params, const char* key, T& value) {
+    const Json* v = params.get(key);
+    if (!v) return true;
+    if (v->type != Json::Type::Number) return false;
+    value = static_cast<T>(v->number);
+    return true;
+}
+
+// A track run's input and tuning (see RunServer for the params).
+struct TrackInput {
+    std::vector<std::string> paths;  // of an image list; the source refers to them
+    std::unique_ptr<FrameSource> source;
+    float video_fps = 30.0f;
+    RunTuning tuning;
+};
+
+// False with a JSON-RPC error code and message if `p` does not describe a run.
+bool ParseTrackParams(const Json& p, const ServerConfig& config, TrackInput& input, int& code, std::string& message) {
+    input.video_fps = config.video_fps;
+    RunTuning& tuning = input.tuning;
+    tuning.detection_fps = config.detection_fps;
+    tuning.iou_thresh = config.iou_thresh;
+    tuning.reid_weight = config.reid_weight;
+    tuning.reid_cos_thresh = config.reid_cos_thresh;
+    tuning.tracking = config.options;
+    const bool fps_given = p.get("videoFps") != nullptr;
+    if (!NumberParam(p, "videoFps", input.video_fps) || !NumberParam(p, "detectionFps", tuning.detection_fps) ||
+        !NumberParam(p, "iouThresh", tuning.iou_thresh) || !NumberParam(p, "reidWeight", tuning.reid_weight) ||
+        !NumberParam(p, "reidCosThresh", tuning.reid_cos_thresh) ||
+        !NumberParam(p, "trackMaxAge", tuning.tracking.track_max_age) ||
+        !NumberParam(p, "trackTentativeAge", tuning.tracking.track_tentative_age) ||
+        !NumberParam(p, "trackDormantAge", tuning.tracking.track_dormant_age) ||
+        !NumberParam(p, "trackInertia", tuning.tracking.track_inertia) ||
+        !NumberParam(p, "smoothLag", tuning.tracking.smooth_lag) ||
+        !NumberParam(p, "keyframeTolerance", tuning.tracking.keyframe_tolerance) ||
+        !NumberParam(p, "timeBudget", tuning.tracking.time_budget_s)) {
+        code = kInvalidParams;
+        message = "numeric parameters must be numbers";
+        return false;
+    }
+    if (const Json* cuts = p.get("cuts")) {
+        bool ok = cuts->type == Json::Type::Array;
+        tuning.tracking.cut_frames.clear();
+        for (size_t k = 0; ok && k < cuts->items.size(); ++k) {
+            ok = cuts->items[k].type == Json::Type::Number;
+            if (ok) tuning.tracking.cut_frames.push_back(static_cast<int>(cuts->items[k].number));
+        }
+        if (!ok) {
+            code = kInvalidParams;
+            message = "cuts must be an array of frame indices";
+            return false;
+        }
+    }
+
+    std::vector<std::string>& paths = input.paths;
+    const Json* images = p.get("images");
+    const Json* images_file = p.get("imagesFile");
+    const Json* video = p.get("video");
+    if (images) {
+        if (images->type != Json::Type::Array) {
+            code = kInvalidParams;
+            message = "images must be an array of paths";
+            return false;
+        }
+        for (const Json& path : images->items) {
+            if (path.type != Json::Type::String) {
+                code = kInvalidParams;
+                message = "images must be an array of paths";
+                return false;
+            }
+            paths.push_back(path.text);
+        }
+    } else if (images_file && images_file->type == Json::Type::String) {
+        std::ifstream file(images_file->text);
+        if (!file.is_open()) {
+            code = kServerError;
+            message = "cannot open " + images_file->text;
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            const size_t start = line.find_first_not_of(" \t\r\n");
+            const size_t end = line.find_last_not_of(" \t\r\n");
+            if (start != std::string::npos) paths.push_back(line.substr(start, end - start + 1));
+        }
+    } else if (video && video->type == Json::Type::String) {
+        auto video_source =
+            std::make_unique<VideoFrameSource>(video->text, config.video_hwaccel, config.video_motion_vectors);
+        if (!video_source->isOpen()) {
+            code = kServerError;
+            message = video_source->error();
+            return false;
+        }
+        if (!fps_given && video_source->frameRate() > 0.0) {
+            input.video_fps = static_cast<float>(video_source->frameRate());
+        }
+        input.source = std::move(video_source);
+    } else {
+        code = kInvalidParams;
+        message = "track needs images, imagesFile or video";
+        return false;
+    }
+    if (!input.source) {
+        if (paths.empty()) {
+            code = kServerError;
+            message = "No image paths provided";
+            return false;
+        }
+        input.source = std::make_unique<ImageListSource>(paths);
+    }
+    return true;
+}
+
+// A run's tracks as the result of a track request.
+std::string TracksJson(const PipelineResult& result) {
+    std::string out = "{\"tracks\": [";
+    for (size_t t = 0; t < result.tracks.size(); ++t) {
+        const FaceTrack& track = result.tracks[t];
+        AppendF(out, "%s{\"id\": %d, ", t > 0 ? ", " : "", track.id);
+        if (track.identity >= 0) AppendF(out, "\"identity\": %d, ", track.identity);
+        out += "\"frames\": [";
+        for (size_t f = 0; f < track.frames.size(); ++f) {
+            const TrackFrame& frame = track.frames[f];
+            AppendF(out, "%s{\"frameIndex\": %d, \"bbox\": [%.6f, %.6f, %.6f, %.6f], \"confidence\": %.4f}",
+                    f > 0 ? ", " : "", frame.frame_index, frame.bbox.x1, frame.bbox.y1, frame.bbox.x2,
+                    frame.bbox.y2, frame.confidence);
+        }
+        out += "]}";
+    }
+    AppendF(out, "], \"frameCount\": %d%s}", result.frame_count, result.stopped ? ", \"stopped\": true" : "");
+    return out;
+}
+
+// Clips tracked at once on auto. Each clip's stages already spread over the
+// cores, so a few clips are enough to fill the gaps one leaves (start-up,
+// linking, decode stalls).
+int ResolveClipWorkers() {
+    return std::max(1, std::min(4, PipelineCoreCount() / 2));
+}
+
+class Server {
+public:
+    Server(const ServerConfig& config, FILE* out)
+        : config_(config),
+          out_(out),
+          pipeline_(config.model_dir, config.conf_thresh, config.detection_fps, config.iou_thresh,
+                    config.reid_model_dir, config.reid_weight, config.reid_cos_thresh, config.options) {
+        if (!pipeline_.isLoaded()) return;
+        worker_ = std::thread([this] { work(); });
+        detect_worker_ = std::thread([this] { detectWork(); });
+    }
+
+    ~Server() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            closing_ = true;
+        }
+        cv_.notify_all();
+        detect_cv_.notify_all();
+        if (worker_.joinable()) worker_.join();
+        if (detect_worker_.joinable()) detect_worker_.join();
+    }
+
+    bool loaded() const { return pipeline_.isLoaded(); }
+    const MemoryBudget* memoryBudget() const { return pipeline_.memoryBudget(); }
+
+    void send(const std::string& message) {
+        std::lock_guard<std::mutex> lock(out_mu_);
+        std::fputs(message.c_str(), out_);
+        std::fputc('\n', out_);
+        std::fflush(out_);
+    }
+
+    // One request line, on the reader's thread.
+    void handle(const std::string& line) {
+        Json request;
+        if (!JsonParser(line).parse(request)) {
+            fail("null", kParseError, "Parse error");
+            return;
+        }
+        const Json* id = request.type == Json::Type::Object ? request.get("id") : nullptr;
+        const std::string id_text = id ? line.substr(id->begin, id->end - id->begin) : std::string();
+        const Json* method = request.type == Json::Type::Object ? request.get("method") : nullptr;
+        if (!method || method->type != Json::Type::String) {
+            fail(id ? id_text : "null", kInvalidRequest, "Invalid request");
+            return;
+        }
+        static const Json kNoParams = [] {
+            Json j;
+            j.type = Json::Type::Object;
+            return j;
+        }();
+        const Json* params = request.get("params");
+        if (!params) params = &kNoParams;
+        if (params->type != Json::Type::Object) {
+            fail(id_text, kInvalidParams, "params must be an object");
+            return;
+        }
+
+        if (method->text == "track") {
+            std::lock_guard<std::mutex> lock(mu_);
+            queue_.push_back(TrackJob{id_text, *params, std::make_shared<std::atomic<bool>>(false)});
+            cv_.notify_all();
+        } else if (method->text == "detect") {
+            queueDetect(id_text, *params);
+        } else if (method->text == "frameRing") {
+            frameRing(id_text, *params);
+        } else if (method->text == "cancel") {
+            cancel(id_text, line, *params);
+        } else if (method->text == "metrics") {
+            reply(id_text, config_.options.metrics ? config_.options.metrics->json() : "{}");
+        } else if (method->text == "requirements") {
+            reply(id_text, FrameRequirementsJson(
+                               DescribeFrameRequirements(config_.options, !config_.reid_model_dir.empty())));
+        } else {
+            fail(id_text, kMethodNotFound, "Method not found: " + method->text);
+        }
+    }
+
+private:
+    struct TrackJob {
+        std::string id;  // JSON text, empty for a notification
+        Json params;
+        std::shared_ptr<std::atomic<bool>> stop;
+    };
+
+    // One frame to detect, answering every request for it that came while
+    // it waited or ran.
+    struct DetectJob {
+        std::vector<std::string> ids;  // JSON texts, empty ones for notifications
+        uint64_t key = 0;              // frame content and request options
+        bool preview = false;
+        std::string image;
+        int slot = -1;
+        RawStreamFormat format;
+    };
+
+    void reply(const std::string& id, const std::string& result) {
+        if (id.empty()) return;
+        send("{\"jsonrpc\": \"2.0\", \"id\": " + id + ", \"result\": " + result + "}");
+    }
+
+    void fail(const std::string& id, int code, const std::string& message) {
+        if (id.empty()) return;
+        std::string error;
+        AppendF(error, "{\"code\": %d, \"message\": ", code);
+        send("{\"jsonrpc\": \"2.0\", \"id\": " + id + ", \"error\": " + error + Quote(message) + "}}");
+    }
+
+    void work() {
+        for (;;) {
+            TrackJob job;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                cv_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                job = std::move(queue_.front());
+                queue_.pop_front();
+                running_ = &job;
+            }
+            track(job);
+            std::lock_guard<std::mutex> lock(mu_);
+            running_ = nullptr;
+        }
+    }
+
+    void track(const TrackJob& job) {
+        TrackInput input;
+        int code = 0;
+        std::string message;
+        if (!ParseTrackParams(job.params, config_, input, code, message)) {
+            fail(job.id, code, message);
+            return;
+        }
+        input.tuning.tracking.stop = job.stop;
+        const PipelineResult result = pipeline_.process(*input.source, input.video_fps, TrackSegmentSink{},
+                                                        input.tuning);
+        if (job.stop->load()) {
+            fail(job.id, kRequestCancelled, "Request cancelled");
+            return;
+        }
+        reply(job.id, TracksJson(result));
+    }
+
+    // Parse a detect request and hash its frame, on the reader's thread, so
+    // that equal frames meet before any of them is detected. A result in the
+    // cache is answered at once; a frame already queued or running takes the
+    // request along; a preview drops the previews still waiting.
+    void queueDetect(const std::string& id, const Json& params) {
+        DetectJob job;
+        job.ids.push_back(id);
+        const Json* preview = params.get("preview");
+        job.preview = preview && preview->type == Json::Type::Bool && preview->boolean;
+        DetectionCache::Hasher hasher;
+        const Json* image = params.get("image");
+        if (params.get("slot")) {
+            const Json* format_name = params.get("format");
+            if (!NumberParam(params, "slot", job.slot) || !NumberParam(params, "width", job.format.width) ||
+                !NumberParam(params, "height", job.format.height) ||
+                (format_name && (format_name->type != Json::Type::String ||
+                                 !ParseRawPixelFormat(format_name->text, job.format.format)))) {
+                fail(id, kInvalidParams, "slot, width and height must be numbers, format rgb24, bgra or nv12");
+                return;
+            }
+            std::lock_guard<std::mutex> lock(ring_mu_);
+            if (!ring_ || !ring_->slot(job.slot)) {
+                fail(id, kInvalidParams, "no such frame ring slot");
+                return;
+            }
+            const size_t bytes = job.format.frameBytes();
+            if (bytes == 0 || bytes > ring_->slotBytes()) {
+                fail(id, kInvalidParams, "the frame does not fit a slot");
+                return;
+            }
+            hasher.value(job.format.width);
+            hasher.value(job.format.height);
+            hasher.value(job.format.format);
+            hasher.bytes(ring_->slot(job.slot), bytes);
+        } else if (!image || image->type != Json::Type::String) {
+            fail(id, kInvalidParams, "detect needs image or slot");
+            return;
+        } else {
+            job.image = image->text;
+            if (!hasher.file(job.image)) {
+                fail(id, kServerError, "Failed to load image " + job.image);
+                return;
+            }
+        }
+        job.key = hasher.digest();
+
+        std::string cached;
+        std::vector<std::string> superseded;
+        bool coalesced = false;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            auto hit = detect_cache_index_.find(job.key);
+            if (hit != detect_cache_index_.end()) {
+                detect_cache_.splice(detect_cache_.begin(), detect_cache_, hit->second);
+                cached = hit->second->second;
+            } else {
+                if (job.preview) {
+                    for (auto it = detect_queue_.begin(); it != detect_queue_.end();) {
+                        if (!it->preview || it->key == job.key) {
+                            ++it;
+                            continue;
+                        }
+                        superseded.insert(superseded.end(), it->ids.begin(), it->ids.end());
+                        it = detect_queue_.erase(it);
+                    }
+                }
+                DetectJob* same = detect_running_ && detect_running_->key == job.key ? detect_running_ : nullptr;
+                for (auto it = detect_queue_.begin(); !same && it != detect_queue_.end(); ++it) {
+                    if (it->key == job.key) same = &*it;
+                }
+                if (same) {
+                    same->ids.push_back(id);
+                    same->preview = same->preview && job.preview;
+                    coalesced = true;
+                } else {
+                    detect_queue_.push_back(std::move(job));
+                    detect_cv_.notify_all();
+                }
+            }
+        }
+        if (MetricsRegistry* metrics = config_.options.metrics.get()) {
+            if (!cached.empty()) metrics->add("server.detectCacheHits");
+            if (coalesced) metrics->add("server.detectCoalesced");
+            if (!superseded.empty()) metrics->add("server.detectSuperseded", static_cast<int64_t>(superseded.size()));
+        }
+        for (const std::string& dropped : superseded) fail(dropped, kRequestCancelled, "Request superseded");
+        if (!cached.empty()) reply(id, cached);
+    }
+
+    void detectWork() {
+        for (;;) {
+            DetectJob job;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                detect_cv_.wait(lock, [this] { return closing_ || !detect_queue_.empty(); });
+                if (detect_queue_.empty()) return;
+                job = std::move(detect_queue_.front());
+                detect_queue_.pop_front();
+                detect_running_ = &job;
+            }
+            std::string result;
+            int code = 0;
+            std::string message;
+            const bool ok = detect(job, result, code, message);
+            std::vector<std::string> ids;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                detect_running_ = nullptr;
+                ids.swap(job.ids);
+                if (ok) {
+                    detect_cache_.emplace_front(job.key, result);
+                    detect_cache_index_[job.key] = detect_cache_.begin();
+                    if (detect_cache_.size() > kDetectCacheEntries) {
+                        detect_cache_index_.erase(detect_cache_.back().first);
+                        detect_cache_.pop_back();
+                    }
+                }
+            }
+            for (const std::string& id : ids) ok ? reply(id, result) : fail(id, code, message);
+        }
+    }
+
+    // Detection is thread-safe, so it runs beside a track in progress.
+    bool detect(const DetectJob& job, std::string& out, int& code, std::string& message) {
+        int width = 0;
+        int height = 0;
+        std::vector<Detection> faces;
+        if (job.slot >= 0) {
+            if (!detectSlot(job, faces, width, height)) {
+                code = kInvalidParams;
+                message = "the frame ring was replaced";
+                return false;
+            }
+        } else {
+            faces = pipeline_.detectSingle(job.image, width, height);
+            if (width <= 0) {
+                code = kServerError;
+                message = "Failed to load image " + job.image;
+                return false;
+            }
+        }
+        AppendF(out, "{\"width\": %d, \"height\": %d, \"faces\": [", width, height);
+        for (size_t k = 0; k < faces.size(); ++k) {
+            const Detection& d = faces[k];
+            AppendF(out, "%s{\"bbox\": [%.6f, %.6f, %.6f, %.6f], \"confidence\": %.4f}", k > 0 ? ", " : "",
+                    d.bbox.x1, d.bbox.y1, d.bbox.x2, d.bbox.y2, d.score);
+        }
+        out += "]}";
+        return true;
+    }
+
+    // A raw frame in a slot of the frame ring, checked when the request was
+    // read. The ring is held for the detection, so frameRing waits for it; a
+    // ring that has been replaced since may no longer have the slot.
+    bool detectSlot(const DetectJob& job, std::vector<Detection>& faces, int& width, int& height) {
+        std::lock_guard<std::mutex> lock(ring_mu_);
+        if (!ring_ || !ring_->slot(job.slot) || job.format.frameBytes() > ring_->slotBytes()) return false;
+        const uint8_t* px = ring_->slot(job.slot);
+        width = job.format.width;
+        height = job.format.height;
+        if (job.format.format == RawPixelFormat::RGB24) {
+            faces = pipeline_.detectRgb(px, width, height);
+        } else {
+            FillRawFrame(px, job.format, FrameRequest{}, slot_frame_);
+            faces = pipeline_.detectRgb(slot_frame_.rgbData(), slot_frame_.rgb_w, slot_frame_.rgb_h);
+        }
+        return true;
+    }
+
+    void frameRing(const std::string& id, const Json& params) {
+        int slots = 4;
+        double slot_bytes = 0.0;
+        if (!NumberParam(params, "slots", slots) || !NumberParam(params, "slotBytes", slot_bytes) ||
+            slots <= 0 || slot_bytes <= 0.0) {
+            fail(id, kInvalidParams, "frameRing needs slotBytes (and slots) as positive numbers");
+            return;
+        }
+        std::lock_guard<std::mutex> lock(ring_mu_);
+        ring_.reset();
+        std::string error;
+        ring_ = SharedFrameRing::Create(slots, static_cast<size_t>(slot_bytes), error);
+        if (!ring_) {
+            fail(id, kServerError, error);
+            return;
+        }
+        reply(id, "{\"name\": " + Quote(ring_->name()) + ", \"slots\": " + std::to_string(ring_->slots()) +
+                      ", \"slotBytes\": " + std::to_string(ring_->slotBytes()) + "}");
+    }
+
+    void cancel(const std::string& id, const std::string& line, const Json& params) {
+        const Json* target = params.get("id");
+        if (!target) {
+            fail(id, kInvalidParams, "cancel needs the id of a track or detect request");
+            return;
+        }
+        const std::string target_text = line.substr(target->begin, target->end - target->begin);
+        bool cancelled = false;
+        std::string dropped;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (running_ && running_->id == target_text) {
+                running_->stop->store(true);
+                cancelled = true;
+            }
+            for (auto it = queue_.begin(); !cancelled && it != queue_.end(); ++it) {
+                if (it->id != target_text) continue;
+                dropped = it->id;
+                queue_.erase(it);
+                cancelled = true;
+                break;
+            }
+            // A queued detect may be answering other requests too.
+            for (auto it = detect_queue_.begin(); !cancelled && it != detect_queue_.end(); ++it) {
+                auto own = std::find(it->ids.begin(), it->ids.end(), target_text);
+                if (own == it->ids.end()) continue;
+                dropped = *own;
+                it->ids.erase(own);
+                if (it->ids.empty()) detect_queue_.erase(it);
+                cancelled = true;
+                break;
+            }
+        }
+        if (!dropped.empty()) fail(dropped, kRequestCancelled, "Request cancelled");
+        reply(id, cancelled ? "{\"cancelled\": true}" : "{\"cancelled\": false}");
+    }
+
+    const ServerConfig& config_;
+    FILE* out_;
+    FacePipeline pipeline_;
+    std::mutex out_mu_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<TrackJob> queue_;
+    const TrackJob* running_ = nullptr;  // the worker's current job
+    bool closing_ = false;
+    std::condition_variable detect_cv_;
+    std::deque<DetectJob> detect_queue_;
+    DetectJob* detect_running_ = nullptr;  // the detect worker's current job
+    std::list<std::pair<uint64_t, std::string>> detect_cache_;  // results by key, most recent first
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, std::string>>::iterator> detect_cache_index_;
+    std::mutex ring_mu_;
+    std::unique_ptr<SharedFrameRing> ring_;  // "frameRing", replaced on the reader's thread
+    LoadedRgbFrame slot_frame_;             // RGB of the last non-RGB slot; detect worker only
+    std::thread worker_;  // declared last: they use the members above
+    std::thread detect_worker_;
+};
+}  // namespace
+
+bool RunServer(const ServerConfig& config, std::istream& in, FILE* out) {
+    Server server(config, out);
+    if (!server.loaded()) return false;
+    server.send("{\"jsonrpc\": \"2.0\", \"method\": \"ready\"}");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r\n") == std::string::npos) continue;
+        server.handle(line);
+    }
+    if (server.memoryBudget()) PrintMemoryReport(*server.memoryBudget());
+    return true;
+}
+
+int RunBatch(const ServerConfig& config, std::istream& manifest, int clip_workers, FILE* out, NumaPlacement numa) {
+    std::vector<std::string> clips;
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (line.find_first_not_of(" \t\r\n") != std::string::npos) clips.push_back(line);
+    }
+    const int parallel = std::max(1, std::min(static_cast<int>(clips.size()),
+                                              clip_workers > 0 ? clip_workers : ResolveClipWorkers()));
+
+    // Concurrent clips split the cores their stages would each size to;
+    // per-clip files the loaded options name would be written by every clip.
+    ServerConfig shared = config;
+    PipelineOptions& options = shared.options;
+    if (parallel > 1) {
+        if (options.decode_threads <= 0) {
+            options.decode_threads = std::max(1, FramePrefetcher::ResolveThreadCount(0) / parallel);
+        }
+        if (options.detect_workers <= 0 && DetectionScheduler::ResolveWorkerCount(0) / parallel >= 2) {
+            options.detect_workers = DetectionScheduler::ResolveWorkerCount(0) / parallel;
+        }
+        if (options.gmc_workers <= 0) {
+            options.gmc_workers = std::max(1, GmcStage::ResolveWorkerCount(0) / parallel);
+        }
+        if (options.detector.num_threads <= 0) {
+            const int detect_workers = DetectionScheduler::ResolveWorkerCount(options.detect_workers);
+            options.detector.num_threads = std::max(1, PipelineCoreCount() / (parallel * detect_workers));
+        }
+    }
+    if (!options.checkpoint_path.empty() || !options.dump_detections_path.empty()) {
+        fprintf(stderr, "Warning: --checkpoint and --dump-detections are per clip; not written in a batch\n");
+        options.checkpoint_path.clear();
+        options.dump_detections_path.clear();
+    }
+
+    const int nodes = numa == NumaPlacement::Off ? 1 : NumaNodeCount();
+    if (numa != NumaPlacement::Off && nodes < 2) {
+        fprintf(stderr, "Warning: --numa needs more than one NUMA node; running unpinned\n");
+    }
+    // A replica is set up on a thread of its node, so its weights and blob
+    // pools are first touched there. Files every pipeline writes back would
+    // be raced over, and the memory budget is split between the replicas.
+    int replicas = nodes > 1 && numa == NumaPlacement::Replicas ? nodes : 1;
+    if (replicas > 1 && (!options.detection_cache_path.empty() || !options.gallery_path.empty())) {
+        fprintf(stderr, "Warning: --numa replicas cannot share --detection-cache or --gallery; one model copy\n");
+        replicas = 1;
+    }
+    PipelineOptions replica_options = options;
+    if (replicas > 1 && replica_options.memory_budget_mb > 0) {
+        replica_options.memory_budget_mb = std::max(1, replica_options.memory_budget_mb / replicas);
+    }
+    std::vector<std::unique_ptr<FacePipeline>> pipelines(static_cast<size_t>(replicas));
+    auto load = [&](int node) {
+        pipelines[static_cast<size_t>(node)] = std::make_unique<FacePipeline>(
+            shared.model_dir, shared.conf_thresh, shared.detection_fps, shared.iou_thresh, shared.reid_model_dir,
+            shared.reid_weight, shared.reid_cos_thresh, replica_options);
+    };
+    if (replicas > 1) {
+        std::vector<std::thread> loaders;
+        for (int node = 0; node < replicas; ++node) {
+            loaders.emplace_back([&, node] {
+                BindThreadToNumaNode(node);
+                load(node);
+            });
+        }
+        for (std::thread& t : loaders) t.join();
+    } else {
+        load(0);
+    }
+    for (const auto& pipeline : pipelines) {
+        if (!pipeline->isLoaded()) return -1;
+    }
+
+    std::mutex out_mu;
+    std::atomic<int> failed{0};
+    auto report = [&](int clip, const std::string& fields) {
+        std::string text;
+        AppendF(text, "{\"clip\": %d, ", clip);
+        text += fields + "}\n";
+        std::lock_guard<std::mutex> lock(out_mu);
+        std::fputs(text.c_str(), out);
+        std::fflush(out);
+    };
+    auto fail = [&](int clip, const std::string& message) {
+        failed++;
+        report(clip, "\"error\": " + Quote(message));
+    };
+    auto run = [&](int c, FacePipeline& pipeline, int node) {
+        Json params;
+        if (!JsonParser(clips[c]).parse(params) || params.type != Json::Type::Object) {
+            fail(c, "not a JSON object");
+            return;
+        }
+        const Json* output = params.get("output");
+        if (!output || output->type != Json::Type::String) {
+            fail(c, "clip needs an output path");
+            return;
+        }
+        if (options.stop && options.stop->load()) {
+            fail(c, "stopped before it started");
+            return;
+        }
+        TrackInput input;
+        int code = 0;
+        std::string message;
+        if (!ParseTrackParams(params, shared, input, code, message)) {
+            fail(c, message);
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const PipelineResult result = pipeline.process(*input.source, input.video_fps, TrackSegmentSink{},
+                                                       input.tuning);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        const std::string json = TracksJson(result);
+        bool written = false;
+        if (FILE* f = std::fopen(output->text.c_str(), "w")) {
+            written = std::fputs(json.c_str(), f) >= 0 && std::fputc('\n', f) != EOF;
+            written = std::fclose(f) == 0 && written;
+        }
+        if (!written) {
+            fail(c, "cannot write " + output->text);
+            return;
+        }
+        std::string fields = "\"output\": " + Quote(output->text);
+        AppendF(fields, ", \"tracks\": %zu, \"frameCount\": %d, \"ms\": %.1f%s", result.tracks.size(),
+                result.frame_count, ms, result.stopped ? ", \"stopped\": true" : "");
+        if (node >= 0) AppendF(fields, ", \"node\": %d", node);
+        report(c, fields);
+    };
+    if (nodes > 1) {
+        // Clip workers dealt round-robin to the nodes. A clip runs on one
+        // node throughout: its stage threads inherit the worker's CPUs and
+        // fan out on that node's pool.
+        ThreadPool::UseNumaPools();
+        std::atomic<int> next{0};
+        std::vector<std::thread> workers;
+        for (int w = 0; w < parallel; ++w) {
+            const int node = w % nodes;
+            workers.emplace_back([&, node] {
+                BindThreadToNumaNode(node);
+                ConfigureWorkerThread();
+                FacePipeline& pipeline = *pipelines[static_cast<size_t>(replicas > 1 ? node : 0)];
+                for (int c; (c = next++) < static_cast<int>(clips.size());) run(c, pipeline, node);
+            });
+        }
+        for (std::thread& t : workers) t.join();
+    } else {
+        ThreadPool::Shared().parallelFor(static_cast<int>(clips.size()), parallel,
+                                         [&](int c) { run(c, *pipelines[0], -1); });
+    }
+    for (const auto& pipeline : pipelines) {
+        if (pipeline->memoryBudget()) PrintMemoryReport(*pipeline->memoryBudget());
+    }
+    return failed.load();
+}
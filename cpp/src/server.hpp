@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdio>
+#include <istream>
+#include <string>
+
+#include "numa.hpp"
+#include "pipeline.hpp"
+#include "video_source.hpp"
+
+/**
+ * What a server or batch loads once and runs every request with (--serve,
+ * --batch): the command line's model and pipeline settings.
+ */
+struct ServerConfig {
+    std::string model_dir;
+    float conf_thresh = 0.5f;
+    float detection_fps = 5.0f;
+    float iou_thresh = 0.15f;
+    std::string reid_model_dir;
+    float reid_weight = 0.35f;
+    float reid_cos_thresh = 0.35f;
+    float video_fps = 30.0f;  // of image lists and videos whose container does not say
+    PipelineOptions options;
+    VideoHwAccel video_hwaccel = VideoHwAccel::Auto;
+    bool video_motion_vectors = false;  // see VideoFrameSource
+};
+
+/**
+ * Long-lived pipeline process: the models, thread pools and detection
+ * cache stay loaded between runs.
+ *
+ * Requests and responses are JSON-RPC 2.0 objects, one per line, read from
+ * `in` and written to `out`. Once the models are loaded the server sends
+ * {"jsonrpc": "2.0", "method": "ready"}. Methods:
+ *
+ *   track   params: "images" (array of paths), "imagesFile" (one path a
+ *           line) or "video"; optionally "videoFps", "detectionFps",
+ *           "iouThresh", "reidWeight", "reidCosThresh", "trackMaxAge",
+ *           "trackTentativeAge", "trackDormantAge", "trackInertia",
+ *           "smoothLag", "keyframeTolerance", "timeBudget" for this run,
+ *           and "cuts" (frames the editor cut to, as --cuts).
+ *           result: {"tracks": [...], "frameCount": n} as with --track,
+ *           plus "stopped": true if the time budget ran out.
+ *   detect  params: "image", or "slot" of the frame ring with the raw
+ *           frame's "width", "height" and "format" ("rgb24" (default),
+ *           "bgra", "nv12"), and "preview": true for a request a newer
+ *           preview may replace (scrubbing). result: {"width", "height",
+ *           "faces": [{"bbox": [x1, y1, x2, y2] (normalized),
+ *           "confidence"}]}.
+ *   frameRing  params: "slotBytes", optionally "slots" (default 4).
+ *           Creates the shared memory that detect's slots are in (see
+ *           SharedFrameRing), replacing an earlier one. result: {"name",
+ *           "slots", "slotBytes" (rounded up to pages)}.
+ *   cancel  params: "id" of a track or queued detect request. result:
+ *           {"cancelled": bool}.
+ *   metrics result: the statistics of every run so far (see
+ *           MetricsRegistry::json; {} without PipelineOptions::metrics).
+ *   requirements  result: the frames the loaded settings need, as with
+ *           --describe-requirements (see DescribeFrameRequirements).
+ *
+ * Track requests run one at a time, in order, on a thread of their own, and
+ * detect requests likewise on another; frameRing, cancel, metrics and
+ * requirements are answered at once, also while those run. Detect requests
+ * are keyed by a hash of the frame (the image file's bytes, or the slot's
+ * size, format and pixels; the detector settings are the server's): a
+ * frame among the last 256 detected is answered from them, and requests for
+ * a frame already queued or being detected share its result. A preview
+ * detect drops the earlier previews still queued, so scrubbing never waits
+ * for frames the panel has moved past. A cancelled track or detect request,
+ * and a superseded preview, gets error -32800. At end of input the server
+ * finishes the queued requests and returns.
+ *
+ * @return false if the models cannot be loaded
+ */
+bool RunServer(const ServerConfig& config, std::istream& in, FILE* out);
+
+/**
+ * Batch of clips tracked by one process (--batch): the models, the thread
+ * pool and the detection cache are loaded once and shared, and up to
+ * `clip_workers` clips (0 = auto) run at once, their stages' thread quotas
+ * split between them.
+ *
+ * The manifest holds one JSON object a line: the params of a track request
+ * (see RunServer) plus "output", the file the clip's result goes to. Each
+ * finished clip is reported on `out` as a JSON line, {"clip": k (from 0),
+ * "output", "tracks", "frameCount", "ms"} or {"clip": k, "error"}.
+ * Once PipelineOptions::stop is set, running clips end early and the rest
+ * are not started.
+ *
+ * With `numa` on a machine of several nodes, the clip workers are dealt
+ * round-robin to the nodes and bound there; each clip runs on one node, its
+ * stage threads on that node's CPUs and pool, and reports its "node".
+ * NumaPlacement::Replicas also loads the models once per node (not with a
+ * detection cache or gallery file, which every copy would write), the
+ * memory budget split between them.
+ *
+ * @return number of clips that failed, -1 if the models cannot be loaded
+ */
+int RunBatch(const ServerConfig& config, std::istream& manifest, int clip_workers, FILE* out,
+             NumaPlacement numa = NumaPlacement::Off);
@@ -0,0 +1,91 @@
+#include "shared_frames.hpp"
+
+#include <atomic>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr size_t kPageBytes = 4096;
+
+// Unique per process and ring, so a server can replace its ring and
+// several servers can run side by side.
+std::string SegmentName() {
+    static std::atomic<int> next{0};
+    char buf[64];
+#ifdef _WIN32
+    std::snprintf(buf, sizeof(buf), "Local\\face_pipeline-%lu-%d", static_cast<unsigned long>(GetCurrentProcessId()),
+                  next++);
+#else
+    std::snprintf(buf, sizeof(buf), "/face_pipeline-%ld-%d", static_cast<long>(::getpid()), next++);
+#endif
+    return buf;
+}
+}  // namespace
+
+std::unique_ptr<SharedFrameRing> SharedFrameRing::Create(int slots, size_t slot_bytes, std::string& error) {
+    if (slots <= 0 || slot_bytes == 0) {
+        error = "a frame ring needs at least one slot of at least one byte";
+        return nullptr;
+    }
+    std::unique_ptr<SharedFrameRing> ring(new SharedFrameRing());
+    ring->name_ = SegmentName();
+    ring->slots_ = slots;
+    ring->slot_bytes_ = (slot_bytes + kPageBytes - 1) / kPageBytes * kPageBytes;
+    const uint64_t total = static_cast<uint64_t>(ring->slot_bytes_) * static_cast<uint64_t>(slots);
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(total >> 32),
+                                        static_cast<DWORD>(total & 0xffffffffu), ring->name_.c_str());
+    if (!mapping || GetLastError() == ERROR_ALREADY_EXISTS) {
+        if (mapping) CloseHandle(mapping);
+        error = "cannot create shared memory " + ring->name_;
+        return nullptr;
+    }
+    ring->mapping_ = mapping;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        error = "cannot map shared memory " + ring->name_;
+        return nullptr;
+    }
+    ring->data_ = static_cast<uint8_t*>(view);
+#else
+    const int fd = ::shm_open(ring->name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        error = "cannot create shared memory " + ring->name_;
+        return nullptr;
+    }
+    void* addr = MAP_FAILED;
+    if (::ftruncate(fd, static_cast<off_t>(total)) == 0) {
+        addr = ::mmap(nullptr, static_cast<size_t>(total), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);  // the mapping keeps the segment
+    if (addr == MAP_FAILED) {
+        ::shm_unlink(ring->name_.c_str());
+        error = "cannot map shared memory " + ring->name_;
+        return nullptr;
+    }
+    ring->data_ = static_cast<uint8_t*>(addr);
+#endif
+    return ring;
+}
+
+SharedFrameRing::~SharedFrameRing() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(static_cast<HANDLE>(mapping_));
+#else
+    if (data_) {
+        ::munmap(data_, slot_bytes_ * static_cast<size_t>(slots_));
+        ::shm_unlink(name_.c_str());
+    }
+#endif
+}
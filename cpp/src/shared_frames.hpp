@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Frames handed to a server through shared memory instead of files
+ * (the "frameRing" request of RunServer).
+ *
+ * The server creates a named segment of `slots` equal slots: POSIX shared
+ * memory, or a file mapping on Windows. A producer opens it by name,
+ * writes one raw frame (packed as with --raw-input: rgb24, bgra or nv12)
+ * into a slot, and sends the slot's index on the control channel. A slot is
+ * the producer's to write again once the request reading it is answered;
+ * the server never writes to the segment.
+ */
+class SharedFrameRing {
+public:
+    /**
+     * @param slot_bytes Capacity of each slot, rounded up to whole pages
+     * @return nullptr (with `error`) if the segment cannot be created
+     */
+    static std::unique_ptr<SharedFrameRing> Create(int slots, size_t slot_bytes, std::string& error);
+    ~SharedFrameRing();
+
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+    /** What producers open: a shm_open name, or a file mapping name on Windows. */
+    const std::string& name() const { return name_; }
+    int slots() const { return slots_; }
+    size_t slotBytes() const { return slot_bytes_; }
+
+    /** Start of slot `index` (nullptr if there is none). */
+    const uint8_t* slot(int index) const {
+        return index >= 0 && index < slots_ ? data_ + static_cast<size_t>(index) * slot_bytes_ : nullptr;
+    }
+
+private:
+    SharedFrameRing() = default;
+
+    std::string name_;
+    int slots_ = 0;
+    size_t slot_bytes_ = 0;
+    uint8_t* data_ = nullptr;
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
@@ -0,0 +1,1072 @@
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define FACE_PIPELINE_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__aarch64__)
+#define FACE_PIPELINE_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+// u16 lane accumulators are flushed before they can overflow (256 * 255 < 65536).
+constexpr int kShiftSadChunk = 256;
+
+inline int AbsDiff(uint8_t a, uint8_t b) { return a > b ? a - b : b - a; }
+
+// ---------------------------------------------------------------------------
+// Scalar reference versions. The others must produce the same results.
+
+void ShiftSadScalar(const uint8_t* prev_row, const uint8_t* curr_row,
+                    int x0, int step, int count, uint32_t* acc) {
+    for (int k = 0; k < count; ++k) {
+        const int x = x0 + k * step;
+        const uint8_t p = prev_row[x];
+        const uint8_t* c = curr_row + x - kShiftSadRadius;
+        for (int s = 0; s < kShiftSadCount; ++s) acc[s] += static_cast<uint32_t>(AbsDiff(p, c[s]));
+    }
+}
+
+void BlockSadScalar(const uint8_t* a, const uint8_t* b, int n, uint32_t* sums) {
+    for (int i = 0; i < n; ++i) sums[i >> 4] += static_cast<uint32_t>(AbsDiff(a[i], b[i]));
+}
+
+double DotScalar(const float* a, const float* b, int n) {
+    double dot = 0.0;
+    for (int i = 0; i < n; ++i) dot += static_cast<double>(a[i]) * static_cast<double>(b[i]);
+    return dot;
+}
+
+int32_t DotI8Scalar(const int8_t* a, const int8_t* b, int n) {
+    int32_t dot = 0;
+    for (int i = 0; i < n; ++i) dot += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    return dot;
+}
+
+void LumaScalar(const uint8_t* rgb, int n, float* out) {
+    for (int i = 0; i < n; ++i) {
+        const uint8_t* px = rgb + static_cast<size_t>(i) * 3u;
+        out[i] = 0.299f * px[0] + 0.587f * px[1] + 0.114f * px[2];
+    }
+}
+
+// One output pixel of the warp. Off the image edge the coordinates are
+// clamped; inside it the clamps are no-ops and are skipped.
+inline void WarpPixelScalar(const uint8_t* src, int w, int h, float x, float y, uint8_t* out) {
+    int x0, y0, x1, y1;
+    if (x >= 0.0f && x < static_cast<float>(w - 1) && y >= 0.0f && y < static_cast<float>(h - 1)) {
+        x0 = static_cast<int>(x);
+        y0 = static_cast<int>(y);
+        x1 = x0 + 1;
+        y1 = y0 + 1;
+    } else {
+        x = std::max(0.0f, std::min(static_cast<float>(w - 1), x));
+        y = std::max(0.0f, std::min(static_cast<float>(h - 1), y));
+        x0 = static_cast<int>(std::floor(x));
+        y0 = static_cast<int>(std::floor(y));
+        x1 = std::min(x0 + 1, w - 1);
+        y1 = std::min(y0 + 1, h - 1);
+    }
+    const float dx = x - static_cast<float>(x0);
+    const float dy = y - static_cast<float>(y0);
+    const uint8_t* p00 = src + (static_cast<size_t>(y0) * w + x0) * 3u;
+    const uint8_t* p10 = src + (static_cast<size_t>(y0) * w + x1) * 3u;
+    const uint8_t* p01 = src + (static_cast<size_t>(y1) * w + x0) * 3u;
+    const uint8_t* p11 = src + (static_cast<size_t>(y1) * w + x1) * 3u;
+    for (int c = 0; c < 3; ++c) {
+        const float v00 = static_cast<float>(p00[c]);
+        const float v10 = static_cast<float>(p10[c]);
+        const float v01 = static_cast<float>(p01[c]);
+        const float v11 = static_cast<float>(p11[c]);
+        const float v0 = v00 + (v10 - v00) * dx;
+        const float v1 = v01 + (v11 - v01) * dx;
+        const float v = v0 + (v1 - v0) * dy;
+        out[c] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, v)));
+    }
+}
+
+void WarpRowScalar(const uint8_t* src, int w, int h, const float* m, int v, int u0, int u1, uint8_t* dst) {
+    const float vf = static_cast<float>(v);
+    for (int u = u0; u < u1; ++u) {
+        const float uf = static_cast<float>(u);
+        const float x = m[0] * uf + m[1] * vf + m[2];
+        const float y = m[3] * uf + m[4] * vf + m[5];
+        WarpPixelScalar(src, w, h, x, y, dst + static_cast<size_t>(u) * 3u);
+    }
+}
+
+// One row of ComputeLumaPlaneStats(). `up` / `down` are null on the first / last row.
+void LumaStatsRowScalar(const float* row, const float* up, const float* down, int w, LumaPlaneStats& s) {
+    for (int x = 0; x < w; ++x) {
+        s.sum += row[x];
+        if (x + 1 < w) s.grad_sum += std::abs(row[x + 1] - row[x]);
+        if (down) s.grad_sum += std::abs(down[x] - row[x]);
+    }
+    if (!up || !down) return;
+    for (int x = 1; x < w - 1; ++x) {
+        const float lap = 4.0f * row[x] - up[x] - down[x] - row[x - 1] - row[x + 1];
+        s.lap_sum += static_cast<double>(lap);
+        s.lap_sum_sq += static_cast<double>(lap) * static_cast<double>(lap);
+    }
+}
+
+// One output row of BoxBlurColumnsU8(): out = (acc + half) * mul >> 16,
+// then the window moves down a row (acc += add - sub).
+void BoxStepScalar(uint16_t* acc, const uint8_t* add, const uint8_t* sub, int n, uint16_t half, uint16_t mul,
+                   uint8_t* out) {
+    for (int i = 0; i < n; ++i) {
+        out[i] = static_cast<uint8_t>((static_cast<uint32_t>(static_cast<uint16_t>(acc[i] + half)) * mul) >> 16);
+        acc[i] = static_cast<uint16_t>(acc[i] + add[i] - sub[i]);
+    }
+}
+
+// Abramowitz & Stegun 4.4.46: acos(x) = sqrt(1 - x) * poly(x) on [0, 1],
+// |error| <= 2e-8 (float rounding dominates). Negative x use
+// acos(x) = pi - acos(-x).
+constexpr float kAcos0 = 1.5707963050f, kAcos1 = -0.2145988016f, kAcos2 = 0.0889789874f,
+                kAcos3 = -0.0501743046f, kAcos4 = 0.0308918810f, kAcos5 = -0.0170881256f,
+                kAcos6 = 0.0066700901f, kAcos7 = -0.0012624911f;
+constexpr float kOcmPi = 3.14159265358979323846f;
+
+// OcmAngleCosts() of one pair, in the order the vector versions evaluate it.
+inline float OcmAngleCostScalar(float dx, float dy, float ix, float iy, float weight, float inertia) {
+    const float norm = std::sqrt(dx * dx + dy * dy) + 1e-6f;
+    const float c = std::max(-1.0f, std::min(1.0f, ix * (dx / norm) + iy * (dy / norm)));
+    const float a = std::abs(c);
+    float p = kAcos7 * a + kAcos6;
+    p = p * a + kAcos5;
+    p = p * a + kAcos4;
+    p = p * a + kAcos3;
+    p = p * a + kAcos2;
+    p = p * a + kAcos1;
+    p = p * a + kAcos0;
+    const float r = std::sqrt(1.0f - a) * p;
+    const float angle = c < 0.0f ? kOcmPi - r : r;
+    return (kOcmPi / 2.0f - angle) / kOcmPi * inertia * weight;
+}
+
+void OcmAngleCostsScalar(const float* dx, const float* dy, const float* ix, const float* iy, const float* weight,
+                         int n, float inertia, float* out) {
+    for (int i = 0; i < n; ++i) out[i] = OcmAngleCostScalar(dx[i], dy[i], ix[i], iy[i], weight[i], inertia);
+}
+
+#if defined(FACE_PIPELINE_SIMD_X86)
+// ---------------------------------------------------------------------------
+// x86-64: SSE2 is the baseline; wider versions only run after the CPUID check.
+
+// Shifts -8..+7 of one sample. The +8 shift is added separately.
+inline __m128i ShiftAbsDiff16(uint8_t p, const uint8_t* c) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+    const __m128i pv = _mm_set1_epi8(static_cast<char>(p));
+    return _mm_or_si128(_mm_subs_epu8(v, pv), _mm_subs_epu8(pv, v));
+}
+
+inline void FlushShiftSad16(__m128i lo, __m128i hi, uint32_t* acc) {
+    alignas(16) uint16_t lanes[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), lo);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 8), hi);
+    for (int s = 0; s < 16; ++s) acc[s] += lanes[s];
+}
+
+void ShiftSadSse2(const uint8_t* prev_row, const uint8_t* curr_row,
+                  int x0, int step, int count, uint32_t* acc) {
+    const __m128i zero = _mm_setzero_si128();
+    for (int k0 = 0; k0 < count; k0 += kShiftSadChunk) {
+        const int k1 = count - k0 < kShiftSadChunk ? count : k0 + kShiftSadChunk;
+        __m128i lo = zero;
+        __m128i hi = zero;
+        uint32_t last = 0;
+        for (int k = k0; k < k1; ++k) {
+            const int x = x0 + k * step;
+            const uint8_t p = prev_row[x];
+            const __m128i d = ShiftAbsDiff16(p, curr_row + x - kShiftSadRadius);
+            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(d, zero));
+            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(d, zero));
+            last += static_cast<uint32_t>(AbsDiff(p, curr_row[x + kShiftSadRadius]));
+        }
+        FlushShiftSad16(lo, hi, acc);
+        acc[kShiftSadCount - 1] += last;
+    }
+}
+
+void BlockSadSse2(const uint8_t* a, const uint8_t* b, int n, uint32_t* sums) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i s = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        sums[i >> 4] += static_cast<uint32_t>(_mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4));
+    }
+    BlockSadScalar(a + i, b + i, n - i, sums + (i >> 4));
+}
+
+double DotSse2(const float* a, const float* b, int n) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 va = _mm_loadu_ps(a + i);
+        const __m128 vb = _mm_loadu_ps(b + i);
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_cvtps_pd(va), _mm_cvtps_pd(vb)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(va, va)), _mm_cvtps_pd(_mm_movehl_ps(vb, vb))));
+    }
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, _mm_add_pd(acc0, acc1));
+    return lanes[0] + lanes[1] + DotScalar(a + i, b + i, n - i);
+}
+
+// Sign-extend the low / high 8 bytes of `v` to 16-bit lanes.
+inline __m128i WidenLoI8(__m128i v) { return _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8); }
+inline __m128i WidenHiI8(__m128i v) { return _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8); }
+
+int32_t DotI8Sse2(const int8_t* a, const int8_t* b, int n) {
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(WidenLoI8(va), WidenLoI8(vb)));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(WidenHiI8(va), WidenHiI8(vb)));
+    }
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + DotI8Scalar(a + i, b + i, n - i);
+}
+
+// Byte shuffles gathering R, G and B of four pixels (12 bytes) into 32-bit lanes.
+#define LUMA_SHUFFLE(c) \
+    (c), -1, -1, -1, (c) + 3, -1, -1, -1, (c) + 6, -1, -1, -1, (c) + 9, -1, -1, -1
+
+void BoxStepSse2(uint16_t* acc, const uint8_t* add, const uint8_t* sub, int n, uint16_t half, uint16_t mul,
+                 uint8_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i hv = _mm_set1_epi16(static_cast<short>(half));
+    const __m128i mv = _mm_set1_epi16(static_cast<short>(mul));
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i + 8));
+        const __m128i o = _mm_packus_epi16(_mm_mulhi_epu16(_mm_add_epi16(lo, hv), mv),
+                                           _mm_mulhi_epu16(_mm_add_epi16(hi, hv), mv));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), o);
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i));
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i));
+        lo = _mm_sub_epi16(_mm_add_epi16(lo, _mm_unpacklo_epi8(a, zero)), _mm_unpacklo_epi8(s, zero));
+        hi = _mm_sub_epi16(_mm_add_epi16(hi, _mm_unpackhi_epi8(a, zero)), _mm_unpackhi_epi8(s, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i + 8), hi);
+    }
+    BoxStepScalar(acc + i, add + i, sub + i, n - i, half, mul, out + i);
+}
+
+void OcmAngleCostsSse2(const float* dx, const float* dy, const float* ix, const float* iy, const float* weight,
+                       int n, float inertia, float* out) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 neg_one = _mm_set1_ps(-1.0f);
+    const __m128 eps = _mm_set1_ps(1e-6f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 pi = _mm_set1_ps(kOcmPi);
+    const __m128 half_pi = _mm_set1_ps(kOcmPi / 2.0f);
+    const __m128 iv = _mm_set1_ps(inertia);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 x = _mm_loadu_ps(dx + i);
+        const __m128 y = _mm_loadu_ps(dy + i);
+        const __m128 norm = _mm_add_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))), eps);
+        const __m128 dot = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ix + i), _mm_div_ps(x, norm)),
+                                      _mm_mul_ps(_mm_loadu_ps(iy + i), _mm_div_ps(y, norm)));
+        const __m128 c = _mm_max_ps(neg_one, _mm_min_ps(one, dot));
+        const __m128 a = _mm_andnot_ps(sign, c);
+        __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(kAcos7), a), _mm_set1_ps(kAcos6));
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(kAcos5));
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(kAcos4));
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(kAcos3));
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(kAcos2));
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(kAcos1));
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(kAcos0));
+        const __m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(one, a)), p);
+        const __m128 neg = _mm_cmplt_ps(c, _mm_setzero_ps());
+        const __m128 angle = _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(pi, r)), _mm_andnot_ps(neg, r));
+        const __m128 cost = _mm_mul_ps(_mm_div_ps(_mm_sub_ps(half_pi, angle), pi), iv);
+        _mm_storeu_ps(out + i, _mm_mul_ps(cost, _mm_loadu_ps(weight + i)));
+    }
+    OcmAngleCostsScalar(dx + i, dy + i, ix + i, iy + i, weight + i, n - i, inertia, out + i);
+}
+
+SIMD_TARGET("sse4.1")
+void LumaSse41(const uint8_t* rgb, int n, float* out) {
+    const __m128i sr = _mm_setr_epi8(LUMA_SHUFFLE(0));
+    const __m128i sg = _mm_setr_epi8(LUMA_SHUFFLE(1));
+    const __m128i sb = _mm_setr_epi8(LUMA_SHUFFLE(2));
+    const __m128 kr = _mm_set1_ps(0.299f);
+    const __m128 kg = _mm_set1_ps(0.587f);
+    const __m128 kb = _mm_set1_ps(0.114f);
+    int i = 0;
+    // Each 16-byte load covers 4 pixels plus 4 bytes of the next ones.
+    for (; i + 6 <= n; i += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + static_cast<size_t>(i) * 3u));
+        const __m128 r = _mm_cvtepi32_ps(_mm_shuffle_epi8(v, sr));
+        const __m128 g = _mm_cvtepi32_ps(_mm_shuffle_epi8(v, sg));
+        const __m128 b = _mm_cvtepi32_ps(_mm_shuffle_epi8(v, sb));
+        // Same operation order as the scalar code, so the result is bit-identical.
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(kr, r), _mm_mul_ps(kg, g)), _mm_mul_ps(kb, b)));
+    }
+    LumaScalar(rgb + static_cast<size_t>(i) * 3u, n - i, out + i);
+}
+
+SIMD_TARGET("avx2")
+void ShiftSadAvx2(const uint8_t* prev_row, const uint8_t* curr_row,
+                  int x0, int step, int count, uint32_t* acc) {
+    // Two samples per iteration, one per 128-bit lane.
+    const __m256i zero = _mm256_setzero_si256();
+    for (int k0 = 0; k0 < count; k0 += kShiftSadChunk) {
+        const int k1 = count - k0 < kShiftSadChunk ? count : k0 + kShiftSadChunk;
+        __m256i lo = zero;
+        __m256i hi = zero;
+        uint32_t last = 0;
+        int k = k0;
+        for (; k + 2 <= k1; k += 2) {
+            const int xa = x0 + k * step;
+            const int xb = xa + step;
+            const uint8_t pa = prev_row[xa];
+            const uint8_t pb = prev_row[xb];
+            const __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(curr_row + xa - kShiftSadRadius))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr_row + xb - kShiftSadRadius)), 1);
+            const __m256i pv = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi8(static_cast<char>(pa))),
+                                                       _mm_set1_epi8(static_cast<char>(pb)), 1);
+            const __m256i d = _mm256_or_si256(_mm256_subs_epu8(v, pv), _mm256_subs_epu8(pv, v));
+            lo = _mm256_add_epi16(lo, _mm256_unpacklo_epi8(d, zero));
+            hi = _mm256_add_epi16(hi, _mm256_unpackhi_epi8(d, zero));
+            last += static_cast<uint32_t>(AbsDiff(pa, curr_row[xa + kShiftSadRadius]));
+            last += static_cast<uint32_t>(AbsDiff(pb, curr_row[xb + kShiftSadRadius]));
+        }
+        __m128i lo128 = _mm_add_epi16(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1));
+        __m128i hi128 = _mm_add_epi16(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1));
+        for (; k < k1; ++k) {
+            const int x = x0 + k * step;
+            const uint8_t p = prev_row[x];
+            const __m128i d = ShiftAbsDiff16(p, curr_row + x - kShiftSadRadius);
+            lo128 = _mm_add_epi16(lo128, _mm_unpacklo_epi8(d, _mm_setzero_si128()));
+            hi128 = _mm_add_epi16(hi128, _mm_unpackhi_epi8(d, _mm_setzero_si128()));
+            last += static_cast<uint32_t>(AbsDiff(p, curr_row[x + kShiftSadRadius]));
+        }
+        FlushShiftSad16(lo128, hi128, acc);
+        acc[kShiftSadCount - 1] += last;
+    }
+}
+
+SIMD_TARGET("avx2")
+void BlockSadAvx2(const uint8_t* a, const uint8_t* b, int n, uint32_t* sums) {
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        // One 64-bit partial sum per 8 bytes; blocks are lanes {0,1} and {2,3}.
+        const __m256i s = _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), s);
+        sums[i >> 4] += static_cast<uint32_t>(lanes[0] + lanes[1]);
+        sums[(i >> 4) + 1] += static_cast<uint32_t>(lanes[2] + lanes[3]);
+    }
+    BlockSadSse2(a + i, b + i, n - i, sums + (i >> 4));
+}
+
+SIMD_TARGET("avx2")
+double DotAvx2(const float* a, const float* b, int n) {
+    // Separate multiply and add: no FMA, matching the other paths' rounding.
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + i)),
+                                                 _mm256_cvtps_pd(_mm_loadu_ps(b + i))));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + i + 4)),
+                                                 _mm256_cvtps_pd(_mm_loadu_ps(b + i + 4))));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + DotScalar(a + i, b + i, n - i);
+}
+
+SIMD_TARGET("avx2")
+int32_t DotI8Avx2(const int8_t* a, const int8_t* b, int n) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        const __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    alignas(32) int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int32_t dot = 0;
+    for (int k = 0; k < 8; ++k) dot += lanes[k];
+    return dot + DotI8Scalar(a + i, b + i, n - i);
+}
+
+SIMD_TARGET("avx2")
+void LumaAvx2(const uint8_t* rgb, int n, float* out) {
+    const __m256i sr = _mm256_setr_epi8(LUMA_SHUFFLE(0), LUMA_SHUFFLE(0));
+    const __m256i sg = _mm256_setr_epi8(LUMA_SHUFFLE(1), LUMA_SHUFFLE(1));
+    const __m256i sb = _mm256_setr_epi8(LUMA_SHUFFLE(2), LUMA_SHUFFLE(2));
+    const __m256 kr = _mm256_set1_ps(0.299f);
+    const __m256 kg = _mm256_set1_ps(0.587f);
+    const __m256 kb = _mm256_set1_ps(0.114f);
+    int i = 0;
+    // Pixels 0-3 in the low lane, 4-7 in the high lane; the high load ends 4 bytes past pixel 7.
+    for (; i + 10 <= n; i += 8) {
+        const uint8_t* p = rgb + static_cast<size_t>(i) * 3u;
+        const __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+        const __m256 r = _mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, sr));
+        const __m256 g = _mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, sg));
+        const __m256 b = _mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, sb));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(kr, r), _mm256_mul_ps(kg, g)),
+                                                _mm256_mul_ps(kb, b)));
+    }
+    LumaSse41(rgb + static_cast<size_t>(i) * 3u, n - i, out + i);
+}
+
+#undef LUMA_SHUFFLE
+
+// Blend one channel of eight pixels; same operation order as WarpPixelScalar.
+SIMD_TARGET("avx2")
+inline __m256i WarpBlendAvx2(__m256i g00, __m256i g10, __m256i g01, __m256i g11,
+                             int shift, __m256 dx, __m256 dy) {
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256 v00 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(g00, shift), mask));
+    const __m256 v10 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(g10, shift), mask));
+    const __m256 v01 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(g01, shift), mask));
+    const __m256 v11 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(g11, shift), mask));
+    const __m256 v0 = _mm256_add_ps(v00, _mm256_mul_ps(_mm256_sub_ps(v10, v00), dx));
+    const __m256 v1 = _mm256_add_ps(v01, _mm256_mul_ps(_mm256_sub_ps(v11, v01), dx));
+    const __m256 v = _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), dy));
+    const __m256 c = _mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(_mm256_set1_ps(255.0f), v));
+    return _mm256_cvttps_epi32(c);
+}
+
+// Eight pixels at a time with 32-bit gathers of the four neighbours. A
+// gather reads one byte past the pixel, so the vector path also needs
+// x < w - 2; any lane outside that goes through the scalar pixel instead.
+SIMD_TARGET("avx2")
+void WarpRowAvx2(const uint8_t* src, int w, int h, const float* m, int v, int u0, int u1, uint8_t* dst) {
+    const float vf = static_cast<float>(v);
+    const __m256 m0 = _mm256_set1_ps(m[0]);
+    const __m256 m3 = _mm256_set1_ps(m[3]);
+    const __m256 row_x = _mm256_set1_ps(m[1] * vf);
+    const __m256 row_y = _mm256_set1_ps(m[4] * vf);
+    const __m256 m2 = _mm256_set1_ps(m[2]);
+    const __m256 m5 = _mm256_set1_ps(m[5]);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 x_max = _mm256_set1_ps(static_cast<float>(w - 2));
+    const __m256 y_max = _mm256_set1_ps(static_cast<float>(h - 1));
+    const __m256i stride = _mm256_set1_epi32(w * 3);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i width = _mm256_set1_epi32(w);
+    const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    // Packs the low byte of R, G and B lanes (RGB in bytes 0-2) into 12 bytes per half.
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    int u = u0;
+    for (; u + 8 <= u1; u += 8) {
+        const __m256 uf = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(u)), lane);
+        const __m256 x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, uf), row_x), m2);
+        const __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m3, uf), row_y), m5);
+        const __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_GE_OQ), _mm256_cmp_ps(x, x_max, _CMP_LT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_GE_OQ), _mm256_cmp_ps(y, y_max, _CMP_LT_OQ)));
+        if (_mm256_movemask_ps(inside) != 0xff) {
+            WarpRowScalar(src, w, h, m, v, u, u + 8, dst);
+            continue;
+        }
+        const __m256i xi = _mm256_cvttps_epi32(x);
+        const __m256i yi = _mm256_cvttps_epi32(y);
+        const __m256 dx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(xi));
+        const __m256 dy = _mm256_sub_ps(y, _mm256_cvtepi32_ps(yi));
+        const __m256i i00 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(yi, width), xi), three);
+        const __m256i i10 = _mm256_add_epi32(i00, three);
+        const __m256i i01 = _mm256_add_epi32(i00, stride);
+        const __m256i i11 = _mm256_add_epi32(i01, three);
+        const int* base = reinterpret_cast<const int*>(src);
+        const __m256i g00 = _mm256_i32gather_epi32(base, i00, 1);
+        const __m256i g10 = _mm256_i32gather_epi32(base, i10, 1);
+        const __m256i g01 = _mm256_i32gather_epi32(base, i01, 1);
+        const __m256i g11 = _mm256_i32gather_epi32(base, i11, 1);
+        const __m256i r = WarpBlendAvx2(g00, g10, g01, g11, 0, dx, dy);
+        const __m256i g = WarpBlendAvx2(g00, g10, g01, g11, 8, dx, dy);
+        const __m256i b = WarpBlendAvx2(g00, g10, g01, g11, 16, dx, dy);
+        const __m256i rgb = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+        alignas(32) uint8_t packed[32];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(packed), _mm256_shuffle_epi8(rgb, pack));
+        uint8_t* out = dst + static_cast<size_t>(u) * 3u;
+        std::memcpy(out, packed, 12);
+        std::memcpy(out + 12, packed + 16, 12);
+    }
+    WarpRowScalar(src, w, h, m, v, u, u1, dst);
+}
+
+SIMD_TARGET("avx2")
+void BoxStepAvx2(uint16_t* acc, const uint8_t* add, const uint8_t* sub, int n, uint16_t half, uint16_t mul,
+                 uint8_t* out) {
+    const __m256i hv = _mm256_set1_epi16(static_cast<short>(half));
+    const __m256i mv = _mm256_set1_epi16(static_cast<short>(mul));
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i + 16));
+        // packus works per 128-bit lane; the permute puts the bytes back in order.
+        const __m256i o = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(_mm256_mulhi_epu16(_mm256_add_epi16(lo, hv), mv),
+                                _mm256_mulhi_epu16(_mm256_add_epi16(hi, hv), mv)),
+            0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), o);
+        const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i));
+        const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i + 16));
+        const __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i));
+        const __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i + 16));
+        lo = _mm256_sub_epi16(_mm256_add_epi16(lo, _mm256_cvtepu8_epi16(a0)), _mm256_cvtepu8_epi16(s0));
+        hi = _mm256_sub_epi16(_mm256_add_epi16(hi, _mm256_cvtepu8_epi16(a1)), _mm256_cvtepu8_epi16(s1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i + 16), hi);
+    }
+    BoxStepScalar(acc + i, add + i, sub + i, n - i, half, mul, out + i);
+}
+
+SIMD_TARGET("avx2")
+void OcmAngleCostsAvx2(const float* dx, const float* dy, const float* ix, const float* iy, const float* weight,
+                       int n, float inertia, float* out) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 neg_one = _mm256_set1_ps(-1.0f);
+    const __m256 eps = _mm256_set1_ps(1e-6f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 pi = _mm256_set1_ps(kOcmPi);
+    const __m256 half_pi = _mm256_set1_ps(kOcmPi / 2.0f);
+    const __m256 iv = _mm256_set1_ps(inertia);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 x = _mm256_loadu_ps(dx + i);
+        const __m256 y = _mm256_loadu_ps(dy + i);
+        const __m256 norm = _mm256_add_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y))), eps);
+        const __m256 dot = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(ix + i), _mm256_div_ps(x, norm)),
+                                         _mm256_mul_ps(_mm256_loadu_ps(iy + i), _mm256_div_ps(y, norm)));
+        const __m256 c = _mm256_max_ps(neg_one, _mm256_min_ps(one, dot));
+        const __m256 a = _mm256_andnot_ps(sign, c);
+        __m256 p = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(kAcos7), a), _mm256_set1_ps(kAcos6));
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(kAcos5));
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(kAcos4));
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(kAcos3));
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(kAcos2));
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(kAcos1));
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(kAcos0));
+        const __m256 r = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_sub_ps(one, a)), p);
+        const __m256 angle = _mm256_blendv_ps(r, _mm256_sub_ps(pi, r), _mm256_cmp_ps(c, _mm256_setzero_ps(), _CMP_LT_OQ));
+        const __m256 cost = _mm256_mul_ps(_mm256_div_ps(_mm256_sub_ps(half_pi, angle), pi), iv);
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(cost, _mm256_loadu_ps(weight + i)));
+    }
+    OcmAngleCostsScalar(dx + i, dy + i, ix + i, iy + i, weight + i, n - i, inertia, out + i);
+}
+
+// Eight floats per step, widened to two double accumulators of four lanes.
+SIMD_TARGET("avx2")
+inline void AddWidenedAvx2(__m256 v, __m256d& acc) {
+    acc = _mm256_add_pd(acc, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)),
+                                           _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1))));
+}
+
+SIMD_TARGET("avx2")
+inline void AddSquaresWidenedAvx2(__m256 v, __m256d& acc) {
+    const __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+    const __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+    acc = _mm256_add_pd(acc, _mm256_add_pd(_mm256_mul_pd(lo, lo), _mm256_mul_pd(hi, hi)));
+}
+
+SIMD_TARGET("avx2")
+inline double HorizontalSumAvx2(__m256d v) {
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+SIMD_TARGET("avx2")
+void LumaStatsRowAvx2(const float* row, const float* up, const float* down, int w, LumaPlaneStats& s) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    __m256d sum = _mm256_setzero_pd();
+    __m256d grad = _mm256_setzero_pd();
+    __m256d lap_sum = _mm256_setzero_pd();
+    __m256d lap_sq = _mm256_setzero_pd();
+    double tail_sum = 0.0, tail_grad = 0.0, tail_lap = 0.0, tail_lap_sq = 0.0;
+
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        const __m256 l = _mm256_loadu_ps(row + x);
+        AddWidenedAvx2(l, sum);
+        if (down) AddWidenedAvx2(_mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(down + x), l)), grad);
+    }
+    for (; x < w; ++x) {
+        tail_sum += row[x];
+        if (down) tail_grad += std::abs(down[x] - row[x]);
+    }
+    // Horizontal differences: x + 1 < w.
+    for (x = 0; x + 9 <= w; x += 8) {
+        AddWidenedAvx2(_mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(row + x + 1), _mm256_loadu_ps(row + x))),
+                       grad);
+    }
+    for (; x + 1 < w; ++x) tail_grad += std::abs(row[x + 1] - row[x]);
+
+    if (up && down) {
+        for (x = 1; x + 9 <= w; x += 8) {
+            // Same operation order as the scalar Laplacian.
+            __m256 lap = _mm256_mul_ps(four, _mm256_loadu_ps(row + x));
+            lap = _mm256_sub_ps(lap, _mm256_loadu_ps(up + x));
+            lap = _mm256_sub_ps(lap, _mm256_loadu_ps(down + x));
+            lap = _mm256_sub_ps(lap, _mm256_loadu_ps(row + x - 1));
+            lap = _mm256_sub_ps(lap, _mm256_loadu_ps(row + x + 1));
+            AddWidenedAvx2(lap, lap_sum);
+            AddSquaresWidenedAvx2(lap, lap_sq);
+        }
+        for (; x < w - 1; ++x) {
+            const float lap = 4.0f * row[x] - up[x] - down[x] - row[x - 1] - row[x + 1];
+            tail_lap += static_cast<double>(lap);
+            tail_lap_sq += static_cast<double>(lap) * static_cast<double>(lap);
+        }
+    }
+    s.sum += HorizontalSumAvx2(sum) + tail_sum;
+    s.grad_sum += HorizontalSumAvx2(grad) + tail_grad;
+    s.lap_sum += HorizontalSumAvx2(lap_sum) + tail_lap;
+    s.lap_sum_sq += HorizontalSumAvx2(lap_sq) + tail_lap_sq;
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+void ShiftSadAvx512(const uint8_t* prev_row, const uint8_t* curr_row,
+                    int x0, int step, int count, uint32_t* acc) {
+    // Four samples per iteration, one per 128-bit lane; the rest via AVX2.
+    const __m512i zero = _mm512_setzero_si512();
+    for (int k0 = 0; k0 < count; k0 += kShiftSadChunk) {
+        const int k1 = count - k0 < kShiftSadChunk ? count : k0 + kShiftSadChunk;
+        __m512i lo = zero;
+        __m512i hi = zero;
+        uint32_t last = 0;
+        int k = k0;
+        for (; k + 4 <= k1; k += 4) {
+            const int x = x0 + k * step;
+            const uint8_t* c = curr_row + x - kShiftSadRadius;
+            const uint8_t p0 = prev_row[x];
+            const uint8_t p1 = prev_row[x + step];
+            const uint8_t p2 = prev_row[x + 2 * step];
+            const uint8_t p3 = prev_row[x + 3 * step];
+            __m512i v = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(c)));
+            v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + step)), 1);
+            v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + 2 * step)), 2);
+            v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + 3 * step)), 3);
+            __m512i pv = _mm512_castsi128_si512(_mm_set1_epi8(static_cast<char>(p0)));
+            pv = _mm512_inserti32x4(pv, _mm_set1_epi8(static_cast<char>(p1)), 1);
+            pv = _mm512_inserti32x4(pv, _mm_set1_epi8(static_cast<char>(p2)), 2);
+            pv = _mm512_inserti32x4(pv, _mm_set1_epi8(static_cast<char>(p3)), 3);
+            const uint8_t* e = c + kShiftSadCount - 1;
+            last += static_cast<uint32_t>(AbsDiff(p0, e[0]) + AbsDiff(p1, e[step]) +
+                                          AbsDiff(p2, e[2 * step]) + AbsDiff(p3, e[3 * step]));
+            const __m512i d = _mm512_or_si512(_mm512_subs_epu8(v, pv), _mm512_subs_epu8(pv, v));
+            lo = _mm512_add_epi16(lo, _mm512_unpacklo_epi8(d, zero));
+            hi = _mm512_add_epi16(hi, _mm512_unpackhi_epi8(d, zero));
+        }
+        const __m256i lo256 = _mm256_add_epi16(_mm512_castsi512_si256(lo), _mm512_extracti64x4_epi64(lo, 1));
+        const __m256i hi256 = _mm256_add_epi16(_mm512_castsi512_si256(hi), _mm512_extracti64x4_epi64(hi, 1));
+        FlushShiftSad16(_mm_add_epi16(_mm256_castsi256_si128(lo256), _mm256_extracti128_si256(lo256, 1)),
+                        _mm_add_epi16(_mm256_castsi256_si128(hi256), _mm256_extracti128_si256(hi256, 1)), acc);
+        acc[kShiftSadCount - 1] += last;
+        if (k < k1) ShiftSadAvx2(prev_row, curr_row, x0 + k * step, step, k1 - k, acc);
+    }
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+void BlockSadAvx512(const uint8_t* a, const uint8_t* b, int n, uint32_t* sums) {
+    int i = 0;
+    for (; i + 64 <= n; i += 64) {
+        const __m512i s = _mm512_sad_epu8(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512(lanes, s);
+        for (int j = 0; j < 4; ++j) sums[(i >> 4) + j] += static_cast<uint32_t>(lanes[2 * j] + lanes[2 * j + 1]);
+    }
+    BlockSadAvx2(a + i, b + i, n - i, sums + (i >> 4));
+}
+
+SIMD_TARGET("avx512f")
+double DotAvx512(const float* a, const float* b, int n) {
+    __m512d acc = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm512_add_pd(acc, _mm512_mul_pd(_mm512_cvtps_pd(_mm256_loadu_ps(a + i)),
+                                               _mm512_cvtps_pd(_mm256_loadu_ps(b + i))));
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, acc);
+    double dot = 0.0;
+    for (double l : lanes) dot += l;
+    return dot + DotScalar(a + i, b + i, n - i);
+}
+
+// CPUID/XGETBV: the CPU must support the ISA and the OS must save its registers.
+bool CpuHas(SimdLevel level) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int r[4];
+    __cpuid(r, 0);
+    const int max_leaf = r[0];
+    __cpuid(r, 1);
+    const bool sse41 = (r[2] & (1 << 19)) != 0;
+    const bool ssse3 = (r[2] & (1 << 9)) != 0;
+    const bool osxsave = (r[2] & (1 << 27)) != 0;
+    const bool avx = (r[2] & (1 << 28)) != 0;
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    int ebx7 = 0;
+    if (max_leaf >= 7) {
+        __cpuidex(r, 7, 0);
+        ebx7 = r[1];
+    }
+    switch (level) {
+        case SimdLevel::Sse2: return true;
+        case SimdLevel::Sse41: return sse41 && ssse3;
+        case SimdLevel::Avx2: return avx && (xcr0 & 0x6) == 0x6 && (ebx7 & (1 << 5)) != 0;
+        case SimdLevel::Avx512:
+            return (xcr0 & 0xe6) == 0xe6 && (ebx7 & (1 << 16)) != 0 && (ebx7 & (1 << 30)) != 0;
+        default: return false;
+    }
+#else
+    __builtin_cpu_init();
+    switch (level) {
+        case SimdLevel::Sse2: return true;
+        case SimdLevel::Sse41: return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3");
+        case SimdLevel::Avx2: return __builtin_cpu_supports("avx2");
+        case SimdLevel::Avx512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+        default: return false;
+    }
+#endif
+}
+#endif  // FACE_PIPELINE_SIMD_X86
+
+#if defined(FACE_PIPELINE_SIMD_NEON)
+// ---------------------------------------------------------------------------
+// arm64: NEON is part of the base ISA, no detection needed.
+
+void ShiftSadNeon(const uint8_t* prev_row, const uint8_t* curr_row,
+                  int x0, int step, int count, uint32_t* acc) {
+    for (int k0 = 0; k0 < count; k0 += kShiftSadChunk) {
+        const int k1 = count - k0 < kShiftSadChunk ? count : k0 + kShiftSadChunk;
+        uint16x8_t lo = vdupq_n_u16(0);
+        uint16x8_t hi = vdupq_n_u16(0);
+        uint32_t last = 0;
+        for (int k = k0; k < k1; ++k) {
+            const int x = x0 + k * step;
+            const uint8_t p = prev_row[x];
+            const uint8x16_t d = vabdq_u8(vld1q_u8(curr_row + x - kShiftSadRadius), vdupq_n_u8(p));
+            lo = vaddw_u8(lo, vget_low_u8(d));
+            hi = vaddw_u8(hi, vget_high_u8(d));
+            last += static_cast<uint32_t>(AbsDiff(p, curr_row[x + kShiftSadRadius]));
+        }
+        uint16_t lanes[16];
+        vst1q_u16(lanes, lo);
+        vst1q_u16(lanes + 8, hi);
+        for (int s = 0; s < 16; ++s) acc[s] += lanes[s];
+        acc[kShiftSadCount - 1] += last;
+    }
+}
+
+void BlockSadNeon(const uint8_t* a, const uint8_t* b, int n, uint32_t* sums) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) sums[i >> 4] += vaddlvq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    BlockSadScalar(a + i, b + i, n - i, sums + (i >> 4));
+}
+
+double DotNeon(const float* a, const float* b, int n) {
+    float64x2_t acc0 = vdupq_n_f64(0.0);
+    float64x2_t acc1 = vdupq_n_f64(0.0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t va = vld1q_f32(a + i);
+        const float32x4_t vb = vld1q_f32(b + i);
+        acc0 = vaddq_f64(acc0, vmulq_f64(vcvt_f64_f32(vget_low_f32(va)), vcvt_f64_f32(vget_low_f32(vb))));
+        acc1 = vaddq_f64(acc1, vmulq_f64(vcvt_high_f64_f32(va), vcvt_high_f64_f32(vb)));
+    }
+    return vaddvq_f64(vaddq_f64(acc0, acc1)) + DotScalar(a + i, b + i, n - i);
+}
+
+int32_t DotI8Neon(const int8_t* a, const int8_t* b, int n) {
+    int32x4_t acc = vdupq_n_s32(0);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const int8x16_t va = vld1q_s8(a + i);
+        const int8x16_t vb = vld1q_s8(b + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_high_s8(va, vb));
+    }
+    return vaddvq_s32(acc) + DotI8Scalar(a + i, b + i, n - i);
+}
+
+void LumaNeon(const uint8_t* rgb, int n, float* out) {
+    const float32x4_t kr = vdupq_n_f32(0.299f);
+    const float32x4_t kg = vdupq_n_f32(0.587f);
+    const float32x4_t kb = vdupq_n_f32(0.114f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const uint8x8x3_t px = vld3_u8(rgb + static_cast<size_t>(i) * 3u);
+        const uint16x8_t r = vmovl_u8(px.val[0]);
+        const uint16x8_t g = vmovl_u8(px.val[1]);
+        const uint16x8_t b = vmovl_u8(px.val[2]);
+        for (int half = 0; half < 2; ++half) {
+            const float32x4_t rf = vcvtq_f32_u32(vmovl_u16(half ? vget_high_u16(r) : vget_low_u16(r)));
+            const float32x4_t gf = vcvtq_f32_u32(vmovl_u16(half ? vget_high_u16(g) : vget_low_u16(g)));
+            const float32x4_t bf = vcvtq_f32_u32(vmovl_u16(half ? vget_high_u16(b) : vget_low_u16(b)));
+            vst1q_f32(out + i + 4 * half, vaddq_f32(vaddq_f32(vmulq_f32(kr, rf), vmulq_f32(kg, gf)), vmulq_f32(kb, bf)));
+        }
+    }
+    LumaScalar(rgb + static_cast<size_t>(i) * 3u, n - i, out + i);
+}
+void BoxStepNeon(uint16_t* acc, const uint8_t* add, const uint8_t* sub, int n, uint16_t half, uint16_t mul,
+                 uint8_t* out) {
+    const uint16x8_t hv = vdupq_n_u16(half);
+    const uint16x4_t mv = vdup_n_u16(mul);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vld1q_u16(acc + i);
+        const uint16x8_t r = vaddq_u16(v, hv);
+        const uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(r), mv), 16);
+        const uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(r), mv), 16);
+        vst1_u8(out + i, vmovn_u16(vcombine_u16(lo, hi)));
+        v = vsubq_u16(vaddq_u16(v, vmovl_u8(vld1_u8(add + i))), vmovl_u8(vld1_u8(sub + i)));
+        vst1q_u16(acc + i, v);
+    }
+    BoxStepScalar(acc + i, add + i, sub + i, n - i, half, mul, out + i);
+}
+
+void OcmAngleCostsNeon(const float* dx, const float* dy, const float* ix, const float* iy, const float* weight,
+                       int n, float inertia, float* out) {
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t neg_one = vdupq_n_f32(-1.0f);
+    const float32x4_t eps = vdupq_n_f32(1e-6f);
+    const float32x4_t pi = vdupq_n_f32(kOcmPi);
+    const float32x4_t half_pi = vdupq_n_f32(kOcmPi / 2.0f);
+    const float32x4_t iv = vdupq_n_f32(inertia);
+    int i = 0;
+    // Separate multiplies and adds: fused ones would round differently
+    // from the scalar code.
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t x = vld1q_f32(dx + i);
+        const float32x4_t y = vld1q_f32(dy + i);
+        const float32x4_t norm = vaddq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y))), eps);
+        const float32x4_t dot = vaddq_f32(vmulq_f32(vld1q_f32(ix + i), vdivq_f32(x, norm)),
+                                          vmulq_f32(vld1q_f32(iy + i), vdivq_f32(y, norm)));
+        const float32x4_t c = vmaxq_f32(neg_one, vminq_f32(one, dot));
+        const float32x4_t a = vabsq_f32(c);
+        float32x4_t p = vaddq_f32(vmulq_f32(vdupq_n_f32(kAcos7), a), vdupq_n_f32(kAcos6));
+        p = vaddq_f32(vmulq_f32(p, a), vdupq_n_f32(kAcos5));
+        p = vaddq_f32(vmulq_f32(p, a), vdupq_n_f32(kAcos4));
+        p = vaddq_f32(vmulq_f32(p, a), vdupq_n_f32(kAcos3));
+        p = vaddq_f32(vmulq_f32(p, a), vdupq_n_f32(kAcos2));
+        p = vaddq_f32(vmulq_f32(p, a), vdupq_n_f32(kAcos1));
+        p = vaddq_f32(vmulq_f32(p, a), vdupq_n_f32(kAcos0));
+        const float32x4_t r = vmulq_f32(vsqrtq_f32(vsubq_f32(one, a)), p);
+        const float32x4_t angle = vbslq_f32(vcltq_f32(c, vdupq_n_f32(0.0f)), vsubq_f32(pi, r), r);
+        const float32x4_t cost = vmulq_f32(vdivq_f32(vsubq_f32(half_pi, angle), pi), iv);
+        vst1q_f32(out + i, vmulq_f32(cost, vld1q_f32(weight + i)));
+    }
+    OcmAngleCostsScalar(dx + i, dy + i, ix + i, iy + i, weight + i, n - i, inertia, out + i);
+}
+#endif  // FACE_PIPELINE_SIMD_NEON
+
+struct KernelTable {
+    SimdLevel level = SimdLevel::Scalar;
+    void (*shift_sad)(const uint8_t*, const uint8_t*, int, int, int, uint32_t*) = ShiftSadScalar;
+    void (*block_sad)(const uint8_t*, const uint8_t*, int, uint32_t*) = BlockSadScalar;
+    double (*dot)(const float*, const float*, int) = DotScalar;
+    int32_t (*dot_i8)(const int8_t*, const int8_t*, int) = DotI8Scalar;
+    void (*luma)(const uint8_t*, int, float*) = LumaScalar;
+    void (*warp_row)(const uint8_t*, int, int, const float*, int, int, int, uint8_t*) = WarpRowScalar;
+    void (*luma_stats_row)(const float*, const float*, const float*, int, LumaPlaneStats&) = LumaStatsRowScalar;
+    void (*box_step)(uint16_t*, const uint8_t*, const uint8_t*, int, uint16_t, uint16_t, uint8_t*) = BoxStepScalar;
+    void (*ocm_angle)(const float*, const float*, const float*, const float*, const float*, int, float, float*) =
+        OcmAngleCostsScalar;
+};
+
+// FACE_PIPELINE_SIMD caps the level; unset or unknown values mean no cap
+// (Neon, the last enumerator).
+SimdLevel RequestedLevel() {
+    const char* env = std::getenv("FACE_PIPELINE_SIMD");
+    if (!env || !*env) return SimdLevel::Neon;
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Sse41,
+                                SimdLevel::Avx2, SimdLevel::Avx512, SimdLevel::Neon};
+    for (SimdLevel l : levels) {
+        if (std::strcmp(env, SimdLevelName(l)) == 0) return l;
+    }
+    return SimdLevel::Neon;
+}
+
+KernelTable SelectKernels() {
+    KernelTable t;
+    const SimdLevel cap = RequestedLevel();
+    (void)cap;
+#if defined(FACE_PIPELINE_SIMD_X86)
+    // The level enum is ordered by width on x86.
+    const SimdLevel order[] = {SimdLevel::Sse2, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Avx512};
+    for (SimdLevel l : order) {
+        if (static_cast<int>(l) > static_cast<int>(cap) || !CpuHas(l)) break;
+        t.level = l;
+    }
+    switch (t.level) {
+        case SimdLevel::Avx512:
+            t.shift_sad = ShiftSadAvx512;
+            t.block_sad = BlockSadAvx512;
+            t.dot = DotAvx512;
+            t.dot_i8 = DotI8Avx2;
+            // AVX-512 implies FMA, which the compiler may contract the luma
+            // sum, the warp blend, the Laplacian and the acos polynomial
+            // into; keep the AVX2 versions so every level is bit-identical.
+            t.luma = LumaAvx2;
+            t.warp_row = WarpRowAvx2;
+            t.luma_stats_row = LumaStatsRowAvx2;
+            t.box_step = BoxStepAvx2;
+            t.ocm_angle = OcmAngleCostsAvx2;
+            break;
+        case SimdLevel::Avx2:
+            t.shift_sad = ShiftSadAvx2;
+            t.block_sad = BlockSadAvx2;
+            t.dot = DotAvx2;
+            t.dot_i8 = DotI8Avx2;
+            t.luma = LumaAvx2;
+            t.warp_row = WarpRowAvx2;
+            t.luma_stats_row = LumaStatsRowAvx2;
+            t.box_step = BoxStepAvx2;
+            t.ocm_angle = OcmAngleCostsAvx2;
+            break;
+        case SimdLevel::Sse41:
+            t.shift_sad = ShiftSadSse2;
+            t.block_sad = BlockSadSse2;
+            t.dot = DotSse2;
+            t.dot_i8 = DotI8Sse2;
+            t.luma = LumaSse41;
+            t.box_step = BoxStepSse2;
+            t.ocm_angle = OcmAngleCostsSse2;
+            break;
+        case SimdLevel::Sse2:
+            t.shift_sad = ShiftSadSse2;
+            t.block_sad = BlockSadSse2;
+            t.dot = DotSse2;
+            t.dot_i8 = DotI8Sse2;
+            t.box_step = BoxStepSse2;
+            t.ocm_angle = OcmAngleCostsSse2;
+            break;
+        default:
+            break;
+    }
+#elif defined(FACE_PIPELINE_SIMD_NEON)
+    if (cap == SimdLevel::Neon) {
+        t.level = SimdLevel::Neon;
+        t.shift_sad = ShiftSadNeon;
+        t.block_sad = BlockSadNeon;
+        t.dot = DotNeon;
+        t.dot_i8 = DotI8Neon;
+        t.luma = LumaNeon;
+        t.box_step = BoxStepNeon;
+        t.ocm_angle = OcmAngleCostsNeon;
+    }
+#endif
+    return t;
+}
+
+const KernelTable& Kernels() {
+    static const KernelTable table = SelectKernels();
+    return table;
+}
+}  // namespace
+
+SimdLevel ActiveSimdLevel() { return Kernels().level; }
+
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Sse2: return "sse2";
+        case SimdLevel::Sse41: return "sse41";
+        case SimdLevel::Avx2: return "avx2";
+        case SimdLevel::Avx512: return "avx512";
+        case SimdLevel::Neon: return "neon";
+        default: return "scalar";
+    }
+}
+
+void AccumulateShiftSad(const uint8_t* prev_row, const uint8_t* curr_row,
+                        int x0, int step, int count, uint32_t acc[kShiftSadCount]) {
+    if (count > 0) Kernels().shift_sad(prev_row, curr_row, x0, step, count, acc);
+}
+
+void AccumulateBlockSad16(const uint8_t* a, const uint8_t* b, int n, uint32_t* sums) {
+    if (n > 0) Kernels().block_sad(a, b, n, sums);
+}
+
+double DotF32(const float* a, const float* b, int n) {
+    return n > 0 ? Kernels().dot(a, b, n) : 0.0;
+}
+
+int32_t DotI8(const int8_t* a, const int8_t* b, int n) {
+    return n > 0 ? Kernels().dot_i8(a, b, n) : 0;
+}
+
+void RgbToLumaF32(const uint8_t* rgb, int n, float* out) {
+    if (n > 0) Kernels().luma(rgb, n, out);
+}
+
+void WarpAffineBilinearRgb(const uint8_t* src, int w, int h, const float m[6],
+                           uint8_t* dst, int dw, int dh) {
+    if (!src || !dst || w <= 0 || h <= 0) return;
+    const KernelTable& k = Kernels();
+    for (int v = 0; v < dh; ++v) {
+        k.warp_row(src, w, h, m, v, 0, dw, dst + static_cast<size_t>(v) * dw * 3u);
+    }
+}
+
+LumaPlaneStats ComputeLumaPlaneStats(const float* luma, int w, int h) {
+    LumaPlaneStats s;
+    if (!luma || w <= 0 || h <= 0) return s;
+    const KernelTable& k = Kernels();
+    for (int y = 0; y < h; ++y) {
+        const float* row = luma + static_cast<size_t>(y) * w;
+        k.luma_stats_row(row, y > 0 ? row - w : nullptr, y + 1 < h ? row + w : nullptr, w, s);
+    }
+    return s;
+}
+
+void BoxBlurColumnsU8(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+                      int n, int rows, int radius) {
+    if (!src || !dst || n <= 0 || rows <= 0) return;
+    radius = std::max(1, std::min(kBoxBlurMaxRadius, radius));
+    const int window = 2 * radius + 1;
+    // (sum + window / 2) * ceil(65536 / window) >> 16 stays <= 255 and in
+    // 16 bits for windows up to 255.
+    const uint16_t half = static_cast<uint16_t>(window / 2);
+    const uint16_t mul = static_cast<uint16_t>((65536 + window - 1) / window);
+    auto row = [&](int y) { return src + static_cast<size_t>(std::max(0, std::min(rows - 1, y))) * src_stride; };
+    std::vector<uint16_t> acc(static_cast<size_t>(n), 0);
+    for (int k = -radius; k <= radius; ++k) {
+        const uint8_t* r = row(k);
+        for (int i = 0; i < n; ++i) acc[i] = static_cast<uint16_t>(acc[i] + r[i]);
+    }
+    const KernelTable& kt = Kernels();
+    for (int y = 0; y < rows; ++y) {
+        kt.box_step(acc.data(), row(y + radius + 1), row(y - radius), n, half, mul,
+                    dst + static_cast<size_t>(y) * dst_stride);
+    }
+}
+
+void OcmAngleCosts(const float* dx, const float* dy, const float* ix, const float* iy, const float* weight,
+                   int n, float inertia, float* out) {
+    if (n > 0) Kernels().ocm_angle(dx, dy, ix, iy, weight, n, inertia, out);
+}
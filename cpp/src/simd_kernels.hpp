@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Hot inner loops with per-CPU implementations picked at run time.
+ *
+ * The binary is built for the baseline ISA (SSE2 on x86-64, NEON on arm64)
+ * so one build runs everywhere; wider x86 variants are compiled with
+ * per-function target attributes and selected once from CPUID. All variants
+ * return the same integers; the float kernels match the scalar path up to
+ * summation order (DotF32, ComputeLumaPlaneStats) or exactly (RgbToLumaF32,
+ * WarpAffineBilinearRgb, OcmAngleCosts).
+ *
+ * FACE_PIPELINE_SIMD=scalar|sse2|sse41|avx2|avx512 caps the level, e.g. to
+ * compare outputs or time a kernel against the scalar code.
+ */
+enum class SimdLevel {
+    Scalar,
+    Sse2,
+    Sse41,
+    Avx2,
+    Avx512,  // AVX-512 F + BW
+    Neon,
+};
+
+/**
+ * Level the kernels below run at (detected on first use).
+ */
+SimdLevel ActiveSimdLevel();
+
+const char* SimdLevelName(SimdLevel level);
+
+/** Shift radius of AccumulateShiftSad(): shifts -8..+8. */
+constexpr int kShiftSadRadius = 8;
+constexpr int kShiftSadCount = 2 * kShiftSadRadius + 1;
+
+/**
+ * Horizontal-shift SAD for a translation search: for `count` samples at
+ * x = x0 + k * step of `prev_row`, add |prev_row[x] - curr_row[x + s]| to
+ * acc[s + kShiftSadRadius] for every shift s in [-8, 8]. The caller keeps
+ * all x + s inside the row.
+ */
+void AccumulateShiftSad(const uint8_t* prev_row, const uint8_t* curr_row,
+                        int x0, int step, int count, uint32_t acc[kShiftSadCount]);
+
+/**
+ * Per-block SAD of `n` bytes: sums[i] += SAD of bytes [16 i, 16 i + 16)
+ * (the last block may be shorter).
+ */
+void AccumulateBlockSad16(const uint8_t* a, const uint8_t* b, int n, uint32_t* sums);
+
+/**
+ * Dot product of `n` floats accumulated in double.
+ */
+double DotF32(const float* a, const float* b, int n);
+
+/**
+ * Dot product of `n` int8 values (exact; |sum| < 2^31 for n < 2^17).
+ */
+int32_t DotI8(const int8_t* a, const int8_t* b, int n);
+
+/**
+ * 0.299 R + 0.587 G + 0.114 B for `n` interleaved RGB pixels.
+ */
+void RgbToLumaF32(const uint8_t* rgb, int n, float* out);
+
+/**
+ * Bilinear similarity/affine warp of an interleaved RGB image into a
+ * dw x dh RGB output: output pixel (u, v) samples the source at
+ * x = m[0] u + m[1] v + m[2], y = m[3] u + m[4] v + m[5], with coordinates
+ * clamped to the image (replicated border). Every level is bit-identical
+ * to the scalar code; only pixels whose footprint lies inside the image
+ * take the vector path.
+ */
+void WarpAffineBilinearRgb(const uint8_t* src, int w, int h, const float m[6],
+                           uint8_t* dst, int dw, int dh);
+
+/**
+ * Sums over a w x h float luma plane, gathered in one pass:
+ * every pixel, the absolute forward differences to the right and below,
+ * and the 4-neighbour Laplacian (4 l - up - down - left - right) of the
+ * interior pixels. The sums match the scalar code up to summation order.
+ */
+struct LumaPlaneStats {
+    double sum = 0.0;
+    double grad_sum = 0.0;  // horizontal + vertical |differences|
+    double lap_sum = 0.0;
+    double lap_sum_sq = 0.0;
+};
+
+LumaPlaneStats ComputeLumaPlaneStats(const float* luma, int w, int h);
+
+/** Largest radius BoxBlurColumnsU8() takes (a 255-row window). */
+constexpr int kBoxBlurMaxRadius = 127;
+
+/**
+ * Vertical box blur of `rows` rows of `n` bytes: byte i of dst row y is
+ * the mean of byte i of src rows y - radius .. y + radius (edge rows
+ * repeated), within one of the rounded mean. Each byte column is blurred
+ * on its own, so interleaved channels need no unpacking; blur a transposed
+ * copy for the horizontal direction. `radius` is clamped to
+ * [1, kBoxBlurMaxRadius]; src and dst must not overlap. Every level is
+ * bit-identical to the scalar code.
+ */
+void BoxBlurColumnsU8(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+                      int n, int rows, int radius);
+
+/**
+ * OC-SORT's direction-consistency (OCM) cost of `n` pairs, as
+ * structure-of-arrays: the direction (dx[i], dy[i]) from a track's
+ * reference center to a detection's center is normalized and compared with
+ * the track's unit inertia direction (ix[i], iy[i]), and
+ * out[i] = (pi/2 - acos(cos)) / pi * inertia * weight[i]. acos is a
+ * polynomial accurate to about 1e-7 rad, well below what moves the cost.
+ * Every level is bit-identical to the scalar code.
+ */
+void OcmAngleCosts(const float* dx, const float* dy, const float* ix, const float* iy, const float* weight,
+                   int n, float inertia, float* out);
@@ -0,0 +1,72 @@
+#include "speculative_detector.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+SpeculativeDetector::SpeculativeDetector(int count, int ahead, FrameCache::Loader decode, Detector detect,
+                                         Wanted wanted, Idle idle, int first)
+    : decode_(std::move(decode)),
+      detect_(std::move(detect)),
+      wanted_(std::move(wanted)),
+      idle_(std::move(idle)),
+      count_(count),
+      ahead_(std::max(1, ahead)),
+      position_(std::max(0, first)),
+      next_(std::max(0, first) + 1),
+      thread_([this] { run(); }) {}
+
+SpeculativeDetector::~SpeculativeDetector() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+bool SpeculativeDetector::take(int index, std::vector<Detection>& dets) {
+    std::lock_guard<std::mutex> lock(mu_);
+    position_ = std::max(position_, index);
+    done_.erase(done_.begin(), done_.lower_bound(index));
+    cv_.notify_all();
+    auto it = done_.find(index);
+    if (it == done_.end()) return false;
+    dets = std::move(it->second);
+    done_.erase(it);
+    used_++;
+    return true;
+}
+
+int SpeculativeDetector::detected() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return detected_;
+}
+
+int SpeculativeDetector::used() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return used_;
+}
+
+void SpeculativeDetector::run() {
+    LoadedRgbFrame frame;
+    std::unique_lock<std::mutex> lock(mu_);
+    while (!stop_) {
+        // A frame the tracker has passed is not worth detecting any more.
+        next_ = std::max(next_, position_ + 1);
+        while (next_ < count_ && next_ <= position_ + ahead_ && !wanted_(next_)) next_++;
+        if (next_ >= count_ || next_ > position_ + ahead_ || !idle_()) {
+            // Idleness is polled: the scheduler does not signal it.
+            cv_.wait_for(lock, std::chrono::milliseconds(2));
+            continue;
+        }
+        const int index = next_++;
+        lock.unlock();
+        std::vector<Detection> dets;
+        const bool ok = decode_(index, frame) && frame.hasRgb();
+        if (ok) dets = detect_(frame);
+        lock.lock();
+        if (!ok) continue;
+        detected_++;
+        if (index > position_) done_[index] = std::move(dets);
+    }
+}
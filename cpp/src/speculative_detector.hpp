@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_cache.hpp"
+#include "kalman_filter.hpp"
+
+/**
+ * Detects unsampled frames just ahead of the tracker while the detection
+ * workers have nothing to do.
+ *
+ * When detected frames already wait for the tracker (`idle()`), detection
+ * is not what the run waits on, and a core goes spare. One thread then
+ * reads and detects the next unsampled frames within `ahead` of the
+ * tracker's position. The tracker takes a frame's detections if they are
+ * done by the time it gets there; later ones are dropped. Which frames get
+ * them depends on timing, so runs using it are not repeatable.
+ */
+class SpeculativeDetector {
+public:
+    using Detector = std::function<std::vector<Detection>(const LoadedRgbFrame&)>;
+    using Wanted = std::function<bool(int)>;  // frame `index` has no detection of its own
+    using Idle = std::function<bool()>;
+
+    /**
+     * @param count Number of frames
+     * @param ahead Frames past the tracker's position it may work on
+     * @param decode Loader with RGB, safe to call next to the decoders
+     * @param detect Detector (with ReID when the run embeds eagerly)
+     * @param first First frame (a resumed run starts past 0)
+     */
+    SpeculativeDetector(int count, int ahead, FrameCache::Loader decode, Detector detect, Wanted wanted, Idle idle,
+                        int first = 0);
+    ~SpeculativeDetector();
+
+    SpeculativeDetector(const SpeculativeDetector&) = delete;
+    SpeculativeDetector& operator=(const SpeculativeDetector&) = delete;
+
+    /**
+     * The tracker is at frame `index`: results of earlier frames are
+     * dropped. Frames must be passed in increasing order.
+     *
+     * @return true (with `dets`) if frame `index` was detected in time
+     */
+    bool take(int index, std::vector<Detection>& dets);
+
+    int detected() const;  // frames it ran the detector on
+    int used() const;      // of those, the ones taken in time
+
+private:
+    void run();
+
+    FrameCache::Loader decode_;
+    Detector detect_;
+    Wanted wanted_;
+    Idle idle_;
+    const int count_;
+    const int ahead_;
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    int position_;   // tracker's frame
+    int next_ = 0;   // next frame to consider
+    bool stop_ = false;
+    int detected_ = 0;
+    int used_ = 0;
+    std::map<int, std::vector<Detection>> done_;
+    std::thread thread_;  // declared last: it reads the members above
+};
@@ -0,0 +1,99 @@
+#include "stage_balancer.hpp"
+
+#include <algorithm>
+
+namespace {
+constexpr double kSaturated = 0.85;  // utilization a stage must reach to grow
+constexpr double kShortQueue = 0.5;  // queue fill it must stay under (its consumer is waiting)
+constexpr double kHeadroom = 0.7;    // utilization a giving stage may reach without the unit
+constexpr int kCooldown = 2;         // periods without a move after one
+}  // namespace
+
+StageBalancer::StageBalancer(int cores, int period_ms)
+    : cores_(std::max(1, cores)),
+      period_(std::max(10, period_ms)),
+      last_(std::chrono::steady_clock::now()) {}
+
+void StageBalancer::addStage(Stage stage) {
+    stage.units = std::max(stage.min_units, std::min(stage.units, stage.max_units));
+    Sample sample;
+    sample.busy_ms = stage.busy_ms();
+    stages_.push_back(std::move(stage));
+    samples_.push_back(sample);
+}
+
+void StageBalancer::poll() {
+    for (size_t s = 0; s < stages_.size(); ++s) {
+        samples_[s].fill_sum += static_cast<double>(stages_[s].queued()) / std::max(1, stages_[s].depth);
+        samples_[s].fill_count++;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_ < period_) return;
+    rebalance(std::chrono::duration<double, std::milli>(now - last_).count());
+    last_ = now;
+}
+
+void StageBalancer::rebalance(double elapsed_ms) {
+    const size_t n = stages_.size();
+    std::vector<double> util(n), fill(n);
+    int used = 0;
+    for (size_t s = 0; s < n; ++s) {
+        const Stage& st = stages_[s];
+        Sample& sample = samples_[s];
+        const double busy = st.busy_ms();
+        const double capacity = elapsed_ms * (st.serial ? 1 : st.units);
+        util[s] = capacity > 0.0 ? (busy - sample.busy_ms) / capacity : 0.0;
+        fill[s] = sample.fill_count > 0 ? sample.fill_sum / sample.fill_count : 0.0;
+        sample = Sample{busy, 0.0, 0};
+        used += st.units * st.cores_per_unit;
+    }
+    if (cooldown_ > 0) {
+        cooldown_--;
+        return;
+    }
+
+    // The saturated stage its consumer waits on; then where its unit comes from.
+    int to = -1;
+    for (size_t s = 0; s < n; ++s) {
+        const Stage& st = stages_[s];
+        if (st.units >= st.max_units || util[s] < kSaturated || fill[s] > kShortQueue) continue;
+        if (to < 0 || util[s] > util[static_cast<size_t>(to)]) to = static_cast<int>(s);
+    }
+    int from = -1;
+    int give_units = 0;
+    const int free_cores = std::max(0, cores_ - used);
+    if (to >= 0 && free_cores < stages_[static_cast<size_t>(to)].cores_per_unit) {
+        // As many units as free the cores the new one takes (never more
+        // cores in use than before, once all are in use).
+        const int needed = stages_[static_cast<size_t>(to)].cores_per_unit - free_cores;
+        for (size_t s = 0; s < n; ++s) {
+            const Stage& st = stages_[s];
+            const int k = (needed + st.cores_per_unit - 1) / st.cores_per_unit;
+            if (static_cast<int>(s) == to || st.units - k < st.min_units) continue;
+            const double without = util[s] * st.units / (st.units - k);
+            if (without > kHeadroom) continue;
+            if (from < 0 || util[s] < util[static_cast<size_t>(from)]) {
+                from = static_cast<int>(s);
+                give_units = k;
+            }
+        }
+        if (from < 0) to = -1;
+    }
+    // A pair chosen once waits for the next period to confirm it.
+    if (to < 0 || to != pending_to_ || from != pending_from_) {
+        pending_to_ = to;
+        pending_from_ = from;
+        return;
+    }
+
+    Stage& grow = stages_[static_cast<size_t>(to)];
+    grow.resize(++grow.units);
+    if (from >= 0) {
+        Stage& give = stages_[static_cast<size_t>(from)];
+        give.units -= give_units;
+        give.resize(give.units);
+    }
+    moves_++;
+    cooldown_ = kCooldown;
+    pending_to_ = pending_from_ = -1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Moves cores between the stages that run ahead of the tracker while a
+ * run goes (--balance-stages).
+ *
+ * Static quotas fit one kind of shot: a crowd makes ReID the slowest
+ * stage, an empty shot leaves the detector idle and decode in front. Each
+ * stage reports the time it has been busy and the frames waiting at its
+ * output; once per period the balancer works out each stage's
+ * utilization (busy time over the cores it holds) and how full its queue
+ * ran. The stage that is saturated with a short queue, so that the one
+ * after it waits, gets one more unit: from the free cores if there are
+ * any, otherwise from the least utilized stage (as many of its units as
+ * free the cores needed), provided that stage's projected utilization
+ * without them still has headroom.
+ *
+ * Against thrashing, a move needs the same pair chosen on two periods in
+ * a row, and each move is followed by two periods without one, so the
+ * stages settle at their new sizes before they are measured again.
+ * Not thread-safe: poll() is called from the tracking loop.
+ */
+class StageBalancer {
+public:
+    struct Stage {
+        std::string name;
+        std::function<double()> busy_ms;  // busy time so far (monotonic)
+        std::function<int()> queued;      // frames waiting at the output
+        int depth = 1;                    // output queue capacity
+        int units = 1;                    // current size
+        int min_units = 1;
+        int max_units = 1;
+        int cores_per_unit = 1;
+        bool serial = false;              // one thread drives its units: utilization is its busy share
+        std::function<void(int)> resize;  // apply a new size
+    };
+
+    StageBalancer(int cores, int period_ms);
+
+    void addStage(Stage stage);
+
+    /** Sample the queues; rebalance once a period has passed. */
+    void poll();
+
+    int moves() const { return moves_; }
+    const std::vector<Stage>& stages() const { return stages_; }
+
+private:
+    struct Sample {
+        double busy_ms = 0.0;
+        double fill_sum = 0.0;
+        int fill_count = 0;
+    };
+
+    void rebalance(double elapsed_ms);
+
+    int cores_;
+    std::chrono::milliseconds period_;
+    std::chrono::steady_clock::time_point last_;
+    std::vector<Stage> stages_;
+    std::vector<Sample> samples_;
+    int pending_to_ = -1;    // move chosen last period (stage growing, stage giving)
+    int pending_from_ = -1;
+    int cooldown_ = 0;       // periods left without a move
+    int moves_ = 0;
+};
@@ -0,0 +1,194 @@
+#include "stage_profile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "json_writer.hpp"
+
+namespace {
+std::atomic<uint64_t> g_next_profile_id{1};
+
+int BucketOf(uint64_t ns) {
+    if (ns < 8) return static_cast<int>(ns);
+    int e = 63;
+    while (!(ns >> e)) --e;
+    return 8 + (e - 3) * 8 + static_cast<int>((ns >> (e - 3)) & 7);
+}
+
+// Middle of bucket `b` in nanoseconds.
+double BucketMid(int b) {
+    if (b < 8) return static_cast<double>(b);
+    const int e = (b - 8) / 8 + 3;
+    const double width = static_cast<double>(uint64_t(1) << (e - 3));
+    return (8 + (b - 8) % 8) * width + width / 2.0;
+}
+
+// Last profile a thread recorded into, and its shard there.
+struct ShardCache {
+    uint64_t profile = 0;
+    void* shard = nullptr;
+};
+thread_local ShardCache t_cache;
+}  // namespace
+
+const char* ProfileStageName(ProfileStage stage) {
+    switch (stage) {
+        case ProfileStage::Decode: return "decode";
+        case ProfileStage::Detect: return "detect";
+        case ProfileStage::Reid: return "reid";
+        case ProfileStage::Gmc: return "gmc";
+        case ProfileStage::Associate: return "associate";
+        case ProfileStage::Link: return "link";
+        case ProfileStage::Wait: return "wait";
+        default: return "unknown";
+    }
+}
+
+StageProfile::StageProfile()
+    : id_(g_next_profile_id.fetch_add(1)), start_(Clock::now()) {}
+
+StageProfile::Shard& StageProfile::shard() {
+    if (t_cache.profile == id_) return *static_cast<Shard*>(t_cache.shard);
+    std::lock_guard<std::mutex> lock(mu_);
+    const std::thread::id self = std::this_thread::get_id();
+    Shard* found = nullptr;
+    for (const auto& s : shards_) {
+        if (s->thread == self) found = s.get();
+    }
+    if (!found) {
+        shards_.push_back(std::make_unique<Shard>());
+        found = shards_.back().get();
+        found->thread = self;
+    }
+    t_cache.profile = id_;
+    t_cache.shard = found;
+    return *found;
+}
+
+void StageProfile::record(ProfileStage stage, Clock::time_point start, Clock::time_point end, int frame) {
+    if (stage >= ProfileStage::Count) return;
+    const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    const uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+    Shard& sh = shard();
+    if (trace_) {
+        if (sh.spans.size() < kMaxSpansPerThread) {
+            const int64_t at = std::chrono::duration_cast<std::chrono::nanoseconds>(start - start_).count();
+            sh.spans.push_back(Span{at, static_cast<int64_t>(v), frame, stage});
+        } else {
+            sh.dropped_spans++;
+        }
+    }
+    Histogram& h = sh.stages[static_cast<size_t>(stage)];
+    // Only this thread writes the shard: plain read-modify-writes suffice.
+    constexpr auto relaxed = std::memory_order_relaxed;
+    h.calls.store(h.calls.load(relaxed) + 1, relaxed);
+    h.total_ns.store(h.total_ns.load(relaxed) + v, relaxed);
+    if (v > h.max_ns.load(relaxed)) h.max_ns.store(v, relaxed);
+    std::atomic<uint32_t>& bucket = h.buckets[static_cast<size_t>(BucketOf(v))];
+    bucket.store(bucket.load(relaxed) + 1, relaxed);
+}
+
+double StageProfile::totalMs(ProfileStage stage) const {
+    if (stage >= ProfileStage::Count) return 0.0;
+    std::lock_guard<std::mutex> lock(mu_);
+    uint64_t ns = 0;
+    for (const auto& shard : shards_) ns += shard->stages[static_cast<size_t>(stage)].total_ns.load(std::memory_order_relaxed);
+    return static_cast<double>(ns) * 1e-6;
+}
+
+bool StageProfile::write(const std::string& path, std::string& error) const {
+    const double wall_s = std::chrono::duration<double>(Clock::now() - start_).count();
+    const int64_t frames = frames_.load();
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "w"), &std::fclose);
+    if (!file) {
+        error = "cannot create " + path;
+        return false;
+    }
+    constexpr auto relaxed = std::memory_order_relaxed;
+    JsonWriter w(file.get());
+    w.raw("{\n  \"wallSeconds\": ").fixed(wall_s, 3).raw(",\n  \"frames\": ").integer(frames);
+    w.raw(",\n  \"framesPerSecond\": ").fixed(wall_s > 0.0 ? static_cast<double>(frames) / wall_s : 0.0, 2);
+    w.raw(",\n  \"stages\": [");
+    std::lock_guard<std::mutex> lock(mu_);
+    std::vector<uint64_t> buckets(kBuckets);
+    bool first = true;
+    for (int s = 0; s < static_cast<int>(ProfileStage::Count); ++s) {
+        uint64_t calls = 0, total_ns = 0, max_ns = 0;
+        int threads = 0;
+        std::fill(buckets.begin(), buckets.end(), 0);
+        for (const auto& shard : shards_) {
+            const Histogram& h = shard->stages[static_cast<size_t>(s)];
+            const uint64_t n = h.calls.load(relaxed);
+            if (n == 0) continue;
+            threads++;
+            calls += n;
+            total_ns += h.total_ns.load(relaxed);
+            max_ns = std::max(max_ns, h.max_ns.load(relaxed));
+            for (int b = 0; b < kBuckets; ++b) buckets[b] += h.buckets[static_cast<size_t>(b)].load(relaxed);
+        }
+        if (calls == 0) continue;
+        // The q-quantile call's bucket middle, never past the slowest call.
+        auto quantile_ms = [&](double q) {
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(calls) + 0.5));
+            uint64_t seen = 0;
+            for (int b = 0; b < kBuckets; ++b) {
+                seen += buckets[b];
+                if (seen >= rank) return std::min(BucketMid(b), static_cast<double>(max_ns)) * 1e-6;
+            }
+            return static_cast<double>(max_ns) * 1e-6;
+        };
+        const double total_ms = static_cast<double>(total_ns) * 1e-6;
+        w.raw(first ? "\n" : ",\n").raw("    {\"stage\": \"").raw(ProfileStageName(static_cast<ProfileStage>(s)));
+        w.raw("\", \"calls\": ").integer(static_cast<int64_t>(calls)).raw(", \"threads\": ").integer(threads);
+        w.raw(", \"totalMs\": ").fixed(total_ms, 3);
+        w.raw(", \"meanMs\": ").fixed(total_ms / static_cast<double>(calls), 3);
+        w.raw(", \"p50Ms\": ").fixed(quantile_ms(0.50), 3);
+        w.raw(", \"p95Ms\": ").fixed(quantile_ms(0.95), 3);
+        w.raw(", \"p99Ms\": ").fixed(quantile_ms(0.99), 3);
+        w.raw(", \"maxMs\": ").fixed(static_cast<double>(max_ns) * 1e-6, 3);
+        w.raw(", \"perSecond\": ").fixed(total_ms > 0.0 ? static_cast<double>(calls) * 1e3 / total_ms : 0.0, 2);
+        w.raw(", \"wallShare\": ").fixed(wall_s > 0.0 ? total_ms * 1e-3 / wall_s : 0.0, 3).ch('}');
+        first = false;
+    }
+    w.raw(first ? "]\n}\n" : "\n  ]\n}\n");
+    if (!w.flush() || std::fclose(file.release()) != 0) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool StageProfile::writeTrace(const std::string& path, std::string& error) const {
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "w"), &std::fclose);
+    if (!file) {
+        error = "cannot create " + path;
+        return false;
+    }
+    JsonWriter w(file.get());
+    w.raw("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    w.raw("  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"face_pipeline\"}}");
+    std::lock_guard<std::mutex> lock(mu_);
+    uint64_t dropped = 0;
+    for (size_t t = 0; t < shards_.size(); ++t) {
+        const Shard& shard = *shards_[t];
+        if (shard.spans.empty()) continue;
+        const int tid = static_cast<int>(t) + 1;
+        w.raw(",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": ").integer(tid);
+        w.raw(", \"args\": {\"name\": \"thread ").integer(tid).raw("\"}}");
+        for (const Span& span : shard.spans) {
+            // Microseconds, to the nanosecond.
+            w.raw(",\n  {\"name\": \"").raw(ProfileStageName(span.stage)).raw("\", \"ph\": \"X\", \"pid\": 1, \"tid\": ");
+            w.integer(tid).raw(", \"ts\": ").fixed(static_cast<double>(span.start_ns) * 1e-3, 3);
+            w.raw(", \"dur\": ").fixed(static_cast<double>(span.dur_ns) * 1e-3, 3);
+            if (span.frame >= 0) w.raw(", \"args\": {\"frame\": ").integer(span.frame).ch('}');
+            w.ch('}');
+        }
+        dropped += shard.dropped_spans;
+    }
+    w.raw("\n], \"otherData\": {\"droppedSpans\": ").integer(static_cast<int64_t>(dropped)).raw("}}\n");
+    if (!w.flush() || std::fclose(file.release()) != 0) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
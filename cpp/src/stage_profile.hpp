@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_stats.hpp"
+
+/**
+ * Kinds of work a run's time is profiled by (--profile).
+ */
+enum class ProfileStage {
+    Decode,     // reading and decoding a frame
+    Detect,     // SCRFD on a frame (full, tiled or regions)
+    Reid,       // MobileFaceNet embeddings of a frame's faces
+    Gmc,        // camera motion of a frame pair
+    Associate,  // OCSort::update of a frame
+    Link,       // offline tracklet linking and building the output tracks, once per run
+    Wait,       // the tracking loop waiting for its next frame
+    Count,
+};
+
+const char* ProfileStageName(ProfileStage stage);
+
+/**
+ * Per-stage timings of one or more runs: calls, total time and a latency
+ * histogram per stage, written out as JSON by write(). With setTrace() it
+ * also keeps every call as a span for writeTrace() (--trace).
+ *
+ * Cheap enough to leave on: a timed scope is two clock reads and a few
+ * stores into a shard of the calling thread's own (found through a
+ * thread_local cache, created under a lock the first time a thread
+ * records), so threads never contend. Latencies go into log-linear
+ * buckets, eight per power of two, so percentiles are within about 6%.
+ */
+class StageProfile {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Times a scope into `profile` (no timing if it is null), and counts
+     * its allocations against `stage` either way (AllocStats).
+     */
+    class Scope {
+    public:
+        Scope(StageProfile* profile, ProfileStage stage, int frame = -1)
+            : profile_(profile), stage_(stage), frame_(frame),
+              start_(profile ? Clock::now() : Clock::time_point()), counted_(stage) {}
+        ~Scope() {
+            if (profile_) profile_->record(stage_, start_, Clock::now(), frame_);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StageProfile* profile_;
+        ProfileStage stage_;
+        int frame_;
+        Clock::time_point start_;
+        AllocStats::Scope counted_;
+    };
+
+    StageProfile();
+
+    StageProfile(const StageProfile&) = delete;
+    StageProfile& operator=(const StageProfile&) = delete;
+
+    /**
+     * Keep every call as a trace span from now on. Set before the runs
+     * start; spans past kMaxSpansPerThread on a thread are only counted.
+     */
+    void setTrace(bool trace) { trace_ = trace; }
+
+    /** One call of `stage` from `start` to `end`, on input frame `frame` (-1 = none). */
+    void record(ProfileStage stage, Clock::time_point start, Clock::time_point end, int frame = -1);
+
+    /** Frames the runs went through, for the frames-per-second figures. */
+    void addFrames(int frames) { frames_.fetch_add(frames, std::memory_order_relaxed); }
+
+    /** Time spent in `stage` so far, over every thread. */
+    double totalMs(ProfileStage stage) const;
+
+    /**
+     * Write the profile as JSON: wall time since construction, frames and
+     * frames per second, then per stage the calls, threads that ran it,
+     * total / mean / p50 / p95 / p99 / max milliseconds, calls per second
+     * of its own time and its share of the wall time (over 1 when several
+     * threads run it).
+     *
+     * @return false (with `error`) if the file cannot be written
+     */
+    bool write(const std::string& path, std::string& error) const;
+
+    /**
+     * Write the spans (setTrace) in Chrome trace-event JSON, for Perfetto
+     * or chrome://tracing: one complete event per call, named by stage
+     * with its frame as an argument, on a track per thread that recorded.
+     * Call it once the runs are done.
+     *
+     * @return false (with `error`) if the file cannot be written
+     */
+    bool writeTrace(const std::string& path, std::string& error) const;
+
+    static constexpr int kBuckets = 8 + 61 * 8;  // 0-7 ns exactly, then 8 per power of two
+    static constexpr size_t kMaxSpansPerThread = size_t(1) << 20;  // about 24 MB a thread
+
+private:
+    struct Histogram {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+        std::array<std::atomic<uint32_t>, kBuckets> buckets{};
+    };
+    struct Span {
+        int64_t start_ns;  // since the profile's construction
+        int64_t dur_ns;
+        int32_t frame;
+        ProfileStage stage;
+    };
+    // Written by its thread only (relaxed loads and stores), read by write();
+    // the spans only by writeTrace(), after the runs.
+    struct Shard {
+        std::thread::id thread;
+        std::array<Histogram, static_cast<size_t>(ProfileStage::Count)> stages;
+        std::vector<Span> spans;
+        uint64_t dropped_spans = 0;
+    };
+
+    Shard& shard();
+
+    const uint64_t id_;  // tells the thread_local cache which profile it holds
+    const Clock::time_point start_;
+    std::atomic<int64_t> frames_{0};
+    bool trace_ = false;
+    mutable std::mutex mu_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
@@ -1,5 +1,8 @@
-// Single compilation unit for stb_image implementation
-// This prevents duplicate symbol errors when multiple files include stb_image.h
+// Single compilation unit for the stb_image / stb_image_write implementations
+// This prevents duplicate symbol errors when multiple files include the headers
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
@@ -0,0 +1,226 @@
+#include "streaming.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "image_ops.hpp"
+
+bool PushFrameSource::push(const uint8_t* rgb, int width, int height) {
+    if (!rgb || width <= 0 || height <= 0) return false;
+    const size_t bytes = static_cast<size_t>(width) * static_cast<size_t>(height) * 3u;
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this] { return closed_ || static_cast<int>(queue_.size()) < depth_; });
+    if (closed_) return false;
+    Pending p;
+    if (!spare_.empty()) {
+        p.rgb = std::move(spare_.back());
+        spare_.pop_back();
+    }
+    lock.unlock();
+    p.rgb.resize(bytes);
+    std::memcpy(p.rgb.data(), rgb, bytes);
+    p.w = width;
+    p.h = height;
+    lock.lock();
+    if (closed_) return false;
+    queue_.push_back(std::move(p));
+    cv_.notify_all();
+    return true;
+}
+
+void PushFrameSource::close() {
+    std::lock_guard<std::mutex> lock(mu_);
+    closed_ = true;
+    cv_.notify_all();
+}
+
+bool PushFrameSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    out.clear();
+    std::unique_lock<std::mutex> lock(mu_);
+    if (index != next_index_ || end_index_.load() >= 0) return false;
+    cv_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) {
+        end_index_ = index;
+        return false;
+    }
+    Pending p = std::move(queue_.front());
+    queue_.pop_front();
+    next_index_++;
+    cv_.notify_all();
+    lock.unlock();
+
+    out.w = p.w;
+    out.h = p.h;
+    if (req.luma_downscale > 0) {
+        RgbToLumaDownsample(p.rgb.data(), p.w, p.h, req.luma_downscale, out.luma);
+        out.luma_w = DownscaledSize(p.w, req.luma_downscale);
+        out.luma_h = DownscaledSize(p.h, req.luma_downscale);
+        out.luma_scale = req.luma_downscale;
+    }
+    if (req.rgb) {
+        // The frame's buffer moves on; the one it replaces is kept for reuse.
+        out.rgb.swap(p.rgb);
+        out.rgb_w = p.w;
+        out.rgb_h = p.h;
+    }
+    lock.lock();
+    if (p.rgb.capacity() > 0 && static_cast<int>(spare_.size()) < depth_) spare_.push_back(std::move(p.rgb));
+    return true;
+}
+
+StreamingPipeline::StreamingPipeline(FacePipeline& pipeline, float video_fps, TrackSegmentSink on_segment,
+                                     int queue_depth)
+    : source_(queue_depth) {
+    worker_ = std::thread([this, &pipeline, video_fps, sink = std::move(on_segment)] {
+        result_ = pipeline.process(source_, video_fps, sink);
+        source_.close();  // a pipeline that stopped early must not leave pushFrame() waiting
+    });
+}
+
+StreamingPipeline::~StreamingPipeline() { finish(); }
+
+bool StreamingPipeline::pushFrame(const uint8_t* rgb, int width, int height) {
+    if (finished_) return false;
+    return source_.push(rgb, width, height);
+}
+
+PipelineResult StreamingPipeline::finish() {
+    if (finished_) return PipelineResult{};
+    finished_ = true;
+    source_.close();
+    if (worker_.joinable()) worker_.join();
+    return std::move(result_);
+}
+
+LivePipeline::LivePipeline(FacePipeline& pipeline, float video_fps, LiveFrameSink on_frame, const LiveConfig& config)
+    : config_(config), on_frame_(std::move(on_frame)) {
+    worker_ = std::thread([this, &pipeline, video_fps] { run(pipeline, video_fps); });
+}
+
+LivePipeline::~LivePipeline() { finish(); }
+
+bool LivePipeline::pushFrame(const uint8_t* rgb, int width, int height) {
+    if (!rgb || width <= 0 || height <= 0) return false;
+    const size_t bytes = static_cast<size_t>(width) * static_cast<size_t>(height) * 3u;
+    std::lock_guard<std::mutex> lock(mu_);
+    if (closed_) return false;
+    // Copied under the lock: the worker only holds it to swap buffers (the
+    // one it gives back is the frame it took last, reused here), and a frame
+    // it has not taken yet is overwritten anyway.
+    pending_.resize(bytes);
+    std::memcpy(pending_.data(), rgb, bytes);
+    pending_w_ = width;
+    pending_h_ = height;
+    pending_index_ = next_index_++;
+    pending_at_ = Clock::now();
+    cv_.notify_all();
+    return true;
+}
+
+LiveStats LivePipeline::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+    if (worker_.joinable()) worker_.join();
+    return stats_;
+}
+
+void LivePipeline::run(FacePipeline& pipeline, float video_fps) {
+    const RunTuning tuning = pipeline.tuning();
+    const PipelineOptions& options = tuning.tracking;
+    const float fps = video_fps > 0.0f ? video_fps : 30.0f;
+    const double budget_ms = 1000.0 * config_.latency_frames / fps;
+    const int full_side = options.detector_input;
+    const int min_side = std::min(full_side, std::max(32, config_.min_detector_input));
+    const int max_gap = config_.max_detect_gap > 0
+                            ? config_.max_detect_gap
+                            : std::max(1, static_cast<int>(fps / std::max(0.1f, tuning.detection_fps)));
+    OCSort tracker(tuning.iou_thresh, options.track_max_age, 2, 3, options.track_inertia);
+    tracker.setJosephUpdate(options.kalman_joseph);
+
+    std::vector<uint8_t> rgb;
+    std::vector<TrackResult> tracks;
+    const std::vector<Detection> none;
+    double ms_per_pixel = 0.0;  // detector cost per input pixel, measured (0 = not yet)
+    int taken = -1;             // index of the last frame taken
+    int last_detection = -max_gap;
+    LiveFrame out;
+    auto hand_over = [&](LiveFrame& frame, Clock::time_point pushed) {
+        frame.tracks.clear();
+        for (const TrackResult& t : tracks) {
+            if (t.time_since_update <= max_gap) frame.tracks.push_back(t);
+        }
+        frame.latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - pushed).count();
+        stats_.frames++;
+        if (frame.latency_ms > budget_ms) stats_.late++;
+        stats_.max_latency_ms = std::max(stats_.max_latency_ms, frame.latency_ms);
+        if (on_frame_) on_frame_(frame);
+    };
+    for (;;) {
+        int index = -1;
+        int w = 0;
+        int h = 0;
+        Clock::time_point pushed;
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            cv_.wait(lock, [this] { return closed_ || pending_index_ >= 0; });
+            if (pending_index_ < 0) break;
+            rgb.swap(pending_);
+            index = pending_index_;
+            w = pending_w_;
+            h = pending_h_;
+            pushed = pending_at_;
+            pending_index_ = -1;
+        }
+
+        // Frames replaced while this one was being handled: predictions only.
+        // Their latency counts from the frame that replaced them.
+        for (int d = taken + 1; d < index; ++d) {
+            tracker.update(none, tracks, true);
+            out = LiveFrame{};
+            out.frame_index = d;
+            out.dropped = true;
+            stats_.dropped++;
+            hand_over(out, pushed);
+        }
+        taken = index;
+
+        // What is left of this frame's budget decides the detector input.
+        const double left_ms = budget_ms - std::chrono::duration<double, std::milli>(Clock::now() - pushed).count();
+        int side = 0;
+        if (ms_per_pixel <= 0.0) {
+            side = min_side;  // the first detection measures the cost
+        } else if (left_ms > 0.0) {
+            // A fifth of what is left stays for the tracker, the hand-over
+            // and the estimate's noise.
+            const int fit = static_cast<int>(std::sqrt(0.8 * left_ms / ms_per_pixel)) / 32 * 32;
+            if (fit >= min_side) side = std::min(full_side, fit);
+        }
+        if (side == 0 && index - last_detection >= max_gap) side = min_side;
+
+        out = LiveFrame{};
+        out.frame_index = index;
+        if (side > 0) {
+            const Clock::time_point start = Clock::now();
+            std::vector<Detection> dets =
+                pipeline.detectRgb(rgb.data(), w, h, nullptr, side < full_side ? side : 0);
+            const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            const double sample = ms / (static_cast<double>(side) * side);
+            ms_per_pixel = ms_per_pixel > 0.0 ? 0.8 * ms_per_pixel + 0.2 * sample : sample;
+            tracker.update(dets, tracks, true);
+            last_detection = index;
+            out.detected = true;
+            out.detector_input = side;
+            stats_.detected++;
+            if (side < full_side) stats_.reduced++;
+        } else {
+            tracker.update(none, tracks, true);
+        }
+        hand_over(out, pushed);
+    }
+    stats_.tracks = tracker.tracksStarted();
+}
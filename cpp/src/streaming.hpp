@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_source.hpp"
+#include "pipeline.hpp"
+
+/**
+ * Frames handed over one at a time by the application (see
+ * StreamingPipeline).
+ *
+ * push() queues a copy of an RGB frame, blocking while `depth` frames are
+ * waiting; read() takes them in order, blocking until the next one arrives.
+ * The stream ends at close().
+ */
+class PushFrameSource final : public FrameSource {
+public:
+    explicit PushFrameSource(int depth = 4) : depth_(depth < 1 ? 1 : depth) {}
+
+    /**
+     * Queue interleaved RGB `rgb` (width x height).
+     *
+     * @return false once the source is closed, or for an empty frame
+     */
+    bool push(const uint8_t* rgb, int width, int height);
+
+    /** End of stream: read() fails past the frames already queued. */
+    void close();
+
+    int frameCount() const override { return -1; }
+    bool randomAccess() const override { return false; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    int endIndex() const override { return end_index_.load(); }
+
+private:
+    struct Pending {
+        std::vector<uint8_t> rgb;
+        int w = 0;
+        int h = 0;
+    };
+
+    const int depth_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Pending> queue_;
+    std::vector<std::vector<uint8_t>> spare_;  // buffers of frames already read, for reuse
+    bool closed_ = false;
+    int next_index_ = 0;
+    std::atomic<int> end_index_{-1};
+};
+
+/**
+ * Push-based tracking with memory bounded by the number of tracks rather
+ * than the length of the video.
+ *
+ * Frames go in with pushFrame() as the application produces them; the
+ * pipeline runs on a thread of its own and hands each tracklet to
+ * `on_segment` as soon as the tracker drops it (see TrackSegmentSink).
+ * finish() ends the stream, runs offline linking over every tracklet and
+ * returns the tracks still open plus how the streamed segments were linked
+ * (PipelineResult::segment_links).
+ *
+ * Usage:
+ *   FacePipeline pipeline(model_dir);
+ *   StreamingPipeline stream(pipeline, 30.0f, [](const FaceTrack& s) { ... });
+ *   while (next frame) stream.pushFrame(rgb, w, h);
+ *   PipelineResult rest = stream.finish();
+ */
+class StreamingPipeline {
+public:
+    /**
+     * @param pipeline Loaded pipeline; must outlive this object
+     * @param video_fps Frame rate of the pushed frames (detection stride)
+     * @param on_segment Called on the pipeline's thread
+     * @param queue_depth Frames pushed ahead of the pipeline before pushFrame() blocks
+     */
+    StreamingPipeline(FacePipeline& pipeline, float video_fps, TrackSegmentSink on_segment, int queue_depth = 4);
+    ~StreamingPipeline();
+
+    StreamingPipeline(const StreamingPipeline&) = delete;
+    StreamingPipeline& operator=(const StreamingPipeline&) = delete;
+
+    /**
+     * Queue the next frame (copied).
+     *
+     * @return false after finish()
+     */
+    bool pushFrame(const uint8_t* rgb, int width, int height);
+
+    /**
+     * End the stream and wait for the pipeline. Only the first call returns
+     * the result; later ones return an empty one.
+     */
+    PipelineResult finish();
+
+private:
+    PushFrameSource source_;
+    PipelineResult result_;
+    bool finished_ = false;
+    std::thread worker_;  // declared last: it uses the members above
+};
+
+/**
+ * Settings of a LivePipeline (--live).
+ */
+struct LiveConfig {
+    float latency_frames = 1.5f;   // a frame's boxes are due this many frame periods after pushFrame()
+    int min_detector_input = 192;  // smallest SCRFD input side the budget may shrink detection to
+    int max_detect_gap = 0;        // detect at least every this many frames, past the budget if need be (0 = the detection stride)
+};
+
+/**
+ * One frame's output of a LivePipeline.
+ */
+struct LiveFrame {
+    int frame_index = 0;
+    bool detected = false;     // the detector ran on this frame
+    bool dropped = false;      // a newer frame replaced it before it was taken: its boxes are predictions
+    int detector_input = 0;    // SCRFD input side of the detection (0 = not detected)
+    double latency_ms = 0.0;   // pushFrame() to the hand-over
+    std::vector<TrackResult> tracks;  // tracks seen within the detection gap, normalized boxes, by track id
+};
+
+using LiveFrameSink = std::function<void(const LiveFrame& frame)>;
+
+/**
+ * What a LivePipeline did, for the summary at finish().
+ */
+struct LiveStats {
+    int frames = 0;      // frames handed over, dropped ones included
+    int detected = 0;    // frames the detector ran on
+    int reduced = 0;     // of those, at a smaller input to fit the budget
+    int dropped = 0;     // frames replaced by newer ones before they were taken
+    int late = 0;        // frames handed over past the latency budget
+    int tracks = 0;      // tracks started
+    double max_latency_ms = 0.0;
+};
+
+/**
+ * Real-time tracking of a live feed within a fixed latency budget.
+ *
+ * Unlike StreamingPipeline nothing queues: pushFrame() never blocks, and a
+ * frame still waiting when the next one arrives is dropped (its boxes, the
+ * tracker's predictions, go out with the next frame's). Each frame taken
+ * runs online OC-SORT without camera motion or ReID. The detector runs
+ * whenever what is left of the frame's budget fits it: its cost per input
+ * pixel is measured as it goes (from a first detection at the smallest
+ * side), and the input side shrinks (down to LiveConfig::min_detector_input)
+ * to fit. Past max_detect_gap frames without
+ * a detection it runs anyway at the smallest side, so tracks are not lost
+ * on a machine too slow for the budget. Tracker IDs are final: there is no
+ * offline linking.
+ *
+ * Usage:
+ *   LivePipeline live(pipeline, 30.0f, [](const LiveFrame& f) { ... });
+ *   while (capture) live.pushFrame(rgb, w, h);
+ *   LiveStats stats = live.finish();
+ */
+class LivePipeline {
+public:
+    /**
+     * @param pipeline Loaded pipeline (its detector, tracker thresholds and
+     *                 detection stride); must outlive this object
+     * @param video_fps Frame rate of the feed (the latency budget's frame period)
+     * @param on_frame Called on the pipeline's thread, in frame order
+     */
+    LivePipeline(FacePipeline& pipeline, float video_fps, LiveFrameSink on_frame,
+                 const LiveConfig& config = LiveConfig{});
+    ~LivePipeline();
+
+    LivePipeline(const LivePipeline&) = delete;
+    LivePipeline& operator=(const LivePipeline&) = delete;
+
+    /**
+     * Hand over the next frame (copied), replacing one still waiting.
+     *
+     * @return false after finish(), or for an empty frame
+     */
+    bool pushFrame(const uint8_t* rgb, int width, int height);
+
+    /** End the feed, wait for the frame in hand and return the statistics. */
+    LiveStats finish();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run(FacePipeline& pipeline, float video_fps);
+
+    const LiveConfig config_;
+    const LiveFrameSink on_frame_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::vector<uint8_t> pending_;  // the newest frame not taken yet (or the buffer of the one taken last)
+    int pending_w_ = 0;
+    int pending_h_ = 0;
+    int pending_index_ = -1;        // -1 = none waiting
+    Clock::time_point pending_at_;
+    int next_index_ = 0;
+    bool closed_ = false;
+    LiveStats stats_;
+    std::thread worker_;  // declared last: it uses the members above
+};
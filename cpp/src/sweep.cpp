@@ -0,0 +1,110 @@
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include "thread_pool.hpp"
+
+namespace {
+// Track quality proxies of one run's output against its dump.
+void ScoreTracks(const PipelineResult& result, const DetectionDump& dump, SweepReport& report) {
+    report.tracks = static_cast<int>(result.tracks.size());
+    report.frame_count = result.frame_count;
+    for (const TrackerInputFrame& f : dump.frames) {
+        if (!f.duplicate) report.detections += static_cast<int>(f.dets.size());
+    }
+    std::vector<std::vector<BBox>> boxes(static_cast<size_t>(std::max(result.frame_count, 0)));
+    for (const FaceTrack& track : result.tracks) {
+        report.output_frames += static_cast<int>(track.frames.size());
+        for (const TrackFrame& tf : track.frames) {
+            if (tf.observed) report.observed_frames++;
+            if (tf.frame_index >= 0 && tf.frame_index < result.frame_count) {
+                boxes[tf.frame_index].push_back(tf.bbox);
+            }
+        }
+    }
+    // A track box is at most one per track and frame, so any pair is two tracks.
+    for (const std::vector<BBox>& frame : boxes) {
+        for (size_t a = 0; a < frame.size(); ++a) {
+            for (size_t b = a + 1; b < frame.size(); ++b) {
+                if (frame[a].iou(frame[b]) >= 0.5f) report.overlaps++;
+            }
+        }
+    }
+    report.mean_track_frames = report.tracks > 0 ? static_cast<double>(report.output_frames) / report.tracks : 0.0;
+}
+}  // namespace
+
+std::vector<SweepConfig> ExpandSweep(const SweepConfig& base,
+                                     const std::vector<float>& iou_thresh,
+                                     const std::vector<int>& max_age,
+                                     const std::vector<float>& inertia,
+                                     const std::vector<float>& reid_weight,
+                                     const std::vector<float>& reid_cos_thresh) {
+    auto or_base = [](const auto& values, auto value) {
+        return values.empty() ? std::vector<decltype(value)>{value} : values;
+    };
+    std::vector<SweepConfig> configs;
+    for (float iou : or_base(iou_thresh, base.iou_thresh)) {
+        for (int age : or_base(max_age, base.max_age)) {
+            for (float in : or_base(inertia, base.inertia)) {
+                for (float w : or_base(reid_weight, base.reid_weight)) {
+                    for (float cos : or_base(reid_cos_thresh, base.reid_cos_thresh)) {
+                        configs.push_back(SweepConfig{iou, age, in, w, cos});
+                    }
+                }
+            }
+        }
+    }
+    return configs;
+}
+
+bool RunParameterSweep(const std::string& dump_path,
+                       const std::vector<SweepConfig>& configs,
+                       float conf_thresh,
+                       float detection_fps,
+                       float video_fps,
+                       const PipelineOptions& options,
+                       int workers,
+                       std::vector<SweepReport>& reports,
+                       std::string& error) {
+    auto dump = std::make_shared<DetectionDump>();
+    if (!dump->load(dump_path, error)) return false;
+    if (!dump->warps) {
+        error = dump_path + " has no GMC warps; sweeps need a dump made with --dump-warps";
+        return false;
+    }
+
+    PipelineOptions run_options = options;
+    run_options.replay = dump;
+    run_options.replay_detections_path.clear();
+    run_options.track_workers = 1;  // the configurations are the parallel work
+    run_options.gallery_path.clear();
+    run_options.checkpoint_path.clear();
+    run_options.dump_detections_path.clear();
+    run_options.detection_cache_path.clear();
+
+    reports.assign(configs.size(), SweepReport{});
+    const int max_parallel = workers > 0 ? workers : PipelineCoreCount();
+    ThreadPool::Shared().parallelFor(static_cast<int>(configs.size()), max_parallel, [&](int c) {
+        const SweepConfig& config = configs[c];
+        PipelineOptions config_options = run_options;
+        config_options.track_max_age = config.max_age;
+        config_options.track_inertia = config.inertia;
+        FacePipeline pipeline("", conf_thresh, detection_fps, config.iou_thresh, "", config.reid_weight,
+                              config.reid_cos_thresh, config_options);
+        const std::vector<std::string> no_paths;
+        ImageListSource source(no_paths);
+
+        const auto start = std::chrono::steady_clock::now();
+        const PipelineResult result = pipeline.process(source, video_fps);
+        const auto end = std::chrono::steady_clock::now();
+
+        SweepReport& report = reports[c];
+        report.config = config;
+        report.ms = std::chrono::duration<double, std::milli>(end - start).count();
+        ScoreTracks(result, *dump, report);
+    });
+    return true;
+}
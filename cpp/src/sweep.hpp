@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "pipeline.hpp"
+
+/**
+ * Tracking parameter sweeps over a detection dump (--sweep).
+ *
+ * The dump (--dump-detections with --dump-warps) is read once and shared:
+ * each configuration replays it through OC-SORT and offline linking with
+ * its own settings, and configurations run concurrently, one per core.
+ * Nothing is labelled, so a configuration is scored by proxies for track
+ * quality: how much of the detected evidence its tracks explain, how
+ * fragmented they are, and how often two tracks cover the same face.
+ */
+struct SweepConfig {
+    float iou_thresh = 0.15f;
+    int max_age = 90;
+    float inertia = 0.2f;
+    float reid_weight = 0.35f;
+    float reid_cos_thresh = 0.35f;
+};
+
+/**
+ * Every combination of the given values. An empty list keeps `base`'s
+ * value for that parameter.
+ */
+std::vector<SweepConfig> ExpandSweep(const SweepConfig& base,
+                                     const std::vector<float>& iou_thresh,
+                                     const std::vector<int>& max_age,
+                                     const std::vector<float>& inertia,
+                                     const std::vector<float>& reid_weight,
+                                     const std::vector<float>& reid_cos_thresh);
+
+/**
+ * Outcome of one configuration.
+ */
+struct SweepReport {
+    SweepConfig config;
+    int tracks = 0;
+    int output_frames = 0;      // track boxes over all tracks
+    int observed_frames = 0;    // of those, boxes a detection updated
+    int detections = 0;         // detections in the dump
+    int overlaps = 0;           // same-frame box pairs of two tracks at IoU >= 0.5
+    double mean_track_frames = 0.0;
+    double ms = 0.0;            // tracking and linking time
+    int frame_count = 0;
+
+    /** Fraction of the dump's detections a track kept. */
+    double coverage() const { return detections > 0 ? static_cast<double>(observed_frames) / detections : 0.0; }
+    double fps() const { return ms > 0.0 ? frame_count * 1000.0 / ms : 0.0; }
+};
+
+/**
+ * Replay the dump at `dump_path` once per configuration. `options` apply to
+ * every run (scene cuts, smoothing, linking limits); outputs with side
+ * effects (gallery, checkpoints, dumps) are not written.
+ *
+ * @param workers configurations run at once (0 = one per core)
+ * @return false with `error` set if the dump cannot be read or has no warps
+ */
+bool RunParameterSweep(const std::string& dump_path,
+                       const std::vector<SweepConfig>& configs,
+                       float conf_thresh,
+                       float detection_fps,
+                       float video_fps,
+                       const PipelineOptions& options,
+                       int workers,
+                       std::vector<SweepReport>& reports,
+                       std::string& error);
@@ -0,0 +1,187 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "cpu.h"
+#include "numa.hpp"
+
+#ifdef __APPLE__
+#include <pthread/qos.h>
+#endif
+
+namespace {
+std::atomic<int> g_powersave{0};
+
+// Index of the pool thread running this code (-1 elsewhere), and its pool.
+thread_local int t_pool_index = -1;
+thread_local ThreadPool* t_pool = nullptr;
+
+// NUMA node the calling thread is bound to (-1 none, -2 not looked up yet).
+thread_local int t_numa_node = -2;
+
+// Per-node pools once UseNumaPools() ran; read-only afterwards.
+std::vector<std::unique_ptr<ThreadPool>> g_node_pools;
+std::atomic<bool> g_numa_pools{false};
+}  // namespace
+
+void SetCpuPowersave(CpuPowersave mode) {
+    g_powersave = static_cast<int>(mode);
+    ncnn::set_cpu_powersave(static_cast<int>(mode));
+#ifdef __APPLE__
+    ConfigureWorkerThread();  // the calling (main) thread too
+#endif
+}
+
+CpuPowersave GetCpuPowersave() {
+    return static_cast<CpuPowersave>(g_powersave.load());
+}
+
+int PipelineCoreCount() {
+    int n = 0;
+    switch (GetCpuPowersave()) {
+        case CpuPowersave::Efficiency: n = ncnn::get_little_cpu_count(); break;
+        case CpuPowersave::Performance: n = ncnn::get_big_cpu_count(); break;
+        default: n = ncnn::get_cpu_count(); break;
+    }
+    // Not every platform reports little cores; fall back to all of them.
+    if (n <= 0) n = ncnn::get_cpu_count();
+    if (n <= 0) n = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(1, n);
+}
+
+void ConfigureWorkerThread() {
+#ifdef __APPLE__
+    // macOS places threads by QoS class rather than affinity.
+    switch (GetCpuPowersave()) {
+        case CpuPowersave::Efficiency: pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0); break;
+        case CpuPowersave::Performance: pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0); break;
+        default: pthread_set_qos_class_self_np(QOS_CLASS_USER_INITIATED, 0); break;
+    }
+#endif
+}
+
+ThreadPool::ThreadPool(int num_threads, int numa_node) : numa_node_(numa_node) {
+    const int n = std::max(0, num_threads);
+    // One queue per pool thread plus a shared one for outside callers.
+    for (int i = 0; i <= n; ++i) queues_.push_back(std::make_unique<Queue>());
+    workers_.reserve(static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+ThreadPool& ThreadPool::Shared() {
+    // Pool threads fan out on their own pool, whichever it is.
+    if (t_pool) return *t_pool;
+    if (g_numa_pools.load()) {
+        if (t_numa_node == -2) t_numa_node = CurrentNumaNode();
+        if (t_numa_node >= 0) return *g_node_pools[static_cast<size_t>(t_numa_node)];
+    }
+    // The caller of parallelFor() is the remaining core.
+    static ThreadPool pool(PipelineCoreCount() - 1);
+    return pool;
+}
+
+void ThreadPool::UseNumaPools() {
+    if (g_numa_pools.load() || NumaNodeCount() < 2) return;
+    for (int node = 0; node < NumaNodeCount(); ++node) {
+        const int cpus = static_cast<int>(NumaNodeCpus(node).size());
+        g_node_pools.push_back(std::make_unique<ThreadPool>(cpus - 1, node));
+    }
+    g_numa_pools = true;
+}
+
+void ThreadPool::push(std::function<void()> task) {
+    // Pool threads queue nested work on their own deque; others spread it.
+    const size_t q = t_pool == this ? static_cast<size_t>(t_pool_index) : next_queue_++ % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[q]->mu);
+        queues_[q]->tasks.push_back(std::move(task));
+    }
+    queued_++;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+    }
+    cv_.notify_one();
+}
+
+bool ThreadPool::runOne() {
+    if (queued_.load() == 0) return false;
+    const size_t n = queues_.size();
+    const size_t self = t_pool == this ? static_cast<size_t>(t_pool_index) : n - 1;
+    std::function<void()> task;
+    for (size_t k = 0; k < n && !task; ++k) {
+        Queue& q = *queues_[(self + k) % n];
+        std::lock_guard<std::mutex> lock(q.mu);
+        if (q.tasks.empty()) continue;
+        if (k == 0) {
+            task = std::move(q.tasks.back());  // own: newest first (still cache-warm)
+            q.tasks.pop_back();
+        } else {
+            task = std::move(q.tasks.front());  // steal: oldest first
+            q.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    queued_--;
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(int self) {
+    t_pool_index = self;
+    t_pool = this;
+    if (numa_node_ >= 0) BindThreadToNumaNode(numa_node_);
+    ConfigureWorkerThread();
+    for (;;) {
+        if (runOne()) continue;
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+        if (stop_) return;
+    }
+}
+
+void ThreadPool::parallelFor(int n, int max_parallel, const std::function<void(int)>& fn) {
+    if (n <= 0) return;
+    const int runners = std::min({n, std::max(1, max_parallel), numThreads() + 1});
+    if (runners <= 1) {
+        for (int i = 0; i < n; ++i) fn(i);
+        return;
+    }
+
+    struct Job {
+        std::atomic<int> next{0};
+        std::atomic<int> active{0};
+        std::mutex mu;
+        std::condition_variable done;
+    };
+    auto job = std::make_shared<Job>();
+    job->active = runners;
+    auto run = [job, n, &fn] {
+        for (int i = job->next++; i < n; i = job->next++) fn(i);
+        if (--job->active == 0) {
+            std::lock_guard<std::mutex> lock(job->mu);
+            job->done.notify_all();
+        }
+    };
+    for (int k = 1; k < runners; ++k) push(run);
+    run();
+    // Help with queued work (ours or not) until every runner has finished.
+    while (job->active.load() > 0) {
+        if (runOne()) continue;
+        std::unique_lock<std::mutex> lock(job->mu);
+        job->done.wait_for(lock, std::chrono::milliseconds(1), [&] { return job->active.load() == 0; });
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Which cores the pipeline runs on (--cpu-powersave).
+ */
+enum class CpuPowersave {
+    All = 0,          // every core (default)
+    Efficiency = 1,   // little / efficiency cores only
+    Performance = 2,  // big / performance cores only
+};
+
+/**
+ * Apply a core policy once, before models load: ncnn binds its own worker
+ * threads accordingly (set_cpu_powersave; a no-op where it cannot bind,
+ * e.g. macOS), pipeline threads take the matching QoS class on macOS, and
+ * PipelineCoreCount() counts only the selected cores.
+ */
+void SetCpuPowersave(CpuPowersave mode);
+CpuPowersave GetCpuPowersave();
+
+/**
+ * Cores every stage's thread quota is derived from (at least 1). Counts
+ * big or little cores separately when ncnn can tell them apart.
+ */
+int PipelineCoreCount();
+
+/**
+ * Call first thing on every pipeline-owned thread (QoS class on macOS).
+ */
+void ConfigureWorkerThread();
+
+/**
+ * Work-stealing pool shared by the compute stages that fan out per call
+ * (ReID batches, detector tiles), so their helpers come from one set of
+ * PipelineCoreCount() - 1 threads instead of being spawned per frame.
+ *
+ * Each thread owns a task deque: it pops its own newest task and steals
+ * the oldest one of another thread when empty. A caller waiting for its
+ * parallelFor() runs queued tasks meanwhile, so nested calls from pool
+ * threads cannot deadlock. Long-lived, blocking stages (decode prefetch,
+ * detection workers) keep their own threads.
+ */
+class ThreadPool {
+public:
+    /** `numa_node` >= 0 binds the pool's threads to that node. */
+    explicit ThreadPool(int num_threads, int numa_node = -1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int numThreads() const { return static_cast<int>(workers_.size()); }
+
+    /**
+     * Run fn(0) ... fn(n - 1) on at most `max_parallel` threads (the
+     * stage's quota, caller included) and return when all are done.
+     */
+    void parallelFor(int n, int max_parallel, const std::function<void(int)>& fn);
+
+    /**
+     * The pipeline-wide pool, created on first use. Pool threads get their
+     * own pool, and after UseNumaPools() threads bound to one NUMA node get
+     * that node's.
+     */
+    static ThreadPool& Shared();
+
+    /**
+     * Create a pool per NUMA node, of the node's cores but one (no-op on a
+     * single node). Call once, before any thread is bound to a node.
+     */
+    static void UseNumaPools();
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void push(std::function<void()> task);
+    bool runOne();  // own newest task, else steal; false if every queue is empty
+    void workerLoop(int self);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::atomic<int> queued_{0};
+    std::atomic<unsigned> next_queue_{0};
+    int numa_node_ = -1;
+    bool stop_ = false;
+};
@@ -0,0 +1,40 @@
+#include "time_budget.hpp"
+
+namespace {
+// Share of the budget the frame loop may use; linking, smoothing and the
+// output get the rest.
+constexpr double kLoopShare = 0.9;
+// A level is measured over at least this many frames and seconds before
+// the next step, so the scheduler's look-ahead at the old level and model
+// warm-up do not count against it.
+constexpr int kStepFrames = 15;
+constexpr double kStepSeconds = 0.25;
+}  // namespace
+
+TimeBudget::TimeBudget(double seconds, bool degrade)
+    : seconds_(seconds),
+      loop_seconds_(seconds * kLoopShare),
+      degrade_(degrade),
+      start_(std::chrono::steady_clock::now()) {}
+
+double TimeBudget::elapsed() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+}
+
+void TimeBudget::observe(int done, int total) {
+    const double now = elapsed();
+    if (now >= loop_seconds_) {
+        expired_ = true;
+        return;
+    }
+    const int level = this->level();
+    if (!degrade_ || total < 0 || level == NoGmc) return;
+    const int step_frames = done - since_[level];
+    const double step_seconds = now - step_elapsed_;
+    if (step_frames < kStepFrames || step_seconds < kStepSeconds) return;
+    const double projected = now + step_seconds / step_frames * (total - done);
+    if (projected <= loop_seconds_) return;
+    level_.store(level + 1, std::memory_order_relaxed);
+    since_[level + 1] = done;
+    step_elapsed_ = now;
+}
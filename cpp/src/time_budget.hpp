@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * Wall-clock budget of a run (PipelineOptions::time_budget_s).
+ *
+ * The frame loop reports each frame; the budget projects from the time per
+ * frame so far when the loop will be done. While that is past the loop's
+ * share of the budget (the rest is kept for linking and output), it gives
+ * up quality one step at a time, each step measured over some frames before
+ * the next:
+ *
+ *   1. HalfDetection: every other sampled frame goes undetected (and ROI
+ *      crops are no longer detected in between);
+ *   2. NoReid: faces are no longer embedded;
+ *   3. NoGmc: camera motion is no longer estimated.
+ *
+ * Once the loop's share is spent the budget has expired and the run stops
+ * reading frames. Without `degrade` (a plain timeout) the level stays Full;
+ * with an unknown frame count there is nothing to project and only the
+ * deadline applies. Worker threads may read level() while the loop reports.
+ */
+class TimeBudget {
+public:
+    enum Level { Full, HalfDetection, NoReid, NoGmc };
+
+    /**
+     * @param seconds Wall-clock time the run may take, from now
+     * @param degrade Lower the level when the run would not fit
+     */
+    TimeBudget(double seconds, bool degrade);
+
+    /**
+     * Report the frame loop's progress and update level() and expired().
+     *
+     * @param done Frames the loop has finished
+     * @param total Frames it will read (-1 = unknown)
+     */
+    void observe(int done, int total);
+
+    int level() const { return level_.load(std::memory_order_relaxed); }
+    bool degraded(Level at_least) const { return level() >= at_least; }
+    bool expired() const { return expired_; }
+    double seconds() const { return seconds_; }
+
+    /** Frames done when `level` began (-1 = not reached). */
+    int since(Level level) const { return since_[level]; }
+
+private:
+    double elapsed() const;
+
+    double seconds_;
+    double loop_seconds_;
+    bool degrade_;
+    std::chrono::steady_clock::time_point start_;
+    std::atomic<int> level_{Full};
+    bool expired_ = false;
+    int since_[NoGmc + 1] = {0, -1, -1, -1};  // frames done when each level began
+    double step_elapsed_ = 0.0;  // seconds into the run when the current one did
+};
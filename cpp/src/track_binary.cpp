@@ -0,0 +1,139 @@
+#include "track_binary.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#ifdef FACE_PIPELINE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+constexpr char kMagic[8] = {'F', 'P', 'T', 'R', 'A', 'C', 'K', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kFlagZstd = 1;
+constexpr uint32_t kFlagStopped = 2;
+
+// Appends little-endian fields whatever the host's byte order.
+class Bytes {
+public:
+    void u8(uint8_t v) { out_.push_back(v); }
+    void u16(uint16_t v) {
+        out_.push_back(static_cast<uint8_t>(v));
+        out_.push_back(static_cast<uint8_t>(v >> 8));
+    }
+    void u32(uint32_t v) {
+        for (int s = 0; s < 32; s += 8) out_.push_back(static_cast<uint8_t>(v >> s));
+    }
+    void i32(int32_t v) { u32(static_cast<uint32_t>(v)); }
+    void u64(uint64_t v) {
+        for (int s = 0; s < 64; s += 8) out_.push_back(static_cast<uint8_t>(v >> s));
+    }
+    void align4() {
+        while (out_.size() % 4 != 0) out_.push_back(0);
+    }
+    void raw(const char* p, size_t n) { out_.insert(out_.end(), p, p + n); }
+
+    std::vector<uint8_t>& data() { return out_; }
+
+private:
+    std::vector<uint8_t> out_;
+};
+
+uint16_t QuantizeUnit16(float v) {
+    return static_cast<uint16_t>(std::lround(std::max(0.0f, std::min(1.0f, v)) * 65535.0f));
+}
+
+uint8_t QuantizeUnit8(float v) {
+    return static_cast<uint8_t>(std::lround(std::max(0.0f, std::min(1.0f, v)) * 255.0f));
+}
+
+void PutTrack(Bytes& b, const FaceTrack& track) {
+    const std::vector<TrackFrame>& frames = track.frames;
+    std::vector<std::pair<int, uint32_t>> runs;
+    for (const TrackFrame& f : frames) {
+        if (!runs.empty() && static_cast<int64_t>(runs.back().first) + runs.back().second == f.frame_index) {
+            runs.back().second++;
+        } else {
+            runs.emplace_back(f.frame_index, 1u);
+        }
+    }
+    b.i32(track.id);
+    b.i32(track.identity);
+    b.u32(static_cast<uint32_t>(frames.size()));
+    b.u32(static_cast<uint32_t>(runs.size()));
+    for (const auto& run : runs) {
+        b.i32(run.first);
+        b.u32(run.second);
+    }
+    for (const TrackFrame& f : frames) b.u16(QuantizeUnit16(f.bbox.x1));
+    for (const TrackFrame& f : frames) b.u16(QuantizeUnit16(f.bbox.y1));
+    for (const TrackFrame& f : frames) b.u16(QuantizeUnit16(f.bbox.x2));
+    for (const TrackFrame& f : frames) b.u16(QuantizeUnit16(f.bbox.y2));
+    for (const TrackFrame& f : frames) b.u8(QuantizeUnit8(f.confidence));
+    b.align4();
+}
+}  // namespace
+
+bool TrackBinaryZstdAvailable() {
+#ifdef FACE_PIPELINE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool WriteTracksBinary(FILE* out, const PipelineResult& result, bool segment_links, int zstd_level,
+                       std::string& error) {
+    Bytes payload;
+    for (const FaceTrack& track : result.tracks) PutTrack(payload, track);
+    const size_t links = segment_links ? result.segment_links.size() : 0;
+    if (segment_links) {
+        for (const auto& link : result.segment_links) {
+            payload.i32(link.first);
+            payload.i32(link.second);
+        }
+    }
+
+    std::vector<uint8_t>& raw = payload.data();
+    const std::vector<uint8_t>* stored = &raw;
+    uint32_t flags = result.stopped ? kFlagStopped : 0;
+#ifdef FACE_PIPELINE_ZSTD
+    std::vector<uint8_t> packed;
+    if (zstd_level > 0) {
+        packed.resize(ZSTD_compressBound(raw.size()));
+        const size_t n = ZSTD_compress(packed.data(), packed.size(), raw.data(), raw.size(), zstd_level);
+        if (ZSTD_isError(n)) {
+            error = std::string("zstd: ") + ZSTD_getErrorName(n);
+            return false;
+        }
+        packed.resize(n);
+        stored = &packed;
+        flags |= kFlagZstd;
+    }
+#else
+    if (zstd_level > 0) {
+        error = "this build has no zstd";
+        return false;
+    }
+#endif
+
+    Bytes header;
+    header.raw(kMagic, sizeof(kMagic));
+    header.u32(kVersion);
+    header.u32(flags);
+    header.i32(result.frame_count);
+    header.u32(static_cast<uint32_t>(result.tracks.size()));
+    header.u32(static_cast<uint32_t>(links));
+    header.u32(0);
+    header.u64(raw.size());
+    header.u64(stored->size());
+    const std::vector<uint8_t>& head = header.data();
+    if (std::fwrite(head.data(), 1, head.size(), out) != head.size() ||
+        std::fwrite(stored->data(), 1, stored->size(), out) != stored->size() || std::fflush(out) != 0) {
+        error = "cannot write the tracks";
+        return false;
+    }
+    return true;
+}
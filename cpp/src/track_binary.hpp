@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "pipeline.hpp"
+
+/**
+ * Compact binary form of a tracking result (--output-format binary), for
+ * hosts that would otherwise parse megabytes of JSON. Unlike checkpoints
+ * and dumps it is an interchange format: every field is little-endian and
+ * src/js/lib/utils/trackBinary.ts reads it into typed arrays.
+ *
+ * Header, 48 bytes:
+ *
+ *   char magic[8]      "FPTRACK1"
+ *   u32  version       1
+ *   u32  flags         1 = payload zstd-compressed, 2 = run stopped early
+ *   i32  frame_count
+ *   u32  track_count
+ *   u32  link_count    streamed segment -> output track links (--stream-events)
+ *   u32  reserved      0
+ *   u64  payload_bytes payload size, uncompressed
+ *   u64  stored_bytes  bytes that follow the header
+ *
+ * Payload, every track then the links, each part 4-byte aligned:
+ *
+ *   i32 id, i32 identity (-1 = none), u32 frames, u32 runs
+ *   runs  x (i32 first frame, u32 length)    frame indices as consecutive runs
+ *   u16 x1[frames], y1[frames], x2[frames], y2[frames]   box / 65535, clamped to the frame
+ *   u8  confidence[frames]                   confidence / 255
+ *   zero bytes up to a multiple of 4
+ *   ...
+ *   link_count x (i32 segment, i32 track)
+ *
+ * About 9 bytes a frame instead of ~110 of JSON; boxes come back within
+ * 1/131070 of the frame, confidences within 1/510.
+ */
+
+/** True if this build can write zstd-compressed payloads (FACE_PIPELINE_ZSTD). */
+bool TrackBinaryZstdAvailable();
+
+/**
+ * Write `result` to `out` (opened in binary mode), with its segment links
+ * if `segment_links`.
+ *
+ * @param zstd_level Compress the payload at this zstd level (0 = store it as is)
+ * @return false (with `error`) if writing or compressing fails
+ */
+bool WriteTracksBinary(FILE* out, const PipelineResult& result, bool segment_links, int zstd_level,
+                       std::string& error);
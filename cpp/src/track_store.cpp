@@ -0,0 +1,219 @@
+#include "track_store.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+uint16_t QuantizeUnit16(float v) {
+    return static_cast<uint16_t>(std::lround(std::max(0.0f, std::min(1.0f, v)) * 65535.0f));
+}
+
+uint8_t QuantizeUnit8(float v) {
+    return static_cast<uint8_t>(std::lround(std::max(0.0f, std::min(1.0f, v)) * 255.0f));
+}
+
+void PutVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+void PutU16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+constexpr size_t kMaxSpan = 256;  // frames one interpolated span may cover (bounds put()'s search)
+// Quantized units an interpolated frame may miss by: rounding both ends
+// alone costs one on most straight runs.
+constexpr int kSpanTolerance = 1;
+
+// A frame's quantized x1, y1, x2, y2 (16 bits) and confidence (8 bits).
+using Quantized = std::array<int, 5>;
+
+// Channel value `t` of `len` frames from `a` to `b`, rounded half away from
+// zero in integers, so put() and get() agree on every platform.
+int Interpolate(int a, int b, int64_t t, int64_t len) {
+    const int64_t num = static_cast<int64_t>(b - a) * t;
+    const int64_t step = num >= 0 ? (num + len / 2) / len : -((-num + len / 2) / len);
+    return a + static_cast<int>(step);
+}
+}  // namespace
+
+void TrackStore::put(int id, const std::vector<TrackFrame>& frames) {
+    if (id < 0 || frames.empty()) return;
+    if (static_cast<size_t>(id) >= blocks_.size()) blocks_.resize(static_cast<size_t>(id) + 1);
+    Block& block = blocks_[id];
+    if (block.frames > 0) {
+        count_--;
+        resident_bytes_ -= block.bytes.size();
+        frames_ -= block.frames;
+        keyframes_ -= block.kept;
+    }
+    block = Block{};
+
+    const size_t n = frames.size();
+    std::vector<Quantized> q(n);
+    for (size_t k = 0; k < n; ++k) {
+        const TrackFrame& f = frames[k];
+        q[k] = {QuantizeUnit16(f.bbox.x1), QuantizeUnit16(f.bbox.y1), QuantizeUnit16(f.bbox.x2),
+                QuantizeUnit16(f.bbox.y2), QuantizeUnit8(f.confidence)};
+    }
+    // Frames a..c are one span when they are consecutive, none inside is
+    // observed, and interpolating a and c gives back every one inside to
+    // kSpanTolerance.
+    auto spans = [&](size_t a, size_t c) {
+        if (static_cast<int64_t>(frames[c].frame_index) - frames[a].frame_index != static_cast<int64_t>(c - a)) {
+            return false;
+        }
+        for (size_t k = a + 1; k < c; ++k) {
+            if (frames[k].observed) return false;
+            for (size_t ch = 0; ch < q[k].size(); ++ch) {
+                const int v = Interpolate(q[a][ch], q[c][ch], static_cast<int64_t>(k - a), static_cast<int64_t>(c - a));
+                if (std::abs(v - q[k][ch]) > kSpanTolerance) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    std::vector<size_t> kept = {0};
+    for (size_t a = 0; a + 1 < n;) {
+        size_t c = a + 1;
+        while (c + 1 < n && c + 1 - a <= kMaxSpan && spans(a, c + 1)) c++;
+        kept.push_back(c);
+        a = c;
+    }
+
+    // Frame deltas are signed (zigzag) so any order round-trips; the second
+    // lowest bit marks a span whose inner frames get() interpolates.
+    std::vector<uint8_t>& out = block.bytes;
+    out.reserve(kept.size() * 10);
+    int64_t prev = 0;
+    for (size_t j = 0; j < kept.size(); ++j) {
+        const TrackFrame& f = frames[kept[j]];
+        const int64_t delta = static_cast<int64_t>(f.frame_index) - prev;
+        prev = f.frame_index;
+        const uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+        const bool filled = j > 0 && kept[j] - kept[j - 1] > 1;
+        PutVarint(out, (zigzag << 2) | (filled ? 2u : 0u) | (f.observed ? 1u : 0u));
+    }
+    for (size_t ch = 0; ch < 4; ++ch) {
+        for (size_t k : kept) PutU16(out, static_cast<uint16_t>(q[k][ch]));
+    }
+    for (size_t k : kept) out.push_back(static_cast<uint8_t>(q[k][4]));
+    out.shrink_to_fit();
+
+    block.size = static_cast<uint32_t>(out.size());
+    block.frames = static_cast<uint32_t>(n);
+    block.kept = static_cast<uint32_t>(kept.size());
+    count_++;
+    frames_ += n;
+    keyframes_ += kept.size();
+    resident_bytes_ += out.size();
+    if (account_) account_->set(resident_bytes_);
+    const bool over = (spill_bytes_ > 0 && resident_bytes_ > spill_bytes_) || (account_ && !account_->fits(0));
+    if (over && !spill_failed_) spill();
+}
+
+bool TrackStore::contains(int id) const {
+    return id >= 0 && static_cast<size_t>(id) < blocks_.size() && blocks_[id].frames > 0;
+}
+
+bool TrackStore::get(int id, std::vector<TrackFrame>& out) const {
+    if (!contains(id)) return false;
+    const Block& block = blocks_[id];
+    std::vector<uint8_t> read_back;
+    const uint8_t* data = block.bytes.data();
+    if (block.offset >= 0) {
+        read_back.resize(block.size);
+        if (!file_ || std::fseek(file_.get(), block.offset, SEEK_SET) != 0 ||
+            std::fread(read_back.data(), 1, read_back.size(), file_.get()) != read_back.size()) {
+            return false;
+        }
+        data = read_back.data();
+    }
+    const uint8_t* p = data;
+    const uint8_t* end = data + block.size;
+
+    const size_t n = block.kept;
+    std::vector<int64_t> frame_of(n);
+    std::vector<uint8_t> flags(n);
+    int64_t frame = 0;
+    for (size_t k = 0; k < n; ++k) {
+        uint64_t v = 0;
+        if (!GetVarint(p, end, v)) return false;
+        const uint64_t zigzag = v >> 2;
+        frame += static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        frame_of[k] = frame;
+        flags[k] = static_cast<uint8_t>(v & 3);
+    }
+    if (static_cast<size_t>(end - p) != n * 9) return false;
+    std::vector<Quantized> q(n);
+    for (size_t ch = 0; ch < 4; ++ch) {
+        for (size_t k = 0; k < n; ++k, p += 2) q[k][ch] = p[0] | (p[1] << 8);
+    }
+    for (size_t k = 0; k < n; ++k) q[k][4] = *p++;
+
+    const float inv16 = 1.0f / 65535.0f;
+    auto emit = [&](int64_t index, const Quantized& v, bool observed) {
+        TrackFrame f;
+        f.frame_index = static_cast<int>(index);
+        f.bbox = {static_cast<float>(v[0]) * inv16, static_cast<float>(v[1]) * inv16,
+                  static_cast<float>(v[2]) * inv16, static_cast<float>(v[3]) * inv16};
+        f.confidence = static_cast<float>(v[4]) * (1.0f / 255.0f);
+        f.observed = observed;
+        out.push_back(f);
+    };
+    out.reserve(out.size() + block.frames);
+    for (size_t k = 0; k < n; ++k) {
+        if ((flags[k] & 2) && k > 0) {
+            const int64_t len = frame_of[k] - frame_of[k - 1];
+            for (int64_t t = 1; t < len; ++t) {
+                Quantized v;
+                for (size_t ch = 0; ch < v.size(); ++ch) v[ch] = Interpolate(q[k - 1][ch], q[k][ch], t, len);
+                emit(frame_of[k - 1] + t, v, false);
+            }
+        }
+        emit(frame_of[k], q[k], (flags[k] & 1) != 0);
+    }
+    return true;
+}
+
+void TrackStore::spill() {
+    if (!file_) file_.reset(std::tmpfile());
+    if (!file_ || std::fseek(file_.get(), 0, SEEK_END) != 0) {
+        spill_failed_ = true;
+        fprintf(stderr, "Warning: cannot create a temporary file; keeping finished tracks in memory\n");
+        return;
+    }
+    for (Block& block : blocks_) {
+        if (block.frames == 0 || block.offset >= 0) continue;
+        const long offset = std::ftell(file_.get());
+        if (offset < 0 || std::fwrite(block.bytes.data(), 1, block.bytes.size(), file_.get()) != block.bytes.size()) {
+            spill_failed_ = true;
+            fprintf(stderr, "Warning: cannot write the track spill file; keeping finished tracks in memory\n");
+            return;
+        }
+        block.offset = offset;
+        resident_bytes_ -= block.bytes.size();
+        spilled_bytes_ += block.bytes.size();
+        std::vector<uint8_t>().swap(block.bytes);
+        if (account_) account_->set(resident_bytes_);
+    }
+    std::fflush(file_.get());
+}
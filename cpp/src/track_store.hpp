@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "memory_budget.hpp"
+#include "pipeline.hpp"
+
+/**
+ * Finished tracklets kept compactly until the output is built
+ * (PipelineOptions::compact_tracks).
+ *
+ * Each tracklet is one block of columns: frame index deltas (varints, the
+ * lowest bit the observed flag), then x1, y1, x2, y2 as 16-bit fractions
+ * of the frame and the confidence as 8 bits, about 10 bytes a frame
+ * instead of 28.
+ *
+ * Only keyframes are stored: the frames a detection updated, the ends of
+ * runs, and predicted frames that linear interpolation of the quantized
+ * values around them misses by more than one unit. Between detections
+ * the tracker's predictions move smoothly, so a tracklet costs about its
+ * detections rather than its frames; get() materializes every frame
+ * again. Boxes come back within 3/131070 of the frame, confidences within
+ * 3/510.
+ *
+ * Once the blocks in memory pass `spill_bytes`, or the memory budget the
+ * store is charged to is spent, they move to an anonymous temporary file
+ * and get() reads them back from there.
+ */
+class TrackStore {
+public:
+    /**
+     * @param spill_bytes Blocks kept in memory before spilling (0 = never spill)
+     * @param account Blocks in memory are charged to it (nullptr = no budget)
+     */
+    explicit TrackStore(size_t spill_bytes = 0, std::unique_ptr<MemoryBudget::Account> account = nullptr)
+        : spill_bytes_(spill_bytes), account_(std::move(account)) {}
+
+    /** Store the frames of tracklet `id` (boxes normalized, in frame order), replacing any stored before. */
+    void put(int id, const std::vector<TrackFrame>& frames);
+
+    bool contains(int id) const;
+
+    /**
+     * Append tracklet `id`'s frames to `out`.
+     *
+     * @return false if it was never stored or its block cannot be read back
+     */
+    bool get(int id, std::vector<TrackFrame>& out) const;
+
+    size_t tracklets() const { return count_; }
+    size_t memoryBytes() const { return resident_bytes_; }
+    size_t spilledBytes() const { return spilled_bytes_; }
+    size_t frames() const { return frames_; }        // frames get() returns
+    size_t keyframes() const { return keyframes_; }  // frames stored
+
+private:
+    struct Block {
+        std::vector<uint8_t> bytes;  // empty once spilled
+        long offset = -1;            // in the spill file, -1 = in memory
+        uint32_t size = 0;
+        uint32_t frames = 0;
+        uint32_t kept = 0;  // keyframes in `bytes`
+    };
+    struct FileCloser {
+        void operator()(FILE* f) const { std::fclose(f); }
+    };
+
+    void spill();
+
+    size_t spill_bytes_;
+    std::unique_ptr<MemoryBudget::Account> account_;
+    std::vector<Block> blocks_;  // by tracklet id; frames == 0 = not stored
+    size_t count_ = 0;
+    size_t resident_bytes_ = 0;
+    size_t spilled_bytes_ = 0;
+    size_t frames_ = 0;
+    size_t keyframes_ = 0;
+    bool spill_failed_ = false;
+    std::unique_ptr<FILE, FileCloser> file_;
+};
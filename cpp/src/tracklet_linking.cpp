@@ -0,0 +1,219 @@
+#include "tracklet_linking.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <utility>
+
+namespace {
+inline float bbox_diag(const BBox& b) {
+    const float w = std::max(0.0f, b.width());
+    const float h = std::max(0.0f, b.height());
+    return std::sqrt(w * w + h * h);
+}
+
+inline float center_dist_norm_max_diag(const BBox& a, const BBox& b) {
+    const float acx = (a.x1 + a.x2) * 0.5f;
+    const float acy = (a.y1 + a.y2) * 0.5f;
+    const float bcx = (b.x1 + b.x2) * 0.5f;
+    const float bcy = (b.y1 + b.y2) * 0.5f;
+    const float dx = acx - bcx;
+    const float dy = acy - bcy;
+    const float diag = std::max(bbox_diag(a), bbox_diag(b)) + 1e-6f;
+    return std::sqrt(dx * dx + dy * dy) / diag;
+}
+}  // namespace
+
+TrackletSummary SummarizeTracklet(int id, const std::vector<TrackFrame>& frames, float conf_thresh) {
+    TrackletSummary s;
+    s.id = id;
+    s.frame_count = static_cast<int>(frames.size());
+    // Trim extremely low-confidence prediction tails so tracklet spans reflect
+    // when the face was actually present (helps offline linking + removes ghosts).
+    const float span_conf = std::max(0.20f, conf_thresh * 0.60f);
+    int first = 0;
+    int last = static_cast<int>(frames.size()) - 1;
+    while (first < static_cast<int>(frames.size()) &&
+           frames[first].confidence < span_conf) {
+        first++;
+    }
+    while (last >= 0 && frames[last].confidence < span_conf) {
+        last--;
+    }
+    if (first >= static_cast<int>(frames.size()) || last < 0 || last < first) {
+        // Fallback: use raw endpoints.
+        first = 0;
+        last = static_cast<int>(frames.size()) - 1;
+    }
+    s.start_frame = frames[first].frame_index;
+    s.end_frame = frames[last].frame_index;
+    s.start_bbox = frames[first].bbox;
+    s.end_bbox = frames[last].bbox;
+
+    int ge = 0;
+    for (const auto& f : frames) {
+        if (f.confidence >= conf_thresh) ge++;
+    }
+    s.conf_ge_thresh = ge;
+    return s;
+}
+
+int LinkMaxGapFrames(float video_fps, const ReidConfig& config) {
+    const int link_max_gap_short =
+        std::max(1, static_cast<int>(std::round(video_fps * config.link_short_gap_s)));
+    return std::max(link_max_gap_short, static_cast<int>(std::round(video_fps * config.link_long_gap_s)));
+}
+
+std::vector<TrackletLink> FindTrackletLinks(const std::vector<TrackletSummary>& tracklets,
+                                            const std::vector<const PackedEmbedding*>& appearance,
+                                            float video_fps, float cos_thresh, const ReidConfig& config,
+                                            const std::function<bool(int from, int to)>& may_link) {
+    const int link_max_gap_short =
+        std::max(1, static_cast<int>(std::round(video_fps * config.link_short_gap_s)));
+    const int link_max_gap_long = LinkMaxGapFrames(video_fps, config);
+    const float kMaxCenterDist = config.link_max_center_dist;   // normalized by max diag
+    const float kMaxAreaRatio = config.link_max_area_ratio;
+
+    const int n = static_cast<int>(tracklets.size());
+    std::vector<int> best_to(n, -1);
+    std::vector<float> best_to_sim(n, -1.0f);
+    std::vector<float> best_to_dist(n, 1e9f);
+
+    std::vector<int> best_from(n, -1);
+    std::vector<float> best_from_sim(n, -1.0f);
+    std::vector<float> best_from_dist(n, 1e9f);
+
+    // Debug: track best long-gap candidate per tracklet (helps threshold tuning).
+    std::vector<int> best_long_to(n, -1);
+    std::vector<float> best_long_to_sim(n, -1.0f);
+    std::vector<int> best_long_to_gap(n, 0);
+    std::vector<float> best_long_to_dist(n, 1e9f);
+
+    // Only tracklets starting within (A.end, A.end + long gap] can follow
+    // A: index the ones with an appearance by start frame once and
+    // binary-search that window, so long footage with thousands of
+    // tracklets does not compare every pair. The window is visited in
+    // start order; exact ties go to the lower index, as in a full scan.
+    std::vector<int> by_start;
+    by_start.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        if (appearance[i]) by_start.push_back(i);
+    }
+    std::stable_sort(by_start.begin(), by_start.end(), [&](int a, int b) {
+        return tracklets[a].start_frame < tracklets[b].start_frame;
+    });
+    std::vector<int> start_frames(by_start.size());
+    for (size_t k = 0; k < by_start.size(); ++k) start_frames[k] = tracklets[by_start[k]].start_frame;
+    auto better = [](float sim, float dist, int idx, float best_sim, float best_dist, int best_idx) {
+        if (sim != best_sim) return sim > best_sim;
+        if (dist != best_dist) return dist < best_dist;
+        return idx < best_idx;
+    };
+
+    for (int i = 0; i < n; ++i) {
+        const auto& A = tracklets[i];
+        if (!appearance[i]) continue;
+
+        const auto lo = std::upper_bound(start_frames.begin(), start_frames.end(), A.end_frame);
+        const auto hi = std::upper_bound(lo, start_frames.end(), A.end_frame + link_max_gap_long);
+        for (auto k = lo; k != hi; ++k) {
+            const int j = by_start[k - start_frames.begin()];
+            if (may_link && !may_link(i, j)) continue;
+            const auto& B = tracklets[j];
+            const int gap = B.start_frame - A.end_frame;
+
+            const float dist = center_dist_norm_max_diag(A.end_bbox, B.start_bbox);
+            if (!(dist <= kMaxCenterDist)) continue;
+
+            const float aA = std::max(1e-6f, A.end_bbox.area());
+            const float aB = std::max(1e-6f, B.start_bbox.area());
+            float ar = aB / aA;
+            if (ar < 1.0f) ar = 1.0f / std::max(1e-6f, ar);
+            if (!(ar <= kMaxAreaRatio)) continue;
+
+            const float sim = CosineSimilarity(*appearance[i], *appearance[j]);
+            const bool long_gap = (gap > link_max_gap_short);
+            if (long_gap) {
+                if (better(sim, dist, j, best_long_to_sim[i], best_long_to_dist[i], best_long_to[i])) {
+                    best_long_to[i] = j;
+                    best_long_to_sim[i] = sim;
+                    best_long_to_gap[i] = gap;
+                    best_long_to_dist[i] = dist;
+                }
+            }
+
+            float sim_thresh = cos_thresh;
+            if (long_gap) {
+                // Long gaps are much riskier. Require (a) enough confident frames in
+                // both tracklets and (b) a moderate absolute similarity floor.
+                if (A.conf_ge_thresh < config.link_long_min_frames ||
+                    B.conf_ge_thresh < config.link_long_min_frames) {
+                    continue;
+                }
+                sim_thresh = std::max(cos_thresh, config.link_long_min_sim);
+            }
+            if (!(sim >= sim_thresh)) continue;
+
+            // Best-to (A -> B): maximize sim, break ties with smaller dist.
+            if (better(sim, dist, j, best_to_sim[i], best_to_dist[i], best_to[i])) {
+                best_to[i] = j;
+                best_to_sim[i] = sim;
+                best_to_dist[i] = dist;
+            }
+
+            // Best-from (B <- A): maximize sim, break ties with smaller dist.
+            if (better(sim, dist, i, best_from_sim[j], best_from_dist[j], best_from[j])) {
+                best_from[j] = i;
+                best_from_sim[j] = sim;
+                best_from_dist[j] = dist;
+            }
+        }
+    }
+
+    std::vector<TrackletLink> links;
+    for (int i = 0; i < n; ++i) {
+        const int j = best_to[i];
+        if (j < 0) continue;
+        if (best_from[j] != i) continue;  // mutual nearest neighbor
+        links.push_back({i, j, best_to_sim[i]});
+    }
+
+    if (std::getenv("FACE_PIPELINE_LOG_REID_CANDS") != nullptr) {
+        for (int i = 0; i < n; ++i) {
+            if (best_long_to[i] < 0) continue;
+            const int idA = tracklets[i].id;
+            const int idB = tracklets[best_long_to[i]].id;
+            fprintf(stderr,
+                    "ReIDLinkLongCand: %d -> %d gap=%d sim=%.3f dist=%.3f\n",
+                    idA, idB,
+                    best_long_to_gap[i],
+                    best_long_to_sim[i],
+                    best_long_to_dist[i]);
+        }
+    }
+    return links;
+}
+
+void MergeFrameRuns(const std::vector<TrackFrame>& frames, const std::vector<size_t>& runs,
+                    std::vector<TrackFrame>& out) {
+    out.clear();
+    out.reserve(frames.size());
+    using Head = std::pair<int, int>;  // (frame index, run)
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    std::vector<size_t> next(runs.begin(), runs.end() - 1);
+    for (size_t r = 0; r + 1 < runs.size(); ++r) {
+        if (next[r] < runs[r + 1]) heads.push({frames[next[r]].frame_index, static_cast<int>(r)});
+    }
+    while (!heads.empty()) {
+        const int r = heads.top().second;
+        heads.pop();
+        const TrackFrame& f = frames[next[r]++];
+        if (next[r] < runs[r + 1]) heads.push({frames[next[r]].frame_index, r});
+        if (out.empty() || out.back().frame_index != f.frame_index) {
+            out.push_back(f);
+        } else if (f.confidence > out.back().confidence) {
+            out.back() = f;
+        }
+    }
+}
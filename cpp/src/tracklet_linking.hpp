@@ -0,0 +1,102 @@
+#pragma once
+
+#include "embedding.hpp"
+#include "pipeline.hpp"
+#include "reid.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/**
+ * What offline linking needs of a tracklet.
+ */
+struct TrackletSummary {
+    int id = -1;
+    int start_frame = 0;
+    int end_frame = 0;
+    BBox start_bbox{};
+    BBox end_bbox{};
+    int frame_count = 0;
+    int conf_ge_thresh = 0;  // frames with confidence >= the detector threshold
+};
+
+/**
+ * Summarize a tracklet's frames (in frame order). Its span leaves out
+ * very low-confidence prediction tails, so it reflects when the face was
+ * actually present.
+ */
+TrackletSummary SummarizeTracklet(int id, const std::vector<TrackFrame>& frames, float conf_thresh);
+
+/**
+ * Link of tracklets[from] to the later tracklets[to].
+ */
+struct TrackletLink {
+    int from;
+    int to;
+    float sim;
+};
+
+/**
+ * Offline tracklet linking (Phase 3 of FacePipeline::process): pairs a
+ * tracklet with one starting after it ends, up to the long gap
+ * (ReidConfig::link_long_gap_s), when their end and start boxes are close
+ * in place and size and their appearances are similar, each being the
+ * other's best such match.
+ *
+ * @param appearance Appearance of each tracklet, null where it has none
+ * @param may_link Further restricts the pairs (from, to) considered, empty = all
+ * @return The links, by `from`
+ */
+std::vector<TrackletLink> FindTrackletLinks(const std::vector<TrackletSummary>& tracklets,
+                                            const std::vector<const PackedEmbedding*>& appearance,
+                                            float video_fps, float cos_thresh, const ReidConfig& config,
+                                            const std::function<bool(int from, int to)>& may_link = nullptr);
+
+/**
+ * The longest gap FindTrackletLinks bridges, in frames: a tracklet ending
+ * at frame e links only to one starting in (e, e + LinkMaxGapFrames()].
+ */
+int LinkMaxGapFrames(float video_fps, const ReidConfig& config);
+
+/**
+ * Union-find over dense tracklet IDs 0..n-1: union by rank, path halving.
+ */
+class UnionFind {
+public:
+    explicit UnionFind(int n) : parent_(n), rank_(n, 0), smallest_(n) {
+        for (int i = 0; i < n; ++i) parent_[i] = smallest_[i] = i;
+    }
+    int find(int x) {
+        while (parent_[x] != x) {
+            parent_[x] = parent_[parent_[x]];
+            x = parent_[x];
+        }
+        return x;
+    }
+    // Smallest ID in x's set: the merged track's ID, for stable output.
+    int representative(int x) { return smallest_[find(x)]; }
+    void unite(int a, int b) {
+        int ra = find(a);
+        int rb = find(b);
+        if (ra == rb) return;
+        if (rank_[ra] < rank_[rb]) std::swap(ra, rb);
+        parent_[rb] = ra;
+        if (rank_[ra] == rank_[rb]) rank_[ra]++;
+        smallest_[ra] = std::min(smallest_[ra], smallest_[rb]);
+    }
+
+private:
+    std::vector<int> parent_;
+    std::vector<int> rank_;
+    std::vector<int> smallest_;
+};
+
+/**
+ * K-way merge of frame runs, each sorted by frame: runs[r]..runs[r + 1] of
+ * `frames`. A frame in several runs keeps its most confident box, the
+ * earliest run's on a tie.
+ */
+void MergeFrameRuns(const std::vector<TrackFrame>& frames, const std::vector<size_t>& runs,
+                    std::vector<TrackFrame>& out);
@@ -0,0 +1,20 @@
+#pragma once
+
+/**
+ * Tracy profiler instrumentation, in builds configured with
+ * FACE_PIPELINE_TRACY: zones around the hot paths, a frame mark per input
+ * frame of the tracking loop and every heap allocation (through the
+ * operator new of alloc_stats.cpp), for live, nanosecond-resolution
+ * profiling in the Tracy server while a slow case is reproduced. Other
+ * builds compile the macros to nothing.
+ */
+#if FACE_PIPELINE_TRACY
+#include <tracy/Tracy.hpp>
+/** Times the rest of the enclosing scope as a zone called `name` (a string literal). */
+#define FACE_PIPELINE_ZONE(name) ZoneScopedN(name)
+/** Ends a frame of the tracking loop. */
+#define FACE_PIPELINE_FRAME_MARK() FrameMark
+#else
+#define FACE_PIPELINE_ZONE(name) (void)0
+#define FACE_PIPELINE_FRAME_MARK() (void)0
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cmath>
 
 struct Mat3f {
     std::array<float, 9> m{};
@@ -14,5 +15,26 @@ struct Mat3f {
     }
 
     float operator()(int r, int c) const { return m[static_cast<size_t>(r) * 3u + static_cast<size_t>(c)]; }
+
+    /** Inverse by cofactors; false (and `out` untouched) when singular. */
+    bool inverse(Mat3f& out) const {
+        const Mat3f& a = *this;
+        const float c00 = a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1);
+        const float c01 = a(1, 2) * a(2, 0) - a(1, 0) * a(2, 2);
+        const float c02 = a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0);
+        const float det = a(0, 0) * c00 + a(0, 1) * c01 + a(0, 2) * c02;
+        if (!(std::abs(det) > 1e-12f)) return false;
+        const float inv = 1.0f / det;
+        out.m = {c00 * inv,
+                 (a(0, 2) * a(2, 1) - a(0, 1) * a(2, 2)) * inv,
+                 (a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1)) * inv,
+                 c01 * inv,
+                 (a(0, 0) * a(2, 2) - a(0, 2) * a(2, 0)) * inv,
+                 (a(0, 2) * a(1, 0) - a(0, 0) * a(1, 2)) * inv,
+                 c02 * inv,
+                 (a(0, 1) * a(2, 0) - a(0, 0) * a(2, 1)) * inv,
+                 (a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0)) * inv};
+        return true;
+    }
 };
 
@@ -0,0 +1,394 @@
+#include "video_source.hpp"
+
+#include "image_ops.hpp"
+
+bool ParseVideoHwAccel(const std::string& name, VideoHwAccel& out) {
+    if (name == "none") {
+        out = VideoHwAccel::None;
+    } else if (name == "auto") {
+        out = VideoHwAccel::Auto;
+    } else if (name == "videotoolbox") {
+        out = VideoHwAccel::VideoToolbox;
+    } else if (name == "d3d11va") {
+        out = VideoHwAccel::D3D11VA;
+    } else if (name == "dxva2") {
+        out = VideoHwAccel::DXVA2;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#ifdef FACE_PIPELINE_VIDEO_FFMPEG
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/motion_vector.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+AVHWDeviceType ResolveDeviceType(VideoHwAccel hw) {
+    switch (hw) {
+        case VideoHwAccel::None: return AV_HWDEVICE_TYPE_NONE;
+        case VideoHwAccel::VideoToolbox: return AV_HWDEVICE_TYPE_VIDEOTOOLBOX;
+        case VideoHwAccel::D3D11VA: return AV_HWDEVICE_TYPE_D3D11VA;
+        case VideoHwAccel::DXVA2: return AV_HWDEVICE_TYPE_DXVA2;
+        case VideoHwAccel::Auto:
+#if defined(__APPLE__)
+            return AV_HWDEVICE_TYPE_VIDEOTOOLBOX;
+#elif defined(_WIN32)
+            return AV_HWDEVICE_TYPE_D3D11VA;
+#else
+            return AV_HWDEVICE_TYPE_NONE;
+#endif
+    }
+    return AV_HWDEVICE_TYPE_NONE;
+}
+
+// Formats whose first plane is full-resolution 8-bit luma.
+bool HasY8Plane(int fmt) {
+    switch (fmt) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21:
+        case AV_PIX_FMT_GRAY8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+AVPixelFormat g_hw_pix_fmt = AV_PIX_FMT_NONE;
+
+AVPixelFormat PickHwFormat(AVCodecContext*, const AVPixelFormat* fmts) {
+    for (const AVPixelFormat* p = fmts; *p != AV_PIX_FMT_NONE; ++p) {
+        if (*p == g_hw_pix_fmt) return *p;
+    }
+    // Hardware surface not offered for this stream: fall back to software.
+    return fmts[0];
+}
+}  // namespace
+
+struct VideoFrameSource::Impl {
+    struct Keyframe {
+        int frame;
+        int64_t timestamp;  // in the stream's time base
+    };
+
+    AVFormatContext* fmt = nullptr;
+    AVCodecContext* codec = nullptr;
+    AVBufferRef* hw_device = nullptr;
+    AVPacket* packet = nullptr;
+    AVFrame* frame = nullptr;
+    AVFrame* sw_frame = nullptr;
+    SwsContext* sws_rgb = nullptr;
+    SwsContext* sws_gray = nullptr;
+    int stream_index = -1;
+    bool draining = false;
+    bool export_mvs = false;
+    std::vector<uint8_t> scratch;
+    std::vector<std::array<float, 4>> motion_vectors;  // of the frame next() returned last
+    std::vector<Keyframe> keys;  // ascending
+    int64_t start_pts = 0;
+    double frames_per_tick = 0.0;  // average frame rate times the time base (0 = unknown)
+
+    ~Impl() {
+        sws_freeContext(sws_rgb);
+        sws_freeContext(sws_gray);
+        av_frame_free(&sw_frame);
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        avcodec_free_context(&codec);
+        av_buffer_unref(&hw_device);
+        avformat_close_input(&fmt);
+    }
+
+    bool open(const std::string& path, VideoHwAccel hw, bool mvs, std::string& error) {
+        if (avformat_open_input(&fmt, path.c_str(), nullptr, nullptr) < 0) {
+            error = "cannot open video " + path;
+            return false;
+        }
+        if (avformat_find_stream_info(fmt, nullptr) < 0) {
+            error = "cannot read stream info from " + path;
+            return false;
+        }
+        const AVCodec* decoder = nullptr;
+        stream_index = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+        if (stream_index < 0 || !decoder) {
+            error = "no decodable video stream in " + path;
+            return false;
+        }
+        indexKeyframes();
+        codec = avcodec_alloc_context3(decoder);
+        if (!codec || avcodec_parameters_to_context(codec, fmt->streams[stream_index]->codecpar) < 0) {
+            error = "cannot configure decoder";
+            return false;
+        }
+
+        // Hardware decoders export no motion vectors.
+        const AVHWDeviceType type = mvs ? AV_HWDEVICE_TYPE_NONE : ResolveDeviceType(hw);
+        if (type != AV_HWDEVICE_TYPE_NONE) {
+            for (int i = 0;; ++i) {
+                const AVCodecHWConfig* cfg = avcodec_get_hw_config(decoder, i);
+                if (!cfg) break;
+                if ((cfg->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && cfg->device_type == type) {
+                    if (av_hwdevice_ctx_create(&hw_device, type, nullptr, nullptr, 0) == 0) {
+                        g_hw_pix_fmt = cfg->pix_fmt;
+                        codec->hw_device_ctx = av_buffer_ref(hw_device);
+                        codec->get_format = PickHwFormat;
+                    }
+                    break;
+                }
+            }
+        }
+        codec->thread_count = 0;  // let libavcodec pick frame/slice threads
+
+        AVDictionary* opts = nullptr;
+        export_mvs = mvs;
+        if (export_mvs) av_dict_set(&opts, "flags2", "+export_mvs", 0);
+        const int rc = avcodec_open2(codec, decoder, &opts);
+        av_dict_free(&opts);
+        if (rc < 0) {
+            error = "cannot open decoder";
+            return false;
+        }
+        packet = av_packet_alloc();
+        frame = av_frame_alloc();
+        sw_frame = av_frame_alloc();
+        return packet && frame && sw_frame;
+    }
+
+    // Keyframes of the demuxer's index (complete once the container is
+    // open for MP4/MOV, and for Matroska with cues).
+    void indexKeyframes() {
+        AVStream* st = fmt->streams[stream_index];
+        const AVRational rate = st->avg_frame_rate;
+        if (rate.num <= 0 || rate.den <= 0) return;
+        frames_per_tick = av_q2d(st->time_base) * av_q2d(rate);
+        start_pts = st->start_time != AV_NOPTS_VALUE ? st->start_time : 0;
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+        const int n = avformat_index_get_entries_count(st);
+        for (int i = 0; i < n; ++i) {
+            const AVIndexEntry* e = avformat_index_get_entry(st, i);
+            if (!e || !(e->flags & AVINDEX_KEYFRAME)) continue;
+            const int frame = frameAt(e->timestamp);
+            if (frame >= 0 && (keys.empty() || frame > keys.back().frame)) keys.push_back({frame, e->timestamp});
+        }
+#endif
+    }
+
+    int frameAt(int64_t timestamp) const {
+        return static_cast<int>(std::llround(static_cast<double>(timestamp - start_pts) * frames_per_tick));
+    }
+
+    // Frame `index`, passing over the ones from `next_index` (the next in
+    // decode order) up to it.
+    const AVFrame* skipTo(int next_index, int index) {
+        auto key = std::upper_bound(keys.begin(), keys.end(), index,
+                                    [](int frame, const Keyframe& k) { return frame < k.frame; });
+        if (key != keys.begin() && (key - 1)->frame > next_index &&
+            av_seek_frame(fmt, stream_index, (key - 1)->timestamp, AVSEEK_FLAG_BACKWARD) >= 0) {
+            avcodec_flush_buffers(codec);
+            draining = false;
+            // Leading pictures of an open GOP come out before the keyframe;
+            // timestamps tell them, and the frames up to `index`, apart.
+            for (;;) {
+                const AVFrame* f = next();
+                if (!f) return nullptr;
+                if (f->best_effort_timestamp == AV_NOPTS_VALUE || frameAt(f->best_effort_timestamp) >= index) {
+                    return f;
+                }
+                drop(f);
+            }
+        }
+        for (int i = next_index; i < index; ++i) {
+            const AVFrame* f = next();
+            if (!f) return nullptr;
+            drop(f);
+        }
+        return next();
+    }
+
+    void drop(const AVFrame* f) {
+        if (f == frame) av_frame_unref(frame);
+    }
+
+    // Decode the next frame into a CPU-accessible AVFrame.
+    const AVFrame* next() {
+        for (;;) {
+            const int rc = avcodec_receive_frame(codec, frame);
+            if (rc == 0) {
+                readMotionVectors(frame);
+                if (frame->hw_frames_ctx) {
+                    av_frame_unref(sw_frame);
+                    if (av_hwframe_transfer_data(sw_frame, frame, 0) < 0) return nullptr;
+                    av_frame_unref(frame);
+                    return sw_frame;
+                }
+                return frame;
+            }
+            if (rc != AVERROR(EAGAIN) || draining) return nullptr;
+
+            // Feed the next video packet (or flush at end of file).
+            for (;;) {
+                if (av_read_frame(fmt, packet) < 0) {
+                    draining = true;
+                    avcodec_send_packet(codec, nullptr);
+                    break;
+                }
+                const bool mine = (packet->stream_index == stream_index);
+                if (mine) avcodec_send_packet(codec, packet);
+                av_packet_unref(packet);
+                if (mine) break;
+            }
+        }
+    }
+
+    // Past-reference block vectors of `f` as (source x, y) -> (block x, y).
+    void readMotionVectors(const AVFrame* f) {
+        motion_vectors.clear();
+        if (!export_mvs) return;
+        const AVFrameSideData* sd = av_frame_get_side_data(f, AV_FRAME_DATA_MOTION_VECTORS);
+        if (!sd) return;
+        const AVMotionVector* mv = reinterpret_cast<const AVMotionVector*>(sd->data);
+        const size_t n = sd->size / sizeof(AVMotionVector);
+        motion_vectors.reserve(n);
+        for (size_t k = 0; k < n; ++k) {
+            if (mv[k].source >= 0) continue;  // B-frame vector into a later frame
+            // Quarter-pel (motion_scale) precision rather than the rounded src_x/src_y.
+            const float scale = mv[k].motion_scale > 0 ? 1.0f / static_cast<float>(mv[k].motion_scale) : 1.0f;
+            const float x = static_cast<float>(mv[k].dst_x);
+            const float y = static_cast<float>(mv[k].dst_y);
+            motion_vectors.push_back({x + static_cast<float>(mv[k].motion_x) * scale,
+                                      y + static_cast<float>(mv[k].motion_y) * scale, x, y});
+        }
+    }
+
+    // To `dst_fmt` at dst_w x dst_h (the source size if 0). A reduced size
+    // is converted and box-filtered in one pass.
+    void convert(const AVFrame* src, int dst_fmt, SwsContext*& ctx, uint8_t* dst, int dst_stride,
+                 int dst_w = 0, int dst_h = 0) {
+        const bool reduced = dst_w > 0 && dst_h > 0 && (dst_w != src->width || dst_h != src->height);
+        ctx = sws_getCachedContext(ctx, src->width, src->height, static_cast<AVPixelFormat>(src->format),
+                                   reduced ? dst_w : src->width, reduced ? dst_h : src->height,
+                                   static_cast<AVPixelFormat>(dst_fmt),
+                                   reduced ? SWS_AREA : SWS_POINT, nullptr, nullptr, nullptr);
+        if (!ctx) return;
+        uint8_t* planes[4] = {dst, nullptr, nullptr, nullptr};
+        int strides[4] = {dst_stride, 0, 0, 0};
+        sws_scale(ctx, src->data, src->linesize, 0, src->height, planes, strides);
+    }
+};
+
+VideoFrameSource::VideoFrameSource(const std::string& path, VideoHwAccel hwaccel, bool motion_vectors)
+    : impl_(std::make_unique<Impl>()) {
+    if (!impl_->open(path, hwaccel, motion_vectors, error_)) {
+        impl_.reset();
+    }
+}
+
+VideoFrameSource::~VideoFrameSource() = default;
+
+bool VideoFrameSource::isOpen() const { return impl_ != nullptr; }
+
+double VideoFrameSource::frameRate() const {
+    if (!impl_) return 0.0;
+    const AVRational r = impl_->fmt->streams[impl_->stream_index]->avg_frame_rate;
+    return (r.num > 0 && r.den > 0) ? av_q2d(r) : 0.0;
+}
+
+bool VideoFrameSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!impl_ || index < next_index_ || end_index_.load() >= 0) return false;
+
+    const AVFrame* f = index > next_index_ ? impl_->skipTo(next_index_, index) : impl_->next();
+    if (!f) {
+        end_index_ = index;
+        return false;
+    }
+    next_index_ = index + 1;
+
+    const int w = f->width;
+    const int h = f->height;
+    out.w = w;
+    out.h = h;
+    if (req.rgb) {
+        // YUV goes to RGB at the smallest size the request allows, in the
+        // same swscale pass.
+        const int factor = RgbReduction(w, h, req.rgb_min_long_side);
+        const int rw = (w + factor - 1) / factor;
+        const int rh = (h + factor - 1) / factor;
+        out.rgb.resize(static_cast<size_t>(rw) * static_cast<size_t>(rh) * 3u);
+        out.rgb_w = rw;
+        out.rgb_h = rh;
+        impl_->convert(f, AV_PIX_FMT_RGB24, impl_->sws_rgb, out.rgb.data(), rw * 3, rw, rh);
+    }
+    if (req.luma_downscale > 0) {
+        // Tightly pack the Y plane (or convert to gray), then reduce.
+        impl_->scratch.resize(static_cast<size_t>(w) * static_cast<size_t>(h));
+        if (HasY8Plane(f->format)) {
+            for (int y = 0; y < h; ++y) {
+                std::memcpy(impl_->scratch.data() + static_cast<size_t>(y) * static_cast<size_t>(w),
+                            f->data[0] + static_cast<ptrdiff_t>(y) * f->linesize[0],
+                            static_cast<size_t>(w));
+            }
+        } else {
+            impl_->convert(f, AV_PIX_FMT_GRAY8, impl_->sws_gray, impl_->scratch.data(), w);
+        }
+        DownsampleLuma(impl_->scratch.data(), w, h, req.luma_downscale, out.luma);
+        out.luma_w = DownscaledSize(w, req.luma_downscale);
+        out.luma_h = DownscaledSize(h, req.luma_downscale);
+        out.luma_scale = req.luma_downscale;
+    }
+    out.motion_vectors.swap(impl_->motion_vectors);
+    impl_->drop(f);
+    return true;
+}
+
+std::vector<int> VideoFrameSource::keyframes() const {
+    std::vector<int> out;
+    if (!impl_) return out;
+    out.reserve(impl_->keys.size());
+    for (const Impl::Keyframe& k : impl_->keys) out.push_back(k.frame);
+    return out;
+}
+
+#else
+
+struct VideoFrameSource::Impl {};
+
+VideoFrameSource::VideoFrameSource(const std::string& path, VideoHwAccel, bool)
+    : error_("cannot decode " + path + ": face_pipeline was built without FFmpeg "
+             "(configure with FACE_PIPELINE_ENABLE_VIDEO=ON and libavcodec installed)") {}
+
+VideoFrameSource::~VideoFrameSource() = default;
+
+bool VideoFrameSource::isOpen() const { return false; }
+
+double VideoFrameSource::frameRate() const { return 0.0; }
+
+std::vector<int> VideoFrameSource::keyframes() const { return {}; }
+
+bool VideoFrameSource::read(int index, const FrameRequest&, LoadedRgbFrame& out) {
+    out.clear();
+    end_index_ = index;
+    return false;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_source.hpp"
+
+/**
+ * Hardware decode preference for VideoFrameSource.
+ */
+enum class VideoHwAccel {
+    None,          // software decode only
+    Auto,          // platform default (VideoToolbox on macOS, D3D11VA on Windows), else software
+    VideoToolbox,
+    D3D11VA,
+    DXVA2,
+};
+
+/**
+ * Parse a hwaccel name ("none", "auto", "videotoolbox", "d3d11va", "dxva2").
+ *
+ * @return false if the name is unknown
+ */
+bool ParseVideoHwAccel(const std::string& name, VideoHwAccel& out);
+
+/**
+ * Frames decoded straight from a video file via libavformat/libavcodec.
+ *
+ * Frames are decoded sequentially by a single decoder; hardware decode is
+ * used when requested and available, and silently falls back to software.
+ * Luma-only requests read the decoder's Y plane directly for YUV formats so
+ * GMC-only frames skip colour conversion, and RGB is converted straight at
+ * the reduced size FrameRequest::rgb_min_long_side allows.
+ *
+ * With `motion_vectors`, the decoder also exports each frame's block motion
+ * vectors (libavcodec's export_mvs; decoding is then in software) into
+ * LoadedRgbFrame::motion_vectors, which GMC fits instead of the pixels.
+ * Only vectors into an earlier frame are kept, and they are read as motion
+ * from the previous frame even where the reference lies further back.
+ *
+ * Frames can be passed over (skipsForward()). When the container indexes
+ * its keyframes (MP4/MOV, Matroska with cues), a skip past one seeks to
+ * the last keyframe before the frame wanted and decodes from there; other
+ * skips decode the frames in between and drop them. Frame indices of
+ * keyframes are their timestamps at the average frame rate.
+ *
+ * Requires an FFmpeg-enabled build (FACE_PIPELINE_VIDEO_FFMPEG); otherwise
+ * isOpen() is false and error() explains why.
+ */
+class VideoFrameSource final : public FrameSource {
+public:
+    VideoFrameSource(const std::string& path, VideoHwAccel hwaccel = VideoHwAccel::Auto, bool motion_vectors = false);
+    ~VideoFrameSource() override;
+
+    VideoFrameSource(const VideoFrameSource&) = delete;
+    VideoFrameSource& operator=(const VideoFrameSource&) = delete;
+
+    bool isOpen() const;
+    const std::string& error() const { return error_; }
+
+    /**
+     * Average frame rate reported by the container (0 if unknown).
+     */
+    double frameRate() const;
+
+    int frameCount() const override { return -1; }
+    bool randomAccess() const override { return false; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    int endIndex() const override { return end_index_.load(); }
+    bool skipsForward() const override { return true; }
+    std::vector<int> keyframes() const override;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::string error_;
+
+    std::mutex mu_;
+    int next_index_ = 0;
+    std::atomic<int> end_index_{-1};
+};
@@ -0,0 +1,283 @@
+#include "watch_source.hpp"
+
+#include <chrono>
+#include <thread>
+#include <unordered_set>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/event.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Upper bound on one wait; size-stability checks need periodic wake-ups
+// even when no notification arrives.
+constexpr int kPollMs = 50;
+
+// Size of a regular file, or -1 if it does not exist (yet).
+int64_t FileSize(const std::string& path) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) != 0 || !(st.st_mode & _S_IFREG)) return -1;
+    return static_cast<int64_t>(st.st_size);
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+    return static_cast<int64_t>(st.st_size);
+#endif
+}
+
+bool IsDirectory(const std::string& path) {
+#ifdef _WIN32
+    struct _stat64 st;
+    return _stat64(path.c_str(), &st) == 0 && (st.st_mode & _S_IFDIR);
+#else
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Watcher: platform directory notifications, used to wake waits early.
+
+#if defined(__linux__)
+struct WatchFolderSource::Watcher {
+    int fd = -1;
+    std::unordered_set<std::string> closed;  // files the writer has closed
+
+    explicit Watcher(const std::string& dir) {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ~Watcher() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    void drain() {
+        if (fd < 0) return;
+        alignas(inotify_event) char buf[4096];
+        for (;;) {
+            const ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n <= 0) break;
+            for (char* p = buf; p < buf + n;) {
+                const auto* ev = reinterpret_cast<const inotify_event*>(p);
+                if (ev->len > 0 && (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+                    // Names nobody asks for (other files) must not pile up.
+                    if (closed.size() > 4096) closed.clear();
+                    closed.insert(ev->name);
+                }
+                p += sizeof(inotify_event) + ev->len;
+            }
+        }
+    }
+
+    // Wakes on pending events but leaves them queued for drain(), which
+    // runs under the source lock.
+    void wait(int ms) {
+        if (fd < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            return;
+        }
+        pollfd p{fd, POLLIN, 0};
+        (void)::poll(&p, 1, ms);
+    }
+
+    bool takeClosed(const std::string& name) { return closed.erase(name) > 0; }
+};
+#elif defined(__APPLE__)
+struct WatchFolderSource::Watcher {
+    int kq = -1;
+    int dir_fd = -1;
+
+    explicit Watcher(const std::string& dir) {
+        dir_fd = ::open(dir.c_str(), O_EVTONLY);
+        kq = (dir_fd >= 0) ? kqueue() : -1;
+        if (kq >= 0) {
+            struct kevent ev;
+            EV_SET(&ev, dir_fd, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE | NOTE_EXTEND, 0, nullptr);
+            if (kevent(kq, &ev, 1, nullptr, 0, nullptr) < 0) {
+                ::close(kq);
+                kq = -1;
+            }
+        }
+    }
+    ~Watcher() {
+        if (kq >= 0) ::close(kq);
+        if (dir_fd >= 0) ::close(dir_fd);
+    }
+
+    void wait(int ms) {
+        if (kq < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            return;
+        }
+        timespec ts{ms / 1000, static_cast<long>(ms % 1000) * 1000000L};
+        struct kevent out;
+        (void)kevent(kq, nullptr, 0, &out, 1, &ts);
+    }
+
+    void drain() {}
+    // Directory events carry no per-file close information.
+    bool takeClosed(const std::string&) { return false; }
+};
+#elif defined(_WIN32)
+struct WatchFolderSource::Watcher {
+    HANDLE change = INVALID_HANDLE_VALUE;
+
+    explicit Watcher(const std::string& dir) {
+        change = FindFirstChangeNotificationA(
+            dir.c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    }
+    ~Watcher() {
+        if (change != INVALID_HANDLE_VALUE) FindCloseChangeNotification(change);
+    }
+
+    void wait(int ms) {
+        if (change == INVALID_HANDLE_VALUE) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            return;
+        }
+        if (WaitForSingleObject(change, static_cast<DWORD>(ms)) == WAIT_OBJECT_0) {
+            FindNextChangeNotification(change);
+        }
+    }
+
+    void drain() {}
+    bool takeClosed(const std::string&) { return false; }
+};
+#else
+struct WatchFolderSource::Watcher {
+    explicit Watcher(const std::string&) {}
+    void wait(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+    void drain() {}
+    bool takeClosed(const std::string&) { return false; }
+};
+#endif
+
+// ---------------------------------------------------------------------------
+// WatchFolderSource
+
+WatchFolderSource::WatchFolderSource(const WatchFolderOptions& options) : options_(options) {
+    if (!IsValidFramePattern(options_.pattern)) {
+        error_ = "invalid frame pattern '" + options_.pattern + "' (expected one %d conversion, e.g. frame%06d.png)";
+        return;
+    }
+    if (!IsDirectory(options_.dir)) {
+        error_ = "watch folder " + options_.dir + " does not exist";
+        return;
+    }
+    watcher_ = std::make_unique<Watcher>(options_.dir);
+    if (options_.frame_count == 0) end_index_ = 0;
+}
+
+WatchFolderSource::~WatchFolderSource() = default;
+
+std::string WatchFolderSource::framePath(int index) const {
+    return options_.dir + "/" + FormatFramePath(options_.pattern, options_.start_number + index);
+}
+
+int WatchFolderSource::endIndex() const {
+    const int end = end_index_.load();
+    return end >= 0 ? end : options_.frame_count;
+}
+
+bool WatchFolderSource::isCompleteLocked(int index, bool sentinel_seen) {
+    const std::string path = framePath(index);
+    const int64_t size = FileSize(path);
+    if (size < 0) return false;
+    // Once the writer signalled completion, every existing frame is final.
+    if (sentinel_seen) return true;
+    if (size == 0) return false;
+    if (watcher_->takeClosed(path.substr(options_.dir.size() + 1))) return true;
+    // Frames are written in order, so a successor means this one is done.
+    const bool has_next = options_.frame_count < 0 || index + 1 < options_.frame_count;
+    if (has_next && FileSize(framePath(index + 1)) >= 0) return true;
+
+    const int64_t now = NowMs();
+    if (size != pending_size_) {
+        pending_size_ = size;
+        pending_since_ms_ = now;
+        return false;
+    }
+    return now - pending_since_ms_ >= options_.settle_ms;
+}
+
+bool WatchFolderSource::waitForFrame(int index) {
+    if (!isOpen() || index < 0) return false;
+    if (options_.frame_count >= 0 && index >= options_.frame_count) return false;
+
+    std::unique_lock<std::mutex> lock(mu_);
+    for (;;) {
+        if (index < ready_) return true;
+        const int end = end_index_.load();
+        if (end >= 0 && index >= end) return false;
+
+        watcher_->drain();
+        // Check the sentinel first: once it exists, all frames are on disk.
+        const bool sentinel_seen =
+            !options_.sentinel.empty() && FileSize(options_.dir + "/" + options_.sentinel) >= 0;
+        bool progressed = false;
+        while ((options_.frame_count < 0 || ready_ < options_.frame_count) &&
+               isCompleteLocked(ready_, sentinel_seen)) {
+            ready_++;
+            pending_size_ = -1;
+            progressed = true;
+        }
+        if (options_.frame_count >= 0 && ready_ >= options_.frame_count) {
+            end_index_ = options_.frame_count;
+        } else if (sentinel_seen) {
+            end_index_ = ready_;
+        }
+        if (progressed) cv_.notify_all();
+        if (progressed || index < ready_ || end_index_.load() >= 0) continue;
+
+        // One thread waits on the watcher with the lock released; the
+        // others (decoders waiting on other frames) wait for its progress.
+        if (!polling_) {
+            polling_ = true;
+            lock.unlock();
+            watcher_->wait(kPollMs);
+            lock.lock();
+            polling_ = false;
+        } else {
+            cv_.wait_for(lock, std::chrono::milliseconds(kPollMs));
+        }
+    }
+}
+
+std::string WatchFolderSource::filePath(int index) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return index >= 0 && index < ready_ ? framePath(index) : std::string();
+}
+
+bool WatchFolderSource::read(int index, const FrameRequest& req, LoadedRgbFrame& out) {
+    if (!waitForFrame(index)) {
+        out.clear();
+        return false;
+    }
+    return LoadFrame(framePath(index), req, out);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "frame_source.hpp"
+
+/**
+ * Configuration for WatchFolderSource.
+ */
+struct WatchFolderOptions {
+    std::string dir;
+    std::string pattern = "frame%06d.png";  // see IsValidFramePattern
+    int start_number = 0;                   // number of the first frame file
+    int frame_count = -1;                   // finalize after this many frames (-1 = unknown)
+    std::string sentinel;                   // finalize once this file appears in `dir`
+    int settle_ms = 250;                    // unchanged-size window for files with no close event
+};
+
+/**
+ * Image sequence consumed while it is still being written into a folder.
+ *
+ * Frame `i` is `dir/pattern(start_number + i)`. A frame is handed out once
+ * its file is complete: the writer closed it (inotify), the next frame
+ * already exists, the sentinel appeared, or its size stayed unchanged for
+ * `settle_ms`. Directory change notifications (inotify on Linux, kqueue on
+ * macOS, change notifications on Windows) only wake the wait early; the
+ * completeness rules are the same everywhere, so other platforms poll.
+ *
+ * The sequence ends after `frame_count` frames, or at the first missing
+ * frame once the sentinel exists.
+ */
+class WatchFolderSource final : public FrameSource {
+public:
+    explicit WatchFolderSource(const WatchFolderOptions& options);
+    ~WatchFolderSource() override;
+
+    WatchFolderSource(const WatchFolderSource&) = delete;
+    WatchFolderSource& operator=(const WatchFolderSource&) = delete;
+
+    bool isOpen() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    /**
+     * Path of frame `index`.
+     */
+    std::string framePath(int index) const;
+
+    int frameCount() const override { return options_.frame_count; }
+    bool randomAccess() const override { return true; }
+    bool read(int index, const FrameRequest& req, LoadedRgbFrame& out) override;
+    /** Only frames already complete: the writer may still be at the others. */
+    std::string filePath(int index) const override;
+    int endIndex() const override;
+    bool waitForFrame(int index) override;
+
+private:
+    struct Watcher;
+
+    bool isCompleteLocked(int index, bool sentinel_seen);
+
+    WatchFolderOptions options_;
+    std::string error_;
+    std::unique_ptr<Watcher> watcher_;
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    bool polling_ = false;      // a thread is waiting on the watcher
+    int ready_ = 0;             // frames [0, ready_) are complete
+    int64_t pending_size_ = -1;  // last seen size of frame ready_
+    int64_t pending_since_ms_ = 0;
+    std::atomic<int> end_index_{-1};
+};
@@ -0,0 +1,69 @@
+// Build-time generator for FACE_PIPELINE_EMBED_MODELS: turns ncnn model
+// files into the C++ tables embedded_models.cpp includes.
+//
+// Usage: embed_models <out.inc> <stem> <param> <bin> [<stem> <param> <bin> ...]
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+bool ReadFile(const char* path, std::vector<unsigned char>& out) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// One byte array; decimal, 16 bytes per line keeps compilers' line limits happy.
+void WriteArray(FILE* out, const char* decl, const std::vector<unsigned char>& data, bool terminate) {
+    fprintf(out, "%s[] = {\n", decl);
+    for (size_t i = 0; i < data.size(); ++i) {
+        fprintf(out, "%u,%s", static_cast<unsigned>(data[i]), (i % 16 == 15) ? "\n" : "");
+    }
+    if (terminate) fprintf(out, "0,");
+    fprintf(out, "\n};\n");
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 5 || (argc - 2) % 3 != 0) {
+        fprintf(stderr, "Usage: %s <out.inc> <stem> <param> <bin> [...]\n", argv[0]);
+        return 1;
+    }
+    FILE* out = fopen(argv[1], "wb");
+    if (!out) {
+        fprintf(stderr, "Error: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(out, "// Generated by tools/embed_models.cpp; do not edit.\n\nnamespace {\n");
+    const int count = (argc - 2) / 3;
+    std::vector<unsigned char> data;
+    for (int m = 0; m < count; ++m) {
+        const char* param = argv[3 + m * 3];
+        const char* bin = argv[4 + m * 3];
+        const std::string index = std::to_string(m);
+        if (!ReadFile(param, data)) {
+            fprintf(stderr, "Error: cannot read %s\n", param);
+            fclose(out);
+            return 1;
+        }
+        WriteArray(out, ("const unsigned char kParam" + index).c_str(), data, true);
+        if (!ReadFile(bin, data)) {
+            fprintf(stderr, "Error: cannot read %s\n", bin);
+            fclose(out);
+            return 1;
+        }
+        // ncnn reads weights in place, which needs at least 4-byte alignment.
+        WriteArray(out, ("alignas(16) const unsigned char kBin" + index).c_str(), data, false);
+    }
+    fprintf(out, "\nconst EmbeddedModel kEmbeddedModels[] = {\n");
+    for (int m = 0; m < count; ++m) {
+        fprintf(out, "    {\"%s\", reinterpret_cast<const char*>(kParam%d), kBin%d, sizeof(kBin%d)},\n",
+                argv[2 + m * 3], m, m, m);
+    }
+    fprintf(out, "};\nconstexpr size_t kEmbeddedModelCount = %d;\n}  // namespace\n", count);
+    return fclose(out) == 0 ? 0 : 1;
+}
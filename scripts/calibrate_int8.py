@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""
+Dev script: build INT8 SCRFD / MobileFaceNet models from our own sequences.
+
+This script:
+1. Exports calibration samples with `face_pipeline --export-calibration`
+   (letterboxed detector inputs and aligned 112x112 ReID crops)
+2. Builds activation tables with ncnn's `ncnn2table`
+3. Writes `scrfd-int8.*` / `mobilefacenet-int8.*` next to the fp32 models with `ncnn2int8`
+4. Runs `face_pipeline --int8-parity` and fails if the INT8 detector drifts from fp32
+
+The pipeline loads the INT8 files when started with `--int8`.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import shutil
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+from typing import List
+
+
+# -----------------------------------------------------------------------------
+# Configuration
+# -----------------------------------------------------------------------------
+
+# SCRFD normalizes in C++ ((pixel - 127.5) / 127.5); the exported samples are
+# raw letterboxed pixels of varying shape, so ncnn2table must not resize them.
+SCRFD_TABLE_ARGS = [
+    "mean=[127.5,127.5,127.5]",
+    "norm=[0.0078431,0.0078431,0.0078431]",
+    "shape=[0,0,3]",
+    "pixel=RGB",
+]
+
+# The MobileFaceNet graph contains its own mean/norm layers.
+REID_TABLE_ARGS = [
+    "mean=[0,0,0]",
+    "norm=[1,1,1]",
+    "shape=[112,112,3]",
+    "pixel=RGB",
+]
+
+
+def _find_tool(name: str, tools_dir: str | None) -> str:
+    if tools_dir:
+        candidate = Path(tools_dir) / name
+        if candidate.exists():
+            return str(candidate)
+    found = shutil.which(name)
+    if not found:
+        raise FileNotFoundError(f"{name} not found (build ncnn with NCNN_BUILD_TOOLS=ON or pass --ncnn-tools)")
+    return found
+
+
+def _run(cmd: List[str]) -> None:
+    print("+ " + " ".join(cmd), file=sys.stderr)
+    subprocess.run(cmd, check=True)
+
+
+def _model_stem(model_dir: Path, stems: List[str]) -> Path:
+    """First stem whose .param/.bin both exist (same order the pipeline uses)."""
+    for stem in stems:
+        path = model_dir / stem
+        if path.with_suffix(".param").exists() and path.with_suffix(".bin").exists():
+            return path
+    raise FileNotFoundError(f"none of {stems} found in {model_dir}")
+
+
+def quantize(
+    tools: dict,
+    src: Path,
+    dst: Path,
+    sample_list: Path,
+    table_args: List[str],
+    work_dir: Path,
+    threads: int,
+) -> None:
+    """Calibrate `src` on the samples in `sample_list` and write the INT8 model `dst`."""
+    table = work_dir / f"{dst.name}.table"
+    _run(
+        [
+            tools["ncnn2table"],
+            str(src.with_suffix(".param")),
+            str(src.with_suffix(".bin")),
+            str(sample_list),
+            str(table),
+            *table_args,
+            f"thread={threads}",
+            "method=kl",
+        ]
+    )
+    _run(
+        [
+            tools["ncnn2int8"],
+            str(src.with_suffix(".param")),
+            str(src.with_suffix(".bin")),
+            str(dst.with_suffix(".param")),
+            str(dst.with_suffix(".bin")),
+            str(table),
+        ]
+    )
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Build INT8 face pipeline models from image sequences")
+    parser.add_argument("--pipeline", required=True, help="Path to the face_pipeline executable")
+    parser.add_argument("--model", required=True, help="Directory containing scrfd.param and scrfd.bin")
+    parser.add_argument("--reid-model", help="Optional directory containing mobilefacenet-*.param/.bin")
+    parser.add_argument("--images-file", required=True, help="File listing calibration frame paths, one per line")
+    parser.add_argument("--frames", type=int, default=100, help="Frames sampled for calibration (default: 100)")
+    parser.add_argument("--min-recall", type=float, default=0.95, help="Parity threshold (default: 0.95)")
+    parser.add_argument("--ncnn-tools", help="Directory containing ncnn2table and ncnn2int8 (default: PATH)")
+    parser.add_argument("--threads", type=int, default=4, help="ncnn2table threads (default: 4)")
+    parser.add_argument("--keep-samples", help="Write calibration samples here instead of a temp directory")
+    args = parser.parse_args()
+
+    tools = {name: _find_tool(name, args.ncnn_tools) for name in ("ncnn2table", "ncnn2int8")}
+    model_dir = Path(args.model)
+    reid_dir = Path(args.reid_model) if args.reid_model else None
+
+    with tempfile.TemporaryDirectory(prefix="face_pipeline_calib_") as tmp:
+        work_dir = Path(args.keep_samples) if args.keep_samples else Path(tmp)
+        work_dir.mkdir(parents=True, exist_ok=True)
+        samples = work_dir / "samples"
+
+        export = [
+            args.pipeline,
+            "--model", str(model_dir),
+            "--images-file", args.images_file,
+            "--export-calibration", str(samples),
+            "--calib-frames", str(args.frames),
+        ]
+        if reid_dir:
+            export += ["--reid-model", str(reid_dir)]
+        _run(export)
+
+        # The optimized graph (prepare_models) if there is one, as for ReID.
+        quantize(tools, _model_stem(model_dir, ["scrfd-opt", "scrfd"]), model_dir / "scrfd-int8",
+                 samples / "scrfd.txt", SCRFD_TABLE_ARGS, work_dir, args.threads)
+        if reid_dir:
+            # ncnn2int8 needs the optimized graph (BatchNorm fused into InnerProduct).
+            src = _model_stem(reid_dir, ["mobilefacenet-opt", "mobilefacenet"])
+            quantize(tools, src, reid_dir / "mobilefacenet-int8",
+                     samples / "reid.txt", REID_TABLE_ARGS, work_dir, args.threads)
+
+    parity = [
+        args.pipeline,
+        "--model", str(model_dir),
+        "--images-file", args.images_file,
+        "--int8-parity",
+        "--int8-min-recall", str(args.min_recall),
+        "--calib-frames", str(args.frames),
+    ]
+    if reid_dir:
+        parity += ["--reid-model", str(reid_dir)]
+    print("+ " + " ".join(parity), file=sys.stderr)
+    result = subprocess.run(parity, stdout=subprocess.PIPE, text=True)
+    report = json.loads(result.stdout) if result.stdout.strip() else {}
+    print(json.dumps(report, indent=2))
+    if result.returncode != 0:
+        sys.exit(result.returncode)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+Dev script: write the optimized forms of the SCRFD / MobileFaceNet models.
+
+This script:
+1. Runs ncnn's `ncnnoptimize` on `scrfd` and `mobilefacenet` (layer fusion,
+   fp16 weight storage) and writes `scrfd-opt.*` / `mobilefacenet-opt.*`
+   next to them
+2. Writes `manifest.txt` into each model directory: one
+   "<fnv1a64> <size> <file>" line per model file it holds
+
+The pipeline prefers the `-opt` files when present, and refuses to load a
+file the manifest lists with another size or checksum.
+"""
+
+from __future__ import annotations
+
+import argparse
+import shutil
+import subprocess
+import sys
+from pathlib import Path
+from typing import List
+
+MANIFEST = "manifest.txt"  # read by cpp/src/inference_backend.cpp
+
+# ncnnoptimize's last argument: 0 = fp32 weights, 1 = fp16 storage.
+FP16_STORAGE = "1"
+
+
+def _find_tool(name: str, tools_dir: str | None) -> str:
+    if tools_dir:
+        candidate = Path(tools_dir) / name
+        if candidate.exists():
+            return str(candidate)
+    found = shutil.which(name)
+    if not found:
+        raise FileNotFoundError(f"{name} not found (build ncnn with NCNN_BUILD_TOOLS=ON or pass --ncnn-tools)")
+    return found
+
+
+def _run(cmd: List[str]) -> None:
+    print("+ " + " ".join(cmd), file=sys.stderr)
+    subprocess.run(cmd, check=True)
+
+
+def fnv1a64(path: Path) -> int:
+    """Byte-wise FNV-1a, as the runtime checks it."""
+    h = 0xCBF29CE484222325
+    with path.open("rb") as f:
+        for chunk in iter(lambda: f.read(1 << 16), b""):
+            for b in chunk:
+                h = ((h ^ b) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def optimize(tool: str, src: Path, dst: Path, fp16: bool) -> None:
+    """Fuse `src`'s layers into `dst` (stems without extension)."""
+    _run(
+        [
+            tool,
+            str(src.with_suffix(".param")),
+            str(src.with_suffix(".bin")),
+            str(dst.with_suffix(".param")),
+            str(dst.with_suffix(".bin")),
+            FP16_STORAGE if fp16 else "0",
+        ]
+    )
+
+
+def write_manifest(model_dir: Path) -> None:
+    """List every .param/.bin pair of `model_dir` with its size and checksum."""
+    lines = []
+    for param in sorted(model_dir.glob("*.param")):
+        bin_path = param.with_suffix(".bin")
+        if not bin_path.exists():
+            continue
+        for path in (param, bin_path):
+            lines.append(f"{fnv1a64(path):016x} {path.stat().st_size} {path.name}\n")
+    (model_dir / MANIFEST).write_text("".join(lines))
+    print(f"wrote {model_dir / MANIFEST} ({len(lines)} files)", file=sys.stderr)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Write optimized face pipeline models and their manifests")
+    parser.add_argument("--model", required=True, help="Directory containing scrfd.param and scrfd.bin")
+    parser.add_argument("--reid-model", help="Optional directory containing mobilefacenet.param/.bin")
+    parser.add_argument("--ncnn-tools", help="Directory containing ncnnoptimize (default: PATH)")
+    parser.add_argument("--fp32", action="store_true", help="Keep fp32 weights instead of fp16 storage")
+    parser.add_argument("--manifest-only", action="store_true",
+                        help="Only rewrite the manifests (e.g. after calibrate_int8)")
+    args = parser.parse_args()
+
+    dirs = [Path(args.model)] + ([Path(args.reid_model)] if args.reid_model else [])
+    if not args.manifest_only:
+        tool = _find_tool("ncnnoptimize", args.ncnn_tools)
+        optimize(tool, dirs[0] / "scrfd", dirs[0] / "scrfd-opt", not args.fp32)
+        if args.reid_model:
+            optimize(tool, dirs[1] / "mobilefacenet", dirs[1] / "mobilefacenet-opt", not args.fp32)
+    for model_dir in dirs:
+        write_manifest(model_dir)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,12 +1,14 @@
 /**
  * Face Detection and Tracking Pipeline
  *
- * TypeScript wrapper for the C++ face pipeline.
- * Single export: runFacePipeline()
+ * TypeScript wrapper for the C++ face pipeline: the face_pipeline.node
+ * addon in-process when it is built, else the face_pipeline executable.
+ * Exports: runFacePipeline(), detectFacesInFrame()
  */
 
 import { child_process, fs, os, path } from "../cep/node";
 import { csi } from "./bolt";
+import { BinaryTrack, decodeTrackBinary } from "./trackBinary";
 
 // -----------------------------------------------------------------------------
 // Types
@@ -28,11 +30,31 @@ export interface TrackFrame {
 export interface FaceTrack {
   id: number;
   frames: TrackFrame[];
+  /**
+   * The track as the MOGRT template's Mask Path keyframes ("<ticks>,<base64>;"
+   * per keyframe, every frame of the run), when PipelineOptions.mogrtTicksPerFrame
+   * asked for them
+   */
+  mogrtKeyframes?: string;
 }
 
 export interface PipelineResult {
   tracks: FaceTrack[];
   frameCount: number;
+  /** The run ended early (aborted or out of time); tracks end at frameCount */
+  stopped?: boolean;
+}
+
+/**
+ * Progress of a run: frames read (total -1 while unknown), shots tracked,
+ * then the start of offline linking.
+ */
+export interface PipelineProgress {
+  stage: "frames" | "shots" | "linking";
+  done: number;
+  total: number;
+  /** Progress of the quick coarse pass (see onPreview) */
+  preview?: boolean;
 }
 
 export interface PipelineOptions {
@@ -44,6 +66,46 @@ export interface PipelineOptions {
   videoFps?: number;
   /** IoU threshold for tracking (default: 0.15) */
   iouThresh?: number;
+  /**
+   * Seconds the run may take: it detects less, then drops ReID and camera
+   * motion to fit, and returns what it tracked when time runs out
+   */
+  timeBudget?: number;
+  /**
+   * Frame to track outward from (the playhead): tracking runs on to the end
+   * and back to the start at once, so the frames around it are ready first
+   */
+  priorityFrame?: number;
+  /**
+   * First frames of the shots the edit cuts to (clip boundaries in the
+   * selection): tracks end there without the pipeline looking for the cut
+   */
+  cuts?: number[];
+  /** Aborting ends the run early; it still resolves with the frames read so far */
+  signal?: AbortSignal;
+  /** Called as the run goes */
+  onProgress?: (progress: PipelineProgress) => void;
+  /**
+   * Called with each tracklet as soon as it ends. Its id is the tracklet's;
+   * the track it ends up in is known once the run is done.
+   */
+  onSegment?: (segment: FaceTrack) => void;
+  /**
+   * Run a quick coarse pass first (small detector input, sparse detection,
+   * no ReID) and call this with its tracks; the result replaces them
+   */
+  onPreview?: (preview: PipelineResult) => void;
+  /**
+   * Premiere ticks of one frame: the pipeline also encodes each track's
+   * MOGRT mask keyframes (FaceTrack.mogrtKeyframes), off the UI thread
+   */
+  mogrtTicksPerFrame?: string;
+  /**
+   * Directory for small JPEG copies of the frames, made from the pipeline's
+   * own decode: <proxyDir>/<frame index, 6 digits>.jpg (see proxyFramePath).
+   * Ignored with priorityFrame
+   */
+  proxyDir?: string;
 }
 
 // -----------------------------------------------------------------------------
@@ -137,6 +199,207 @@ function getModelDir(): string {
   );
 }
 
+// -----------------------------------------------------------------------------
+// Native addon (cpp/node, built with -DFACE_PIPELINE_NODE_ADDON=ON)
+// -----------------------------------------------------------------------------
+
+/** Pipeline loaded by the addon (opaque). */
+type NativePipeline = object;
+
+/** The addon's tracks have the binary result's layout. */
+type NativeTrack = BinaryTrack;
+
+interface NativeResult {
+  frameCount: number;
+  stopped: boolean;
+  tracks: NativeTrack[];
+}
+
+interface NativeRunOptions {
+  videoFps?: number;
+  timeBudget?: number;
+  onProgress?: (stage: PipelineProgress["stage"], done: number, total: number) => void;
+  /** A nonzero cancel[0] stops the run */
+  cancel?: Int32Array;
+}
+
+/** A frame in memory: packed RGB24 (default), BGRA or NV12. */
+export interface FramePixels {
+  width: number;
+  height: number;
+  format?: "rgb24" | "bgra" | "nv12";
+  data: ArrayBuffer | ArrayBufferView;
+}
+
+interface NativeAddon {
+  createPipeline(config: {
+    modelDir: string;
+    confThresh?: number;
+    detectionFps?: number;
+    iouThresh?: number;
+  }): Promise<NativePipeline>;
+  trackImages(pipeline: NativePipeline, paths: string[], options?: NativeRunOptions): Promise<NativeResult>;
+  detectFrame(
+    pipeline: NativePipeline,
+    frame: FramePixels
+  ): Promise<{ boxes: Float32Array; scores: Float32Array }>;
+}
+
+let _addon: NativeAddon | null | undefined;
+
+/**
+ * The addon, or null if it is not built (or does not load here).
+ */
+function getNativeAddon(): NativeAddon | null {
+  if (_addon !== undefined) return _addon;
+  _addon = null;
+  if (typeof require === "undefined") return _addon;
+  const extRoot = getExtensionRoot();
+  const candidates = [
+    path.join(extRoot, "cpp", "build", "Release", "face_pipeline.node"),
+    path.join(extRoot, "cpp", "build", "face_pipeline.node"),
+    // Packaged CEP assets
+    path.join(extRoot, "bin", "face_pipeline.node"),
+    // Repo/dev fallback
+    path.join(extRoot, "src", "bin", "face_pipeline.node"),
+  ];
+  for (const candidate of candidates) {
+    try {
+      if (fs.existsSync(candidate)) {
+        _addon = require(candidate) as NativeAddon;
+        break;
+      }
+    } catch (e) {
+      console.warn(`face_pipeline.node did not load (${candidate}):`, e);
+    }
+  }
+  return _addon;
+}
+
+// Pipelines stay loaded between runs, one per model and detector setting.
+const _nativePipelines = new Map<string, Promise<NativePipeline>>();
+
+function getNativePipeline(
+  addon: NativeAddon,
+  config: { confThresh: number; detectionFps: number; iouThresh: number }
+): Promise<NativePipeline> {
+  const modelDir = getModelDir();
+  const key = JSON.stringify([modelDir, config.confThresh, config.detectionFps, config.iouThresh]);
+  let pipeline = _nativePipelines.get(key);
+  if (!pipeline) {
+    pipeline = addon.createPipeline({ modelDir, ...config });
+    // A failed load is retried next time.
+    pipeline.catch(() => _nativePipelines.delete(key));
+    _nativePipelines.set(key, pipeline);
+  }
+  return pipeline;
+}
+
+/**
+ * Convert a track of typed arrays (the addon's, the binary result's) to a typed track.
+ */
+function parseNativeTrack(raw: NativeTrack): FaceTrack {
+  const frames: TrackFrame[] = new Array(raw.frameIndices.length);
+  for (let f = 0; f < frames.length; f++) {
+    frames[f] = {
+      frameIndex: raw.frameIndices[f],
+      bbox: {
+        x1: raw.boxes[f * 4],
+        y1: raw.boxes[f * 4 + 1],
+        x2: raw.boxes[f * 4 + 2],
+        y2: raw.boxes[f * 4 + 3],
+      },
+      confidence: raw.confidences[f],
+    };
+  }
+  return { id: raw.id, frames };
+}
+
+/**
+ * Track with the addon: no process, no paths on stdin, no JSON.
+ */
+async function trackNative(
+  addon: NativeAddon,
+  imagePaths: string[],
+  options: {
+    confThresh: number;
+    detectionFps: number;
+    videoFps: number;
+    iouThresh: number;
+    timeBudget?: number;
+    signal?: AbortSignal;
+    onProgress?: (progress: PipelineProgress) => void;
+  }
+): Promise<PipelineResult> {
+  const pipeline = await getNativePipeline(addon, options);
+  const cancel = new Int32Array(1);
+  const stop = () => {
+    cancel[0] = 1;
+  };
+  if (options.signal?.aborted) stop();
+  options.signal?.addEventListener("abort", stop, { once: true });
+  // Frames are reported one by one; pass them on at most every 200 ms.
+  let last = 0;
+  const onProgress = options.onProgress;
+  try {
+    const result = await addon.trackImages(pipeline, imagePaths, {
+      videoFps: options.videoFps,
+      timeBudget: options.timeBudget,
+      cancel,
+      onProgress: onProgress
+        ? (stage, done, total) => {
+            const now = Date.now();
+            if (stage === "frames" && done !== total && now - last < 200) return;
+            last = now;
+            onProgress({ stage, done, total });
+          }
+        : undefined,
+    });
+    return {
+      tracks: result.tracks.map(parseNativeTrack),
+      frameCount: result.frameCount,
+      stopped: result.stopped,
+    };
+  } finally {
+    options.signal?.removeEventListener("abort", stop);
+  }
+}
+
+/**
+ * Compact description of a numbered image sequence
+ * (e.g. `/tmp/x/frame%06d.png` frames 0..215999).
+ */
+interface FrameSequence {
+  pattern: string;
+  first: number;
+  last: number;
+}
+
+/**
+ * Detect whether paths are consecutive frames of one numbered sequence, so the
+ * pipeline can be given a pattern and range instead of every path on stdin.
+ */
+function describeFrameSequence(imagePaths: string[]): FrameSequence | null {
+  const match = /^(.*?)(\d+)(\.[^./\\]+)$/.exec(imagePaths[0] ?? "");
+  if (!match) return null;
+  const [, prefix, digits, suffix] = match;
+  const first = parseInt(digits, 10);
+  const padded = digits.length > 1 && digits.startsWith("0");
+  const width = digits.length;
+  const last = first + imagePaths.length - 1;
+  if (!Number.isSafeInteger(last) || last > 0x7fffffff) return null;
+
+  for (let i = 0; i < imagePaths.length; i++) {
+    const n = String(first + i);
+    const expected = prefix + (padded ? n.padStart(width, "0") : n) + suffix;
+    if (imagePaths[i] !== expected) return null;
+  }
+  // Zero-padded numbers keep their width ("%06d"); others use plain "%d".
+  const escape = (s: string) => s.replace(/%/g, "%%");
+  const conversion = padded ? `%0${width}d` : "%d";
+  return { pattern: escape(prefix) + conversion + escape(suffix), first, last };
+}
+
 /**
  * Spawn the C++ face pipeline executable.
  */
@@ -147,16 +410,32 @@ function spawnPipeline(
     detectionFps: number;
     videoFps: number;
     iouThresh: number;
+    timeBudget?: number;
+    priorityFrame?: number;
+    cuts?: number[];
+    signal?: AbortSignal;
+    onProgress?: (progress: PipelineProgress) => void;
+    onSegment?: (segment: FaceTrack) => void;
+    onPreview?: (preview: PipelineResult) => void;
+    mogrtTicksPerFrame?: string;
+    proxyDir?: string;
   }
 ): Promise<PipelineResult> {
   return new Promise((resolve, reject) => {
     const executable = getPipelineExecutable();
     const modelDir = getModelDir();
 
+    // Numbered sequences are described by pattern + range, which keeps
+    // stdin (and the pipeline's path list) out of the picture entirely.
+    const sequence = describeFrameSequence(imagePaths);
+    const inputArgs = sequence
+      ? ["--frames", sequence.pattern, "--range", `${sequence.first}:${sequence.last}`]
+      : ["--track"];
+
     const args = [
       "--model",
       modelDir,
-      "--track",
+      ...inputArgs,
       "--conf",
       options.confThresh.toString(),
       "--detection-fps",
@@ -165,7 +444,33 @@ function spawnPipeline(
       options.videoFps.toString(),
       "--iou",
       options.iouThresh.toString(),
+      "--stream-events",
     ];
+    if (options.onPreview) args.push("--preview");
+    if (options.priorityFrame !== undefined && options.priorityFrame > 0) {
+      args.push("--priority-frame", Math.floor(options.priorityFrame).toString());
+    }
+    if (options.timeBudget !== undefined && options.timeBudget > 0) {
+      args.push("--time-budget", options.timeBudget.toString());
+    }
+    if (options.cuts?.length) args.push("--cuts", options.cuts.join(","));
+    if (options.proxyDir && !(options.priorityFrame! > 0)) args.push("--proxy-dir", options.proxyDir);
+    // With a pattern, stdin stays open for a "stop" line; paths on stdin
+    // leave a signal as the way to stop.
+    const stopOnStdin = sequence !== null && options.signal !== undefined;
+    if (stopOnStdin) args.push("--stop-on-stdin");
+    // Without a segment consumer the tracks come back whole, in the compact
+    // binary form, through a temporary file instead of JSON on stdout.
+    const resultFile = options.onSegment
+      ? null
+      : path.join(os.tmpdir(), `face_pipeline-${process.pid}-${Date.now()}-${Math.random().toString(36).slice(2)}.fptrk`);
+    if (resultFile) args.push("--output-format", "binary", "--output", resultFile);
+    // MOGRT keyframes need the whole tracks too.
+    const mogrtFile =
+      resultFile && options.mogrtTicksPerFrame ? resultFile.replace(/\.fptrk$/, ".mogrt.json") : null;
+    if (mogrtFile) {
+      args.push("--emit-mogrt-keyframes", mogrtFile, "--ticks-per-frame", options.mogrtTicksPerFrame!);
+    }
 
     // Set up environment for dynamic library loading
     const spawnEnv = { ...process.env };
@@ -193,16 +498,75 @@ function spawnPipeline(
     });
 
     // Write image paths to stdin (one per line)
-    for (const p of imagePaths) {
-      proc.stdin.write(p + "\n");
+    if (!sequence) {
+      for (const p of imagePaths) {
+        proc.stdin.write(p + "\n");
+      }
+    }
+    if (!stopOnStdin) proc.stdin.end();
+    // A "stop" may race the pipeline's exit.
+    proc.stdin.on("error", () => {});
+
+    const stop = () => {
+      if (stopOnStdin) {
+        proc.stdin.end("stop\n");
+      } else {
+        proc.kill("SIGINT");
+      }
+    };
+    if (options.signal?.aborted) {
+      stop();
+    } else {
+      options.signal?.addEventListener("abort", stop, { once: true });
     }
-    proc.stdin.end();
 
-    let stdout = "";
+    // Events arrive one JSON object per line; only tracklets and the final
+    // event are kept (the preview's tracks go to onPreview).
+    let pending = "";
     let stderr = "";
+    let parseError: string | null = null;
+    const segments: FaceTrack[] = [];
+    let done: RawDoneEvent | null = null;
+
+    const handleLine = (line: string) => {
+      if (line.trim() === "") return;
+      let event: RawEvent;
+      try {
+        event = JSON.parse(line) as RawEvent;
+      } catch {
+        parseError = parseError ?? line;
+        return;
+      }
+      if (event.event === "progress") {
+        options.onProgress?.({
+          stage: event.stage,
+          done: event.done,
+          total: event.total,
+          ...(event.preview ? { preview: true } : {}),
+        });
+      } else if (event.event === "preview") {
+        options.onPreview?.({
+          tracks: event.tracks.map(parseRawTrack),
+          frameCount: event.frameCount,
+          stopped: event.stopped === true,
+        });
+      } else if (event.event === "segment") {
+        const segment = parseRawTrack(event);
+        segments.push(segment);
+        options.onSegment?.(segment);
+      } else if (event.event === "done") {
+        done = event;
+      }
+    };
 
     proc.stdout.on("data", (data) => {
-      stdout += data.toString();
+      pending += data.toString();
+      let newline = pending.indexOf("\n");
+      while (newline >= 0) {
+        handleLine(pending.slice(0, newline));
+        pending = pending.slice(newline + 1);
+        newline = pending.indexOf("\n");
+      }
     });
 
     proc.stderr.on("data", (data) => {
@@ -210,19 +574,61 @@ function spawnPipeline(
     });
 
     proc.on("close", (code) => {
+      options.signal?.removeEventListener("abort", stop);
+      handleLine(pending);
       if (code !== 0) {
-        reject(
-          new Error(`Face pipeline exited with code ${code}: ${stderr || stdout}`)
-        );
+        reject(new Error(`Face pipeline exited with code ${code}: ${stderr}`));
         return;
       }
-
-      try {
-        const result = JSON.parse(stdout) as RawResult;
-        resolve(parseRawResult(result));
-      } catch (e) {
-        reject(new Error(`Failed to parse pipeline output: ${stdout}`));
+      if (parseError !== null || done === null) {
+        if (resultFile) fs.rm(resultFile, { force: true }, () => {});
+        if (mogrtFile) fs.rm(mogrtFile, { force: true }, () => {});
+        reject(new Error(`Failed to parse pipeline output: ${parseError ?? "no result"}`));
+        return;
+      }
+      const finished: RawDoneEvent = done;
+      if (!finished.output) {
+        resolve(mergeSegments(finished, segments));
+        return;
       }
+      fs.readFile(finished.output, (err, bytes) => {
+        fs.rm(finished.output!, { force: true }, () => {});
+        if (err) {
+          reject(new Error(`Failed to read pipeline output: ${err.message}`));
+          return;
+        }
+        let decoded: PipelineResult;
+        try {
+          const result = decodeTrackBinary(bytes);
+          decoded = {
+            tracks: result.tracks.map(parseNativeTrack),
+            frameCount: result.frameCount,
+            stopped: result.stopped,
+          };
+        } catch (e) {
+          reject(new Error(`Failed to parse pipeline output: ${(e as Error).message}`));
+          return;
+        }
+        // Keyframes of a stopped run stop short of the frames the panel has.
+        if (!mogrtFile || decoded.stopped) {
+          if (mogrtFile) fs.rm(mogrtFile, { force: true }, () => {});
+          resolve(decoded);
+          return;
+        }
+        // Missing when the run stopped during the preview: the panel then
+        // encodes the keyframes itself.
+        fs.readFile(mogrtFile, "utf8", (mogrtErr, text) => {
+          fs.rm(mogrtFile, { force: true }, () => {});
+          if (!mogrtErr) {
+            try {
+              attachMogrtKeyframes(decoded, JSON.parse(text) as RawMogrtKeyframes);
+            } catch {
+              // Same fallback as a missing file.
+            }
+          }
+          resolve(decoded);
+        });
+      });
     });
 
     proc.on("error", (err) => {
@@ -232,27 +638,71 @@ function spawnPipeline(
 }
 
 /**
- * Raw result from C++ pipeline (bbox as array).
+ * --emit-mogrt-keyframes file (cpp/src/mogrt_keyframes.hpp).
+ */
+interface RawMogrtKeyframes {
+  ticksPerFrame: string;
+  frameCount: number;
+  tracks: Array<{ id: number; keyframes: string }>;
+}
+
+function attachMogrtKeyframes(result: PipelineResult, raw: RawMogrtKeyframes): void {
+  const byId = new Map(raw.tracks.map((t) => [t.id, t.keyframes]));
+  for (const track of result.tracks) {
+    const keyframes = byId.get(track.id);
+    if (keyframes !== undefined) track.mogrtKeyframes = keyframes;
+  }
+}
+
+/**
+ * Raw track from C++ pipeline (bbox as array).
  */
-interface RawResult {
-  tracks: Array<{
-    id: number;
-    frames: Array<{
-      frameIndex: number;
-      bbox: [number, number, number, number];
-      confidence: number;
-    }>;
+interface RawTrack {
+  id: number;
+  frames: Array<{
+    frameIndex: number;
+    bbox: [number, number, number, number];
+    confidence: number;
   }>;
+}
+
+/**
+ * Last event of a run: the tracks still open at the end and, for each
+ * streamed tracklet, the track it was linked into (-1 = dropped).
+ */
+interface RawDoneEvent {
+  event: "done";
+  tracks: RawTrack[];
+  segmentLinks: Record<string, number>;
+  /** With --output: the file holding the (whole) tracks instead */
+  output?: string;
   frameCount: number;
+  stopped?: boolean;
 }
 
 /**
- * Convert raw result to typed result (bbox as object).
+ * Tracks of the coarse pass (--preview), before the full run's.
  */
-function parseRawResult(raw: RawResult): PipelineResult {
-  const tracks: FaceTrack[] = raw.tracks.map((t) => ({
-    id: t.id,
-    frames: t.frames.map((f) => ({
+interface RawPreviewEvent {
+  event: "preview";
+  tracks: RawTrack[];
+  frameCount: number;
+  stopped?: boolean;
+}
+
+type RawEvent =
+  | { event: "progress"; stage: PipelineProgress["stage"]; done: number; total: number; preview?: boolean }
+  | ({ event: "segment" } & RawTrack)
+  | RawPreviewEvent
+  | RawDoneEvent;
+
+/**
+ * Convert raw track to typed track (bbox as object).
+ */
+function parseRawTrack(raw: RawTrack): FaceTrack {
+  return {
+    id: raw.id,
+    frames: raw.frames.map((f) => ({
       frameIndex: f.frameIndex,
       bbox: {
         x1: f.bbox[0],
@@ -262,9 +712,28 @@ function parseRawResult(raw: RawResult): PipelineResult {
       },
       confidence: f.confidence,
     })),
-  }));
+  };
+}
 
-  return { tracks, frameCount: raw.frameCount };
+/**
+ * Put streamed tracklets back into the tracks they were linked into.
+ */
+function mergeSegments(done: RawDoneEvent, segments: FaceTrack[]): PipelineResult {
+  const byId = new Map<number, FaceTrack>();
+  for (const t of done.tracks) byId.set(t.id, parseRawTrack(t));
+  for (const segment of segments) {
+    const root = done.segmentLinks[String(segment.id)] ?? -1;
+    if (root < 0) continue;
+    const track = byId.get(root);
+    if (track) {
+      track.frames.push(...segment.frames);
+    } else {
+      byId.set(root, { id: root, frames: [...segment.frames] });
+    }
+  }
+  const tracks = [...byId.values()].sort((a, b) => a.id - b.id);
+  for (const t of tracks) t.frames.sort((a, b) => a.frameIndex - b.frameIndex);
+  return { tracks, frameCount: done.frameCount, stopped: done.stopped === true };
 }
 
 // -----------------------------------------------------------------------------
@@ -324,10 +793,77 @@ export async function runFacePipeline(
     p.startsWith("file://") ? p.replace("file://", "") : p
   );
 
+  // The addon runs whole tracks; streamed segments, the preview, the
+  // playhead-first order, editor cuts and MOGRT keyframes come from the
+  // executable.
+  const addon = getNativeAddon();
+  if (
+    addon &&
+    !options.onSegment &&
+    !options.onPreview &&
+    !(options.priorityFrame! > 0) &&
+    !options.cuts?.length &&
+    !options.mogrtTicksPerFrame &&
+    !options.proxyDir
+  ) {
+    return trackNative(addon, cleanPaths, {
+      confThresh: options.confThresh ?? 0.5,
+      detectionFps: options.detectionFps ?? 5.0,
+      videoFps: options.videoFps ?? 30.0,
+      iouThresh: options.iouThresh ?? 0.15,
+      timeBudget: options.timeBudget,
+      signal: options.signal,
+      onProgress: options.onProgress,
+    });
+  }
+
   return spawnPipeline(cleanPaths, {
     confThresh: options.confThresh ?? 0.5,
     detectionFps: options.detectionFps ?? 5.0,
     videoFps: options.videoFps ?? 30.0,
     iouThresh: options.iouThresh ?? 0.15,
+    timeBudget: options.timeBudget,
+    priorityFrame: options.priorityFrame,
+    cuts: options.cuts,
+    signal: options.signal,
+    onProgress: options.onProgress,
+    onSegment: options.onSegment,
+    onPreview: options.onPreview,
+    mogrtTicksPerFrame: options.mogrtTicksPerFrame,
+    proxyDir: options.proxyDir,
   });
 }
+
+/** Proxy of frame `frameIndex` in PipelineOptions.proxyDir (it may not be written yet). */
+export function proxyFramePath(proxyDir: string, frameIndex: number): string {
+  return path.join(proxyDir, `${frameIndex.toString().padStart(6, "0")}.jpg`);
+}
+
+/**
+ * Detect the faces of one frame already in memory (e.g. to re-detect the
+ * frame under the playhead), in-process: a few milliseconds once the
+ * addon's pipeline is loaded, instead of spawning the executable.
+ *
+ * @returns Faces, most confident first, or null without the addon
+ */
+export async function detectFacesInFrame(
+  frame: FramePixels,
+  options: { confThresh?: number } = {}
+): Promise<Array<{ bbox: BBox; confidence: number }> | null> {
+  const addon = getNativeAddon();
+  if (!addon) return null;
+  const pipeline = await getNativePipeline(addon, {
+    confThresh: options.confThresh ?? 0.5,
+    detectionFps: 5.0,
+    iouThresh: 0.15,
+  });
+  const { boxes, scores } = await addon.detectFrame(pipeline, frame);
+  const faces: Array<{ bbox: BBox; confidence: number }> = [];
+  for (let i = 0; i < scores.length; i++) {
+    faces.push({
+      bbox: { x1: boxes[i * 4], y1: boxes[i * 4 + 1], x2: boxes[i * 4 + 2], y2: boxes[i * 4 + 3] },
+      confidence: scores[i],
+    });
+  }
+  return faces;
+}
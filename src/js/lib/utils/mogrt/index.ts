@@ -292,11 +292,12 @@ const updateMaskPathWithKeyframes = (
 };
 
 /**
- * Updates a mask path parameter with explicit keyframes (ticks + base64).
+ * Updates a mask path parameter with explicit keyframes (ticks + base64),
+ * or with the <Keyframes> text the face pipeline already encoded.
  */
 const updateMaskPathWithExplicitKeyframes = (
   maskPathParam: Element,
-  keyframes: Array<{ ticks: string; base64: string }>
+  keyframes: Array<{ ticks: string; base64: string }> | string
 ) => {
   const isTimeVarying = maskPathParam.querySelector("IsTimeVarying");
   if (isTimeVarying) {
@@ -314,11 +315,17 @@ const updateMaskPathWithExplicitKeyframes = (
     );
     maskPathParam.appendChild(startKeyframeValue);
   }
+  const text =
+    typeof keyframes === "string"
+      ? keyframes
+      : keyframes.map((k) => `${k.ticks},${k.base64}`).join(";") + ";";
   if (keyframes.length > 0) {
-    startKeyframeValue.textContent = keyframes[0].base64;
+    startKeyframeValue.textContent =
+      typeof keyframes === "string"
+        ? text.slice(text.indexOf(",") + 1, text.indexOf(";"))
+        : keyframes[0].base64;
   }
 
-  const text = keyframes.map((k) => `${k.ticks},${k.base64}`).join(";") + ";";
   let keyframesEl = maskPathParam.querySelector("Keyframes");
   if (!keyframesEl) {
     keyframesEl = maskPathParam.ownerDocument.createElement("Keyframes");
@@ -492,7 +499,7 @@ export const updateXmlMaskPathsOrAdd = async (
     expansion?: number;
     animate?: boolean;
     points?: MaskPoint[];
-    keyframes?: Array<{ ticks: string; base64: string }>;
+    keyframes?: Array<{ ticks: string; base64: string }> | string;
   }>
 ): Promise<string> => {
   const fileContent = fs.readFileSync(xmlPath, "utf8");
@@ -646,10 +653,13 @@ const createTinyMaskPath = (): MaskPoint[] => {
 /**
  * Build and import a MOGRT from tracked masks with explicit per-frame keyframes.
  * Fills in missing frames with tiny masks to prevent masks from "hanging around".
+ * A track's `keyframes`, encoded by the face pipeline for the same ticks per
+ * frame and frame count (FaceTrack.mogrtKeyframes), go in as they are.
  */
 export const buildAndImportMogrtFromTracks = async (
   tracks: Array<{
     frames: Array<{ frameIndex: number; points: MaskPoint[] }>;
+    keyframes?: string;
     blurriness?: number;
     feather?: number;
     expansion?: number;
@@ -702,6 +712,16 @@ export const buildAndImportMogrtFromTracks = async (
 
     // Prepare specs - fill in missing frames with tiny masks
     const specs = tracks.map((t) => {
+      if (t.keyframes) {
+        const start = t.keyframes.slice(t.keyframes.indexOf(",") + 1, t.keyframes.indexOf(";"));
+        return {
+          base64: start,
+          keyframes: t.keyframes,
+          blurriness: t.blurriness,
+          feather: t.feather,
+          expansion: t.expansion,
+        };
+      }
       // Create a map of frameIndex -> points for quick lookup
       const frameMap = new Map<number, MaskPoint[]>();
       t.frames.forEach((f) => {
@@ -0,0 +1,119 @@
+/**
+ * Reader of the face pipeline's binary result (--output-format binary),
+ * laid out in cpp/src/track_binary.hpp: tracks come back as typed arrays,
+ * without building an object per frame.
+ * Single export: decodeTrackBinary()
+ */
+
+/** One track: frame i is frameIndices[i], boxes[4i..4i+3] (x1, y1, x2, y2), confidences[i]. */
+export interface BinaryTrack {
+  id: number;
+  /** -1 = none */
+  identity: number;
+  frameIndices: Int32Array;
+  boxes: Float32Array;
+  confidences: Float32Array;
+}
+
+export interface BinaryResult {
+  tracks: BinaryTrack[];
+  frameCount: number;
+  stopped: boolean;
+  /** Streamed segment -> track it was linked into (-1 = dropped) */
+  segmentLinks: Map<number, number>;
+}
+
+const MAGIC = "FPTRACK1";
+const HEADER_BYTES = 48;
+const FLAG_ZSTD = 1;
+const FLAG_STOPPED = 2;
+
+/**
+ * Decode a binary result. zstd payloads (binary-zstd) need a zstd
+ * decompressor: pass one, or run on a Node whose zlib has it.
+ *
+ * @throws if the bytes are not a result this reader knows
+ */
+export function decodeTrackBinary(
+  bytes: Uint8Array,
+  decompress?: (payload: Uint8Array) => Uint8Array
+): BinaryResult {
+  if (bytes.byteLength < HEADER_BYTES) throw new Error("track binary: truncated header");
+  const header = new DataView(bytes.buffer, bytes.byteOffset, HEADER_BYTES);
+  for (let i = 0; i < MAGIC.length; i++) {
+    if (header.getUint8(i) !== MAGIC.charCodeAt(i)) throw new Error("track binary: bad magic");
+  }
+  const version = header.getUint32(8, true);
+  if (version !== 1) throw new Error(`track binary: unknown version ${version}`);
+  const flags = header.getUint32(12, true);
+  const frameCount = header.getInt32(16, true);
+  const trackCount = header.getUint32(20, true);
+  const linkCount = header.getUint32(24, true);
+  const payloadBytes = Number(header.getBigUint64(32, true));
+  const storedBytes = Number(header.getBigUint64(40, true));
+  if (bytes.byteLength < HEADER_BYTES + storedBytes) throw new Error("track binary: truncated payload");
+
+  let payload = bytes.subarray(HEADER_BYTES, HEADER_BYTES + storedBytes);
+  if (flags & FLAG_ZSTD) {
+    payload = (decompress ?? zstdDecompress)(payload);
+  }
+  if (payload.byteLength !== payloadBytes) throw new Error("track binary: payload size mismatch");
+
+  const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+  let at = 0;
+  const need = (n: number) => {
+    if (at + n > payload.byteLength) throw new Error("track binary: truncated track");
+  };
+  const tracks: BinaryTrack[] = new Array(trackCount);
+  for (let t = 0; t < trackCount; t++) {
+    need(16);
+    const id = view.getInt32(at, true);
+    const identity = view.getInt32(at + 4, true);
+    const frames = view.getUint32(at + 8, true);
+    const runs = view.getUint32(at + 12, true);
+    at += 16;
+
+    need(runs * 8);
+    const frameIndices = new Int32Array(frames);
+    let f = 0;
+    for (let r = 0; r < runs; r++) {
+      const first = view.getInt32(at, true);
+      const length = view.getUint32(at + 4, true);
+      at += 8;
+      if (f + length > frames) throw new Error("track binary: runs exceed the frames");
+      for (let k = 0; k < length; k++) frameIndices[f++] = first + k;
+    }
+    if (f !== frames) throw new Error("track binary: runs do not cover the frames");
+
+    need(frames * 9);
+    const boxes = new Float32Array(frames * 4);
+    for (let c = 0; c < 4; c++) {
+      for (let i = 0; i < frames; i++) {
+        boxes[i * 4 + c] = view.getUint16(at + (c * frames + i) * 2, true) / 65535;
+      }
+    }
+    at += frames * 8;
+    const confidences = new Float32Array(frames);
+    for (let i = 0; i < frames; i++) confidences[i] = payload[at + i] / 255;
+    at += frames;
+    at = (at + 3) & ~3;
+
+    tracks[t] = { id, identity, frameIndices, boxes, confidences };
+  }
+
+  need(linkCount * 8);
+  const segmentLinks = new Map<number, number>();
+  for (let l = 0; l < linkCount; l++) {
+    segmentLinks.set(view.getInt32(at, true), view.getInt32(at + 4, true));
+    at += 8;
+  }
+  return { tracks, frameCount, stopped: (flags & FLAG_STOPPED) !== 0, segmentLinks };
+}
+
+function zstdDecompress(payload: Uint8Array): Uint8Array {
+  const zlib = typeof require !== "undefined" ? require("zlib") : null;
+  if (!zlib || typeof zlib.zstdDecompressSync !== "function") {
+    throw new Error("track binary: zstd payload, but this Node has no zstd (use --output-format binary)");
+  }
+  return zlib.zstdDecompressSync(payload);
+}
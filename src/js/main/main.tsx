@@ -7,10 +7,25 @@ import { canvasToNormalized, type MaskPoint } from "../lib/utils/mogrt/encoder";
 import { fs, os, path } from "../lib/cep/node";
 import {
   bboxToMaskPoints,
+  proxyFramePath,
   runFacePipeline,
   type FaceTrack,
+  type PipelineProgress,
+  type TrackFrame,
 } from "../lib/utils/faceDetection";
 
+const describePipelineProgress = (p: PipelineProgress): string => {
+  if (p.preview) return `Quick preview… (${p.done}/${p.total} frames)`;
+  switch (p.stage) {
+    case "frames":
+      return `Detecting faces… (${p.done}/${p.total} frames)`;
+    case "shots":
+      return `Tracking shots… (${p.done}/${p.total})`;
+    case "linking":
+      return "Linking face tracks…";
+  }
+};
+
 export const App = () => {
   const [bgColor, setBgColor] = useState("#282c34");
   const [statusMessage, setStatusMessage] = useState("");
@@ -23,6 +38,9 @@ export const App = () => {
     feather?: number;
     expansion?: number;
     keyframes?: Record<number, MaskPoint[]>; // frameIndex -> points mapping
+    // The pipeline's MOGRT encoding of `keyframes` (FaceTrack.mogrtKeyframes),
+    // good while the mask keeps that very object (edits replace it).
+    native?: { keyframes: Record<number, MaskPoint[]>; text: string; ticksPerFrame: string };
   };
   const [masks, setMasks] = useState<UIMask[]>([]);
   const [activeMaskId, setActiveMaskId] = useState<string | null>(null);
@@ -44,14 +62,56 @@ export const App = () => {
   const [isRendering, setIsRendering] = useState(false);
   const detectAbortRef = useRef<{ cancelled: boolean }>({ cancelled: false });
   const [faceTracks, setFaceTracks] = useState<FaceTrack[] | null>(null);
+  // Editable masks from tracks, each starting on the box `startFrame` picks.
+  const masksFromTracks = (
+    tracks: FaceTrack[],
+    startFrame: (t: FaceTrack) => TrackFrame | undefined,
+    ticksPerFrame?: string
+  ): UIMask[] =>
+    tracks.map((t, idx) => {
+      const keyframes: Record<number, MaskPoint[]> = {};
+      t.frames.forEach((f) => {
+        keyframes[f.frameIndex] = bboxToMaskPoints(f.bbox);
+      });
+
+      const use = startFrame(t);
+      const pts = use ? bboxToMaskPoints(use.bbox) : [];
+
+      return {
+        id: `track_${t.id}`,
+        name: `Person ${idx + 1}`,
+        points: pts,
+        blurriness: 50,
+        feather: 10,
+        expansion: 0,
+        keyframes,
+        native:
+          t.mogrtKeyframes && ticksPerFrame
+            ? { keyframes, text: t.mogrtKeyframes, ticksPerFrame }
+            : undefined,
+      };
+    });
+  // Masks of the quick coarse pass, shown until the full run replaces them.
+  const showPreview = (
+    tracks: FaceTrack[],
+    startFrame: (t: FaceTrack) => TrackFrame | undefined
+  ) => {
+    const previewMasks = masksFromTracks(tracks, startFrame);
+    setMasks(previewMasks);
+    setActiveMaskId(previewMasks[0]?.id ?? null);
+    setStatusMessage(`Preview: ${tracks.length} face track(s); refining…`);
+  };
   const [confidenceThreshold, setConfidenceThreshold] = useState<number>(0.5);
   const [selectionInfo, setSelectionInfo] = useState<{
     startTicks: string;
     endTicks: string;
     ticksPerFrame: string;
     numFrames: number;
+    cutFrames: number[];
   } | null>(null);
   const [framePaths, setFramePaths] = useState<string[]>([]);
+  // Small JPEGs of the frames, written by the pipeline as it decodes them.
+  const [proxyDir, setProxyDir] = useState<string | null>(null);
   const [currentFrameIndex, setCurrentFrameIndex] = useState<number>(0);
   const [isPlaying, setIsPlaying] = useState<boolean>(false);
 
@@ -140,7 +200,9 @@ export const App = () => {
       0,
       Math.min(currentFrameIndex, framePaths.length - 1)
     );
-    const nextPath = framePaths[clamped];
+    const proxyPath = proxyDir ? proxyFramePath(proxyDir, clamped) : null;
+    const useProxy = proxyPath !== null && fs.existsSync && fs.existsSync(proxyPath);
+    const nextPath = useProxy && proxyPath ? proxyPath : framePaths[clamped];
     // Update preview image (read as data URL if possible)
     try {
       if (fs.existsSync && fs.existsSync(nextPath)) {
@@ -148,7 +210,7 @@ export const App = () => {
         const base64 = Buffer.from(
           imageBuffer as unknown as Uint8Array
         ).toString("base64");
-        const dataUrl = `data:image/png;base64,${base64}`;
+        const dataUrl = `data:image/${useProxy ? "jpeg" : "png"};base64,${base64}`;
         setPreviewImage(dataUrl);
       } else {
         setPreviewImage(nextPath);
@@ -156,7 +218,7 @@ export const App = () => {
     } catch {
       setPreviewImage(nextPath);
     }
-  }, [currentFrameIndex, framePaths]);
+  }, [currentFrameIndex, framePaths, proxyDir]);
 
 
   // Helper to get points for a mask at a given frame index
@@ -366,6 +428,8 @@ export const App = () => {
           return na - nb;
         });
       setFramePaths(pngs);
+      const proxies = path.join(result.outputDir, "proxies");
+      setProxyDir(proxies);
       setCurrentFrameIndex(0);
 
       if (pngs.length === 0) {
@@ -377,10 +441,17 @@ export const App = () => {
       setIsDetectingFaces(true);
       setStatusMessage(`Detecting faces… (${pngs.length} frames)`);
 
+      const firstFrame = (t: FaceTrack) =>
+        t.frames.find((f) => f.frameIndex === 0) ?? t.frames[0];
       const pipelineResult = await runFacePipeline(pngs, {
         confThresh: confidenceThreshold,
         videoFps: 30.0,
         detectionFps: 5.0,
+        onProgress: (p) => setStatusMessage(describePipelineProgress(p)),
+        onPreview: (preview) => showPreview(preview.tracks, firstFrame),
+        mogrtTicksPerFrame: info.ticksPerFrame,
+        proxyDir: proxies,
+        cuts: info.cutFrames,
       });
 
       if (detectAbortRef.current.cancelled) {
@@ -392,25 +463,7 @@ export const App = () => {
       setFaceTracks(pipelineResult.tracks);
 
       // Initialize editable masks from tracks
-      const newMasks: UIMask[] = pipelineResult.tracks.map((t, idx) => {
-        const keyframes: Record<number, MaskPoint[]> = {};
-        t.frames.forEach((f) => {
-          keyframes[f.frameIndex] = bboxToMaskPoints(f.bbox);
-        });
-
-        const use = t.frames.find((f) => f.frameIndex === 0) ?? t.frames[0];
-        const pts = use ? bboxToMaskPoints(use.bbox) : [];
-
-        return {
-          id: `track_${t.id}`,
-          name: `Person ${idx + 1}`,
-          points: pts,
-          blurriness: 50,
-          feather: 10,
-          expansion: 0,
-          keyframes,
-        };
-      });
+      const newMasks = masksFromTracks(pipelineResult.tracks, firstFrame, info.ticksPerFrame);
 
       setMasks(newMasks);
       setActiveMaskId(newMasks[0]?.id ?? null);
@@ -792,10 +845,17 @@ export const App = () => {
       detectAbortRef.current.cancelled = false;
       setStatusMessage(`Detecting faces… (${framePaths.length} frames)`);
 
+      const currentFrame = (t: FaceTrack) =>
+        t.frames.find((f) => f.frameIndex === currentFrameIndex) ??
+        t.frames[t.frames.length - 1];
       const pipelineResult = await runFacePipeline(framePaths, {
         confThresh: confidenceThreshold,
         videoFps: 30.0,
         detectionFps: 5.0,
+        priorityFrame: currentFrameIndex,
+        onProgress: (p) => setStatusMessage(describePipelineProgress(p)),
+        onPreview: (preview) => showPreview(preview.tracks, currentFrame),
+        mogrtTicksPerFrame: selectionInfo?.ticksPerFrame,
       });
 
       if (detectAbortRef.current.cancelled) {
@@ -806,27 +866,11 @@ export const App = () => {
       setFaceTracks(pipelineResult.tracks);
 
       // Initialize editable masks from tracks
-      const newMasks: UIMask[] = pipelineResult.tracks.map((t, idx) => {
-        const keyframes: Record<number, MaskPoint[]> = {};
-        t.frames.forEach((f) => {
-          keyframes[f.frameIndex] = bboxToMaskPoints(f.bbox);
-        });
-
-        const use =
-          t.frames.find((f) => f.frameIndex === currentFrameIndex) ??
-          t.frames[t.frames.length - 1];
-        const pts = use ? bboxToMaskPoints(use.bbox) : [];
-
-        return {
-          id: `track_${t.id}`,
-          name: `Person ${idx + 1}`,
-          points: pts,
-          blurriness: 50,
-          feather: 10,
-          expansion: 0,
-          keyframes,
-        };
-      });
+      const newMasks = masksFromTracks(
+        pipelineResult.tracks,
+        currentFrame,
+        selectionInfo?.ticksPerFrame
+      );
 
       setMasks(newMasks);
       setActiveMaskId(newMasks[0]?.id ?? null);
@@ -866,8 +910,15 @@ export const App = () => {
               }))
               .sort((a, b) => a.frameIndex - b.frameIndex);
 
+            const native =
+              m.native &&
+              m.native.keyframes === m.keyframes &&
+              m.native.ticksPerFrame === selectionInfo.ticksPerFrame
+                ? m.native.text
+                : undefined;
             return {
               frames,
+              keyframes: native,
               blurriness: m.blurriness ?? 50,
               feather: m.feather ?? 10,
               expansion: m.expansion ?? 0,
@@ -905,6 +956,7 @@ export const App = () => {
             frameIndex: f.frameIndex,
             points: bboxToMaskPoints(f.bbox),
           })),
+          keyframes: t.mogrtKeyframes,
           blurriness: 50,
           feather: 10,
           expansion: 0,
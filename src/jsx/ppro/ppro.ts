@@ -74,6 +74,7 @@ export const getSelectionRangeAndSetInOut = ():
       endTicks: string;
       ticksPerFrame: string;
       numFrames: number;
+      cutFrames: number[];
     }
   | string => {
   try {
@@ -145,11 +146,37 @@ export const getSelectionRangeAndSetInOut = ():
       Math.round((maxEnd - minStart) / parseInt(tpf, 10))
     );
 
+    // Clip boundaries inside the range are the edit's cuts, as frames of
+    // the rendered sequence (the first frame of each new shot).
+    const ticks = parseInt(tpf, 10);
+    const cutFrames: number[] = [];
+    for (let i = 0; i < seq.videoTracks.numTracks; i++) {
+      const track = seq.videoTracks[i];
+      for (let j = 0; j < track.clips.numItems; j++) {
+        const clip = track.clips[j];
+        const edges = [parseInt(clip.start.ticks, 10), parseInt(clip.end.ticks, 10)];
+        for (let k = 0; k < edges.length; k++) {
+          const t = edges[k];
+          if (isNaN(t) || t <= minStart || t >= maxEnd) continue;
+          const frame = Math.round((t - minStart) / ticks);
+          if (frame > 0 && frame < frames) cutFrames.push(frame);
+        }
+      }
+    }
+    cutFrames.sort((a, b) => a - b);
+    // Clips on other tracks often share an edge (no Array.indexOf here).
+    let unique = 0;
+    for (let k = 0; k < cutFrames.length; k++) {
+      if (k === 0 || cutFrames[k] !== cutFrames[unique - 1]) cutFrames[unique++] = cutFrames[k];
+    }
+    cutFrames.length = unique;
+
     return {
       startTicks: inTicks,
       endTicks: outTicks,
       ticksPerFrame: tpf,
       numFrames: frames,
+      cutFrames,
     };
   } catch (e: any) {
     return `Error in getSelectionRangeAndSetInOut: ${e.toString()}`;